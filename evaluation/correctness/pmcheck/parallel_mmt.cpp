@@ -0,0 +1,318 @@
+// Parallel driver for the pmcheck tests (see run.sh).
+//
+// Random-mode model checking is embarrassingly parallel: each execution
+// starts from a fresh pool and an independently chosen crash point, so a
+// budget of N executions can be split across worker processes without
+// changing what is explored. This driver shards the execution budget
+// over a process pool fed from a shared work queue, giving one run.sh
+// invocation (with its own pool id and scratch directory) per shard.
+//
+// Different shards frequently rediscover the same buggy execution. Each
+// finished shard's log is scanned for findings, every finding is reduced
+// to a hash of its text with run-specific numbers (sequence numbers,
+// addresses, pool ids) masked out, and only the first occurrence of each
+// hash is reported. The per-shard logs are kept under out/parallel/ for
+// manual inspection.
+//
+// Usage: parallel_mmt <target|all> <tool> <mode> [workers] [execs]
+//   target  one of the run.sh targets, or "all"
+//   tool    yashme | psan
+//   mode    random | model ("model" runs one shard per target; its
+//           schedule enumeration cannot be split)
+//   workers process pool size (default: number of cores)
+//   execs   total random-mode executions per target (default: 1000)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <limits.h>
+#include <time.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+static const char *all_targets[] = {
+    "simple", "checkpoint", "detectable_cas",
+    "queue_O0", "queue_O1", "queue_O2", "queue_comb",
+    "treiber_stack", "list", "clevel",
+};
+static const int num_all_targets = sizeof(all_targets) / sizeof(all_targets[0]);
+
+struct Job
+{
+    std::string target;
+    std::string pool_postfix; // unique per job, keeps pools/scratch apart
+    int execs;                // this shard's slice of the budget
+};
+
+// Shared state ---------------------------------------------------------
+
+static std::vector<Job> job_queue;
+static size_t next_job = 0;
+static std::mutex queue_lock;
+
+static std::unordered_set<unsigned long long> seen_findings;
+static std::mutex report_lock;
+
+static long total_executions = 0;
+static long buggy_executions = 0;
+static int failed_jobs = 0;
+static int duplicate_findings = 0;
+
+static std::string dir_base; // directory containing this binary's sources
+static std::string log_dir;
+static std::string tool;
+static std::string mode;
+
+// Finding deduplication ------------------------------------------------
+
+// FNV-1a over the finding text with every digit run collapsed to '#'.
+// Sequence numbers, thread ids, addresses and pool postfixes differ
+// between shards even when the underlying bug is the same; masking them
+// makes the hash a (coarse) identifier of the buggy state itself.
+static unsigned long long finding_hash(const char *line)
+{
+    unsigned long long h = 14695981039346656037ull;
+    int in_number = 0;
+    for (const char *p = line; *p != '\0'; p++)
+    {
+        char c = *p;
+        if ((c >= '0' && c <= '9') || (in_number && ((c >= 'a' && c <= 'f') || c == 'x')))
+        {
+            if (in_number) continue;
+            in_number = 1;
+            c = '#';
+        }
+        else
+        {
+            in_number = 0;
+        }
+        h = (h ^ (unsigned long long)(unsigned char)c) * 1099511628211ull;
+    }
+    return h;
+}
+
+static int is_finding(const char *line)
+{
+    return strstr(line, "ERROR") != NULL ||
+           strstr(line, "Error") != NULL ||
+           strstr(line, "race") != NULL ||
+           strstr(line, "Race") != NULL ||
+           strstr(line, "bug") != NULL ||
+           strstr(line, "Bug") != NULL ||
+           strstr(line, "WARNING") != NULL;
+}
+
+// Scans one finished shard's log: reports unseen findings and folds the
+// checker's final execution counts into the global totals.
+static void scan_log(const Job &job, const std::string &log_path)
+{
+    FILE *log = fopen(log_path.c_str(), "r");
+    if (log == NULL)
+    {
+        return;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), log) != NULL)
+    {
+        long count;
+        if (sscanf(line, "Number of complete, bug-free executions: %ld", &count) == 1)
+        {
+            std::lock_guard<std::mutex> guard(report_lock);
+            total_executions += count;
+            continue;
+        }
+        if (sscanf(line, "Number of buggy executions: %ld", &count) == 1)
+        {
+            std::lock_guard<std::mutex> guard(report_lock);
+            total_executions += count;
+            buggy_executions += count;
+            continue;
+        }
+        if (!is_finding(line))
+        {
+            continue;
+        }
+
+        // "Number of buggy executions: 0" style summary lines are handled
+        // above; everything else matching the keywords is a finding.
+        unsigned long long h = finding_hash(line);
+        std::lock_guard<std::mutex> guard(report_lock);
+        if (seen_findings.insert(h).second)
+        {
+            printf("[%s/%s] %s", job.target.c_str(), job.pool_postfix.c_str(), line);
+            fflush(stdout);
+        }
+        else
+        {
+            duplicate_findings++;
+        }
+    }
+    fclose(log);
+}
+
+// Worker ---------------------------------------------------------------
+
+// Runs one shard: forks run.sh with this job's pool postfix and
+// execution slice, with stdout/stderr redirected to the shard's log.
+static int run_job(const Job &job, const std::string &log_path)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0)
+    {
+        int fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0)
+        {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        std::string script = dir_base + "/run.sh";
+        char execs[32];
+        snprintf(execs, sizeof(execs), "%d", job.execs);
+        execl(script.c_str(), script.c_str(), job.target.c_str(),
+              tool.c_str(), mode.c_str(), job.pool_postfix.c_str(), execs,
+              (char *)NULL);
+        perror("execl");
+        _exit(127);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static void worker_main()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::lock_guard<std::mutex> guard(queue_lock);
+            if (next_job == job_queue.size())
+            {
+                return;
+            }
+            job = job_queue[next_job++];
+        }
+
+        std::string log_path = log_dir + "/" + job.target + "_" + job.pool_postfix + ".log";
+        int failed = run_job(job, log_path);
+        scan_log(job, log_path);
+        if (failed)
+        {
+            std::lock_guard<std::mutex> guard(report_lock);
+            failed_jobs++;
+            printf("[%s/%s] shard failed, see %s\n",
+                   job.target.c_str(), job.pool_postfix.c_str(), log_path.c_str());
+            fflush(stdout);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || argc > 6)
+    {
+        printf("Usage: %s <target|all> <tool> <mode> [workers] [execs]\n", argv[0]);
+        return 1;
+    }
+
+    const char *target = argv[1];
+    tool = argv[2];
+    mode = argv[3];
+    int workers = (argc > 4) ? atoi(argv[4]) : (int)std::thread::hardware_concurrency();
+    int execs = (argc > 5) ? atoi(argv[5]) : 1000;
+    if (workers < 1 || execs < 1)
+    {
+        printf("Invalid worker/execution count.\n");
+        return 1;
+    }
+    if (mode != "random" && mode != "model")
+    {
+        printf("invalid mode: %s (possible mode: model, random)\n", mode.c_str());
+        return 1;
+    }
+
+    // The driver is built next to the test binaries but run.sh and the
+    // logs live in the source directory, one level up from .build.
+    char self[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len <= 0)
+    {
+        perror("readlink");
+        return 1;
+    }
+    self[len] = '\0';
+    dir_base = std::string(dirname(self)) + "/..";
+    log_dir = dir_base + "/out/parallel";
+    std::string out_dir = dir_base + "/out";
+    mkdir(out_dir.c_str(), 0755);
+    mkdir(log_dir.c_str(), 0755);
+
+    std::vector<std::string> targets;
+    if (strcmp(target, "all") == 0)
+    {
+        for (int i = 0; i < num_all_targets; i++)
+        {
+            targets.push_back(all_targets[i]);
+        }
+    }
+    else
+    {
+        targets.push_back(target);
+    }
+
+    // Shard each target's budget; model mode enumerates its schedule
+    // space in one process, so it gets one shard per target and the
+    // pool only parallelizes across targets.
+    int shards = (mode == "random") ? workers : 1;
+    long base_postfix = (long)time(NULL) * 1000;
+    for (const std::string &t : targets)
+    {
+        for (int s = 0; s < shards; s++)
+        {
+            Job job;
+            job.target = t;
+            job.pool_postfix = std::to_string(base_postfix++);
+            job.execs = (execs + shards - 1) / shards;
+            job_queue.push_back(job);
+        }
+    }
+
+    printf("[parallel_mmt] %zu shards over %d workers (tool: %s, mode: %s)\n",
+           job_queue.size(), workers, tool.c_str(), mode.c_str());
+
+    std::vector<std::thread> pool;
+    for (int w = 0; w < workers; w++)
+    {
+        pool.emplace_back(worker_main);
+    }
+    for (std::thread &t : pool)
+    {
+        t.join();
+    }
+
+    printf("[parallel_mmt] done: %ld executions (%ld buggy), "
+           "%zu unique findings, %d duplicates suppressed, %d failed shards\n",
+           total_executions, buggy_executions,
+           seen_findings.size(), duplicate_findings, failed_jobs);
+    return failed_jobs != 0;
+}
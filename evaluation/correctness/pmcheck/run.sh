@@ -20,7 +20,10 @@ cd $BUILD
 TARGET=$1
 TOOL=$2
 MODE=$3
-pool_postfix=$(date +%s%3N)
+# Optional: explicit pool postfix and random-mode execution count, used
+# by parallel_mmt to give each shard a private pool and budget slice.
+pool_postfix=${4:-$(date +%s%3N)}
+EXECS=${5:-1000}
 pool_id=${TARGET}_${pool_postfix}
 
 # Set
@@ -47,7 +50,7 @@ fi
 if [ "${MODE}" == "model" ]; then
     OPT="$OPT"
 elif [ "${MODE}" == "random" ]; then
-    OPT="$OPT -x1000"
+    OPT="$OPT -x$EXECS"
 else
     echo "invalid mode: $MODE (possible mode: model, random)"
     exit
@@ -55,15 +58,40 @@ fi
 echo "[Run] target: $TARGET, TOOL: $TOOL, (option: $OPT, pool: $pool_id)"
 dmsg "[Run] target: $TARGET, TOOL: $TOOL, (option: $OPT, pool: $pool_id)"
 
+# Pool templating (see scripts/prime_pool.sh): if a primed pool image
+# exists for this target, clone it (CoW where the fs supports reflinks)
+# so this run opens an initialized pool instead of re-running setup.
+TEMPLATE_DIR=/mnt/pmem0/test/templates/$TARGET
+if [ -d "$TEMPLATE_DIR" ] && [ "${PMCHECK_SAVE_TEMPLATE:-0}" != "1" ]; then
+    mkdir -p /mnt/pmem0/test/$pool_id
+    for f in $TEMPLATE_DIR/${TARGET}_template*; do
+        [ -e "$f" ] || continue
+        cp --reflink=auto "$f" /mnt/pmem0/test/$pool_id/$(basename "$f" | sed "s/${TARGET}_template/$pool_id/")
+    done
+fi
+
 # Run
 export LD_LIBRARY_PATH=$PMCHECK:$RUSTSTD
 export PMCheck="-d/mnt/pmem0/test/$pool_id/$pool_id.pool_valid $OPT"
 ulimit -s 82920000
 mkdir -p $OUT/$TOOL
+# Each invocation runs in its own scratch directory so that concurrent
+# runs (parallel_mmt) do not clobber each other's PMCheckOutput files.
+SCRATCH=$BUILD/job_$pool_id
+mkdir -p $SCRATCH
+cd $SCRATCH
 # RUST_MIN_STACK=100000000 ./test_mmt_$TOOL $TARGET 2>&1>>$OUT/$TOOL/$TARGET.log
-RUST_MIN_STACK=100000000 ./test_mmt_$TOOL $TARGET $pool_postfix
+RUST_MIN_STACK=100000000 $BUILD/test_mmt_$TOOL $TARGET $pool_postfix
 # 2>&1 | tee -a the_log_file
-rm -rf PMCheckOutput*
-rm -rf /mnt/pmem0/test/$pool_id
+cd $BUILD
+rm -rf $SCRATCH
+if [ "${PMCHECK_SAVE_TEMPLATE:-0}" == "1" ]; then
+    # keep the initialized pool as this target's template image
+    rm -rf $TEMPLATE_DIR
+    mkdir -p $(dirname $TEMPLATE_DIR)
+    mv /mnt/pmem0/test/$pool_id $TEMPLATE_DIR
+else
+    rm -rf /mnt/pmem0/test/$pool_id
+fi
 echo "[Finish] target: $TARGET, TOOL: $TOOL, (option: $OPT)"
 dmsg "[Finish] target: $TARGET, TOOL: $TOOL, (option: $OPT)"
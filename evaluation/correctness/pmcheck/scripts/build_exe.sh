@@ -41,3 +41,7 @@ function build() {
 
 build psan
 build yashme
+
+# Parallel driver (plain host binary, no instrumentation)
+echo "Build parallel_mmt"
+g++ -std=c++17 -O2 -Wall -pthread $DIR_BASE/parallel_mmt.cpp -o $BUILD/parallel_mmt
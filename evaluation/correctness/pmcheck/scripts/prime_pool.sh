@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# Primes pool template images for run.sh's pool templating.
+#
+# Each target is run once with MEMENTO_POOL_PRIME=1, so the process
+# creates and initializes its pool but skips the root mementos, and the
+# resulting image is saved under /mnt/pmem0/test/templates/<target>/.
+# Later run.sh invocations clone the image (reflink/CoW where the
+# filesystem supports it) instead of paying pool setup on every
+# execution. Re-run this after changing a data structure's layout.
+#
+# Usage: ./scripts/prime_pool.sh [target...]   (default: all targets)
+
+set -e
+
+DIR_BASE=$(dirname $(realpath $0))/..
+TOOL=${TOOL:-psan}
+
+if [ $# -ge 1 ]; then
+    TARGETS="$@"
+else
+    TARGETS="simple checkpoint detectable_cas queue_O0 queue_O1 queue_O2 queue_comb treiber_stack list clevel"
+fi
+
+for target in $TARGETS; do
+    echo "[Prime] $target"
+    MEMENTO_POOL_PRIME=1 PMCHECK_SAVE_TEMPLATE=1 \
+        $DIR_BASE/run.sh $target $TOOL random template 1
+done
@@ -2,10 +2,42 @@
 #define CCEH_H_
 
 #include <hash_api.h>
+
+#ifdef CCEH_RALLOC
+// Persistent-memory-native flavor: segments and directories come from
+// ralloc (RP_malloc) instead of libvmem, so CCEH pays the same
+// allocator costs as the ralloc-based tables and runs on our real
+// pools. Segment and directory sizes are powers of two, so they land
+// on ralloc size-class boundaries without extra padding.
+#include <ralloc.hpp>
+#include <vmem.h> // site tags only; the accounting layer is vmem-build-only
+static inline void cceh_pool_init(void)
+{
+  static int restarted = RP_init("cceh", 32UL * 1024 * 1024 * 1024);
+  (void)restarted;
+}
+static inline void *cceh_alloc(size_t size,
+                               enum vmem_site site = VMEM_SITE_OTHER)
+{
+  (void)site;
+  cceh_pool_init();
+  return RP_malloc(size);
+}
+inline void deletePM() { RP_close(); }
+inline void vmem_print() {}
+#else
 #include <vmem.h>
+static inline void *cceh_alloc(size_t size,
+                               enum vmem_site site = VMEM_SITE_OTHER)
+{
+  return vmem_aligned_alloc_site(site, 64, size);
+}
+#endif
 
 #include <atomic>
 #include <cmath>
+#include <thread>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -13,6 +45,7 @@
 
 #include "pair.h"
 #include "persist.h"
+#include "table_stats.h"
 constexpr size_t kSegmentBits = 8;
 constexpr size_t kMask = (1 << kSegmentBits) - 1;
 constexpr size_t kShift = kSegmentBits;
@@ -29,15 +62,15 @@ struct Segment
 
   ~Segment(void) {}
 
-  void *operator new(size_t size) { return vmem_aligned_alloc(vmp, 64, size); }
+  void *operator new(size_t size) { return cceh_alloc(size, VMEM_SITE_SEGMENT); }
 
-  void *operator new[](size_t size)
-  {
-    return vmem_aligned_alloc(vmp, 64, size);
-  }
+  void *operator new[](size_t size) { return cceh_alloc(size, VMEM_SITE_SEGMENT); }
 
   int Insert(Key_t &, Value_t, size_t, size_t);
+  int Update(Key_t &, Value_t, size_t, size_t);
   void Insert4split(Key_t &, Value_t, size_t);
+  void Mask4split(size_t *, uint8_t *);
+  void Scatter4split(Segment *, Segment *);
   bool Put(Key_t &, Value_t, size_t);
   Segment **Split(void);
 
@@ -46,6 +79,26 @@ struct Segment
   int64_t sema = 0;
   size_t pattern = 0;
   size_t numElem(void);
+
+  /// One-byte hash fingerprints, one per slot, set on insert and
+  /// cleared on delete. Probes compare 16 of these with one SSE load
+  /// before touching any pair cache line; 0 means "unknown" (never
+  /// written, or lost across restart) and always falls through to the
+  /// full key compare, so the filter can only skip true misses.
+  uint8_t fp_[kNumSlot] = {};
+
+  /// Fingerprint byte: bits 8..15 of the hash — the bucket index uses
+  /// bits 0..7 and the directory the top bits, so it adds information.
+  static uint8_t fp_of(size_t key_hash)
+  {
+    return (key_hash >> kShift) & 0xFF;
+  }
+
+  /// Sibling being populated while this segment splits (INPLACE mode).
+  /// Published before the copy loop starts so probes and writers whose
+  /// keys belong to the new half follow it instead of stalling on the
+  /// whole migration; cleared once the directory swings over.
+  Segment *forward_ = nullptr;
 };
 
 struct Directory
@@ -56,12 +109,9 @@ struct Directory
   size_t depth;
   bool lock;
   int sema = 0;
-  void *operator new(size_t size) { return vmem_aligned_alloc(vmp, 64, size); }
+  void *operator new(size_t size) { return cceh_alloc(size, VMEM_SITE_DIRECTORY); }
 
-  void *operator new[](size_t size)
-  {
-    return vmem_aligned_alloc(vmp, 64, size);
-  }
+  void *operator new[](size_t size) { return cceh_alloc(size, VMEM_SITE_DIRECTORY); }
   Directory(void)
   {
     depth = kDefaultDepth;
@@ -80,7 +130,14 @@ struct Directory
     sema = 0;
   }
 
-  ~Directory(void) { vmem_free(vmp, _); }
+  ~Directory(void)
+  {
+#ifdef CCEH_RALLOC
+    RP_free(_);
+#else
+    vmem_free(vmp, _);
+#endif
+  }
 
   bool Acquire(void)
   {
@@ -94,17 +151,60 @@ struct Directory
     return CAS(&lock, &locked, false);
   }
 
+  /// Striped locks over the entry array. Normal splits lock only the
+  /// stripes their chunk touches, and doubling migrates the doubled
+  /// directory stripe by stripe under the same locks, so splits
+  /// elsewhere in the table proceed while the copy is in flight
+  /// instead of stalling on one table-wide lock for the whole pass.
+  static const size_t kNumStripes = 64;
+  bool stripe_lock_[kNumStripes] = {};
+
+  /// Doubled directory being populated while a doubling migrates. It
+  /// stays set on the retired directory, so a writer still holding a
+  /// stale snapshot propagates its update forward instead of losing it.
+  Directory *next_ = nullptr;
+
+  /// Per-stripe migration progress; written and read only under the
+  /// matching stripe lock.
+  bool stripe_migrated_[kNumStripes] = {};
+
+  size_t StripeOf(size_t idx) const { return idx * kNumStripes / capacity; }
+
+  void AcquireStripe(size_t s)
+  {
+    bool unlocked = false;
+    while (!CAS(&stripe_lock_[s], &unlocked, true))
+    {
+      unlocked = false;
+      asm("nop");
+    }
+  }
+
+  void ReleaseStripe(size_t s)
+  {
+    bool locked = true;
+    CAS(&stripe_lock_[s], &locked, false);
+  }
+
   void SanityCheck(void *);
   void LSBUpdate(int, int, int, int, Segment **);
 };
 
-class CCEH : public hash_api
+// final: the static-dispatch PiBench build calls through CCEH* and
+// relies on it to fully devirtualize
+class CCEH final : public hash_api
 {
 public:
   CCEH(void);
   CCEH(size_t);
-  ~CCEH(void) { deletePM(); };
+  ~CCEH(void)
+  {
+    presplit_stop_.store(true);
+    if (presplit_thread_.joinable()) presplit_thread_.join();
+    deletePM();
+  };
   bool Insert(Key_t &, Value_t);
+  bool Upsert(Key_t &, Value_t);
   bool InsertOnly(Key_t &, Value_t);
   bool Delete(Key_t &);
   Value_t Get(Key_t &);
@@ -121,34 +221,82 @@ public:
   // hash_api
   void vmem_print_api() { vmem_print(); }
   std::string hash_name() { return "CCEH"; };
+  size_t max_inline_value_size() { return sizeof(Value_t); }
+  void set_inline_value_size(size_t value_sz)
+  {
+    inline_value_sz_ = value_sz;
+    wrap_fn_ = fixed_value_wrap(value_sz);
+  }
   bool recovery() { return Recovery(); }
   hash_Utilization utilization() { return Utilization(); }
+  hash_stats_t stats()
+  {
+    hash_stats_t st = tstats_.snapshot();
+    st.directory_depth = dir->depth;
+    st.capacity =
+        num_segments_.load(std::memory_order_relaxed) * Segment::kNumSlot;
+    if (st.capacity)
+      st.load_factor = static_cast<double>(st.items) / st.capacity;
+    // Resident PM: the placement-hook accounting covers values too;
+    // the ralloc build has no accounting layer, so derive it from the
+    // structure instead.
+#ifndef CCEH_RALLOC
+    vmem_acct_t acct;
+    vmem_acct_snapshot(&acct);
+    for (int s = 0; s < VMEM_SITE_COUNT; ++s) st.pm_bytes += acct.bytes[s];
+#else
+    st.pm_bytes =
+        num_segments_.load(std::memory_order_relaxed) * sizeof(Segment) +
+        dir->capacity * sizeof(Segment *);
+#endif
+    return st;
+  }
   bool find(const char *key, size_t key_sz, char *value_out, unsigned tid)
   {
     Key_t k = *reinterpret_cast<const Key_t *>(key);
     auto r = Get(k);
+    if (inline_value_sz_ && r != NONE)
+      memcpy(value_out, &r, inline_value_sz_);
     return r;
   }
 
+  /// Software-pipelined batch lookup; see CCEH_MSB.cpp.
+  uint64_t find_batch(const char *const *keys, size_t key_sz, uint64_t count,
+                      char *values_out, size_t value_stride, unsigned tid);
+
   bool insert(const char *key, size_t key_sz, const char *value,
               size_t value_sz, unsigned tid, unsigned t)
   {
     Key_t k = *reinterpret_cast<const Key_t *>(key);
-    Insert(k, value);
+    Insert(k, wrap_value(value, value_sz));
     return true;
   }
+  // keep the 6-arg base overload visible next to the local 4-arg one
+  // (the static-dispatch harness calls the former by name)
+  using hash_api::insertResize;
   bool insertResize(const char *key, size_t key_sz, const char *value,
                     size_t value_sz)
   {
     Key_t k = *reinterpret_cast<const Key_t *>(key);
-    return Insert(k, value);
+    return Insert(k, wrap_value(value, value_sz));
   }
+  // Pre-sizes the directory for 'count' and streams pairs into their
+  // buckets with non-temporal stores; assumes a freshly created table.
+  void bulk_load(const char *keys, const char *values, size_t key_sz,
+                 size_t value_sz, uint64_t count, unsigned tid);
   bool update(const char *key, size_t key_sz, const char *value,
               size_t value_sz)
   {
     return true;
   }
 
+  bool upsert(const char *key, size_t key_sz, const char *value,
+              size_t value_sz, unsigned tid, unsigned t)
+  {
+    Key_t k = *reinterpret_cast<const Key_t *>(key);
+    return Upsert(k, wrap_value(value, value_sz));
+  }
+
   bool remove(const char *key, size_t key_sz, unsigned tid)
   {
     Key_t k = *reinterpret_cast<const Key_t *>(key);
@@ -162,8 +310,67 @@ public:
   }
 
 private:
+  /// In-slot mode: copies the value bytes into the slot word itself, so
+  /// a hit needs no dependent read; out-of-line mode stores the caller's
+  /// pointer unchanged. Common value sizes go through the fixed-width
+  /// copier picked at create_tree time (see pair.h) instead of a
+  /// runtime-length memcpy per operation.
+  Value_t wrap_value(const char *value, size_t value_sz)
+  {
+    if (inline_value_sz_ == 0) return value;
+    if (wrap_fn_) return wrap_fn_(value);
+    uint64_t v = 0;
+    memcpy(&v, value, value_sz < sizeof(v) ? value_sz : sizeof(v));
+    return reinterpret_cast<Value_t>(v);
+  }
+
+  /// Non-zero when values are stored in-slot (set through
+  /// set_inline_value_size by create_tree).
+  size_t inline_value_sz_ = 0;
+  /// Constant-size in-slot copier, or nullptr for the generic path.
+  Value_t (*wrap_fn_)(const char *) = nullptr;
+
+  /// Swings the directory over to the two halves of a split (normal
+  /// split or directory doubling). Shared by the insert path and the
+  /// background pre-splitter.
+  void UpdateDirectory(Segment **, size_t);
+
+  /// Replaces the empty-segment template behind directory entry x with
+  /// a freshly allocated segment (copy-on-first-write). Returns the
+  /// materialized segment, or nullptr when the directory swung over
+  /// mid-way and the caller must retry against the published one.
+  Segment *Materialize(Directory *, size_t);
+
+  /// Shared immutable empty segment every fresh directory entry points
+  /// at. Reads probe it and miss (all slots INVALID); the first write
+  /// to an entry materializes a real segment, so creating a pre-sized
+  /// table costs O(directory) instead of allocating and zeroing every
+  /// segment up front.
+  Segment *empty_seg_ = nullptr;
+
+  /// local_depth/pattern the lazily materialized segments are born
+  /// with: the directory depth at creation (or bulk_load pre-size)
+  /// time. Doubling only duplicates entries, so template entries always
+  /// stand for segments of exactly this depth.
+  size_t lazy_depth_ = 0;
+
+  /// Background pre-splitter: periodically walks the directory and
+  /// splits segments past the fill watermark off the critical path, so
+  /// foreground inserts rarely pay the split cost themselves.
+  void PreSplitLoop(void);
+
   size_t global_depth;
   Directory *dir;
+  std::thread presplit_thread_;
+  std::atomic<bool> presplit_stop_{false};
+
+  /// Striped item/probe counters maintained on the operation path;
+  /// Insert/Delete/Get feed them so stats() needs no table walk.
+  table_stats tstats_;
+  /// Live segment count: seeded by the constructors and bumped once per
+  /// completed split, so capacity can be derived without touching the
+  /// directory.
+  std::atomic<uint64_t> num_segments_{0};
 };
 
 #endif // EXTENDIBLE_PTR_H_
@@ -1,5 +1,8 @@
+#include <immintrin.h>
+
 #include <bitset>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <iostream>
 #include <thread>
@@ -12,15 +15,31 @@
 extern size_t perfCounter;
 extern "C" hash_api *create_tree(const tree_options_t &opt, unsigned sz,
                                  unsigned tnum) {
+  if (!opt.hash_fn.empty() && !hash_select(opt.hash_fn.c_str()))
+    std::cout << "unknown hash_fn: " << opt.hash_fn << std::endl;
   if (sz)
     sz = sz / Segment::kNumSlot;
   else
     sz = 65536;
-  return new CCEH(sz >= 2 ? sz : 2);
+  auto api = new CCEH(sz >= 2 ? sz : 2);
+  if (opt.value_size <= api->max_inline_value_size())
+    api->set_inline_value_size(opt.value_size);
+  return api;
 }
 int Segment::Insert(Key_t &key, Value_t value, size_t loc, size_t key_hash) {
 #ifdef INPLACE
-  if ((volatile int64_t)sema == -1) return 3;
+  if ((volatile int64_t)sema == -1) {
+    // Mid-split. Keys destined for the already-published sibling need
+    // not wait for the copy to finish; everyone else retries.
+    Segment *fwd = forward_;
+    if (fwd != nullptr &&
+        (key_hash & ((size_t)1
+                     << (8 * sizeof(key_hash) - fwd->local_depth)))) {
+      auto r = fwd->Insert(key, value, loc, key_hash);
+      if (r == 0 || r == -1) return r;
+    }
+    return 3;
+  }
   if ((key_hash >> (8 * sizeof(key_hash) - local_depth)) != pattern) return 2;
   auto lock = sema;
   int ret = 1;
@@ -50,6 +69,7 @@ int Segment::Insert(Key_t &key, Value_t value, size_t loc, size_t key_hash) {
       _[slot].value = value;
       mfence();
       _[slot].key = key;
+      fp_[slot] = fp_of(key_hash);
       ret = 0;
       break;
     } else {
@@ -76,6 +96,7 @@ int Segment::Insert(Key_t &key, Value_t value, size_t loc, size_t key_hash) {
       _[slot].value = value;
       mfence();
       _[slot].key = key;
+      fp_[slot] = fp_of(key_hash);
       ret = 0;
       break;
     } else {
@@ -90,17 +111,117 @@ int Segment::Insert(Key_t &key, Value_t value, size_t loc, size_t key_hash) {
 #endif
 }
 
+// Overwrites the value of an existing key in place under the segment
+// sema, following the same mid-split / pattern discipline as Insert.
+// Returns 0 on success, 1 when the key is not in this segment, 2 on a
+// pattern mismatch (stale directory entry) and 3 when mid-split and not
+// forwardable.
+int Segment::Update(Key_t &key, Value_t value, size_t loc, size_t key_hash) {
+#ifdef INPLACE
+  if ((volatile int64_t)sema == -1) {
+    Segment *fwd = forward_;
+    if (fwd != nullptr &&
+        (key_hash & ((size_t)1
+                     << (8 * sizeof(key_hash) - fwd->local_depth)))) {
+      auto r = fwd->Update(key, value, loc, key_hash);
+      if (r == 0 || r == 1) return r;
+    }
+    return 3;
+  }
+#else
+  if (sema == -1) return 2;
+#endif
+  if ((key_hash >> (8 * sizeof(key_hash) - local_depth)) != pattern) return 2;
+  auto lock = sema;
+  int ret = 1;
+  while (!CAS(&sema, &lock, lock + 1)) {
+    lock = sema;
+  }
+  for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
+    auto slot = (loc + i) % Segment::kNumSlot;
+    if (_[slot].key == key) {
+      _[slot].value = value;
+      mfence();
+      ret = 0;
+      break;
+    }
+  }
+  lock = sema;
+  while (!CAS(&sema, &lock, lock - 1)) {
+    lock = sema;
+  }
+  return ret;
+}
+
 void Segment::Insert4split(Key_t &key, Value_t value, size_t loc) {
   for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
     auto slot = (loc + i) % kNumSlot;
-    if (_[slot].key == INVALID) {
-      _[slot].key = key;
+    // Claim with CAS: during a split, forwarded writers insert into
+    // this segment concurrently with the copy loop.
+    Key_t LOCK = INVALID;
+    if (CAS(&_[slot].key, &LOCK, SENTINEL)) {
       _[slot].value = value;
+      _[slot].key = key;
+      fp_[slot] = fp_of(h(&key, sizeof(Key_t)));
       return;
     }
   }
 }
 
+// Hashes every slot and computes its destination half in one pass.
+// Placement needs only one extra hash bit, so the bit test runs four
+// hashes per AVX2 compare instead of branching per slot; both split
+// flavors consume the arrays.
+void Segment::Mask4split(size_t *hashes, uint8_t *to_hi) {
+  for (unsigned i = 0; i < kNumSlot; ++i)
+    hashes[i] = h(&_[i].key, sizeof(Key_t));
+
+  const __m256i bit = _mm256_set1_epi64x(
+      (long long)1 << (8 * sizeof(Key_t) - local_depth - 1));
+  const __m256i zero = _mm256_setzero_si256();
+  for (unsigned i = 0; i < kNumSlot; i += 4) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)&hashes[i]);
+    __m256i stay = _mm256_cmpeq_epi64(_mm256_and_si256(v, bit), zero);
+    unsigned mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(stay)) & 0xF;
+    to_hi[i] = mask & 1;
+    to_hi[i + 1] = (mask >> 1) & 1;
+    to_hi[i + 2] = (mask >> 2) & 1;
+    to_hi[i + 3] = (mask >> 3) & 1;
+  }
+}
+
+// Batched redistribution for the private (non-INPLACE) split path.
+// Pairs reach the halves through 16-byte streaming stores — nothing
+// probes them until the directory swings, and rehash output is
+// write-once, so the pair lines never enter the cache and only the
+// fingerprint and header lines are left for the caller's flush pass.
+// Free slots come from a local occupancy bitmap: no CAS claims, no
+// reading back lines that were just streamed.
+void Segment::Scatter4split(Segment *lo, Segment *hi) {
+  size_t hashes[kNumSlot];
+  uint8_t to_hi[kNumSlot];
+  Mask4split(hashes, to_hi);
+
+  uint64_t used[2][kNumSlot / 64] = {};
+  for (unsigned i = 0; i < kNumSlot; ++i) {
+    // untouched destination slots already carry INVALID from the Pair
+    // constructor, so empty source slots need no copy at all
+    if (_[i].key == INVALID) continue;
+    Segment *d = to_hi[i] ? hi : lo;
+    uint64_t *u = used[to_hi[i]];
+    size_t loc = (hashes[i] & kMask) * kNumPairPerCacheLine;
+    for (unsigned j = 0; j < kNumPairPerCacheLine * kNumCacheLine; ++j) {
+      size_t slot = (loc + j) % kNumSlot;
+      if (u[slot / 64] & ((uint64_t)1 << (slot % 64))) continue;
+      u[slot / 64] |= (uint64_t)1 << (slot % 64);
+      _mm_stream_si128((__m128i *)&d->_[slot],
+                       _mm_load_si128((const __m128i *)&_[i]));
+      d->fp_[slot] = fp_of(hashes[i]);
+      break;
+    }
+  }
+}
+
 Segment **Segment::Split(void) {
   using namespace std;
   int64_t lock = 0;
@@ -112,11 +233,22 @@ Segment **Segment::Split(void) {
   split[1] = new Segment(local_depth + 1);
   split[1]->sema = 0;
   split[1]->local_depth = local_depth + 1;
+  // Publish the sibling before copying: writers for the new half and
+  // probes that miss here can follow forward_ instead of spinning for
+  // the whole migration. The copy loop and forwarded writers both
+  // claim slots with CAS, so they compose.
+  split[1]->pattern = (pattern << 1) + 1;
+  mfence();
+  forward_ = split[1];
+  // Masks for the whole segment come from one vector pass; the inserts
+  // keep their CAS claims because forwarded writers race the copy loop.
+  size_t hashes[kNumSlot];
+  uint8_t to_hi[kNumSlot];
+  Mask4split(hashes, to_hi);
   for (unsigned i = 0; i < kNumSlot; ++i) {
-    auto key_hash = h(&_[i].key, sizeof(Key_t));
-    if (key_hash & ((size_t)1 << ((sizeof(Key_t) * 8 - local_depth - 1)))) {
+    if (to_hi[i]) {
       split[1]->Insert4split(_[i].key, _[i].value,
-                             (key_hash & kMask) * kNumPairPerCacheLine);
+                             (hashes[i] & kMask) * kNumPairPerCacheLine);
     }
   }
 
@@ -130,36 +262,83 @@ Segment **Segment::Split(void) {
   split[0] = new Segment(local_depth + 1);
   split[1] = new Segment(local_depth + 1);
 
-  for (unsigned i = 0; i < kNumSlot; ++i) {
-    auto key_hash = h(&_[i].key, sizeof(Key_t));
-    if (key_hash & ((size_t)1 << ((sizeof(Key_t) * 8 - local_depth - 1)))) {
-      split[1]->Insert4split(_[i].key, _[i].value,
-                             (key_hash & kMask) * kNumPairPerCacheLine);
-    } else {
-      split[0]->Insert4split(_[i].key, _[i].value,
-                             (key_hash & kMask) * kNumPairPerCacheLine);
-    }
-  }
+  Scatter4split(split[0], split[1]);
 
-  clflush((char *)split[0], sizeof(Segment));
-  clflush((char *)split[1], sizeof(Segment));
+  // The pairs went out as streaming stores and are durable at the
+  // fence below; only the fingerprint and header lines of the two
+  // halves still sit in cache, and they have no persist order between
+  // them, so one batch with a single trailing fence covers both.
+  flush_batch batch;
+  batch.add(&split[0]->local_depth, sizeof(Segment) - sizeof(_));
+  batch.add(&split[1]->local_depth, sizeof(Segment) - sizeof(_));
+  batch.commit();
   return split;
 #endif
 }
 
 CCEH::CCEH(void) : dir{new Directory(0)} {
+  lazy_depth_ = dir->depth;
+  empty_seg_ = new Segment(lazy_depth_);
   for (unsigned i = 0; i < dir->capacity; ++i) {
-    dir->_[i] = new Segment(0);
-    dir->_[i]->pattern = i;
+    dir->_[i] = empty_seg_;
   }
+  num_segments_ = dir->capacity;
+  presplit_thread_ = std::thread(&CCEH::PreSplitLoop, this);
 }
 
 CCEH::CCEH(size_t initCap)
     : dir{new Directory(static_cast<size_t>(log2(initCap)))} {
+  // Pre-sized creation is O(directory): every entry points at one
+  // shared empty segment and real segments materialize on first write,
+  // so a 64M-bucket table serves its first operation without paying
+  // for zeroing gigabytes of segments.
+  lazy_depth_ = dir->depth;
+  empty_seg_ = new Segment(lazy_depth_);
   for (unsigned i = 0; i < dir->capacity; ++i) {
-    dir->_[i] = new Segment(static_cast<size_t>(log2(initCap)));
-    dir->_[i]->pattern = i;
+    dir->_[i] = empty_seg_;
+  }
+  num_segments_ = dir->capacity;
+  presplit_thread_ = std::thread(&CCEH::PreSplitLoop, this);
+}
+
+Segment *CCEH::Materialize(Directory *d, size_t x) {
+  // All duplicates of a template entry stand for one logical segment
+  // of depth lazy_depth_; install the materialized segment under the
+  // stripe locks so concurrent first-writers agree on a single copy
+  // and the migrating doubling cannot race the swing.
+  size_t stride = (size_t)1 << (d->depth - lazy_depth_);
+  size_t lo = x - (x % stride);
+  size_t s_lo = d->StripeOf(lo);
+  size_t s_hi = d->StripeOf(lo + stride - 1);
+  for (size_t ss = s_lo; ss <= s_hi; ++ss) d->AcquireStripe(ss);
+  if (d != __atomic_load_n(&dir, __ATOMIC_ACQUIRE)) {
+    for (size_t ss = s_lo; ss <= s_hi; ++ss) d->ReleaseStripe(ss);
+    return nullptr;
   }
+  Segment *seg = d->_[lo];
+  if (seg == empty_seg_) {
+    seg = new Segment(lazy_depth_);
+    seg->pattern = lo >> (d->depth - lazy_depth_);
+    clflush((char *)seg, sizeof(Segment));
+    for (size_t i = lo; i < lo + stride; ++i) d->_[i] = seg;
+    clflush((char *)&d->_[lo], sizeof(void *) * stride);
+    // Mirror into an in-flight doubling for stripes already migrated,
+    // exactly as normal splits do.
+    auto nd = __atomic_load_n(&d->next_, __ATOMIC_ACQUIRE);
+    if (nd != nullptr) {
+      bool mirrored = false;
+      for (size_t i = lo; i < lo + stride; ++i) {
+        if (!d->stripe_migrated_[d->StripeOf(i)]) continue;
+        nd->_[2 * i] = seg;
+        nd->_[2 * i + 1] = seg;
+        mirrored = true;
+      }
+      if (mirrored)
+        clflush((char *)&nd->_[2 * lo], sizeof(void *) * 2 * stride);
+    }
+  }
+  for (size_t ss = s_lo; ss <= s_hi; ++ss) d->ReleaseStripe(ss);
+  return seg;
 }
 
 void Directory::LSBUpdate(int local_depth, int global_depth, int dir_cap, int x,
@@ -189,6 +368,168 @@ void Directory::LSBUpdate(int local_depth, int global_depth, int dir_cap, int x,
   return;
 }
 
+void CCEH::UpdateDirectory(Segment **s, size_t key_hash) {
+RETRY:
+  auto d = __atomic_load_n(&dir, __ATOMIC_ACQUIRE);
+  auto x = (key_hash >> (8 * sizeof(key_hash) - d->depth));
+#ifdef INPLACE
+  if (d->_[x]->local_depth - 1 < d->depth) {  // normal split
+#else
+  if (d->_[x]->local_depth < d->depth) {  // normal split
+#endif
+    // A normal split rewrites one aligned chunk of entries; lock only
+    // the stripes that chunk touches, so splits of unrelated segments
+    // — and the stripe-by-stripe doubling below — run concurrently.
+    unsigned depth_diff = d->depth - s[0]->local_depth;
+    size_t chunk_size = (size_t)1 << (depth_diff + 1);
+    size_t lo = x - (x % chunk_size);
+    size_t s_lo = d->StripeOf(lo);
+    size_t s_hi = d->StripeOf(lo + chunk_size - 1);
+    for (size_t ss = s_lo; ss <= s_hi; ++ss) d->AcquireStripe(ss);
+    if (d != __atomic_load_n(&dir, __ATOMIC_ACQUIRE)) {
+      // The directory doubled and swung over while we were locking;
+      // redo the update against the published one.
+      for (size_t ss = s_lo; ss <= s_hi; ++ss) d->ReleaseStripe(ss);
+      goto RETRY;
+    }
+    if (depth_diff == 0) {
+      if (x % 2 == 0) {
+        d->_[x + 1] = s[1];
+#ifdef INPLACE
+        clflush((char *)&d->_[x + 1], 8);
+#else
+        mfence();
+        d->_[x] = s[0];
+        clflush((char *)&d->_[x], 16);
+#endif
+      } else {
+        d->_[x] = s[1];
+#ifdef INPLACE
+        clflush((char *)&d->_[x], 8);
+#else
+        mfence();
+        d->_[x - 1] = s[0];
+        clflush((char *)&d->_[x - 1], 16);
+#endif
+      }
+    } else {
+      for (unsigned i = 0; i < chunk_size / 2; ++i) {
+        d->_[lo + chunk_size / 2 + i] = s[1];
+      }
+      clflush((char *)&d->_[lo + chunk_size / 2],
+              sizeof(void *) * chunk_size / 2);
+#ifndef INPLACE
+      for (unsigned i = 0; i < chunk_size / 2; ++i) {
+        d->_[lo + i] = s[0];
+      }
+      clflush((char *)&d->_[lo], sizeof(void *) * chunk_size / 2);
+#endif
+    }
+    // A doubling may be migrating concurrently. Stripes the migrator
+    // already copied will not be visited again, so mirror the freshly
+    // written entries into the doubled directory pairwise — entry
+    // duplication commutes with the split update, so the copy stays
+    // exact. Stripes not yet migrated are picked up by the copy loop
+    // itself. The swing to the new directory needs every stripe, so it
+    // cannot complete while we hold these.
+    auto nd = __atomic_load_n(&d->next_, __ATOMIC_ACQUIRE);
+    if (nd != nullptr) {
+      bool mirrored = false;
+      for (size_t i = lo; i < lo + chunk_size; ++i) {
+        if (!d->stripe_migrated_[d->StripeOf(i)]) continue;
+        nd->_[2 * i] = d->_[i];
+        nd->_[2 * i + 1] = d->_[i];
+        mirrored = true;
+      }
+      if (mirrored)
+        clflush((char *)&nd->_[2 * lo], sizeof(void *) * 2 * chunk_size);
+    }
+    for (size_t ss = s_lo; ss <= s_hi; ++ss) d->ReleaseStripe(ss);
+  } else {  // directory doubling
+    // One doubling at a time; the old global lock now serializes only
+    // doublings against each other instead of every directory update.
+    while (!d->Acquire()) {
+      if (__atomic_load_n(&dir, __ATOMIC_ACQUIRE) != d) goto RETRY;
+      asm("nop");
+    }
+    if (d != __atomic_load_n(&dir, __ATOMIC_ACQUIRE)) {
+      d->Release();
+      goto RETRY;
+    }
+    auto _dir = new Directory(d->depth + 1);
+    // Publish the doubled directory before copying so concurrent
+    // normal splits can mirror into already-migrated stripes; then
+    // migrate stripe by stripe under the stripe locks, leaving every
+    // other stripe free for splits the whole time.
+    __atomic_store_n(&d->next_, _dir, __ATOMIC_RELEASE);
+    for (size_t i = 0; i < d->capacity;) {
+      size_t ss = d->StripeOf(i);
+      size_t hi = i;
+      while (hi < d->capacity && d->StripeOf(hi) == ss) ++hi;
+      d->AcquireStripe(ss);
+      for (size_t j = i; j < hi; ++j) {
+        if (j == x) {
+          _dir->_[2 * j] = s[0];
+          _dir->_[2 * j + 1] = s[1];
+        } else {
+          _dir->_[2 * j] = d->_[j];
+          _dir->_[2 * j + 1] = d->_[j];
+        }
+      }
+      clflush((char *)&_dir->_[2 * i], sizeof(void *) * 2 * (hi - i));
+      d->stripe_migrated_[ss] = true;
+      d->ReleaseStripe(ss);
+      i = hi;
+    }
+    clflush((char *)_dir, sizeof(Directory));
+    __atomic_store_n(&dir, _dir, __ATOMIC_RELEASE);
+    clflush((char *)&dir, sizeof(void *));
+    d->Release();
+    // d (and d->next_) stay allocated: readers and writers holding a
+    // stale snapshot keep using them, and stale writers follow next_.
+  }
+#ifdef INPLACE
+  s[0]->forward_ = nullptr;
+  s[0]->sema = 0;
+#endif
+  // One split completed, whichever directory path it took.
+  num_segments_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CCEH::PreSplitLoop(void) {
+  // Segments split once a probe window fills, which in practice happens
+  // around 70% occupancy; splitting a bit below that keeps the split
+  // out of the foreground insert without wasting much space.
+  const size_t watermark = Segment::kNumSlot * 6 / 10;
+  while (!presplit_stop_.load(std::memory_order_relaxed)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    auto d = dir;  // snapshot; doubling swaps the pointer
+    for (size_t x = 0; x < d->capacity && d == dir; ++x) {
+      if (presplit_stop_.load(std::memory_order_relaxed)) return;
+      auto target = d->_[x];
+      // Duplicate pointers for shallow segments are contiguous in the
+      // MSB layout; only visit the first occurrence.
+      if (x > 0 && target == d->_[x - 1]) continue;
+      // Never-written template entries have nothing to split.
+      if (target == empty_seg_) continue;
+      if (target->sema != 0) continue;
+      if (target->numElem() < watermark) continue;
+
+      // Any hash whose top bits select this slot stands in for a key.
+      size_t key_hash = x << (8 * sizeof(size_t) - d->depth);
+      Segment **s = target->Split();
+      if (s == nullptr) continue;
+
+      s[0]->pattern =
+          (key_hash >> (8 * sizeof(key_hash) - s[0]->local_depth + 1)) << 1;
+      s[1]->pattern =
+          ((key_hash >> (8 * sizeof(key_hash) - s[1]->local_depth + 1)) << 1) +
+          1;
+      UpdateDirectory(s, key_hash);
+    }
+  }
+}
+
 bool CCEH::Insert(Key_t &key, Value_t value) {
   bool resized = false;
 STARTOVER:
@@ -196,8 +537,13 @@ STARTOVER:
   auto y = (key_hash & kMask) * kNumPairPerCacheLine;
 
 RETRY:
-  auto x = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
-  auto target = dir->_[x];
+  auto d = __atomic_load_n(&dir, __ATOMIC_ACQUIRE);
+  auto x = (key_hash >> (8 * sizeof(key_hash) - d->depth));
+  auto target = d->_[x];
+  if (target == empty_seg_) {
+    target = Materialize(d, x);
+    if (target == nullptr) goto RETRY;
+  }
   auto ret = target->Insert(key, value, y, key_hash);
 
   if (ret == 1) {
@@ -214,109 +560,141 @@ RETRY:
     s[1]->pattern =
         ((key_hash >> (8 * sizeof(key_hash) - s[1]->local_depth + 1)) << 1) + 1;
 
-    // Directory management
-    while (!dir->Acquire()) {
-      asm("nop");
-    }
-    {  // CRITICAL SECTION - directory update
-      x = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
-#ifdef INPLACE
-      if (dir->_[x]->local_depth - 1 < dir->depth) {  // normal split
-#else
-      if (dir->_[x]->local_depth < dir->depth) {  // normal split
-#endif
-        unsigned depth_diff = dir->depth - s[0]->local_depth;
-        if (depth_diff == 0) {
-          if (x % 2 == 0) {
-            dir->_[x + 1] = s[1];
-#ifdef INPLACE
-            clflush((char *)&dir->_[x + 1], 8);
-#else
-            mfence();
-            dir->_[x] = s[0];
-            clflush((char *)&dir->_[x], 16);
-#endif
-          } else {
-            dir->_[x] = s[1];
-#ifdef INPLACE
-            clflush((char *)&dir->_[x], 8);
-#else
-            mfence();
-            dir->_[x - 1] = s[0];
-            clflush((char *)&dir->_[x - 1], 16);
-#endif
-          }
-        } else {
-          int chunk_size = pow(2, dir->depth - (s[0]->local_depth - 1));
-          x = x - (x % chunk_size);
-          for (unsigned i = 0; i < chunk_size / 2; ++i) {
-            dir->_[x + chunk_size / 2 + i] = s[1];
-          }
-          clflush((char *)&dir->_[x + chunk_size / 2],
-                  sizeof(void *) * chunk_size / 2);
-#ifndef INPLACE
-          for (unsigned i = 0; i < chunk_size / 2; ++i) {
-            dir->_[x + i] = s[0];
-          }
-          clflush((char *)&dir->_[x], sizeof(void *) * chunk_size / 2);
-#endif
-        }
-        while (!dir->Release()) {
-          asm("nop");
-        }
-      } else {  // directory doubling
-        resized = true;
-        auto dir_old = dir;
-        auto d = dir->_;
-        // auto _dir = new Segment*[dir->capacity*2];
-        auto _dir = new Directory(dir->depth + 1);
-        for (unsigned i = 0; i < dir->capacity; ++i) {
-          if (i == x) {
-            _dir->_[2 * i] = s[0];
-            _dir->_[2 * i + 1] = s[1];
-          } else {
-            _dir->_[2 * i] = d[i];
-            _dir->_[2 * i + 1] = d[i];
-          }
-        }
-        clflush((char *)&_dir->_[0], sizeof(Segment *) * _dir->capacity);
-        clflush((char *)&_dir, sizeof(Directory));
-        dir = _dir;
-        clflush((char *)&dir, sizeof(void *));
-        // vmem_free(vmp, dir_old);
-      }
-#ifdef INPLACE
-      s[0]->sema = 0;
-#endif
-    }  // End of critical section
+    UpdateDirectory(s, key_hash);
     // std::cout << 2 << std::endl;
     goto RETRY;
   } else if (ret == 2) {
     // std::cout << 3 << std::endl;
     goto STARTOVER;
+  } else if (ret == 3) {
+    // Segment is mid-split and the key was not forwardable; previously
+    // this fell through as a silent success and the record was lost.
+    CPUPause();
+    goto RETRY;
   } else if (ret == -1) {
     ;
   } else {
-    clflush((char *)&dir->_[x]->_[y], 64);
+    clflush((char *)&target->_[y], 64);
+    // Only a genuinely new record lands here (duplicates return -1).
+    tstats_.record_insert();
   }
   return resized;
 }
 
+// Single-probe upsert: the hit path overwrites the value inside the
+// target segment without a preceding Get; only an absent key falls
+// through to the regular insert path.
+bool CCEH::Upsert(Key_t &key, Value_t value) {
+  auto key_hash = h(&key, sizeof(key));
+  auto y = (key_hash & kMask) * kNumPairPerCacheLine;
+
+RETRY:
+  auto x = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
+  auto target = dir->_[x];
+  if (target == empty_seg_) {
+    // Nothing stored yet behind this entry: the key is absent, take
+    // the insert path (which materializes the segment).
+    Insert(key, value);
+    return true;
+  }
+  auto ret = target->Update(key, value, y, key_hash);
+
+  if (ret == 0) {
+    clflush((char *)&target->_[y], 64);
+    return true;
+  } else if (ret == 2) {
+    // Stale directory entry (pattern mismatch); re-read the directory.
+    goto RETRY;
+  } else if (ret == 3) {
+    CPUPause();
+    goto RETRY;
+  }
+  // Key absent: take the insert path (which handles splits itself).
+  Insert(key, value);
+  return true;
+}
+
 // This function does not allow resizing
 bool CCEH::InsertOnly(Key_t &key, Value_t value) {
   auto key_hash = h(&key, sizeof(key));
-  auto x = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
+  auto d = __atomic_load_n(&dir, __ATOMIC_ACQUIRE);
+  auto x = (key_hash >> (8 * sizeof(key_hash) - d->depth));
   auto y = (key_hash & kMask) * kNumPairPerCacheLine;
 
-  auto ret = dir->_[x]->Insert(key, value, y, key_hash);
+  auto target = d->_[x];
+  if (target == empty_seg_) {
+    target = Materialize(d, x);
+    if (target == nullptr) return false;
+  }
+  auto ret = target->Insert(key, value, y, key_hash);
   if (ret == 0) {
-    clflush((char *)&dir->_[x]->_[y], 64);
+    clflush((char *)&target->_[y], 64);
     return true;
   }
 
   return false;
 }
 
+void CCEH::bulk_load(const char *keys, const char *values, size_t key_sz,
+                     size_t value_sz, uint64_t count, unsigned tid) {
+  // Grow the directory up front so the load never splits: target
+  // half-full segments, matching what the insert path converges to.
+  // Only ever grows, and assumes a freshly created table — segments
+  // already holding data are dropped by the rebuild.
+  size_t target_segs = count / (Segment::kNumSlot / 2) + 1;
+  auto depth = static_cast<size_t>(ceil(log2(target_segs)));
+  if (depth > dir->depth) {
+    dir = new Directory(depth);
+    // Template entries again: only the segments the load actually
+    // touches get materialized, so pre-sizing for a skewed or partial
+    // load does not pay for the segments that stay empty.
+    lazy_depth_ = depth;
+    empty_seg_->local_depth = depth;
+    for (unsigned i = 0; i < dir->capacity; ++i) {
+      dir->_[i] = empty_seg_;
+    }
+    clflush((char *)dir, sizeof(Directory));
+    num_segments_ = dir->capacity;
+  }
+  for (uint64_t i = 0; i < count; ++i) {
+    Key_t k = *reinterpret_cast<const Key_t *>(keys + i * key_sz);
+    auto value = static_cast<Value_t>(values + i * value_sz);
+    auto key_hash = h(&k, sizeof(k));
+    auto x = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
+    auto y = (key_hash & kMask) * kNumPairPerCacheLine;
+    auto target = dir->_[x];
+    if (target == empty_seg_) {
+      target = Materialize(dir, x);
+      if (target == nullptr) {
+        sfence();
+        Insert(k, value);
+        continue;
+      }
+    }
+    bool done = false;
+    for (unsigned j = 0; j < kNumPairPerCacheLine * kNumCacheLine; ++j) {
+      auto slot = (y + j) % Segment::kNumSlot;
+      if (target->_[slot].key == INVALID) {
+        // The bucket line is written once and never re-read during the
+        // load, so stream the pair past the cache; one fence at the end
+        // replaces the per-record flush.
+        ntstore_u64(&target->_[slot].value, (uint64_t)value);
+        ntstore_u64(&target->_[slot].key, (uint64_t)k);
+        target->fp_[slot] = Segment::fp_of(key_hash);
+        tstats_.record_insert();
+        done = true;
+        break;
+      }
+    }
+    // Overfull probe window: fall back to the regular path (may split).
+    if (!done) {
+      sfence();  // drain pending streaming stores first
+      Insert(k, value);
+    }
+  }
+  sfence();
+}
+
 bool CCEH::Delete(Key_t &key) {
   auto key_hash = h(&key, sizeof(key));
   auto x = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
@@ -324,6 +702,10 @@ bool CCEH::Delete(Key_t &key) {
 
   auto dir_ = dir->_[x];
 
+  // Never-written entry: nothing to delete, and the shared template
+  // must stay untouched (even its sema).
+  if (dir_ == empty_seg_) return NONE;
+
 #ifdef INPLACE
   auto sema = dir->_[x]->sema;
   while (!CAS(&dir->_[x]->sema, &sema, sema + 1)) {
@@ -335,6 +717,8 @@ bool CCEH::Delete(Key_t &key) {
     auto slot = (y + i) % Segment::kNumSlot;
     if (dir_->_[slot].key == key) {
       dir_->_[slot].key = INVALID;
+      dir_->fp_[slot] = 0;
+      tstats_.record_remove();
       break;
     }
   }
@@ -351,40 +735,109 @@ bool CCEH::Delete(Key_t &key) {
 
 Value_t CCEH::Get(Key_t &key) {
   auto key_hash = h(&key, sizeof(key));
-  auto x = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
   auto y = (key_hash & kMask) * kNumPairPerCacheLine;
 
-  auto dir_ = dir->_[x];
-
-#ifdef INPLACE
-  auto sema = dir_->sema;
-  while (!CAS(&dir_->sema, &sema, sema + 1)) {
-    sema = dir_->sema;
+RETRY:
+  // Optimistic lock-free read: one acquire load of the directory
+  // pointer, and every derived access (depth, segment array) goes
+  // through that snapshot, so a concurrent doubling cannot mix old and
+  // new views. Old directories and pre-split segments are never
+  // reclaimed (see UpdateDirectory), so a stale snapshot stays
+  // readable; readers pay no sema traffic at all and only retry when a
+  // miss coincides with a split or doubling that could have moved the
+  // key.
+  auto d = __atomic_load_n(&dir, __ATOMIC_ACQUIRE);
+  auto x = (key_hash >> (8 * sizeof(key_hash) - d->depth));
+  auto dir_ = d->_[x];
+  auto depth_before = dir_->local_depth;
+
+  // Fingerprint filter: one 16-byte compare over the probe window
+  // decides which slots can hold the key before any pair line is
+  // loaded, so a negative lookup usually costs the fingerprint line
+  // instead of four pair lines.
+  unsigned match = 0xFFFF;
+  if (y + kNumPairPerCacheLine * kNumCacheLine <= Segment::kNumSlot) {
+    __m128i fps = _mm_loadu_si128((const __m128i *)&dir_->fp_[y]);
+    __m128i want = _mm_set1_epi8((char)Segment::fp_of(key_hash));
+    __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(fps, want),
+                               _mm_cmpeq_epi8(fps, _mm_setzero_si128()));
+    match = _mm_movemask_epi8(hit);
   }
-#endif
-
   for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
+    if (!(match & (1u << i))) continue;
     auto slot = (y + i) % Segment::kNumSlot;
     if (dir_->_[slot].key == key) {
-#ifdef INPLACE
-      sema = dir_->sema;
-      while (!CAS(&dir_->sema, &sema, sema - 1)) {
-        sema = dir_->sema;
-      }
-#endif
+      // Probe length in cache lines touched within the window.
+      tstats_.record_probe(i / kNumPairPerCacheLine + 1);
       return dir_->_[slot].value;
     }
   }
 
-#ifdef INPLACE
-  sema = dir_->sema;
-  while (!CAS(&dir_->sema, &sema, sema - 1)) {
-    sema = dir_->sema;
+  // Mid-split, records forwarded to the sibling live only there until
+  // the directory swings over; probe it before declaring a miss.
+  auto fwd = dir_->forward_;
+  if (fwd != nullptr) {
+    for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
+      auto slot = (y + i) % Segment::kNumSlot;
+      if (fwd->_[slot].key == key) {
+        // Forwarded hits pay the whole window plus the sibling walk.
+        tstats_.record_probe(kNumCacheLine + 1);
+        return fwd->_[slot].value;
+      }
+    }
   }
-#endif
+
+  // Validate the miss: only a split of this segment or a directory
+  // swap could have moved the key out from under the probe.
+  if (d != dir || d->_[x] != dir_ || dir_->local_depth != depth_before) {
+    goto RETRY;
+  }
+  // Misses land in the last histogram bin.
+  tstats_.record_probe(table_stats::kProbeBuckets - 1);
   return NONE;
 }
 
+/* Software-pipelined batch lookup. Pass one hashes every key in the
+ * window and prefetches its directory entry; pass two chases the entry
+ * and prefetches the fingerprint line and the head of the probe window;
+ * pass three completes the probes in order through Get, so the retry
+ * and forwarding logic is reused on warm lines. With the window's
+ * streams independent, their demand misses overlap instead of
+ * serializing one 300ns probe behind another. */
+uint64_t CCEH::find_batch(const char *const *keys, size_t key_sz,
+                          uint64_t count, char *values_out,
+                          size_t value_stride, unsigned tid) {
+  constexpr uint64_t W = 16;
+  Key_t ks[W];
+  size_t hs[W];
+  uint64_t found = 0;
+  for (uint64_t base = 0; base < count; base += W) {
+    uint64_t lim = std::min(W, count - base);
+    auto d = __atomic_load_n(&dir, __ATOMIC_ACQUIRE);
+    for (uint64_t i = 0; i < lim; ++i) {
+      ks[i] = *reinterpret_cast<const Key_t *>(keys[base + i]);
+      hs[i] = h(&ks[i], sizeof(ks[i]));
+      auto x = hs[i] >> (8 * sizeof(size_t) - d->depth);
+      __builtin_prefetch(&d->_[x]);
+    }
+    for (uint64_t i = 0; i < lim; ++i) {
+      auto x = hs[i] >> (8 * sizeof(size_t) - d->depth);
+      auto seg = d->_[x];
+      auto y = (hs[i] & kMask) * kNumPairPerCacheLine;
+      __builtin_prefetch(&seg->fp_[y]);
+      __builtin_prefetch(&seg->_[y]);
+    }
+    for (uint64_t i = 0; i < lim; ++i) {
+      auto r = Get(ks[i]);
+      if (r == NONE) continue;
+      found++;
+      if (inline_value_sz_)
+        memcpy(values_out + (base + i) * value_stride, &r, inline_value_sz_);
+    }
+  }
+  return found;
+}
+
 hash_Utilization CCEH::Utilization(void) {
   size_t sum = 0;
   std::unordered_map<Segment *, bool> set;
@@ -434,22 +887,78 @@ size_t Segment::numElem(void) {
 }
 
 bool CCEH::Recovery(void) {
-  bool recovered = false;
-  size_t i = 0;
-  while (i < dir->capacity) {
-    size_t depth_cur = dir->_[i]->local_depth;
-    size_t stride = pow(2, dir->depth - depth_cur);
-    size_t buddy = i + stride;
-    if (buddy == dir->capacity) break;
-    for (int j = buddy - 1; i < j; j--) {
-      if (dir->_[j]->local_depth != depth_cur) {
-        dir->_[j] = dir->_[i];
-      }
+  // Parallel directory repair. The sequential scan walks spans whose
+  // width depends on the entries themselves, so ranges cannot simply be
+  // cut anywhere: a stale entry mid-span would fool a thread into
+  // treating it as a span start. Two phases instead: a read-only pass
+  // finds the coarsest span width in the directory, and since spans are
+  // power-of-two sized and aligned they never cross a boundary aligned
+  // to that width — blocks at that alignment can then be repaired
+  // independently, replaying the sequential algorithm exactly.
+  auto d = dir;
+  unsigned nthreads = std::thread::hardware_concurrency();
+  if (nthreads == 0) nthreads = 1;
+
+  // Phase 1: coarsest span = smallest local_depth anywhere (stale
+  // entries included — they are exactly the ones with shallow depths).
+  std::atomic<size_t> min_depth{d->depth};
+  {
+    size_t chunk = (d->capacity + nthreads - 1) / nthreads;
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < nthreads; ++t) {
+      pool.emplace_back([&, t]() {
+        size_t lo = (size_t)t * chunk;
+        size_t hi = std::min(lo + chunk, d->capacity);
+        size_t local = d->depth;
+        for (size_t i = lo; i < hi; ++i)
+          local = std::min(local, d->_[i]->local_depth);
+        size_t cur = min_depth.load(std::memory_order_relaxed);
+        while (local < cur &&
+               !min_depth.compare_exchange_weak(cur, local)) {
+        }
+      });
     }
-    i = i + stride;
+    for (auto &th : pool) th.join();
   }
+
+  // Phase 2: hand out aligned blocks of the coarsest width and repair
+  // each concurrently; repairs of different blocks touch disjoint
+  // entries, so the threads need no synchronization beyond the join.
+  size_t max_stride = (size_t)1 << (d->depth - min_depth.load());
+  size_t nblocks = d->capacity / max_stride;
+  if (nthreads > nblocks) nthreads = nblocks ? nblocks : 1;
+  std::atomic<size_t> repaired{0};
+  {
+    size_t blk_chunk = (nblocks + nthreads - 1) / nthreads;
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < nthreads; ++t) {
+      pool.emplace_back([&, t]() {
+        size_t lo = (size_t)t * blk_chunk * max_stride;
+        size_t hi = std::min(lo + blk_chunk * max_stride, d->capacity);
+        size_t local = 0;
+        size_t i = lo;
+        while (i < hi) {
+          size_t depth_cur = d->_[i]->local_depth;
+          size_t stride = (size_t)1 << (d->depth - depth_cur);
+          size_t buddy = i + stride;
+          if (buddy == d->capacity) break;
+          for (size_t j = buddy - 1; i < j; --j) {
+            if (d->_[j]->local_depth != depth_cur) {
+              d->_[j] = d->_[i];
+              ++local;
+            }
+          }
+          i = i + stride;
+        }
+        if (local) repaired.fetch_add(local, std::memory_order_relaxed);
+      });
+    }
+    for (auto &th : pool) th.join();
+  }
+
+  bool recovered = repaired.load() != 0;
   if (recovered) {
-    clflush((char *)&dir->_[0], sizeof(void *) * dir->capacity);
+    clflush((char *)&d->_[0], sizeof(void *) * d->capacity);
   }
   return recovered;
 }
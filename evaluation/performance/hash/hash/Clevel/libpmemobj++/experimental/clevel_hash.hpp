@@ -43,6 +43,7 @@
 #include <fstream>
 #include <immintrin.h>
 #include "../../../common/hash.h"
+#include "../../../common/resize_governor.h"
 #if _MSC_VER
 #include <intrin.h>
 #include <windows.h>
@@ -276,7 +277,7 @@ namespace pmem
 				}
 
 				clevel_hash() : meta(make_persistent<level_meta>().raw().off),
-								thread_num(0)
+								thread_num(0), kv_batch(1)
 				{
 					std::cout << "clevel_hash constructor: HashPower = "
 							  << HashPower << std::endl;
@@ -284,6 +285,9 @@ foo();
 					assert(HashPower > 0);
 					hashpower.get_rw() = HashPower;
 
+					for (int k = 0; k < summary_slots; k++)
+						summaries_[k] = nullptr;
+
 					std::cout << "hashpower : " << hashpower << std::endl;
 
 					// setup pool
@@ -338,6 +342,51 @@ foo();
 						pop, KV_ptr, std::move(*const_cast<value_type *>(v)));
 				}
 
+				/* Carves the next KV record out of the calling thread's slab,
+				 * allocating a fresh slab of kv_batch records in a single
+				 * transaction when the current one is exhausted, so the
+				 * transaction setup/teardown is paid once per kv_batch
+				 * inserts. The record itself is published with one
+				 * fence-bounded persist instead of a per-insert transaction.
+				 * Records are copied in (the harness only stores trivially
+				 * copyable pairs). */
+				persistent_ptr<value_type>
+				slab_allocate_KV(pool_base &pop, difference_type t_id,
+								 const void *param)
+				{
+					KV_slab &slab = kv_slabs[static_cast<size_type>(t_id)];
+					size_type batch = kv_batch.get_ro();
+					if (slab.chunk == nullptr || slab.next == batch)
+					{
+						transaction::manual tx(pop);
+						slab.chunk = make_persistent<value_type[]>(batch);
+						transaction::commit();
+						slab.next = 0;
+					}
+					value_type *slot =
+						&slab.chunk[static_cast<difference_type>(slab.next)];
+					/* value_type carries a const key, so the slot (default
+					 * constructed with the slab) is overwritten in place. */
+					new (slot) value_type(*static_cast<const value_type *>(param));
+					pop.persist(slot, sizeof(value_type));
+					++slab.next;
+					return persistent_ptr<value_type>(pmemobj_oid(slot));
+				}
+
+				/* Returns the most recently carved record (duplicate insert
+				 * or lost update race); the slot is reused by the next
+				 * allocation instead of being freed individually. */
+				void
+				slab_unallocate_KV(difference_type t_id)
+				{
+					KV_slab &slab = kv_slabs[static_cast<size_type>(t_id)];
+					if (slab.next > 0 &&
+						tmp_entry[t_id].get() ==
+							&slab.chunk[static_cast<difference_type>(slab.next -
+																	 1)])
+						--slab.next;
+				}
+
 				ret
 				insert(const value_type &value, size_type thread_id, size_type id)
 				{
@@ -392,6 +441,19 @@ foo();
 				{
 					run_expand_thread.get_rw().store(false);
 					expand_thread.join();
+					for (int k = 0; k < summary_slots; k++)
+					{
+						if (summaries_[k] != nullptr)
+						{
+							delete[] summaries_[k]->words;
+							delete summaries_[k];
+						}
+					}
+					for (size_t k = 0; k < summary_retired_.size(); k++)
+					{
+						delete[] summary_retired_[k]->words;
+						delete summary_retired_[k];
+					}
 					clear();
 				}
 
@@ -460,7 +522,7 @@ foo();
 								delete_persistent<level_meta>(tmp_meta[di]);
 							if (tmp_level[di] != nullptr)
 								delete_persistent<level_bucket>(tmp_level[di]);
-							if (tmp_entry[di] != nullptr)
+							if (kv_batch.get_ro() < 2 && tmp_entry[di] != nullptr)
 								delete_persistent<value_type>(tmp_entry[di]);
 						}
 						delete_persistent<persistent_ptr<level_meta>[]>(
@@ -491,6 +553,21 @@ foo();
 					tmp_level =
 						make_persistent<persistent_ptr<level_bucket>[]>(thread_num);
 					tmp_entry = make_persistent<persistent_ptr<value_type>[]>(thread_num);
+
+					kv_slabs.assign(thread_num, KV_slab());
+				}
+
+				/**
+	 * Set the number of inserts whose KV records are carved out of one
+	 * transactional slab allocation. With num == 1 (the default) every
+	 * insert allocates through the per-operation transaction as before;
+	 * larger values amortize the transaction setup/teardown across the
+	 * batch and publish each record with a single fence-bounded flush.
+	 */
+				void
+				set_kv_batch(size_type num)
+				{
+					kv_batch = (num < 1) ? 1 : num;
 				}
 
 				// Only for debug use!
@@ -532,6 +609,121 @@ foo();
 				persistent_ptr<persistent_ptr<level_bucket>[]> tmp_level;
 				persistent_ptr<persistent_ptr<value_type>[]> tmp_entry;
 
+				/* Batched commit mode (see set_kv_batch()): per-thread slabs
+				 * of KV records allocated kv_batch at a time. Cursors are
+				 * volatile; a crash leaks at most one partial slab per
+				 * thread, the same window as the atomic-allocator build. */
+				struct KV_slab
+				{
+					persistent_ptr<value_type[]> chunk = nullptr;
+					size_type next = 0;
+				};
+				p<size_type> kv_batch;
+				std::vector<KV_slab> kv_slabs;
+
+				/* Transient DRAM summary of one level's buckets: one tag
+				 * byte per slot (derived from the partial, never 0; 0
+				 * means unknown and is always probed). A lookup tests a
+				 * whole bucket with one 8-byte DRAM read and touches the
+				 * PM line only when a byte may match, so most negative
+				 * probes stay out of PM entirely. Summaries are rebuilt
+				 * lazily: the first search that misses a level in the
+				 * registry scans it once, and levels retired by rehash
+				 * are evicted when a new level needs the slot. */
+				struct bucket_summary
+				{
+					uint64_t level_off;
+					uintptr_t slots_base;
+					uint64_t nbuckets;
+					uint64_t *words;
+				};
+
+				constexpr static int summary_slots = 8;
+
+				static uint8_t
+				summary_tag(partial_t partial)
+				{
+					uint8_t t = (uint8_t)(partial >> 8);
+					return t == 0 ? 1 : t;
+				}
+
+				/* any byte equal to tag, or zero (unknown)? SWAR over
+				 * the assoc_num slot bytes of one bucket */
+				static bool
+				summary_may_contain(uint64_t w, uint8_t tag)
+				{
+					const uint64_t ones = 0x0101010101010101ULL;
+					const uint64_t highs = 0x8080808080808080ULL;
+					uint64_t x = w ^ (ones * tag);
+					uint64_t eq = (x - ones) & ~x & highs;
+					uint64_t zero = (w - ones) & ~w & highs;
+					return (eq | zero) != 0;
+				}
+
+				bucket_summary *
+				summary_find(uint64_t level_off) const
+				{
+					for (int k = 0; k < summary_slots; k++)
+					{
+						bucket_summary *s = summaries_[k];
+						if (s != nullptr && s->level_off == level_off)
+							return s;
+					}
+					return nullptr;
+				}
+
+				/* Re-derives the summary byte of one slot from its
+				 * current contents; called after every successful slot
+				 * CAS. summary_invalidate runs before the CAS, so while
+				 * a mutation is in flight the byte reads 0 (unknown)
+				 * and the bucket is probed rather than skipped. */
+				void
+				summary_refresh(const KV_entry_ptr_t *slot) const
+				{
+					uintptr_t addr = (uintptr_t)slot;
+					for (int k = 0; k < summary_slots; k++)
+					{
+						bucket_summary *s = summaries_[k];
+						if (s == nullptr || addr < s->slots_base ||
+							addr >= s->slots_base +
+									s->nbuckets * sizeof(bucket))
+							continue;
+						KV_entry_ptr_u cur(slot->off);
+						uint8_t v = (cur.p.get_offset() == 0)
+							? 0
+							: summary_tag(cur.x.partial);
+						volatile uint8_t *bytes =
+							(volatile uint8_t *)s->words;
+						bytes[(addr - s->slots_base) /
+							  sizeof(KV_entry_ptr_u)] = v;
+					}
+				}
+
+				void
+				summary_invalidate(const KV_entry_ptr_t *slot) const
+				{
+					uintptr_t addr = (uintptr_t)slot;
+					for (int k = 0; k < summary_slots; k++)
+					{
+						bucket_summary *s = summaries_[k];
+						if (s == nullptr || addr < s->slots_base ||
+							addr >= s->slots_base +
+									s->nbuckets * sizeof(bucket))
+							continue;
+						volatile uint8_t *bytes =
+							(volatile uint8_t *)s->words;
+						bytes[(addr - s->slots_base) /
+							  sizeof(KV_entry_ptr_u)] = 0;
+					}
+				}
+
+				bucket_summary *
+				summary_build(uint64_t level_off, level_bucket *cl) const;
+
+				mutable bucket_summary *summaries_[summary_slots];
+				mutable std::vector<bucket_summary *> summary_retired_;
+				mutable std::mutex summary_mtx_;
+
 				std::thread expand_thread;
 
 				/** ID of persistent memory pool where hash map resides. */
@@ -567,6 +759,23 @@ foo();
 						f_idx = first_index(hv, cl->capacity);
 						s_idx = second_index(partial, f_idx, cl->capacity);
 
+						/* consult the DRAM summary first: the PM bucket
+						 * lines are read only when a slot byte may match */
+						bucket_summary *bs = summary_find(li.off);
+						if (bs == nullptr)
+							bs = summary_build(li.off, cl);
+						bool probe_f = true, probe_s = true;
+						if (bs != nullptr)
+						{
+							uint8_t tag = summary_tag(partial);
+							probe_f = summary_may_contain(
+								((volatile uint64_t *)bs->words)[f_idx], tag);
+							probe_s = summary_may_contain(
+								((volatile uint64_t *)bs->words)[s_idx], tag);
+						}
+
+						if (probe_f)
+						{
 						bucket &f_b = cl->buckets[f_idx];
 						for (size_type j = 0; j < assoc_num; j++)
 						{
@@ -579,7 +788,10 @@ foo();
 								}
 							}
 						}
+						}
 
+						if (probe_s)
+						{
 						bucket &s_b = cl->buckets[s_idx];
 						for (size_type j = 0; j < assoc_num; j++)
 						{
@@ -592,6 +804,7 @@ foo();
 								}
 							}
 						}
+						}
 
 						next_li = cl->up;
 						i++;
@@ -603,6 +816,111 @@ foo();
 				} // end while(true)
 			}
 
+			/* Builds the summary for one level and registers it. The
+			 * summary is published all-zero first, so concurrent
+			 * invalidate/refresh stores land in it while the scan runs;
+			 * each byte is then promoted from 0 with a CAS and rolled
+			 * back if the slot changed under the scan, so a byte never
+			 * holds a tag its slot does not justify. When the registry
+			 * is full, an entry whose level is no longer in the current
+			 * meta chain is recycled; readers holding a stale meta
+			 * snapshot retry through the existing context check, and
+			 * retired summaries are kept until teardown so such readers
+			 * never touch freed memory. Returns nullptr if every
+			 * registry slot still belongs to a live level. */
+			template <typename Key, typename T, typename Hash, typename KeyEqual,
+					  size_t HashPower>
+			typename clevel_hash<Key, T, Hash, KeyEqual,
+								 HashPower>::bucket_summary *
+			clevel_hash<Key, T, Hash, KeyEqual, HashPower>::summary_build(
+				uint64_t level_off, level_bucket *cl) const
+			{
+				bucket_summary *ns = new bucket_summary;
+				ns->level_off = level_off;
+				ns->slots_base = (uintptr_t)&cl->buckets[0];
+				ns->nbuckets = cl->capacity;
+				ns->words = new uint64_t[cl->capacity]();
+
+				bucket_summary *bs = nullptr;
+				for (int k = 0; k < summary_slots && bs == nullptr; k++)
+				{
+					bucket_summary *cur = summaries_[k];
+					if (cur != nullptr && cur->level_off == level_off)
+					{
+						// another thread built it first
+						delete[] ns->words;
+						delete ns;
+						return cur;
+					}
+					if (cur == nullptr &&
+						__sync_bool_compare_and_swap(&summaries_[k],
+													 (bucket_summary *)0, ns))
+						bs = ns;
+				}
+
+				if (bs == nullptr)
+				{
+					/* registry full: recycle the slot of a level that
+					 * rehash has retired from the meta chain */
+					std::lock_guard<std::mutex> lock(summary_mtx_);
+					level_meta_ptr_t m_copy(meta);
+					level_meta *m =
+						static_cast<level_meta *>(m_copy(my_pool_uuid));
+					for (int k = 0; k < summary_slots && bs == nullptr; k++)
+					{
+						bucket_summary *cur = summaries_[k];
+						if (cur == nullptr)
+							continue;
+						bool live = false;
+						level_ptr_t li = nullptr, next_li = m->last_level;
+						do
+						{
+							li = next_li;
+							if (li.off == cur->level_off)
+							{
+								live = true;
+								break;
+							}
+							next_li = li.get_address(my_pool_uuid)->up;
+						} while (li != m->first_level);
+						if (live)
+							continue;
+						summary_retired_.push_back(cur);
+						summaries_[k] = ns;
+						bs = ns;
+					}
+					if (bs == nullptr)
+					{
+						delete[] ns->words;
+						delete ns;
+						return nullptr;
+					}
+				}
+
+				// promote bytes from the published all-zero state
+				volatile uint8_t *bytes = (volatile uint8_t *)bs->words;
+				for (uint64_t b = 0; b < bs->nbuckets; b++)
+				{
+					for (size_type j = 0; j < assoc_num; j++)
+					{
+						const KV_entry_ptr_t *slot = &cl->buckets[b].slots[j].p;
+						KV_entry_ptr_u cur(slot->off);
+						if (cur.p.get_offset() == 0)
+							continue;
+						uint64_t idx = b * assoc_num + j;
+						if (!__sync_bool_compare_and_swap(
+								&bytes[idx], (uint8_t)0,
+								summary_tag(cur.x.partial)))
+							continue;
+						// roll back if the slot moved under the scan
+						KV_entry_ptr_u now(slot->off);
+						if (now.p.off != cur.p.off)
+							bytes[idx] = 0;
+					}
+				}
+				return bs;
+			}
+
 			template <typename Key, typename T, typename Hash, typename KeyEqual,
 					  size_t HashPower>
 			void
@@ -625,6 +943,7 @@ foo();
 						if (CAS(&(p2->p.off), e2.raw(), 0))
 						{
 							pop.persist(&(p2->p.off), sizeof(uint64_t));
+							summary_refresh(&(p2->p));
 						}
 					}
 
@@ -635,6 +954,7 @@ foo();
 						if (CAS(&(p2->p.off), e2.raw(), 0))
 						{
 							pop.persist(&(p2->p.off), sizeof(uint64_t));
+							summary_refresh(&(p2->p));
 
 							PMEMoid oid = e2.raw_ptr(my_pool_uuid);
 							pmemobj_free(&oid);
@@ -981,7 +1301,10 @@ foo();
 				partial_t partial = get_partial(hv);
 
 				difference_type t_id = static_cast<difference_type>(thread_id);
-				allocate_KV(pop, tmp_entry[t_id], param);
+				if (kv_batch.get_ro() > 1)
+					tmp_entry[t_id] = slab_allocate_KV(pop, t_id, param);
+				else
+					allocate_KV(pop, tmp_entry[t_id], param);
 				KV_entry_ptr_u created(tmp_entry[t_id].raw().off);
 				created.x.partial = partial;
 
@@ -1040,14 +1363,19 @@ foo();
 
 					if (result == FOUND_IN_LEFT || result == FOUND_IN_RIGHT)
 					{
-						delete_persistent_atomic<value_type>(tmp_entry[t_id]);
+						if (kv_batch.get_ro() > 1)
+							slab_unallocate_KV(t_id);
+						else
+							delete_persistent_atomic<value_type>(tmp_entry[t_id]);
 						return ret(level_num, 0, 0);
 					}
 					else if ((result == VACANCY_IN_LEFT || result == VACANCY_IN_RIGHT) &&
 							 (level_num > 0 || !m->is_resizing))
 					{
+						summary_invalidate(e);
 						if (CAS(&(e->off), old_e.raw(), created.p.raw()))
 						{
+							summary_refresh(e);
 							if (!m->is_resizing && meta(my_pool_uuid)->is_resizing &&
 								level_num == 0)
 							{
@@ -1121,6 +1449,7 @@ foo();
 									if (CAS(&(f_b.slots[j].p.off), tmp.p.off, 0))
 									{
 										pop.persist(&(f_b.slots[j].p.off), sizeof(uint64_t));
+										summary_refresh(&(f_b.slots[j].p));
 										succ_deletion = true;
 
 										PMEMoid oid = tmp.p.raw_ptr(my_pool_uuid);
@@ -1157,6 +1486,7 @@ foo();
 									if (CAS(&(s_b.slots[j].p.off), tmp.p.off, 0))
 									{
 										pop.persist(&(s_b.slots[j].p.off), sizeof(uint64_t));
+										summary_refresh(&(s_b.slots[j].p));
 										succ_deletion = true;
 
 										PMEMoid oid = tmp.p.raw_ptr(my_pool_uuid);
@@ -1204,7 +1534,10 @@ foo();
 				partial_t partial = get_partial(hv);
 
 				difference_type t_id = static_cast<difference_type>(thread_id);
-				allocate_KV(pop, tmp_entry[t_id], param);
+				if (kv_batch.get_ro() > 1)
+					tmp_entry[t_id] = slab_allocate_KV(pop, t_id, param);
+				else
+					allocate_KV(pop, tmp_entry[t_id], param);
 				KV_entry_ptr_u created(tmp_entry[t_id].raw().off);
 				created.x.partial = partial;
 
@@ -1232,9 +1565,11 @@ foo();
 							// which indicates a successful update.
 							return ret(true);
 						}
-						else if (CAS(&(e->off), old_e.raw(), created.p.raw()))
+						summary_invalidate(e);
+						if (CAS(&(e->off), old_e.raw(), created.p.raw()))
 						{
 							pop.persist(&(e->off), sizeof(uint64_t));
+							summary_refresh(e);
 
 							// Instead of simply issuing another find to guarantee the
 							// update is successful, we apply context checking to avoid
@@ -1255,6 +1590,9 @@ foo();
 					{
 						if (!succ_update)
 						{
+							if (kv_batch.get_ro() > 1)
+							slab_unallocate_KV(t_id);
+						else
 							delete_persistent_atomic<value_type>(tmp_entry[t_id]);
 						}
 						// Even the updated item is deleted by other threads, our update
@@ -1432,6 +1770,10 @@ foo();
 
 					for (size_type ii = 0; ii < resize_bulk; ii++)
 					{
+						// One token per rehashed bucket; the governor
+						// slows this thread down while foreground
+						// latency is over budget.
+						resize_governor::instance().admit(1);
 					RETRY_REHASH:
 						m_copy = level_meta_ptr_t(meta);
 						pop.persist(&(meta.off), sizeof(uint64_t));
@@ -1465,15 +1807,18 @@ foo();
 								KV_entry_ptr_t dst_tmp = dst_b1.slots[j].p;
 								if (dst_tmp.get_offset() == 0)
 								{
+									summary_invalidate(&(dst_b1.slots[j].p));
 									if (CAS(&(dst_b1.slots[j].p.off),
 											dst_tmp.raw(), src_tmp.raw()))
 									{
 										pop.persist(&(dst_b1.slots[j].p.off),
 													sizeof(uint64_t));
+										summary_refresh(&(dst_b1.slots[j].p));
 
 										b.slots[slot_idx].p = nullptr;
 										pop.persist(&(b.slots[slot_idx].p.off),
 													sizeof(uint64_t));
+										summary_refresh(&(b.slots[slot_idx].p));
 										succ = true;
 										break;
 									}
@@ -1482,15 +1827,18 @@ foo();
 								dst_tmp = dst_b2.slots[j].p;
 								if (dst_tmp.get_offset() == 0)
 								{
+									summary_invalidate(&(dst_b2.slots[j].p));
 									if (CAS(&(dst_b2.slots[j].p.off),
 											dst_tmp.raw(), src_tmp.raw()))
 									{
 										pop.persist(&(dst_b2.slots[j].p.off),
 													sizeof(uint64_t));
+										summary_refresh(&(dst_b2.slots[j].p));
 
 										b.slots[slot_idx].p = nullptr;
 										pop.persist(&(b.slots[slot_idx].p.off),
 													sizeof(uint64_t));
+										summary_refresh(&(b.slots[slot_idx].p));
 										succ = true;
 										break;
 									}
@@ -11,6 +11,7 @@
 #include "../libpmemobj_cpp_examples_common.hpp"
 #include <libpmemobj++/experimental/clevel_hash.hpp>
 #include "../../../common/hash_api.h"
+#include "../../../common/resize_governor.h"
 #define LAYOUT "clevel_hash"
 // #define KEY_LEN 15
 // #define VALUE_LEN 16
@@ -32,7 +33,7 @@ class clevel : public hash_api
 	nvobj::persistent_ptr<persistent_map_type> map;
 
 public:
-	clevel(int tnum = 1)
+	clevel(int tnum = 1, size_t batch = 1)
 	{
         const char *path = "/mnt/pmem0/eval_hash/clevel";
 		std::remove(path); // Remove existing file
@@ -43,6 +44,7 @@ public:
 		nvobj::transaction::manual tx(pop);
 		proot->cons = nvobj::make_persistent<persistent_map_type>();
 		proot->cons->set_thread_num(tnum);
+		proot->cons->set_kv_batch(batch);
 		map = proot->cons;
 		nvobj::transaction::commit();
 	}
@@ -53,10 +55,25 @@ public:
 		return h;
 	}
 	std::string hash_name() { return "clevel"; };
+	/// Incremental stats from the insert-path globals (racy, fine for
+	/// sampling): items inserted so far and the capacity the last
+	/// insert observed; pm_bytes estimates the slot arrays from it.
+	hash_stats_t stats()
+	{
+		hash_stats_t st;
+		st.items = coo;
+		st.capacity = ccc;
+		if (st.capacity)
+			st.load_factor = static_cast<double>(st.items) / st.capacity;
+		st.pm_bytes = ccc * sizeof(persistent_map_type::value_type);
+		return st;
+	}
 	bool find(const char *key, size_t key_sz, char *value_out, unsigned tid)
 	{
 		pmem::obj::p<uint64_t> k = *reinterpret_cast<const uint64_t *>(key);
+		auto sample = resize_governor::instance().sample_op();
 		auto r = map->search(persistent_map_type::key_type(k));
+		resize_governor::instance().observe(sample);
 		return r.found;
 	}
 	bool insert(const char *key, size_t key_sz, const char *value,
@@ -64,7 +81,9 @@ public:
 	{
 		auto k = *reinterpret_cast<const uint64_t *>(key);
 		auto v = *reinterpret_cast<const uint64_t *>(value);
+		auto sample = resize_governor::instance().sample_op();
 		auto r = map->insert(persistent_map_type::value_type(k, v), tid, t);
+		resize_governor::instance().observe(sample);
 		if (!r.found)
 		{
 			coo++;
@@ -101,6 +120,6 @@ public:
 };
 extern "C" hash_api *create_tree(const tree_options_t &opt, unsigned sz = 1024, unsigned tnum = 1)
 {
-	clevel *c = new clevel(tnum);
+	clevel *c = new clevel(tnum, opt.batch_size);
 	return c;
 }
@@ -11,6 +11,7 @@
 #endif
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <list>
 #include <mutex>
@@ -150,7 +151,11 @@ class EpochManager {
     /// compare-and-swap on the #m_threadId member.
     struct Entry {
       /// Construct an Entry in an unlocked and ready to use state.
-      Entry() : protected_epoch{0}, last_unprotected_epoch{0}, thread_id{0} {}
+      Entry()
+          : protected_epoch{0},
+            last_unprotected_epoch{0},
+            thread_id{0},
+            bump_pending{0} {}
 
       /// Threads record a snapshot of the global epoch during Protect().
       /// Threads reset this to 0 during Unprotect().
@@ -185,8 +190,14 @@ class EpochManager {
       /// XXX(tzwang): on Linux pthread_t is 64-bit
       std::atomic<uint64_t> thread_id;  //  8 bytes
 
+      /// Set by the owning thread when it wants the global epoch bumped
+      /// (see EpochManager::BumpCurrentEpoch()). Lives on the thread's
+      /// own cacheline, so requesting a bump causes no cross-thread
+      /// traffic; the advancer thread harvests and clears these flags.
+      std::atomic<uint32_t> bump_pending;  //  4 bytes
+
       /// Ensure that each Entry is CACHELINE_SIZE.
-      char ___padding[40];
+      char ___padding[36];
 
       // -- Allocation policy to ensure alignment --
 
@@ -232,6 +243,8 @@ class EpochManager {
     void ReleaseEntryForThread();
     void ReclaimOldEntries();
     bool IsProtected();
+    void RequestBump();
+    bool HarvestBumpRequests();
 
    private:
 #ifdef TEST_BUILD
@@ -283,6 +296,13 @@ class EpochManager {
   /// of how early it might have entered. See MinEpochTable for more details.
   MinEpochTable* epoch_table_;
 
+  /// Dedicated advancer: harvests per-thread bump requests, applies them
+  /// as a single epoch increment, and recomputes the safe-to-reclaim
+  /// epoch. Being the sole writer of #current_epoch_ keeps the epoch
+  /// cacheline read-mostly for the worker threads.
+  std::thread advancer_;
+  std::atomic<bool> advancer_stop_;
+
   EpochManager(const EpochManager&) = delete;
   EpochManager(EpochManager&&) = delete;
   EpochManager& operator=(EpochManager&&) = delete;
@@ -333,7 +353,10 @@ class EpochGuard {
 };
 
 EpochManager::EpochManager()
-    : current_epoch_{1}, safe_to_reclaim_epoch_{0}, epoch_table_{nullptr} {}
+    : current_epoch_{1},
+      safe_to_reclaim_epoch_{0},
+      epoch_table_{nullptr},
+      advancer_stop_{false} {}
 
 EpochManager::~EpochManager() { Uninitialize(); }
 
@@ -361,6 +384,24 @@ bool EpochManager::Initialize() {
   safe_to_reclaim_epoch_ = 0;
   epoch_table_ = new_table;
 
+  // Flat-combining style epoch advancement: worker threads only mark a
+  // flag on their own table entry; this thread coalesces all pending
+  // requests into one increment per pass and takes the O(table) minimum
+  // scan off the worker threads entirely.
+  advancer_stop_.store(false, std::memory_order_relaxed);
+  advancer_ = std::thread([this] {
+    while (!advancer_stop_.load(std::memory_order_acquire)) {
+      if (epoch_table_->HarvestBumpRequests()) {
+        Epoch newEpoch =
+            current_epoch_.load(std::memory_order_relaxed) + 1;
+        current_epoch_.store(newEpoch, std::memory_order_seq_cst);
+        ComputeNewSafeToReclaimEpoch(newEpoch);
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+  });
+
   return true;
 }
 
@@ -384,6 +425,9 @@ bool EpochManager::Initialize() {
 bool EpochManager::Uninitialize() {
   if (!epoch_table_) return true;
 
+  advancer_stop_.store(true, std::memory_order_release);
+  if (advancer_.joinable()) advancer_.join();
+
   auto s = epoch_table_->Uninitialize();
 
   // Keep going anyway. Even if the inner table fails to completely
@@ -408,12 +452,14 @@ bool EpochManager::Uninitialize() {
  * performance, since it is an atomic operation and invalidates a read-hot
  * object in the cache of all of the cores.
  *
- * Only called by GarbageList.
+ * Only called by GarbageList. The bump is deferred: the calling thread
+ * merely flags its own (cacheline-private) table entry and the advancer
+ * thread applies all pending requests as a single increment, so a
+ * delete-heavy workload no longer serializes on the epoch cacheline.
+ * GarbageList tolerates the lag — a Push that finds its victim slot not
+ * yet safe to reclaim simply probes another slot.
  */
-void EpochManager::BumpCurrentEpoch() {
-  Epoch newEpoch = current_epoch_.fetch_add(1, std::memory_order_seq_cst);
-  ComputeNewSafeToReclaimEpoch(newEpoch);
-}
+void EpochManager::BumpCurrentEpoch() { epoch_table_->RequestBump(); }
 
 // - private -
 
@@ -711,6 +757,40 @@ bool EpochManager::MinEpochTable::IsProtected() {
   return entry->protected_epoch.load(std::memory_order_relaxed) != 0;
 }
 
+/**
+ * Record that the calling thread wants the global epoch advanced. Only
+ * touches the thread's own table entry, which lives on its own cacheline,
+ * so concurrent requesters never contend with each other or with readers
+ * of the global epoch. Requests are level-triggered: any number of them
+ * between two advancer passes collapse into one epoch increment.
+ */
+void EpochManager::MinEpochTable::RequestBump() {
+  Entry* entry = nullptr;
+  if (!GetEntryForThread(&entry)) {
+    return;
+  }
+  entry->bump_pending.store(1, std::memory_order_release);
+}
+
+/**
+ * Collect and clear all pending bump requests. Called only from the
+ * advancer thread.
+ *
+ * \return true if at least one thread requested an epoch bump since the
+ *      last harvest.
+ */
+bool EpochManager::MinEpochTable::HarvestBumpRequests() {
+  bool any = false;
+  for (uint64_t i = 0; i < size_; ++i) {
+    Entry& entry = table_[i];
+    if (entry.bump_pending.load(std::memory_order_acquire) != 0) {
+      entry.bump_pending.store(0, std::memory_order_relaxed);
+      any = true;
+    }
+  }
+  return any;
+}
+
 void EpochManager::MinEpochTable::ReleaseEntryForThread() {}
 
 void EpochManager::MinEpochTable::ReclaimOldEntries() {}
@@ -5,9 +5,14 @@
 #define HASH_INTERFACE_H_
 #include <hash_api.h>
 
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
 
 #include "allocator.h"
+#include "table_stats.h"
 #ifdef PMEM
 #include <libpmemobj.h>
 #endif
@@ -27,6 +32,54 @@ struct string_key
   char key[0];
 };
 
+/* When T is a string_key pointer the bucket stores only the 8-byte
+ * pointer inline and the full key out-of-line.  The top 16 bits of that
+ * pointer are unused on x86-64, so the first two key bytes are packed
+ * there as an inline prefix: together with the 8-bit fingerprint, most
+ * false positives are rejected without dereferencing the out-of-line
+ * key.  Stored keys are tagged on insert and must be untagged before
+ * any dereference. */
+constexpr uint64_t varKeyPtrMask = (1ULL << 48) - 1;
+
+static inline uint64_t var_key_prefix(const string_key *key)
+{
+  uint16_t prefix = 0;
+  memcpy(&prefix, key->key, key->length < 2 ? key->length : 2);
+  return static_cast<uint64_t>(prefix) << 48;
+}
+
+template <class T>
+static inline T untag_var_key(T key)
+{
+  if constexpr (std::is_pointer_v<T>)
+  {
+    return reinterpret_cast<T>(reinterpret_cast<uint64_t>(key) &
+                               varKeyPtrMask);
+  }
+  else
+  {
+    return key;
+  }
+}
+
+/* Idempotent: re-tagging an already tagged key recomputes the same
+ * prefix, so split/merge paths may pass stored keys straight through. */
+template <class T>
+static inline T tag_var_key(T key)
+{
+  if constexpr (std::is_pointer_v<T>)
+  {
+    auto k = reinterpret_cast<const string_key *>(
+        reinterpret_cast<uint64_t>(key) & varKeyPtrMask);
+    return reinterpret_cast<T>(reinterpret_cast<uint64_t>(k) |
+                               var_key_prefix(k));
+  }
+  else
+  {
+    return key;
+  }
+}
+
 template <class T>
 class Hash : public hash_api
 {
@@ -44,19 +97,60 @@ public:
   };
   virtual bool Delete(T) = 0;
   virtual bool Delete(T, bool) = 0;
+  // Batched delete for bulk expiry; the default loops the per-key
+  // path, concrete tables override it to amortize epoch entry and
+  // coalesce write-backs.
+  virtual size_t DeleteBatch(const T *keys, size_t n)
+  {
+    size_t removed = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      T k = keys[i];
+      if (Delete(k, false)) removed++;
+    }
+    return removed;
+  }
+  // Batched lookup for independent keys; out[i] receives the value or
+  // NONE. The default loops the per-key path (the caller holds the
+  // epoch), concrete tables override it with software-pipelined probes.
+  virtual size_t GetBatch(const T *keys, size_t n, Value_t *out)
+  {
+    size_t found = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      out[i] = Get(keys[i], true);
+      if (out[i] != NONE) found++;
+    }
+    return found;
+  }
+  // Insert-or-overwrite; the default re-runs Insert, concrete tables
+  // override it with a single-probe in-place update.
+  virtual bool Upsert(T k, Value_t v, bool is_in_epoch)
+  {
+    return Insert(k, v, is_in_epoch);
+  }
   virtual Value_t Get(T) = 0;
   virtual Value_t Get(T key, bool is_in_epoch) = 0;
   virtual bool Recovery() = 0;
   virtual void getNumber() = 0;
   virtual hash_Utilization utiliz();
   virtual string hash_name();
+  // Incremental statistics; concrete tables override to fill in the
+  // structure-derived fields (capacity, depth, overflow) on top of the
+  // counters kept here.
+  virtual hash_stats_t Stats() { return tstats_.snapshot(); }
   // hash_api
   hash_Utilization utilization() { return utiliz(); };
+  hash_stats_t stats() { return Stats(); }
   bool recovery() { return Recovery(); };
+  size_t max_inline_value_size() { return sizeof(Value_t); }
+  void set_inline_value_size(size_t value_sz) { inline_value_sz = value_sz; }
   bool find(const char *key, size_t key_sz, char *value_out, unsigned tid)
   {
     T k = *reinterpret_cast<const T *>(key);
     auto r = Get(k, false);
+    if (inline_value_sz && r != NONE)
+      memcpy(value_out, &r, inline_value_sz);
     return r;
   }
 
@@ -64,14 +158,37 @@ public:
               size_t value_sz, unsigned tid, unsigned t)
   {
     T k = *reinterpret_cast<const T *>(key);
-    Insert(k, value, false);
+    Insert(k, wrap_value(value, value_sz), false);
+    // Counted here rather than at the slot write: Insert reports
+    // "resized", not "inserted", so the item count over-reads by the
+    // number of duplicate-key inserts — irrelevant for unique-key runs.
+    tstats_.record_insert();
     return true;
   }
   bool insertResize(const char *key, size_t key_sz, const char *value,
                     size_t value_sz)
   {
     T k = *reinterpret_cast<const T *>(key);
-    return Insert(k, value, false);
+    return Insert(k, wrap_value(value, value_sz), false);
+  }
+  void bulk_load(const char *keys, const char *values, size_t key_sz,
+                 size_t value_sz, uint64_t count, unsigned tid)
+  {
+    // Segments are pre-sized through create_tree's 'sz' hint; the win
+    // here is amortization: one epoch guard for the whole batch instead
+    // of one acquisition per record on the insert path.
+#ifdef PMEM
+    auto guard = Allocator::AquireEpochGuard();
+    const bool in_epoch = true;
+#else
+    const bool in_epoch = false;
+#endif
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      T k = *reinterpret_cast<const T *>(keys + i * key_sz);
+      Insert(k, wrap_value(values + i * value_sz, value_sz), in_epoch);
+      tstats_.record_insert();
+    }
   }
   bool update(const char *key, size_t key_sz, const char *value,
               size_t value_sz)
@@ -79,17 +196,78 @@ public:
     return true;
   }
 
+  bool upsert(const char *key, size_t key_sz, const char *value,
+              size_t value_sz, unsigned tid, unsigned t)
+  {
+    T k = *reinterpret_cast<const T *>(key);
+    Upsert(k, wrap_value(value, value_sz), false);
+    return true;
+  }
+
   bool remove(const char *key, size_t key_sz, unsigned tid)
   {
     T k = *reinterpret_cast<const T *>(key);
-    Delete(k, false);
+    if (Delete(k, false))
+      tstats_.record_remove();
     return true;
   }
 
+  uint64_t remove_batch(const char *keys, size_t key_sz, uint64_t count,
+                        unsigned tid)
+  {
+    std::vector<T> ks(count);
+    for (uint64_t i = 0; i < count; ++i)
+      ks[i] = *reinterpret_cast<const T *>(keys + i * key_sz);
+    uint64_t removed = DeleteBatch(ks.data(), count);
+    tstats_.record_remove_n(removed);
+    return removed;
+  }
+
+  uint64_t find_batch(const char *const *keys, size_t key_sz, uint64_t count,
+                      char *values_out, size_t value_stride, unsigned tid)
+  {
+    std::vector<T> ks(count);
+    for (uint64_t i = 0; i < count; ++i)
+      ks[i] = *reinterpret_cast<const T *>(keys[i]);
+    std::vector<Value_t> vs(count);
+#ifdef PMEM
+    auto guard = Allocator::AquireEpochGuard();
+#endif
+    uint64_t found = GetBatch(ks.data(), count, vs.data());
+    if (inline_value_sz)
+    {
+      for (uint64_t i = 0; i < count; ++i)
+        if (vs[i] != NONE)
+          memcpy(values_out + i * value_stride, &vs[i], inline_value_sz);
+    }
+    return found;
+  }
+
   int scan(const char *key, size_t key_sz, int scan_sz, char *&values_out)
   {
     return scan_sz;
   }
+
+private:
+  // In-slot mode: copies the value bytes into the slot word itself, so
+  // a hit needs no dependent read; out-of-line mode stores the caller's
+  // pointer unchanged.
+  Value_t wrap_value(const char *value, size_t value_sz)
+  {
+    if (inline_value_sz == 0) return value;
+    uint64_t v = 0;
+    memcpy(&v, value, value_sz < sizeof(v) ? value_sz : sizeof(v));
+    return reinterpret_cast<Value_t>(v);
+  }
+
+  // Non-zero when values are stored in-slot (set through
+  // set_inline_value_size by create_tree).
+  size_t inline_value_sz = 0;
+
+protected:
+  // Striped item/probe counters shared with the concrete tables, which
+  // feed probe lengths from their lookup paths.
+  table_stats tstats_;
 };
 
 #endif // _HASH_INTERFACE_H_
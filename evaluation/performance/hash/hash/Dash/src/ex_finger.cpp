@@ -31,5 +31,7 @@ extern "C" hash_api *create_tree(const tree_options_t &opt, unsigned sz, unsigne
   {
     new (hash_table) extendible::Finger_EH<uint64_t>();
   }
+  if (opt.value_size <= hash_table->max_inline_value_size())
+    hash_table->set_inline_value_size(opt.value_size);
   return hash_table;
 }
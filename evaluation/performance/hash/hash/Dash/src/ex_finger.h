@@ -13,6 +13,8 @@
 #include <immintrin.h>
 #include <omp.h>
 
+#include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <cassert>
 #include <cmath>
@@ -77,6 +79,18 @@ inline bool var_compare(char *str1, char *str2, int len1, int len2) {
   return !memcmp(str1, str2, len1);
 }
 
+/* Matches a stored (prefix-tagged) key pointer against the probe key.
+ * The two key bytes packed into the stored pointer's top bits reject
+ * most fingerprint false positives without touching the out-of-line
+ * key's cache line. */
+template <class K>
+static inline bool var_match(K stored, string_key *probe) {
+  auto bits = reinterpret_cast<uint64_t>(stored);
+  if ((bits & ~varKeyPtrMask) != var_key_prefix(probe)) return false;
+  auto curr = reinterpret_cast<string_key *>(bits & varKeyPtrMask);
+  return var_compare(curr->key, probe->key, curr->length, probe->length);
+}
+
 template <class T>
 struct Bucket {
   inline int find_empty_slot() {
@@ -247,10 +261,7 @@ struct Bucket {
       string_key *_key = reinterpret_cast<string_key *>(key);
       for (int i = 0; i < 14; i += 1) {
         if (CHECK_BIT(mask, i) &&
-            (var_compare((reinterpret_cast<string_key *>(_[i].key))->key,
-                         _key->key,
-                         (reinterpret_cast<string_key *>(_[i].key))->length,
-                         _key->length))) {
+            (var_match(_[i].key, _key))) {
           return _[i].value;
         }
       }
@@ -364,7 +375,7 @@ struct Bucket {
       return -1;
     }
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
 #ifdef PMEM
     Allocator::Persist(&_[slot], sizeof(_[slot]));
 #endif
@@ -390,56 +401,38 @@ struct Bucket {
       if (mask != 0) {
         for (int i = 0; i < 12; i += 4) {
           if (CHECK_BIT(mask, i) &&
-              (var_compare((reinterpret_cast<string_key *>(_[i].key))->key,
-                           _key->key,
-                           (reinterpret_cast<string_key *>(_[i].key))->length,
-                           _key->length))) {
+              (var_match(_[i].key, _key))) {
             unset_hash(i, false);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 1) &&
-              (var_compare(
-                  reinterpret_cast<string_key *>(_[i + 1].key)->key, _key->key,
-                  (reinterpret_cast<string_key *>(_[i + 1].key))->length,
-                  _key->length))) {
+              (var_match(_[i + 1].key, _key))) {
             unset_hash(i + 1, false);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 2) &&
-              (var_compare(
-                  reinterpret_cast<string_key *>(_[i + 2].key)->key, _key->key,
-                  (reinterpret_cast<string_key *>(_[i + 2].key))->length,
-                  _key->length))) {
+              (var_match(_[i + 2].key, _key))) {
             unset_hash(i + 2, false);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 3) &&
-              (var_compare(
-                  reinterpret_cast<string_key *>(_[i + 3].key)->key, _key->key,
-                  (reinterpret_cast<string_key *>(_[i + 3].key))->length,
-                  _key->length))) {
+              (var_match(_[i + 3].key, _key))) {
             unset_hash(i + 3, false);
             return 0;
           }
         }
 
         if (CHECK_BIT(mask, 12) &&
-            (var_compare(reinterpret_cast<string_key *>(_[12].key)->key,
-                         _key->key,
-                         (reinterpret_cast<string_key *>(_[12].key))->length,
-                         _key->length))) {
+            (var_match(_[12].key, _key))) {
           unset_hash(12, false);
           return 0;
         }
 
         if (CHECK_BIT(mask, 13) &&
-            (var_compare(reinterpret_cast<string_key *>(_[13].key)->key,
-                         _key->key,
-                         (reinterpret_cast<string_key *>(_[13].key))->length,
-                         _key->length))) {
+            (var_match(_[13].key, _key))) {
           unset_hash(13, false);
           return 0;
         }
@@ -483,6 +476,126 @@ struct Bucket {
     return -1;
   }
 
+  /*in-place overwrite of the value for a matching key; returns 0 on a
+   * hit and -1 when the key is not in this bucket*/
+  int Update(T key, Value_t value, uint8_t meta_hash, bool probe) {
+    int mask = 0;
+    SSE_CMP8(finger_array, meta_hash);
+    if (!probe) {
+      mask = mask & GET_BITMAP(bitmap) & (~GET_MEMBER(bitmap));
+    } else {
+      mask = mask & GET_BITMAP(bitmap) & GET_MEMBER(bitmap);
+    }
+
+    if constexpr (std::is_pointer_v<T>) {
+      string_key *_key = reinterpret_cast<string_key *>(key);
+      /*loop unrolling*/
+      if (mask != 0) {
+        for (int i = 0; i < 12; i += 4) {
+          if (CHECK_BIT(mask, i) &&
+              (var_match(_[i].key, _key))) {
+            _[i].value = value;
+#ifdef PMEM
+            Allocator::Persist(&_[i].value, sizeof(_[i].value));
+#endif
+            return 0;
+          }
+          if (CHECK_BIT(mask, i + 1) &&
+              (var_match(_[i + 1].key, _key))) {
+            _[i + 1].value = value;
+#ifdef PMEM
+            Allocator::Persist(&_[i + 1].value, sizeof(_[i + 1].value));
+#endif
+            return 0;
+          }
+          if (CHECK_BIT(mask, i + 2) &&
+              (var_match(_[i + 2].key, _key))) {
+            _[i + 2].value = value;
+#ifdef PMEM
+            Allocator::Persist(&_[i + 2].value, sizeof(_[i + 2].value));
+#endif
+            return 0;
+          }
+          if (CHECK_BIT(mask, i + 3) &&
+              (var_match(_[i + 3].key, _key))) {
+            _[i + 3].value = value;
+#ifdef PMEM
+            Allocator::Persist(&_[i + 3].value, sizeof(_[i + 3].value));
+#endif
+            return 0;
+          }
+        }
+
+        if (CHECK_BIT(mask, 12) &&
+            (var_match(_[12].key, _key))) {
+          _[12].value = value;
+#ifdef PMEM
+          Allocator::Persist(&_[12].value, sizeof(_[12].value));
+#endif
+          return 0;
+        }
+        if (CHECK_BIT(mask, 13) &&
+            (var_match(_[13].key, _key))) {
+          _[13].value = value;
+#ifdef PMEM
+          Allocator::Persist(&_[13].value, sizeof(_[13].value));
+#endif
+          return 0;
+        }
+      }
+
+    } else {
+      if (mask != 0) {
+        for (int i = 0; i < 12; i += 4) {
+          if (CHECK_BIT(mask, i) && (_[i].key == key)) {
+            _[i].value = value;
+#ifdef PMEM
+            Allocator::Persist(&_[i].value, sizeof(_[i].value));
+#endif
+            return 0;
+          }
+          if (CHECK_BIT(mask, i + 1) && (_[i + 1].key == key)) {
+            _[i + 1].value = value;
+#ifdef PMEM
+            Allocator::Persist(&_[i + 1].value, sizeof(_[i + 1].value));
+#endif
+            return 0;
+          }
+          if (CHECK_BIT(mask, i + 2) && (_[i + 2].key == key)) {
+            _[i + 2].value = value;
+#ifdef PMEM
+            Allocator::Persist(&_[i + 2].value, sizeof(_[i + 2].value));
+#endif
+            return 0;
+          }
+          if (CHECK_BIT(mask, i + 3) && (_[i + 3].key == key)) {
+            _[i + 3].value = value;
+#ifdef PMEM
+            Allocator::Persist(&_[i + 3].value, sizeof(_[i + 3].value));
+#endif
+            return 0;
+          }
+        }
+
+        if (CHECK_BIT(mask, 12) && (_[12].key == key)) {
+          _[12].value = value;
+#ifdef PMEM
+          Allocator::Persist(&_[12].value, sizeof(_[12].value));
+#endif
+          return 0;
+        }
+        if (CHECK_BIT(mask, 13) && (_[13].key == key)) {
+          _[13].value = value;
+#ifdef PMEM
+          Allocator::Persist(&_[13].value, sizeof(_[13].value));
+#endif
+          return 0;
+        }
+      }
+    }
+    return -1;
+  }
+
   int Insert_with_noflush(T key, Value_t value, uint8_t meta_hash, bool probe) {
     auto slot = find_empty_slot();
     /* this branch can be removed*/
@@ -492,15 +605,50 @@ struct Bucket {
       return -1;
     }
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
     set_hash(slot, meta_hash, probe);
     return 0;
   }
 
+#ifdef PMEM
+  /* Persists a freshly written pair slot together with this bucket's
+   * header using one flush per dirty cacheline: the 32-byte header
+   * shares its line with slots 0 and 1, so a displacement landing there
+   * commits with a single flush instead of two. The displacement
+   * planner writes every slot of a bucket first and then calls this
+   * once, where the old path flushed each store separately. */
+  void persist_pair_and_header(int slot) {
+    if (slot < 2) {
+      Allocator::Persist(this, kCacheLineSize);
+    } else {
+      Allocator::Persist(&_[slot], sizeof(_Pair<T>));
+      Allocator::Persist(&bitmap, sizeof(bitmap));
+    }
+  }
+#endif
+
+  /* Insert that defers persistence to persist_pair_and_header(), so the
+   * caller can batch the pair and header flushes; returns the slot
+   * written, or -1 when the bucket is full. */
+  int Insert_planned(T key, Value_t value, uint8_t meta_hash, bool probe) {
+    auto slot = find_empty_slot();
+    assert(slot < kNumPairPerBucket);
+    if (slot == -1) {
+      return -1;
+    }
+    _[slot].value = value;
+    _[slot].key = tag_var_key(key);
+    set_hash(slot, meta_hash, probe);
+#ifdef PMEM
+    persist_pair_and_header(slot);
+#endif
+    return slot;
+  }
+
   void Insert_displace(T key, Value_t value, uint8_t meta_hash, int slot,
                        bool probe) {
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
 #ifdef PMEM
     Allocator::Persist(&_[slot], sizeof(_Pair<T>));
 #endif
@@ -510,7 +658,7 @@ struct Bucket {
   void Insert_displace_with_noflush(T key, Value_t value, uint8_t meta_hash,
                                     int slot, bool probe) {
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
     set_hash(slot, meta_hash, probe);
   }
 
@@ -600,6 +748,53 @@ struct Directory {
   }
 };
 
+#ifdef DASH_COMPACT_DIR
+/*
+ * Compact DRAM mirror of the directory (-DDASH_COMPACT_DIR). The PM
+ * directory stays authoritative; the mirror packs each 8-byte entry
+ * into 32 bits -- the segment's offset from the fixed pool mapping in
+ * cache-line units -- so twice the directory fits in cache and the
+ * point lookup's first hop stops missing. Slots left kCompactInvalid
+ * (stale crash version at build time) push the reader to the PM
+ * directory, whose recovery path heals the slot. Mirrors retired by a
+ * doubling or halving are leaked deliberately: lock-free readers may
+ * still hold them, and the retired ones sum to less than one
+ * final-size mirror.
+ */
+const uint32_t kCompactInvalid = 0xffffffffu;
+
+template <class T>
+struct CompactDir {
+  uint32_t global_depth;
+  std::atomic<uint32_t> entry[0];
+
+  // allocations are kCacheLineSize aligned, so line-granular offsets
+  // from the fixed mapping cover a 256GB pool in 32 bits
+  static uint32_t Pack(uint64_t seg) {
+    return static_cast<uint32_t>((seg - pool_addr) >> 6);
+  }
+  static Table<T> *Unpack(uint32_t packed) {
+    return reinterpret_cast<Table<T> *>(pool_addr +
+                                        (static_cast<uint64_t>(packed) << 6));
+  }
+
+  static CompactDir *Build(Directory<T> *d, uint64_t want_version) {
+    size_t cap = size_t(1) << d->global_depth;
+    auto *cd = reinterpret_cast<CompactDir *>(
+        new char[sizeof(CompactDir) + sizeof(uint32_t) * cap]);
+    cd->global_depth = d->global_depth;
+    for (size_t i = 0; i < cap; ++i) {
+      uint64_t e = reinterpret_cast<uint64_t>(d->_[i]);
+      cd->entry[i].store((e & headerMask) == want_version
+                             ? Pack(e & tailMask)
+                             : kCompactInvalid,
+                         std::memory_order_relaxed);
+    }
+    return cd;
+  }
+};
+#endif
+
 /*thread local table allcoation pool*/
 template <class T>
 struct TlsTablePool {
@@ -737,19 +932,22 @@ struct Table {
     int displace_index = neighbor->Find_org_displacement();
     if ((GET_COUNT(next_neighbor->bitmap) != kNumPairPerBucket) &&
         (displace_index != -1)) {
-      next_neighbor->Insert(neighbor->_[displace_index].key,
-                            neighbor->_[displace_index].value,
-                            neighbor->finger_array[displace_index], true);
+      /* The final arrangement is known up front: the displaced pair
+       * moves into the next neighbor's first free slot and (key, value)
+       * takes its slot. Each bucket is written completely and then
+       * flushed once per dirty line. */
+      next_neighbor->Insert_planned(neighbor->_[displace_index].key,
+                                    neighbor->_[displace_index].value,
+                                    neighbor->finger_array[displace_index],
+                                    true);
       next_neighbor->release_lock();
-#ifdef PMEM
-      Allocator::Persist(&next_neighbor->bitmap, sizeof(next_neighbor->bitmap));
-#endif
       neighbor->unset_hash(displace_index);
-      neighbor->Insert_displace(key, value, meta_hash, displace_index, true);
-      neighbor->release_lock();
+      neighbor->Insert_displace_with_noflush(key, value, meta_hash,
+                                             displace_index, true);
 #ifdef PMEM
-      Allocator::Persist(&neighbor->bitmap, sizeof(neighbor->bitmap));
+      neighbor->persist_pair_and_header(displace_index);
 #endif
+      neighbor->release_lock();
       target->release_lock();
 #ifdef COUNTING
       __sync_fetch_and_add(&number, 1);
@@ -765,19 +963,20 @@ struct Table {
     int displace_index = target->Find_probe_displacement();
     if ((GET_COUNT(prev_neighbor->bitmap) != kNumPairPerBucket) &&
         (displace_index != -1)) {
-      prev_neighbor->Insert(target->_[displace_index].key,
-                            target->_[displace_index].value,
-                            target->finger_array[displace_index], false);
+      /* Same planned application as Next_displace: write each bucket
+       * completely, then one flush per dirty line. */
+      prev_neighbor->Insert_planned(target->_[displace_index].key,
+                                    target->_[displace_index].value,
+                                    target->finger_array[displace_index],
+                                    false);
       prev_neighbor->release_lock();
-#ifdef PMEM
-      Allocator::Persist(&prev_neighbor->bitmap, sizeof(prev_neighbor->bitmap));
-#endif
       target->unset_hash(displace_index);
-      target->Insert_displace(key, value, meta_hash, displace_index, false);
-      target->release_lock();
+      target->Insert_displace_with_noflush(key, value, meta_hash,
+                                           displace_index, false);
 #ifdef PMEM
-      Allocator::Persist(&target->bitmap, sizeof(target->bitmap));
+      target->persist_pair_and_header(displace_index);
 #endif
+      target->release_lock();
       neighbor->release_lock();
 #ifdef COUNTING
       __sync_fetch_and_add(&number, 1);
@@ -842,7 +1041,7 @@ struct Table {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1007,7 +1206,8 @@ void Table<T>::Insert4splitWithCheck(T key, Value_t value, size_t key_hash,
 
   /*some bucket may be overflowed?*/
   if (GET_COUNT(insert_target->bitmap) < kNumPairPerBucket) {
-    insert_target->_[GET_COUNT(insert_target->bitmap)].key = key;
+    insert_target->_[GET_COUNT(insert_target->bitmap)].key =
+        tag_var_key(key);
     insert_target->_[GET_COUNT(insert_target->bitmap)].value = value;
     insert_target->set_hash(GET_COUNT(insert_target->bitmap), meta_hash, probe);
 #ifdef COUNTING
@@ -1078,7 +1278,8 @@ void Table<T>::Insert4split(T key, Value_t value, size_t key_hash,
 
   /*some bucket may be overflowed?*/
   if (GET_COUNT(insert_target->bitmap) < kNumPairPerBucket) {
-    insert_target->_[GET_COUNT(insert_target->bitmap)].key = key;
+    insert_target->_[GET_COUNT(insert_target->bitmap)].key =
+        tag_var_key(key);
     insert_target->_[GET_COUNT(insert_target->bitmap)].value = value;
     insert_target->set_hash(GET_COUNT(insert_target->bitmap), meta_hash, probe);
 #ifdef COUNTING
@@ -1220,7 +1421,7 @@ void Table<T>::HelpSplit(Table<T> *next_table) {
     for (int j = 0; j < kNumPairPerBucket; ++j) {
       if (CHECK_BIT(mask, j)) {
         if constexpr (std::is_pointer_v<T>) {
-          auto curr_key = curr_bucket->_[j].key;
+          auto curr_key = untag_var_key(curr_bucket->_[j].key);
           key_hash = h(curr_key->key, curr_key->length);
         } else {
           key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1247,7 +1448,7 @@ void Table<T>::HelpSplit(Table<T> *next_table) {
     for (int j = 0; j < kNumPairPerBucket; ++j) {
       if (CHECK_BIT(mask, j)) {
         if constexpr (std::is_pointer_v<T>) {
-          auto curr_key = curr_bucket->_[j].key;
+          auto curr_key = untag_var_key(curr_bucket->_[j].key);
           key_hash = h(curr_key->key, curr_key->length);
         } else {
           key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1318,7 +1519,7 @@ Table<T> *Table<T>::Split(size_t _key_hash) {
     for (int j = 0; j < kNumPairPerBucket; ++j) {
       if (CHECK_BIT(mask, j)) {
         if constexpr (std::is_pointer_v<T>) {
-          auto curr_key = curr_bucket->_[j].key;
+          auto curr_key = untag_var_key(curr_bucket->_[j].key);
           key_hash = h(curr_key->key, curr_key->length);
         } else {
           key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1347,7 +1548,7 @@ Table<T> *Table<T>::Split(size_t _key_hash) {
     for (int j = 0; j < kNumPairPerBucket; ++j) {
       if (CHECK_BIT(mask, j)) {
         if constexpr (std::is_pointer_v<T>) {
-          auto curr_key = curr_bucket->_[j].key;
+          auto curr_key = untag_var_key(curr_bucket->_[j].key);
           key_hash = h(curr_key->key, curr_key->length);
         } else {
           key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1404,7 +1605,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1424,7 +1625,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1444,7 +1645,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1464,7 +1665,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1488,8 +1689,16 @@ class Finger_EH : public Hash<T> {
   bool Insert(T key, Value_t value, bool);
   inline bool Delete(T);
   bool Delete(T, bool);
+  size_t DeleteBatch(const T *keys, size_t n);
+  /* one key of DeleteBatch: write-backs queued, merges deferred */
+  bool DeleteDeferred(T key, uint64_t key_hash,
+                      std::vector<std::pair<char *, size_t>> &dirty,
+                      std::vector<uint64_t> &merges);
+  inline bool Upsert(T key, Value_t value);
+  bool Upsert(T key, Value_t value, bool);
   inline Value_t Get(T);
   Value_t Get(T key, bool is_in_epoch);
+  size_t GetBatch(const T *keys, size_t n, Value_t *out);
   void TryMerge(uint64_t);
   void Directory_Doubling(int x, Table<T> *new_b, Table<T> *old_b);
   void Directory_Merge_Update(Directory<T> *_sa, uint64_t key_hash,
@@ -1534,6 +1743,40 @@ class Finger_EH : public Hash<T> {
 #endif
     return hash_Utilization();
   }
+  /* Same directory walk as utiliz(), but filling the incremental stats
+   * surface: item counts and probe histogram come from the counters the
+   * operation paths maintain, capacity and stash occupancy from the
+   * structure. */
+  hash_stats_t Stats() {
+    hash_stats_t st = this->tstats_.snapshot();
+    Directory<T> *seg = dir;
+    Table<T> **dir_entry = seg->_;
+    Table<T> *ss;
+    auto global_depth = seg->global_depth;
+    size_t depth_diff;
+    size_t seg_count = 0;
+    size_t stash_used = 0;
+    size_t capacity = pow(2, global_depth);
+    for (size_t i = 0; i < capacity;) {
+      ss = reinterpret_cast<Table<T> *>(
+          reinterpret_cast<uint64_t>(dir_entry[i]) & tailMask);
+      depth_diff = global_depth - ss->local_depth;
+      seg_count++;
+      for (int j = 0; j < stashBucket; ++j) {
+        if (GET_COUNT((ss->bucket + kNumBucket + j)->bitmap) != 0)
+          stash_used++;
+      }
+      i += pow(2, depth_diff);
+    }
+    st.directory_depth = global_depth;
+    st.capacity = seg_count * kNumPairPerBucket * (kNumBucket + stashBucket);
+    st.overflow_buckets = stash_used;
+    st.pm_bytes =
+        seg_count * sizeof(Table<T>) + capacity * sizeof(Table<T> *);
+    if (st.capacity)
+      st.load_factor = static_cast<double>(st.items) / st.capacity;
+    return st;
+  }
   void getNumber() {
     std::cout << "The size of the bucket is " << sizeof(struct Bucket<T>)
               << std::endl;
@@ -1575,6 +1818,61 @@ class Finger_EH : public Hash<T> {
 #endif
   }
 
+  /* Emits every live pair of one segment. Buckets a few steps ahead of
+   * the consume pointer are prefetched (a bucket is four cachelines),
+   * so the walk is limited by memory bandwidth rather than by
+   * demand-miss latency. Each pair occupies exactly one physical slot
+   * (probed and stashed entries are not duplicated), so the bitmap walk
+   * reports each item once. */
+  template <class CB>
+  void scan_segment(Table<T> *ss, CB &&callback) {
+    constexpr int kPrefetchAhead = 4;
+    for (int b = 0; b < kNumBucket + stashBucket; ++b) {
+      if (b + kPrefetchAhead < kNumBucket + stashBucket) {
+        auto line = reinterpret_cast<const char *>(ss->bucket +
+                                                   (b + kPrefetchAhead));
+        for (size_t off = 0; off < sizeof(Bucket<T>); off += kCacheLineSize) {
+          _mm_prefetch(line + off, _MM_HINT_T0);
+        }
+      }
+      Bucket<T> *curr_bucket = ss->bucket + b;
+      auto mask = GET_BITMAP(curr_bucket->bitmap);
+      for (int j = 0; j < kNumPairPerBucket; ++j) {
+        if (CHECK_BIT(mask, j)) {
+          callback(untag_var_key(curr_bucket->_[j].key),
+                   curr_bucket->_[j].value);
+        }
+      }
+    }
+  }
+
+  /* Full-table scan over the directory slots [begin, end): the caller
+   * partitions [0, 2^global_depth) into contiguous slices and fans them
+   * out to its own threads, one scan_directory call per slice. A
+   * segment with local depth below the global depth appears in several
+   * consecutive slots; it is owned by (and reported from) its first
+   * slot only, so slices never report the same segment twice. The scan
+   * is unsynchronized like the rest of the read path: run it inside an
+   * epoch guard, and expect pairs moved by a concurrent split to be
+   * seen at their old or their new home. */
+  template <class CB>
+  void scan_directory(size_t begin, size_t end, CB &&callback) {
+    Directory<T> *seg = dir;
+    Table<T> **dir_entry = seg->_;
+    size_t capacity = pow(2, seg->global_depth);
+    if (end > capacity) end = capacity;
+    for (size_t i = begin; i < end;) {
+      auto ss = reinterpret_cast<Table<T> *>(
+          reinterpret_cast<uint64_t>(dir_entry[i]) & tailMask);
+      size_t chunk = pow(2, seg->global_depth - ss->local_depth);
+      size_t first = i & ~(chunk - 1);
+      if (first >= begin) {
+        scan_segment(ss, callback);
+      }
+      i = first + chunk;
+    }
+  }
+
   void recoverTable(Table<T> **target_table, size_t, size_t, Directory<T> *);
   bool Recovery();
 
@@ -1593,6 +1891,19 @@ class Finger_EH : public Hash<T> {
   }
 
   Directory<T> *dir;
+#ifdef DASH_COMPACT_DIR
+  /* DRAM mirror pointer; garbage after a restart, rebuilt in Recovery */
+  std::atomic<CompactDir<T> *> cdir;
+
+  /* mirror one PM entry write; a no-op when the mirror belongs to
+   * another directory generation (the doubling rebuild catches up) */
+  inline void compact_set(Directory<T> *_sa, size_t idx, uint64_t seg) {
+    auto cd = cdir.load(std::memory_order_acquire);
+    if (_sa == dir && cd->global_depth == _sa->global_depth)
+      cd->entry[idx].store(CompactDir<T>::Pack(seg & tailMask),
+                           std::memory_order_release);
+  }
+#endif
   int lock;
   uint64_t
       crash_version; /*when the crash version equals to 0Xff => set the crash
@@ -1629,6 +1940,10 @@ Finger_EH<T>::Finger_EH(size_t initCap, PMEMobjpool *_pool) {
     dir->_[i]->state = 0;
   }
   dir->depth_count = initCap;
+#ifdef DASH_COMPACT_DIR
+  cdir.store(CompactDir<T>::Build(dir, crash_version),
+             std::memory_order_release);
+#endif
 }
 
 template <class T>
@@ -1708,6 +2023,10 @@ void Finger_EH<T>::Halve_Directory() {
   TX_END
 #else
   dir = new_dir;
+#endif
+#ifdef DASH_COMPACT_DIR
+  cdir.store(CompactDir<T>::Build(dir, crash_version),
+             std::memory_order_release);
 #endif
   std::cout << "End::Directory_Halving towards " << dir->global_depth
             << std::endl;
@@ -1760,6 +2079,12 @@ void Finger_EH<T>::Directory_Doubling(int x, Table<T> *new_b, Table<T> *old_b) {
 #else
   dir = new_sa;
 #endif
+#ifdef DASH_COMPACT_DIR
+  /* still inside the split's critical section: readers that raced the
+   * swap retry off the bucket version locks, like PM directory reads */
+  cdir.store(CompactDir<T>::Build(dir, crash_version),
+             std::memory_order_release);
+#endif
 }
 
 template <class T>
@@ -1780,6 +2105,9 @@ void Finger_EH<T>::Directory_Update(Directory<T> *_sa, int x, Table<T> *new_b,
       }
       TX_ONABORT { std::cout << "Error for update txn" << std::endl; }
       TX_END
+#ifdef DASH_COMPACT_DIR
+      compact_set(_sa, x + 1, reinterpret_cast<uint64_t>(new_b));
+#endif
     } else {
       TX_BEGIN(pool_addr) {
         pmemobj_tx_add_range_direct(&dir_entry[x], sizeof(Table<T> *));
@@ -1791,6 +2119,9 @@ void Finger_EH<T>::Directory_Update(Directory<T> *_sa, int x, Table<T> *new_b,
       }
       TX_ONABORT { std::cout << "Error for update txn" << std::endl; }
       TX_END
+#ifdef DASH_COMPACT_DIR
+      compact_set(_sa, x, reinterpret_cast<uint64_t>(new_b));
+#endif
     }
 #ifdef COUNTING
     __sync_fetch_and_add(&_sa->depth_count, 2);
@@ -1812,6 +2143,10 @@ void Finger_EH<T>::Directory_Update(Directory<T> *_sa, int x, Table<T> *new_b,
     }
     TX_ONABORT { std::cout << "Error for update txn" << std::endl; }
     TX_END
+#ifdef DASH_COMPACT_DIR
+    for (int i = base - 1; i >= 0; --i)
+      compact_set(_sa, x + base + i, reinterpret_cast<uint64_t>(new_b));
+#endif
   }
   // printf("Done!directory update for %d\n", x);
 }
@@ -1829,6 +2164,9 @@ void Finger_EH<T>::Directory_Merge_Update(Directory<T> *_sa, uint64_t key_hash,
   for (int i = right; i < right + chunk_size / 2; ++i) {
     dir_entry[i] = left_seg;
     Allocator::Persist(&dir_entry[i], sizeof(uint64_t));
+#ifdef DASH_COMPACT_DIR
+    compact_set(_sa, i, reinterpret_cast<uint64_t>(left_seg));
+#endif
   }
 
   if ((left_seg->local_depth + 1) == global_depth) {
@@ -1887,6 +2225,9 @@ void Finger_EH<T>::recoverTable(Table<T> **target_table, size_t key_hash,
   for (int i = x; i < (x + chunk_size); ++i) {
     dir_entry[i] = reinterpret_cast<Table<T> *>(
         (reinterpret_cast<uint64_t>(dir_entry[i]) & tailMask) | crash_version);
+#ifdef DASH_COMPACT_DIR
+    compact_set(old_sa, i, reinterpret_cast<uint64_t>(dir_entry[i]));
+#endif
   }
   *target_table = reinterpret_cast<Table<T> *>(
       reinterpret_cast<uint64_t>(target) | crash_version);
@@ -1898,6 +2239,11 @@ bool Finger_EH<T>::Recovery() {
    * segment to indicate that this segment is clean*/
   if (clean) {
     clean = false;
+#ifdef DASH_COMPACT_DIR
+    /* clean restart still invalidates the DRAM mirror pointer */
+    cdir.store(CompactDir<T>::Build(dir, crash_version),
+               std::memory_order_release);
+#endif
     return false;
   }
   Allocator::EpochRecovery();
@@ -1920,6 +2266,11 @@ bool Finger_EH<T>::Recovery() {
     }
     Allocator::Persist(dir_entry, sizeof(uint64_t) * length);
   }
+#ifdef DASH_COMPACT_DIR
+  /* the PM-resident mirror pointer is from the previous run */
+  cdir.store(CompactDir<T>::Build(dir, crash_version),
+             std::memory_order_release);
+#endif
   return true;
 }
 
@@ -2040,6 +2391,29 @@ Value_t Finger_EH<T>::Get(T key, bool is_in_epoch) {
   }
   auto meta_hash = ((uint8_t)(key_hash & kMask));  // the last 8 bits
 RETRY:
+#ifdef DASH_COMPACT_DIR
+  /* first hop through the packed mirror: 4 bytes per entry, twice the
+   * directory per cache level; invalid slots take the PM path below */
+  auto cd = cdir.load(std::memory_order_acquire);
+  auto x = (key_hash >> (8 * sizeof(key_hash) - cd->global_depth));
+  auto y = BUCKET_INDEX(key_hash);
+  uint32_t packed = cd->entry[x].load(std::memory_order_acquire);
+  Table<T> *target;
+  if (packed != kCompactInvalid) {
+    target = CompactDir<T>::Unpack(packed);
+  } else {
+    auto old_sa = dir;
+    auto xx = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
+    auto old_entry = old_sa->_[xx];
+    target = reinterpret_cast<Table<T> *>(
+        reinterpret_cast<uint64_t>(old_entry) & tailMask);
+    if ((reinterpret_cast<uint64_t>(old_entry) & headerMask) !=
+        crash_version) {
+      recoverTable(&old_sa->_[xx], key_hash, xx, old_sa);
+      goto RETRY;
+    }
+  }
+#else
   auto old_sa = dir;
   auto x = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
   auto y = BUCKET_INDEX(key_hash);
@@ -2052,6 +2426,7 @@ RETRY:
     recoverTable(&dir_entry[x], key_hash, x, old_sa);
     goto RETRY;
   }
+#endif
 
   Bucket<T> *target_bucket = target->bucket + y;
   Bucket<T> *neighbor_bucket = target->bucket + ((y + 1) & bucketMask);
@@ -2066,11 +2441,18 @@ RETRY:
   }
 
   /*verification procedure*/
+#ifdef DASH_COMPACT_DIR
+  if (cdir.load(std::memory_order_acquire) != cd ||
+      cd->entry[x].load(std::memory_order_acquire) != packed) {
+    goto RETRY;
+  }
+#else
   old_sa = dir;
   x = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
   if (old_sa->_[x] != old_entry) {
     goto RETRY;
   }
+#endif
 
   auto ret = target_bucket->check_and_get(meta_hash, key, false);
   if (target_bucket->test_lock_version_change(old_version)) {
@@ -2159,6 +2541,48 @@ FINAL:
   return NONE;
 }
 
+/* Software-pipelined batch lookup; the caller holds the epoch. Pass one
+ * hashes every key in the window and prefetches its directory entry;
+ * pass two resolves the segment (buckets are inline, so this is address
+ * arithmetic on the warmed entry) and prefetches the target and
+ * neighbor bucket headers; pass three completes the probes in order
+ * through Get, reusing the version-retry, stash and recovery logic on
+ * warm lines. The prefetch passes are purely advisory — a stale or
+ * crash-tagged entry just wastes the hint and Get revalidates. */
+template <class T>
+size_t Finger_EH<T>::GetBatch(const T *keys, size_t n, Value_t *out) {
+  constexpr size_t W = 16;
+  uint64_t hs[W];
+  size_t found = 0;
+  for (size_t base = 0; base < n; base += W) {
+    size_t lim = std::min(W, n - base);
+    auto old_sa = dir;
+    auto dir_entry = old_sa->_;
+    for (size_t i = 0; i < lim; ++i) {
+      if constexpr (std::is_pointer_v<T>) {
+        hs[i] = h(keys[base + i]->key, keys[base + i]->length);
+      } else {
+        hs[i] = h(&keys[base + i], sizeof(keys[base + i]));
+      }
+      auto x = (hs[i] >> (8 * sizeof(uint64_t) - old_sa->global_depth));
+      __builtin_prefetch(&dir_entry[x]);
+    }
+    for (size_t i = 0; i < lim; ++i) {
+      auto x = (hs[i] >> (8 * sizeof(uint64_t) - old_sa->global_depth));
+      Table<T> *target = reinterpret_cast<Table<T> *>(
+          reinterpret_cast<uint64_t>(dir_entry[x]) & tailMask);
+      auto y = BUCKET_INDEX(hs[i]);
+      __builtin_prefetch(target->bucket + y);
+      __builtin_prefetch(target->bucket + ((y + 1) & bucketMask));
+    }
+    for (size_t i = 0; i < lim; ++i) {
+      out[base + i] = Get(keys[base + i], true);
+      if (out[base + i] != NONE) found++;
+    }
+  }
+  return found;
+}
+
 template <class T>
 Value_t Finger_EH<T>::Get(T key) {
   uint64_t key_hash;
@@ -2169,6 +2593,29 @@ Value_t Finger_EH<T>::Get(T key) {
   }
   auto meta_hash = ((uint8_t)(key_hash & kMask));  // the last 8 bits
 RETRY:
+#ifdef DASH_COMPACT_DIR
+  /* first hop through the packed mirror: 4 bytes per entry, twice the
+   * directory per cache level; invalid slots take the PM path below */
+  auto cd = cdir.load(std::memory_order_acquire);
+  auto x = (key_hash >> (8 * sizeof(key_hash) - cd->global_depth));
+  auto y = BUCKET_INDEX(key_hash);
+  uint32_t packed = cd->entry[x].load(std::memory_order_acquire);
+  Table<T> *target;
+  if (packed != kCompactInvalid) {
+    target = CompactDir<T>::Unpack(packed);
+  } else {
+    auto old_sa = dir;
+    auto xx = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
+    auto old_entry = old_sa->_[xx];
+    target = reinterpret_cast<Table<T> *>(
+        reinterpret_cast<uint64_t>(old_entry) & tailMask);
+    if ((reinterpret_cast<uint64_t>(old_entry) & headerMask) !=
+        crash_version) {
+      recoverTable(&old_sa->_[xx], key_hash, xx, old_sa);
+      goto RETRY;
+    }
+  }
+#else
   auto old_sa = dir;
   auto x = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
   auto y = BUCKET_INDEX(key_hash);
@@ -2181,6 +2628,7 @@ RETRY:
     recoverTable(&dir_entry[x], key_hash, x, old_sa);
     goto RETRY;
   }
+#endif
 
   Bucket<T> *target_bucket = target->bucket + y;
   Bucket<T> *neighbor_bucket = target->bucket + ((y + 1) & bucketMask);
@@ -2195,17 +2643,25 @@ RETRY:
   }
 
   /*verification procedure*/
+#ifdef DASH_COMPACT_DIR
+  if (cdir.load(std::memory_order_acquire) != cd ||
+      cd->entry[x].load(std::memory_order_acquire) != packed) {
+    goto RETRY;
+  }
+#else
   old_sa = dir;
   x = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
   if (old_sa->_[x] != old_entry) {
     goto RETRY;
   }
+#endif
 
   auto ret = target_bucket->check_and_get(meta_hash, key, false);
   if (target_bucket->test_lock_version_change(old_version)) {
     goto RETRY;
   }
   if (ret != NONE) {
+    this->tstats_.record_probe(1);
     return ret;
   }
 
@@ -2214,6 +2670,7 @@ RETRY:
     goto RETRY;
   }
   if (ret != NONE) {
+    this->tstats_.record_probe(2);
     return ret;
   }
 
@@ -2240,6 +2697,7 @@ RETRY:
               if (target_bucket->test_lock_version_change(old_version)) {
                 goto RETRY;
               }
+              this->tstats_.record_probe(3);
               return ret;
             }
           }
@@ -2260,6 +2718,7 @@ RETRY:
               if (target_bucket->test_lock_version_change(old_version)) {
                 goto RETRY;
               }
+              this->tstats_.record_probe(3);
               return ret;
             }
           }
@@ -2277,12 +2736,15 @@ RETRY:
           if (target_bucket->test_lock_version_change(old_version)) {
             goto RETRY;
           }
+          this->tstats_.record_probe(3);
           return ret;
         }
       }
     }
   }
 FINAL:
+  // Misses land in the last histogram bin.
+  this->tstats_.record_probe(table_stats::kProbeBuckets - 1);
   return NONE;
 }
 
@@ -2557,6 +3019,358 @@ RETRY:
   return false;
 }
 
+/*dirty write-backs are deduplicated by address: several deletions in
+ * one bucket touch the same bitmap word*/
+static inline void note_dirty(std::vector<std::pair<char *, size_t>> &dirty,
+                              void *ptr, size_t size) {
+  for (auto &d : dirty) {
+    if (d.first == reinterpret_cast<char *>(ptr)) {
+      return;
+    }
+  }
+  dirty.emplace_back(reinterpret_cast<char *>(ptr), size);
+}
+
+/*One key of DeleteBatch: same probe and locking as Delete, but the
+ * caller already holds the epoch, bitmap write-backs are queued for a
+ * coalesced flush instead of fenced one by one (Delete also persists
+ * after dropping the bucket locks, so the deferral does not weaken the
+ * crash story), and empty-segment merges are pushed to the segment
+ * group boundary*/
+template <class T>
+bool Finger_EH<T>::DeleteDeferred(
+    T key, uint64_t key_hash, std::vector<std::pair<char *, size_t>> &dirty,
+    std::vector<uint64_t> &merges) {
+  auto meta_hash = ((uint8_t)(key_hash & kMask));  // the last 8 bits
+RETRY:
+  auto old_sa = dir;
+  auto x = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
+  auto dir_entry = old_sa->_;
+  Table<T> *target_table = reinterpret_cast<Table<T> *>(
+      reinterpret_cast<uint64_t>(dir_entry[x]) & tailMask);
+
+  if ((reinterpret_cast<uint64_t>(dir_entry[x]) & headerMask) !=
+      crash_version) {
+    recoverTable(&dir_entry[x], key_hash, x, old_sa);
+    goto RETRY;
+  }
+
+  /*we need to first do the locking and then do the verify*/
+  auto y = BUCKET_INDEX(key_hash);
+  Bucket<T> *target = target_table->bucket + y;
+  Bucket<T> *neighbor = target_table->bucket + ((y + 1) & bucketMask);
+  target->get_lock();
+  if (!neighbor->try_get_lock()) {
+    target->release_lock();
+    goto RETRY;
+  }
+
+  old_sa = dir;
+  x = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
+  if (reinterpret_cast<Table<T> *>(reinterpret_cast<uint64_t>(old_sa->_[x]) &
+                                   tailMask) != target_table) {
+    target->release_lock();
+    neighbor->release_lock();
+    goto RETRY;
+  }
+
+  auto ret = target->Delete(key, meta_hash, false);
+  if (ret == 0) {
+#ifdef COUNTING
+    auto num = SUB(&target_table->number, 1);
+#endif
+    target->release_lock();
+#ifdef PMEM
+    note_dirty(dirty, &target->bitmap, sizeof(target->bitmap));
+#endif
+    neighbor->release_lock();
+#ifdef COUNTING
+    if (num == 0) {
+      merges.push_back(key_hash);
+    }
+#endif
+    return true;
+  }
+
+  ret = neighbor->Delete(key, meta_hash, true);
+  if (ret == 0) {
+#ifdef COUNTING
+    auto num = SUB(&target_table->number, 1);
+#endif
+    neighbor->release_lock();
+#ifdef PMEM
+    note_dirty(dirty, &neighbor->bitmap, sizeof(neighbor->bitmap));
+#endif
+    target->release_lock();
+#ifdef COUNTING
+    if (num == 0) {
+      merges.push_back(key_hash);
+    }
+#endif
+    return true;
+  }
+
+  if (target->test_stash_check()) {
+    auto test_stash = false;
+    if (target->test_overflow()) {
+      test_stash = true;
+    } else {
+      int mask = target->overflowBitmap & overflowBitmapMask;
+      if (mask != 0) {
+        for (int i = 0; i < 4; ++i) {
+          if (CHECK_BIT(mask, i) &&
+              (target->finger_array[14 + i] == meta_hash) &&
+              (((1 << i) & target->overflowMember) == 0)) {
+            test_stash = true;
+            goto TEST_STASH;
+          }
+        }
+      }
+
+      mask = neighbor->overflowBitmap & overflowBitmapMask;
+      if (mask != 0) {
+        for (int i = 0; i < 4; ++i) {
+          if (CHECK_BIT(mask, i) &&
+              (neighbor->finger_array[14 + i] == meta_hash) &&
+              (((1 << i) & neighbor->overflowMember) != 0)) {
+            test_stash = true;
+            break;
+          }
+        }
+      }
+    }
+
+  TEST_STASH:
+    if (test_stash == true) {
+      Bucket<T> *stash = target_table->bucket + kNumBucket;
+      stash->get_lock();
+      for (int i = 0; i < stashBucket; ++i) {
+        int index = ((i + (y & stashMask)) & stashMask);
+        Bucket<T> *curr_stash = target_table->bucket + kNumBucket + index;
+        auto ret = curr_stash->Delete(key, meta_hash, false);
+        if (ret == 0) {
+          /*need to unset indicator in original bucket*/
+          stash->release_lock();
+#ifdef PMEM
+          note_dirty(dirty, &curr_stash->bitmap, sizeof(curr_stash->bitmap));
+#endif
+          auto bucket_ix = BUCKET_INDEX(key_hash);
+          auto org_bucket = target_table->bucket + bucket_ix;
+          assert(org_bucket == target);
+          target->unset_indicator(meta_hash, neighbor, key, index);
+#ifdef COUNTING
+          auto num = SUB(&target_table->number, 1);
+#endif
+          neighbor->release_lock();
+          target->release_lock();
+#ifdef COUNTING
+          if (num == 0) {
+            merges.push_back(key_hash);
+          }
+#endif
+          return true;
+        }
+      }
+      stash->release_lock();
+    }
+  }
+  neighbor->release_lock();
+  target->release_lock();
+  return false;
+}
+
+/*Batched range expiry: one epoch guard covers the whole batch, so a
+ * single enter/leave and one garbage-retirement window replace n of
+ * them. Keys are ordered by directory slot so each segment's
+ * deletions run back-to-back: its bucket lines and locks stay hot,
+ * the queued bitmap write-backs are flushed unfenced with one drain
+ * per segment, and deferred merges run once at the group boundary.
+ * Returns how many of the keys existed*/
+template <class T>
+size_t Finger_EH<T>::DeleteBatch(const T *keys, size_t n) {
+  if (n == 0) {
+    return 0;
+  }
+#ifdef PMEM
+  auto epoch_guard = Allocator::AquireEpochGuard();
+#endif
+  std::vector<uint64_t> hashes(n);
+  std::vector<uint32_t> order(n);
+  for (size_t i = 0; i < n; ++i) {
+    if constexpr (std::is_pointer_v<T>) {
+      hashes[i] = h(keys[i]->key, keys[i]->length);
+    } else {
+      hashes[i] = h(&keys[i], sizeof(keys[i]));
+    }
+    order[i] = (uint32_t)i;
+  }
+  /*grouping is a locality hint, so a directory doubling racing with
+   * the batch costs nothing but grouping quality*/
+  auto depth = dir->global_depth;
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return (hashes[a] >> (8 * sizeof(uint64_t) - depth)) <
+           (hashes[b] >> (8 * sizeof(uint64_t) - depth));
+  });
+
+  size_t removed = 0;
+  std::vector<std::pair<char *, size_t>> dirty;
+  std::vector<uint64_t> merges;
+  auto flush_group = [&]() {
+#ifdef PMEM
+    if (!dirty.empty()) {
+      for (auto &d : dirty) {
+        Allocator::Flush(d.first, d.second);
+      }
+      Allocator::Drain();
+    }
+#endif
+    dirty.clear();
+    for (auto merge_hash : merges) {
+      TryMerge(merge_hash);
+    }
+    merges.clear();
+  };
+
+  uint64_t prev_x = 0;
+  for (size_t i = 0; i < n; ++i) {
+    auto idx = order[i];
+    auto x = (hashes[idx] >> (8 * sizeof(uint64_t) - depth));
+    if (i != 0 && x != prev_x) {
+      flush_group();
+    }
+    prev_x = x;
+    if (DeleteDeferred(keys[idx], hashes[idx], dirty, merges)) {
+      removed++;
+    }
+  }
+  flush_group();
+  return removed;
+}
+
+template <class T>
+bool Finger_EH<T>::Upsert(T key, Value_t value, bool is_in_epoch) {
+  if (!is_in_epoch) {
+    auto epoch_guard = Allocator::AquireEpochGuard();
+    return Upsert(key, value);
+  }
+  return Upsert(key, value);
+}
+
+/*Insert the key, or overwrite its value in place when it already exists;
+ * the probe walks the same target/neighbor/stash path as Delete and only
+ * falls back to the regular insert when the key is absent*/
+template <class T>
+bool Finger_EH<T>::Upsert(T key, Value_t value) {
+  uint64_t key_hash;
+  if constexpr (std::is_pointer_v<T>) {
+    key_hash = h(key->key, key->length);
+  } else {
+    key_hash = h(&key, sizeof(key));
+  }
+  auto meta_hash = ((uint8_t)(key_hash & kMask));  // the last 8 bits
+RETRY:
+  auto old_sa = dir;
+  auto x = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
+  auto dir_entry = old_sa->_;
+  Table<T> *target_table = reinterpret_cast<Table<T> *>(
+      reinterpret_cast<uint64_t>(dir_entry[x]) & tailMask);
+
+  if ((reinterpret_cast<uint64_t>(dir_entry[x]) & headerMask) !=
+      crash_version) {
+    recoverTable(&dir_entry[x], key_hash, x, old_sa);
+    goto RETRY;
+  }
+
+  /*we need to first do the locking and then do the verify*/
+  auto y = BUCKET_INDEX(key_hash);
+  Bucket<T> *target = target_table->bucket + y;
+  Bucket<T> *neighbor = target_table->bucket + ((y + 1) & bucketMask);
+  target->get_lock();
+  if (!neighbor->try_get_lock()) {
+    target->release_lock();
+    goto RETRY;
+  }
+
+  old_sa = dir;
+  x = (key_hash >> (8 * sizeof(key_hash) - old_sa->global_depth));
+  if (reinterpret_cast<Table<T> *>(reinterpret_cast<uint64_t>(old_sa->_[x]) &
+                                   tailMask) != target_table) {
+    target->release_lock();
+    neighbor->release_lock();
+    goto RETRY;
+  }
+
+  auto ret = target->Update(key, value, meta_hash, false);
+  if (ret == 0) {
+    target->release_lock();
+    neighbor->release_lock();
+    return true;
+  }
+
+  ret = neighbor->Update(key, value, meta_hash, true);
+  if (ret == 0) {
+    neighbor->release_lock();
+    target->release_lock();
+    return true;
+  }
+
+  if (target->test_stash_check()) {
+    auto test_stash = false;
+    if (target->test_overflow()) {
+      test_stash = true;
+    } else {
+      /*search in the original bucket*/
+      int mask = target->overflowBitmap & overflowBitmapMask;
+      if (mask != 0) {
+        for (int i = 0; i < 4; ++i) {
+          if (CHECK_BIT(mask, i) &&
+              (target->finger_array[14 + i] == meta_hash) &&
+              (((1 << i) & target->overflowMember) == 0)) {
+            test_stash = true;
+            goto TEST_STASH;
+          }
+        }
+      }
+
+      mask = neighbor->overflowBitmap & overflowBitmapMask;
+      if (mask != 0) {
+        for (int i = 0; i < 4; ++i) {
+          if (CHECK_BIT(mask, i) &&
+              (neighbor->finger_array[14 + i] == meta_hash) &&
+              (((1 << i) & neighbor->overflowMember) != 0)) {
+            test_stash = true;
+            break;
+          }
+        }
+      }
+    }
+
+  TEST_STASH:
+    if (test_stash == true) {
+      Bucket<T> *stash = target_table->bucket + kNumBucket;
+      stash->get_lock();
+      for (int i = 0; i < stashBucket; ++i) {
+        int index = ((i + (y & stashMask)) & stashMask);
+        Bucket<T> *curr_stash = target_table->bucket + kNumBucket + index;
+        auto ret = curr_stash->Update(key, value, meta_hash, false);
+        if (ret == 0) {
+          /*the overflow indicator in the original bucket stays valid*/
+          stash->release_lock();
+          neighbor->release_lock();
+          target->release_lock();
+          return true;
+        }
+      }
+      stash->release_lock();
+    }
+  }
+  neighbor->release_lock();
+  target->release_lock();
+  /*the key is absent: take the regular insert path (which re-probes, but
+   * only on the miss side of the upsert)*/
+  return Insert(key, value, true);
+}
+
 /*DEBUG FUNCTION: search the position of the key in this table and print
  * correspongdign informantion in this table, to test whether it is correct*/
 
@@ -18,5 +18,7 @@ extern "C" hash_api* create_tree(const tree_options_t& opt, unsigned sz = 0) {
   } else {
     new (hash_table) linear::Linear<uint64_t>();
   }
+  if (opt.value_size <= hash_table->max_inline_value_size())
+    hash_table->set_inline_value_size(opt.value_size);
   return hash_table;
 }
\ No newline at end of file
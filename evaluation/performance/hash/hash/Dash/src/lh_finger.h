@@ -11,6 +11,7 @@
 
 #include <immintrin.h>
 
+#include <atomic>
 #include <bitset>
 #include <cassert>
 #include <cmath>
@@ -24,6 +25,7 @@
 #include "Hash.h"
 #include "allocator.h"
 #include "hash.h"
+#include "resize_governor.h"
 #define DOUBLE_EXPANSION 1
 
 #ifdef PMEM
@@ -87,6 +89,18 @@ inline bool var_compare(char *str1, char *str2, int len1, int len2) {
   return !memcmp(str1, str2, len1);
 }
 
+/* Matches a stored (prefix-tagged) key pointer against the probe key.
+ * The two key bytes packed into the stored pointer's top bits reject
+ * most fingerprint false positives without touching the out-of-line
+ * key's cache line. */
+template <class K>
+static inline bool var_match(K stored, string_key *probe) {
+  auto bits = reinterpret_cast<uint64_t>(stored);
+  if ((bits & ~varKeyPtrMask) != var_key_prefix(probe)) return false;
+  auto curr = reinterpret_cast<string_key *>(bits & varKeyPtrMask);
+  return var_compare(curr->key, probe->key, curr->length, probe->length);
+}
+
 inline uint32_t pow2(int shift_index) { return (1 << shift_index); }
 
 inline uint64_t IDX(uint64_t hashKey, uint64_t level) {
@@ -152,39 +166,33 @@ struct overflowBucket {
       if (mask != 0) {
         for (int i = 0; i < 12; i += 4) {
           if (CHECK_BIT(mask, i) &&
-              (var_compare(_[i].key->key, key->key, _[i].key->length,
-                           key->length))) {
+              (var_match(_[i].key, key))) {
             return _[i].value;
           }
 
           if (CHECK_BIT(mask, i + 1) &&
-              (var_compare(_[i + 1].key->key, key->key, _[i + 1].key->length,
-                           key->length))) {
+              (var_match(_[i + 1].key, key))) {
             return _[i + 1].value;
           }
 
           if (CHECK_BIT(mask, i + 2) &&
-              (var_compare(_[i + 2].key->key, key->key, _[i + 2].key->length,
-                           key->length))) {
+              (var_match(_[i + 2].key, key))) {
             return _[i + 2].value;
           }
 
           if (CHECK_BIT(mask, i + 3) &&
-              (var_compare(_[i + 3].key->key, key->key, _[i + 3].key->length,
-                           key->length))) {
+              (var_match(_[i + 3].key, key))) {
             return _[i + 3].value;
           }
         }
 
         if (CHECK_BIT(mask, 12) &&
-            (var_compare(_[12].key->key, key->key, _[12].key->length,
-                         key->length))) {
+            (var_match(_[12].key, key))) {
           return _[12].value;
         }
 
         if (CHECK_BIT(mask, 13) &&
-            (var_compare(_[13].key->key, key->key, _[13].key->length,
-                         key->length))) {
+            (var_match(_[13].key, key))) {
           return _[13].value;
         }
       }
@@ -262,7 +270,7 @@ struct overflowBucket {
       return -1;
     }
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
 #ifdef PMEM
     Allocator::Persist(&_[slot], sizeof(_[slot]));
 #endif
@@ -279,44 +287,38 @@ struct overflowBucket {
       if (mask != 0) {
         for (int i = 0; i < 12; i += 4) {
           if (CHECK_BIT(mask, i) &&
-              (var_compare(_[i].key->key, key->key, _[i].key->length,
-                           key->length))) {
+              (var_match(_[i].key, key))) {
             unset_hash(i);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 1) &&
-              (var_compare(_[i + 1].key->key, key->key, _[i + 1].key->length,
-                           key->length))) {
+              (var_match(_[i + 1].key, key))) {
             unset_hash(i + 1);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 2) &&
-              (var_compare(_[i + 2].key->key, key->key, _[i + 2].key->length,
-                           key->length))) {
+              (var_match(_[i + 2].key, key))) {
             unset_hash(i + 2);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 3) &&
-              (var_compare(_[i + 3].key->key, key->key, _[i + 3].key->length,
-                           key->length))) {
+              (var_match(_[i + 3].key, key))) {
             unset_hash(i + 3);
             return 0;
           }
         }
 
         if (CHECK_BIT(mask, 12) &&
-            (var_compare(_[12].key->key, key->key, _[12].key->length,
-                         key->length))) {
+            (var_match(_[12].key, key))) {
           unset_hash(12);
           return 0;
         }
 
         if (CHECK_BIT(mask, 13) &&
-            (var_compare(_[13].key->key, key->key, _[13].key->length,
-                         key->length))) {
+            (var_match(_[13].key, key))) {
           unset_hash(13);
           return 0;
         }
@@ -367,7 +369,7 @@ struct overflowBucket {
       return -1;
     }
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
     set_hash(slot, meta_hash);
     return 0;
   }
@@ -563,39 +565,33 @@ struct Bucket {
       if (mask != 0) {
         for (int i = 0; i < 12; i += 4) {
           if (CHECK_BIT(mask, i) &&
-              (var_compare(_[i].key->key, key->key, _[i].key->length,
-                           key->length))) {
+              (var_match(_[i].key, key))) {
             return _[i].value;
           }
 
           if (CHECK_BIT(mask, i + 1) &&
-              (var_compare(_[i + 1].key->key, key->key, _[i + 1].key->length,
-                           key->length))) {
+              (var_match(_[i + 1].key, key))) {
             return _[i + 1].value;
           }
 
           if (CHECK_BIT(mask, i + 2) &&
-              (var_compare(_[i + 2].key->key, key->key, _[i + 2].key->length,
-                           key->length))) {
+              (var_match(_[i + 2].key, key))) {
             return _[i + 2].value;
           }
 
           if (CHECK_BIT(mask, i + 3) &&
-              (var_compare(_[i + 3].key->key, key->key, _[i + 3].key->length,
-                           key->length))) {
+              (var_match(_[i + 3].key, key))) {
             return _[i + 3].value;
           }
         }
 
         if (CHECK_BIT(mask, 12) &&
-            (var_compare(_[12].key->key, key->key, _[12].key->length,
-                         key->length))) {
+            (var_match(_[12].key, key))) {
           return _[12].value;
         }
 
         if (CHECK_BIT(mask, 13) &&
-            (var_compare(_[13].key->key, key->key, _[13].key->length,
-                         key->length))) {
+            (var_match(_[13].key, key))) {
           return _[13].value;
         }
       }
@@ -714,7 +710,7 @@ struct Bucket {
       return -1;
     }
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
 #ifdef PMEM
     Allocator::Persist(&_[slot], sizeof(_[slot]));
 #endif
@@ -739,44 +735,38 @@ struct Bucket {
       if (mask != 0) {
         for (int i = 0; i < 12; i += 4) {
           if (CHECK_BIT(mask, i) &&
-              (var_compare(_[i].key->key, key->key, _[i].key->length,
-                           key->length))) {
+              (var_match(_[i].key, key))) {
             unset_hash(i);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 1) &&
-              (var_compare(_[i + 1].key->key, key->key, _[i + 1].key->length,
-                           key->length))) {
+              (var_match(_[i + 1].key, key))) {
             unset_hash(i + 1);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 2) &&
-              (var_compare(_[i + 2].key->key, key->key, _[i + 2].key->length,
-                           key->length))) {
+              (var_match(_[i + 2].key, key))) {
             unset_hash(i + 2);
             return 0;
           }
 
           if (CHECK_BIT(mask, i + 3) &&
-              (var_compare(_[i + 3].key->key, key->key, _[i + 3].key->length,
-                           key->length))) {
+              (var_match(_[i + 3].key, key))) {
             unset_hash(i + 3);
             return 0;
           }
         }
 
         if (CHECK_BIT(mask, 12) &&
-            (var_compare(_[12].key->key, key->key, _[12].key->length,
-                         key->length))) {
+            (var_match(_[12].key, key))) {
           unset_hash(12);
           return 0;
         }
 
         if (CHECK_BIT(mask, 13) &&
-            (var_compare(_[13].key->key, key->key, _[13].key->length,
-                         key->length))) {
+            (var_match(_[13].key, key))) {
           unset_hash(13);
           return 0;
         }
@@ -828,7 +818,7 @@ struct Bucket {
       return -1;
     }
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
     set_hash(slot, meta_hash, probe);
     return 0;
   }
@@ -836,7 +826,7 @@ struct Bucket {
   void Insert_displace(T key, Value_t value, uint8_t meta_hash, int slot,
                        bool probe) {
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
 #ifdef PMEM
     Allocator::Persist(&_[slot], sizeof(_Pair<T>));
 #endif
@@ -847,7 +837,7 @@ struct Bucket {
                                     int slot, bool probe) {
     assert(key != 0);
     _[slot].value = value;
-    _[slot].key = key;
+    _[slot].key = tag_var_key(key);
     set_hash(slot, meta_hash, probe);
   }
 
@@ -1222,7 +1212,7 @@ struct Table {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1247,7 +1237,7 @@ struct Table {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = next_bucket->_[j].key;
+            auto curr_key = untag_var_key(next_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(next_bucket->_[j].key), sizeof(Key_t));
@@ -1357,7 +1347,8 @@ void Table<T>::Split(Table<T> *org_table, uint64_t base_level, int org_idx,
       if (CHECK_BIT(mask, j)) {
         if constexpr (std::is_pointer_v<T>) {
           key_hash =
-              h(curr_bucket->_[j].key->key, curr_bucket->_[j].key->length);
+              h(untag_var_key(curr_bucket->_[j].key)->key,
+              untag_var_key(curr_bucket->_[j].key)->length);
         } else {
           key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
         }
@@ -1383,7 +1374,8 @@ void Table<T>::Split(Table<T> *org_table, uint64_t base_level, int org_idx,
       if (CHECK_BIT(mask, j)) {
         if constexpr (std::is_pointer_v<T>) {
           key_hash =
-              h(curr_bucket->_[j].key->key, curr_bucket->_[j].key->length);
+              h(untag_var_key(curr_bucket->_[j].key)->key,
+              untag_var_key(curr_bucket->_[j].key)->length);
         } else {
           key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
         }
@@ -1460,7 +1452,8 @@ void Table<T>::Split(Table<T> *org_table, uint64_t base_level, int org_idx,
       if (CHECK_BIT(mask, i)) {
         if constexpr (std::is_pointer_v<T>) {
           key_hash =
-              h(next_bucket->_[i].key->key, next_bucket->_[i].key->length);
+              h(untag_var_key(next_bucket->_[i].key)->key,
+              untag_var_key(next_bucket->_[i].key)->length);
         } else {
           key_hash = h(&(next_bucket->_[i].key), sizeof(Key_t));
         }
@@ -1544,7 +1537,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1564,7 +1557,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1585,7 +1578,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1608,7 +1601,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1627,7 +1620,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1647,7 +1640,7 @@ void Table<T>::Merge(Table<T> *neighbor, bool unique_check_flag) {
       for (int j = 0; j < kNumPairPerBucket; ++j) {
         if (CHECK_BIT(mask, j)) {
           if constexpr (std::is_pointer_v<T>) {
-            auto curr_key = curr_bucket->_[j].key;
+            auto curr_key = untag_var_key(curr_bucket->_[j].key);
             key_hash = h(curr_key->key, curr_key->length);
           } else {
             key_hash = h(&(curr_bucket->_[j].key), sizeof(Key_t));
@@ -1816,7 +1809,8 @@ void Table<T>::Insert4split(T key, Value_t value, size_t key_hash,
 
   /*some bucket may be overflowed?*/
   if (GET_COUNT(insert_target->bitmap) < kNumPairPerBucket) {
-    insert_target->_[GET_COUNT(insert_target->bitmap)].key = key;
+    insert_target->_[GET_COUNT(insert_target->bitmap)].key =
+        tag_var_key(key);
     insert_target->_[GET_COUNT(insert_target->bitmap)].value = value;
     insert_target->set_hash(GET_COUNT(insert_target->bitmap), meta_hash, probe);
 #ifdef COUNTING
@@ -1956,11 +1950,14 @@ class Linear : public Hash<T> {
   void FindAnyway(T key);
   bool Recovery();
   void ShutDown() {
+    expander_stop_.store(true);
+    if (expander_thread_.joinable()) expander_thread_.join();
     clean = true;
     Allocator::Persist(&clean, sizeof(clean));
   }
   bool TryMerge(uint64_t, Table<T> *);
   bool recoverSegment(Table<T> **seg_ptr, size_t, size_t, size_t);
+  void ExpanderLoop();
   std::string hash_name() { return "Dash_lh"; }
   float utiliz() {
     uint64_t count = 0;
@@ -2176,6 +2173,11 @@ class Linear : public Hash<T> {
   Directory<T> dir;
   int lock;
   bool clean;
+  /* Background expander (transient, rebuilt by either constructor):
+   * migrates the split images behind the split pointer so inserts do
+   * not perform Split() synchronously. */
+  std::thread expander_thread_;
+  std::atomic<bool> expander_stop_{false};
 };
 
 template <class T>
@@ -2197,16 +2199,80 @@ Linear<T>::Linear(PMEMobjpool *_pool) {
       curr_bucket->set_initialize();
     }
   }
+  expander_thread_ = std::thread(&Linear<T>::ExpanderLoop, this);
 }
 
 template <class T>
 Linear<T>::Linear(void) {
   std::cout << "Reinitialize Up for linear hashing" << std::endl;
+  expander_thread_ = std::thread(&Linear<T>::ExpanderLoop, this);
 }
 
 template <class T>
 Linear<T>::~Linear(void) {
-  // TO-DO
+  expander_stop_.store(true);
+  if (expander_thread_.joinable()) expander_thread_.join();
+}
+
+/* Walks the window of split images behind the split pointer and runs
+ * their migrations ahead of the writers. Expansion here is lazy:
+ * Expand() only advances N_next, and the first insert that lands on an
+ * uninitialized image pays the whole Split() of its original table.
+ * With the expander draining that window, steady-state inserts pay at
+ * most the N_next bump (one CAS); migration draws one governor token
+ * per table, so a latency-sensitive foreground throttles the expander
+ * rather than the other way around. Races with foreground splitters
+ * are benign — both sides take every bucket lock of the image and
+ * Split() re-migrates nothing on a second run — and segment arrays
+ * still marked for recovery are left to the foreground paths that
+ * clear the bits. */
+template <class T>
+void Linear<T>::ExpanderLoop() {
+  while (!expander_stop_.load(std::memory_order_relaxed)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    uint64_t old_N_next = dir.N_next;
+    uint32_t N = old_N_next >> 32;
+    uint32_t next = (uint32_t)old_N_next;
+    uint64_t lo = pow2(N);
+    for (uint64_t x = lo; x < lo + next; ++x) {
+      if (expander_stop_.load(std::memory_order_relaxed)) return;
+      uint32_t dir_idx;
+      uint32_t offset;
+      SEG_IDX_OFFSET(static_cast<uint32_t>(x), dir_idx, offset);
+      Table<T> *seg_arr = dir._[dir_idx];
+      if (seg_arr == NULL || seg_arr == reinterpret_cast<Table<T> *>(-1))
+        continue;
+      if (reinterpret_cast<uint64_t>(seg_arr) & recoverLockBit) continue;
+      Table<T> *target = seg_arr + offset;
+      if (target->bucket->test_initialize()) continue;
+
+      resize_governor::instance().admit(1);
+      for (int i = 0; i < kNumBucket; ++i) {
+        Bucket<T> *curr_bucket = target->bucket + i;
+        curr_bucket->get_lock();
+      }
+      /* a doubling moved the window out from under us; retry from the
+       * fresh N_next */
+      if ((dir.N_next >> 32) != N) {
+        for (int i = 0; i < kNumBucket; ++i) {
+          Bucket<T> *curr_bucket = target->bucket + i;
+          curr_bucket->release_lock();
+        }
+        break;
+      }
+      if (!target->bucket->test_initialize()) {
+        uint64_t org_idx;
+        uint64_t base_level;
+        Table<T> *org_table =
+            target->get_org_table(x, &org_idx, &base_level, &dir);
+        target->Split(org_table, base_level, org_idx, &dir);
+      }
+      for (int i = 0; i < kNumBucket; ++i) {
+        Bucket<T> *curr_bucket = target->bucket + i;
+        curr_bucket->release_lock();
+      }
+    }
+  }
 }
 
 template <class T>
@@ -2367,6 +2433,7 @@ bool Linear<T>::Insert(T key, Value_t value, bool is_in_epoch) {
 
 template <class T>
 bool Linear<T>::Insert(T key, Value_t value) {
+  auto sample = resize_governor::instance().sample_op();
   bool resize = false;
   uint64_t key_hash;
   if constexpr (std::is_pointer_v<T>) {
@@ -2401,6 +2468,7 @@ RETRY:
     Expand(2);
     resize = true;
   }
+  resize_governor::instance().observe(sample);
   return resize;
 }
 
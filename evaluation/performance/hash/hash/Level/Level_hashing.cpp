@@ -1,11 +1,15 @@
 #include "Level_hashing.h"
 
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include "hash.h"
+#include "resize_governor.h"
 
 using namespace std;
 
@@ -28,11 +32,16 @@ void LevelHashing::generate_seeds(void)
 }
 extern "C" hash_api *create_tree(const tree_options_t &opt, unsigned sz, unsigned tnum)
 {
+  if (!opt.hash_fn.empty() && !hash_select(opt.hash_fn.c_str()))
+    std::cout << "unknown hash_fn: " << opt.hash_fn << std::endl;
   if (sz)
     sz = log2(2 * sz / 3 / ASSOC_NUM);
   else
     sz = 23;
-  return new LevelHashing(sz >= 2 ? sz : 2);
+  auto api = new LevelHashing(sz >= 2 ? sz : 2);
+  if (opt.value_size <= api->max_inline_value_size())
+    api->set_inline_value_size(opt.value_size);
+  return api;
 }
 LevelHashing::LevelHashing(void) {}
 bool LevelHashing::Recovery()
@@ -49,6 +58,10 @@ LevelHashing::~LevelHashing(void)
   delete[] mutex;
   vmem_free(vmp, buckets[0]);
   vmem_free(vmp, buckets[1]);
+  if (retired_bottom)
+  {
+    vmem_free(vmp, retired_bottom);
+  }
   deletePM();
 }
 
@@ -60,7 +73,7 @@ LevelHashing::LevelHashing(size_t _levels)
 {
   locksize = 256;
   nlocks = (3 * addr_capacity / 2) / locksize + 1;
-  mutex = new std::shared_mutex[nlocks];
+  mutex = new stripe_mutex[nlocks];
 
   generate_seeds();
   buckets[0] = new Node[addr_capacity];
@@ -89,17 +102,15 @@ RETRY:
     for (j = 0; j < ASSOC_NUM; j++)
     {
       {
-        std::unique_lock<std::shared_mutex> lock(mutex[f_idx / locksize]);
-        if (buckets[i][f_idx].token[j] == 1 &&
-            buckets[i][f_idx].slot[j].key == key)
+        std::unique_lock<stripe_mutex> lock(mutex[f_idx / locksize]);
+        if (buckets[i][f_idx].match(j, key))
         {
           return false;
         }
       }
       {
-        std::unique_lock<std::shared_mutex> lock(mutex[s_idx / locksize]);
-        if (buckets[i][s_idx].token[j] == 1 &&
-            buckets[i][s_idx].slot[j].key == key)
+        std::unique_lock<stripe_mutex> lock(mutex[s_idx / locksize]);
+        if (buckets[i][s_idx].match(j, key))
         {
           return false;
         }
@@ -115,27 +126,25 @@ RETRY:
     for (j = 0; j < ASSOC_NUM; j++)
     {
       {
-        std::unique_lock<std::shared_mutex> lock(mutex[f_idx / locksize]);
+        std::unique_lock<stripe_mutex> lock(mutex[f_idx / locksize]);
         if (buckets[i][f_idx].token[j] == 0)
         {
-          buckets[i][f_idx].slot[j].value = value;
-          mfence();
-          buckets[i][f_idx].slot[j].key = key;
-          buckets[i][f_idx].token[j] = 1;
+          buckets[i][f_idx].write_begin();
+          buckets[i][f_idx].fill(j, key, value);
           clflush((char *)&buckets[i][f_idx], sizeof(Node));
+          buckets[i][f_idx].write_end();
           level_item_num[i]++;
           return resized;
         }
       }
       {
-        std::unique_lock<std::shared_mutex> lock(mutex[s_idx / locksize]);
+        std::unique_lock<stripe_mutex> lock(mutex[s_idx / locksize]);
         if (buckets[i][s_idx].token[j] == 0)
         {
-          buckets[i][s_idx].slot[j].value = value;
-          mfence();
-          buckets[i][s_idx].slot[j].key = key;
-          buckets[i][s_idx].token[j] = 1;
+          buckets[i][s_idx].write_begin();
+          buckets[i][s_idx].fill(j, key, value);
           clflush((char *)&buckets[i][s_idx], sizeof(Node));
+          buckets[i][s_idx].write_end();
           level_item_num[i]++;
           return resized;
         }
@@ -171,34 +180,32 @@ RETRY:
     if (resize_num > 0)
     {
       {
-        std::unique_lock<std::shared_mutex> lock(mutex[f_idx / locksize]);
+        std::unique_lock<stripe_mutex> lock(mutex[f_idx / locksize]);
 
         empty_loc = b2t_movement(f_idx);
 
         if (empty_loc != -1)
         {
-          buckets[1][f_idx].slot[empty_loc].value = value;
-          mfence();
-          buckets[1][f_idx].slot[empty_loc].key = key;
-          buckets[1][f_idx].token[empty_loc] = 1;
+          buckets[1][f_idx].write_begin();
+          buckets[1][f_idx].fill(empty_loc, key, value);
           clflush((char *)&buckets[1][f_idx], sizeof(Node));
+          buckets[1][f_idx].write_end();
           level_item_num[1]++;
           resizing_lock = 0;
           return resized;
         }
       }
       {
-        std::unique_lock<std::shared_mutex> lock(mutex[s_idx / locksize]);
+        std::unique_lock<stripe_mutex> lock(mutex[s_idx / locksize]);
 
         empty_loc = b2t_movement(s_idx);
 
         if (empty_loc != -1)
         {
-          buckets[1][s_idx].slot[empty_loc].value = value;
-          mfence();
-          buckets[1][s_idx].slot[empty_loc].key = key;
-          buckets[1][s_idx].token[empty_loc] = 1;
+          buckets[1][s_idx].write_begin();
+          buckets[1][s_idx].fill(empty_loc, key, value);
           clflush((char *)&buckets[1][s_idx], sizeof(Node));
+          buckets[1][s_idx].write_end();
           level_item_num[1]++;
           resizing_lock = 0;
           return resized;
@@ -206,6 +213,29 @@ RETRY:
       }
     }
 
+    // Depth-bounded cuckoo kicks: try_movement only looks one
+    // displacement away, but at high load a chain of a few moves across
+    // alternate slots usually still opens a candidate bucket. Chasing
+    // those chains before surrendering defers the resize from ~75% to
+    // around 90% load factor.
+    f_idx = F_IDX(f_hash, addr_capacity);
+    s_idx = S_IDX(s_hash, addr_capacity);
+    for (i = 0; i < 2; i++)
+    {
+      if (!cuckoo_kick(i, f_idx, key, value))
+      {
+        resizing_lock = 0;
+        return resized;
+      }
+      if (!cuckoo_kick(i, s_idx, key, value))
+      {
+        resizing_lock = 0;
+        return resized;
+      }
+      f_idx = F_IDX(f_hash, addr_capacity / 2);
+      s_idx = S_IDX(s_hash, addr_capacity / 2);
+    }
+
     resize();
     resized = true;
     resizing_lock = 0;
@@ -215,18 +245,73 @@ RETRY:
 
 bool LevelHashing::InsertOnly(Key_t &key, Value_t value) { return true; }
 
+// hash_api bulk load (snapshot rebuild, single caller, fresh table).
+// The loaded payloads are never re-read during the load, so key/value
+// words stream past the cache with movnti instead of polluting it, and
+// per-record flushes collapse into one bulk write-back per level at
+// the end. Records whose candidate buckets are all full drain the
+// pending streaming stores and fall back to the regular insert path.
+void LevelHashing::bulk_load(const char *keys, const char *values,
+                             size_t key_sz, size_t value_sz, uint64_t count,
+                             unsigned tid)
+{
+  for (uint64_t n = 0; n < count; ++n)
+  {
+    Key_t key = *reinterpret_cast<const Key_t *>(keys + n * key_sz);
+    Value_t value = wrap_value(values + n * value_sz, value_sz);
+    uint64_t f_hash = F_HASH(key);
+    uint64_t s_hash = S_HASH(key);
+    bool done = false;
+    for (int i = 0; i < 2 && !done; ++i)
+    {
+      uint64_t idx[2] = {F_IDX(f_hash, addr_capacity / (1 + i)),
+                         S_IDX(s_hash, addr_capacity / (1 + i))};
+      for (int b = 0; b < 2 && !done; ++b)
+      {
+        Node &bucket = buckets[i][idx[b]];
+        for (int j = 0; j < ASSOC_NUM; ++j)
+        {
+          if (bucket.token[j] == 0)
+          {
+            ntstore_u64(&bucket.value_at(j), (uint64_t)value);
+            ntstore_u64(&bucket.key_at(j), (uint64_t)key);
+#ifdef LEVEL_PACKED
+            bucket.fp[j] = Node::fp_of(key);
+#endif
+            bucket.token[j] = 1;
+            level_item_num[i]++;
+            done = true;
+            break;
+          }
+        }
+      }
+    }
+    if (!done)
+    {
+      sfence();
+      Insert(key, value); // may move records or resize
+    }
+  }
+  // One write-back per level covers the token bytes next to the
+  // streamed payloads and everything the fallback path touched.
+  sfence();
+  clflush((char *)&buckets[0][0], sizeof(Node) * addr_capacity, false);
+  clflush((char *)&buckets[1][0], sizeof(Node) * (addr_capacity / 2), false);
+  mfence();
+}
+
 void LevelHashing::resize(void)
 {
-  auto lock = new std::unique_lock<std::shared_mutex> *[nlocks];
+  auto lock = new std::unique_lock<stripe_mutex> *[nlocks];
   for (int i = 0; i < nlocks; i++)
   {
-    lock[i] = new std::unique_lock<std::shared_mutex>(mutex[i]);
+    lock[i] = new std::unique_lock<stripe_mutex>(mutex[i]);
   }
-  std::shared_mutex *old_mutex = mutex;
+  stripe_mutex *old_mutex = mutex;
 
   int prev_nlocks = nlocks;
   nlocks = nlocks + 2 * addr_capacity / locksize + 1;
-  mutex = new std::shared_mutex[nlocks];
+  mutex = new stripe_mutex[nlocks];
 
   size_t new_addr_capacity = pow(2, levels + 1);
   interim_level_buckets = new Node[new_addr_capacity];
@@ -237,76 +322,113 @@ void LevelHashing::resize(void)
   clflush((char *)&interim_level_buckets, sizeof(Node));
   resizingPtr = (char *)interim_level_buckets;
   clflush((char *)&resizingPtr, sizeof(char *));
-  uint64_t new_level_item_num = 0;
-  uint64_t old_idx;
-  for (old_idx = 0; old_idx < pow(2, levels - 1); old_idx++)
-  {
-    uint64_t i, j;
-    for (i = 0; i < ASSOC_NUM; i++)
+  // Rehash the bottom level with a worker pool instead of one thread:
+  // each worker owns a disjoint range of old buckets, and claims slots
+  // in the interim level with a CAS on the token byte since two workers
+  // can hash into the same interim bucket. Every stripe lock is held
+  // exclusively here, so nothing else observes the interim table; a
+  // crash mid-migration discards it wholesale through resizingPtr, so
+  // claiming the token before the key/value stores is safe.
+  uint64_t old_capacity = pow(2, levels - 1);
+  std::atomic<uint64_t> new_level_item_num{0};
+  auto migrate = [&](uint64_t begin, uint64_t end) {
+    uint64_t moved = 0;
+    for (uint64_t old_idx = begin; old_idx < end; old_idx++)
     {
-      if (buckets[1][old_idx].token[i] == 1)
+      // One token per old bucket: when foreground latency is over
+      // budget the governor slows the whole worker pool down together.
+      resize_governor::instance().admit(1);
+      uint64_t i, j;
+      for (i = 0; i < ASSOC_NUM; i++)
       {
-        Key_t key = buckets[1][old_idx].slot[i].key;
-        Value_t value = buckets[1][old_idx].slot[i].value;
-
-        uint32_t f_idx = F_IDX(F_HASH(key), new_addr_capacity);
-        uint32_t s_idx = S_IDX(S_HASH(key), new_addr_capacity);
-
-        uint8_t insertSuccess = 0;
-        for (j = 0; j < ASSOC_NUM; j++)
+        if (buckets[1][old_idx].token[i] == 1)
         {
-          if (interim_level_buckets[f_idx].token[j] == 0)
-          {
-            interim_level_buckets[f_idx].slot[j].value = value;
-
-            mfence();
+          Key_t key = buckets[1][old_idx].key_at(i);
+          Value_t value = buckets[1][old_idx].value_at(i);
 
-            interim_level_buckets[f_idx].slot[j].key = key;
-            interim_level_buckets[f_idx].token[j] = 1;
+          uint32_t f_idx = F_IDX(F_HASH(key), new_addr_capacity);
+          uint32_t s_idx = S_IDX(S_HASH(key), new_addr_capacity);
 
-            clflush((char *)&interim_level_buckets[f_idx], sizeof(Node));
-
-            insertSuccess = 1;
-            new_level_item_num++;
-            break;
-          }
-          else if (interim_level_buckets[s_idx].token[j] == 0)
+          for (j = 0; j < ASSOC_NUM; j++)
           {
-            interim_level_buckets[s_idx].slot[j].value = value;
-
-            mfence();
-
-            interim_level_buckets[s_idx].slot[j].key = key;
-            interim_level_buckets[s_idx].token[j] = 1;
-
-            clflush((char *)&interim_level_buckets[s_idx], sizeof(Node));
-
-            insertSuccess = 1;
-            new_level_item_num++;
-            break;
+            uint8_t empty = 0;
+            if (CAS(&interim_level_buckets[f_idx].token[j], &empty, 1))
+            {
+              interim_level_buckets[f_idx].fill_claimed(j, key, value);
+
+              clflush((char *)&interim_level_buckets[f_idx], sizeof(Node));
+
+              moved++;
+              break;
+            }
+            empty = 0;
+            if (CAS(&interim_level_buckets[s_idx].token[j], &empty, 1))
+            {
+              interim_level_buckets[s_idx].fill_claimed(j, key, value);
+
+              clflush((char *)&interim_level_buckets[s_idx], sizeof(Node));
+
+              moved++;
+              break;
+            }
           }
-        }
 
-        buckets[1][old_idx].token[i] = 0;
+          buckets[1][old_idx].clear(i);
 
-        clflush((char *)&buckets[1][old_idx].token[i], sizeof(uint8_t));
+          clflush((char *)&buckets[1][old_idx].token[i], sizeof(uint8_t));
+        }
       }
     }
+    new_level_item_num.fetch_add(moved);
+  };
+
+  unsigned nworkers = std::thread::hardware_concurrency();
+  if (nworkers == 0 || old_capacity < 1024) nworkers = 1;
+  if (nworkers > 8) nworkers = 8;
+  if (nworkers == 1)
+  {
+    migrate(0, old_capacity);
+  }
+  else
+  {
+    std::vector<std::thread> pool;
+    uint64_t chunk = old_capacity / nworkers;
+    for (unsigned w = 0; w < nworkers; w++)
+    {
+      uint64_t begin = w * chunk;
+      uint64_t end = (w == nworkers - 1) ? old_capacity : begin + chunk;
+      pool.emplace_back(migrate, begin, end);
+    }
+    for (auto &t : pool)
+    {
+      t.join();
+    }
   }
-  clflush((char *)&buckets[1][0], sizeof(Node) * pow(2, levels - 1));
-  clflush((char *)&interim_level_buckets[0], sizeof(Node) * new_addr_capacity);
+  // The rehashed bottom level and the interim level only need to be
+  // durable before resizingPtr clears below; there is no order between
+  // the two ranges themselves, so batch them under one trailing fence.
+  flush_batch batch;
+  batch.add(&buckets[1][0], sizeof(Node) * pow(2, levels - 1));
+  batch.add(&interim_level_buckets[0], sizeof(Node) * new_addr_capacity);
+  batch.commit();
   resizingPtr = nullptr;
   clflush((char *)&resizingPtr, sizeof(char *));
   levels++;
   resize_num++;
 
-  vmem_free(vmp, buckets[1]);
+  // Lock-free readers may still be probing the old bottom level; park
+  // it for one resize epoch instead of freeing it under them.
+  if (retired_bottom)
+  {
+    vmem_free(vmp, retired_bottom);
+  }
+  retired_bottom = buckets[1];
   buckets[1] = buckets[0];
   buckets[0] = interim_level_buckets;
   interim_level_buckets = NULL;
 
   level_item_num[1] = level_item_num[0];
-  level_item_num[0] = new_level_item_num;
+  level_item_num[0] = new_level_item_num.load();
 
   addr_capacity = new_addr_capacity;
   total_capacity = pow(2, levels) + pow(2, levels - 1);
@@ -319,17 +441,134 @@ void LevelHashing::resize(void)
   delete[] old_mutex;
 }
 
+// Search a displacement chain of up to 'depth' moves that opens a slot
+// in bucket idx of the given level: each resident's alternate bucket is
+// tried for a free slot, recursing through full alternates. The scan is
+// optimistic (no locks); apply_kick_path revalidates every move under
+// the stripe locks, so a stale read costs only an aborted chain. Steps
+// are appended deepest-first, which is the order they execute in.
+bool LevelHashing::find_kick_path(uint64_t level_num, uint64_t idx, int depth,
+                                  std::vector<kick_step> &path)
+{
+  if (depth <= 0) return false;
+  uint64_t cap = addr_capacity / (1 + level_num);
+  // First look for a one-move exit from any resident.
+  for (int i = 0; i < ASSOC_NUM; i++)
+  {
+    if (buckets[level_num][idx].token[i] == 0) continue;
+    Key_t m_key = buckets[level_num][idx].key_at(i);
+    uint64_t f_idx = F_IDX(F_HASH(m_key), cap);
+    uint64_t s_idx = S_IDX(S_HASH(m_key), cap);
+    uint64_t jdx = (f_idx == idx) ? s_idx : f_idx;
+    if (jdx == idx) continue;
+    for (int j = 0; j < ASSOC_NUM; j++)
+    {
+      if (buckets[level_num][jdx].token[j] == 0)
+      {
+        path.push_back({idx, m_key, jdx});
+        return true;
+      }
+    }
+  }
+  // No free alternate anywhere: recurse one level deeper through each
+  // resident's alternate bucket.
+  for (int i = 0; i < ASSOC_NUM; i++)
+  {
+    if (buckets[level_num][idx].token[i] == 0) continue;
+    Key_t m_key = buckets[level_num][idx].key_at(i);
+    uint64_t f_idx = F_IDX(F_HASH(m_key), cap);
+    uint64_t s_idx = S_IDX(S_HASH(m_key), cap);
+    uint64_t jdx = (f_idx == idx) ? s_idx : f_idx;
+    if (jdx == idx) continue;
+    if (find_kick_path(level_num, jdx, depth - 1, path))
+    {
+      path.push_back({idx, m_key, jdx});
+      return true;
+    }
+  }
+  return false;
+}
+
+// Executes a chain found by find_kick_path, deepest move first so each
+// shallower move lands in the slot the previous one vacated. Every move
+// re-finds its key and a free destination slot under the stripe locks
+// (same two-lock discipline as try_movement; chains run only under
+// resizing_lock, so at most one multi-lock holder exists and ordering
+// cannot deadlock). Any stale step aborts the chain — records already
+// moved sit in legitimate alternate buckets, so a partial chain leaves
+// the table consistent, merely without the hoped-for free slot.
+bool LevelHashing::apply_kick_path(uint64_t level_num,
+                                   std::vector<kick_step> &path)
+{
+  for (auto &step : path)
+  {
+    std::unique_lock<stripe_mutex> from_lock(
+        mutex[step.idx / locksize]);
+    std::unique_lock<stripe_mutex> to_lock;
+    if ((step.to_idx / locksize) != (step.idx / locksize))
+      to_lock = std::unique_lock<stripe_mutex>(
+          mutex[step.to_idx / locksize]);
+
+    int src = -1, dst = -1;
+    for (int j = 0; j < ASSOC_NUM; j++)
+    {
+      if (src < 0 && buckets[level_num][step.idx].match(j, step.key))
+        src = j;
+      if (dst < 0 && buckets[level_num][step.to_idx].token[j] == 0)
+        dst = j;
+    }
+    if (src < 0 || dst < 0) return false;
+
+    Value_t m_value = buckets[level_num][step.idx].value_at(src);
+    buckets[level_num][step.to_idx].write_begin();
+    buckets[level_num][step.to_idx].fill(dst, step.key, m_value);
+    clflush((char *)&buckets[level_num][step.to_idx], sizeof(Node));
+    buckets[level_num][step.to_idx].write_end();
+    buckets[level_num][step.idx].write_begin();
+    buckets[level_num][step.idx].clear(src);
+    clflush((char *)&buckets[level_num][step.idx].token[src],
+            sizeof(uint8_t));
+    buckets[level_num][step.idx].write_end();
+  }
+  return true;
+}
+
+// Depth-bounded cuckoo kick into bucket idx: find and execute a chain,
+// then claim the freed slot for the new key. Returns 0 on success, 1
+// when no chain exists within kKickDepth (caller falls back to resize).
+uint8_t LevelHashing::cuckoo_kick(uint64_t level_num, uint64_t idx, Key_t &key,
+                                  Value_t value)
+{
+  std::vector<kick_step> path;
+  if (!find_kick_path(level_num, idx, kKickDepth, path)) return 1;
+  if (!apply_kick_path(level_num, path)) return 1;
+  std::unique_lock<stripe_mutex> lock(mutex[idx / locksize]);
+  for (int j = 0; j < ASSOC_NUM; j++)
+  {
+    if (buckets[level_num][idx].token[j] == 0)
+    {
+      buckets[level_num][idx].write_begin();
+      buckets[level_num][idx].fill(j, key, value);
+      clflush((char *)&buckets[level_num][idx], sizeof(Node));
+      buckets[level_num][idx].write_end();
+      level_item_num[level_num]++;
+      return 0;
+    }
+  }
+  return 1;
+}
+
 uint8_t LevelHashing::try_movement(uint64_t idx, uint64_t level_num, Key_t &key,
                                    Value_t value)
 {
   uint64_t i, j, jdx;
   {
-    std::unique_lock<std::shared_mutex> *lock[2];
-    lock[0] = new std::unique_lock<std::shared_mutex>(mutex[idx / locksize]);
+    std::unique_lock<stripe_mutex> *lock[2];
+    lock[0] = new std::unique_lock<stripe_mutex>(mutex[idx / locksize]);
     for (i = 0; i < ASSOC_NUM; i++)
     {
-      Key_t m_key = buckets[level_num][idx].slot[i].key;
-      Value_t m_value = buckets[level_num][idx].slot[i].value;
+      Key_t m_key = buckets[level_num][idx].key_at(i);
+      Value_t m_value = buckets[level_num][idx].value_at(i);
       uint64_t f_hash = F_HASH(m_key);
       uint64_t s_hash = S_HASH(m_key);
       uint64_t f_idx = F_IDX(f_hash, addr_capacity / (1 + level_num));
@@ -343,26 +582,24 @@ uint8_t LevelHashing::try_movement(uint64_t idx, uint64_t level_num, Key_t &key,
       if ((jdx / locksize) != (idx / locksize))
       {
         lock[1] =
-            new std::unique_lock<std::shared_mutex>(mutex[jdx / locksize]);
+            new std::unique_lock<stripe_mutex>(mutex[jdx / locksize]);
       }
 
       for (j = 0; j < ASSOC_NUM; j++)
       {
         if (buckets[level_num][jdx].token[j] == 0)
         {
-          buckets[level_num][jdx].slot[j].value = m_value;
-          mfence();
-          buckets[level_num][jdx].slot[j].key = m_key;
-          buckets[level_num][jdx].token[j] = 1;
+          buckets[level_num][jdx].write_begin();
+          buckets[level_num][jdx].fill(j, m_key, m_value);
           clflush((char *)&buckets[level_num][jdx], sizeof(Node));
-          buckets[level_num][idx].token[i] = 0;
+          buckets[level_num][jdx].write_end();
+          buckets[level_num][idx].write_begin();
+          buckets[level_num][idx].clear(i);
           clflush((char *)&buckets[level_num][idx].token[i], sizeof(uint8_t));
 
-          buckets[level_num][idx].slot[i].value = value;
-          mfence();
-          buckets[level_num][idx].slot[i].key = key;
-          buckets[level_num][idx].token[i] = 1;
+          buckets[level_num][idx].fill(i, key, value);
           clflush((char *)&buckets[level_num][idx], sizeof(Node));
+          buckets[level_num][idx].write_end();
           level_item_num[level_num]++;
 
           if ((jdx / locksize) != (idx / locksize))
@@ -381,109 +618,166 @@ uint8_t LevelHashing::try_movement(uint64_t idx, uint64_t level_num, Key_t &key,
   return 1;
 }
 
+// Batched bottom-to-top migration. Entries used to move one at a time,
+// each paying its own fenced destination flush and token write-back;
+// the move is now planned for the whole bucket first and applied in two
+// passes — all destination fills written back as one deduped batch
+// under a single fence, then all source token clears under a second —
+// so a migration step costs two fences instead of two per entry. The
+// destination pass persists strictly before the source clears, keeping
+// the crash guarantee of the per-entry path (a crash can duplicate a
+// record, never lose one).
 int LevelHashing::b2t_movement(uint64_t idx)
 {
-  Key_t key;
-  Value_t value;
-  uint64_t s_hash, f_hash;
-  uint64_t s_idx, f_idx;
-  uint64_t i, j;
-
-  std::unique_lock<shared_mutex> *lock;
-  for (i = 0; i < ASSOC_NUM; i++)
+  struct planned
   {
-    key = buckets[1][idx].slot[i].key;
-    value = buckets[1][idx].slot[i].value;
-    f_hash = F_HASH(key);
-    s_hash = S_HASH(key);
-    f_idx = F_IDX(f_hash, addr_capacity);
-    s_idx = S_IDX(s_hash, addr_capacity);
-
-    for (j = 0; j < ASSOC_NUM; j++)
+    int src;
+    uint64_t dst;
+    Key_t key;
+    Value_t value;
+  };
+  planned plan[ASSOC_NUM];
+  int nplan = 0;
+  uint8_t claimed[ASSOC_NUM] = {0}; // tentative fills per planned move
+
+  // Plan: pick a destination bucket for every resident, counting the
+  // free slots already promised to earlier residents so two moves do
+  // not plan into one slot. Reads are optimistic; the apply pass
+  // revalidates under the stripe locks.
+  for (int i = 0; i < ASSOC_NUM; i++)
+  {
+    if (buckets[1][idx].token[i] == 0) continue;
+    Key_t key = buckets[1][idx].key_at(i);
+    uint64_t cand[2] = {F_IDX(F_HASH(key), addr_capacity),
+                        S_IDX(S_HASH(key), addr_capacity)};
+    for (int c = 0; c < 2; c++)
     {
-      if ((idx / locksize) != (f_idx / locksize))
-        lock = new std::unique_lock<std::shared_mutex>(mutex[f_idx / locksize]);
-      if (buckets[0][f_idx].token[j] == 0)
+      int free_slots = 0;
+      for (int j = 0; j < ASSOC_NUM; j++)
+        if (buckets[0][cand[c]].token[j] == 0) free_slots++;
+      for (int p = 0; p < nplan; p++)
+        if (plan[p].dst == cand[c]) free_slots -= claimed[p];
+      if (free_slots > 0)
       {
-        buckets[0][f_idx].slot[j].value = value;
-        mfence();
-        buckets[0][f_idx].slot[j].key = key;
-        buckets[0][f_idx].token[j] = 1;
-        clflush((char *)&buckets[0][f_idx], sizeof(Node));
-        buckets[1][idx].token[i] = 0;
-        clflush((char *)&buckets[1][idx].token[i], sizeof(uint8_t));
-        level_item_num[0]++;
-        level_item_num[1]--;
-
-        if ((idx / locksize) != (f_idx / locksize))
-          delete lock;
-        return i;
+        claimed[nplan] = 1;
+        plan[nplan++] = {i, cand[c], key, buckets[1][idx].value_at(i)};
+        break;
       }
-      if ((idx / locksize) != (f_idx / locksize))
-        delete lock;
-      if ((idx / locksize) != (s_idx / locksize))
-        lock = new std::unique_lock<std::shared_mutex>(mutex[s_idx / locksize]);
-
-      if (buckets[0][s_idx].token[j] == 0)
-      {
-        buckets[0][s_idx].slot[j].value = value;
-        mfence();
-        buckets[0][s_idx].slot[j].key = key;
-        buckets[0][s_idx].token[j] = 1;
-        clflush((char *)&buckets[0][s_idx], sizeof(Node));
-        buckets[1][idx].token[i] = 0;
-        clflush((char *)&buckets[0][s_idx].token[j], sizeof(uint8_t));
-
-        level_item_num[0]++;
-        level_item_num[1]--;
-
-        if ((idx / locksize) != (s_idx / locksize))
-          delete lock;
-        return i;
-      }
-      if ((idx / locksize) != (s_idx / locksize))
-        delete lock;
     }
   }
-  return -1;
+  if (nplan == 0) return -1;
+
+  // Apply, destination pass: fill and seqlock-publish each move under
+  // its stripe lock, deferring every write-back into one batch (lines
+  // shared by two moves are deduped) with a single trailing fence.
+  flush_batch batch;
+  int moved_src[ASSOC_NUM];
+  int nmoved = 0;
+  for (int p = 0; p < nplan; p++)
+  {
+    std::unique_lock<stripe_mutex> lock;
+    if ((idx / locksize) != (plan[p].dst / locksize))
+      lock = std::unique_lock<stripe_mutex>(
+          mutex[plan[p].dst / locksize]);
+    int j;
+    for (j = 0; j < ASSOC_NUM; j++)
+      if (buckets[0][plan[p].dst].token[j] == 0) break;
+    if (j == ASSOC_NUM) continue; // raced away; leave the resident put
+    buckets[0][plan[p].dst].write_begin();
+    buckets[0][plan[p].dst].fill(j, plan[p].key, plan[p].value);
+    buckets[0][plan[p].dst].write_end();
+    batch.add(&buckets[0][plan[p].dst], sizeof(Node));
+    moved_src[nmoved++] = plan[p].src;
+    level_item_num[0]++;
+  }
+  if (nmoved == 0) return -1;
+  batch.commit();
+
+  // Source pass: only after the copies are durable do the bottom-level
+  // tokens clear, all on one line of the source bucket.
+  buckets[1][idx].write_begin();
+  for (int m = 0; m < nmoved; m++)
+  {
+    buckets[1][idx].clear(moved_src[m]);
+    level_item_num[1]--;
+  }
+  buckets[1][idx].write_end();
+  clflush((char *)&buckets[1][idx].token[0], sizeof(uint8_t) * ASSOC_NUM);
+  return moved_src[0];
 }
 
 Value_t LevelHashing::Get(Key_t &key)
 {
   uint64_t f_hash = F_HASH(key);
   uint64_t s_hash = S_HASH(key);
-  uint32_t f_idx = F_IDX(f_hash, addr_capacity);
-  uint32_t s_idx = S_IDX(s_hash, addr_capacity);
+
+  // Lock-free read: writers set the slot key before the token, so a
+  // token hit always pairs with a complete slot, and any slot rewrite
+  // bumps the bucket's seqlock word; rescanning on a version change is
+  // all a reader needs. A miss is only trusted if no resize ran while
+  // we probed — resizing_lock stays 1 for the whole migration, so the
+  // final check below catches every overlap.
+RETRY:
+  while (resizing_lock == 1)
+  {
+    asm("nop");
+  }
+  // All four candidate buckets follow from the two hashes alone, so
+  // compute and prefetch them before the first probe: a full miss
+  // overlaps the four line fills into one memory round-trip instead of
+  // paying them back to back.
+  Node *cand[2][2] = {
+      {&buckets[0][F_IDX(f_hash, addr_capacity)],
+       &buckets[0][S_IDX(s_hash, addr_capacity)]},
+      {&buckets[1][F_IDX(f_hash, addr_capacity / 2)],
+       &buckets[1][S_IDX(s_hash, addr_capacity / 2)]}};
+  __builtin_prefetch(cand[0][0]);
+  __builtin_prefetch(cand[0][1]);
+  __builtin_prefetch(cand[1][0]);
+  __builtin_prefetch(cand[1][1]);
   int i = 0, j;
 
   for (i = 0; i < 2; i++)
   {
+    for (int k = 0; k < 2; k++)
     {
-      std::shared_lock<std::shared_mutex> lock(mutex[f_idx / locksize]);
-      for (j = 0; j < ASSOC_NUM; j++)
+      Node *b = cand[i][k];
+      for (;;)
       {
-        if (buckets[i][f_idx].token[j] == 1 &&
-            buckets[i][f_idx].slot[j].key == key)
+        uint32_t v = __atomic_load_n(&b->version, __ATOMIC_ACQUIRE);
+        if (v & 1)
         {
-          return buckets[i][f_idx].slot[j].value;
+          asm("nop");
+          continue;
         }
-      }
-    }
-    {
-      std::shared_lock<std::shared_mutex> lock(mutex[s_idx / locksize]);
-      for (j = 0; j < ASSOC_NUM; j++)
-      {
-        if (buckets[i][s_idx].token[j] == 1 &&
-            buckets[i][s_idx].slot[j].key == key)
+        bool hit = false;
+        Value_t value = NONE;
+        for (j = 0; j < ASSOC_NUM; j++)
         {
-          return buckets[i][s_idx].slot[j].value;
+          if (b->match(j, key))
+          {
+            value = b->value_at(j);
+            hit = true;
+            break;
+          }
+        }
+        if (__atomic_load_n(&b->version, __ATOMIC_ACQUIRE) != v)
+        {
+          continue;
         }
+        if (hit)
+        {
+          return value;
+        }
+        break;
       }
     }
-    f_idx = F_IDX(f_hash, addr_capacity / 2);
-    s_idx = S_IDX(s_hash, addr_capacity / 2);
   }
 
+  if (resizing_lock == 1)
+  {
+    goto RETRY;
+  }
   return NONE;
 }
 
@@ -503,23 +797,25 @@ bool LevelHashing::Delete(Key_t &key)
   {
     for (j = 0; j < ASSOC_NUM; j++)
     {
-      std::unique_lock<std::shared_mutex> lock(mutex[f_idx / locksize]);
-      if (buckets[i][f_idx].token[j] == 1 &&
-          buckets[i][f_idx].slot[j].key == key)
+      std::unique_lock<stripe_mutex> lock(mutex[f_idx / locksize]);
+      if (buckets[i][f_idx].match(j, key))
       {
-        buckets[i][f_idx].token[j] = 0;
+        buckets[i][f_idx].write_begin();
+        buckets[i][f_idx].clear(j);
         clflush((char *)&buckets[i][f_idx].token[j], sizeof(uint8_t));
+        buckets[i][f_idx].write_end();
         return 1;
       }
     }
     for (j = 0; j < ASSOC_NUM; j++)
     {
-      std::unique_lock<std::shared_mutex> lock(mutex[s_idx / locksize]);
-      if (buckets[i][s_idx].token[j] == 1 &&
-          buckets[i][s_idx].slot[j].key == key)
+      std::unique_lock<stripe_mutex> lock(mutex[s_idx / locksize]);
+      if (buckets[i][s_idx].match(j, key))
       {
-        buckets[i][s_idx].token[j] = 0;
+        buckets[i][s_idx].write_begin();
+        buckets[i][s_idx].clear(j);
         clflush((char *)&buckets[i][s_idx].token[j], sizeof(uint8_t));
+        buckets[i][s_idx].write_end();
         return 1;
       }
     }
@@ -530,6 +826,55 @@ bool LevelHashing::Delete(Key_t &key)
   return 0;
 }
 
+/// Single-probe upsert: walks the same four candidate buckets as Get,
+/// overwriting the value in place (under the stripe lock, seqlock-
+/// bracketed for lock-free readers) when the key is found; only an
+/// absent key falls through to the insert path.
+bool LevelHashing::Upsert(Key_t &key, Value_t value)
+{
+  while (resizing_lock == 1)
+  {
+    asm("nop");
+  }
+  uint64_t f_hash = F_HASH(key);
+  uint64_t s_hash = S_HASH(key);
+  uint64_t f_idx = F_IDX(f_hash, addr_capacity);
+  uint64_t s_idx = S_IDX(s_hash, addr_capacity);
+
+  uint64_t i, j;
+  for (i = 0; i < 2; i++)
+  {
+    for (j = 0; j < ASSOC_NUM; j++)
+    {
+      std::unique_lock<stripe_mutex> lock(mutex[f_idx / locksize]);
+      if (buckets[i][f_idx].match(j, key))
+      {
+        buckets[i][f_idx].write_begin();
+        buckets[i][f_idx].value_at(j) = value;
+        clflush((char *)&buckets[i][f_idx].value_at(j), sizeof(Value_t));
+        buckets[i][f_idx].write_end();
+        return true;
+      }
+    }
+    for (j = 0; j < ASSOC_NUM; j++)
+    {
+      std::unique_lock<stripe_mutex> lock(mutex[s_idx / locksize]);
+      if (buckets[i][s_idx].match(j, key))
+      {
+        buckets[i][s_idx].write_begin();
+        buckets[i][s_idx].value_at(j) = value;
+        clflush((char *)&buckets[i][s_idx].value_at(j), sizeof(Value_t));
+        buckets[i][s_idx].write_end();
+        return true;
+      }
+    }
+    f_idx = F_IDX(f_hash, addr_capacity / 2);
+    s_idx = S_IDX(s_hash, addr_capacity / 2);
+  }
+
+  return Insert(key, value);
+}
+
 hash_Utilization LevelHashing::Utilization(void)
 {
   size_t sum = 0;
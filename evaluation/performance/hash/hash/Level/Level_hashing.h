@@ -8,11 +8,23 @@
 #include <cstring>
 #include <mutex>
 #include <shared_mutex>
+#include <vector>
 
 #include "pair.h"
+#include "resize_governor.h"
 #include "persist.h"
+#include "spinlock.h"
 #define ASSOC_NUM 3
 
+/// Stripe lock type: the NUMA-cohort lock prefers handoff to same-node
+/// waiters (bounded, see spinlock.h) so hot-bucket lock lines stop
+/// bouncing across sockets; the default stays std::shared_mutex.
+#ifdef LEVEL_COHORT_LOCK
+using stripe_mutex = cohort_lock;
+#else
+using stripe_mutex = std::shared_mutex;
+#endif
+
 struct Entry
 {
   Key_t key;
@@ -24,24 +36,118 @@ struct Entry
   }
   void *operator new[](size_t size)
   {
-    return vmem_aligned_alloc(vmp, 64, size);
+    return vmem_aligned_alloc_site(VMEM_SITE_BUCKET, 64, size);
   }
 
-  void *operator new(size_t size) { return vmem_aligned_alloc(vmp, 64, size); }
+  void *operator new(size_t size) { return vmem_aligned_alloc_site(VMEM_SITE_BUCKET, 64, size); }
 };
 
 struct Node
 {
+#ifdef LEVEL_PACKED
+  /// Packed flavor: fingerprints, tokens, seqlock word, keys and
+  /// values squeezed into exactly one 64-byte line, so a negative
+  /// probe and a hit both resolve without leaving the line. The
+  /// default flavor interleaves key/value pairs and pays an extra line
+  /// on most probes; build with -DLEVEL_PACKED to compare.
+  uint8_t fp[ASSOC_NUM];
+  uint8_t token[ASSOC_NUM];
+  uint16_t pad0_;
+  uint32_t version = 0;
+  uint32_t pad1_;
+  Key_t keys[ASSOC_NUM];
+  Value_t values[ASSOC_NUM];
+
+  Node()
+  {
+    for (int j = 0; j < ASSOC_NUM; j++)
+    {
+      fp[j] = 0;
+      token[j] = 0;
+      keys[j] = INVALID;
+      values[j] = NONE;
+    }
+  }
+
+  Key_t &key_at(int j) { return keys[j]; }
+  Value_t &value_at(int j) { return values[j]; }
+
+  /// One multiply-mix byte of the key; cheaper to reject on than an
+  /// 8-byte key compare and kept next to the tokens.
+  static uint8_t fp_of(Key_t k)
+  {
+    return (uint8_t)((k * 0x9E3779B97F4A7C15ULL) >> 56);
+  }
+#else
   uint8_t token[ASSOC_NUM];
   Entry slot[ASSOC_NUM];
-  char dummy[13];
+  /// Seqlock word for lock-free readers: a writer that rewrites an
+  /// occupied slot makes it odd before the stores and even after
+  /// (under its stripe lock); readers rescan the bucket when it moved.
+  /// Carved out of the old padding, so the bucket size is unchanged.
+  uint32_t version = 0;
+  char dummy[9];
+
+  Key_t &key_at(int j) { return slot[j].key; }
+  Value_t &value_at(int j) { return slot[j].value; }
+#endif
+
+  /// Occupied and holding k? In the packed flavor the fingerprint
+  /// rejects most mismatches before the key compare.
+  bool match(int j, Key_t k)
+  {
+#ifdef LEVEL_PACKED
+    if (fp[j] != fp_of(k)) return false;
+#endif
+    return token[j] == 1 && key_at(j) == k;
+  }
+
+  /// Publishes (k, v) into free slot j with the store ordering lock-
+  /// free readers rely on: value, fence, key, then token last.
+  void fill(int j, Key_t k, Value_t v)
+  {
+    value_at(j) = v;
+    mfence();
+    key_at(j) = k;
+#ifdef LEVEL_PACKED
+    fp[j] = fp_of(k);
+#endif
+    token[j] = 1;
+  }
+
+  /// Fills slot j whose token was already claimed (resize workers CAS
+  /// the token first; the interim level is not visible to readers).
+  void fill_claimed(int j, Key_t k, Value_t v)
+  {
+    value_at(j) = v;
+    mfence();
+    key_at(j) = k;
+#ifdef LEVEL_PACKED
+    fp[j] = fp_of(k);
+#endif
+  }
+
+  void clear(int j)
+  {
+    token[j] = 0;
+#ifdef LEVEL_PACKED
+    fp[j] = 0;
+#endif
+  }
+
+  void write_begin() { __atomic_fetch_add(&version, 1, __ATOMIC_ACQ_REL); }
+  void write_end() { __atomic_fetch_add(&version, 1, __ATOMIC_ACQ_REL); }
   void *operator new[](size_t size)
   {
-    return vmem_aligned_alloc(vmp, 64, size);
+    return vmem_aligned_alloc_site(VMEM_SITE_BUCKET, 64, size);
   }
 
-  void *operator new(size_t size) { return vmem_aligned_alloc(vmp, 64, size); }
+  void *operator new(size_t size) { return vmem_aligned_alloc_site(VMEM_SITE_BUCKET, 64, size); }
 };
+
+#ifdef LEVEL_PACKED
+static_assert(sizeof(Node) == 64, "packed bucket must be one cache line");
+#endif
 class LevelHashing : public hash_api
 {
 private:
@@ -57,7 +163,7 @@ private:
   uint64_t s_seed;
   uint32_t resize_num;
   int32_t resizing_lock = 0;
-  std::shared_mutex *mutex;
+  stripe_mutex *mutex;
   int nlocks;
   int locksize;
 
@@ -65,7 +171,48 @@ private:
   void resize(void);
   int b2t_movement(uint64_t);
   uint8_t try_movement(uint64_t, uint64_t, Key_t &, Value_t);
+
+  /// One move of a cuckoo displacement chain: key relocates from
+  /// bucket idx to its alternate to_idx within one level.
+  struct kick_step
+  {
+    uint64_t idx;
+    Key_t key;
+    uint64_t to_idx;
+  };
+
+  /// Chain length for the cuckoo kick path; try_movement already
+  /// covers depth one, so chains add up to this many further moves.
+  static const int kKickDepth = 4;
+
+  bool find_kick_path(uint64_t, uint64_t, int, std::vector<kick_step> &);
+  bool apply_kick_path(uint64_t, std::vector<kick_step> &);
+  uint8_t cuckoo_kick(uint64_t, uint64_t, Key_t &, Value_t);
   char *resizingPtr;
+  /// Old bottom level parked for one resize epoch: lock-free readers
+  /// may still be probing it when the levels shift, so it is freed at
+  /// the next resize (or teardown) instead of immediately.
+  Node *retired_bottom = nullptr;
+
+  /// In-slot mode: copies the value bytes into the slot word itself, so
+  /// a hit needs no dependent read; out-of-line mode stores the caller's
+  /// pointer unchanged. Common value sizes go through the fixed-width
+  /// copier picked at create_tree time (see pair.h) instead of a
+  /// runtime-length memcpy per operation.
+  Value_t wrap_value(const char *value, size_t value_sz)
+  {
+    if (inline_value_sz == 0) return value;
+    if (wrap_fn) return wrap_fn(value);
+    uint64_t v = 0;
+    memcpy(&v, value, value_sz < sizeof(v) ? value_sz : sizeof(v));
+    return reinterpret_cast<Value_t>(v);
+  }
+
+  /// Non-zero when values are stored in-slot (set through
+  /// set_inline_value_size by create_tree).
+  size_t inline_value_sz = 0;
+  /// Constant-size in-slot copier, or nullptr for the generic path.
+  Value_t (*wrap_fn)(const char *) = nullptr;
 
 public:
   LevelHashing(void);
@@ -73,6 +220,7 @@ public:
   ~LevelHashing(void);
   bool InsertOnly(Key_t &, Value_t);
   bool Insert(Key_t &, Value_t);
+  bool Upsert(Key_t &, Value_t);
   bool Delete(Key_t &);
   bool Recovery();
   Value_t Get(Key_t &);
@@ -81,9 +229,28 @@ public:
   {
     return (addr_capacity + addr_capacity / 2) * ASSOC_NUM;
   }
+  /// Incremental stats from the per-level item counters the operation
+  /// paths already maintain — no walk; pm_bytes is the two live levels'
+  /// bucket arrays (the parked retired bottom is garbage, not table).
+  hash_stats_t stats()
+  {
+    hash_stats_t st;
+    st.items = level_item_num[0] + level_item_num[1];
+    st.capacity = Capacity();
+    if (st.capacity)
+      st.load_factor = static_cast<double>(st.items) / st.capacity;
+    st.pm_bytes = (addr_capacity + addr_capacity / 2) * sizeof(Node);
+    return st;
+  }
   // hash_api
   void vmem_print_api() { vmem_print(); }
   std::string hash_name() { return "Level"; };
+  size_t max_inline_value_size() { return sizeof(Value_t); }
+  void set_inline_value_size(size_t value_sz)
+  {
+    inline_value_sz = value_sz;
+    wrap_fn = fixed_value_wrap(value_sz);
+  }
   bool recovery()
   {
     Recovery();
@@ -93,8 +260,11 @@ public:
   bool find(const char *key, size_t key_sz, char *value_out, unsigned tid)
   {
     Key_t k = *reinterpret_cast<const Key_t *>(key);
+    auto sample = resize_governor::instance().sample_op();
     auto r = Get(k);
-
+    resize_governor::instance().observe(sample);
+    if (inline_value_sz && r != NONE)
+      memcpy(value_out, &r, inline_value_sz);
     return r;
   }
 
@@ -102,21 +272,32 @@ public:
               size_t value_sz, unsigned tid, unsigned t)
   {
     Key_t k = *reinterpret_cast<const Key_t *>(key);
-    Insert(k, value);
+    auto sample = resize_governor::instance().sample_op();
+    Insert(k, wrap_value(value, value_sz));
+    resize_governor::instance().observe(sample);
     return true;
   }
   bool insertResize(const char *key, size_t key_sz, const char *value,
                     size_t value_sz)
   {
     Key_t k = *reinterpret_cast<const Key_t *>(key);
-    return Insert(k, value);
+    return Insert(k, wrap_value(value, value_sz));
   }
+  void bulk_load(const char *keys, const char *values, size_t key_sz,
+                 size_t value_sz, uint64_t count, unsigned tid);
   bool update(const char *key, size_t key_sz, const char *value,
               size_t value_sz)
   {
     return true;
   }
 
+  bool upsert(const char *key, size_t key_sz, const char *value,
+              size_t value_sz, unsigned tid, unsigned t)
+  {
+    Key_t k = *reinterpret_cast<const Key_t *>(key);
+    return Upsert(k, wrap_value(value, value_sz));
+  }
+
   bool remove(const char *key, size_t key_sz, unsigned tid)
   {
     Key_t k = *reinterpret_cast<const Key_t *>(key);
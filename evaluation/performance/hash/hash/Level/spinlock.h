@@ -1,6 +1,8 @@
 /* Spin lock using xchg
    Copied from http://locklessinc.com/articles/locks/
  */
+#ifndef LEVEL_SPINLOCK_H_
+#define LEVEL_SPINLOCK_H_
 
 /* Compile read-write barrier */
 #define barrier() asm volatile("": : :"memory")
@@ -42,3 +44,91 @@ static inline int spin_trylock(spinlock *lock)
 {
     return xchg_8(lock, BUSY);
 }
+
+#ifdef LEVEL_COHORT_LOCK
+#include <atomic>
+#include <sched.h>
+
+// consecutive same-node handoffs before the global lock is released,
+// so a hammered bucket cannot starve the remote socket
+const int COHORT_HANDOFF_BOUND = 64;
+// gates are indexed by NUMA node id modulo this
+const int COHORT_MAX_NODES = 8;
+
+/*
+ * Two-level cohort lock (-DLEVEL_COHORT_LOCK): a per-node ticket gate
+ * under a global owner word. A releasing holder that sees same-node
+ * waiters hands the global lock over locally -- the lock cache line
+ * stays on the socket instead of bouncing across the interconnect on
+ * every hot-bucket acquisition -- and releases globally after
+ * COHORT_HANDOFF_BOUND consecutive local handoffs so remote waiters
+ * are never starved. BasicLockable, so the stripe layer's
+ * std::unique_lock works on it unchanged.
+ */
+class cohort_lock
+{
+    struct alignas(64) node_gate
+    {
+        std::atomic<unsigned> next{0};
+        std::atomic<unsigned> serving{0};
+        // set when the previous holder passed the global lock along
+        // with the local one; read only by the gate's current holder
+        std::atomic<bool> global_held{false};
+        unsigned handoffs = 0; // guarded by holding the gate
+    };
+    std::atomic<int> global_owner{-1}; // node id, -1 when free
+    node_gate gates[COHORT_MAX_NODES];
+    int owner_node = -1; // written while holding
+
+    // the node is sticky per thread: migration across sockets is rare
+    // and only costs locality, never correctness
+    static int my_node()
+    {
+        static thread_local int node = -1;
+        if (node < 0) {
+            unsigned c = 0, n = 0;
+            node = (getcpu(&c, &n) == 0) ? (int)(n % COHORT_MAX_NODES) : 0;
+        }
+        return node;
+    }
+
+public:
+    void lock()
+    {
+        int n = my_node();
+        node_gate &g = gates[n];
+        unsigned t = g.next.fetch_add(1, std::memory_order_relaxed);
+        while (g.serving.load(std::memory_order_acquire) != t)
+            cpu_relax();
+        if (!g.global_held.load(std::memory_order_relaxed)) {
+            int expected = -1;
+            while (!global_owner.compare_exchange_weak(
+                       expected, n, std::memory_order_acquire,
+                       std::memory_order_relaxed)) {
+                expected = -1;
+                cpu_relax();
+            }
+            g.global_held.store(true, std::memory_order_relaxed);
+            g.handoffs = 0;
+        }
+        owner_node = n;
+    }
+
+    void unlock()
+    {
+        node_gate &g = gates[owner_node];
+        unsigned t = g.serving.load(std::memory_order_relaxed);
+        bool waiters = g.next.load(std::memory_order_relaxed) != t + 1;
+        if (waiters && ++g.handoffs < (unsigned)COHORT_HANDOFF_BOUND) {
+            // pass global ownership along with the gate
+            g.serving.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        g.handoffs = 0;
+        g.global_held.store(false, std::memory_order_relaxed);
+        global_owner.store(-1, std::memory_order_release);
+        g.serving.fetch_add(1, std::memory_order_release);
+    }
+};
+#endif // LEVEL_COHORT_LOCK
+#endif // LEVEL_SPINLOCK_H_
@@ -3,11 +3,18 @@
 
 #include <malloc.h>
 #include <math.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
 
 //#define CLHTDEBUG
 //#define CRASH_AFTER_SWAP_CLHT
@@ -20,7 +27,6 @@ __thread uint32_t put_num_failed_expand = 0;
 __thread uint32_t put_num_failed_on_new = 0;
 #endif
 
-__thread size_t check_ht_status_steps = CLHT_STATUS_INVOK_IN;
 
 #include "assert.h"
 #include "stdlib.h"
@@ -130,6 +136,7 @@ bucket_t *clht_bucket_create() {
 
   uint32_t j;
   for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
+    bucket->fp[j] = 0;
     bucket->key[j] = 0;
   }
   bucket->next = NULL;
@@ -167,6 +174,8 @@ clht_t *clht_create(uint64_t num_buckets) {
   w->resize_lock = LOCK_FREE;
   w->gc_lock = LOCK_FREE;
   w->status_lock = LOCK_FREE;
+  w->status_req = 0;
+  w->replica_set = NULL;
   w->version_list = NULL;
   w->version_min = 0;
   w->ht_oldest = w->ht;
@@ -227,6 +236,9 @@ clht_hashtable_t *clht_hashtable_create(uint64_t num_buckets) {
   }
   hashtable->is_helper = 1;
   hashtable->helper_done = 0;
+  hashtable->helper_cursor = 0;
+  hashtable->helpers_active = 0;
+  hashtable->replicas = NULL;
 
   return hashtable;
 }
@@ -243,15 +255,92 @@ uint64_t clht_hash(clht_hashtable_t *hashtable, clht_addr_t key) {
   return k & (hashtable->hash);
 }
 
+/* ********************************************************************************
+ */
+/* NUMA read replication */
+/* ********************************************************************************
+ */
+
+#define CLHT_REPLICA_MAX_NODES 8
+
+/* Per-node DRAM mirrors of the bucket array. Writers mark the bin
+ * dirty for every node; one propagator thread per node (pinned there,
+ * so first-touch keeps its mirror local) copies dirty bucket chains
+ * over from the PM master. Mirror overflow buckets are reused and
+ * never freed while attached, so a reader mid-chain never touches
+ * freed memory. */
+struct clht_replica_set {
+  bucket_t *table[CLHT_REPLICA_MAX_NODES];
+  uint8_t *dirty[CLHT_REPLICA_MAX_NODES]; /* one flag per bin per node */
+  volatile uint64_t epoch[CLHT_REPLICA_MAX_NODES];
+  uint64_t num_buckets;
+  int num_nodes;
+  std::atomic<bool> stop;
+  std::vector<std::thread> threads;
+};
+
+/* NUMA node of the calling thread, clamped to the configured count. */
+static inline int replica_node_self(int num_nodes) {
+  static __thread int cached = -1;
+  if (unlikely(cached < 0)) {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+      node = 0;
+    }
+    cached = (int)node;
+  }
+  return cached < num_nodes ? cached : cached % num_nodes;
+}
+
+/* Called by writers (under the bucket lock) after updating the
+ * master: flags the bin for every node's propagator. */
+static inline void replica_mark(clht_hashtable_t *hashtable, clht_addr_t key) {
+  struct clht_replica_set *set = hashtable->replicas;
+  if (likely(set == NULL)) {
+    return;
+  }
+  size_t bin = clht_hash(hashtable, key);
+  int n;
+  for (n = 0; n < set->num_nodes; n++) {
+    __atomic_store_n(&set->dirty[n][bin], 1, __ATOMIC_RELEASE);
+  }
+}
+
+/* Node-local mirror of the bucket array, or NULL while the propagator
+ * is still building it (readers fall back to the master). */
+static inline bucket_t *replica_local_table(clht_hashtable_t *hashtable) {
+  struct clht_replica_set *set = hashtable->replicas;
+  if (likely(set == NULL)) {
+    return NULL;
+  }
+  int node = replica_node_self(set->num_nodes);
+  return __atomic_load_n(&set->table[node], __ATOMIC_ACQUIRE);
+}
+
 /* Retrieve a key-value entry from a hash table. */
 clht_val_t clht_get(clht_hashtable_t *hashtable, clht_addr_t key) {
   size_t bin = clht_hash(hashtable, key);
   CLHT_GC_HT_VERSION_USED(hashtable);
   volatile bucket_t *bucket = hashtable->table + bin;
+  /* NUMA mode: probe the node-local DRAM mirror instead of the PM
+   * master (bounded staleness, see clht_replica_enable) */
+  bucket_t *mirror = replica_local_table(hashtable);
+  if (unlikely(mirror != NULL)) {
+    bucket = mirror + bin;
+  }
+  uint8_t fp = clht_fp(key);
 
   uint32_t j;
   do {
+    /* overlap the next overflow line's load with this bucket's scan */
+    if (unlikely(bucket->next != NULL)) {
+      __builtin_prefetch((const void *)bucket->next);
+    }
+    uint32_t probe = clht_fp_mask(bucket, fp);
     for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
+      if (!(probe & (1u << j))) {
+        continue;
+      }
       clht_val_t val = bucket->val[j];
 #ifdef __tile__
       _mm_lfence();
@@ -271,10 +360,15 @@ clht_val_t clht_get(clht_hashtable_t *hashtable, clht_addr_t key) {
 }
 
 static inline bool bucket_exists(volatile bucket_t *bucket, clht_addr_t key) {
+  uint8_t fp = clht_fp(key);
   uint32_t j;
   do {
+    if (unlikely(bucket->next != NULL)) {
+      __builtin_prefetch((const void *)bucket->next);
+    }
+    uint32_t probe = clht_fp_mask(bucket, fp);
     for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
-      if (bucket->key[j] == key) {
+      if ((probe & (1u << j)) && bucket->key[j] == key) {
         return true;
       }
     }
@@ -313,6 +407,7 @@ int clht_put(clht_t *h, clht_addr_t key, clht_val_t val) {
   CLHT_CHECK_STATUS(h);
   clht_addr_t *empty = NULL;
   clht_val_t *empty_v = NULL;
+  volatile uint8_t *empty_fp = NULL;
 
   uint32_t j;
   do {
@@ -323,6 +418,7 @@ int clht_put(clht_t *h, clht_addr_t key, clht_val_t val) {
       } else if (empty == NULL && bucket->key[j] == 0) {
         empty = (clht_addr_t *)&bucket->key[j];
         empty_v = &bucket->val[j];
+        empty_fp = &bucket->fp[j];
       }
     }
 
@@ -333,6 +429,7 @@ int clht_put(clht_t *h, clht_addr_t key, clht_val_t val) {
 
         bucket_t *b = clht_bucket_create_stats(hashtable, &resize);
         b->val[0] = val;
+        b->fp[0] = clht_fp(key);
 #ifdef __tile__
         /* keep the writes in order */
         _mm_sfence();
@@ -347,6 +444,9 @@ int clht_put(clht_t *h, clht_addr_t key, clht_val_t val) {
         clflush((char *)&bucket->next, sizeof(uintptr_t), true);
       } else {
         *empty_v = val;
+        /* fingerprint first: a reader must never skip a slot whose
+         * key is already visible */
+        *empty_fp = clht_fp(key);
 #ifdef __tile__
         /* keep the writes in order */
         _mm_sfence();
@@ -355,14 +455,102 @@ int clht_put(clht_t *h, clht_addr_t key, clht_val_t val) {
         clflush((char *)empty, sizeof(uintptr_t), true);
       }
 
+      replica_mark(hashtable, key);
       LOCK_RLS(lock);
       if (unlikely(resize)) {
-        /* ht_resize_pes(h, 1); */
-        DEBUG_PRINT("Calling ht_status for key %ld\n", (long)key);
-        int ret = ht_status(h, 1, 0);
+        /* Raise the flag and move on: the status watcher runs the
+         * full-table scan and any resize off the hot path. */
+        DEBUG_PRINT("Raising status_req for key %ld\n", (long)key);
+        h->status_req = 1;
+      }
+      return true + resize;
+    }
+    bucket = bucket->next;
+  } while (true);
+}
+
+/*
+  Insert a key-value entry, or overwrite the value in place when the key
+  already exists; one bucket-chain walk under the bucket lock either way.
+  return:
+    0: fail
+    1: success
+    2: success with resize
+ */
+int clht_upsert(clht_t *h, clht_addr_t key, clht_val_t val) {
+  clht_hashtable_t *hashtable = h->ht;
+  size_t bin = clht_hash(hashtable, key);
+  volatile bucket_t *bucket = hashtable->table + bin;
 
-        // if crash, return true, because the insert anyway succeeded
-        if (ret == 0) return true + resize;
+  clht_lock_t *lock = &bucket->lock;
+  while (!LOCK_ACQ(lock, hashtable)) {
+    hashtable = h->ht;
+    size_t bin = clht_hash(hashtable, key);
+
+    bucket = hashtable->table + bin;
+    lock = &bucket->lock;
+  }
+
+  CLHT_GC_HT_VERSION_USED(hashtable);
+  CLHT_CHECK_STATUS(h);
+  clht_addr_t *empty = NULL;
+  clht_val_t *empty_v = NULL;
+  volatile uint8_t *empty_fp = NULL;
+
+  uint32_t j;
+  do {
+    for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
+      if (bucket->key[j] == key) {
+        bucket->val[j] = val;
+        clflush((char *)&bucket->val[j], sizeof(clht_val_t), true);
+        replica_mark(hashtable, key);
+        LOCK_RLS(lock);
+        return true;
+      } else if (empty == NULL && bucket->key[j] == 0) {
+        empty = (clht_addr_t *)&bucket->key[j];
+        empty_v = &bucket->val[j];
+        empty_fp = &bucket->fp[j];
+      }
+    }
+
+    int resize = 0;
+    if (likely(bucket->next == NULL)) {
+      if (unlikely(empty == NULL)) {
+        DPP(put_num_failed_expand);
+
+        bucket_t *b = clht_bucket_create_stats(hashtable, &resize);
+        b->val[0] = val;
+        b->fp[0] = clht_fp(key);
+#ifdef __tile__
+        /* keep the writes in order */
+        _mm_sfence();
+#endif
+        b->key[0] = key;
+#ifdef __tile__
+        /* make sure they are visible */
+        _mm_sfence();
+#endif
+        clflush((char *)b, sizeof(bucket_t), true);
+        bucket->next = b;
+        clflush((char *)&bucket->next, sizeof(uintptr_t), true);
+      } else {
+        *empty_v = val;
+        /* fingerprint first: a reader must never skip a slot whose
+         * key is already visible */
+        *empty_fp = clht_fp(key);
+#ifdef __tile__
+        /* keep the writes in order */
+        _mm_sfence();
+#endif
+        *empty = key;
+        clflush((char *)empty, sizeof(uintptr_t), true);
+      }
+
+      replica_mark(hashtable, key);
+      LOCK_RLS(lock);
+      if (unlikely(resize)) {
+        DEBUG_PRINT("Raising status_req for key %ld\n", (long)key);
+        h->status_req = 1;
       }
       return true + resize;
     }
@@ -400,7 +588,9 @@ clht_val_t clht_remove(clht_t *h, clht_addr_t key) {
       if (bucket->key[j] == key) {
         clht_val_t val = bucket->val[j];
         bucket->key[j] = 0;
+        bucket->fp[j] = 0;
         clflush((char *)&bucket->key[j], sizeof(uintptr_t), true);
+        replica_mark(hashtable, key);
         LOCK_RLS(lock);
         return val;
       }
@@ -420,6 +610,7 @@ static uint32_t clht_put_seq(clht_hashtable_t *hashtable, clht_addr_t key,
     for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
       if (bucket->key[j] == 0) {
         bucket->val[j] = val;
+        bucket->fp[j] = clht_fp(key);
         bucket->key[j] = key;
         return true;
       }
@@ -430,6 +621,7 @@ static uint32_t clht_put_seq(clht_hashtable_t *hashtable, clht_addr_t key,
       int null;
       bucket->next = clht_bucket_create_stats(hashtable, &null);
       bucket->next->val[0] = val;
+      bucket->next->fp[0] = clht_fp(key);
       bucket->next->key[0] = key;
       return true;
     }
@@ -438,6 +630,217 @@ static uint32_t clht_put_seq(clht_hashtable_t *hashtable, clht_addr_t key,
   } while (true);
 }
 
+/* Copies one slot with the discipline lock-free readers rely on: a
+ * changing key is invalidated first and written last, so a reader
+ * never pairs one key with another key's value. */
+static void replica_copy_bucket(volatile bucket_t *src, bucket_t *dst) {
+  uint32_t j;
+  for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
+    clht_addr_t key = src->key[j];
+    clht_val_t val = src->val[j];
+    if (dst->key[j] != key) {
+      dst->key[j] = 0;
+    }
+    dst->val[j] = val;
+    dst->fp[j] = src->fp[j];
+    dst->key[j] = key;
+  }
+}
+
+/* Mirrors the master chain hanging off one bin into the node mirror.
+ * Mirror overflow buckets are plain DRAM, allocated on first use and
+ * kept (with cleared keys) when the master chain shrinks: a reader
+ * may still be walking them. */
+static void replica_copy_bin(volatile bucket_t *src, bucket_t *dst) {
+  replica_copy_bucket(src, dst);
+  volatile bucket_t *s = src->next;
+  bucket_t *d = dst;
+  while (s != NULL) {
+    if (d->next == NULL) {
+      bucket_t *b =
+          (bucket_t *)aligned_alloc(CACHE_LINE_SIZE, sizeof(bucket_t));
+      memset(b, 0, sizeof(bucket_t));
+      replica_copy_bucket(s, b);
+      /* publish only after the copy so readers never see a half-built
+       * bucket */
+      __atomic_store_n((bucket_t **)&d->next, b, __ATOMIC_RELEASE);
+    } else {
+      replica_copy_bucket(s, (bucket_t *)d->next);
+    }
+    d = (bucket_t *)d->next;
+    s = s->next;
+  }
+  volatile bucket_t *o = d->next;
+  while (o != NULL) {
+    uint32_t j;
+    for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
+      o->key[j] = 0;
+      o->fp[j] = 0;
+    }
+    o = o->next;
+  }
+}
+
+/* Pins the calling thread to the cpus of one NUMA node. Best effort:
+ * without the sysfs topology the thread stays where it is and the
+ * mirror is just another DRAM copy. */
+static void replica_pin_to_node(int node) {
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+           node);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return;
+  }
+  char buf[256];
+  if (fgets(buf, sizeof(buf), f) == NULL) {
+    fclose(f);
+    return;
+  }
+  fclose(f);
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  char *tok = strtok(buf, ",\n");
+  while (tok != NULL) {
+    int lo, hi;
+    if (sscanf(tok, "%d-%d", &lo, &hi) == 2) {
+      int c;
+      for (c = lo; c <= hi; c++) {
+        CPU_SET(c, &cpus);
+      }
+    } else if (sscanf(tok, "%d", &lo) == 1) {
+      CPU_SET(lo, &cpus);
+    }
+    tok = strtok(NULL, ",\n");
+  }
+  if (CPU_COUNT(&cpus) > 0) {
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+  }
+}
+
+/* One per node: builds the node-local mirror, then keeps folding in
+ * dirty bins until stopped or the table is resized away. */
+static void replica_propagate(clht_t *h, struct clht_replica_set *set,
+                              int node) {
+  replica_pin_to_node(node);
+
+  /* build this node's mirror; first touch from here lands it on the
+   * node. Marks raised meanwhile are covered by the full first pass,
+   * since the set was attached before this thread started. */
+  clht_hashtable_t *ht = h->ht;
+  uint64_t nb = set->num_buckets;
+  bucket_t *table =
+      (bucket_t *)aligned_alloc(CACHE_LINE_SIZE, nb * sizeof(bucket_t));
+  memset(table, 0, nb * sizeof(bucket_t));
+  uint64_t bin;
+  for (bin = 0; bin < nb; bin++) {
+    replica_copy_bin(ht->table + bin, table + bin);
+  }
+  __atomic_store_n(&set->table[node], table, __ATOMIC_RELEASE);
+
+  while (!set->stop.load(std::memory_order_relaxed)) {
+    if (unlikely(h->ht != ht)) {
+      /* a resize swapped the root: detach rather than mirror a table
+       * this set was not sized for; re-enable attaches to the new one */
+      __atomic_store_n(&ht->replicas, (struct clht_replica_set *)NULL,
+                       __ATOMIC_RELEASE);
+      break;
+    }
+    int any = 0;
+    for (bin = 0; bin < nb; bin++) {
+      if (__atomic_exchange_n(&set->dirty[node][bin], 0, __ATOMIC_ACQ_REL)) {
+        replica_copy_bin(ht->table + bin, table + bin);
+        any = 1;
+      }
+    }
+    __atomic_fetch_add((uint64_t *)&set->epoch[node], 1, __ATOMIC_ACQ_REL);
+    if (!any) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  /* unpublish, wait out readers that already picked the mirror up,
+   * then reclaim it */
+  __atomic_store_n(&set->table[node], (bucket_t *)NULL, __ATOMIC_RELEASE);
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  for (bin = 0; bin < nb; bin++) {
+    volatile bucket_t *b = table[bin].next;
+    while (b != NULL) {
+      volatile bucket_t *cur = b;
+      b = b->next;
+      free((void *)cur);
+    }
+  }
+  free(table);
+}
+
+void clht_replica_enable(clht_t *h, int num_nodes) {
+  if (h->replica_set != NULL || num_nodes <= 0) {
+    return;
+  }
+  if (num_nodes > CLHT_REPLICA_MAX_NODES) {
+    num_nodes = CLHT_REPLICA_MAX_NODES;
+  }
+  clht_hashtable_t *ht = h->ht;
+  struct clht_replica_set *set = new clht_replica_set();
+  set->num_buckets = ht->num_buckets;
+  set->num_nodes = num_nodes;
+  set->stop.store(false);
+  int n;
+  for (n = 0; n < num_nodes; n++) {
+    set->table[n] = NULL;
+    set->epoch[n] = 0;
+    set->dirty[n] = (uint8_t *)calloc(ht->num_buckets, 1);
+  }
+  h->replica_set = set;
+  /* attach before the first full copy: writes from here on are
+   * marked, and the initial sweep covers everything older */
+  __atomic_store_n(&ht->replicas, set, __ATOMIC_RELEASE);
+  for (n = 0; n < num_nodes; n++) {
+    set->threads.emplace_back(replica_propagate, h, set, n);
+  }
+}
+
+void clht_replica_disable(clht_t *h) {
+  struct clht_replica_set *set = h->replica_set;
+  if (set == NULL) {
+    return;
+  }
+  if (h->ht->replicas == set) {
+    __atomic_store_n(&h->ht->replicas, (struct clht_replica_set *)NULL,
+                     __ATOMIC_RELEASE);
+  }
+  set->stop.store(true);
+  for (auto &t : set->threads) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+  int n;
+  for (n = 0; n < set->num_nodes; n++) {
+    free(set->dirty[n]);
+  }
+  delete set;
+  h->replica_set = NULL;
+}
+
+void clht_replica_quiesce(clht_t *h) {
+  struct clht_replica_set *set = h->replica_set;
+  if (set == NULL) {
+    return;
+  }
+  int n;
+  for (n = 0; n < set->num_nodes; n++) {
+    uint64_t e = set->epoch[n];
+    /* two pass boundaries: one may already have been mid-scan when
+     * the caller's last mark landed */
+    while (__atomic_load_n(&set->table[n], __ATOMIC_ACQUIRE) != NULL &&
+           set->epoch[n] < e + 2) {
+      _mm_pause();
+    }
+  }
+}
+
 static int bucket_cpy(clht_t *h, volatile bucket_t *bucket,
                       clht_hashtable_t *ht_new) {
   if (!LOCK_ACQ_RES(&bucket->lock)) {
@@ -487,24 +890,29 @@ static int bucket_cpy(clht_t *h, volatile bucket_t *bucket,
 }
 
 void ht_resize_help(clht_hashtable_t *h) {
-  if ((int32_t)FAD_U32((volatile uint32_t *)&h->is_helper) <= 0) {
+  if (h->is_helper != 1 || h->table_tmp == NULL) {
     return;
   }
 
-  int32_t b;
-  /* hash = num_buckets - 1 */
-  for (b = h->hash; b >= 0; b--) {
+  /* Cooperative migration: any number of writers that collide with the
+   * resize help, each claiming bucket indices from the top through the
+   * shared cursor while the resizer walks from the bottom. bucket_cpy
+   * takes the bucket's resize lock, so double claims copy nothing. */
+  IAF_U32(&h->helpers_active);
+
+  do {
+    int64_t b = (int64_t)h->hash - (int64_t)FAI_U32(&h->helper_cursor);
+    if (b < 0) {
+      break;
+    }
     bucket_t *bu_cur = h->table + b;
-    if (!bucket_cpy(
-            (clht_t *)h, bu_cur,
-            h->table_tmp)) { /* reached a point where the resizer is handling */
-      /* printf("[GC-%02d] helped  #buckets: %10zu = %5.1f%%\n",  */
-      /* 	 clht_gc_get_id(), h->num_buckets - b, 100.0 * (h->num_buckets
-       * - b) / h->num_buckets); */
+    if (!bucket_cpy((clht_t *)h, bu_cur,
+                    h->table_tmp)) { /* reached the resizer's region */
       break;
     }
-  }
+  } while (1);
 
+  DAF_U32(&h->helpers_active);
   h->helper_done = 1;
 }
 
@@ -512,8 +920,6 @@ void ht_resize_help(clht_hashtable_t *h) {
 int ht_resize_pes(clht_t *h, int is_increase, int by) {
   //    ticks s = getticks();
 
-  check_ht_status_steps = CLHT_STATUS_INVOK;
-
   clht_hashtable_t *ht_old = h->ht;
 
   if (TRYLOCK_ACQ(&h->resize_lock)) {
@@ -552,11 +958,9 @@ int ht_resize_pes(clht_t *h, int is_increase, int by) {
     if (!ret) break;
   }
 
-  if (is_increase && ht_old->is_helper != 1) /* there exist a helper */
-  {
-    while (ht_old->helper_done != 1) {
-      _mm_pause();
-    }
+  /* wait for every helper to finish the buckets it claimed */
+  while (ht_old->helpers_active != 0) {
+    _mm_pause();
   }
 
 #else
@@ -678,6 +1082,24 @@ int ht_resize_pes(clht_t *h, int is_increase, int by) {
 #if CLHT_DO_GC == 1
   clht_gc_collect(h);
 #else
+  /* Defer reclamation while a snapshot scanner still pins the old
+   * table; only the resizer waits here, writers are already on the
+   * new root. */
+  int pinned;
+  do {
+    pinned = 0;
+    volatile ht_ts_t *ts = h->version_list;
+    while (ts != NULL) {
+      if (ts->versionp == ht_old) {
+        pinned = 1;
+        break;
+      }
+      ts = ts->next;
+    }
+    if (pinned) {
+      _mm_pause();
+    }
+  } while (pinned);
   clht_gc_release(ht_old);
 #endif
 
@@ -819,6 +1241,106 @@ size_t ht_status(clht_t *h, int resize_increase, int just_print) {
   return size;
 }
 
+/* One ht_ts node per scanning thread, pushed onto version_list once
+ * and reused; unpin just clears versionp. Nodes are never removed,
+ * mirroring how the ht_ts list was designed to be used. */
+static __thread ht_ts_t *scan_ts = NULL;
+
+clht_hashtable_t *clht_snapshot_pin(clht_t *h) {
+  if (scan_ts == NULL) {
+    scan_ts = (ht_ts_t *)vmem_aligned_alloc(vmp, CACHE_LINE_SIZE,
+                                            sizeof(ht_ts_t));
+    scan_ts->versionp = NULL;
+    do {
+      scan_ts->next = h->version_list;
+    } while (!CAS_U64_BOOL((uint64_t *)&h->version_list,
+                           (uint64_t)scan_ts->next, (uint64_t)scan_ts));
+  }
+
+  /* Publish the pin, then re-read the root: if a resize swapped in
+   * between, re-pin the new table until the two agree, so the resizer
+   * either sees our pin or we see its new root. */
+  do {
+    scan_ts->versionp = h->ht;
+    scan_ts->version = scan_ts->versionp->version;
+    _mm_mfence();
+  } while (scan_ts->versionp != h->ht);
+
+  return scan_ts->versionp;
+}
+
+void clht_snapshot_unpin(void) {
+  if (scan_ts != NULL) {
+    scan_ts->versionp = NULL;
+  }
+}
+
+#define CLHT_SCAN_BATCH 256
+
+size_t clht_scan_range(clht_hashtable_t *ht, uint64_t bin_start,
+                       uint64_t bin_end, clht_scan_cb cb, void *arg) {
+  clht_addr_t keys[CLHT_SCAN_BATCH];
+  clht_val_t vals[CLHT_SCAN_BATCH];
+  size_t n = 0;
+  size_t total = 0;
+
+  uint64_t bin;
+  for (bin = bin_start; bin < bin_end; bin++) {
+    volatile bucket_t *bucket = ht->table + bin;
+    do {
+      uint32_t j;
+      for (j = 0; j < ENTRIES_PER_BUCKET; j++) {
+        clht_addr_t key = bucket->key[j];
+        if (key != 0) {
+          keys[n] = key;
+          vals[n] = bucket->val[j];
+          if (++n == CLHT_SCAN_BATCH) {
+            cb(keys, vals, n, arg);
+            total += n;
+            n = 0;
+          }
+        }
+      }
+      bucket = bucket->next;
+    } while (bucket != NULL);
+  }
+
+  if (n > 0) {
+    cb(keys, vals, n, arg);
+    total += n;
+  }
+  return total;
+}
+
+size_t clht_scan_parallel(clht_t *h, unsigned nworkers, clht_scan_cb cb,
+                          void *arg) {
+  clht_hashtable_t *ht = clht_snapshot_pin(h);
+  uint64_t num_buckets = ht->num_buckets;
+
+  if (nworkers <= 1 || num_buckets < 1024) {
+    size_t total = clht_scan_range(ht, 0, num_buckets, cb, arg);
+    clht_snapshot_unpin();
+    return total;
+  }
+
+  std::atomic<size_t> total{0};
+  std::vector<std::thread> pool;
+  uint64_t chunk = num_buckets / nworkers;
+  for (unsigned w = 0; w < nworkers; w++) {
+    uint64_t begin = w * chunk;
+    uint64_t end = (w == nworkers - 1) ? num_buckets : begin + chunk;
+    pool.emplace_back([&, begin, end] {
+      total.fetch_add(clht_scan_range(ht, begin, end, cb, arg));
+    });
+  }
+  for (auto &t : pool) {
+    t.join();
+  }
+
+  clht_snapshot_unpin();
+  return total.load();
+}
+
 size_t clht_size_mem(clht_hashtable_t *h) /* in bytes */
 {
   if (h == NULL) {
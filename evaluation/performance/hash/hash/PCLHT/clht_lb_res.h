@@ -7,7 +7,10 @@
 #include <stdlib.h>
 #include <vmem.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <thread>
 
 #include "atomic_ops.h"
 #include "hash.h"
@@ -39,17 +42,11 @@
 #define CLHT_USE_RTM 0
 #endif
 
-#if CLHT_DO_CHECK_STATUS == 1
-#define CLHT_CHECK_STATUS(h)                    \
-  if (unlikely((--check_ht_status_steps) == 0)) \
-  {                                             \
-    ht_status(h, 0, 0);                         \
-    check_ht_status_steps = CLHT_STATUS_INVOK;  \
-  }
-
-#else
+/* Status checks are event-driven: writers that hit the expansion
+ * threshold raise status_req on the clht_t and a watcher thread runs
+ * ht_status off the hot path, so the periodic full-table scan never
+ * lands on a foreground operation. */
 #define CLHT_CHECK_STATUS(h)
-#endif
 
 #if CLHT_DO_GC == 1
 #define CLHT_GC_HT_VERSION_USED(ht) \
@@ -137,6 +134,14 @@ static inline uint64_t pow2roundup(uint64_t x)
 typedef struct ALIGNED(CACHE_LINE_SIZE) bucket_s
 {
   clht_lock_t lock;
+  /* one-byte key fingerprints, one per slot, packed into the header
+   * bytes after the lock (the hops counter was never used): a probe
+   * compares all of them with a single 16-byte load before touching
+   * any key word. 0 means unset and always falls through to the full
+   * key compare, so the filter can only skip true misses. Written
+   * before the key on insert, so a reader never skips a slot whose
+   * key is already published. */
+  volatile uint8_t fp[ENTRIES_PER_BUCKET];
   volatile uint32_t hops;
   clht_addr_t key[ENTRIES_PER_BUCKET];
   clht_val_t val[ENTRIES_PER_BUCKET];
@@ -147,6 +152,44 @@ typedef struct ALIGNED(CACHE_LINE_SIZE) bucket_s
 //_Static_assert (sizeof(bucket_t) % 64 == 0, "sizeof(bucket_t) == 64");
 //#endif
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* fingerprint byte of a key: multiply-mix high byte, remapped away
+ * from 0 (0 marks an unset slot) */
+static inline uint8_t clht_fp(clht_addr_t key)
+{
+  uint8_t fp = (uint8_t)(((uint64_t)key * 0x9E3779B97F4A7C15ULL) >> 56);
+  return fp == 0 ? 1 : fp;
+}
+
+/* bitmask of the slots whose fingerprint may match (bit j set = slot
+ * j still needs the key compare); one SSE compare of the bucket
+ * header covers every slot, a byte loop does the same off x86 */
+static inline uint32_t clht_fp_mask(volatile bucket_t *bucket, uint8_t fp)
+{
+#if defined(__SSE2__)
+  __m128i hdr = _mm_loadu_si128((const __m128i *)(const void *)bucket);
+  __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(hdr, _mm_set1_epi8((char)fp)),
+                             _mm_cmpeq_epi8(hdr, _mm_setzero_si128()));
+  /* the fingerprints sit at byte offsets 1..ENTRIES_PER_BUCKET */
+  return ((uint32_t)_mm_movemask_epi8(hit) >> 1) &
+         ((1u << ENTRIES_PER_BUCKET) - 1);
+#else
+  uint32_t m = 0;
+  uint32_t j;
+  for (j = 0; j < ENTRIES_PER_BUCKET; j++)
+  {
+    if (bucket->fp[j] == fp || bucket->fp[j] == 0)
+    {
+      m |= 1u << j;
+    }
+  }
+  return m;
+#endif
+}
+
 typedef struct ALIGNED(CACHE_LINE_SIZE) clht
 {
   union
@@ -161,11 +204,20 @@ typedef struct ALIGNED(CACHE_LINE_SIZE) clht
       volatile clht_lock_t resize_lock;
       volatile clht_lock_t gc_lock;
       volatile clht_lock_t status_lock;
+      /* raised when an expansion hits the threshold; consumed by the
+       * status watcher thread */
+      volatile clht_lock_t status_req;
+      /* owning handle for NUMA read replication (enable/disable);
+       * the hot-path attachment pointer lives on the hashtable */
+      struct clht_replica_set *replica_set;
     };
     uint8_t padding[2 * CACHE_LINE_SIZE];
   };
 } clht_t;
 
+/* NUMA read replication (see clht_replica_enable below). */
+struct clht_replica_set;
+
 typedef struct ALIGNED(CACHE_LINE_SIZE) clht_hashtable_s
 {
   union
@@ -189,7 +241,17 @@ typedef struct ALIGNED(CACHE_LINE_SIZE) clht_hashtable_s
       };
       volatile int32_t is_helper;
       volatile int32_t helper_done;
+      /* shared claim cursor for cooperative migration: helpers grab
+       * bucket indices from the top with fetch-and-increment while the
+       * resizer walks from the bottom */
+      volatile uint32_t helper_cursor;
+      /* helpers currently copying; the resizer waits for it to drain
+       * before swapping the root */
+      volatile uint32_t helpers_active;
       size_t version_min;
+      /* non-NULL while NUMA read replication is attached to this
+       * table; readers probe their node-local mirror through it */
+      struct clht_replica_set *replicas;
     };
     uint8_t padding[2 * CACHE_LINE_SIZE];
   };
@@ -382,6 +444,10 @@ clht_t *clht_create(uint64_t num_buckets);
 /* Insert a key-value pair into a hashtable. */
 int clht_put(clht_t *hashtable, clht_addr_t key, clht_val_t val);
 
+/* Insert key, or overwrite its value in place when it already exists;
+ * a single bucket-chain walk either way. */
+int clht_upsert(clht_t *hashtable, clht_addr_t key, clht_val_t val);
+
 /* Retrieve a key-value pair from a hashtable. */
 clht_val_t clht_get(clht_hashtable_t *hashtable, clht_addr_t key);
 
@@ -389,6 +455,22 @@ clht_val_t clht_get(clht_hashtable_t *hashtable, clht_addr_t key);
 clht_val_t clht_remove(clht_t *hashtable, clht_addr_t key);
 
 size_t clht_size(clht_hashtable_t *hashtable);
+
+/* Snapshot-consistent export. clht_snapshot_pin publishes an ht_ts
+ * node on version_list naming the table version the caller is about
+ * to read; ht_resize_pes defers reclaiming an old table while any pin
+ * covers it, so scanners never block writers and never read freed
+ * memory. Batches of key/value pairs are streamed through the
+ * callback; keys are published value-first (same discipline clht_get
+ * relies on), so a nonzero key always pairs with its value. */
+typedef void (*clht_scan_cb)(const clht_addr_t *keys,
+                             const clht_val_t *vals, size_t n, void *arg);
+clht_hashtable_t *clht_snapshot_pin(clht_t *h);
+void clht_snapshot_unpin(void);
+size_t clht_scan_range(clht_hashtable_t *ht, uint64_t bin_start,
+                       uint64_t bin_end, clht_scan_cb cb, void *arg);
+size_t clht_scan_parallel(clht_t *h, unsigned nworkers, clht_scan_cb cb,
+                          void *arg);
 size_t clht_size_mem(clht_hashtable_t *hashtable);
 size_t clht_size_mem_garbage(clht_hashtable_t *hashtable);
 bool clht_recovery();
@@ -405,6 +487,22 @@ hash_Utilization utiliz(clht_t *hashtable);
 bucket_t *clht_bucket_create();
 int ht_resize_pes(clht_t *hashtable, int is_increase, int by);
 
+/* NUMA read replication: mirrors the bucket array per node in plain
+ * DRAM (propagator threads are pinned to their node, so first-touch
+ * makes the mirrors node-local). Writes go to the PM master as usual;
+ * writers mark the bin dirty and per-node propagator threads copy
+ * dirty bucket chains over asynchronously, so readers see bounded
+ * staleness (at most one propagation pass, see clht_replica_quiesce)
+ * in exchange for never paying remote-DIMM latency on a lookup. A
+ * resize detaches replication (readers fall back to the master);
+ * re-enable against the new table if wanted. Opt-in at runtime via
+ * clht_replica_enable or the CLHT_NUMA_NODES environment variable. */
+void clht_replica_enable(clht_t *h, int num_nodes);
+void clht_replica_disable(clht_t *h);
+/* Blocks until every write marked before the call is visible in every
+ * node mirror (two full propagation passes per node). */
+void clht_replica_quiesce(clht_t *h);
+
 const char *clht_type_desc();
 
 void clht_lock_initialization(clht_t *h);
@@ -413,8 +511,39 @@ class CLHT : public hash_api
 {
 public:
   clht *iclht;
-  CLHT(size_t sz = 512) { iclht = clht_create(sz); }
-  ~CLHT() { deletePM(); }
+  CLHT(size_t sz = 512)
+  {
+    iclht = clht_create(sz);
+    /* event-driven status: writers only raise status_req; this thread
+     * pays for the full-table scan and any resize it triggers */
+    status_thread_ = std::thread([this] {
+      while (!status_stop_.load(std::memory_order_relaxed))
+      {
+        if (iclht->status_req)
+        {
+          iclht->status_req = 0;
+          ht_status(iclht, 1, 0);
+        }
+        else
+        {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }
+    });
+    /* opt-in NUMA read replication (node count from the environment) */
+    const char *nodes = getenv("CLHT_NUMA_NODES");
+    if (nodes != NULL && atoi(nodes) > 0)
+    {
+      clht_replica_enable(iclht, atoi(nodes));
+    }
+  }
+  ~CLHT()
+  {
+    clht_replica_disable(iclht);
+    status_stop_.store(true);
+    if (status_thread_.joinable()) status_thread_.join();
+    deletePM();
+  }
   // hash_api
   void vmem_print_api() { vmem_print(); }
   std::string hash_name() { return "CLHT"; };
@@ -424,6 +553,19 @@ public:
     return true;
   }
   hash_Utilization utilization() { return utiliz(iclht); }
+  /// Incremental stats from the root table's geometry (racy reads, fine
+  /// for sampling). CLHT keeps no O(1) item counter, so items and
+  /// load_factor stay zero; the capacity/footprint series still shows
+  /// every resize doubling, and num_expands counts chained buckets.
+  hash_stats_t stats()
+  {
+    hash_stats_t st;
+    clht_hashtable_t *ht = iclht->ht;
+    st.capacity = (uint64_t)ht->num_buckets * ENTRIES_PER_BUCKET;
+    st.pm_bytes = (uint64_t)ht->num_buckets * sizeof(bucket_t);
+    st.overflow_buckets = ht->num_expands;
+    return st;
+  }
   bool find(const char *key, size_t key_sz, char *value_out, unsigned tid)
   {
     clht_addr_t k = *reinterpret_cast<const clht_addr_t *>(key);
@@ -452,6 +594,14 @@ public:
     return true;
   }
 
+  bool upsert(const char *key, size_t key_sz, const char *value,
+              size_t value_sz, unsigned tid, unsigned t)
+  {
+    clht_addr_t k = *reinterpret_cast<const clht_addr_t *>(key);
+    clht_val_t v = *reinterpret_cast<const clht_val_t *>(value);
+    return clht_upsert(iclht, k, v);
+  }
+
   bool remove(const char *key, size_t key_sz, unsigned tid)
   {
     clht_addr_t k = *reinterpret_cast<const clht_addr_t *>(key);
@@ -463,6 +613,10 @@ public:
   {
     return scan_sz;
   }
+
+private:
+  std::thread status_thread_;
+  std::atomic<bool> status_stop_{false};
 };
 
 #endif /* _CLHT_RES_RES_H_ */
@@ -1,8 +1,10 @@
 #ifndef UTIL_HASH_H_
 #define UTIL_HASH_H_
 #include <bits/hash_bytes.h>
+#include <immintrin.h>
 #include <stddef.h>
 
+#include <cstring>
 #include <functional>
 
 namespace {
@@ -274,11 +276,188 @@ inline uint64_t xxhash(const void *data, size_t length, size_t seed) {
   return hash_compute(data, length, seed, 0);
 }
 
-static size_t (*hash_funcs[4])(const void *key, size_t len, size_t seed) = {
-    standard, murmur2, jenkins, xxhash};
+// MurmurHash3 finalizer: full-width avalanche, so every selectable
+// stage fills the top bits the directory-indexed tables consume.
+inline uint64_t fmix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+// wyhash-style stage: one widening multiply folds 16 bytes, so short
+// keys finish in two multiplies.
+inline uint64_t wymix(uint64_t a, uint64_t b) {
+  __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+inline size_t wyhash(const void *key, size_t len, size_t seed) {
+  const char *p = static_cast<const char *>(key);
+  uint64_t hash = seed ^ NUMBER64_1;
+  size_t n = len;
+  while (n >= 16) {
+    hash = wymix(unaligned_load(p) ^ NUMBER64_2, unaligned_load(p + 8) ^ hash);
+    p += 16;
+    n -= 16;
+  }
+  uint64_t a = 0, b = 0;
+  if (n >= 8) {
+    a = unaligned_load(p);
+    if (n > 8) b = unaligned_load(p + n - 8);
+  } else if (n > 0) {
+    a = load_bytes(p, n);
+  }
+  return wymix(NUMBER64_1 ^ len, wymix(a ^ NUMBER64_2, b ^ hash));
+}
+
+// CRC32C-based stage: the hardware instruction has 3-cycle latency but
+// single-cycle throughput, so chains on independent keys pipeline (see
+// hash_n). Only 32 bits of state survive, hence the fmix64 finalizer.
+// hash_select only exposes it when the CPU has SSE4.2.
+__attribute__((target("sse4.2"))) inline size_t crchash(const void *key,
+                                                        size_t len,
+                                                        size_t seed) {
+  const char *p = static_cast<const char *>(key);
+  uint64_t c = seed;
+  size_t n = len;
+  while (n >= 8) {
+    c = __builtin_ia32_crc32di(c, unaligned_load(p));
+    p += 8;
+    n -= 8;
+  }
+  if (n > 0) {
+    c = __builtin_ia32_crc32di(c, load_bytes(p, n));
+  }
+  return fmix64(c ^ (len * NUMBER64_1));
+}
+
+static size_t (*hash_funcs[6])(const void *key, size_t len, size_t seed) = {
+    standard, murmur2, jenkins, xxhash, wyhash, crchash};
+
+static const char *hash_fn_names[6] = {"standard", "murmur2", "jenkins",
+                                       "xxhash",   "wyhash",  "crc"};
+
+/// Index into hash_funcs used by h(); tables keep their historical
+/// default unless create_tree selects another stage through
+/// tree_options_t::hash_fn.
+static size_t hash_fn_idx = 0;
+
+/// Selects the hash stage by name; returns false (and leaves the
+/// selection alone) for unknown names or for "crc" on CPUs without
+/// SSE4.2.
+inline bool hash_select(const char *name) {
+  for (size_t i = 0; i < sizeof(hash_fn_names) / sizeof(hash_fn_names[0]);
+       ++i) {
+    if (strcmp(name, hash_fn_names[i]) == 0) {
+      if (hash_funcs[i] == crchash && !__builtin_cpu_supports("sse4.2")) {
+        return false;
+      }
+      hash_fn_idx = i;
+      return true;
+    }
+  }
+  return false;
+}
 
 inline size_t h(const void *key, size_t len, size_t seed = 0xc70697UL) {
-  return hash_funcs[0](key, len, seed);
+  return hash_funcs[hash_fn_idx](key, len, seed);
+}
+
+#if defined(__x86_64__)
+// 64x64->low-64 multiply across four AVX2 lanes (no native mullo_epi64
+// below AVX-512): cross products of the 32-bit halves.
+__attribute__((target("avx2"))) inline __m256i mul64_avx2(__m256i a,
+                                                          __m256i b) {
+  __m256i lo = _mm256_mul_epu32(a, b);
+  __m256i t1 = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+  __m256i t2 = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+  return _mm256_add_epi64(lo,
+                          _mm256_slli_epi64(_mm256_add_epi64(t1, t2), 32));
+}
+
+__attribute__((target("avx2"))) inline __m256i rotl64_avx2(__m256i x, int r) {
+  return _mm256_or_si256(_mm256_slli_epi64(x, r),
+                         _mm256_srli_epi64(x, 64 - r));
+}
+
+// Four xxhash lanes over fixed 8-byte keys, bit-identical to the scalar
+// stage so precomputed hashes agree with what a table computes on its
+// own probes.
+__attribute__((target("avx2"))) inline void xxhash8_x4_avx2(const char *keys,
+                                                            size_t seed,
+                                                            uint64_t *out) {
+  const __m256i n1 = _mm256_set1_epi64x((long long)NUMBER64_1);
+  const __m256i n2 = _mm256_set1_epi64x((long long)NUMBER64_2);
+  const __m256i n3 = _mm256_set1_epi64x((long long)NUMBER64_3);
+  const __m256i n4 = _mm256_set1_epi64x((long long)NUMBER64_4);
+  __m256i hash = _mm256_set1_epi64x((long long)(seed + NUMBER64_5 + 8));
+  __m256i k1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys));
+  k1 = mul64_avx2(k1, n2);
+  k1 = rotl64_avx2(k1, 31);
+  k1 = mul64_avx2(k1, n1);
+  hash = _mm256_xor_si256(hash, k1);
+  hash = _mm256_add_epi64(mul64_avx2(rotl64_avx2(hash, 27), n1), n4);
+  hash = _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 33));
+  hash = mul64_avx2(hash, n2);
+  hash = _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 29));
+  hash = mul64_avx2(hash, n3);
+  hash = _mm256_xor_si256(hash, _mm256_srli_epi64(hash, 32));
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), hash);
+}
+
+// Four interleaved hardware CRC chains: independent keys hide the
+// 3-cycle crc32 latency behind each other.
+__attribute__((target("sse4.2"))) inline void crchash8_x4(const char *keys,
+                                                          size_t seed,
+                                                          uint64_t *out) {
+  uint64_t c0 = __builtin_ia32_crc32di(seed, unaligned_load(keys));
+  uint64_t c1 = __builtin_ia32_crc32di(seed, unaligned_load(keys + 8));
+  uint64_t c2 = __builtin_ia32_crc32di(seed, unaligned_load(keys + 16));
+  uint64_t c3 = __builtin_ia32_crc32di(seed, unaligned_load(keys + 24));
+  const uint64_t lmix = 8 * NUMBER64_1;
+  out[0] = fmix64(c0 ^ lmix);
+  out[1] = fmix64(c1 ^ lmix);
+  out[2] = fmix64(c2 ^ lmix);
+  out[3] = fmix64(c3 ^ lmix);
+}
+#endif
+
+/// Hashes n keys of 'len' bytes laid back to back at 'keys' with the
+/// selected stage, writing one hash per key to 'out'. Produces exactly
+/// the values h() would, but amortizes the per-key cost: fixed 8-byte
+/// keys go through four-lane AVX2 (xxhash) or interleaved hardware CRC
+/// chains when the CPU allows, everything else through a four-way
+/// unrolled scalar loop that lets independent lanes overlap.
+inline void hash_n(const void *keys, size_t n, size_t len, uint64_t *out,
+                   size_t seed = 0xc70697UL) {
+  const char *p = static_cast<const char *>(keys);
+  size_t i = 0;
+#if defined(__x86_64__)
+  if (len == 8) {
+    if (hash_funcs[hash_fn_idx] == xxhash && __builtin_cpu_supports("avx2")) {
+      for (; i + 4 <= n; i += 4) {
+        xxhash8_x4_avx2(p + i * 8, seed, out + i);
+      }
+    } else if (hash_funcs[hash_fn_idx] == crchash) {
+      /* hash_select already verified SSE4.2 */
+      for (; i + 4 <= n; i += 4) {
+        crchash8_x4(p + i * 8, seed, out + i);
+      }
+    }
+  }
+#endif
+  for (; i + 4 <= n; i += 4) {
+    out[i] = h(p + i * len, len, seed);
+    out[i + 1] = h(p + (i + 1) * len, len, seed);
+    out[i + 2] = h(p + (i + 2) * len, len, seed);
+    out[i + 3] = h(p + (i + 3) * len, len, seed);
+  }
+  for (; i < n; ++i) {
+    out[i] = h(p + i * len, len, seed);
+  }
 }
 
 #endif  // UTIL_HASH_H_
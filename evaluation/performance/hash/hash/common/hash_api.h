@@ -16,6 +16,7 @@
 #define __hash_api_HPP__
 
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <string>
 
@@ -26,12 +27,44 @@ struct tree_options_t
   std::string pool_path = "";
   size_t pool_size = 0;
   size_t num_threads = 1;
+  /// Number of inserts committed per transactional batch, for tables
+  /// that support batched publishing (currently Clevel); 1 keeps the
+  /// per-operation transaction behavior.
+  size_t batch_size = 1;
+  /// Hash stage to select in tables built on the shared hash.h plug
+  /// table ("standard", "murmur2", "jenkins", "xxhash", "wyhash",
+  /// "crc"); empty keeps each table's historical default.
+  std::string hash_fn = "";
 };
 struct hash_Utilization
 {
   float load_factor;
   float utilization;
 };
+
+/// Incremental statistics surface: maintained with sampled per-thread
+/// counters (see table_stats.h) so it can be queried while traffic runs,
+/// unlike hash_Utilization which some tables compute with a full walk.
+/// Fields a table cannot derive cheaply stay zero.
+struct hash_stats_t
+{
+  /// items / capacity, when both are known.
+  double load_factor = 0.0;
+  /// Live record count, maintained on the insert/remove paths.
+  uint64_t items = 0;
+  /// Slot capacity currently allocated (possibly an estimate).
+  uint64_t capacity = 0;
+  /// Resident PM bytes attributed to the table — placement-hook
+  /// accounting where the vmem layer is in, structure-derived
+  /// otherwise; 0 when unknown.
+  uint64_t pm_bytes = 0;
+  /// Global/directory depth for extendible schemes, 0 otherwise.
+  uint64_t directory_depth = 0;
+  /// Stash or chained overflow buckets in use (possibly sampled).
+  uint64_t overflow_buckets = 0;
+  /// Sampled probe lengths, in buckets inspected; last bin is "7+".
+  uint64_t probe_hist[8] = {};
+};
 class hash_api;
 extern "C" hash_api *create_tree(const tree_options_t &opt, unsigned sz,
                                  unsigned tnum);
@@ -45,6 +78,9 @@ public:
   virtual std::string hash_name() { return ""; };
   virtual ~hash_api() {}
   virtual hash_Utilization utilization() { return hash_Utilization(); }
+  /// Incremental counterpart to utilization(); safe to call while
+  /// operations run. The default reports nothing.
+  virtual hash_stats_t stats() { return hash_stats_t(); }
   virtual bool recovery() { return false; };
   virtual void vmem_print_api(){};
   /**
@@ -59,6 +95,20 @@ public:
   virtual bool find(const char *key, size_t sz, char *value_out,
                     unsigned tid) = 0;
 
+  /**
+   * @brief Issue prefetches for the locations an operation on key would
+   *        touch (typically hash the key and prefetch its bucket).
+   *
+   * The benchmark's batched mode calls this for a window of upcoming
+   * keys before executing their operations, so independent probe misses
+   * overlap instead of serializing. The default is a no-op; tables that
+   * cannot compute bucket addresses cheaply may leave it unimplemented.
+   *
+   * @param key Pointer to beginning of key.
+   * @param sz Size of key in bytes.
+   */
+  virtual void prefetch(const char *key, size_t sz, unsigned tid) {}
+
   /**
    * @brief Insert a record with given key and value.
    *
@@ -76,6 +126,22 @@ public:
   {
     return false;
   }
+  /**
+   * @brief Bulk-load 'count' records from dense key and value arrays.
+   *
+   * 'keys' and 'values' hold count fixed-size records back to back.
+   * The default walks the regular insert path; structures that can
+   * pre-size themselves for 'count' and construct buckets with
+   * streaming writes should override it — snapshot rebuilds go through
+   * here and dominate restart time on the per-record path.
+   */
+  virtual void bulk_load(const char *keys, const char *values, size_t key_sz,
+                         size_t value_sz, uint64_t count, unsigned tid)
+  {
+    for (uint64_t i = 0; i < count; ++i)
+      insert(keys + i * key_sz, key_sz, values + i * value_sz, value_sz, tid,
+             static_cast<unsigned>(i));
+  }
   /**
    * @brief Update the record with given key with the new given value.
    *
@@ -89,6 +155,40 @@ public:
   virtual bool update(const char *key, size_t key_sz, const char *value,
                       size_t value_sz) = 0;
 
+  /**
+   * @brief Largest value size, in bytes, the table can store directly in
+   *        a slot instead of behind a pointer.
+   *
+   * create_tree compares tree_options_t::value_size against this and,
+   * when the values fit, calls set_inline_value_size before any
+   * operation is issued; hits then return the value bytes from the slot
+   * itself instead of chasing a pointer into a separately allocated
+   * record. The default of 0 keeps values out-of-line.
+   */
+  virtual size_t max_inline_value_size() { return 0; }
+
+  /**
+   * @brief Switch the wrapper to storing value_sz-byte values in-slot.
+   *
+   * Only called with value_sz <= max_inline_value_size().
+   */
+  virtual void set_inline_value_size(size_t value_sz) {}
+
+  /**
+   * @brief Insert the record, or overwrite its value if the key exists.
+   *
+   * The default falls back to update-then-insert and probes twice;
+   * tables override it with a native single-probe implementation that
+   * overwrites in place when the key is found.
+   */
+  virtual bool upsert(const char *key, size_t key_sz, const char *value,
+                      size_t value_sz, unsigned tid, unsigned t)
+  {
+    if (update(key, key_sz, value, value_sz))
+      return true;
+    return insert(key, key_sz, value, value_sz, tid, t);
+  }
+
   /**
    * @brief Remove the record with the given key.
    *
@@ -99,6 +199,56 @@ public:
    */
   virtual bool remove(const char *key, size_t key_sz, unsigned tid) = 0;
 
+  /**
+   * @brief Remove a batch of keys (bulk expiry).
+   *
+   * @param keys Pointer to the first key; keys are laid out
+   * contiguously with stride key_sz.
+   * @param key_sz Size of each key in bytes.
+   * @param count Number of keys in the batch.
+   * @return Number of keys that existed and were removed.
+   *
+   * The default loops the per-key path; wrappers that can amortize
+   * epoch entry and coalesce write-backs across the batch override it.
+   */
+  virtual uint64_t remove_batch(const char *keys, size_t key_sz,
+                                uint64_t count, unsigned tid)
+  {
+    uint64_t removed = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      if (remove(keys + i * key_sz, key_sz, tid)) removed++;
+    }
+    return removed;
+  }
+
+  /**
+   * @brief Look up a batch of independent keys.
+   *
+   * @param keys Array of count pointers to key_sz-byte keys.
+   * @param key_sz Size of each key in bytes.
+   * @param count Number of keys in the batch.
+   * @param[out] values_out count value slots, value_stride bytes apart,
+   * filled for the keys that are found.
+   * @param value_stride Distance between consecutive value slots.
+   * @return Number of keys found.
+   *
+   * The default loops the per-key path; pipelined implementations hash
+   * every key and prefetch its target bucket before completing any
+   * probe, so the batch's cache misses overlap instead of serializing.
+   */
+  virtual uint64_t find_batch(const char *const *keys, size_t key_sz,
+                              uint64_t count, char *values_out,
+                              size_t value_stride, unsigned tid)
+  {
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+      if (find(keys[i], key_sz, values_out + i * value_stride, tid)) found++;
+    }
+    return found;
+  }
+
   /**
    * @brief Scan records starting from record with given key.
    *
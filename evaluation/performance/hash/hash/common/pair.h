@@ -1,5 +1,8 @@
 #ifndef UTIL_PAIR_H_
 #define UTIL_PAIR_H_
+#include <cstdint>
+#include <cstring>
+
 #include "vmem.h"
 typedef size_t Key_t;
 typedef const char* Value_t;
@@ -23,11 +26,68 @@ struct Pair {
     return *this;
   }
 
+#ifndef CCEH_RALLOC
   void* operator new(size_t size) { return vmem_aligned_alloc(vmp, 64, size); }
 
   void* operator new[](size_t size) {
     return vmem_aligned_alloc(vmp, 64, size);
   }
+#endif
+};
+
+/*
+ * Compile-time specialized pair layout. Pair above fixes the slot shape
+ * at 8-byte key / 8-byte pointer value; FixedPair carries the byte
+ * sizes in the type instead, so slot stores, compares and value copies
+ * are constant-size operations the compiler lowers to plain loads and
+ * stores -- no per-operation length dispatch -- and a bucket of
+ * FixedPair<KS,VS> spends exactly KS+VS bytes per slot. The shapes
+ * deployments actually run (8/8, 8/16, 16/16) are instantiated once in
+ * vmem.cpp; create_tree picks a shape from tree_options_t key_size /
+ * value_size via fixed_value_wrap below (and falls back to the generic
+ * runtime-length path for anything else).
+ */
+template <size_t KS, size_t VS>
+struct FixedPair {
+  static_assert(KS == 8 || KS == 16, "unsupported key size");
+  static_assert(VS == 8 || VS == 16, "unsupported value size");
+  char key[KS];
+  char value[VS];
+
+  void store(const char* k, const char* v) {
+    memcpy(key, k, KS);
+    memcpy(value, v, VS);
+  }
+  bool match(const char* k) const { return memcmp(key, k, KS) == 0; }
+  void load_value(char* out) const { memcpy(out, value, VS); }
 };
+static_assert(sizeof(FixedPair<8, 8>) == sizeof(Pair),
+              "8/8 shape must stay slot-compatible with Pair");
+
+extern template struct FixedPair<8, 8>;
+extern template struct FixedPair<8, 16>;
+extern template struct FixedPair<16, 16>;
+
+/* In-slot value copier for the wrappers' wrap_value paths: the copy
+ * length is a template argument, so each instantiation is a fixed-width
+ * load/store instead of a runtime-length memcpy on every operation. */
+template <size_t VS>
+inline Value_t fixed_value_wrap_fn(const char* value) {
+  uint64_t v = 0;
+  memcpy(&v, value, VS);
+  return reinterpret_cast<Value_t>(v);
+}
+
+/* Selected once at create_tree time from tree_options_t::value_size;
+ * nullptr means no specialization exists and the generic path stays. */
+inline Value_t (*fixed_value_wrap(size_t value_sz))(const char*) {
+  switch (value_sz) {
+    case 1: return fixed_value_wrap_fn<1>;
+    case 2: return fixed_value_wrap_fn<2>;
+    case 4: return fixed_value_wrap_fn<4>;
+    case 8: return fixed_value_wrap_fn<8>;
+    default: return nullptr;
+  }
+}
 
 #endif  // UTIL_PAIR_H_
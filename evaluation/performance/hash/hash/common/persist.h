@@ -15,32 +15,224 @@
 #define kCacheLineSize (64)
 
 static inline void CPUPause(void) { __asm__ volatile("pause" ::: "memory"); }
+
+// Optional flush/fence accounting, compiled in with -DPERSIST_STATS.
+//
+// Every flush and fence below bumps a cache-line-padded thread-local
+// slot, so the hot path costs one private increment and no shared-line
+// traffic; with the flag off the macros compile away entirely. Totals
+// are exported through persist_stats_read(), a weak default-visibility
+// C symbol the harness dlsym()s out of the loaded table library to
+// report flushes/op and fences/op per phase. Reads race with the
+// increments, which is fine for reporting.
+#ifdef PERSIST_STATS
+#include <atomic>
+struct alignas(kCacheLineSize) persist_stats_t {
+  uint64_t flushes;
+  uint64_t fences;
+};
+#define PERSIST_STATS_SLOTS 256
+__attribute__((weak)) persist_stats_t
+    persist_stats_slots[PERSIST_STATS_SLOTS] = {};
+__attribute__((weak)) std::atomic<unsigned> persist_stats_used{0};
+static inline persist_stats_t *persist_stats_tls(void) {
+  static thread_local persist_stats_t *slot = 0;
+  if (slot == 0)
+    slot = &persist_stats_slots[persist_stats_used.fetch_add(
+                                    1, std::memory_order_relaxed) %
+                                PERSIST_STATS_SLOTS];
+  return slot;
+}
+extern "C" __attribute__((weak, visibility("default"))) void
+persist_stats_read(uint64_t *flushes, uint64_t *fences) {
+  *flushes = *fences = 0;
+  for (unsigned i = 0; i < PERSIST_STATS_SLOTS; ++i) {
+    *flushes += persist_stats_slots[i].flushes;
+    *fences += persist_stats_slots[i].fences;
+  }
+}
+#define PERSIST_COUNT_FLUSH() (persist_stats_tls()->flushes++)
+#define PERSIST_COUNT_FENCE() (persist_stats_tls()->fences++)
+#else
+#define PERSIST_COUNT_FLUSH()
+#define PERSIST_COUNT_FENCE()
+#endif
+
+// Runtime write-back dispatch, used when no flush instruction was fixed
+// at compile time: resolve once per process from CPUID
+// (clwb > clflushopt > clflush) so one binary serves the whole fleet.
+#include <cpuid.h>
+typedef void (*pwb_line_fn)(volatile char *);
+static inline void pwb_line_clflush(volatile char *p) {
+  asm volatile("clflush %0" : "+m"(*p));
+}
+static inline void pwb_line_clflushopt(volatile char *p) {
+  asm volatile("clflushopt %0" : "+m"(*p));
+}
+static inline void pwb_line_clwb(volatile char *p) {
+  asm volatile("clwb %0" : "+m"(*p));
+}
+static inline pwb_line_fn pwb_line_resolve(void) {
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    if (ebx & (1u << 24)) return pwb_line_clwb;
+    if (ebx & (1u << 23)) return pwb_line_clflushopt;
+  }
+  return pwb_line_clflush;
+}
+static pwb_line_fn pwb_line __attribute__((unused)) = 0;
+static inline void pwb(volatile char *p) {
+  if (pwb_line == 0) pwb_line = pwb_line_resolve();
+  pwb_line(p);
+}
+// name of the resolved path, for logging
+static inline const char *pwb_name(void) {
+  pwb_line_fn f = pwb_line_resolve();
+  if (f == pwb_line_clwb) return "clwb";
+  if (f == pwb_line_clflushopt) return "clflushopt";
+  return "clflush";
+}
+
 static inline void clflush(void *p) {
+  PERSIST_COUNT_FLUSH();
 #ifdef CLFLUSH
   asm volatile("clflush %0" : "+m"(p));
 #elif CLFLUSH_OPT
   asm volatile(".byte 0x66; clflush %0" : "+m"(p));
 #elif CLWB
   asm volatile(".byte 0x66; xsaveopt %0" : "+m"(p));
+#else
+  pwb((volatile char *)p);
 #endif
 }
 static inline void BARRIER(void *p) { clflush(p); }
 
-static inline void mfence(void) { asm volatile("mfence" ::: "memory"); }
+static inline void mfence(void) {
+  PERSIST_COUNT_FENCE();
+  asm volatile("mfence" ::: "memory");
+}
 
 static inline void clflush(char *data, size_t len, bool fence = true) {
   volatile char *ptr = (char *)((unsigned long)data & (~(kCacheLineSize - 1)));
   if (fence) mfence();
   for (; ptr < data + len; ptr += kCacheLineSize) {
+    PERSIST_COUNT_FLUSH();
 #ifdef CLFLUSH
     asm volatile("clflush %0" : "+m"(*(volatile char *)ptr));
 #elif CLFLUSH_OPT
     asm volatile(".byte 0x66; clflush %0" : "+m"(*(volatile char *)ptr));
 #elif CLWB
     asm volatile(".byte 0x66; xsaveopt %0" : "+m"(*(volatile char *)(ptr)));
+#else
+    pwb(ptr);
 #endif
   }
   if (fence) mfence();
 }
 
+// Non-temporal store path for write-once payloads.
+//
+// movnti is coherent but weakly ordered and bypasses the cache, so
+// bulk-load and rehash writes that are never re-read do not evict the
+// working set; callers publish with sfence(). movdir64b would move a
+// full line per instruction but needs -mmovdir64b on every TU and
+// newer parts; back-to-back movnti hit the same write-combining path.
+static inline void sfence(void) {
+  PERSIST_COUNT_FENCE();
+  asm volatile("sfence" ::: "memory");
+}
+
+static inline void ntstore_u64(void *dst, uint64_t v) {
+  asm volatile("movnti %1, %0" : "=m"(*(uint64_t *)dst) : "r"(v));
+}
+
+// Streaming stores only pay off once cache pollution outweighs the WC
+// buffer cost; below this, regular stores plus clflush win.
+enum { kNTStoreThreshold = 256 };
+
+// Streaming copy: movnti over the 8-byte-aligned body; ragged head and
+// tail fall back to plain stores plus an unfenced write-back, so the
+// whole range is durable after the caller's sfence()/mfence().
+static inline void ntstore(void *dst, const void *src, size_t len) {
+  char *d = (char *)dst;
+  const char *s = (const char *)src;
+  if ((uintptr_t)d & 7) {
+    size_t head = 8 - ((uintptr_t)d & 7);
+    if (head > len) head = len;
+    memcpy(d, s, head);
+    clflush(d, head, false);
+    d += head;
+    s += head;
+    len -= head;
+  }
+  while (len >= 8) {
+    uint64_t v;
+    memcpy(&v, s, 8);  // src may be unaligned
+    ntstore_u64(d, v);
+    d += 8;
+    s += 8;
+    len -= 8;
+  }
+  if (len > 0) {
+    memcpy(d, s, len);
+    clflush(d, len, false);
+  }
+}
+
+// Batch flush builder.
+//
+// clflush(char*, size_t) fences on both sides of every call, so a
+// commit point touching N independent regions pays 2N mfences. A
+// flush_batch collects the regions first: add() splits each range into
+// cache lines and drops lines that are already queued, commit() issues
+// all write-backs back-to-back and ends with a single mfence.
+// Write-backs are ordered after older stores to their own line, so no
+// leading fence is needed. Only batch regions with no required persist
+// order BETWEEN them -- the batch persists them as one group, not in
+// add() order.
+struct flush_batch {
+  enum { kMaxLines = 64 };
+  uintptr_t lines[kMaxLines];
+  unsigned count = 0;
+
+  void add(const void *data, size_t len) {
+    uintptr_t line = (uintptr_t)data & ~(uintptr_t)(kCacheLineSize - 1);
+    for (; line < (uintptr_t)data + len; line += kCacheLineSize) {
+      bool queued = false;
+      for (unsigned i = 0; i < count; ++i) {
+        if (lines[i] == line) {
+          queued = true;
+          break;
+        }
+      }
+      if (queued) continue;
+      // spill early when full; correct, just loses dedup across spills
+      if (count == kMaxLines) drain();
+      lines[count++] = line;
+    }
+  }
+
+  void commit() {
+    drain();
+    mfence();
+  }
+
+  void drain() {
+    for (unsigned i = 0; i < count; ++i) {
+      volatile char *ptr = (volatile char *)lines[i];
+      PERSIST_COUNT_FLUSH();
+#ifdef CLFLUSH
+      asm volatile("clflush %0" : "+m"(*ptr));
+#elif CLFLUSH_OPT
+      asm volatile(".byte 0x66; clflush %0" : "+m"(*ptr));
+#elif CLWB
+      asm volatile(".byte 0x66; xsaveopt %0" : "+m"(*ptr));
+#else
+      pwb(ptr);
+#endif
+    }
+    count = 0;
+  }
+};
+
 #endif  // UTIL_PERSIST_H_
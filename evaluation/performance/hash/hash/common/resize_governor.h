@@ -0,0 +1,123 @@
+#ifndef RESIZE_GOVERNOR_H_
+#define RESIZE_GOVERNOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+/// Paces background bucket migration against a foreground latency
+/// budget. Foreground operations feed a sampled latency EWMA through
+/// sample_op()/observe(); migration threads draw one token per migrated
+/// bucket from a bucket refilled once per millisecond, at a rate that
+/// halves while the EWMA sits above the budget and creeps back up while
+/// it does not. A resize under a loaded foreground therefore stretches
+/// out instead of saturating PM write bandwidth, trading migration
+/// duration for a bounded foreground latency hit; with an idle
+/// foreground the rate recovers to the ceiling within a few hundred
+/// refills and pacing costs nothing measurable.
+class resize_governor
+{
+public:
+  static resize_governor &instance()
+  {
+    static resize_governor g;
+    return g;
+  }
+
+  /// Foreground latency the governor tries to keep the EWMA under.
+  static constexpr uint64_t kBudgetNs = 20000;
+  /// Floor on migration progress so a resize always terminates.
+  static constexpr uint64_t kMinRatePerMs = 64;
+  /// Ceiling, effectively "unthrottled" for our table sizes.
+  static constexpr uint64_t kMaxRatePerMs = 1 << 20;
+
+  /// Foreground: returns a begin timestamp for sampled operations (one
+  /// in 64 per thread), 0 otherwise; hand the result to observe() when
+  /// the operation finishes. Non-sampled calls cost one thread-local
+  /// increment.
+  uint64_t sample_op()
+  {
+    thread_local uint64_t count = 0;
+    if ((count++ & 63) != 0)
+      return 0;
+    return now_ns();
+  }
+
+  void observe(uint64_t begin_ns)
+  {
+    if (begin_ns == 0)
+      return;
+    uint64_t lat = now_ns() - begin_ns;
+    // 1/8-gain EWMA; concurrent racy updates only blur the estimate,
+    // which is all the pacing needs.
+    uint64_t prev = ewma_ns_.load(std::memory_order_relaxed);
+    ewma_ns_.store(prev - prev / 8 + lat / 8, std::memory_order_relaxed);
+  }
+
+  /// Migration: blocks until 'buckets' tokens are available. Call once
+  /// per migrated bucket (or small batch of buckets); the wait sleeps
+  /// rather than spins so a throttled migrator yields its core.
+  void admit(uint64_t buckets)
+  {
+    for (;;)
+    {
+      int64_t want = static_cast<int64_t>(buckets);
+      int64_t have = tokens_.load(std::memory_order_relaxed);
+      if (have >= want &&
+          tokens_.compare_exchange_weak(have, have - want,
+                                        std::memory_order_relaxed))
+        return;
+      refill();
+      if (tokens_.load(std::memory_order_relaxed) < want)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+private:
+  resize_governor() : ewma_ns_(0), tokens_(kMaxRatePerMs),
+                      rate_per_ms_(kMaxRatePerMs), last_refill_ns_(now_ns()) {}
+
+  static uint64_t now_ns()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void refill()
+  {
+    uint64_t now = now_ns();
+    uint64_t last = last_refill_ns_.load(std::memory_order_relaxed);
+    uint64_t elapsed_ms = (now - last) / 1000000;
+    if (elapsed_ms == 0)
+      return;
+    if (!last_refill_ns_.compare_exchange_strong(last, now,
+                                                 std::memory_order_relaxed))
+      return;
+    uint64_t r = rate_per_ms_.load(std::memory_order_relaxed);
+    if (ewma_ns_.load(std::memory_order_relaxed) > kBudgetNs)
+    {
+      // Multiplicative backoff while the foreground is over budget,
+      // additive-ish recovery once it is not (AIMD, like it sounds).
+      r = r / 2 > kMinRatePerMs ? r / 2 : kMinRatePerMs;
+    }
+    else if (r < kMaxRatePerMs)
+    {
+      r += r / 16 + 1;
+    }
+    rate_per_ms_.store(r, std::memory_order_relaxed);
+    int64_t cap = static_cast<int64_t>(2 * r);
+    int64_t fresh = static_cast<int64_t>(r * elapsed_ms);
+    int64_t cur = tokens_.load(std::memory_order_relaxed);
+    int64_t next = cur + fresh > cap ? cap : cur + fresh;
+    tokens_.store(next, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> ewma_ns_;
+  std::atomic<int64_t> tokens_;
+  std::atomic<uint64_t> rate_per_ms_;
+  std::atomic<uint64_t> last_refill_ns_;
+};
+
+#endif // RESIZE_GOVERNOR_H_
@@ -0,0 +1,81 @@
+#ifndef TABLE_STATS_H_
+#define TABLE_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "hash_api.h"
+
+/// Incremental statistics kept with striped, sampled counters so they
+/// can be maintained on the operation path and queried while traffic
+/// runs, instead of the full-table walks behind hash_Utilization.
+///
+/// Item counts are exact (one atomic add on the stripe per mutation);
+/// probe lengths are sampled one-in-64 per thread, which is plenty to
+/// shape a histogram and keeps the common case to a thread-local
+/// increment. Stripes are cacheline-sized so concurrent writers do not
+/// share lines.
+class table_stats
+{
+public:
+  static constexpr unsigned kStripes = 16;
+  static constexpr unsigned kProbeBuckets = 8;
+
+  void record_insert() { stripe().items.fetch_add(1, std::memory_order_relaxed); }
+  void record_remove() { stripe().items.fetch_sub(1, std::memory_order_relaxed); }
+
+  /// Bulk variant for batched paths: one stripe update per batch.
+  void record_remove_n(uint64_t n)
+  {
+    stripe().items.fetch_sub(static_cast<int64_t>(n),
+                             std::memory_order_relaxed);
+  }
+
+  /// Record the number of buckets (or cache lines) a probe inspected;
+  /// lengths past the histogram edge land in the last bin. Sampled.
+  void record_probe(unsigned length)
+  {
+    thread_local uint64_t count = 0;
+    if ((count++ & 63) != 0)
+      return;
+    if (length >= kProbeBuckets)
+      length = kProbeBuckets - 1;
+    stripe().probes[length].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// Sums the stripes into the items and probe_hist fields; the caller
+  /// fills in capacity, depth, and whatever else it can derive.
+  hash_stats_t snapshot() const
+  {
+    hash_stats_t st;
+    int64_t items = 0;
+    for (unsigned s = 0; s < kStripes; ++s)
+    {
+      items += stripes_[s].items.load(std::memory_order_relaxed);
+      for (unsigned b = 0; b < kProbeBuckets; ++b)
+        st.probe_hist[b] +=
+            stripes_[s].probes[b].load(std::memory_order_relaxed);
+    }
+    st.items = items > 0 ? static_cast<uint64_t>(items) : 0;
+    return st;
+  }
+
+private:
+  struct alignas(64) stripe_t
+  {
+    std::atomic<int64_t> items{0};
+    std::atomic<uint64_t> probes[kProbeBuckets] = {};
+  };
+
+  stripe_t &stripe()
+  {
+    thread_local unsigned idx =
+        next_stripe_.fetch_add(1, std::memory_order_relaxed) % kStripes;
+    return stripes_[idx];
+  }
+
+  stripe_t stripes_[kStripes];
+  std::atomic<unsigned> next_stripe_{0};
+};
+
+#endif // TABLE_STATS_H_
@@ -1,7 +1,34 @@
 #include <hash_api.h>
 #include <libvmem.h>
+#include <stdio.h>
 #include <stdlib.h>
+
+#include "pair.h"
+#include "vmem.h"
 unsigned long PM_POOL_SZ = 32UL * 1024 * 1024 * 1024;
 VMEM* vmp = vmem_create(PMEM_LOC, PM_POOL_SZ);
 void deletePM() { vmem_delete(vmp); }
-void vmem_print() { vmem_stats_print(vmp, "1"); }
\ No newline at end of file
+
+// Per-callsite footprint report (see the accounting layer in vmem.h).
+// The old coarse jemalloc dump is still available with VMEM_POOL_STATS=1.
+void vmem_print() {
+  vmem_acct_t total;
+  vmem_acct_snapshot(&total);
+  uint64_t bytes = 0, calls = 0;
+  printf("vmem footprint by callsite:\n");
+  for (int s = 0; s < VMEM_SITE_COUNT; ++s) {
+    if (total.calls[s] == 0) continue;
+    printf("  %-10s %12lu allocs %12.1f MiB\n", vmem_site_name(s),
+           (unsigned long)total.calls[s], total.bytes[s] / (1024.0 * 1024.0));
+    bytes += total.bytes[s];
+    calls += total.calls[s];
+  }
+  printf("  %-10s %12lu allocs %12.1f MiB\n", "total", (unsigned long)calls,
+         bytes / (1024.0 * 1024.0));
+  if (getenv("VMEM_POOL_STATS")) vmem_stats_print(vmp, "1");
+}
+
+// explicit instantiations of the fixed pair shapes declared in pair.h
+template struct FixedPair<8, 8>;
+template struct FixedPair<8, 16>;
+template struct FixedPair<16, 16>;
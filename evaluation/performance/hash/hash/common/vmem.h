@@ -1,6 +1,117 @@
 #pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Allocation callsites the tables tag their placement hooks with, so a
+// footprint report can attribute growth to segments vs directories vs
+// buckets vs values. Defined outside the CCEH_RALLOC guard: ralloc
+// builds keep the tags (and ignore them) so the hooks read the same.
+enum vmem_site {
+  VMEM_SITE_OTHER = 0,
+  VMEM_SITE_SEGMENT,
+  VMEM_SITE_DIRECTORY,
+  VMEM_SITE_BUCKET,
+  VMEM_SITE_VALUE,
+  VMEM_SITE_COUNT
+};
+
+static inline const char *vmem_site_name(int site) {
+  switch (site) {
+    case VMEM_SITE_SEGMENT:
+      return "segment";
+    case VMEM_SITE_DIRECTORY:
+      return "directory";
+    case VMEM_SITE_BUCKET:
+      return "bucket";
+    case VMEM_SITE_VALUE:
+      return "value";
+    default:
+      return "other";
+  }
+}
+
+// ralloc-backed builds (-DCCEH_RALLOC) do not link libvmem; the
+// allocation hooks that normally go through vmp are redirected by the
+// including table, so the vmem surface disappears entirely.
+#ifndef CCEH_RALLOC
 #include <libvmem.h>
+
+#include <atomic>
 extern unsigned long PM_POOL_SZ;
 extern VMEM *vmp;
 void deletePM();
-void vmem_print();
\ No newline at end of file
+void vmem_print();
+
+// Per-thread, per-callsite allocation accounting behind vmem_print().
+//
+// Same shape as the PERSIST_STATS counters in persist.h: every
+// allocation bumps a cache-line-padded thread-local slot, so the
+// measured threads pay two private increments and no shared-line
+// traffic or lock. vmem_acct_snapshot() sums the slots lock-free;
+// reads race with the increments, which is fine for reporting.
+struct alignas(64) vmem_acct_t {
+  uint64_t bytes[VMEM_SITE_COUNT];
+  uint64_t calls[VMEM_SITE_COUNT];
+};
+#define VMEM_ACCT_SLOTS 256
+__attribute__((weak)) vmem_acct_t vmem_acct_slots[VMEM_ACCT_SLOTS] = {};
+__attribute__((weak)) std::atomic<unsigned> vmem_acct_used{0};
+static inline vmem_acct_t *vmem_acct_tls(void) {
+  static thread_local vmem_acct_t *slot = 0;
+  if (slot == 0)
+    slot = &vmem_acct_slots[vmem_acct_used.fetch_add(
+                                1, std::memory_order_relaxed) %
+                            VMEM_ACCT_SLOTS];
+  return slot;
+}
+static inline void vmem_account(enum vmem_site site, size_t bytes) {
+  vmem_acct_t *slot = vmem_acct_tls();
+  slot->bytes[site] += bytes;
+  slot->calls[site] += 1;
+}
+static inline void vmem_acct_snapshot(vmem_acct_t *out) {
+  for (int s = 0; s < VMEM_SITE_COUNT; ++s) out->bytes[s] = out->calls[s] = 0;
+  for (unsigned i = 0; i < VMEM_ACCT_SLOTS; ++i) {
+    for (int s = 0; s < VMEM_SITE_COUNT; ++s) {
+      out->bytes[s] += vmem_acct_slots[i].bytes[s];
+      out->calls[s] += vmem_acct_slots[i].calls[s];
+    }
+  }
+}
+// Per-thread arena over the shared pool.
+//
+// The placement hooks used to funnel every bucket/segment allocation
+// through libvmem's internal locking, which shows up in load-phase
+// profiles at high thread counts. Each thread instead bump-allocates
+// out of a private chunk and takes the pool lock once per
+// VMEM_ARENA_EXTENT refill. Requests above VMEM_ARENA_CUTOFF bypass
+// the arena — whole levels and directory tables are single allocations
+// the tables later vmem_free, so they must stay individually freeable.
+// Arena-served objects (segments, buckets, entries) are never freed by
+// the tables, so the arena implements no free; retiring whole extents
+// is the only reclamation that would ever make sense here.
+#define VMEM_ARENA_EXTENT (4UL * 1024 * 1024)
+#define VMEM_ARENA_CUTOFF (256UL * 1024)
+static inline void *vmem_arena_alloc(size_t align, size_t size) {
+  static thread_local char *cur = 0;
+  static thread_local char *end = 0;
+  if (size > VMEM_ARENA_CUTOFF) return vmem_aligned_alloc(vmp, align, size);
+  uintptr_t p = ((uintptr_t)cur + (align - 1)) & ~(uintptr_t)(align - 1);
+  if (cur == 0 || p + size > (uintptr_t)end) {
+    char *extent = (char *)vmem_aligned_alloc(vmp, 64, VMEM_ARENA_EXTENT);
+    if (extent == 0) return vmem_aligned_alloc(vmp, align, size);
+    cur = extent;
+    end = extent + VMEM_ARENA_EXTENT;
+    p = ((uintptr_t)cur + (align - 1)) & ~(uintptr_t)(align - 1);
+  }
+  cur = (char *)(p + size);
+  return (void *)p;
+}
+// Accounted flavor of the usual placement-hook call.
+static inline void *vmem_aligned_alloc_site(enum vmem_site site, size_t align,
+                                            size_t size) {
+  vmem_account(site, size);
+  return vmem_arena_alloc(align, size);
+}
+#endif
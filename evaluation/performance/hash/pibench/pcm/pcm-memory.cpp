@@ -36,6 +36,7 @@
 #include <assert.h>
 #include "cpucounters.h"
 #include "utils.h"
+#include "pmm_media.h"
 
 //Programmable iMC counter
 #define READ 0
@@ -78,6 +79,14 @@ typedef struct memdata
     float EDC_Wr_socket[max_sockets];
     uint64 partial_write[max_sockets];
     bool PMM;
+    // DIMM vendor counters (system-wide; see pmm_media.h): traffic at
+    // the media interface and the media/controller amplification the
+    // 256B media access granularity causes. PMM_media gates the output.
+    float PMM_MediaRd;
+    float PMM_MediaWr;
+    float PMM_RdAmp;
+    float PMM_WrAmp;
+    bool PMM_media;
 } memdata_t;
 
 void print_help(const string prog_name)
@@ -470,6 +479,14 @@ void display_bandwidth(PCM *m, memdata_t *md, uint32 no_columns, const bool show
                  << setw(14) << sysReadPMM << "                --|\n\
             \r|--            System PMM Write Throughput(MB/s):"
                  << setw(14) << sysWritePMM << "                --|\n";
+        if (md->PMM && md->PMM_media)
+            cout << "\
+            \r|--       System PMM Media Read Thr.      (MB/s):"
+                 << setw(14) << md->PMM_MediaRd << "                --|\n\
+            \r|--       System PMM Media Write Thr.     (MB/s):"
+                 << setw(14) << md->PMM_MediaWr << "                --|\n\
+            \r|--       PMM Amplification (media/ctrl)  Rd/Wr :"
+                 << setw(7) << md->PMM_RdAmp << "/" << setw(6) << md->PMM_WrAmp << "                --|\n";
         cout << "\
             \r|--                 System Read Throughput(MB/s):"
              << setw(14) << sysReadDRAM + sysReadPMM << "                --|\n\
@@ -532,6 +549,8 @@ void display_bandwidth_csv_header(PCM *m, memdata_t *md, const bool show_channel
     }
     if (md->PMM)
         cout << "System;System;System;System;";
+    if (md->PMM_media)
+        cout << "System;System;System;System;";
     cout << "System;System;System\n";
 
     cout << "Date;Time;";
@@ -580,6 +599,8 @@ void display_bandwidth_csv_header(PCM *m, memdata_t *md, const bool show_channel
 
     if (md->PMM)
         cout << "DRAMRead;DRAMWrite;PMMREAD;PMMWrite;";
+    if (md->PMM_media)
+        cout << "PMMMediaRead;PMMMediaWrite;PMMRdAmp;PMMWrAmp;";
     cout << "Read;Write;Memory" << endl;
 }
 
@@ -660,18 +681,45 @@ void display_bandwidth_csv(PCM *m, memdata_t *md, uint64 elapsedTime, const bool
              << setw(10) << sysWriteDRAM << ';'
              << setw(10) << sysReadPMM << ';'
              << setw(10) << sysWritePMM << ';';
+    if (md->PMM_media)
+        cout << setw(10) << md->PMM_MediaRd << ';'
+             << setw(10) << md->PMM_MediaWr << ';'
+             << setw(10) << md->PMM_RdAmp << ';'
+             << setw(10) << md->PMM_WrAmp << ';';
 
     cout << setw(10) << sysReadDRAM + sysReadPMM << ';'
          << setw(10) << sysWriteDRAM + sysWritePMM << ';'
          << setw(10) << sysReadDRAM + sysReadPMM + sysWriteDRAM + sysWritePMM << endl;
 }
 
-void calculate_bandwidth(PCM *m, const ServerUncorePowerState uncState1[], const ServerUncorePowerState uncState2[], uint64 elapsedTime, bool csv, bool &csvheader, uint32 no_columns, bool PMM, const bool show_channel_output)
+void calculate_bandwidth(PCM *m, const ServerUncorePowerState uncState1[], const ServerUncorePowerState uncState2[], uint64 elapsedTime, bool csv, bool &csvheader, uint32 no_columns, bool PMM, const bool show_channel_output,
+                         const pmm_media_counters &mediaState1 = pmm_media_counters(), const pmm_media_counters &mediaState2 = pmm_media_counters())
 {
     //const uint32 num_imc_channels = m->getMCChannelsPerSocket();
     //const uint32 num_edc_channels = m->getEDCChannelsPerSocket();
     memdata_t md;
     md.PMM = PMM;
+    md.PMM_MediaRd = 0.0;
+    md.PMM_MediaWr = 0.0;
+    md.PMM_RdAmp = 0.0;
+    md.PMM_WrAmp = 0.0;
+    md.PMM_media = false;
+    if (PMM)
+    {
+        // DIMM vendor counters over the same interval: bandwidth at the
+        // media interface and the amplification factor against the
+        // controller-side requests (256B media granularity makes the
+        // write factor > 1 for anything but dense sequential streams).
+        pmm_media_counters d = pmm_media_delta(&mediaState1, &mediaState2);
+        if (d.valid)
+        {
+            md.PMM_media = true;
+            md.PMM_MediaRd = (float)(d.media_read_bytes / 1000000.0 / (elapsedTime / 1000.0));
+            md.PMM_MediaWr = (float)(d.media_write_bytes / 1000000.0 / (elapsedTime / 1000.0));
+            md.PMM_RdAmp = (float)pmm_media_amp(d.media_read_bytes, d.ctrl_read_bytes);
+            md.PMM_WrAmp = (float)pmm_media_amp(d.media_write_bytes, d.ctrl_write_bytes);
+        }
+    }
 
     for (uint32 skt = 0; skt < m->getNumSockets(); ++skt)
     {
@@ -1110,6 +1158,12 @@ int main(int argc, char *argv[])
     for (uint32 i = 0; i < m->getNumSockets(); ++i)
         BeforeState[i] = m->getServerUncorePowerState(i);
 
+    // DIMM vendor counters bracket the same intervals; stays !valid (and
+    // silent) when ipmctl or the DIMMs are absent
+    pmm_media_counters mediaBeforeState, mediaAfterState;
+    if (PMM)
+        pmm_media_read(&mediaBeforeState);
+
     BeforeTime = m->getTickCount();
 
     if (sysCmd != NULL)
@@ -1156,6 +1210,8 @@ int main(int argc, char *argv[])
         AfterTime = m->getTickCount();
         for (uint32 i = 0; i < m->getNumSockets(); ++i)
             AfterState[i] = m->getServerUncorePowerState(i);
+        if (PMM)
+            pmm_media_read(&mediaAfterState);
 
         if (!csv)
         {
@@ -1166,10 +1222,11 @@ int main(int argc, char *argv[])
         if (rankA >= 0 || rankB >= 0)
             calculate_bandwidth(m, BeforeState, AfterState, AfterTime - BeforeTime, csv, csvheader, no_columns, rankA, rankB);
         else
-            calculate_bandwidth(m, BeforeState, AfterState, AfterTime - BeforeTime, csv, csvheader, no_columns, PMM, show_channel_output);
+            calculate_bandwidth(m, BeforeState, AfterState, AfterTime - BeforeTime, csv, csvheader, no_columns, PMM, show_channel_output, mediaBeforeState, mediaAfterState);
 
         swap(BeforeTime, AfterTime);
         swap(BeforeState, AfterState);
+        swap(mediaBeforeState, mediaAfterState);
 
         if (m->isBlocked())
         {
@@ -0,0 +1,116 @@
+/*
+   Per-DIMM PMem vendor counters: media traffic vs controller traffic.
+
+   The iMC PMM_READ/PMM_WRITE events (pcm-memory -pmm, PiBench's
+   getBytesRead/WrittenFromPMM) see the DDR-T bus, i.e. the 64B requests
+   the CPU issues to the DIMM controller. The DIMM itself accesses its
+   media in 256B blocks, so small or scattered writes are amplified
+   behind the bus where those counters cannot see it. The DIMM firmware
+   keeps its own lifetime counters on both sides of that boundary --
+   MediaReads/MediaWrites (media interface) and
+   ReadRequests/WriteRequests (controller interface), all ticking once
+   per 64B -- and the ratio media/controller is the amplification
+   factor.
+
+   The counters are only reachable through the nvdimm DSM, so this
+   reader shells out to `ipmctl show -performance` and sums the per-DIMM
+   values. Reads degrade gracefully: without ipmctl (or without PMem
+   DIMMs) valid stays false and callers skip the metric. A snapshot
+   costs one ipmctl invocation (~tens of ms), so bracket phases with it,
+   not operations.
+*/
+
+#ifndef PMM_MEDIA_H
+#define PMM_MEDIA_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct pmm_media_counters
+{
+    uint64_t media_read_bytes = 0;
+    uint64_t media_write_bytes = 0;
+    uint64_t ctrl_read_bytes = 0;
+    uint64_t ctrl_write_bytes = 0;
+    int dimms = 0;
+    bool valid = false;
+};
+
+/* Parse "   Key=0x<hex>" into the low 64 bits of the (128-bit) value.
+   The firmware counters are cumulative since boot; deltas over a
+   bracket fit comfortably in 64 bits. */
+static inline bool pmm_media_parse_hex(const char *line, const char *key,
+                                       uint64_t *out)
+{
+    while (*line == ' ' || *line == '\t')
+        ++line;
+    size_t klen = strlen(key);
+    if (strncmp(line, key, klen) != 0 || line[klen] != '=')
+        return false;
+    const char *v = line + klen + 1;
+    if (v[0] == '0' && (v[1] == 'x' || v[1] == 'X'))
+        v += 2;
+    size_t n = strspn(v, "0123456789abcdefABCDEF");
+    if (n == 0)
+        return false;
+    /* keep the low 16 hex digits = low 64 bits */
+    const char *lo = (n > 16) ? v + (n - 16) : v;
+    *out = strtoull(lo, NULL, 16);
+    return true;
+}
+
+/* One snapshot, summed over all DIMMs; returns c->valid. */
+static inline bool pmm_media_read(struct pmm_media_counters *c)
+{
+    *c = pmm_media_counters();
+#ifdef _MSC_VER
+    return false; /* no popen; Linux-only, like the rest of our PM stack */
+#else
+    FILE *p = popen("ipmctl show -performance 2>/dev/null", "r");
+    if (p == NULL)
+        return false;
+    char line[512];
+    uint64_t v = 0;
+    while (fgets(line, sizeof(line), p) != NULL)
+    {
+        if (strstr(line, "DimmID") != NULL)
+            c->dimms++;
+        else if (pmm_media_parse_hex(line, "MediaReads", &v))
+            c->media_read_bytes += v * 64;
+        else if (pmm_media_parse_hex(line, "MediaWrites", &v))
+            c->media_write_bytes += v * 64;
+        else if (pmm_media_parse_hex(line, "ReadRequests", &v))
+            c->ctrl_read_bytes += v * 64;
+        else if (pmm_media_parse_hex(line, "WriteRequests", &v))
+            c->ctrl_write_bytes += v * 64;
+    }
+    pclose(p);
+    c->valid = c->dimms > 0 &&
+               (c->media_read_bytes != 0 || c->media_write_bytes != 0);
+    return c->valid;
+#endif
+}
+
+static inline struct pmm_media_counters
+pmm_media_delta(const struct pmm_media_counters *before,
+                const struct pmm_media_counters *after)
+{
+    struct pmm_media_counters d;
+    d.media_read_bytes = after->media_read_bytes - before->media_read_bytes;
+    d.media_write_bytes = after->media_write_bytes - before->media_write_bytes;
+    d.ctrl_read_bytes = after->ctrl_read_bytes - before->ctrl_read_bytes;
+    d.ctrl_write_bytes = after->ctrl_write_bytes - before->ctrl_write_bytes;
+    d.dimms = after->dimms;
+    d.valid = before->valid && after->valid;
+    return d;
+}
+
+/* media/controller ratio; 0 when the controller side saw no traffic */
+static inline double pmm_media_amp(uint64_t media_bytes, uint64_t ctrl_bytes)
+{
+    return ctrl_bytes != 0 ? (double)media_bytes / (double)ctrl_bytes : 0.0;
+}
+
+#endif /* PMM_MEDIA_H */
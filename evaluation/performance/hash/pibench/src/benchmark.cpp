@@ -1,21 +1,35 @@
 #include "benchmark.hpp"
+#include "hash.h"
 
+#include <fcntl.h>        // open
 #include <omp.h>
-#include <sys/utsname.h> // uname
+#include <pthread.h>      // pthread_setaffinity_np
+#include <sched.h>        // sched_getcpu
+#include <sys/mman.h>     // mmap
+#include <sys/resource.h> // getrusage (straggler check)
+#include <sys/stat.h>     // fstat
+#include <sys/utsname.h>  // uname
+#include <unistd.h>       // close
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <cmath> // std::ceil
+#include <cmath>  // std::ceil
+#include <cstdio> // fwrite
 #include <ctime>
 #include <fstream>
 #include <functional> // std::bind
 #include <iostream>
 #include <map>
 #include <regex> // std::regex_replace
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "hash_api.h"
+#include "library_loader.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 using namespace std;
 namespace PiBench
@@ -86,13 +100,181 @@ namespace PiBench
               << "\tKernel: " << kernel_version << std::endl;
   }
 
-  benchmark_t::benchmark_t(hash_api *tree, const options_t &opt) noexcept
-      : tree_(tree),
+  // Expand a sysfs-style CPU list ("0-3,8,10-11") into CPU ids.
+  static std::vector<int> parse_cpulist(const std::string &s)
+  {
+    std::vector<int> cpus;
+    std::stringstream ss(s);
+    std::string tok;
+    while (std::getline(ss, tok, ','))
+    {
+      if (tok.empty())
+        continue;
+      auto dash = tok.find('-');
+      if (dash == std::string::npos)
+      {
+        cpus.push_back(atoi(tok.c_str()));
+      }
+      else
+      {
+        int last = atoi(tok.c_str() + dash + 1);
+        for (int c = atoi(tok.substr(0, dash).c_str()); c <= last; ++c)
+          cpus.push_back(c);
+      }
+    }
+    return cpus;
+  }
+
+  // Per-NUMA-node CPU ids read from sysfs, so no libnuma dependency.
+  // Falls back to a single flat node when the topology is not exposed.
+  static std::vector<std::vector<int>> read_numa_nodes()
+  {
+    std::vector<std::vector<int>> nodes;
+    for (int n = 0;; ++n)
+    {
+      std::ifstream f("/sys/devices/system/node/node" + std::to_string(n) +
+                      "/cpulist");
+      if (!f.good())
+        break;
+      std::string line;
+      std::getline(f, line);
+      nodes.push_back(parse_cpulist(line));
+    }
+    if (nodes.empty())
+    {
+      nodes.emplace_back();
+      for (unsigned c = 0; c < std::thread::hardware_concurrency(); ++c)
+        nodes[0].push_back(c);
+    }
+    return nodes;
+  }
+
+  static std::vector<int> build_affinity(const std::string &policy)
+  {
+    if (policy.empty())
+      return {};
+    auto nodes = read_numa_nodes();
+    std::vector<int> cpus;
+    if (policy == "compact")
+    {
+      for (auto &node : nodes)
+        cpus.insert(cpus.end(), node.begin(), node.end());
+    }
+    else if (policy == "scatter")
+    {
+      for (size_t i = 0;; ++i)
+      {
+        bool any = false;
+        for (auto &node : nodes)
+          if (i < node.size())
+          {
+            cpus.push_back(node[i]);
+            any = true;
+          }
+        if (!any)
+          break;
+      }
+    }
+    else if (policy.rfind("node:", 0) == 0)
+    {
+      size_t n = atoi(policy.c_str() + 5);
+      if (n >= nodes.size())
+      {
+        std::cout << "Affinity node " << n << " does not exist." << std::endl;
+        exit(1);
+      }
+      cpus = nodes[n];
+    }
+    else
+    {
+      cpus = parse_cpulist(policy);
+    }
+    if (cpus.empty())
+    {
+      std::cout << "Affinity policy yields no CPUs: " << policy << std::endl;
+      exit(1);
+    }
+    return cpus;
+  }
+
+  void benchmark_t::pin_thread(uint32_t tid) noexcept
+  {
+    if (cpu_assign_.empty())
+      return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu_assign_[tid % cpu_assign_.size()], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  benchmark_t::benchmark_t(tree_t *tree, const options_t &opt) noexcept
+      : kvs(nullptr),
+        tree_(tree),
         opt_(opt),
-        op_generator_(opt.read_ratio, opt.insert_ratio, opt.remove_ratio),
+        op_generator_(opt.read_ratio, opt.insert_ratio, opt.remove_ratio,
+                      opt.rmw_ratio, opt.upsert_ratio),
         value_generator_(opt.value_size),
-        pcm_(nullptr)
+        pcm_(nullptr),
+        replay_map_(nullptr),
+        replay_bytes_(0),
+        key_slab_(nullptr),
+        value_slab_(nullptr)
   {
+    cpu_assign_ = build_affinity(opt.affinity);
+    batch_size_ = std::max(1u, opt.batch_size);
+    if (!opt.value_size_dist.empty())
+      value_generator_ = value_generator_t(opt.value_size_dist, opt.value_size);
+    if (opt.format == "json")
+    {
+      results_.open(opt.result_file, std::ofstream::app);
+      if (!results_.is_open())
+      {
+        std::cout << "Error opening results file: " << opt.result_file
+                  << std::endl;
+        exit(0);
+      }
+      // Config echo first, so every line of a partial run can be joined
+      // back to the parameters that produced it.
+      std::ostringstream cfg;
+      cfg << "\"event\":\"config\",\"library\":\"" << opt.library_file
+          << "\",\"num_ops\":" << opt.num_ops
+          << ",\"threads\":" << opt.num_threads
+          << ",\"key_size\":" << opt.key_size
+          << ",\"value_size\":" << opt.value_size
+          << ",\"read_ratio\":" << opt.read_ratio
+          << ",\"insert_ratio\":" << opt.insert_ratio
+          << ",\"remove_ratio\":" << opt.remove_ratio
+          << ",\"rmw_ratio\":" << opt.rmw_ratio
+          << ",\"upsert_ratio\":" << opt.upsert_ratio
+          << ",\"skew\":" << opt.key_skew << ",\"seed\":" << opt.rnd_seed;
+      emit_result(cfg.str());
+    }
+    if (!opt.replay_file.empty())
+    {
+      int fd = open(opt.replay_file.c_str(), O_RDONLY);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) != 0)
+      {
+        std::cout << "Error opening trace: " << opt.replay_file << std::endl;
+        exit(0);
+      }
+      replay_bytes_ = st.st_size;
+      replay_map_ = static_cast<char *>(
+          mmap(nullptr, replay_bytes_, PROT_READ, MAP_PRIVATE, fd, 0));
+      close(fd);
+      auto h = reinterpret_cast<const trace_header_t *>(replay_map_);
+      if (replay_map_ == MAP_FAILED || replay_bytes_ < sizeof(trace_header_t) ||
+          h->magic != trace_header_t::MAGIC ||
+          h->version != trace_header_t::VERSION || h->key_size != opt.key_size ||
+          replay_bytes_ < sizeof(trace_header_t) +
+                              h->num_ops * trace_record_size(h->key_size))
+      {
+        std::cout << "Error: invalid or truncated trace: " << opt.replay_file
+                  << std::endl;
+        exit(0);
+      }
+      madvise(replay_map_, replay_bytes_, MADV_SEQUENTIAL);
+    }
     if (opt.enable_pcm)
     {
       pcm_ = PCM::getInstance();
@@ -103,7 +285,20 @@ namespace PiBench
         if (status == PCM::PMUBusy)
           pcm_->resetPMU();
         else
-          exit(0);
+        {
+          // No MSR access (containerized runners): fall back to the
+          // perf_event provider instead of dropping counters entirely.
+          // This must happen before the first parallel region so the
+          // inherited core events cover the workers.
+          pcm_ = nullptr;
+          if (perf_.open())
+            std::cout << "PCM unavailable; using perf_event counters"
+                      << std::endl;
+          else
+            std::cout << "perf_event fallback unavailable too; "
+                         "running without hardware counters"
+                      << std::endl;
+        }
       }
     }
 
@@ -135,7 +330,402 @@ namespace PiBench
   {
     if (pcm_)
       pcm_->cleanup();
+    if (replay_map_)
+      munmap(replay_map_, replay_bytes_);
     delete[] kvs;
+    delete[] key_slab_;
+    delete[] value_slab_;
+  }
+
+  void benchmark_t::emit_result(const std::string &fields) noexcept
+  {
+    if (!results_.is_open())
+      return;
+    results_ << "{" << fields << "}\n";
+    results_.flush();
+  }
+
+  void benchmark_t::pcm_begin() noexcept
+  {
+    if (persist_stats_read_fn)
+      persist_stats_read_fn(&flush_before_, &fence_before_);
+    if (pcm_ || perf_.active())
+      pmm_media_read(&media_before_);
+    if (!pcm_)
+    {
+      if (perf_.active())
+        perf_.begin();
+      return;
+    }
+    pcm_before_ = std::make_unique<SystemCounterState>();
+    *pcm_before_ = getSystemCounterState();
+  }
+
+  void benchmark_t::pcm_end(const char *phase, uint64_t ops,
+                            float elapsed_ms) noexcept
+  {
+    if (persist_stats_read_fn)
+    {
+      // Counters are monotonic; the phase cost is the delta against the
+      // pcm_begin() snapshot.
+      uint64_t fl, fe;
+      persist_stats_read_fn(&fl, &fe);
+      fl -= flush_before_;
+      fe -= fence_before_;
+      std::cout << "Persist[" << phase << "]: flushed lines: " << fl
+                << " fences: " << fe;
+      if (ops > 0)
+        std::cout << " flushes/op: " << (float)fl / ops
+                  << " fences/op: " << (float)fe / ops;
+      std::cout << std::endl;
+      std::ostringstream j;
+      j << "\"event\":\"persist\",\"phase\":\"" << phase
+        << "\",\"flushed_lines\":" << fl << ",\"fences\":" << fe
+        << ",\"ops\":" << ops;
+      emit_result(j.str());
+    }
+    if (pcm_ || perf_.active())
+    {
+      // DIMM vendor counters over the same bracket: traffic at the
+      // media interface next to the 64B requests the controller
+      // received, and their ratio — the write amplification the 256B
+      // media access granularity causes, which the bus-side PMM
+      // counters cannot see. Skipped when ipmctl or PMem are absent.
+      pmm_media_counters media_after;
+      pmm_media_read(&media_after);
+      auto d = pmm_media_delta(&media_before_, &media_after);
+      if (d.valid)
+      {
+        double msecs = elapsed_ms / 1000.0;
+        auto rd_amp = pmm_media_amp(d.media_read_bytes, d.ctrl_read_bytes);
+        auto wr_amp = pmm_media_amp(d.media_write_bytes, d.ctrl_write_bytes);
+        std::cout << "PMM-media[" << phase << "]:\n"
+                  << "\tmedia read/write (MB/s): "
+                  << (msecs > 0 ? d.media_read_bytes / 1e6 / msecs : 0)
+                  << " / "
+                  << (msecs > 0 ? d.media_write_bytes / 1e6 / msecs : 0)
+                  << "\n"
+                  << "\tamplification (media/ctrl) read/write: " << rd_amp
+                  << " / " << wr_amp << "\n";
+        if (ops > 0)
+          std::cout << "\tmedia bytes/op read/write: "
+                    << (float)d.media_read_bytes / ops << " / "
+                    << (float)d.media_write_bytes / ops << "\n";
+        std::cout << std::flush;
+        std::ostringstream mj;
+        mj << "\"event\":\"pmm_media\",\"phase\":\"" << phase
+           << "\",\"elapsed_ms\":" << elapsed_ms << ",\"ops\":" << ops
+           << ",\"media_read_bytes\":" << d.media_read_bytes
+           << ",\"media_write_bytes\":" << d.media_write_bytes
+           << ",\"ctrl_read_bytes\":" << d.ctrl_read_bytes
+           << ",\"ctrl_write_bytes\":" << d.ctrl_write_bytes
+           << ",\"read_amplification\":" << rd_amp
+           << ",\"write_amplification\":" << wr_amp;
+        emit_result(mj.str());
+      }
+    }
+    if (!pcm_ && perf_.active())
+    {
+      // Same bracket, perf_event provider: cycles and miss rates per
+      // operation, plus IMC bandwidth where the uncore events opened.
+      auto d = perf_.end();
+      double psecs = elapsed_ms / 1000.0;
+      std::cout << "Perf[" << phase << "]:\n"
+                << "\tcycles: " << d.cycles
+                << " LLC misses: " << d.llc_misses
+                << " dTLB misses: " << d.dtlb_misses << "\n";
+      if (d.has_imc)
+        std::cout << "\tIMC read/write (MB/s): "
+                  << (psecs > 0 ? d.imc_read_bytes / 1e6 / psecs : 0) << " / "
+                  << (psecs > 0 ? d.imc_write_bytes / 1e6 / psecs : 0)
+                  << "\n";
+      if (ops > 0)
+      {
+        std::cout << "\tcycles/op: " << (float)d.cycles / ops
+                  << " LLC misses/op: " << (float)d.llc_misses / ops
+                  << " dTLB misses/op: " << (float)d.dtlb_misses / ops
+                  << "\n";
+        if (d.has_imc)
+          std::cout << "\tIMC bytes/op read/write: "
+                    << (float)d.imc_read_bytes / ops << " / "
+                    << (float)d.imc_write_bytes / ops << "\n";
+      }
+      std::cout << std::flush;
+      std::ostringstream pj;
+      pj << "\"event\":\"perf\",\"phase\":\"" << phase
+         << "\",\"elapsed_ms\":" << elapsed_ms << ",\"ops\":" << ops
+         << ",\"cycles\":" << d.cycles << ",\"llc_misses\":" << d.llc_misses
+         << ",\"dtlb_misses\":" << d.dtlb_misses;
+      if (d.has_imc)
+        pj << ",\"imc_read_bytes\":" << d.imc_read_bytes
+           << ",\"imc_write_bytes\":" << d.imc_write_bytes;
+      emit_result(pj.str());
+      return;
+    }
+    if (!pcm_ || !pcm_before_)
+      return;
+    SystemCounterState after = getSystemCounterState();
+    auto dram_rd = getBytesReadFromMC(*pcm_before_, after);
+    auto dram_wr = getBytesWrittenToMC(*pcm_before_, after);
+    auto pm_rd = getBytesReadFromPMM(*pcm_before_, after);
+    auto pm_wr = getBytesWrittenToPMM(*pcm_before_, after);
+    auto l3 = getL3CacheMisses(*pcm_before_, after);
+    // RAPL package and DRAM energy over the same bracket; on our
+    // power-capped boxes joules per operation matters as much as
+    // nanoseconds per operation.
+    auto pkg_j = getConsumedJoules(*pcm_before_, after);
+    auto dram_j = getDRAMConsumedJoules(*pcm_before_, after);
+    double secs = elapsed_ms / 1000.0;
+    std::cout << "PCM[" << phase << "]:\n"
+              << "\tDRAM read/write (MB/s): " << (secs > 0 ? dram_rd / 1e6 / secs : 0)
+              << " / " << (secs > 0 ? dram_wr / 1e6 / secs : 0) << "\n"
+              << "\tPM read/write (MB/s): " << (secs > 0 ? pm_rd / 1e6 / secs : 0)
+              << " / " << (secs > 0 ? pm_wr / 1e6 / secs : 0) << "\n";
+    if (ops > 0)
+    {
+      std::cout << "\tDRAM bytes/op read/write: " << (float)dram_rd / ops
+                << " / " << (float)dram_wr / ops << "\n"
+                << "\tPM bytes/op read/write: " << (float)pm_rd / ops << " / "
+                << (float)pm_wr / ops << "\n"
+                << "\tLLC misses/op: " << (float)l3 / ops << "\n";
+      if (pkg_j > 0)
+        std::cout << "\tEnergy uJ/op package/DRAM: " << pkg_j * 1e6 / ops
+                  << " / " << dram_j * 1e6 / ops << "\n"
+                  << "\tops/J: " << ops / (pkg_j + dram_j) << "\n";
+    }
+    std::cout << "\tEnergy package/DRAM (J): " << pkg_j << " / " << dram_j
+              << " (avg W: " << (secs > 0 ? (pkg_j + dram_j) / secs : 0) << ")"
+              << "\n"
+              << "\tLLC misses: " << l3 << std::endl;
+    std::ostringstream j;
+    j << "\"event\":\"pcm\",\"phase\":\"" << phase
+      << "\",\"elapsed_ms\":" << elapsed_ms << ",\"ops\":" << ops
+      << ",\"dram_read_bytes\":" << dram_rd
+      << ",\"dram_write_bytes\":" << dram_wr << ",\"pm_read_bytes\":" << pm_rd
+      << ",\"pm_write_bytes\":" << pm_wr << ",\"llc_misses\":" << l3
+      << ",\"pkg_joules\":" << pkg_j << ",\"dram_joules\":" << dram_j;
+    emit_result(j.str());
+  }
+
+  float benchmark_t::generate_workload() noexcept
+  {
+    kvs = new pair[opt_.num_ops];
+    auto kvs1 = new pair[opt_.num_ops];
+    // Keys and values live in contiguous slabs the timed loop walks
+    // sequentially, instead of one heap allocation per record.
+    key_slab_ = new char[opt_.num_ops * opt_.key_size];
+    value_slab_ = new char[opt_.num_ops * opt_.value_size];
+    auto neg_slab = new char[opt_.num_ops * opt_.key_size];
+    stopwatch_t sw;
+    sw.start();
+    map<uint64_t, uint64_t> cf;
+    std::cout << "generating data..." << std::endl;
+    trace_ops_.resize(opt_.num_ops);
+    if (!value_generator_.size_classes().empty())
+    {
+      // Variable value sizes: the slab keeps a fixed max-size stride so
+      // partitioned generation can index it directly; actual sizes and
+      // size classes are recorded per record.
+      value_sz_.resize(opt_.num_ops);
+      value_cls_.resize(opt_.num_ops);
+    }
+    std::atomic<uint64_t> progress(0);
+#pragma omp parallel num_threads(opt_.num_threads)
+    {
+      auto tid = omp_get_thread_num();
+      pin_thread(tid);
+      // Partition the keyspace statically. All generator state is
+      // thread_local, so each worker re-seeds its own stream; a given
+      // (seed, thread count) pair reproduces the same workload, and the
+      // sequential ids of the slices stay disjoint.
+      uint64_t chunk = (opt_.num_ops + opt_.num_threads - 1) / opt_.num_threads;
+      uint64_t begin = static_cast<uint64_t>(tid) * chunk;
+      uint64_t end = std::min(begin + chunk, opt_.num_ops);
+      key_generator_->prepare_thread(opt_.rnd_seed + tid,
+                                     key_generator_t::SEQ_BASE + begin);
+      operation_generator_t::set_seed(opt_.rnd_seed + tid);
+      value_generator_t::set_seed(opt_.rnd_seed + tid);
+      // Key-dependency flags are pre-drawn with the rest of the stream;
+      // chain starts never cross the partition boundary, so the first
+      // record of each slice is always independent.
+      std::default_random_engine dep_gen(opt_.rnd_seed + tid);
+      std::uniform_real_distribution<float> dep_dist(0.0, 1.0);
+      // Negative lookups draw from their own engine so enabling them
+      // does not perturb the dependency stream.
+      std::default_random_engine neg_gen(~(opt_.rnd_seed + tid));
+      std::uniform_real_distribution<float> neg_dist(0.0, 1.0);
+      std::uniform_int_distribution<uint64_t> neg_pick(
+          0, key_generator_->keyspace() - 1);
+      // Churn state is per slice: removes only ever target keys the
+      // same slice inserted earlier, so the pre-drawn stream stays
+      // valid however the run threads interleave.
+      std::default_random_engine churn_gen(opt_.rnd_seed + tid + 0x9e3779b9);
+      std::uniform_real_distribution<float> churn_dist(0.0, 1.0);
+      uint64_t churn_ins = 0, churn_rem = 0;
+      uint64_t last_report = 0;
+      for (uint64_t i = begin; i < end; ++i)
+      {
+        // Drifting hotspot: advance the id rotation with stream
+        // position. The run consumes each slice in order under the
+        // static schedule, so position stands in for elapsed time and
+        // all slices drift in step.
+        if (opt_.hotspot_drift > 0)
+          key_generator_t::set_rotation(
+              static_cast<uint64_t>(static_cast<double>(i - begin) / chunk *
+                                    opt_.hotspot_drift *
+                                    key_generator_->keyspace()) %
+              key_generator_->keyspace());
+        auto key_ptr = key_generator_->next(false);
+        // Generate random value
+        auto value_ptr = value_generator_.next();
+        uint32_t vsz = opt_.value_size;
+        if (!value_sz_.empty())
+        {
+          auto cls = value_generator_.next_size_class();
+          vsz = value_generator_.size_classes()[cls];
+          value_sz_[i] = vsz;
+          value_cls_[i] = cls;
+        }
+        kvs[i].key = key_slab_ + i * opt_.key_size;
+        kvs[i].value = value_slab_ + i * opt_.value_size;
+        memcpy(kvs[i].key, key_ptr, opt_.key_size);
+        // Verification mode stores f(key) instead of random bytes, so
+        // duplicate inserts of a hot key write identical values and any
+        // read can be validated. Keyed off the slab entry, which is
+        // what the load phase inserts; run-phase writes under a
+        // redirected key re-derive inline.
+        if (opt_.verify)
+          value_generator_t::fill_checksum(kvs[i].key, opt_.key_size,
+                                           kvs[i].value, vsz);
+        else
+          memcpy(kvs[i].value, value_ptr, vsz);
+        auto key_ptr1 = key_generator_->next(true);
+        kvs1[i].key = neg_slab + i * opt_.key_size;
+        kvs1[i].value = kvs[i].value;
+        memcpy(kvs1[i].key, key_ptr1, opt_.key_size);
+        // Zipfian/selfsimilar op sampling is pre-drawn here too so it
+        // never runs inside the measured loop.
+        trace_ops_[i] = static_cast<uint8_t>(op_generator_.next());
+        // Churn: replace the drawn operation with the next step of the
+        // sliding window — grow to churn_window fresh keys, then
+        // alternate inserting a new key and removing the oldest live
+        // one, so cardinality stays constant while records turn over.
+        bool churn = false;
+        if (opt_.churn_ratio > 0 &&
+            churn_dist(churn_gen) < opt_.churn_ratio)
+        {
+          churn = true;
+          uint64_t id;
+          if (churn_ins - churn_rem < opt_.churn_window)
+          {
+            id = key_generator_t::CHURN_BASE + begin + churn_ins++;
+            trace_ops_[i] = static_cast<uint8_t>(operation_t::INSERT);
+          }
+          else
+          {
+            id = key_generator_t::CHURN_BASE + begin + churn_rem++;
+            trace_ops_[i] = static_cast<uint8_t>(operation_t::REMOVE);
+          }
+          memcpy(kvs1[i].key, key_generator_->key_for_id(id),
+                 opt_.key_size);
+          kvs[i].key = kvs1[i].key;
+        }
+        // Negative lookup: redirect the run key of a READ to an id
+        // above every loaded one (NEG_BASE), leaving the slab entry —
+        // which is what the load phase inserts — untouched. The
+        // run-phase find() then misses by construction.
+        bool neg = false;
+        if (opt_.negative &&
+            trace_ops_[i] == static_cast<uint8_t>(operation_t::READ) &&
+            neg_dist(neg_gen) < opt_.negative_ratio)
+        {
+          neg = true;
+          memcpy(kvs1[i].key,
+                 key_generator_->key_for_id(key_generator_t::NEG_BASE +
+                                            neg_pick(neg_gen)),
+                 opt_.key_size);
+          kvs[i].key = kvs1[i].key;
+        }
+        if (opt_.dep_ratio > 0.0 && i != begin && !neg && !churn &&
+            dep_dist(dep_gen) < opt_.dep_ratio)
+          trace_ops_[i] |= OP_DEP_FLAG;
+        if (((i - begin) & 0xFFFFF) == 0xFFFFF)
+        {
+          auto done =
+              progress.fetch_add(0x100000, std::memory_order_relaxed) + 0x100000;
+          if (tid == 0 && done - last_report >= opt_.num_ops / 10)
+          {
+            last_report = done;
+            auto ms = sw.elapsed<std::chrono::milliseconds>();
+            std::cout << "\tgenerated " << done / 1000000 << "M/"
+                      << opt_.num_ops / 1000000 << "M (ETA "
+                      << ms / done * (opt_.num_ops - done) / 1000 << " s)"
+                      << std::endl;
+          }
+        }
+      }
+    }
+    auto elapsed_gen = sw.elapsed<std::chrono::milliseconds>();
+    if (!opt_.hash_fn.empty() && hash_select(opt_.hash_fn.c_str()))
+    {
+      // Hash the materialized key stream through the batch interface
+      // and summarize how evenly the selected stage spreads it over a
+      // directory-sized bucket space. The tables are handed the same
+      // stage through tree_options_t, so probe-length shifts in the
+      // measured run can be attributed to the quality reported here.
+      std::vector<uint64_t> hashes(opt_.num_ops);
+      stopwatch_t hsw;
+      hsw.start();
+      hash_n(key_slab_, opt_.num_ops, opt_.key_size, hashes.data());
+      auto hash_us = hsw.elapsed<std::chrono::microseconds>();
+      constexpr uint64_t kHashBuckets = 1ULL << 16;
+      std::vector<uint64_t> bucket_load(kHashBuckets, 0);
+      for (uint64_t i = 0; i < opt_.num_ops; ++i)
+        ++bucket_load[hashes[i] >> 48];
+      double expected = static_cast<double>(opt_.num_ops) / kHashBuckets;
+      double chi2 = 0.0;
+      uint64_t max_load = 0;
+      for (uint64_t b = 0; b < kHashBuckets; ++b)
+      {
+        double d = bucket_load[b] - expected;
+        chi2 += d * d / expected;
+        max_load = std::max(max_load, bucket_load[b]);
+      }
+      std::cout << "Hash stage '" << opt_.hash_fn << "': "
+                << (opt_.num_ops * opt_.key_size) / (hash_us ? hash_us : 1)
+                << " MB/s over the key stream, chi2/bucket "
+                << chi2 / kHashBuckets << ", max bucket load " << max_load
+                << " (expected " << expected << ")" << std::endl;
+    }
+    if (!opt_.record_file.empty())
+    {
+      // The operation stream is already materialized above, so the
+      // dumped trace is exactly what this process will go on to execute.
+      FILE *f = fopen(opt_.record_file.c_str(), "wb");
+      if (f == nullptr)
+      {
+        std::cout << "Error opening trace for write: " << opt_.record_file
+                  << std::endl;
+        exit(0);
+      }
+      trace_header_t h = {trace_header_t::MAGIC, trace_header_t::VERSION,
+                          opt_.num_ops, opt_.key_size, opt_.value_size};
+      fwrite(&h, sizeof(h), 1, f);
+      for (uint64_t i = 0; i < opt_.num_ops; ++i)
+      {
+        fwrite(&trace_ops_[i], 1, 1, f);
+        fwrite(kvs[i].key, 1, opt_.key_size, f);
+      }
+      fclose(f);
+      std::cout << "Recorded " << opt_.num_ops << " operations to "
+                << opt_.record_file << std::endl;
+    }
+    delete[] kvs1;
+    // Redirected run keys (negative or churned) alias neg_slab, so it
+    // must outlive the run.
+    if (!opt_.negative && opt_.churn_ratio == 0)
+      delete[] neg_slab;
+    return elapsed_gen;
   }
 
   void benchmark_t::load() noexcept
@@ -147,28 +737,93 @@ namespace PiBench
     std::cout << "mode latency: " << opt_.latency << std::endl;
     std::cout << "mode load_factor: " << opt_.load_factor << std::endl;
     std::cout << "if test mode is `load_factor`, thread num will be 1. " << std::endl;
-    kvs = new pair[opt_.num_ops];
-    auto kvs1 = new pair[opt_.num_ops];
-    stopwatch_t sw;
-    sw.start();
-    auto negative_size = opt_.negative_ratio * opt_.num_ops;
-    map<uint64_t, uint64_t> cf;
-    std::cout << "generating data..." << std::endl;
-    for (uint64_t i = 0; i < opt_.num_ops; ++i)
+    if (replay_map_)
     {
-      auto key_ptr = key_generator_->next(false);
-      // Generate random value
-      auto value_ptr = value_generator_.next();
-      kvs[i] = pair(key_ptr, opt_.key_size, value_ptr, opt_.value_size);
-      auto key_ptr1 = key_generator_->next(true);
-      kvs1[i] = pair(key_ptr1, opt_.key_size, value_ptr, opt_.value_size);
+      // Replaying: keys stream straight out of the trace mapping, so no
+      // workload is generated. The load phase, when enabled, inserts
+      // each trace key with a filler value.
+      if (!opt_.skip_load)
+      {
+        stopwatch_t sw;
+        sw.start();
+        pcm_begin();
+        const char *recs = replay_map_ + sizeof(trace_header_t);
+        uint64_t rec_sz = trace_record_size(opt_.key_size);
+#pragma omp parallel num_threads(opt_.num_threads)
+        {
+          auto tid = omp_get_thread_num();
+          pin_thread(tid);
+          uint64_t counter = 0;
+          char value_in[value_generator_t::VALUE_MAX] = {0};
+          tree_->thread_ini(tid);
+#pragma omp for schedule(static)
+          for (uint64_t i = 0; i < opt_.num_ops; ++i)
+          {
+            tree_->insert(recs + i * rec_sz + 1, opt_.key_size, value_in,
+                          opt_.value_size, tid, counter);
+          }
+        }
+        auto load_ms = sw.elapsed<std::chrono::milliseconds>();
+        pcm_end("load", opt_.num_ops, load_ms);
+        std::cout << "\tLoad time: " << load_ms << " milliseconds" << std::endl;
+        std::ostringstream j;
+        j << "\"event\":\"load\",\"ops\":" << opt_.num_ops
+          << ",\"elapsed_ms\":" << load_ms;
+        emit_result(j.str());
+      }
+      return;
     }
-    auto elapsed_gen = sw.elapsed<std::chrono::milliseconds>();
+    // Comparison mode runs several libraries against one stream: the
+    // workload buffers are generated on the first load() and reused
+    // verbatim by every later one.
+    float elapsed_gen = 0;
+    if (kvs == nullptr)
+      elapsed_gen = generate_workload();
+    else
+      std::cout << "reusing generated workload" << std::endl;
+    stopwatch_t sw;
     sw.start();
     std::cout << "loading..." << std::endl;
+    pcm_begin();
+    if (opt_.use_bulk_load && !opt_.skip_load)
+    {
+      // The slabs already hold the records back to back, which is
+      // exactly the layout bulk_load consumes; each worker hands its
+      // contiguous slice to the table in one call. The slab always
+      // holds the loadable keys, so negative redirects work here too.
+#pragma omp parallel num_threads(opt_.num_threads)
+      {
+        auto tid = omp_get_thread_num();
+        pin_thread(tid);
+        tree_->thread_ini(tid);
+        uint64_t chunk =
+            (opt_.num_ops + opt_.num_threads - 1) / opt_.num_threads;
+        uint64_t begin = static_cast<uint64_t>(tid) * chunk;
+        uint64_t end = std::min(begin + chunk, opt_.num_ops);
+        if (begin < end)
+          tree_->bulk_load(key_slab_ + begin * opt_.key_size,
+                           value_slab_ + begin * opt_.value_size,
+                           opt_.key_size, opt_.value_size, end - begin, tid);
+      }
+      auto bulk_ms = sw.elapsed<std::chrono::milliseconds>();
+      pcm_end("load", opt_.num_ops, bulk_ms);
+      std::cout << "\nOverview:"
+                << "\n"
+                << "\tGenerate time: " << elapsed_gen << " milliseconds"
+                << std::endl
+                << "\tLoad time: " << bulk_ms << " milliseconds (bulk)"
+                << std::endl;
+      std::ostringstream jb;
+      jb << "\"event\":\"load\",\"ops\":" << opt_.num_ops
+         << ",\"elapsed_ms\":" << bulk_ms << ",\"generate_ms\":" << elapsed_gen
+         << ",\"bulk\":1";
+      emit_result(jb.str());
+      return;
+    }
 #pragma omp parallel num_threads(opt_.num_threads)
     {
       auto tid = omp_get_thread_num();
+      pin_thread(tid);
       uint64_t counter = 0;
       tree_->thread_ini(tid);
 #pragma omp for schedule(static)
@@ -177,27 +832,166 @@ namespace PiBench
       {
         if (!opt_.skip_load)
         {
-          if (i < negative_size)
-          {
-            tree_->insert(kvs1[i].key, opt_.key_size, kvs1[i].value,
-                          opt_.value_size, tid, counter);
-          }
-          else
-          {
-            tree_->insert(kvs[i].key, opt_.key_size, kvs[i].value,
-                          opt_.value_size, tid, counter);
-          }
+          uint32_t vsz = value_sz_.empty() ? opt_.value_size : value_sz_[i];
+          // kvs[i].key may have been redirected to a negative key; the
+          // slab entry always holds the loadable one.
+          tree_->insert(key_slab_ + i * opt_.key_size, opt_.key_size,
+                        kvs[i].value, vsz, tid, counter);
         }
       }
     }
-    delete[] kvs1;
     auto elapsed = sw.elapsed<std::chrono::milliseconds>();
+    pcm_end("load", opt_.skip_load ? 0 : opt_.num_ops, elapsed);
     std::cout << "\nOverview:"
               << "\n"
               << "\tGenerate time: " << elapsed_gen << " milliseconds" << std::endl
               << "\tLoad time: " << elapsed << " milliseconds" << std::endl;
+    std::ostringstream j;
+    j << "\"event\":\"load\",\"ops\":"
+      << (opt_.skip_load ? 0 : opt_.num_ops) << ",\"elapsed_ms\":" << elapsed
+      << ",\"generate_ms\":" << elapsed_gen;
+    emit_result(j.str());
+  }
+
+  float benchmark_t::tune_burst(uint32_t width, uint64_t nops) noexcept
+  {
+    uint32_t nthreads = opt_.num_threads;
+    stopwatch_t sw;
+    sw.start();
+#pragma omp parallel num_threads(nthreads)
+    {
+      auto tid = omp_get_thread_num();
+      pin_thread(tid);
+      char value_out[value_generator_t::VALUE_MAX];
+      uint64_t chunk = (nops + nthreads - 1) / nthreads;
+      uint64_t begin = static_cast<uint64_t>(tid) * chunk;
+      uint64_t end = std::min(begin + chunk, nops);
+      for (uint64_t base = begin; base < end; base += width)
+      {
+        uint64_t lim = std::min<uint64_t>(base + width, end);
+        // Width 1 is the plain loop in run_threads, so no prefetch pass
+        // here either; otherwise the burst is charged an overhead the
+        // real run at width 1 never pays.
+        if (width > 1)
+          for (uint64_t i = base; i < lim; ++i)
+          {
+            __builtin_prefetch(kvs[i].key);
+            tree_->prefetch(kvs[i].key, opt_.key_size, tid);
+          }
+        for (uint64_t i = base; i < lim; ++i)
+        {
+          uint8_t raw = trace_ops_.empty()
+                            ? static_cast<uint8_t>(operation_t::READ)
+                            : trace_ops_[i];
+          auto op = static_cast<operation_t>(raw & ~OP_DEP_FLAG);
+          uint32_t vsz = value_sz_.empty() ? opt_.value_size : value_sz_[i];
+          // The same stream prefix replays once per burst, so mutations
+          // are softened to keep cardinality constant across candidates:
+          // inserts become upserts and removes become reads. The probe
+          // work — the part the interleave width overlaps — is the same.
+          switch (op)
+          {
+          case operation_t::INSERT:
+          case operation_t::UPSERT:
+          case operation_t::RMW:
+            tree_->upsert(kvs[i].key, opt_.key_size, kvs[i].value, vsz, tid,
+                          0);
+            break;
+          default:
+            tree_->find(kvs[i].key, opt_.key_size, value_out, tid);
+            break;
+          }
+        }
+      }
+    }
+    float us = sw.elapsed<std::chrono::microseconds>();
+    return us > 0 ? static_cast<float>(nops) / us : 0;
+  }
+
+  // Auto-tune: the interleave width trades prefetch lead time against
+  // window buffering, and its optimum moves with the machine's miss
+  // latency and memory-level parallelism — a constant tuned on one box
+  // is wrong on the next. Hill-climb it against measured throughput:
+  // evaluate the current width's power-of-two neighbors over short
+  // bursts of the generated stream and move while a neighbor wins by
+  // more than the noise margin. Bursts run real operations against the
+  // loaded table, so they double as extra warmup.
+  void benchmark_t::auto_tune() noexcept
+  {
+    if (replay_map_ || kvs == nullptr)
+    {
+      std::cout << "Auto-tune: skipped (no generated stream)" << std::endl;
+      return;
+    }
+    uint64_t burst = std::min<uint64_t>(opt_.num_ops, 1u << 20);
+    std::map<uint32_t, float> scored;
+    auto eval = [&](uint32_t w) {
+      auto it = scored.find(w);
+      if (it != scored.end())
+        return it->second;
+      float mops = tune_burst(w, burst);
+      scored[w] = mops;
+      std::cout << "\tAuto-tune: width " << w << ": " << mops << " Mops/s"
+                << std::endl;
+      return mops;
+    };
+    constexpr uint32_t kMaxWidth = 256;
+    uint32_t cur = batch_size_;
+    float best = eval(cur);
+    bool moved = true;
+    while (moved)
+    {
+      moved = false;
+      for (uint32_t cand : {cur > 1 ? cur / 2 : cur,
+                            cur < kMaxWidth ? cur * 2 : cur})
+      {
+        if (cand == cur)
+          continue;
+        float mops = eval(cand);
+        // 2% hysteresis so run-to-run noise does not walk the width off
+        // a flat plateau.
+        if (mops > best * 1.02f)
+        {
+          best = mops;
+          cur = cand;
+          moved = true;
+          break;
+        }
+      }
+    }
+    batch_size_ = cur;
+    std::cout << "\tAuto-tune: chose width " << cur << " (" << best
+              << " Mops/s over " << burst << "-op bursts)" << std::endl;
+    std::ostringstream j;
+    j << "\"event\":\"auto_tune\",\"batch_size\":" << cur
+      << ",\"burst_ops\":" << burst << ",\"mops_per_s\":" << best
+      << ",\"probed\":[";
+    bool first = true;
+    for (auto &p : scored)
+    {
+      j << (first ? "" : ",") << "{\"width\":" << p.first
+        << ",\"mops_per_s\":" << p.second << "}";
+      first = false;
+    }
+    j << "]";
+    emit_result(j.str());
   }
+
   void benchmark_t::run() noexcept
+  {
+    if (opt_.thread_sweep.empty())
+    {
+      run_threads(opt_.num_threads);
+      return;
+    }
+    for (auto n : opt_.thread_sweep)
+    {
+      std::cout << "\nSweep: " << n << " threads" << std::endl;
+      run_threads(n);
+    }
+  }
+
+  void benchmark_t::run_threads(uint32_t num_threads) noexcept
   {
     bool is_resizing = tree_->hash_is_resizing();
     if (opt_.read_ratio == 1 || opt_.remove_ratio == 1)
@@ -222,25 +1016,230 @@ namespace PiBench
     uint64 sample_stride = opt_.num_ops / opt_.samples;
     uint64 load_factor_stride = opt_.num_ops / 200;
     uint64 last_sample = -sample_stride;
-    std::vector<uint64> latency[opt_.num_threads];
+    std::vector<uint64> latency[num_threads];
     if (opt_.latency)
       for (auto &&i : latency)
       {
         i.reserve(opt_.samples);
       }
+    std::vector<stats_t> stats(num_threads);
+    // Insert latency split by value size class, when sizes are
+    // distribution-driven and latency capture is on.
+    size_t n_vcls = value_generator_.size_classes().size();
+    std::vector<std::vector<latency_hist_t>> vhist(
+        opt_.latency && n_vcls ? num_threads : 0,
+        std::vector<latency_hist_t>(n_vcls));
+    std::vector<int> placement(num_threads, -1);
+    // Calibrate the TSC before the measured region so the one-time spin
+    // never lands inside a worker's first sample.
+    tsc_stopwatch_t::ns_per_cycle();
+    // Think time is spun in cycles so the pause costs no clock reads.
+    uint64_t think_cycles =
+        opt_.think_ns ? static_cast<uint64_t>(opt_.think_ns /
+                                              tsc_stopwatch_t::ns_per_cycle())
+                      : 0;
+    // Timeline sampler: every sampling_ms, sum the per-thread operation
+    // counters and stream a CSV row with window throughput and whether
+    // the table was mid-resize, so rehash valleys show up as a timeline
+    // instead of being smeared into the aggregates.
+    std::atomic<bool> timeline_stop(false);
+    std::thread timeline;
+    std::ofstream timeline_out;
+    if (!opt_.timeline_file.empty())
+    {
+      timeline_out.open(opt_.timeline_file, std::ofstream::app);
+      // 'drift' is the hot region's current position as a fraction of
+      // the keyspace (0 when drift is off), derived from the operations
+      // consumed so far; plotting throughput against it shows whether
+      // the table tracks the moving hot set.
+      // 'rss_mb' samples process resident memory each window; under
+      // churn, growth here with constant table cardinality is
+      // unreclaimed garbage accumulating.
+      // 'load_factor' and 'pm_mb' come from the incremental stats()
+      // surface (counters, no walk), so a directory doubling or level
+      // rehash appears as a capacity step aligned with its throughput
+      // valley.
+      timeline_out << "ms,ops,mops_per_s,resizing,drift,rss_mb,"
+                      "load_factor,pm_mb\n";
+      timeline = std::thread([&]() {
+        stopwatch_t tsw;
+        tsw.start();
+        uint64_t last_ops = 0;
+        float last_ms = 0;
+        while (!timeline_stop.load(std::memory_order_relaxed))
+        {
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(opt_.sampling_ms));
+          uint64_t ops = 0;
+          for (auto &s : stats)
+            ops += s.operation_count;
+          float ms = tsw.elapsed<std::chrono::milliseconds>();
+          bool resizing = tree_->hash_is_resizing();
+          double drift =
+              opt_.hotspot_drift > 0
+                  ? std::fmod((double)ops / opt_.num_ops * opt_.hotspot_drift,
+                              1.0)
+                  : 0.0;
+          uint64_t vm_pages = 0, rss_pages = 0;
+          {
+            std::ifstream statm("/proc/self/statm");
+            statm >> vm_pages >> rss_pages;
+          }
+          double rss_mb =
+              rss_pages * (sysconf(_SC_PAGESIZE) / 1024.0) / 1024.0;
+          hash_stats_t hs = tree_->stats();
+          double pm_mb = hs.pm_bytes / 1024.0 / 1024.0;
+          timeline_out << (uint64_t)ms << "," << (ops - last_ops) << ","
+                       << (ops - last_ops) / ((ms - last_ms) * 1000.0f) << ","
+                       << (resizing ? 1 : 0) << "," << drift << "," << rss_mb
+                       << "," << hs.load_factor << "," << pm_mb << "\n";
+          timeline_out.flush();
+          std::ostringstream j;
+          j << "\"event\":\"window\",\"ms\":" << (uint64_t)ms
+            << ",\"ops\":" << (ops - last_ops)
+            << ",\"resizing\":" << (resizing ? 1 : 0)
+            << ",\"drift\":" << drift << ",\"rss_mb\":" << rss_mb
+            << ",\"load_factor\":" << hs.load_factor
+            << ",\"pm_mb\":" << pm_mb;
+          emit_result(j.str());
+          last_ops = ops;
+          last_ms = ms;
+        }
+      });
+    }
+    // Warmup: workers start executing immediately, but while 'warming'
+    // is set nothing is recorded as measurement. A monitor samples
+    // aggregate throughput every sampling_ms; once the coefficient of
+    // variation over the last few windows drops under 5% (or the cap
+    // expires), it snapshots the operations consumed so far, restarts
+    // the run clock and clears the flag — a single relaxed store the
+    // workers observe mid-stream.
+    std::atomic<bool> warming(opt_.warmup_max_ms > 0);
+    std::atomic<uint64_t> warmup_ops(0);
+    std::thread warmup_monitor;
+    if (warming.load())
+    {
+      warmup_monitor = std::thread([&]() {
+        constexpr int WIN = 5;
+        float win[WIN];
+        int nwin = 0;
+        uint64_t prev = 0;
+        stopwatch_t wsw;
+        wsw.start();
+        while (true)
+        {
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(opt_.sampling_ms));
+          uint64_t total = 0;
+          for (auto &s : stats)
+            total += s.operation_count;
+          win[nwin++ % WIN] = total - prev;
+          prev = total;
+          bool stable = false;
+          if (nwin >= WIN)
+          {
+            float mean = 0, var = 0;
+            for (auto w : win)
+              mean += w / WIN;
+            for (auto w : win)
+              var += (w - mean) * (w - mean) / WIN;
+            stable = mean > 0 && std::sqrt(var) / mean < 0.05f;
+          }
+          float ms = wsw.elapsed<std::chrono::milliseconds>();
+          if (stable || ms >= opt_.warmup_max_ms || total >= opt_.num_ops)
+          {
+            warmup_ops.store(total, std::memory_order_relaxed);
+            swt.start();
+            warming.store(false, std::memory_order_relaxed);
+            std::cout << "\tWarmup: " << (uint64_t)ms << " ms, " << total
+                      << " ops (" << (stable ? "steady" : "cap") << ")"
+                      << std::endl;
+            return;
+          }
+        }
+      });
+    }
+    // Straggler monitor (--straggler_ms): one preempted worker skews the
+    // whole merged result, so every sampling_ms the per-thread heartbeat
+    // stamps are checked against the threshold; a window where any
+    // thread's stamp went stale is tainted — that worker sat descheduled
+    // and the window measured the scheduler, not the table. Tainted
+    // windows' time and operations feed a separate clean-throughput
+    // figure and flag the run. Merged latency histograms cannot be
+    // unpicked after the fact, so they keep the tainted samples and the
+    // flag is the warning to rerun.
+    std::atomic<bool> straggler_stop(false);
+    std::atomic<uint64_t> total_windows(0), tainted_windows(0);
+    std::atomic<uint64_t> tainted_ops(0), tainted_ms(0);
+    std::vector<long> nivcsw(num_threads, 0);
+    std::thread straggler_monitor;
+    uint64_t stall_cycles = 0;
+    if (opt_.straggler_ms > 0)
+    {
+      stall_cycles = static_cast<uint64_t>(
+          opt_.straggler_ms * 1e6 / tsc_stopwatch_t::ns_per_cycle());
+      straggler_monitor = std::thread([&]() {
+        stopwatch_t ssw;
+        ssw.start();
+        uint64_t prev_ops = 0;
+        float prev_ms = 0;
+        while (!straggler_stop.load(std::memory_order_relaxed))
+        {
+          std::this_thread::sleep_for(
+              std::chrono::milliseconds(opt_.sampling_ms));
+          uint64_t now = tsc_stopwatch_t::now();
+          uint64_t ops = 0;
+          bool stalled = false;
+          for (auto &s : stats)
+          {
+            ops += s.operation_count;
+            uint64_t hb = s.heartbeat;
+            if (hb != 0 && now > hb && now - hb > stall_cycles)
+              stalled = true;
+          }
+          float ms = ssw.elapsed<std::chrono::milliseconds>();
+          total_windows.fetch_add(1, std::memory_order_relaxed);
+          if (stalled)
+          {
+            tainted_windows.fetch_add(1, std::memory_order_relaxed);
+            tainted_ops.fetch_add(ops - prev_ops, std::memory_order_relaxed);
+            tainted_ms.fetch_add(static_cast<uint64_t>(ms - prev_ms),
+                                 std::memory_order_relaxed);
+          }
+          prev_ops = ops;
+          prev_ms = ms;
+        }
+      });
+    }
     std::unique_ptr<SystemCounterState> before_sstate;
     if (opt_.pm)
     {
       before_sstate = std::make_unique<SystemCounterState>();
       *before_sstate = getSystemCounterState();
     }
-#pragma omp parallel num_threads(opt_.num_threads)
+    pcm_begin();
+#pragma omp parallel num_threads(num_threads)
     {
       auto tid = omp_get_thread_num();
+      pin_thread(tid);
+      placement[tid] = sched_getcpu();
       uint64_t counter = 0;
       stopwatch_t sw;
       stopwatch_t swl;
       char value_out[value_generator_t::VALUE_MAX];
+      char value_in[value_generator_t::VALUE_MAX] = {0};
+      // Key of this worker's previous operation, reused when the
+      // pre-drawn stream flags a dependent key.
+      const char *prev_key = nullptr;
+      // One probe per worker: opened without inheritance it counts just
+      // this thread, so a sampled operation can be bracketed by two
+      // counter reads and charged to its operation type (--perf_sample).
+      thread_event_probe_t probe;
+      bool probing = opt_.perf_sample > 0 && probe.open();
+      // Arm the heartbeat before the first operation so a worker that
+      // stalls in its very first window is already visible as stale.
+      if (stall_cycles)
+        stats[tid].heartbeat = tsc_stopwatch_t::now();
 #pragma omp barrier
 
 #pragma omp single nowait
@@ -248,22 +1247,81 @@ namespace PiBench
         swt.start();
       }
 
-#pragma omp for schedule(static)
-      for (uint64_t i = 0; i < opt_.num_ops; ++i)
+      // 'intended' is the operation's scheduled start (tsc) in open-loop
+      // mode; 0 means closed loop and latency runs from the actual start.
+      auto exec_op = [&](uint64_t i, uint64_t intended = 0)
       {
-        // Generate random operation
-        auto op = op_generator_.next();
-        auto key_ptr = kvs[i].key;
-        auto value_ptr = kvs[i].value;
+        operation_t op;
+        const char *key_ptr;
+        const char *value_ptr;
+        uint8_t raw;
+        if (replay_map_)
+        {
+          // Stream the record straight out of the mapping: the key
+          // pointer handed to the table aliases the trace file.
+          const char *rec = replay_map_ + sizeof(trace_header_t) +
+                            i * trace_record_size(opt_.key_size);
+          raw = static_cast<uint8_t>(*rec);
+          key_ptr = rec + 1;
+          value_ptr = value_in;
+        }
+        else
+        {
+          // Operation stream is pre-drawn during the load phase; fall
+          // back to drawing inline only if load() was never run.
+          raw = trace_ops_.empty() ? static_cast<uint8_t>(op_generator_.next())
+                                   : trace_ops_[i];
+          key_ptr = kvs[i].key;
+          value_ptr = kvs[i].value;
+        }
+        op = static_cast<operation_t>(raw & ~OP_DEP_FLAG);
+        if ((raw & OP_DEP_FLAG) && prev_key != nullptr)
+          key_ptr = prev_key;
+        bool found = true;
+        uint32_t vsz = value_sz_.empty() ? opt_.value_size : value_sz_[i];
+        if (opt_.verify && op != operation_t::READ &&
+            op != operation_t::REMOVE)
+        {
+          // Dependent and churn records write under a key other than
+          // the one their slab value was derived from; re-derive so the
+          // stored bytes always checksum against the stored key.
+          value_generator_t::fill_checksum(key_ptr, opt_.key_size, value_in,
+                                           vsz);
+          value_ptr = value_in;
+        }
+        uint64_t tsc0 = 0;
+        uint64_t queued = 0;
         if (opt_.latency)
         {
           swl.start();
+          tsc0 = tsc_stopwatch_t::now();
+          if (intended != 0)
+          {
+            // Measure from the schedule, not from when the worker got
+            // around to it — the gap is the queueing delay.
+            queued = tsc0 > intended ? tsc0 - intended : 0;
+            tsc0 = intended;
+          }
         }
+        uint64_t ev0[thread_event_probe_t::N_EV];
+        bool sampled = probing && i % opt_.perf_sample == 0 &&
+                       !warming.load(std::memory_order_relaxed);
+        if (sampled)
+          probe.read_all(ev0);
         switch (op)
         {
         case operation_t::READ:
         {
-          tree_->find(key_ptr, opt_.key_size, value_out, tid);
+          found = tree_->find(key_ptr, opt_.key_size, value_out, tid);
+          ++(found ? stats[tid].read_hits : stats[tid].read_misses);
+          // With variable value sizes the stored length depends on
+          // which record inserted the key, so only the leading word is
+          // checked there; fixed-size runs validate the whole value.
+          if (opt_.verify && found &&
+              !value_generator_t::verify_checksum(
+                  key_ptr, opt_.key_size, value_out,
+                  value_sz_.empty() ? opt_.value_size : 8))
+            ++stats[tid].verify_fails;
           break;
         }
 
@@ -272,15 +1330,15 @@ namespace PiBench
           ////for insert
           if (!opt_.resize_ratio)
           {
-            tree_->insert(key_ptr, opt_.key_size, value_ptr, opt_.value_size,
-                          tid, counter++);
+            tree_->insert(key_ptr, opt_.key_size, value_ptr, vsz, tid,
+                          counter++);
           }
           //// for resizing
           else if (opt_.resize_ratio)
           {
             sw.start();
             auto r = tree_->insertResize(key_ptr, opt_.key_size, value_ptr,
-                                         opt_.value_size, tid, counter++);
+                                         vsz, tid, counter++);
 
             auto ela = sw.elapsed<std::chrono::nanoseconds>();
             std::cout << ela << std::endl;
@@ -303,18 +1361,197 @@ namespace PiBench
           auto r = tree_->remove(key_ptr, opt_.key_size, tid);
           break;
         }
+        case operation_t::RMW:
+        {
+          // Read-modify-write: the update key is by construction the
+          // key just read, so the second probe hits the same bucket
+          // while its lines are still hot (and its lock still warm).
+          tree_->find(key_ptr, opt_.key_size, value_out, tid);
+          tree_->update(key_ptr, opt_.key_size, value_ptr, vsz);
+          break;
+        }
+        case operation_t::UPSERT:
+        {
+          tree_->upsert(key_ptr, opt_.key_size, value_ptr, vsz, tid,
+                        counter++);
+          break;
+        }
         default:
           std::cout << "Error: unknown operation!" << std::endl;
           exit(0);
           break;
         }
-        if (opt_.latency && i % sample_stride == 0)
+        if (sampled)
+        {
+          uint64_t ev1[thread_event_probe_t::N_EV];
+          probe.read_all(ev1);
+          auto o = static_cast<uint8_t>(op);
+          ++stats[tid].ev_samples[o];
+          stats[tid].ev_llc[o] +=
+              ev1[thread_event_probe_t::LLC] - ev0[thread_event_probe_t::LLC];
+          stats[tid].ev_dtlb[o] +=
+              ev1[thread_event_probe_t::DTLB] - ev0[thread_event_probe_t::DTLB];
+          stats[tid].ev_stall[o] += ev1[thread_event_probe_t::STALL] -
+                                    ev0[thread_event_probe_t::STALL];
+        }
+        ++stats[tid].operation_count;
+        if (stall_cycles)
+          stats[tid].heartbeat = tsc_stopwatch_t::now();
+        if (opt_.latency && !warming.load(std::memory_order_relaxed))
+        {
+          uint64_t dt = tsc_stopwatch_t::now() - tsc0;
+          stats[tid].op_hist[static_cast<uint8_t>(op)].record(dt);
+          if (op == operation_t::READ)
+            (found ? stats[tid].read_hit_hist : stats[tid].read_miss_hist)
+                .record(dt);
+          if (intended != 0)
+            stats[tid].queue_hist.record(queued);
+          if (!vhist.empty() && op == operation_t::INSERT)
+            vhist[tid][value_cls_[i]].record(dt);
+          if (i % sample_stride == 0)
+          {
+            auto t = swl.elapsed<std::chrono::nanoseconds>();
+            latency[tid].push_back(t);
+          }
+        }
+        prev_key = key_ptr;
+        if (think_cycles)
         {
-          auto t = swl.elapsed<std::chrono::nanoseconds>();
-          latency[tid].push_back(t);
+          // Client think time, spun after the latency window closes so
+          // it widens inter-arrival gaps without inflating op latency.
+          uint64_t until = tsc_stopwatch_t::now() + think_cycles;
+          while (tsc_stopwatch_t::now() < until)
+            _mm_pause();
+        }
+      };
+
+      if (batch_size_ > 1)
+      {
+        // Interleaved mode: partition the operations statically, then
+        // walk each thread's share in windows of batch_size streams —
+        // one pass announcing the upcoming keys through
+        // hash_api::prefetch, one pass executing them. Tables that
+        // implement the hook get their probe misses overlapped instead
+        // of serialized; the rest degrade to the plain loop.
+        //
+        // A window whose operations are all independent READs is
+        // instead issued as one hash_api::find_batch call, letting the
+        // table pipeline the probes itself; per-operation
+        // instrumentation (latency, verify, perf sampling) has no
+        // per-operation boundary there, so any of those options keeps
+        // the window on the generic path.
+        uint64_t chunk =
+            (opt_.num_ops + num_threads - 1) / num_threads;
+        uint64_t begin = static_cast<uint64_t>(tid) * chunk;
+        uint64_t end = std::min(begin + chunk, opt_.num_ops);
+        bool batch_reads_ok = !opt_.latency && !opt_.verify &&
+                              opt_.perf_sample == 0 &&
+                              (replay_map_ || !trace_ops_.empty());
+        std::vector<const char *> bkeys(batch_size_);
+        std::vector<char> bvals(static_cast<size_t>(batch_size_) *
+                                value_generator_t::VALUE_MAX);
+        for (uint64_t base = begin; base < end; base += batch_size_)
+        {
+          uint64_t lim = std::min<uint64_t>(base + batch_size_, end);
+          bool all_reads = batch_reads_ok;
+          for (uint64_t i = base; all_reads && i < lim; ++i)
+          {
+            uint8_t raw =
+                replay_map_
+                    ? static_cast<uint8_t>(
+                          *(replay_map_ + sizeof(trace_header_t) +
+                            i * trace_record_size(opt_.key_size)))
+                    : trace_ops_[i];
+            all_reads = raw == static_cast<uint8_t>(operation_t::READ);
+          }
+          if (all_reads)
+          {
+            for (uint64_t i = base; i < lim; ++i)
+              bkeys[i - base] =
+                  replay_map_ ? replay_map_ + sizeof(trace_header_t) +
+                                    i * trace_record_size(opt_.key_size) + 1
+                              : kvs[i].key;
+            uint64_t hits = tree_->find_batch(
+                bkeys.data(), opt_.key_size, lim - base, bvals.data(),
+                value_generator_t::VALUE_MAX, tid);
+            stats[tid].read_hits += hits;
+            stats[tid].read_misses += (lim - base) - hits;
+            stats[tid].operation_count += lim - base;
+            if (stall_cycles)
+              stats[tid].heartbeat = tsc_stopwatch_t::now();
+            prev_key = bkeys[lim - base - 1];
+            continue;
+          }
+          for (uint64_t i = base; i < lim; ++i)
+          {
+            const char *k =
+                replay_map_ ? replay_map_ + sizeof(trace_header_t) +
+                                  i * trace_record_size(opt_.key_size) + 1
+                            : kvs[i].key;
+            __builtin_prefetch(k);
+            tree_->prefetch(k, opt_.key_size, tid);
+          }
+          for (uint64_t i = base; i < lim; ++i)
+          {
+            exec_op(i);
+          }
         }
       }
+      else if (opt_.arrival_rate > 0)
+      {
+        // Open loop: each thread issues against a fixed arrival
+        // schedule instead of waiting for the previous operation to
+        // return. Early arrivals spin until their slot; late ones run
+        // immediately and their lateness is charged as queueing delay,
+        // so the latency percentiles reflect the offered load rather
+        // than whatever rate the table sustained (no coordinated
+        // omission).
+        double cycles_per_op =
+            1e9 / opt_.arrival_rate / tsc_stopwatch_t::ns_per_cycle();
+        uint64_t chunk = (opt_.num_ops + num_threads - 1) / num_threads;
+        uint64_t begin = static_cast<uint64_t>(tid) * chunk;
+        uint64_t end = std::min(begin + chunk, opt_.num_ops);
+        uint64_t t0 = tsc_stopwatch_t::now();
+        for (uint64_t i = begin; i < end; ++i)
+        {
+          uint64_t intended =
+              t0 + static_cast<uint64_t>((i - begin) * cycles_per_op);
+          while (tsc_stopwatch_t::now() < intended)
+            _mm_pause();
+          exec_op(i, intended);
+        }
+      }
+      else
+      {
+#pragma omp for schedule(static)
+        for (uint64_t i = 0; i < opt_.num_ops; ++i)
+        {
+          exec_op(i);
+        }
+      }
+      // How often the kernel took this worker off-CPU mid-run; pairs
+      // with the tainted-window count to separate preemption from a
+      // genuinely slow table.
+      if (stall_cycles)
+      {
+        struct rusage ru;
+        if (getrusage(RUSAGE_THREAD, &ru) == 0)
+          nivcsw[tid] = ru.ru_nivcsw;
+      }
     }
+    timeline_stop.store(true, std::memory_order_relaxed);
+    if (timeline.joinable())
+      timeline.join();
+    straggler_stop.store(true, std::memory_order_relaxed);
+    if (straggler_monitor.joinable())
+      straggler_monitor.join();
+    // The monitor exits on its own once it transitions (or once it sees
+    // the whole stream consumed before reaching steady state).
+    if (warmup_monitor.joinable())
+      warmup_monitor.join();
+    // Operations retired after the clock restart; everything before it
+    // was warmup and is excluded from throughput.
+    uint64_t measured_ops = opt_.num_ops - warmup_ops.load();
 
     is_resizing = tree_->hash_is_resizing();
 
@@ -322,6 +1559,20 @@ namespace PiBench
     {
       elapsed = swt.elapsed<std::chrono::microseconds>();
     }
+    // Where the workers actually landed, whatever the policy was.
+    std::cout << "\tPlacement (thread:cpu):";
+    for (uint32_t t = 0; t < num_threads; ++t)
+      std::cout << " " << t << ":" << placement[t];
+    std::cout << std::endl;
+    if (opt_.straggler_ms > 0)
+    {
+      std::cout << "\tInvoluntary ctx switches (thread:count):";
+      for (uint32_t t = 0; t < num_threads; ++t)
+        std::cout << " " << t << ":" << nivcsw[t];
+      std::cout << std::endl;
+    }
+    pcm_end("run", measured_ops, elapsed / 1000);
+    last_mops_ = elapsed > 0 ? (float)measured_ops / elapsed : 0;
     if (opt_.pm)
     {
       std::unique_ptr<SystemCounterState> after_sstate;
@@ -359,9 +1610,47 @@ namespace PiBench
     if (opt_.throughput)
     {
       std::cout << "\tRun time(ms): " << elapsed / 1000 << std::endl;
-      std::cout << "\tThroughput(Mops/s): " << (float)opt_.num_ops / elapsed
+      std::cout << "\tThroughput(Mops/s): " << (float)measured_ops / elapsed
                 << std::endl;
     }
+    // Straggler verdict: clean throughput recomputed over the windows
+    // where every worker kept making progress. A gap between the
+    // headline and clean figures means the run was scheduler-limited —
+    // rerun before reading a regression into it.
+    if (opt_.straggler_ms > 0)
+    {
+      uint64_t tw = tainted_windows.load();
+      uint64_t allw = total_windows.load();
+      uint64_t t_ops = tainted_ops.load();
+      uint64_t t_ms = tainted_ms.load();
+      float clean_elapsed = elapsed - t_ms * 1000.0f;
+      float clean_mops =
+          clean_elapsed > 0 && measured_ops > t_ops
+              ? (float)(measured_ops - t_ops) / clean_elapsed
+              : 0;
+      if (tw == 0)
+        std::cout << "\tStraggler check: clean (" << allw
+                  << " windows, no thread stalled > " << opt_.straggler_ms
+                  << " ms)" << std::endl;
+      else
+        std::cout << "\tStraggler check: TAINTED — " << tw << " of " << allw
+                  << " windows had a thread stalled > " << opt_.straggler_ms
+                  << " ms; excluding them: " << clean_mops
+                  << " Mops/s over " << clean_elapsed / 1000 << " ms"
+                  << std::endl;
+      std::ostringstream sj;
+      sj << "\"event\":\"straggler\",\"threshold_ms\":" << opt_.straggler_ms
+         << ",\"windows\":" << allw << ",\"tainted_windows\":" << tw
+         << ",\"tainted_ops\":" << t_ops << ",\"tainted_ms\":" << t_ms
+         << ",\"clean_mops_per_s\":" << clean_mops << ",\"nivcsw\":[";
+      for (uint32_t t = 0; t < num_threads; ++t)
+        sj << (t ? "," : "") << nivcsw[t];
+      sj << "]";
+      emit_result(sj.str());
+    }
+    // Per-operation percentiles rendered for the JSON run event while
+    // the merged histograms are in hand below.
+    std::ostringstream lat_json;
     if (opt_.latency)
     {
       std::cout << "\tLatency(ns): \t" << std::endl;
@@ -379,11 +1668,209 @@ namespace PiBench
            << "4 " << v[0.999 * sz] << "\n"
            << "5 " << v[0.9999 * sz] << "\n"
            << "6 " << v[0.99999 * sz] << std::endl;
+
+      // Merge the per-thread histograms and report tail latency per
+      // operation type, scaling cycle deltas by the calibrated TSC rate.
+      double ns_per_cycle = tsc_stopwatch_t::ns_per_cycle();
+      static const char *op_names[NUM_OPS] = {"READ", "INSERT", "REMOVE",
+                                              "RMW", "UPSERT"};
+      std::cout << "\tPer-operation latency(ns):" << std::endl;
+      for (unsigned o = 0; o < NUM_OPS; ++o)
+      {
+        latency_hist_t merged;
+        for (auto &&s : stats)
+          merged.merge(s.op_hist[o]);
+        if (merged.count_ == 0)
+          continue;
+        std::cout << "\t" << op_names[o] << " count: " << merged.count_
+                  << " p50: " << merged.percentile(0.50) * ns_per_cycle
+                  << " p99: " << merged.percentile(0.99) * ns_per_cycle
+                  << " p999: " << merged.percentile(0.999) * ns_per_cycle
+                  << " p9999: " << merged.percentile(0.9999) * ns_per_cycle
+                  << " max: " << merged.max_ * ns_per_cycle << std::endl;
+        lat_json << ",\"" << op_names[o]
+                 << "\":{\"count\":" << merged.count_
+                 << ",\"p50_ns\":" << merged.percentile(0.50) * ns_per_cycle
+                 << ",\"p99_ns\":" << merged.percentile(0.99) * ns_per_cycle
+                 << ",\"p999_ns\":" << merged.percentile(0.999) * ns_per_cycle
+                 << ",\"max_ns\":" << merged.max_ * ns_per_cycle << "}";
+      }
+      // READ split by outcome: with --negative_ratio in play the hit
+      // and miss paths have different probe depths, so blending them
+      // into the READ row above would hide the miss tail.
+      const std::pair<const char *, latency_hist_t stats_t::*> rsplit[] = {
+          {"READ(hit)", &stats_t::read_hit_hist},
+          {"READ(miss)", &stats_t::read_miss_hist}};
+      for (auto &rs : rsplit)
+      {
+        latency_hist_t merged;
+        for (auto &&s : stats)
+          merged.merge(s.*rs.second);
+        if (merged.count_ == 0)
+          continue;
+        std::cout << "\t" << rs.first << " count: " << merged.count_
+                  << " p50: " << merged.percentile(0.50) * ns_per_cycle
+                  << " p99: " << merged.percentile(0.99) * ns_per_cycle
+                  << " p999: " << merged.percentile(0.999) * ns_per_cycle
+                  << " p9999: " << merged.percentile(0.9999) * ns_per_cycle
+                  << " max: " << merged.max_ * ns_per_cycle << std::endl;
+        lat_json << ",\"" << rs.first
+                 << "\":{\"count\":" << merged.count_
+                 << ",\"p50_ns\":" << merged.percentile(0.50) * ns_per_cycle
+                 << ",\"p99_ns\":" << merged.percentile(0.99) * ns_per_cycle
+                 << ",\"p999_ns\":" << merged.percentile(0.999) * ns_per_cycle
+                 << ",\"max_ns\":" << merged.max_ * ns_per_cycle << "}";
+      }
+      // Open-loop mode: the per-op rows above are sojourn times
+      // (queueing + service); the queueing component is also reported
+      // on its own so the two can be separated.
+      if (opt_.arrival_rate > 0)
+      {
+        latency_hist_t merged;
+        for (auto &&s : stats)
+          merged.merge(s.queue_hist);
+        if (merged.count_ != 0)
+          std::cout << "\tQUEUE count: " << merged.count_
+                    << " p50: " << merged.percentile(0.50) * ns_per_cycle
+                    << " p99: " << merged.percentile(0.99) * ns_per_cycle
+                    << " p999: " << merged.percentile(0.999) * ns_per_cycle
+                    << " p9999: " << merged.percentile(0.9999) * ns_per_cycle
+                    << " max: " << merged.max_ * ns_per_cycle << std::endl;
+        if (merged.count_ != 0)
+          lat_json << ",\"QUEUE\":{\"count\":" << merged.count_
+                   << ",\"p50_ns\":" << merged.percentile(0.50) * ns_per_cycle
+                   << ",\"p99_ns\":" << merged.percentile(0.99) * ns_per_cycle
+                   << ",\"p999_ns\":"
+                   << merged.percentile(0.999) * ns_per_cycle
+                   << ",\"max_ns\":" << merged.max_ * ns_per_cycle << "}";
+      }
+      if (!vhist.empty())
+      {
+        std::cout << "\tINSERT latency(ns) by value size:" << std::endl;
+        for (size_t c = 0; c < n_vcls; ++c)
+        {
+          latency_hist_t merged;
+          for (auto &th : vhist)
+            merged.merge(th[c]);
+          if (merged.count_ == 0)
+            continue;
+          std::cout << "\t" << value_generator_.size_classes()[c]
+                    << "B count: " << merged.count_
+                    << " p50: " << merged.percentile(0.50) * ns_per_cycle
+                    << " p99: " << merged.percentile(0.99) * ns_per_cycle
+                    << " p999: " << merged.percentile(0.999) * ns_per_cycle
+                    << " p9999: " << merged.percentile(0.9999) * ns_per_cycle
+                    << std::endl;
+        }
+      }
+    }
+    // Outcome counters are kept regardless of latency capture; the miss
+    // ratio doubles as a check that --negative_ratio took effect.
+    uint64_t read_hits = 0, read_misses = 0;
+    for (auto &&s : stats)
+    {
+      read_hits += s.read_hits;
+      read_misses += s.read_misses;
+    }
+    if (read_hits + read_misses > 0)
+      std::cout << "\tRead hit/miss: " << read_hits << "/" << read_misses
+                << " (" << 100.0 * read_misses / (read_hits + read_misses)
+                << "% miss)" << std::endl;
+    uint64_t verify_fails = 0;
+    if (opt_.verify)
+    {
+      for (auto &&s : stats)
+        verify_fails += s.verify_fails;
+      if (verify_fails == 0)
+        std::cout << "\tValue verification: all " << read_hits
+                  << " read values checked OK" << std::endl;
+      else
+        std::cout << "\tValue verification: " << verify_fails << " of "
+                  << read_hits << " read values CORRUPT" << std::endl;
     }
     if (opt_.resize_ratio)
     {
       cout << total_resize_time << " " << elapsed << std::endl;
     }
+    // Sampled hardware-event attribution: average counter deltas per
+    // bracketed operation, split by operation type. Averages, not
+    // tails — the bracketing syscalls add a constant overhead that
+    // cancels when comparing op types against each other.
+    if (opt_.perf_sample > 0)
+    {
+      static const char *attr_names[NUM_OPS] = {"READ", "INSERT", "REMOVE",
+                                                "RMW", "UPSERT"};
+      std::ostringstream pj;
+      pj << "\"event\":\"perf_attr\",\"sample_every\":" << opt_.perf_sample;
+      std::cout << "\tSampled event attribution (avg/op):" << std::endl;
+      bool any = false;
+      for (unsigned o = 0; o < NUM_OPS; ++o)
+      {
+        uint64_t n = 0, llc = 0, dtlb = 0, stall = 0;
+        for (auto &&s : stats)
+        {
+          n += s.ev_samples[o];
+          llc += s.ev_llc[o];
+          dtlb += s.ev_dtlb[o];
+          stall += s.ev_stall[o];
+        }
+        if (n == 0)
+          continue;
+        any = true;
+        std::cout << "\t" << attr_names[o] << " samples: " << n
+                  << " llc_miss: " << (double)llc / n
+                  << " dtlb_miss: " << (double)dtlb / n
+                  << " stalled_cycles: " << (double)stall / n << std::endl;
+        pj << ",\"" << attr_names[o] << "\":{\"samples\":" << n
+           << ",\"llc_miss\":" << (double)llc / n
+           << ",\"dtlb_miss\":" << (double)dtlb / n
+           << ",\"stalled_cycles\":" << (double)stall / n << "}";
+      }
+      if (any)
+        emit_result(pj.str());
+      else
+        std::cout << "\t(no events available — perf_event access denied?)"
+                  << std::endl;
+    }
+    // Incremental table statistics; wrappers that do not maintain them
+    // return the all-zero default and are skipped.
+    auto tstats = tree_->stats();
+    if (tstats.items != 0 || tstats.capacity != 0)
+    {
+      constexpr unsigned kProbeBins =
+          sizeof(tstats.probe_hist) / sizeof(tstats.probe_hist[0]);
+      std::cout << "\tTable stats: items " << tstats.items << ", capacity "
+                << tstats.capacity << ", load factor " << tstats.load_factor
+                << ", directory depth " << tstats.directory_depth
+                << ", overflow buckets " << tstats.overflow_buckets
+                << "\n\tProbe length histogram (sampled):";
+      for (unsigned b = 0; b < kProbeBins; ++b)
+        std::cout << " " << tstats.probe_hist[b];
+      std::cout << std::endl;
+      std::ostringstream ts;
+      ts << "\"event\":\"table_stats\",\"items\":" << tstats.items
+         << ",\"capacity\":" << tstats.capacity
+         << ",\"load_factor\":" << tstats.load_factor
+         << ",\"directory_depth\":" << tstats.directory_depth
+         << ",\"overflow_buckets\":" << tstats.overflow_buckets
+         << ",\"probe_hist\":[";
+      for (unsigned b = 0; b < kProbeBins; ++b)
+        ts << (b ? "," : "") << tstats.probe_hist[b];
+      ts << "]";
+      emit_result(ts.str());
+    }
+    std::ostringstream j;
+    j << "\"event\":\"run\",\"threads\":" << num_threads
+      << ",\"ops\":" << measured_ops << ",\"elapsed_ms\":" << elapsed / 1000
+      << ",\"mops_per_s\":" << (float)measured_ops / elapsed
+      << ",\"warmup_ops\":" << warmup_ops.load()
+      << ",\"read_hits\":" << read_hits << ",\"read_misses\":" << read_misses
+      << ",\"resizing\":" << (is_resizing ? 1 : 0) << lat_json.str();
+    if (opt_.verify)
+      j << ",\"verify_fails\":" << verify_fails;
+    if (opt_.straggler_ms > 0)
+      j << ",\"tainted\":" << (tainted_windows.load() ? 1 : 0);
+    emit_result(j.str());
   }
 } // namespace PiBench
 
@@ -415,6 +1902,8 @@ namespace std
        << "\tTarget: " << opt.library_file << "\n"
        << "\t# Operations: " << opt.num_ops << "\n"
        << "\t# Threads: " << opt.num_threads << "\n"
+       << "\tBatch size: " << opt.batch_size << "\n"
+       << "\tAffinity: " << (opt.affinity.empty() ? "OS" : opt.affinity) << "\n"
        << "\tKey size: " << opt.key_size << "\n"
        << "\tValue size: " << opt.value_size << "\n"
        << "\tRandom seed: " << opt.rnd_seed << "\n"
@@ -428,7 +1917,19 @@ namespace std
        << "\t\tRead: " << opt.read_ratio << "\n"
        << "\t\tInsert: " << opt.insert_ratio << "\n"
        << "\t\tUpdate: " << opt.update_ratio << "\n"
-       << "\t\tDelete: " << opt.remove_ratio << "\n";
+       << "\t\tDelete: " << opt.remove_ratio << "\n"
+       << "\t\tRMW: " << opt.rmw_ratio << "\n"
+       << "\t\tUpsert: " << opt.upsert_ratio << "\n"
+       << "\tKey dependency: " << opt.dep_ratio << "\n"
+       << "\tThink time(ns): " << opt.think_ns << "\n"
+       << "\tHotspot drift: " << opt.hotspot_drift << "\n"
+       << "\tChurn: " << opt.churn_ratio << " (window " << opt.churn_window
+       << ")\n"
+       << "\tArrival rate(ops/s/thread): "
+       << (opt.arrival_rate ? std::to_string(opt.arrival_rate)
+                            : "closed loop")
+       << "\n"
+       << "\tVerify values: " << (opt.verify ? "on" : "off") << "\n";
     return os;
   }
 } // namespace std
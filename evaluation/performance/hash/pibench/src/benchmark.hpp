@@ -3,15 +3,37 @@
 
 #include <chrono>  // std::chrono::high_resolution_clock::time_point
 #include <cstdint>
+#include <fstream> // std::ofstream (JSON results stream)
 #include <memory>  // For unique_ptr
+#include <utility> // std::pair
 #include <vector>
 
 #include "cpucounters.h"
 #include "hash_api.h"
 #include "key_generator.hpp"
 #include "operation_generator.hpp"
+#include "perf_counters.hpp"
+#include "pmm_media.h"
 #include "stopwatch.hpp"
 #include "value_generator.hpp"
+
+/* Static-dispatch build (PiBenchStatic): the concrete table class is
+ * compiled into the binary and the benchmark drives it through its
+ * real type instead of hash_api*, so the per-operation virtual hop
+ * devirtualizes and short probes inline into the driver loop. The
+ * regular build keeps the dlopen/hash_api* path; tree_t is hash_api
+ * there, so nothing changes. */
+#ifdef PIBENCH_STATIC_TREE
+#include PIBENCH_STATIC_TREE_HEADER
+namespace PiBench {
+using tree_t = PIBENCH_STATIC_TREE;
+}
+#else
+namespace PiBench {
+using tree_t = hash_api;
+}
+#endif
+
 namespace PiBench {
 
 void print_environment();
@@ -52,8 +74,62 @@ struct options_t {
   /// Number of parallel threads used for executing requests.
   uint32_t num_threads = 1;
 
-  /// Sampling window in milliseconds.
-  uint32_t sampling_ms = 1000;
+  /// Number of logical operation streams each thread interleaves
+  /// (prefetch-then-execute windows); 1 issues one operation at a time.
+  uint32_t batch_size = 1;
+
+  /// Hill-climb the interleave width before the measured run
+  /// (--auto_tune): short calibration bursts over a prefix of the
+  /// generated stream evaluate neighboring widths against measured
+  /// throughput, moving while it improves. The optimum tracks the
+  /// machine's miss latency and memory-level parallelism, so it is
+  /// probed per machine instead of hardcoded; the winner is stamped
+  /// into the output header and used in place of batch_size.
+  bool auto_tune = false;
+
+  /// Thread counts to sweep the run phase over without reloading; empty
+  /// runs once at num_threads. Mutating workloads accumulate across
+  /// sweep points since the loaded structure is reused.
+  std::vector<uint32_t> thread_sweep;
+
+  /// Worker placement policy: "compact" (fill nodes in order), "scatter"
+  /// (round-robin across nodes), "node:K" (only node K's CPUs, for
+  /// pinning local to the PM DIMMs), an explicit CPU list ("0,2,4-8"),
+  /// or "" to inherit OS placement.
+  std::string affinity = "";
+
+  /// Sampling window in milliseconds (timeline CSV tick).
+  uint32_t sampling_ms = 100;
+
+  /// Cap in milliseconds on the untimed warmup that precedes
+  /// measurement: workers run the workload while a monitor samples
+  /// aggregate throughput every sampling_ms, and the run clock restarts
+  /// once the window variance stabilizes or the cap expires. 0 starts
+  /// timing immediately. PCM counters still bracket the whole region,
+  /// warmup included.
+  uint32_t warmup_max_ms = 0;
+
+  /// Straggler threshold in milliseconds: workers stamp a tsc heartbeat
+  /// on every completed operation and a monitor samples the stamps every
+  /// sampling_ms; a window where any thread's stamp is older than this
+  /// is tainted — that worker sat preempted, so the window measured the
+  /// scheduler, not the table. Tainted windows are excluded from a
+  /// separate clean-throughput figure, the run is flagged, and per-
+  /// thread involuntary context-switch counts are reported. 0 disables.
+  uint32_t straggler_ms = 0;
+
+  /// CSV file streaming per-window throughput and the resizing flag
+  /// during the run phase ("" = off).
+  std::string timeline_file = "";
+
+  /// Results format: "text" keeps the human-oriented output only,
+  /// "json" additionally streams one JSON object per event (config,
+  /// phases, PCM, latency, timeline windows) to result_file. Lines are
+  /// flushed as they happen, so a killed run still yields the prefix.
+  std::string format = "text";
+
+  /// Destination of the JSON results stream (appended).
+  std::string result_file = "results.jsonl";
 
   /// Key prefix.
   std::string key_prefix = "";
@@ -61,9 +137,13 @@ struct options_t {
   /// Size of key in bytes.
   uint32_t key_size = 8;
 
-  /// Size of value in bytes.
+  /// Size of value in bytes (the maximum when value_size_dist is set).
   uint32_t value_size = 8;
 
+  /// Weighted (size, weight) pairs for distribution-driven value
+  /// sizing; empty keeps the single fixed value_size.
+  std::vector<std::pair<uint32_t, float>> value_size_dist;
+
   /// Ratio of read operations.
   float read_ratio = 0.0;
 
@@ -76,6 +156,67 @@ struct options_t {
   /// Ratio of remove operations.
   float remove_ratio = 0.0;
 
+  /// Ratio of read-modify-write operations, executed as a find followed
+  /// by an update of the same key.
+  float rmw_ratio = 0.0;
+
+  /// Ratio of upsert (insert-or-overwrite) operations.
+  float upsert_ratio = 0.0;
+
+  /// Hash stage the tables (and the generator-side quality report)
+  /// should select from the shared plug table; empty keeps defaults.
+  std::string hash_fn = "";
+
+  /// Probability that an operation reuses the previous operation's key
+  /// instead of drawing a fresh one; runs of dependent keys form
+  /// geometric chains of expected length 1/(1-dep_ratio).
+  float dep_ratio = 0.0;
+
+  /// Client think time in nanoseconds spun between operations (outside
+  /// the per-operation latency window); 0 issues back to back.
+  uint32_t think_ns = 0;
+
+  /// Run the --calibrate primitive probe (calibrate.hpp) before the
+  /// benchmark and stamp the results into the output header.
+  bool calibrate = false;
+
+  /// Bracket one operation in perf_sample with per-thread hardware
+  /// counter reads (LLC misses, dTLB misses, backend stalls) and charge
+  /// the deltas to that operation's type; 0 disables. The two read()
+  /// syscalls dwarf the operation itself, so this samples rather than
+  /// measures every op.
+  uint32_t perf_sample = 0;
+
+  /// Derive values as a keyed checksum of their key and validate every
+  /// successful read inline (value_generator_t::verify_checksum, a few
+  /// ns per read) — correctness checking cheap enough to leave on in
+  /// performance runs, so silent corruption surfaces in the run that
+  /// caused it instead of a later audit.
+  bool verify = false;
+
+  /// Churn: fraction of operations replaced by insert/remove pairs over
+  /// a sliding window of fresh keys. Each worker slice first grows its
+  /// window to churn_window keys, then strictly alternates insert and
+  /// remove of the oldest, holding table cardinality constant while
+  /// turning records over — steady reclamation and tombstone pressure.
+  float churn_ratio = 0.0;
+
+  /// Live churned keys maintained per worker slice.
+  uint32_t churn_window = 1 << 16;
+
+  /// Open-loop offered load in operations per second per thread: each
+  /// operation gets an intended start on a fixed schedule and latency
+  /// is measured from it, so queueing delay behind a slow operation is
+  /// charged to the ops it delays instead of being silently omitted.
+  /// 0 keeps the closed loop (issue on return).
+  uint64_t arrival_rate = 0;
+
+  /// Hot-set drift for skewed key distributions: number of full
+  /// keyspace rotations the hot region makes over the run; 0 keeps it
+  /// fixed. The drawn ids are rotated before hashing, so the hot keys
+  /// move across the keyspace while the skew shape stays put.
+  float hotspot_drift = 0.0;
+
   /// Ratio of scan operations.
   float scan_ratio = 0.0;
 
@@ -100,8 +241,104 @@ struct options_t {
   /// Whether to skip the load phase.
   bool skip_load = true;
 
+  /// Load through hash_api::bulk_load over per-thread slices of the
+  /// key/value slabs instead of per-record insert calls.
+  bool use_bulk_load = false;
+
   /// Ratio of requests to sample latency from (between 0.0 and 1.0).
   float latency_sampling = 0.0;
+
+  /// Path to dump the generated workload as a binary trace ("" = off).
+  std::string record_file = "";
+
+  /// Path to a binary trace to replay instead of generating ("" = off).
+  std::string replay_file = "";
+
+  /// Number of worker processes sharing the pool; above 1 the run
+  /// forks that many single-threaded workers which attach to the same
+  /// pool file and synchronize phases over a process-shared barrier.
+  uint32_t num_processes = 1;
+
+  /// Record counts for the crash-recovery sweep: for each N a child
+  /// process loads N records and SIGKILLs itself, then recovery is
+  /// timed and a key sample validated in a fresh process. Empty
+  /// disables the mode.
+  std::vector<uint64_t> crash_points;
+
+  /// Pre-loaded pool images ("" = off). save_pool preserves the pool
+  /// file after the load phase at this path, next to a manifest of the
+  /// generator parameters it was loaded with; from_pool attaches a
+  /// copy of such an image and skips the load phase entirely when the
+  /// saved manifest matches this invocation (a mismatch falls back to
+  /// loading from scratch). Both require an explicit pool_path.
+  std::string save_pool = "";
+  std::string from_pool = "";
+};
+
+/**
+ * @brief HDR-style latency histogram.
+ *
+ * Values are bucketed into power-of-two groups subdivided into SUBS
+ * linear sub-buckets, i.e. 5 mantissa bits are kept, bounding the
+ * relative quantization error at ~3% regardless of magnitude. record()
+ * is two shifts and an increment, cheap enough to call on every
+ * operation instead of sampling.
+ */
+struct latency_hist_t {
+  static constexpr uint32_t GROUPS = 48;
+  static constexpr uint32_t SUBS = 32;
+
+  latency_hist_t() : count_(0), max_(0) {
+    for (auto& g : buckets_)
+      for (auto& b : g) b = 0;
+  }
+
+  void record(uint64_t v) noexcept {
+    uint32_t group, sub;
+    if (v < SUBS) {
+      group = 0;
+      sub = static_cast<uint32_t>(v);
+    } else {
+      uint32_t msb = 63 - __builtin_clzll(v);
+      group = msb - 4;
+      if (group >= GROUPS) {
+        group = GROUPS - 1;
+        sub = SUBS - 1;
+      } else {
+        sub = (v >> (msb - 5)) & (SUBS - 1);
+      }
+    }
+    ++buckets_[group][sub];
+    ++count_;
+    if (v > max_) max_ = v;
+  }
+
+  void merge(const latency_hist_t& other) noexcept {
+    for (uint32_t g = 0; g < GROUPS; ++g)
+      for (uint32_t s = 0; s < SUBS; ++s) buckets_[g][s] += other.buckets_[g][s];
+    count_ += other.count_;
+    if (other.max_ > max_) max_ = other.max_;
+  }
+
+  /**
+   * @brief Returns the value at quantile q (e.g. 0.99 for p99).
+   */
+  uint64_t percentile(double q) const noexcept {
+    uint64_t target = static_cast<uint64_t>(q * count_);
+    uint64_t seen = 0;
+    for (uint32_t g = 0; g < GROUPS; ++g) {
+      for (uint32_t s = 0; s < SUBS; ++s) {
+        seen += buckets_[g][s];
+        if (seen > target)
+          return g == 0 ? s : static_cast<uint64_t>(SUBS + s) << (g - 1);
+      }
+    }
+    return max_;
+  }
+
+  uint64_t buckets_[GROUPS][SUBS];
+  uint64_t count_;
+  uint64_t max_;
 };
 
 /**
@@ -114,6 +351,40 @@ struct alignas(64) stats_t {
   /// Number of operations completed.
   uint64_t operation_count;
 
+  /// Per-operation latency histograms (rdtsc deltas), indexed by
+  /// operation_t. Each worker owns one stats_t; histograms are merged
+  /// across threads once the run finishes.
+  latency_hist_t op_hist[NUM_OPS];
+
+  /// READ latency split by outcome. Negative lookups (--negative_ratio)
+  /// land in the miss histogram by construction, so the hit and miss
+  /// paths are reported separately instead of blended into op_hist.
+  latency_hist_t read_hit_hist;
+  latency_hist_t read_miss_hist;
+
+  /// READ outcome counters, kept even when latency capture is off.
+  uint64_t read_hits = 0;
+  uint64_t read_misses = 0;
+
+  /// Reads whose returned value failed checksum validation (--verify).
+  uint64_t verify_fails = 0;
+
+  /// Open-loop arrival mode: delay between an operation's intended
+  /// start and when the worker actually got to it.
+  latency_hist_t queue_hist;
+
+  /// tsc stamp of this worker's most recently completed operation,
+  /// written per op when the straggler check is on and read racily by
+  /// the monitor thread; a stale stamp means the worker was preempted.
+  uint64_t heartbeat = 0;
+
+  /// Sampled hardware-event attribution (--perf_sample): counter deltas
+  /// around individual bracketed operations, bucketed by operation_t.
+  uint64_t ev_samples[NUM_OPS] = {0};
+  uint64_t ev_llc[NUM_OPS] = {0};
+  uint64_t ev_dtlb[NUM_OPS] = {0};
+  uint64_t ev_stall[NUM_OPS] = {0};
+
   /// Vector to store both start and end time of requests.
   std::vector<std::chrono::high_resolution_clock::time_point> times;
 
@@ -140,7 +411,7 @@ class benchmark_t {
    * @param tree pointer to tree data structure compliant with the API.
    * @param opt options used to run the benchmark.
    */
-  benchmark_t(hash_api* tree, const options_t& opt) noexcept;
+  benchmark_t(tree_t* tree, const options_t& opt) noexcept;
 
   /**
    * @brief Destroy the benchmark_t object.
@@ -156,7 +427,23 @@ class benchmark_t {
    * equivalent, results.
    */
   void load() noexcept;
+
+  /// Run the measured phase: once at num_threads, or once per entry of
+  /// thread_sweep against the same loaded structure.
   void run() noexcept;
+
+  /// Hill-climb the interleave width in calibration bursts against the
+  /// loaded table (--auto_tune); run() then uses the winner in place of
+  /// options_t::batch_size.
+  void auto_tune() noexcept;
+
+  /// Swap in a fresh table (comparison mode): the generated workload
+  /// buffers are kept, so the next load()/run() replays the identical
+  /// stream against the new library.
+  void set_tree(tree_t* tree) noexcept { tree_ = tree; }
+
+  /// Throughput of the last run_threads() pass, for summary blocks.
+  float last_mops() const noexcept { return last_mops_; }
   void search() noexcept;
 
   /// Run the workload as specified by options_t.
@@ -168,10 +455,22 @@ class benchmark_t {
   static constexpr size_t MAX_SCAN = 1000;
 
  private:
+  /**
+   * @brief Generate the workload buffers (keys, values, op stream).
+   *
+   * Runs once; later load() calls reuse the buffers so every library in
+   * a comparison run executes the identical stream. Returns the
+   * generation time in milliseconds.
+   */
+  float generate_workload() noexcept;
+
   /// Array to store keys and values.
   pair* kvs;
   /// Tree data structure being benchmarked.
-  hash_api* tree_;
+  tree_t* tree_;
+
+  /// Throughput (Mops/s) measured by the last run_threads() pass.
+  float last_mops_ = 0;
 
   /// Options used to run this benchmark.
   const options_t opt_;
@@ -187,6 +486,90 @@ class benchmark_t {
 
   /// Intel PCM handler.
   PCM* pcm_;
+
+  /// perf_event fallback used when PCM cannot program the PMU (no MSR
+  /// access on containerized runners); serves the same begin/end
+  /// bracket with cycles, LLC/dTLB misses and IMC bandwidth.
+  perf_counters_t perf_;
+
+  /// PMem DIMM vendor-counter snapshot (media vs controller traffic,
+  /// see pmm_media.h) at the last pcm_begin(); stays invalid when
+  /// ipmctl or the DIMMs are absent and the metric is skipped.
+  pmm_media_counters media_before_;
+
+  /**
+   * @brief Bracket a benchmark phase with PCM counter snapshots.
+   *
+   * pcm_begin() captures the system counter state; pcm_end() diffs
+   * against it and prints DRAM and PM read/write bandwidth, bytes per
+   * operation, and LLC misses tagged with the phase name. Both are
+   * no-ops unless PCM was enabled.
+   */
+  void pcm_begin() noexcept;
+  void pcm_end(const char* phase, uint64_t ops, float elapsed_ms) noexcept;
+
+  /// Counter state captured by the last pcm_begin().
+  std::unique_ptr<SystemCounterState> pcm_before_;
+
+  /// Flush/fence counters (PERSIST_STATS table builds) at the last
+  /// pcm_begin(), for the per-phase delta.
+  uint64_t flush_before_ = 0;
+  uint64_t fence_before_ = 0;
+
+  /**
+   * @brief Append one JSON object line to the results stream.
+   *
+   * 'fields' is the pre-rendered body without braces; the writer wraps
+   * it and flushes so partial runs keep every completed event. No-op
+   * unless --format json opened the stream.
+   */
+  void emit_result(const std::string& fields) noexcept;
+
+  /// JSON-lines results stream (open only in json mode).
+  std::ofstream results_;
+
+  /// One measured pass over the operation stream at the given
+  /// concurrency (the body run() dispatches to).
+  void run_threads(uint32_t num_threads) noexcept;
+
+  /// One calibration burst for auto_tune(): nops operations of the
+  /// generated stream at the given interleave width, returning Mops/s.
+  /// Mutations are softened (inserts to upserts, removes to reads) so
+  /// every candidate width sees a table of the same cardinality.
+  float tune_burst(uint32_t width, uint64_t nops) noexcept;
+
+  /// Effective interleave width used by run_threads():
+  /// options_t::batch_size unless auto_tune() picked a better one.
+  uint32_t batch_size_;
+
+  /// Pin the calling worker to cpu_assign_[tid % size]; no-op when no
+  /// affinity policy is set.
+  void pin_thread(uint32_t tid) noexcept;
+
+  /// CPU ids in assignment order, built from options_t::affinity.
+  std::vector<int> cpu_assign_;
+
+  /// Run-phase operation stream, fully drawn before timing starts so
+  /// the measured loop does no RNG work (also what --record dumps).
+  /// The low bits hold the operation_t; bit 7 marks an operation whose
+  /// key depends on (equals) the previous operation's key.
+  std::vector<uint8_t> trace_ops_;
+
+  /// Contiguous backing for all keys and values; kvs entries point into
+  /// these slabs so the timed loop walks them sequentially.
+  char* key_slab_;
+  char* value_slab_;
+
+  /// Per-record value size and size-class index when value sizes are
+  /// distribution-driven (both empty in fixed-size runs).
+  std::vector<uint32_t> value_sz_;
+  std::vector<uint8_t> value_cls_;
+
+  /// mmap'ed trace file when replaying, nullptr otherwise.
+  char* replay_map_;
+
+  /// Size in bytes of the replay mapping.
+  size_t replay_bytes_;
 };
 }  // namespace PiBench
 
@@ -0,0 +1,173 @@
+#ifndef __CALIBRATE_HPP__
+#define __CALIBRATE_HPP__
+
+#include <cpuid.h>
+#include <fcntl.h>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "stopwatch.hpp"
+
+namespace PiBench
+{
+
+/**
+ * @brief Platform primitive microbenchmark behind --calibrate.
+ *
+ * Results from different boxes of the fleet are only comparable once
+ * the cost of the persistence primitives is factored out: a table that
+ * looks 20% slower may just sit behind a slower clwb. This probe
+ * measures the flush/fence primitives (clflush, clflushopt, clwb,
+ * ntstore, sfence) and sequential/random read and write bandwidth at a
+ * few block sizes against a buffer mapped on the pool path (falling
+ * back to DRAM when none is given), and stamps the numbers into the
+ * run header and JSON stream so downstream comparisons can normalize
+ * by them.
+ *
+ * clflushopt/clwb are emitted as raw byte sequences (the usual
+ * 66-prefix encodings) so the binary runs on parts without the ISA,
+ * and cpuid gates their use at runtime.
+ */
+
+inline void calibrate_clflush(volatile char* p)
+{
+    asm volatile("clflush %0" : "+m"(*p));
+}
+
+inline void calibrate_clflushopt(volatile char* p)
+{
+    asm volatile(".byte 0x66; clflush %0" : "+m"(*p));
+}
+
+inline void calibrate_clwb(volatile char* p)
+{
+    asm volatile(".byte 0x66; xsaveopt %0" : "+m"(*p));
+}
+
+inline std::string run_calibration(const std::string& pool_path)
+{
+    constexpr size_t BUF = 256ULL << 20;
+    constexpr size_t LINE = 64;
+    char* buf = nullptr;
+    bool on_pm = false;
+    int fd = -1;
+    if (!pool_path.empty())
+    {
+        std::string f = pool_path + "_calibrate";
+        fd = open(f.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd >= 0 && ftruncate(fd, BUF) == 0)
+        {
+            buf = (char*)mmap(nullptr, BUF, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
+            if (buf == MAP_FAILED)
+                buf = nullptr;
+            else
+                on_pm = true;
+        }
+        unlink(f.c_str());
+    }
+    if (buf == nullptr)
+        buf = (char*)mmap(nullptr, BUF, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    memset(buf, 0xab, BUF); // fault everything in before timing
+
+    unsigned a, b, c, d;
+    bool has_clflushopt = false, has_clwb = false;
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d))
+    {
+        has_clflushopt = b & (1u << 23);
+        has_clwb = b & (1u << 24);
+    }
+
+    double ns = tsc_stopwatch_t::ns_per_cycle();
+    std::ostringstream j;
+    j << "\"event\":\"calibrate\",\"medium\":\""
+      << (on_pm ? "pool_path" : "dram") << "\"";
+    std::cout << "Calibration (" << (on_pm ? "pool path" : "DRAM")
+              << "):" << std::endl;
+
+    // Flush-primitive latency: write one word per line, flush, fence;
+    // distinct lines so every flush actually writes back.
+    constexpr uint64_t ITERS = 1 << 20;
+    auto lat = [&](const char* name, auto&& flush_op) {
+        uint64_t t0 = tsc_stopwatch_t::now();
+        for (uint64_t i = 0; i < ITERS; ++i)
+        {
+            volatile char* p = buf + (i * LINE) % BUF;
+            *(volatile uint64_t*)p = i;
+            flush_op(p);
+            _mm_sfence();
+        }
+        double l = (tsc_stopwatch_t::now() - t0) * ns / ITERS;
+        std::cout << "\t" << name << "+sfence: " << l << " ns" << std::endl;
+        j << ",\"" << name << "_ns\":" << l;
+    };
+    lat("clflush", calibrate_clflush);
+    if (has_clflushopt)
+        lat("clflushopt", calibrate_clflushopt);
+    if (has_clwb)
+        lat("clwb", calibrate_clwb);
+    lat("ntstore", [](volatile char* p) {
+        _mm_stream_si64((long long*)p, 0x5a5a5a5a5a5a5a5aLL);
+    });
+    {
+        uint64_t t0 = tsc_stopwatch_t::now();
+        for (uint64_t i = 0; i < ITERS; ++i)
+            _mm_sfence();
+        double l = (tsc_stopwatch_t::now() - t0) * ns / ITERS;
+        std::cout << "\tsfence: " << l << " ns" << std::endl;
+        j << ",\"sfence_ns\":" << l;
+    }
+
+    // Bandwidth: one pass over the buffer per pattern. Reads are summed
+    // so the pass cannot be optimized away; writes go through ntstores,
+    // which is how the tables push bulk data to PM.
+    auto bw = [&](const char* name, size_t block, bool write, bool rnd) {
+        size_t blocks = BUF / block;
+        std::vector<uint64_t> order(blocks);
+        for (size_t i = 0; i < blocks; ++i)
+            order[i] = i;
+        if (rnd)
+            std::shuffle(order.begin(), order.end(),
+                         std::default_random_engine(42));
+        uint64_t sink = 0;
+        uint64_t t0 = tsc_stopwatch_t::now();
+        for (size_t i = 0; i < blocks; ++i)
+        {
+            char* p = buf + order[i] * block;
+            if (write)
+                for (size_t o = 0; o < block; o += 8)
+                    _mm_stream_si64((long long*)(p + o), i + o);
+            else
+                for (size_t o = 0; o < block; o += 8)
+                    sink += *(volatile uint64_t*)(p + o);
+        }
+        _mm_sfence();
+        double secs = (tsc_stopwatch_t::now() - t0) * ns / 1e9;
+        double mbs = BUF / 1e6 / secs + (sink & 1) * 1e-9;
+        std::cout << "\t" << name << ": " << mbs << " MB/s" << std::endl;
+        j << ",\"" << name << "_mb_s\":" << mbs;
+    };
+    bw("seq_read", 1 << 20, false, false);
+    bw("seq_write", 1 << 20, true, false);
+    bw("rnd_read_64", LINE, false, true);
+    bw("rnd_write_64", LINE, true, true);
+    bw("rnd_read_4k", 4096, false, true);
+    bw("rnd_write_4k", 4096, true, true);
+
+    munmap(buf, BUF);
+    if (fd >= 0)
+        close(fd);
+    return j.str();
+}
+} // namespace PiBench
+#endif
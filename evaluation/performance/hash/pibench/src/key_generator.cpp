@@ -8,7 +8,12 @@ namespace PiBench
   thread_local std::default_random_engine key_generator_t::generator_;
   thread_local uint32_t key_generator_t::seed_;
   thread_local char key_generator_t::buf_[KEY_MAX];
-  thread_local uint64_t key_generator_t::current_id_ = 200000000;
+  thread_local uint64_t key_generator_t::current_id_ = key_generator_t::SEQ_BASE;
+  thread_local uint64_t key_generator_t::rotation_ = 0;
+
+  thread_local uint64_t zipfian_key_generator_t::batch_[BATCH];
+  thread_local uint32_t zipfian_key_generator_t::batch_pos_ =
+      zipfian_key_generator_t::BATCH;
 
   key_generator_t::key_generator_t(size_t N, size_t size,
                                    const std::string &prefix)
@@ -19,10 +24,19 @@ namespace PiBench
   }
 
   const char *key_generator_t::next(bool in_sequence)
+  {
+    if (in_sequence)
+      return key_for_id(current_id_++);
+    uint64_t id = next_id();
+    if (rotation_ != 0)
+      id = 1 + (id - 1 + rotation_) % N_;
+    return key_for_id(id);
+  }
+
+  const char *key_generator_t::key_for_id(uint64_t id)
   {
     char *ptr = &buf_[prefix_.size()];
 
-    uint64_t id = in_sequence ? current_id_++ : next_id();
     uint64_t hashed_id =
         utils::multiplicative_hash<uint64_t>(id);
 
@@ -2,13 +2,13 @@
 #define __KEY_GENERATOR_HPP__
 
 #include "selfsimilar_int_distribution.hpp"
-#include "zipfian_int_distribution.hpp"
 
 #include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <random>
 #include <string>
+#include <vector>
 
 namespace PiBench
 {
@@ -58,6 +58,16 @@ public:
      */
     virtual const char* next(bool in_sequence = false) final;
 
+    /**
+     * @brief Materialize the key for a specific id.
+     *
+     * Same hashing and layout as next(), but for a caller-chosen id —
+     * used to build keys outside the generator's own streams, e.g.
+     * guaranteed-absent keys drawn from NEG_BASE upwards. The returned
+     * pointer aliases the same thread-local buffer as next().
+     */
+    const char* key_for_id(uint64_t id);
+
     /**
      * @brief Returns total key size (including prefix).
      *
@@ -90,10 +100,54 @@ public:
      */
     static uint32_t get_seed() noexcept { return seed_; }
 
+    /**
+     * @brief Prepare the calling thread to generate keys.
+     *
+     * Key generation state (engine, key buffer, sequence counter) is
+     * thread_local, so threads sharing one generator draw independent
+     * streams — but only the constructing thread had its buffer stamped
+     * with the prefix. Partitioned loading calls this on each worker
+     * with a distinct seed and the first sequential id of its slice.
+     */
+    void prepare_thread(uint32_t seed, uint64_t first_id) const
+    {
+        memset(buf_, 0, KEY_MAX);
+        memcpy(buf_, prefix_.c_str(), prefix_.size());
+        set_seed(seed);
+        current_id_ = first_id;
+        rotation_ = 0;
+    }
+
+    /**
+     * @brief Rotate randomly drawn ids by 'r' positions (mod N).
+     *
+     * Skewed distributions concentrate mass on low ids; rotating the
+     * drawn id before hashing moves that hot region elsewhere in the
+     * keyspace while keeping the skew shape. Drift modes advance the
+     * rotation as the stream progresses. Sequential generation and
+     * key_for_id() are unaffected.
+     */
+    static void set_rotation(uint64_t r) { rotation_ = r; }
+
     static constexpr uint32_t KEY_MAX = 128;
 
+    /// First id handed out by sequential generation (next(true)).
+    static constexpr uint64_t SEQ_BASE = 200000000;
+
+    /// First id used for negative (guaranteed-absent) keys: above both
+    /// the random id range [1, N] and anything sequential generation
+    /// hands out, so a key built from it is never loaded.
+    static constexpr uint64_t NEG_BASE = 2 * SEQ_BASE;
+
+    /// First id used by churn-mode insert/remove pairs; its own range
+    /// so churned keys never collide with loaded or negative ones.
+    static constexpr uint64_t CHURN_BASE = 3 * SEQ_BASE;
+
     static thread_local uint64_t current_id_;
 
+    /// Rotation applied to randomly drawn ids (see set_rotation()).
+    static thread_local uint64_t rotation_;
+
 protected:
     virtual uint64_t next_id() = 0;
 
@@ -154,22 +208,201 @@ private:
     selfsimilar_int_distribution<uint64_t> dist_;
 };
 
+/**
+ * @brief Zipfian generator backed by a Walker alias table.
+ *
+ * The inverse-CDF method (zipfian_int_distribution) pays a pow() per
+ * draw, hundreds of ns at high skew. Instead the rank probabilities
+ * 1/k^theta are folded once at construction into an alias table of
+ * (threshold, partner) pairs, after which every draw is one uniform
+ * double, one table load and one compare — constant time regardless of
+ * skew. Construction is a single O(N) pass (about the cost the old
+ * zeta computation already paid) and the table costs 8 bytes per rank.
+ *
+ * The table is what makes generator memory scale with the keyspace:
+ * at billions of keys it runs to tens of GB and perturbs the very
+ * DRAM/PM balance under test. Above ALIAS_MAX_N construction therefore
+ * skips the table and draws fall back to rejection-inversion sampling
+ * (Hormann & Derflinger), which needs only a handful of precomputed
+ * doubles — O(1) memory at any scale, at the price of a pow() or two
+ * per draw.
+ */
 class zipfian_key_generator_t final : public key_generator_t
 {
 public:
     zipfian_key_generator_t(size_t N, size_t size, const std::string& prefix = "", float skew = 0.99)
-        : dist_(1, N, skew),
-          key_generator_t(N, size, prefix)
+        : key_generator_t(N, size, prefix)
     {
+        if (N <= ALIAS_MAX_N)
+            build_alias(N, skew);
+        else
+            build_rejection(N, skew);
     }
 
+    /**
+     * @brief Fill 'out' with 'n' random ranks in [1, N].
+     *
+     * The loop body is branch-light (the alias pick compiles to a
+     * conditional move) and the table accesses are independent, so the
+     * compiler can unroll and gather; callers wanting bulk generation
+     * should draw through here instead of looping next().
+     */
+    void next_ids(uint64_t* out, size_t n)
+    {
+        std::uniform_real_distribution<double> u01(0.0, 1.0);
+        if (prob_.empty())
+        {
+            for (size_t i = 0; i < n; ++i)
+                out[i] = sample_rejection(u01);
+            return;
+        }
+        const size_t sz = prob_.size();
+        for (size_t i = 0; i < n; ++i)
+        {
+            double u = u01(generator_) * sz;
+            size_t k = static_cast<size_t>(u);
+            out[i] = 1 + (u - k < prob_[k] ? k : alias_[k]);
+        }
+    }
+
+protected:
     virtual uint64_t next_id() override
     {
-        return dist_(generator_);
+        // next() is a per-key virtual call, so the batched draw is
+        // surfaced through a thread-local buffer refilled BATCH ids at
+        // a time. The buffer starts empty per thread, so it is always
+        // refilled under the seed prepare_thread() installed.
+        if (batch_pos_ == BATCH)
+        {
+            next_ids(batch_, BATCH);
+            batch_pos_ = 0;
+        }
+        return batch_[batch_pos_++];
     }
 
 private:
-    zipfian_int_distribution<uint64_t> dist_;
+    /**
+     * @brief Build the alias table over ranks 0..N-1 (Walker/Vose).
+     *
+     * Scaled masses below 1 donate their slack to a heavier partner;
+     * every slot ends up with an acceptance threshold and an alias.
+     * Ranks fit uint32_t, which bounds the keyspace at 2^32 — well
+     * above any run we do.
+     */
+    void build_alias(size_t N, double theta)
+    {
+        std::vector<double> w(N);
+        double zeta = 0.0;
+        for (size_t k = 0; k < N; ++k)
+        {
+            w[k] = std::pow(static_cast<double>(k + 1), -theta);
+            zeta += w[k];
+        }
+        prob_.resize(N);
+        alias_.resize(N);
+        const double scale = N / zeta;
+        std::vector<uint32_t> small, large;
+        for (size_t k = 0; k < N; ++k)
+        {
+            w[k] *= scale;
+            (w[k] < 1.0 ? small : large).push_back(static_cast<uint32_t>(k));
+        }
+        while (!small.empty() && !large.empty())
+        {
+            uint32_t s = small.back(); small.pop_back();
+            uint32_t l = large.back(); large.pop_back();
+            prob_[s] = static_cast<float>(w[s]);
+            alias_[s] = l;
+            w[l] -= 1.0 - w[s];
+            (w[l] < 1.0 ? small : large).push_back(l);
+        }
+        // Rounding leftovers are slots of mass ~1: accept unconditionally.
+        for (auto& rest : {&small, &large})
+            while (!rest->empty())
+            {
+                prob_[rest->back()] = 1.0f;
+                alias_[rest->back()] = rest->back();
+                rest->pop_back();
+            }
+    }
+
+    /**
+     * @brief Precompute the rejection-inversion constants (no table).
+     *
+     * The flattened CDF H(x) of the continuous majorant x^-theta is
+     * inverted analytically; a draw inverts a uniform through it and
+     * accepts or rejects against the discrete mass, a couple of pow()
+     * calls either way with acceptance probability near 1.
+     */
+    void build_rejection(size_t N, double theta)
+    {
+        theta_ = theta;
+        h_x1_ = h_integral(1.5) - 1.0;
+        h_n_ = h_integral(N + 0.5);
+        s_ = 2.0 - h_integral_inverse(h_integral(2.5) - std::pow(2.0, -theta));
+        rej_n_ = N;
+    }
+
+    double h_integral(double x) const
+    {
+        double logx = std::log(x);
+        // expm1/log1p keep precision when theta is close to 1, where
+        // (1-theta)*log(x) is tiny.
+        return theta_ == 1.0 ? logx
+                             : std::expm1((1.0 - theta_) * logx) /
+                                   (1.0 - theta_);
+    }
+
+    double h_integral_inverse(double x) const
+    {
+        if (theta_ == 1.0)
+            return std::exp(x);
+        double t = x * (1.0 - theta_);
+        if (t < -1.0)
+            t = -1.0; // clamp rounding at the tail
+        return std::exp(std::log1p(t) / (1.0 - theta_));
+    }
+
+    uint64_t sample_rejection(std::uniform_real_distribution<double>& u01)
+    {
+        while (true)
+        {
+            double u = h_n_ + u01(generator_) * (h_x1_ - h_n_);
+            double x = h_integral_inverse(u);
+            uint64_t k = static_cast<uint64_t>(x + 0.5);
+            if (k < 1)
+                k = 1;
+            else if (k > rej_n_)
+                k = rej_n_;
+            if (k - x <= s_ ||
+                u >= h_integral(k + 0.5) - std::pow(static_cast<double>(k),
+                                                    -theta_))
+                return k;
+        }
+    }
+
+    static constexpr uint32_t BATCH = 64;
+
+    /// Largest keyspace the alias table is built for: 8 bytes per rank
+    /// puts 2^27 ranks at 1 GB; past that the table would dominate the
+    /// memory of the process under test.
+    static constexpr size_t ALIAS_MAX_N = 1ULL << 27;
+
+    /// Pre-drawn ranks handed out one by one through next_id().
+    static thread_local uint64_t batch_[BATCH];
+    static thread_local uint32_t batch_pos_;
+
+    /// Acceptance threshold and alias partner per rank (empty above
+    /// ALIAS_MAX_N, where draws use rejection-inversion instead).
+    std::vector<float> prob_;
+    std::vector<uint32_t> alias_;
+
+    /// Rejection-inversion constants (see build_rejection()).
+    double theta_ = 0.0;
+    double h_x1_ = 0.0;
+    double h_n_ = 0.0;
+    double s_ = 0.0;
+    uint64_t rej_n_ = 0;
 };
 } // namespace PiBench
 #endif
\ No newline at end of file
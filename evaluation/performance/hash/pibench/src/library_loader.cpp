@@ -7,6 +7,8 @@
 namespace PiBench
 {
 
+  void (*persist_stats_read_fn)(uint64_t *, uint64_t *) = nullptr;
+
   library_loader_t::library_loader_t(const std::string &path)
   {
     // Dynamically loads the library indicated by 'path'
@@ -32,6 +34,14 @@ namespace PiBench
       std::cout << "Could not find 'create()'" << std::endl;
       exit(1);
     }
+
+    // Optional flush/fence accounting exported by instrumented builds
+    // (common/persist.h with PERSIST_STATS); absence is the normal case.
+    dlerror();
+    persist_stats_read_fn =
+        (void (*)(uint64_t *, uint64_t *))dlsym(handle_, "persist_stats_read");
+    if (dlerror() != nullptr)
+      persist_stats_read_fn = nullptr;
   }
 
   library_loader_t::~library_loader_t()
@@ -10,6 +10,11 @@
 namespace PiBench
 {
 
+  /// Reader for the optional PERSIST_STATS flush/fence counters in the
+  /// loaded table library (common/persist.h); set by library_loader_t
+  /// when the symbol resolves, left nullptr for uninstrumented builds.
+  extern void (*persist_stats_read_fn)(uint64_t *, uint64_t *);
+
   class library_loader_t
   {
   public:
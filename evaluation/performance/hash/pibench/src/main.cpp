@@ -1,17 +1,264 @@
 #include <dlfcn.h>
+#include <pthread.h>  // process-shared barrier
+#include <sys/mman.h> // mmap
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork
 
 #include <algorithm>
+#include <csignal> // raise
 #include <cerrno>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 
 #include "benchmark.hpp"
+#include "calibrate.hpp"
 #include "cxxopts.hpp"
 #include "hash_api.h"
 #include "library_loader.hpp"
+#include "trace.hpp"
 
 using namespace PiBench;
 
+/**
+ * Renders the manifest describing the record set a saved pool image
+ * was loaded with. Attaching is only sound when every field that
+ * shapes the loaded records matches, so --from-pool compares the
+ * saved manifest byte-for-byte against a freshly rendered one instead
+ * of parsing fields individually.
+ */
+static std::string pool_manifest(const options_t &opt,
+                                 const tree_options_t &tree_opt)
+{
+  std::ostringstream m;
+  m << "records=" << opt.num_ops << "\n"
+    << "key_prefix=" << opt.key_prefix << "\n"
+    << "key_size=" << opt.key_size << "\n"
+    << "value_size=" << opt.value_size << "\n"
+    << "seed=" << opt.rnd_seed << "\n"
+    << "distribution=" << static_cast<int>(opt.key_distribution) << "\n"
+    << "skew=" << opt.key_skew << "\n"
+    << "negative_ratio=" << opt.negative_ratio << "\n"
+    << "hash_fn=" << opt.hash_fn << "\n"
+    << "hash_size=" << opt.hash_size << "\n"
+    << "pool_size=" << tree_opt.pool_size << "\n";
+  return m.str();
+}
+
+/**
+ * Byte copy for pool images (the pool may live on a DAX mount where
+ * rename/link tricks do not apply across filesystems).
+ */
+static bool copy_pool_image(const std::string &from, const std::string &to)
+{
+  std::ifstream src(from, std::ifstream::binary);
+  std::ofstream dst(to, std::ofstream::binary | std::ofstream::trunc);
+  if (!src.is_open() || !dst.is_open())
+    return false;
+  dst << src.rdbuf();
+  return src.good() && dst.good();
+}
+
+/**
+ * Crash-recovery sweep. For each N in opt.crash_points:
+ *   1. a forked writer creates the pool, inserts N sequentially-keyed
+ *      records and SIGKILLs itself mid-flight (no teardown runs);
+ *   2. a forked reader reopens the pool, times hash_api::recovery(),
+ *      and probes a deterministic sample of the inserted keys.
+ * Each phase runs in its own process so dlopen/pool state never leaks
+ * between iterations; the pool file is removed between sweep points
+ * when a pool_path is configured (libraries with internal fixed paths
+ * must be pointed at a fresh directory per invocation).
+ */
+static void run_crash_recovery(const options_t &opt,
+                               const tree_options_t &tree_opt)
+{
+  std::cout << "Crash-recovery sweep:" << std::endl;
+  for (auto n : opt.crash_points)
+  {
+    if (!tree_opt.pool_path.empty())
+      std::remove(tree_opt.pool_path.c_str());
+    pid_t writer = fork();
+    if (writer == 0)
+    {
+      library_loader_t lib(opt.library_file);
+      hash_api *tree = lib.create_tree(tree_opt, opt.hash_size, 1);
+      if (tree == nullptr)
+        _exit(1);
+      tree->thread_ini(0);
+      uniform_key_generator_t kg(n, opt.key_size, opt.key_prefix);
+      kg.prepare_thread(opt.rnd_seed, key_generator_t::SEQ_BASE);
+      char value_in[value_generator_t::VALUE_MAX] = {0};
+      uint64_t counter = 0;
+      for (uint64_t i = 0; i < n; ++i)
+        tree->insert(kg.next(true), opt.key_size, value_in, opt.value_size, 0,
+                     counter);
+      raise(SIGKILL); // die with the pool as-is; no destructors, no flushes
+      _exit(1);
+    }
+    int status;
+    waitpid(writer, &status, 0);
+    if (!WIFSIGNALED(status))
+    {
+      std::cout << "\tN: " << n << " writer exited instead of crashing"
+                << std::endl;
+      continue;
+    }
+    pid_t reader = fork();
+    if (reader == 0)
+    {
+      library_loader_t lib(opt.library_file);
+      stopwatch_t sw;
+      sw.start();
+      hash_api *tree = lib.create_tree(tree_opt, opt.hash_size, 1);
+      if (tree == nullptr)
+        _exit(1);
+      tree->recovery();
+      auto ms = sw.elapsed<std::chrono::milliseconds>();
+      tree->thread_ini(0);
+      // Regenerate the writer's key sequence and probe an evenly spaced
+      // sample; a crashed load may legitimately lose in-flight tail
+      // inserts, so report the hit count instead of asserting.
+      uniform_key_generator_t kg(n, opt.key_size, opt.key_prefix);
+      kg.prepare_thread(opt.rnd_seed, key_generator_t::SEQ_BASE);
+      uint64_t stride = std::max<uint64_t>(1, n / 1000);
+      uint64_t sampled = 0, found = 0;
+      char value_out[value_generator_t::VALUE_MAX];
+      for (uint64_t i = 0; i < n; ++i)
+      {
+        auto key = kg.next(true);
+        if (i % stride != 0)
+          continue;
+        ++sampled;
+        if (tree->find(key, opt.key_size, value_out, 0))
+          ++found;
+      }
+      std::cout << "\tN: " << n << " recovery_ms: " << ms
+                << " sampled: " << sampled << " found: " << found << std::endl;
+      _exit(0);
+    }
+    waitpid(reader, &status, 0);
+  }
+}
+
+/**
+ * Multi-process shared-pool mode. Forks opt.num_processes
+ * single-threaded workers that each dlopen the library and attach to
+ * the same pool file. Phases synchronize over a pthread barrier in an
+ * anonymous shared mapping (a futex under the hood), so every process
+ * enters the measured loop together. Each worker loads a disjoint
+ * sequential key slice, then runs its share of operations with keys
+ * drawn over the whole keyspace so probes collide across address
+ * spaces. The parent aggregates per-process counts and elapsed times.
+ */
+static void run_multiprocess(const options_t &opt,
+                             const tree_options_t &tree_opt)
+{
+  constexpr uint32_t MAX_PROCS = 256;
+  struct slot_t
+  {
+    uint64_t ops;
+    float elapsed_ms;
+  };
+  struct shared_t
+  {
+    pthread_barrier_t barrier;
+    slot_t slots[MAX_PROCS];
+  };
+  uint32_t nprocs = std::min(opt.num_processes, MAX_PROCS);
+  auto *shm = static_cast<shared_t *>(mmap(nullptr, sizeof(shared_t),
+                                           PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  if (shm == MAP_FAILED)
+  {
+    std::cout << "Error mapping shared state." << std::endl;
+    exit(1);
+  }
+  pthread_barrierattr_t attr;
+  pthread_barrierattr_init(&attr);
+  pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(&shm->barrier, &attr, nprocs);
+
+  uint64_t share = opt.num_ops / nprocs;
+  for (uint32_t p = 0; p < nprocs; ++p)
+  {
+    pid_t pid = fork();
+    if (pid != 0)
+      continue;
+    library_loader_t lib(opt.library_file);
+    hash_api *tree = lib.create_tree(tree_opt, opt.hash_size, 1);
+    if (tree == nullptr)
+      _exit(1);
+    tree->thread_ini(0);
+    uniform_key_generator_t kg(opt.num_ops, opt.key_size, opt.key_prefix);
+    kg.prepare_thread(opt.rnd_seed + p, key_generator_t::SEQ_BASE + p * share);
+    operation_generator_t og(opt.read_ratio, opt.insert_ratio,
+                             opt.remove_ratio, opt.rmw_ratio,
+                             opt.upsert_ratio);
+    operation_generator_t::set_seed(opt.rnd_seed + p);
+    char value_in[value_generator_t::VALUE_MAX] = {0};
+    char value_out[value_generator_t::VALUE_MAX];
+    uint64_t counter = 0;
+    if (!opt.skip_load)
+    {
+      for (uint64_t i = 0; i < share; ++i)
+        tree->insert(kg.next(true), opt.key_size, value_in, opt.value_size, 0,
+                     counter);
+    }
+    pthread_barrier_wait(&shm->barrier);
+    stopwatch_t sw;
+    sw.start();
+    for (uint64_t i = 0; i < share; ++i)
+    {
+      auto key = kg.next(false);
+      switch (og.next())
+      {
+      case operation_t::READ:
+        tree->find(key, opt.key_size, value_out, 0);
+        break;
+      case operation_t::INSERT:
+        tree->insert(key, opt.key_size, value_in, opt.value_size, 0, counter++);
+        break;
+      case operation_t::REMOVE:
+        tree->remove(key, opt.key_size, 0);
+        break;
+      case operation_t::RMW:
+        tree->find(key, opt.key_size, value_out, 0);
+        tree->update(key, opt.key_size, value_in, opt.value_size);
+        break;
+      case operation_t::UPSERT:
+        tree->upsert(key, opt.key_size, value_in, opt.value_size, 0,
+                     counter++);
+        break;
+      }
+    }
+    shm->slots[p].ops = share;
+    shm->slots[p].elapsed_ms = sw.elapsed<std::chrono::milliseconds>();
+    _exit(0);
+  }
+
+  int status;
+  while (wait(&status) > 0)
+    ;
+  uint64_t total_ops = 0;
+  float max_ms = 0;
+  std::cout << "Multi-process run (" << nprocs << " processes):" << std::endl;
+  for (uint32_t p = 0; p < nprocs; ++p)
+  {
+    auto &s = shm->slots[p];
+    total_ops += s.ops;
+    max_ms = std::max(max_ms, s.elapsed_ms);
+    std::cout << "\tprocess " << p << ": " << s.ops << " ops in "
+              << s.elapsed_ms << " ms" << std::endl;
+  }
+  if (max_ms > 0)
+    std::cout << "\tAggregate throughput(Mops/s): "
+              << total_ops / (max_ms * 1000.0) << std::endl;
+  pthread_barrier_destroy(&shm->barrier);
+  munmap(shm, sizeof(shared_t));
+}
+
 int main(int argc, char **argv)
 {
   // Parse command line arguments
@@ -23,7 +270,9 @@ int main(int argc, char **argv)
                              "Benchmark framework for persistent indexes.");
     options.positional_help("INPUT").show_positional_help();
 
-    options.add_options()("input", "Absolute path to library file",
+    options.add_options()("input",
+                          "Absolute path to library file (comma-separated "
+                          "paths compare libraries on one workload)",
                           cxxopts::value<std::string>())(
         "n,records", "Number of records to load",
         cxxopts::value<uint64_t>()->default_value(std::to_string(
@@ -39,6 +288,32 @@ int main(int argc, char **argv)
         "t,threads", "Number of threads to use",
         cxxopts::value<uint32_t>()->default_value(
             std::to_string(opt.num_threads)))(
+        "b,batch", "Operation streams interleaved per thread",
+        cxxopts::value<uint32_t>()->default_value(
+            std::to_string(opt.batch_size)))(
+        "thread-sweep", "Comma-separated thread counts to sweep in-process",
+        cxxopts::value<std::string>())(
+        "affinity", "Worker placement: compact|scatter|node:K|CPU list",
+        cxxopts::value<std::string>()->default_value(opt.affinity))(
+        "timeline", "Stream per-window throughput/resize CSV to file",
+        cxxopts::value<std::string>())(
+        "value_sizes", "Weighted value sizes, e.g. 16:0.9,512:0.1",
+        cxxopts::value<std::string>())(
+        "crash-points", "Record counts for the crash-recovery sweep",
+        cxxopts::value<std::string>())(
+        "P,processes", "Worker processes sharing the pool",
+        cxxopts::value<uint32_t>()->default_value(
+            std::to_string(opt.num_processes)))(
+        "sampling_ms", "Timeline sampling window in milliseconds",
+        cxxopts::value<uint32_t>()->default_value(
+            std::to_string(opt.sampling_ms)))(
+        "warmup_ms", "Cap on the untimed warmup phase in milliseconds (0 = off)",
+        cxxopts::value<uint32_t>()->default_value(
+            std::to_string(opt.warmup_max_ms)))(
+        "straggler_ms",
+        "Stall threshold for the straggler check in milliseconds (0 = off)",
+        cxxopts::value<uint32_t>()->default_value(
+            std::to_string(opt.straggler_ms)))(
         "r,read_ratio", "Ratio of read operations",
         cxxopts::value<float>()->default_value(std::to_string(opt.read_ratio)))(
         "i,insert_ratio", "Ratio of insert operations",
@@ -46,12 +321,81 @@ int main(int argc, char **argv)
             opt.insert_ratio)))("d,remove_ratio", "Ratio of remove operations",
                                 cxxopts::value<float>()->default_value(
                                     std::to_string(opt.remove_ratio)))(
+        "rmw_ratio", "Ratio of read-modify-write (find+update) operations",
+        cxxopts::value<float>()->default_value(std::to_string(opt.rmw_ratio)))(
+        "upsert_ratio", "Ratio of upsert (insert-or-overwrite) operations",
+        cxxopts::value<float>()->default_value(
+            std::to_string(opt.upsert_ratio)))(
+        "hash_fn",
+        "Hash stage to plug into the tables (standard,murmur2,jenkins,xxhash,"
+        "wyhash,crc)",
+        cxxopts::value<std::string>()->default_value(opt.hash_fn))(
+        "dep_ratio",
+        "Probability an operation reuses the previous operation's key",
+        cxxopts::value<float>()->default_value(std::to_string(opt.dep_ratio)))(
+        "think_ns", "Think time in nanoseconds spun between operations",
+        cxxopts::value<uint32_t>()->default_value(
+            std::to_string(opt.think_ns)))(
+        "churn_ratio",
+        "Fraction of operations replaced by sliding-window insert/remove "
+        "pairs (constant cardinality churn)",
+        cxxopts::value<float>()->default_value(
+            std::to_string(opt.churn_ratio)))(
+        "churn_window", "Live churned keys maintained per worker slice",
+        cxxopts::value<uint32_t>()->default_value(
+            std::to_string(opt.churn_window)))(
+        "arrival_rate",
+        "Open-loop offered load in ops/s per thread (0 = closed loop)",
+        cxxopts::value<uint64_t>()->default_value(
+            std::to_string(opt.arrival_rate)))(
+        "hotspot_drift",
+        "Keyspace rotations the hot set makes over the run (skewed "
+        "distributions)",
+        cxxopts::value<float>()->default_value(
+            std::to_string(opt.hotspot_drift)))(
         "skip_load", "Skip the load phase",
         cxxopts::value<bool>()->default_value(
             (opt.skip_load ? "true" : "false")))(
+        "bulk_load", "Load through hash_api::bulk_load instead of inserts",
+        cxxopts::value<bool>()->default_value(
+            (opt.use_bulk_load ? "true" : "false")))(
         "distribution", "Key distribution to use",
-        cxxopts::value<std::string>()->default_value("UNIFORM"))("help",
-                                                                 "Print help");
+        cxxopts::value<std::string>()->default_value("UNIFORM"))(
+        "record", "Dump the generated workload to a binary trace file",
+        cxxopts::value<std::string>())(
+        "replay", "Replay a binary trace file instead of generating",
+        cxxopts::value<std::string>())(
+        "save-pool",
+        "Preserve the loaded pool image plus manifest at this path",
+        cxxopts::value<std::string>())(
+        "from-pool",
+        "Attach a copy of a saved pool image, skipping load when its "
+        "manifest matches",
+        cxxopts::value<std::string>())(
+        "calibrate",
+        "Probe flush/fence latencies and PM bandwidth before the run",
+        cxxopts::value<bool>()->default_value(
+            (opt.calibrate ? "true" : "false")))(
+        "auto_tune",
+        "Hill-climb the batch/interleave width in calibration bursts "
+        "before the run",
+        cxxopts::value<bool>()->default_value(
+            (opt.auto_tune ? "true" : "false")))(
+        "perf_sample",
+        "Bracket one operation in N with hardware counter reads and "
+        "attribute LLC/dTLB misses and stalls per op type (0 = off)",
+        cxxopts::value<uint32_t>()->default_value(
+            std::to_string(opt.perf_sample)))(
+        "verify",
+        "Store values as a keyed checksum of their key and validate "
+        "every successful read inline",
+        cxxopts::value<bool>()->default_value(
+            (opt.verify ? "true" : "false")))(
+        "format", "Results format [text | json]",
+        cxxopts::value<std::string>()->default_value(opt.format))(
+        "results", "Destination file of the JSON results stream",
+        cxxopts::value<std::string>()->default_value(opt.result_file))(
+        "help", "Print help");
 
     options.parse_positional({"input"});
 
@@ -82,6 +426,11 @@ int main(int argc, char **argv)
       opt.skip_load = result["skip_load"].as<bool>();
     }
 
+    if (result.count("bulk_load"))
+    {
+      opt.use_bulk_load = result["bulk_load"].as<bool>();
+    }
+
     if (result.count("latency_sampling"))
     {
       opt.latency_sampling = result["latency_sampling"].as<float>();
@@ -110,10 +459,135 @@ int main(int argc, char **argv)
     if (result.count("threads"))
       opt.num_threads = result["threads"].as<uint32_t>();
 
+    // Parse "batch_size"
+    if (result.count("batch"))
+      opt.batch_size = result["batch"].as<uint32_t>();
+
+    // Parse "thread-sweep": load once, run at each listed concurrency.
+    // The pool and load phase are sized for the largest sweep point.
+    if (result.count("thread-sweep"))
+    {
+      std::stringstream sweep(result["thread-sweep"].as<std::string>());
+      std::string tok;
+      while (std::getline(sweep, tok, ','))
+      {
+        auto n = std::strtoul(tok.c_str(), nullptr, 10);
+        if (n < 1)
+        {
+          std::cout << "Invalid thread-sweep entry: " << tok << std::endl;
+          exit(1);
+        }
+        opt.thread_sweep.push_back(n);
+        opt.num_threads = std::max<uint32_t>(opt.num_threads, n);
+      }
+    }
+
+    // Parse "processes"
+    if (result.count("processes"))
+      opt.num_processes = result["processes"].as<uint32_t>();
+
+    // Parse "crash-points"
+    if (result.count("crash-points"))
+    {
+      std::stringstream ss(result["crash-points"].as<std::string>());
+      std::string tok;
+      while (std::getline(ss, tok, ','))
+      {
+        auto n = std::strtoull(tok.c_str(), nullptr, 10);
+        if (n < 1)
+        {
+          std::cout << "Invalid crash-points entry: " << tok << std::endl;
+          exit(1);
+        }
+        opt.crash_points.push_back(n);
+      }
+    }
+
+    // Parse "value_sizes": weighted size distribution; value_size
+    // becomes the maximum so buffers and the tree are sized for it.
+    if (result.count("value_sizes"))
+    {
+      std::stringstream ss(result["value_sizes"].as<std::string>());
+      std::string tok;
+      uint32_t max_size = 0;
+      while (std::getline(ss, tok, ','))
+      {
+        auto colon = tok.find(':');
+        if (colon == std::string::npos)
+        {
+          std::cout << "Invalid value_sizes entry: " << tok << std::endl;
+          exit(1);
+        }
+        uint32_t sz = std::strtoul(tok.c_str(), nullptr, 10);
+        float w = std::strtof(tok.c_str() + colon + 1, nullptr);
+        if (sz < 1 || w <= 0.0)
+        {
+          std::cout << "Invalid value_sizes entry: " << tok << std::endl;
+          exit(1);
+        }
+        opt.value_size_dist.emplace_back(sz, w);
+        max_size = std::max(max_size, sz);
+      }
+      opt.value_size = max_size;
+    }
+
+    // Parse "timeline"
+    if (result.count("timeline"))
+      opt.timeline_file = result["timeline"].as<std::string>();
+
+    // Parse "affinity"
+    if (result.count("affinity"))
+      opt.affinity = result["affinity"].as<std::string>();
+
+    // Parse "record" / "replay"
+    if (result.count("record"))
+      opt.record_file = result["record"].as<std::string>();
+
+    if (result.count("replay"))
+      opt.replay_file = result["replay"].as<std::string>();
+
+    if (result.count("save-pool"))
+      opt.save_pool = result["save-pool"].as<std::string>();
+
+    if (result.count("from-pool"))
+      opt.from_pool = result["from-pool"].as<std::string>();
+
+    if (result.count("calibrate"))
+      opt.calibrate = result["calibrate"].as<bool>();
+
+    if (result.count("auto_tune"))
+      opt.auto_tune = result["auto_tune"].as<bool>();
+
+    if (result.count("perf_sample"))
+      opt.perf_sample = result["perf_sample"].as<uint32_t>();
+
+    if (result.count("verify"))
+      opt.verify = result["verify"].as<bool>();
+
+    if (result.count("format"))
+    {
+      opt.format = result["format"].as<std::string>();
+      if (opt.format != "text" && opt.format != "json")
+      {
+        std::cout << "Results format must be one of [text | json], but is "
+                  << opt.format << std::endl;
+        exit(1);
+      }
+    }
+
+    if (result.count("results"))
+      opt.result_file = result["results"].as<std::string>();
+
     // Parse "sampling_ms"
     if (result.count("sampling_ms"))
       opt.sampling_ms = result["sampling_ms"].as<uint32_t>();
 
+    if (result.count("warmup_ms"))
+      opt.warmup_max_ms = result["warmup_ms"].as<uint32_t>();
+
+    if (result.count("straggler_ms"))
+      opt.straggler_ms = result["straggler_ms"].as<uint32_t>();
+
     // Parse "key_prefix"
     if (result.count("key_prefix"))
       opt.key_prefix = result["key_prefix"].as<std::string>();
@@ -142,6 +616,33 @@ int main(int argc, char **argv)
     if (result.count("scan_ratio"))
       opt.scan_ratio = result["scan_ratio"].as<float>();
 
+    if (result.count("rmw_ratio"))
+      opt.rmw_ratio = result["rmw_ratio"].as<float>();
+
+    if (result.count("upsert_ratio"))
+      opt.upsert_ratio = result["upsert_ratio"].as<float>();
+
+    if (result.count("hash_fn"))
+      opt.hash_fn = result["hash_fn"].as<std::string>();
+
+    if (result.count("dep_ratio"))
+      opt.dep_ratio = result["dep_ratio"].as<float>();
+
+    if (result.count("think_ns"))
+      opt.think_ns = result["think_ns"].as<uint32_t>();
+
+    if (result.count("churn_ratio"))
+      opt.churn_ratio = result["churn_ratio"].as<float>();
+
+    if (result.count("churn_window"))
+      opt.churn_window = result["churn_window"].as<uint32_t>();
+
+    if (result.count("arrival_rate"))
+      opt.arrival_rate = result["arrival_rate"].as<uint64_t>();
+
+    if (result.count("hotspot_drift"))
+      opt.hotspot_drift = result["hotspot_drift"].as<float>();
+
     // Parse 'scan_size'.
     if (result.count("scan_size"))
       opt.scan_size = result["scan_size"].as<uint32_t>();
@@ -212,13 +713,21 @@ int main(int argc, char **argv)
   }
 
   auto sum = opt.read_ratio + opt.insert_ratio + opt.update_ratio +
-             opt.remove_ratio + opt.scan_ratio + opt.resize_ratio;
+             opt.remove_ratio + opt.scan_ratio + opt.resize_ratio +
+             opt.rmw_ratio + opt.upsert_ratio;
   if (sum != 1.0)
   {
     std::cout << "Sum of ratios should be 1.0 but is " << sum << std::endl;
     exit(1);
   }
 
+  if (opt.dep_ratio < 0.0 || opt.dep_ratio >= 1.0)
+  {
+    std::cout << "Key dependency ratio must be in [0.0, 1.0) but is "
+              << opt.dep_ratio << std::endl;
+    exit(1);
+  }
+
   if (opt.scan_size < 1 || opt.scan_size > benchmark_t::MAX_SCAN)
   {
     std::cout << "Scan size must be in the range [1,"
@@ -241,6 +750,36 @@ int main(int argc, char **argv)
     exit(1);
   }
 
+  if (opt.batch_size < 1)
+  {
+    std::cout << "Batch size must be at least 1." << std::endl;
+    exit(1);
+  }
+
+  if (!opt.record_file.empty() && !opt.replay_file.empty())
+  {
+    std::cout << "--record and --replay are mutually exclusive." << std::endl;
+    exit(1);
+  }
+
+  // A trace fixes the workload shape: take op count and key/value sizes
+  // from its header so the run matches the recording.
+  if (!opt.replay_file.empty())
+  {
+    std::ifstream trace(opt.replay_file, std::ifstream::binary);
+    PiBench::trace_header_t header;
+    if (!trace.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        header.magic != PiBench::trace_header_t::MAGIC ||
+        header.version != PiBench::trace_header_t::VERSION)
+    {
+      std::cout << "Invalid trace file: " << opt.replay_file << std::endl;
+      exit(1);
+    }
+    opt.num_ops = header.num_ops;
+    opt.key_size = header.key_size;
+    opt.value_size = header.value_size;
+  }
+
   if ((opt.latency_sampling < 0.0 || opt.latency_sampling > 1.0))
   {
     std::cout << "Latency sampling must be in the range [0.0 , 1.0]."
@@ -273,15 +812,153 @@ int main(int argc, char **argv)
     opt.latency = true;
   }
   print_environment();
+  if (opt.calibrate)
+  {
+    // Stamp primitive costs into the header before anything touches
+    // the pool, so cross-machine comparisons can normalize by them.
+    auto fields = run_calibration(tree_opt.pool_path);
+    if (opt.format == "json")
+    {
+      std::ofstream rf(opt.result_file, std::ofstream::app);
+      if (rf.is_open())
+        rf << "{" << fields << "}\n";
+    }
+  }
   std::cout << opt << std::endl;
 
   tree_opt.key_size = opt.key_prefix.size() + opt.key_size;
   tree_opt.value_size = opt.value_size;
   tree_opt.num_threads = opt.num_threads;
+  tree_opt.hash_fn = opt.hash_fn;
+
+  // Pre-loaded pool images. Attaching copies the saved image over
+  // pool_path before the library opens it, so the library sees an
+  // already-loaded pool and the load phase is skipped; the image file
+  // itself is never opened by a table and stays reusable. Restricted
+  // to the single-library, single-process path: the other modes
+  // orchestrate their own pools.
+  bool attached_pool = false;
+  if (!opt.from_pool.empty() || !opt.save_pool.empty())
+  {
+    if (tree_opt.pool_path.empty())
+    {
+      std::cout << "--save-pool/--from-pool require an explicit pool_path "
+                << "(libraries with internal fixed paths cannot attach)."
+                << std::endl;
+      exit(1);
+    }
+    if (!opt.crash_points.empty() || opt.num_processes > 1 ||
+        opt.library_file.find(',') != std::string::npos)
+    {
+      std::cout << "--save-pool/--from-pool only apply to single-library, "
+                << "single-process runs." << std::endl;
+      exit(1);
+    }
+  }
+  if (!opt.from_pool.empty())
+  {
+    std::ifstream mf(opt.from_pool + ".manifest");
+    std::stringstream saved;
+    saved << mf.rdbuf();
+    if (mf.is_open() && saved.str() == pool_manifest(opt, tree_opt))
+    {
+      if (!copy_pool_image(opt.from_pool, tree_opt.pool_path))
+      {
+        std::cout << "Error copying pool image " << opt.from_pool << " to "
+                  << tree_opt.pool_path << std::endl;
+        exit(1);
+      }
+      opt.skip_load = true;
+      attached_pool = true;
+      std::cout << "Attached pool image " << opt.from_pool
+                << " (load phase skipped)" << std::endl;
+    }
+    else
+    {
+      std::cout << "Pool image manifest missing or mismatched; loading from "
+                << "scratch." << std::endl;
+    }
+  }
+
+  if (!opt.crash_points.empty())
+  {
+    // Crash mode orchestrates its own child processes; the parent must
+    // not touch the pool first.
+    run_crash_recovery(opt, tree_opt);
+    return 0;
+  }
 
+  if (opt.num_processes > 1)
+  {
+    // Likewise: the workers create/attach to the pool themselves.
+    run_multiprocess(opt, tree_opt);
+    return 0;
+  }
+
+  // Comma-separated library paths run an A/B comparison: the workload
+  // is generated once and every library executes the identical stream
+  // in sequence, each against a fresh pool.
+  std::vector<std::string> libs;
+  {
+    std::stringstream ss(opt.library_file);
+    std::string tok;
+    while (std::getline(ss, tok, ','))
+      if (!tok.empty())
+        libs.push_back(tok);
+  }
+  if (libs.size() > 1)
+  {
+    std::unique_ptr<benchmark_t> bench;
+    // Keep every library mapped until the end; the benchmark holds
+    // pointers into whichever one ran last.
+    std::vector<std::unique_ptr<library_loader_t>> loaded;
+    std::vector<std::pair<std::string, float>> summary;
+    auto base_pool = tree_opt.pool_path;
+    for (size_t li = 0; li < libs.size(); ++li)
+    {
+      auto per_lib_opt = tree_opt;
+      if (!base_pool.empty())
+        per_lib_opt.pool_path = base_pool + "_" + std::to_string(li);
+      std::cout << "\n=== " << libs[li] << " ===" << std::endl;
+      loaded.emplace_back(new library_loader_t(libs[li]));
+      hash_api *t =
+          loaded.back()->create_tree(per_lib_opt, opt.hash_size,
+                                     opt.num_threads);
+      if (t == nullptr)
+      {
+        std::cout << "Error instantiating tree." << std::endl;
+        exit(1);
+      }
+      // Under the static-dispatch build comparison mode only makes
+      // sense against the linked-in table; the cast is a no-op in the
+      // regular build.
+      if (!bench)
+        bench = std::make_unique<benchmark_t>(static_cast<tree_t *>(t), opt);
+      else
+        bench->set_tree(static_cast<tree_t *>(t));
+      bench->load();
+      bench->run();
+      summary.emplace_back(libs[li], bench->last_mops());
+    }
+    std::cout << "\nComparison (identical workload stream):" << std::endl;
+    for (auto &s : summary)
+      std::cout << "\t" << s.first << ": " << s.second << " Mops/s"
+                << std::endl;
+    return 0;
+  }
+
+#ifdef PIBENCH_STATIC_TREE
+  // Static-dispatch build: the table is linked in, so skip dlopen and
+  // hand benchmark_t the concrete type (see benchmark.hpp).
+  std::cerr << "Initializing (static dispatch)..." << std::endl;
+  tree_t *tree =
+      static_cast<tree_t *>(::create_tree(tree_opt, opt.hash_size,
+                                          opt.num_threads));
+#else
   library_loader_t lib(opt.library_file);
   std::cerr << "Initializing..." << std::endl;
   hash_api *tree = lib.create_tree(tree_opt, opt.hash_size, opt.num_threads);
+#endif
   if (tree == nullptr)
   {
     std::cout << "Error instantiating tree." << std::endl;
@@ -289,8 +966,32 @@ int main(int argc, char **argv)
   }
   // std::cerr << "Successful! " << std::endl;
   // sleep(10);
+  // An attached image is a pool that was not closed by this process;
+  // run the library's recovery before traffic, as a reopen would.
+  if (attached_pool)
+    tree->recovery();
   benchmark_t bench(tree, opt);
   bench.load();
+  if (!opt.save_pool.empty() && !attached_pool)
+  {
+    // Preserve the freshly loaded pool plus the manifest that makes it
+    // reusable; the copy runs after load() returns, when every insert
+    // has been flushed and fenced.
+    if (copy_pool_image(tree_opt.pool_path, opt.save_pool))
+    {
+      std::ofstream mf(opt.save_pool + ".manifest", std::ofstream::trunc);
+      mf << pool_manifest(opt, tree_opt);
+      std::cout << "Saved pool image to " << opt.save_pool << std::endl;
+    }
+    else
+      std::cout << "Error saving pool image to " << opt.save_pool
+                << std::endl;
+  }
+  // Tune against the loaded table so the bursts see the same probe
+  // costs the run will; the chosen width lands in the output ahead of
+  // the run figures and in the auto_tune result event.
+  if (opt.auto_tune)
+    bench.auto_tune();
   bench.run();
   return 0;
 }
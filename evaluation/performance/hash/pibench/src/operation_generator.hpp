@@ -7,7 +7,21 @@
 
 namespace PiBench {
 
-enum class operation_t : uint8_t { READ = 0, INSERT = 1, REMOVE = 2 };
+/// RMW is a composite find+update pair on the same key; NUM_OPS counts
+/// the distinct operation types for sizing per-op stats.
+enum class operation_t : uint8_t {
+  READ = 0,
+  INSERT = 1,
+  REMOVE = 2,
+  RMW = 3,
+  UPSERT = 4
+};
+constexpr unsigned NUM_OPS = 5;
+
+/// Bit set on a trace operation byte when the operation reuses the
+/// previous operation's key instead of its own (key-dependency chain).
+/// The low bits still hold the operation_t.
+constexpr uint8_t OP_DEP_FLAG = 0x80;
 
 class operation_generator_t {
  public:
@@ -16,13 +30,15 @@ class operation_generator_t {
    *
    * @param read ratio of read operations.
    * @param insert ratio of insert operations.
-   * @param update ratio of update operations.
    * @param remove ratio of remove operations.
-   * @param scan ratio of scan operations.
+   * @param rmw ratio of read-modify-write (find+update) operations.
+   * @param upsert ratio of insert-or-overwrite operations.
    */
-  operation_generator_t(float read, float insert, float remove) {
+  operation_generator_t(float read, float insert, float remove,
+                        float rmw = 0.0, float upsert = 0.0) {
     std::default_random_engine gen;
-    std::discrete_distribution<uint32_t> op_weights({read, insert, remove});
+    std::discrete_distribution<uint32_t> op_weights(
+        {read, insert, remove, rmw, upsert});
 
     for (unsigned int i = 0; i < ops_.size(); ++i) {
       ops_[i] = static_cast<operation_t>(op_weights(gen));
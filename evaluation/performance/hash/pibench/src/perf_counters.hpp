@@ -0,0 +1,292 @@
+#ifndef __PERF_COUNTERS_HPP__
+#define __PERF_COUNTERS_HPP__
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace PiBench
+{
+
+inline int perf_open_event(uint32_t type, uint64_t config, int pid, int cpu,
+                           bool inherit)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 0;
+    attr.inherit = inherit ? 1 : 0;
+    attr.exclude_kernel = 0;
+    attr.exclude_hv = 1;
+    return static_cast<int>(
+        syscall(__NR_perf_event_open, &attr, pid, cpu, -1, 0));
+}
+
+inline uint64_t perf_read_counter(int fd) noexcept
+{
+    uint64_t v = 0;
+    if (read(fd, &v, sizeof(v)) != sizeof(v))
+        return 0;
+    return v;
+}
+
+/**
+ * @brief perf_event_open-based fallback for the vendored PCM.
+ *
+ * PCM programs the PMU through /dev/cpu/msr, which containerized
+ * runners do not expose, so counter-based metrics silently vanish
+ * there. This provider covers the subset pcm_end() reports through the
+ * kernel's perf interface instead: cycles, LLC misses and dTLB misses
+ * are opened per process with inherit set (so workers spawned later are
+ * aggregated on read), and memory bandwidth comes from the uncore IMC
+ * cas_count events discovered under /sys/bus/event_source — those are
+ * system-wide and may be refused under perf_event_paranoid >= 1, in
+ * which case they are skipped and only the core events report.
+ *
+ * Usage mirrors the PCM bracket: begin() snapshots, end() returns the
+ * delta since the last begin().
+ */
+class perf_counters_t
+{
+public:
+    struct sample_t
+    {
+        uint64_t cycles = 0;
+        uint64_t llc_misses = 0;
+        uint64_t dtlb_misses = 0;
+        uint64_t imc_read_bytes = 0;
+        uint64_t imc_write_bytes = 0;
+        bool has_imc = false;
+    };
+
+    ~perf_counters_t()
+    {
+        for (auto& c : core_)
+            close(c.fd);
+        for (auto& c : imc_)
+            close(c.fd);
+    }
+
+    /**
+     * @brief Open the counters; returns true if at least the core
+     * events are available. Must run before worker threads spawn so
+     * inheritance covers them.
+     */
+    bool open()
+    {
+        struct
+        {
+            uint32_t type;
+            uint64_t config;
+            uint64_t sample_t::*field;
+        } events[] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, &sample_t::cycles},
+            {PERF_TYPE_HW_CACHE,
+             PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+             &sample_t::llc_misses},
+            {PERF_TYPE_HW_CACHE,
+             PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+             &sample_t::dtlb_misses},
+        };
+        for (auto& e : events)
+        {
+            int fd = open_event(e.type, e.config, 0 /*this process*/, -1, true);
+            if (fd >= 0)
+                core_.push_back({fd, e.field, 0});
+        }
+        open_imc();
+        return !core_.empty();
+    }
+
+    bool active() const noexcept { return !core_.empty() || !imc_.empty(); }
+
+    void begin() noexcept
+    {
+        for (auto& c : core_)
+            c.last = read_counter(c.fd);
+        for (auto& c : imc_)
+            c.last = read_counter(c.fd);
+    }
+
+    sample_t end() noexcept
+    {
+        sample_t s;
+        for (auto& c : core_)
+            s.*(c.field) = read_counter(c.fd) - c.last;
+        for (auto& c : imc_)
+        {
+            // cas_count_* ticks once per 64B cache-line transfer.
+            s.*(c.field) += (read_counter(c.fd) - c.last) * 64;
+            s.has_imc = true;
+        }
+        return s;
+    }
+
+private:
+    struct counter_t
+    {
+        int fd;
+        uint64_t sample_t::*field;
+        uint64_t last;
+    };
+
+    static int open_event(uint32_t type, uint64_t config, int pid, int cpu,
+                          bool inherit)
+    {
+        return perf_open_event(type, config, pid, cpu, inherit);
+    }
+
+    static uint64_t read_counter(int fd) noexcept
+    {
+        return perf_read_counter(fd);
+    }
+
+    /**
+     * @brief Discover uncore IMC channels and open their cas_count
+     * read/write events (system-wide on cpu 0; uncore events count per
+     * socket, so remote-socket traffic is missed on multi-socket boxes).
+     */
+    void open_imc()
+    {
+        for (int ch = 0;; ++ch)
+        {
+            std::string dev = "/sys/bus/event_source/devices/uncore_imc_" +
+                              std::to_string(ch);
+            uint64_t type;
+            if (!read_sysfs_u64(dev + "/type", &type))
+                break;
+            struct
+            {
+                const char* name;
+                uint64_t sample_t::*field;
+            } evs[] = {{"cas_count_read", &sample_t::imc_read_bytes},
+                       {"cas_count_write", &sample_t::imc_write_bytes}};
+            for (auto& e : evs)
+            {
+                uint64_t config;
+                if (!read_event_config(dev + "/events/" + e.name, &config))
+                    continue;
+                int fd = open_event(static_cast<uint32_t>(type), config,
+                                    -1 /*system-wide*/, 0, false);
+                if (fd >= 0)
+                    imc_.push_back({fd, e.field, 0});
+            }
+        }
+    }
+
+    static bool read_sysfs_u64(const std::string& path, uint64_t* out)
+    {
+        FILE* f = fopen(path.c_str(), "r");
+        if (f == nullptr)
+            return false;
+        bool ok = fscanf(f, "%lu", out) == 1;
+        fclose(f);
+        return ok;
+    }
+
+    /// Parse an "event=0x..,umask=0x.." sysfs event description into a
+    /// raw config word.
+    static bool read_event_config(const std::string& path, uint64_t* out)
+    {
+        FILE* f = fopen(path.c_str(), "r");
+        if (f == nullptr)
+            return false;
+        char buf[256] = {0};
+        bool ok = fgets(buf, sizeof(buf), f) != nullptr;
+        fclose(f);
+        if (!ok)
+            return false;
+        uint64_t event = 0, umask = 0;
+        char* p = strstr(buf, "event=");
+        if (p == nullptr)
+            return false;
+        event = strtoull(p + 6, nullptr, 0);
+        p = strstr(buf, "umask=");
+        if (p != nullptr)
+            umask = strtoull(p + 6, nullptr, 0);
+        *out = event | (umask << 8);
+        return true;
+    }
+
+    std::vector<counter_t> core_;
+    std::vector<counter_t> imc_;
+};
+
+/**
+ * @brief Per-thread event probe for sampled per-operation attribution.
+ *
+ * Aggregate counters say how many LLC misses a run cost, not which
+ * operation type spent them. Opened with pid 0 / cpu -1 and no
+ * inheritance, each event counts just the calling thread, so a worker
+ * can bracket an individual operation with two read() calls and charge
+ * the delta to that operation's bucket. The two syscalls cost far more
+ * than the operation itself — hence sampling one op in N rather than
+ * bracketing all of them.
+ *
+ * Events that fail to open (unsupported on the part, or forbidden)
+ * simply read as zero; open() fails only when none open at all.
+ */
+class thread_event_probe_t
+{
+public:
+    enum
+    {
+        LLC = 0,
+        DTLB = 1,
+        STALL = 2,
+        N_EV = 3
+    };
+
+    ~thread_event_probe_t()
+    {
+        for (auto fd : fd_)
+            if (fd >= 0)
+                close(fd);
+    }
+
+    bool open()
+    {
+        struct
+        {
+            uint32_t type;
+            uint64_t config;
+        } events[N_EV] = {
+            {PERF_TYPE_HW_CACHE,
+             PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HW_CACHE,
+             PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+        };
+        bool any = false;
+        for (int e = 0; e < N_EV; ++e)
+        {
+            fd_[e] = perf_open_event(events[e].type, events[e].config,
+                                     0 /*this thread*/, -1, false);
+            any |= fd_[e] >= 0;
+        }
+        return any;
+    }
+
+    void read_all(uint64_t out[N_EV]) const noexcept
+    {
+        for (int e = 0; e < N_EV; ++e)
+            out[e] = fd_[e] >= 0 ? perf_read_counter(fd_[e]) : 0;
+    }
+
+private:
+    int fd_[N_EV] = {-1, -1, -1};
+};
+} // namespace PiBench
+#endif
@@ -0,0 +1,35 @@
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+#include <cstdint>
+
+namespace PiBench {
+
+/**
+ * @brief On-disk workload trace format.
+ *
+ * A trace is this header followed by num_ops fixed-size records, each a
+ * single operation byte (operation_t) immediately followed by key_size
+ * key bytes. Records are fixed size so a replay thread can index its
+ * partition directly into an mmap'ed file and pass key pointers to the
+ * table zero-copy. Values are not stored: their content is random
+ * filler, so only value_size is kept for regeneration.
+ */
+struct trace_header_t {
+  static constexpr uint32_t MAGIC = 0x50695472;  // "PiTr"
+  static constexpr uint32_t VERSION = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint64_t num_ops;
+  uint32_t key_size;
+  uint32_t value_size;
+};
+
+/// Size in bytes of one trace record for the given key size.
+inline constexpr uint64_t trace_record_size(uint32_t key_size) {
+  return 1 + key_size;
+}
+}  // namespace PiBench
+
+#endif
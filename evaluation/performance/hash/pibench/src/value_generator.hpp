@@ -2,7 +2,14 @@
 #define __VALUE_GENERATOR_HPP__
 
 #include <cstdint>
+#include <cstring>
 #include <random>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
 
 namespace PiBench
 {
@@ -21,6 +28,46 @@ public:
     {
     }
 
+    /**
+     * @brief Construct a generator drawing value sizes from a weighted
+     * distribution (e.g. bimodal 16B/512B) instead of one fixed size.
+     *
+     * @param size_dist (size, weight) pairs.
+     * @param max_size largest size in the distribution; next() always
+     *                 yields a pointer with max_size readable bytes.
+     */
+    value_generator_t(const std::vector<std::pair<uint32_t, float>>& size_dist,
+                      const uint32_t max_size)
+        : size_(max_size),
+          dist_(0, sizeof(VALUE_POOL) - max_size)
+    {
+        std::vector<float> weights;
+        for (auto& e : size_dist)
+        {
+            sizes_.push_back(e.first);
+            weights.push_back(e.second);
+        }
+        size_dist_ =
+            std::discrete_distribution<uint32_t>(weights.begin(), weights.end());
+    }
+
+    /**
+     * @brief Draw the size class of the next value.
+     *
+     * @return uint32_t index into size_classes(); always 0 when the
+     *         generator was built with a fixed size.
+     */
+    uint32_t next_size_class()
+    {
+        return sizes_.empty() ? 0 : size_dist_(gen_);
+    }
+
+    /// Distinct value sizes drawn from; empty for fixed-size generators.
+    const std::vector<uint32_t>& size_classes() const noexcept
+    {
+        return sizes_;
+    }
+
     /**
      * @brief Returns a pointer to beginning of value.
      *
@@ -62,6 +109,67 @@ public:
      */
     static uint32_t get_seed() noexcept { return seed_; }
 
+    /**
+     * @brief Keyed checksum word of a key (--verify mode).
+     *
+     * The value stored under a key is this word repeated, so duplicate
+     * inserts of the same key write identical bytes and any read can be
+     * validated without knowing which record stored the value. Uses the
+     * SSE4.2 CRC32 instruction where available (a couple of ns for the
+     * usual key sizes), a FNV fold otherwise.
+     */
+    static uint64_t checksum_word(const char* key, uint32_t key_size)
+    {
+        uint64_t crc = 0x9e3779b97f4a7c15ULL; // salt: keyed, not plain CRC
+#ifdef __SSE4_2__
+        uint32_t i = 0;
+        for (; i + 8 <= key_size; i += 8)
+        {
+            uint64_t w;
+            memcpy(&w, key + i, 8);
+            crc = _mm_crc32_u64(crc, w);
+        }
+        for (; i < key_size; ++i)
+            crc = _mm_crc32_u8(static_cast<uint32_t>(crc),
+                               static_cast<uint8_t>(key[i]));
+#else
+        for (uint32_t i = 0; i < key_size; ++i)
+            crc = (crc ^ static_cast<uint8_t>(key[i])) * 0x100000001b3ULL;
+#endif
+        // CRC32 leaves the top half zero; spread it so every byte of
+        // the value carries entropy.
+        return crc * 0x2545f4914f6cdd1dULL;
+    }
+
+    /// Materialize the checksum value for a key: checksum_word splatted
+    /// across size bytes (partial word at the tail).
+    static void fill_checksum(const char* key, uint32_t key_size, char* out,
+                              uint32_t size)
+    {
+        uint64_t w = checksum_word(key, key_size);
+        uint32_t o = 0;
+        for (; o + 8 <= size; o += 8)
+            memcpy(out + o, &w, 8);
+        if (o < size)
+            memcpy(out + o, &w, size - o);
+    }
+
+    /// Check that a read-back value is the checksum value of its key.
+    static bool verify_checksum(const char* key, uint32_t key_size,
+                                const char* value, uint32_t size)
+    {
+        uint64_t w = checksum_word(key, key_size);
+        uint32_t o = 0;
+        for (; o + 8 <= size; o += 8)
+        {
+            uint64_t v;
+            memcpy(&v, value + o, 8);
+            if (v != w)
+                return false;
+        }
+        return o >= size || memcmp(value + o, &w, size - o) == 0;
+    }
+
     /// Maximum size in Bytes of supported.
     static constexpr uint32_t VALUE_MAX = 1400;
 
@@ -78,6 +186,12 @@ private:
     /// Distribution used for generating a random start position in VALUE_POOL.
     std::uniform_int_distribution<> dist_;
 
+    /// Distinct value sizes when distribution-driven (empty otherwise).
+    std::vector<uint32_t> sizes_;
+
+    /// Weighted choice over sizes_.
+    std::discrete_distribution<uint32_t> size_dist_;
+
     /// Pool of random bytes used to generate values.
     static constexpr char VALUE_POOL[] =
         "NvhE8N7yR26f4bbpMJnUKgHncH6QbsI10HyxlvYHKFiMk5nPNDbueF2xKLzteSd0NazU2APkJWXvBW2oUu8dkZnWMMu37G8TH2qm"
@@ -9,20 +9,41 @@
 #ifndef RECOVERABLE_LINKED_LIST_TRACKING_H_
 #define RECOVERABLE_LINKED_LIST_TRACKING_H_
 
+#include <cstdlib>
+#include <new>
+
 #include "Utilities.h"
 
+#ifndef PROFILING_SAMPLE_PERIOD
+#define PROFILING_SAMPLE_PERIOD 64		// 1-in-N ops get latency/retry detail; power of two
+#endif
+
 template <class T> class RecoverableLinkedListTracking{
 
 	private:
 		enum {FALSE_RESULT, TRUE_RESULT, BOT_RESULT=-1};
 		enum OpType {INSERT_OP_TYPE, DELETE_OP_TYPE, FIND_OP_TYPE};
+		enum {INDEX_GAP = 64};					// keys covered by one jump-pointer bucket
+		enum {BACKOFF_MIN = 2, BACKOFF_MAX = 1024};		// pause-loop bounds for contended retries
+		enum {MAX_HELPERS = 2, HELP_SPIN_BOUND = 4096};	// concurrent helpers per Info record
+		enum {RECOVERY_WORKERS = 8, RECOVERY_SEG = 4096};	// parallel recovery scan: workers, nodes per segment
 
 	public:
 		class Info;
 
 #if defined(PROFILING)
-		class OpProfiler {
-			public: 
+		// Per-thread profiler. Each thread owns one cache-line-aligned
+		// instance (alignas also rounds its size up to a line multiple,
+		// so neighbouring thread-local data never shares its lines) and
+		// only ever writes its own, so the always-on counters cost a
+		// thread-private increment, never coherence traffic. Latency
+		// and retry detail, which would need two TSC reads per op, is
+		// only recorded for one op in PROFILING_SAMPLE_PERIOD.
+		// Instances register themselves on construction, so Snapshot()
+		// can aggregate a cross-thread view at any time without the
+		// threads publishing anything.
+		class alignas(CACHE_LINE_SIZE) OpProfiler {
+			public:
 				unsigned long numNodesAccessedTmp;
 				unsigned long numNodesAccessedDuringSearches;
 				unsigned long numInsertOps;
@@ -45,7 +66,12 @@ template <class T> class RecoverableLinkedListTracking{
 				unsigned long numPsync;	
 				unsigned long numPwbHelp;
 				unsigned long numBarrierHelp;
-				unsigned long numPsyncHelp;			
+				unsigned long numPsyncHelp;
+				unsigned long sampleTick;			// ops seen since the last sample
+				unsigned long numSampledOps;
+				unsigned long sampledCycles;		// summed op latency of the samples
+				unsigned long sampledCyclesMax;
+				unsigned long sampledRetries;		// summed extra attempts of the samples
 
 				OpProfiler() {
 					numNodesAccessedTmp = 0;
@@ -71,11 +97,96 @@ template <class T> class RecoverableLinkedListTracking{
 					numPwbHelp = 0;
 					numBarrierHelp = 0;
 					numPsyncHelp = 0;
+					sampleTick = 0;
+					numSampledOps = 0;
+					sampledCycles = 0;
+					sampledCyclesMax = 0;
+					sampledRetries = 0;
+					registered = false;
+				}
+
+				// True for one op in PROFILING_SAMPLE_PERIOD (a power
+				// of two); the ops record TSC latency and retry detail
+				// only when it fires. Registration is lazy -- on the
+				// first op, not in the constructor -- so snapshot
+				// accumulators never enter the registry themselves.
+				inline bool SampleThisOp() {
+					if (!registered) {
+						registered = true;
+						int slot = __sync_fetch_and_add(&numRegistered, 1);
+						if (slot < MAX_THREADS) {
+							registry[slot] = this;
+						}
+					}
+					return ((++sampleTick) & (PROFILING_SAMPLE_PERIOD - 1)) == 0;
+				}
+
+				inline unsigned long SampleClock() {
+					return __builtin_ia32_rdtsc();
+				}
+
+				inline void RecordSample(unsigned long cycles, unsigned long retries) {
+					numSampledOps++;
+					sampledCycles += cycles;
+					if (cycles > sampledCyclesMax) {
+						sampledCyclesMax = cycles;
+					}
+					sampledRetries += retries;
+				}
+
+				// Sums every registered per-thread profiler into `out`.
+				// Reads race with the owners' increments, so a
+				// mid-run snapshot is approximate (fields may be a few
+				// ops apart); after the threads join it is exact.
+				static void Snapshot(OpProfiler &out) {
+					int n = numRegistered < MAX_THREADS ? numRegistered : MAX_THREADS;
+					for (int i = 0; i < n; i++) {
+						OpProfiler* p = registry[i];
+						if (p != NULL) {
+							p->AddTo(out);
+						}
+					}
+				}
+
+			private:
+				static OpProfiler* volatile registry[MAX_THREADS];
+				static volatile int numRegistered;
+				bool registered;
+
+				void AddTo(OpProfiler &out) const {
+					out.numNodesAccessedDuringSearches += numNodesAccessedDuringSearches;
+					out.numInsertOps += numInsertOps;
+					out.numInsertAttempts += numInsertAttempts;
+					out.numNodesAccessedDuringInserts += numNodesAccessedDuringInserts;
+					out.numDeleteOps += numDeleteOps;
+					out.numDeleteAttempts += numDeleteAttempts;
+					out.numNodesAccessedDuringDeletes += numNodesAccessedDuringDeletes;
+					out.numFindOps += numFindOps;
+					out.numFindAttempts += numFindAttempts;
+					out.numNodesAccessedDuringFinds += numNodesAccessedDuringFinds;
+					out.numSearchBarrier1 += numSearchBarrier1;
+					out.numSearchBarrier2 += numSearchBarrier2;
+					out.numFindBarrier += numFindBarrier;
+					out.numPwb += numPwb;
+					out.numPwbLow += numPwbLow;
+					out.numPwbMedium += numPwbMedium;
+					out.numPwbHigh += numPwbHigh;
+					out.numBarrier += numBarrier;
+					out.numPsync += numPsync;
+					out.numPwbHelp += numPwbHelp;
+					out.numBarrierHelp += numBarrierHelp;
+					out.numPsyncHelp += numPsyncHelp;
+					out.numSampledOps += numSampledOps;
+					out.sampledCycles += sampledCycles;
+					if (sampledCyclesMax > out.sampledCyclesMax) {
+						out.sampledCyclesMax = sampledCyclesMax;
+					}
+					out.sampledRetries += sampledRetries;
 				}
 		};
 
-		static thread_local OpProfiler prof;	
-#endif	
+		static thread_local OpProfiler prof;
+#endif
 
 		//====================Start Node Class==========================//
 		class Node {
@@ -101,6 +212,47 @@ template <class T> class RecoverableLinkedListTracking{
 				}
 		};
 		//====================End Node Class==========================//
+		//====================Start NodePool Class==========================//
+		// Per-thread slab allocator for Nodes. Global new scatters adjacent
+		// list nodes across the heap, so every traversal hop was a cache
+		// miss; carving nodes sequentially out of cache-line-aligned slabs
+		// keeps nodes allocated together (which tend to be list-adjacent,
+		// e.g. an inserted node and its copied successor) on shared cache
+		// lines. Nodes are never handed back: helpers may hold references to
+		// an unlinked node indefinitely and the protocol relies on its
+		// marked info word staying intact, so reuse would reintroduce ABA --
+		// the original allocator never freed nodes either.
+		class NodePool {
+			public:
+				enum {SLAB_NODES = 512};
+
+				NodePool() {
+					slab = NULL;
+					used = SLAB_NODES;
+				}
+
+				Node* Alloc() {
+					if (used == SLAB_NODES) {
+						slab = (Node*) aligned_alloc(CACHE_LINE_SIZE, SLAB_NODES*sizeof(Node));
+						used = 0;
+					}
+
+					return new (&slab[used++]) Node();
+				}
+
+				Node* Alloc(T val, Node* nx) {
+					Node* nd = Alloc();
+					nd->value = val;
+					nd->next = nx;
+
+					return nd;
+				}
+
+			private:
+				Node* slab;
+				int used;
+		};
+		//====================End NodePool Class==========================//
 		//====================Start Info Class==========================//
 		class Info {
 			public:
@@ -109,8 +261,9 @@ template <class T> class RecoverableLinkedListTracking{
 				Node* new_nd;
 				Info* pred_info;
 				Info* curr_info;
-				T result;
+				volatile T result;
 				OpType op_type;
+				volatile int helpers;				// transient: helpers currently inside HelpOp
 
 				Info() {
 					pred = NULL;
@@ -118,6 +271,7 @@ template <class T> class RecoverableLinkedListTracking{
 					new_nd = NULL;
 					curr_info = NULL;
 					result = BOT_RESULT;
+					helpers = 0;
 				}
 		};
 		//====================End Info Class==========================//
@@ -167,7 +321,14 @@ template <class T> class RecoverableLinkedListTracking{
             
             head = dummy1;
             MANUAL(PWB(&head);)
-            MANUAL(PSYNC();)				
+            MANUAL(PSYNC();)
+
+            // The jump-pointer index is transient: it lives in DRAM, is never
+            // flushed, and is rebuilt from the list itself after a crash.
+            jumpIndex = new Node* volatile [KEY_RANGE/INDEX_GAP + 1];
+            for (int b = 0; b <= KEY_RANGE/INDEX_GAP; b++) {
+                jumpIndex[b] = NULL;
+            }
 		}
 
 		//---------------------------------
@@ -175,7 +336,7 @@ template <class T> class RecoverableLinkedListTracking{
 			Node* curr;
 			Node* predpred;
     		*pred = NULL;
-		    curr = head;
+		    curr = IndexLookup(search_value);
 		    *curr_info = curr->info;
 														#if defined(PROFILING)
 														prof.numNodesAccessedTmp = 1;
@@ -191,16 +352,66 @@ template <class T> class RecoverableLinkedListTracking{
 														#endif		    	
 		    }
 
+		    IndexPublish(*pred);
 		    return curr;
 		}
 
+		//---------------------------------
+		// Rebuilds the transient jump-pointer index with a single scan of the
+		// list. Must be called after recovery (the index is not persisted);
+		// initialize() also uses it to warm the index up-front.
+		void RebuildIndex() {
+			for (int b = 0; b <= KEY_RANGE/INDEX_GAP; b++) {
+				jumpIndex[b] = NULL;
+			}
+
+			Node* curr = head->next;
+			while (curr->value != INT_MAX) {
+				if (is_marked_reference(curr->info) == false) {
+					IndexPublish(curr);
+				}
+				curr = curr->next;
+			}
+		}
+
+		//---------------------------------
+		// Parallel recovery pass. The list cannot be split by key up
+		// front -- without the (transient, lost) index the only way into
+		// its middle is through next pointers -- so one skim thread
+		// chases next pointers only, publishing every RECOVERY_SEG-th
+		// node as a segment boundary, while nr_workers threads consume
+		// finished segments behind it and do the per-node work:
+		// completing any operation left pending at the crash (a marked
+		// info word) via HelpOp and republishing the node into the
+		// jump-pointer index. The skim costs one dependent load per
+		// node; the validation and publication, which touch several
+		// cache lines per node, run nr_workers wide. Repairs commute
+		// with the scan: an unlinked node keeps its next pointer,
+		// segments end on a boundary *value* rather than a boundary
+		// pointer, and a missed index publication only lengthens the
+		// first Search through that bucket.
+		void RecoverParallel(int nr_workers) {
+			for (int b = 0; b <= KEY_RANGE/INDEX_GAP; b++) {
+				jumpIndex[b] = NULL;
+			}
+
+			long numNodes = 0, taggedNodes = 0;
+			RecoverScan(nr_workers, true, &numNodes, &taggedNodes);
+		}
+
 
 		//---------------------------------
 		bool Find(T search_value, int tid) {
 			Node *curr, *pred;
 			Info *curr_info, *pred_info;
+			int backoffSpins = BACKOFF_MIN;
 			Info *op_info = new Info();
 			op_info->op_type = FIND_OP_TYPE;
+														#if defined(PROFILING)
+														bool sampled = prof.SampleThisOp();
+														unsigned long sampleStart = sampled ? prof.SampleClock() : 0;
+														unsigned long sampleAttempts = prof.numFindAttempts;
+														#endif
 
 			RD[tid].RD = NULL;
 			MANUAL(PWB_LOW(&RD[tid].RD);)
@@ -224,7 +435,8 @@ template <class T> class RecoverableLinkedListTracking{
 														#endif				
 				// HELPING PHASE
 				if (is_marked_reference(curr_info) == true) {						// help the other operation
-					HelpOp(get_unmarked_reference(curr_info), true);					
+					HelpOpThrottled(get_unmarked_reference(curr_info));
+					Backoff(backoffSpins);
 					continue;
 				}
 
@@ -240,6 +452,9 @@ template <class T> class RecoverableLinkedListTracking{
 														prof.numPwbLow+=2;
 														prof.numPsync+=2;
 														#endif
+														#if defined(PROFILING)
+														if (sampled) prof.RecordSample(prof.SampleClock() - sampleStart, prof.numFindAttempts - sampleAttempts - 1);
+														#endif
 				return (op_info->result);
 			}
 		}
@@ -251,9 +466,15 @@ template <class T> class RecoverableLinkedListTracking{
 			Info *curr_info, *pred_info;
 			Node *new_curr;
 			Node *new_node;
-			
+			int backoffSpins = BACKOFF_MIN;
+
 			Info *op_info = new Info();
 			op_info->op_type = INSERT_OP_TYPE;
+														#if defined(PROFILING)
+														bool sampled = prof.SampleThisOp();
+														unsigned long sampleStart = sampled ? prof.SampleClock() : 0;
+														unsigned long sampleAttempts = prof.numInsertAttempts;
+														#endif
 
 			RD[tid].RD = NULL;															
 			MANUAL(PWB_LOW(&RD[tid].RD);)
@@ -277,10 +498,12 @@ template <class T> class RecoverableLinkedListTracking{
 														#endif			
 				// HELPING PHASE
 				if (is_marked_reference(pred_info) == true) {							// help the other operation
-					HelpOp(get_unmarked_reference(pred_info), true);													
+					HelpOpThrottled(get_unmarked_reference(pred_info));
+					Backoff(backoffSpins);
 				} 
 				else if (is_marked_reference(curr_info) == true) {						// help the other operation
-					HelpOp(get_unmarked_reference(curr_info), true);													
+					HelpOpThrottled(get_unmarked_reference(curr_info));
+					Backoff(backoffSpins);
 				}
 				// UNSUCCESSFUL INSERT
 				else if (curr->value == value) {										// value already in the list
@@ -295,17 +518,20 @@ template <class T> class RecoverableLinkedListTracking{
 														prof.numPwb+=2;
 														prof.numPwbLow+=2;
 														prof.numPsync+=2;
-														#endif			
+														#endif
+														#if defined(PROFILING)
+														if (sampled) prof.RecordSample(prof.SampleClock() - sampleStart, prof.numInsertAttempts - sampleAttempts - 1);
+														#endif
 					return false;
 				}
-				else {																	
+				else {
 					// NewSet
-					new_curr = new Node();												// make a copy for the successor of the new node
+					new_curr = nodePool.Alloc();										// make a copy for the successor of the new node
 					new_curr->value = curr->value;										// update the copy of curr
 					new_curr->next = curr->next;
 					new_curr->info = get_marked_reference(op_info);
 					MANUAL(PWB_LOW(new_curr);)
-					new_node = new Node(value, new_curr);								// new node to insert
+					new_node = nodePool.Alloc(value, new_curr);							// new node to insert
 					new_node->info = get_marked_reference(op_info);						
 					MANUAL(PWB_LOW(new_node);)
 
@@ -329,8 +555,12 @@ template <class T> class RecoverableLinkedListTracking{
 														#endif
 					HelpOp(op_info, false);
 					if (op_info->result != BOT_RESULT) {								// SUCCESSFUL INSERT
+														#if defined(PROFILING)
+														if (sampled) prof.RecordSample(prof.SampleClock() - sampleStart, prof.numInsertAttempts - sampleAttempts - 1);
+														#endif
 						return op_info->result;
 					}
+					Backoff(backoffSpins);												// our mark CAS lost; retry gently
 
 					op_info = new Info();
 					op_info->op_type = INSERT_OP_TYPE;				
@@ -342,9 +572,15 @@ template <class T> class RecoverableLinkedListTracking{
 		bool Delete(T value, int tid) {
 			Node *curr, *pred;
 			Info *curr_info, *pred_info;
-			
+			int backoffSpins = BACKOFF_MIN;
+
 			Info *op_info = new Info();
 			op_info->op_type = DELETE_OP_TYPE;
+														#if defined(PROFILING)
+														bool sampled = prof.SampleThisOp();
+														unsigned long sampleStart = sampled ? prof.SampleClock() : 0;
+														unsigned long sampleAttempts = prof.numDeleteAttempts;
+														#endif
 
 			
 			RD[tid].RD = NULL;																			
@@ -369,10 +605,12 @@ template <class T> class RecoverableLinkedListTracking{
 														#endif	
 				// HELPING PHASE
 				if (is_marked_reference(pred_info) == true) {							// help the other operation
-					HelpOp(get_unmarked_reference(pred_info), true);													
+					HelpOpThrottled(get_unmarked_reference(pred_info));
+					Backoff(backoffSpins);
 				} 
 				else if (is_marked_reference(curr_info) == true) {						// help the other operation
-					HelpOp(get_unmarked_reference(curr_info), true);													
+					HelpOpThrottled(get_unmarked_reference(curr_info));
+					Backoff(backoffSpins);
 				}
 				// UNSUCCESSFUL DELETE
 				else if (curr->value != value) {										// value already in the list
@@ -387,7 +625,10 @@ template <class T> class RecoverableLinkedListTracking{
 														prof.numPwb+=2;
 														prof.numPwbLow+=2;
 														prof.numPsync+=2;
-														#endif			
+														#endif
+														#if defined(PROFILING)
+														if (sampled) prof.RecordSample(prof.SampleClock() - sampleStart, prof.numDeleteAttempts - sampleAttempts - 1);
+														#endif
 					return false;
 				}
 				else {
@@ -409,8 +650,12 @@ template <class T> class RecoverableLinkedListTracking{
 														#endif					
 					HelpOp(op_info, false);
 					if (op_info->result != BOT_RESULT) {								// SUCCESSFUL DELETE
+														#if defined(PROFILING)
+														if (sampled) prof.RecordSample(prof.SampleClock() - sampleStart, prof.numDeleteAttempts - sampleAttempts - 1);
+														#endif
 						return op_info->result;
 					}
+					Backoff(backoffSpins);												// our mark CAS lost; retry gently
 
 					op_info = new Info();
 					op_info->op_type = DELETE_OP_TYPE;	
@@ -424,9 +669,11 @@ template <class T> class RecoverableLinkedListTracking{
 			fastRandomSetSeed(seed);
 
 			for (int i = 0; i < KEY_RANGE/2; i++) {
-		  		int value = fastRandomRange(1, KEY_RANGE);  		
+		  		int value = fastRandomRange(1, KEY_RANGE);
 		  		Insert(value, 0);
 			}
+
+			RecoverParallel(RECOVERY_WORKERS);
 		}
 
 		//---------------------------------
@@ -442,17 +689,215 @@ template <class T> class RecoverableLinkedListTracking{
 					tagedNodes++;
 				}
 
-				iterator = iterator->next;				
+				iterator = iterator->next;
 			}
 
 			printf ("Tracking - nodes: %d, tagged nodes: %d \n", numNodes, tagedNodes);
 		}
 
+		//---------------------------------
+		// Parallel variant: same segmented scan as RecoverParallel but
+		// read-only -- nothing is repaired or republished, so the
+		// counts match what the single-threaded walk would report.
+		void count_list_elements(int nr_workers) {
+			long numNodes = 0, taggedNodes = 0;
+
+			cout << "Counting of elements started!" << endl; fflush(stdout);
+
+			RecoverScan(nr_workers, false, &numNodes, &taggedNodes);
+
+			printf ("Tracking - nodes: %ld, tagged nodes: %ld \n", numNodes, taggedNodes);
+		}
+
 	private:
-		Node* volatile head CACHE_ALIGN;	char padding_head[PAD_CACHE(sizeof(Node*))];	
+		Node* volatile head CACHE_ALIGN;	char padding_head[PAD_CACHE(sizeof(Node*))];
 		TypeCP *CP CACHE_ALIGN;				char padding_CP[PAD_CACHE(sizeof(TypeCP*))];
 		TypeRD *RD CACHE_ALIGN;				char padding_RD[PAD_CACHE(sizeof(TypeRD*))];
+		Node* volatile *jumpIndex CACHE_ALIGN;	char padding_index[PAD_CACHE(sizeof(Node* volatile *))];
+
+		static thread_local NodePool nodePool;
+
+
+		// ---------------------------------
+		// Picks the furthest indexed node that is still strictly below
+		// search_value, so Search starts within ~INDEX_GAP keys of its target
+		// instead of at head. A hint whose info is marked may already be
+		// unlinked (an unlinked node keeps its marked info forever), so such
+		// hints are skipped. A hint can still be unlinked between this check
+		// and its use, but then the info of every node of that stale prefix
+		// has changed since Search read it, so the mark CAS in HelpOp fails
+		// and the operation retries -- exactly as for any stale pred.
+		inline Node* IndexLookup(T search_value) {
+			for (int b = search_value/INDEX_GAP; b >= 0; b--) {
+				Node* hint = jumpIndex[b];
+				if (hint != NULL && hint->value < search_value && is_marked_reference(hint->info) == false) {
+					return hint;
+				}
+			}
 
+			return head;
+		}
+
+		// ---------------------------------
+		// Publishes a node into its jump-pointer bucket. Plain racy store:
+		// losing a publication only costs a longer walk, never correctness,
+		// since IndexLookup validates whatever it reads.
+		inline void IndexPublish(Node* nd) {
+			if (nd == NULL || nd->value <= 0 || nd->value == INT_MAX) {
+				return;
+			}
+
+			jumpIndex[nd->value/INDEX_GAP] = nd;
+		}
+
+		// ---------------------------------
+		// Shared state of one segmented recovery scan; boundaries are
+		// handed from the skim to the workers through `produced` (a
+		// worker claims segment i with fetch-and-add on `consumed` and
+		// spins until produced > i).
+		class RecoveryState {
+			public:
+				RecoverableLinkedListTracking* list;
+				Node** bounds;				// bounds[i] = first node of segment i
+				volatile long produced;		// segments whose end boundary is recorded
+				volatile long consumed;		// segments claimed by workers
+				volatile bool skim_done;
+				bool repair;				// help pending ops + republish the index
+				volatile long numNodes;
+				volatile long taggedNodes;
+		};
+
+		// ---------------------------------
+		static void* RecoveryWorker(void* arg) {
+			RecoveryState* st = (RecoveryState*)arg;
+			RecoverableLinkedListTracking* list = st->list;
+
+			while (1) {
+				long seg = __sync_fetch_and_add(&(st->consumed), 1);
+				while (st->produced <= seg) {
+					if (st->skim_done && st->produced <= seg) {
+						return NULL;
+					}
+					_mm_pause();
+				}
+
+				// Segments end on the boundary *value*: the boundary
+				// node itself may be unlinked or copied by a repair in
+				// the neighbouring segment, but values are unique and
+				// sorted, so the walk still terminates at the seam.
+				Node* curr = st->bounds[seg];
+				T stop_value = st->bounds[seg + 1]->value;
+				long numNodes = 0, taggedNodes = 0;
+
+				while (curr->value < stop_value) {
+					Info* info = curr->info;
+					if (list->is_marked_reference(info) == true) {
+						taggedNodes++;
+						if (st->repair) {
+							list->HelpOp(list->get_unmarked_reference(info), true);
+						}
+					}
+					if (st->repair && list->is_marked_reference(curr->info) == false) {
+						list->IndexPublish(curr);
+					}
+					numNodes++;
+					curr = curr->next;
+				}
+
+				__sync_fetch_and_add(&(st->numNodes), numNodes);
+				__sync_fetch_and_add(&(st->taggedNodes), taggedNodes);
+			}
+		}
+
+		// ---------------------------------
+		// Engine behind RecoverParallel and the parallel count: skims
+		// the list in the calling thread while nr_workers consume the
+		// segments it publishes. With repair == true the counts are
+		// approximate (repairs relink nodes under the scan); read-only
+		// they are exact.
+		void RecoverScan(int nr_workers, bool repair, long* outNodes, long* outTagged) {
+			RecoveryState st;
+			st.list = this;
+			st.bounds = new Node* [KEY_RANGE/RECOVERY_SEG + 2];
+			st.produced = 0;
+			st.consumed = 0;
+			st.skim_done = false;
+			st.repair = repair;
+			st.numNodes = 0;
+			st.taggedNodes = 0;
+
+			pthread_t workers[nr_workers];
+			for (int w = 0; w < nr_workers; w++) {
+				if (pthread_create(&workers[w], NULL, RecoveryWorker, (void*)&st)) {
+					cout << "Error occurred when creating recovery worker " << w << endl;
+					exit(1);
+				}
+			}
+
+			long seg = 0, in_seg = 0;
+			Node* curr = head->next;
+			st.bounds[0] = curr;
+			while (curr->value != INT_MAX) {
+				curr = curr->next;
+				if (++in_seg == RECOVERY_SEG && curr->value != INT_MAX) {
+					st.bounds[seg + 1] = curr;
+					__sync_synchronize();
+					st.produced = ++seg;
+					in_seg = 0;
+				}
+			}
+			st.bounds[seg + 1] = curr;							// INT_MAX dummy closes the last segment
+			__sync_synchronize();
+			st.produced = seg + 1;
+			st.skim_done = true;
+
+			for (int w = 0; w < nr_workers; w++) {
+				pthread_join(workers[w], NULL);
+			}
+
+			*outNodes = st.numNodes;
+			*outTagged = st.taggedNodes;
+			delete [] st.bounds;
+		}
+
+		// ---------------------------------
+		// Bounded exponential backoff for contended retry loops: a failed
+		// CAS means someone else made progress, so immediately re-hitting
+		// the same cache line only multiplies coherence traffic.
+		inline void Backoff(int &spins) {
+			for (int i = 0; i < spins; i++) {
+				_mm_pause();
+			}
+
+			if (spins < BACKOFF_MAX) {
+				spins <<= 1;
+			}
+		}
+
+		// ---------------------------------
+		// Caps the number of threads helping one Info record at MAX_HELPERS;
+		// surplus threads spin-wait on its result instead of issuing yet
+		// more CASes and flushes on the same cache lines. The wait is
+		// bounded: an attempt whose mark CAS failed leaves result at
+		// BOT_RESULT forever, so after HELP_SPIN_BOUND pauses the thread
+		// helps anyway, preserving lock-freedom.
+		inline void HelpOpThrottled(Info *op_info) {
+			if (__sync_fetch_and_add(&(op_info->helpers), 1) < MAX_HELPERS) {
+				HelpOp(op_info, true);
+				__sync_fetch_and_sub(&(op_info->helpers), 1);
+				return;
+			}
+			__sync_fetch_and_sub(&(op_info->helpers), 1);
+
+			for (int i = 0; i < HELP_SPIN_BOUND; i++) {
+				if (op_info->result != BOT_RESULT) {
+					return;
+				}
+				_mm_pause();
+			}
+
+			HelpOp(op_info, true);
+		}
 
 		// ---------------------------------
 		inline bool HelpOp (Info *op_info, bool helper) {
@@ -565,9 +1010,12 @@ template <class T> class RecoverableLinkedListTracking{
 		}
 };
 
+template <class T> thread_local typename RecoverableLinkedListTracking<T>::NodePool RecoverableLinkedListTracking<T>::nodePool;
+
 #if defined(PROFILING)
-RecoverableLinkedListTracking<int>::OpProfiler tmpProfilerRecoverableLinkedListTracking;
-template<> thread_local RecoverableLinkedListTracking<int>::OpProfiler RecoverableLinkedListTracking<int>::prof CACHE_ALIGN = tmpProfilerRecoverableLinkedListTracking;
+template <class T> typename RecoverableLinkedListTracking<T>::OpProfiler* volatile RecoverableLinkedListTracking<T>::OpProfiler::registry[MAX_THREADS] = {};
+template <class T> volatile int RecoverableLinkedListTracking<T>::OpProfiler::numRegistered = 0;
+template<> thread_local RecoverableLinkedListTracking<int>::OpProfiler RecoverableLinkedListTracking<int>::prof CACHE_ALIGN;
 #endif
 
 #endif /* RECOVERABLE_LINKED_LIST_TRACKING_H_ */
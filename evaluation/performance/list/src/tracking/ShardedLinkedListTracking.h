@@ -0,0 +1,98 @@
+/// @file ShardedLinkedListTracking.h
+///
+/// Sharded wrapper around RecoverableLinkedListTracking: NUM_SHARDS
+/// independent list instances with keys hash-partitioned across them.
+/// Each shard keeps the unmodified tracking protocol, so the wrapper
+/// measures how far plain partitioning takes the design before any
+/// algorithmic change is needed. Recovery is embarrassingly parallel:
+/// shards share nothing, so their transient indexes are rebuilt by one
+/// thread each.
+
+#ifndef SHARDED_LINKED_LIST_TRACKING_H_
+#define SHARDED_LINKED_LIST_TRACKING_H_
+
+#include "Utilities.h"
+#include "RecoverableLinkedListTracking.h"
+
+#ifndef NUM_SHARDS
+#define NUM_SHARDS 8
+#endif
+
+template <class T> class ShardedLinkedListTracking{
+
+	public:
+		ShardedLinkedListTracking() {
+			for (int s = 0; s < NUM_SHARDS; s++) {
+				shards[s] = new RecoverableLinkedListTracking<T>();
+			}
+		}
+
+		//---------------------------------
+		bool Find(T value, int tid) {
+			return ShardOf(value)->Find(value, tid);
+		}
+
+		bool Insert(T value, int tid) {
+			return ShardOf(value)->Insert(value, tid);
+		}
+
+		bool Delete(T value, int tid) {
+			return ShardOf(value)->Delete(value, tid);
+		}
+
+		//---------------------------------
+		void initialize(){
+			long int seed = time(NULL) + 240;
+			fastRandomSetSeed(seed);
+
+			for (int i = 0; i < KEY_RANGE/2; i++) {
+		  		int value = fastRandomRange(1, KEY_RANGE);
+		  		Insert(value, 0);
+			}
+
+			RebuildIndexes();
+		}
+
+		//---------------------------------
+		// Rebuilds every shard's transient jump-pointer index after
+		// recovery, one thread per shard.
+		void RebuildIndexes() {
+			pthread_t rebuilders[NUM_SHARDS];
+
+			for (int s = 0; s < NUM_SHARDS; s++) {
+				if (pthread_create(&rebuilders[s], NULL, RebuildShard, (void*)shards[s])) {
+					cout << "Error occurred when creating index rebuilder " << s << endl;
+					exit(1);
+				}
+			}
+			for (int s = 0; s < NUM_SHARDS; s++) {
+				pthread_join(rebuilders[s], NULL);
+			}
+		}
+
+		//---------------------------------
+		void count_list_elements() {
+			for (int s = 0; s < NUM_SHARDS; s++) {
+				shards[s]->count_list_elements();
+			}
+		}
+
+	private:
+		RecoverableLinkedListTracking<T>* shards[NUM_SHARDS];
+
+		// ---------------------------------
+		// Multiplicative (Fibonacci) hashing: consecutive keys land on
+		// different shards, so a popular key range does not serialize on
+		// one list.
+		inline RecoverableLinkedListTracking<T>* ShardOf(T value) {
+			return shards[((unsigned long)value * 2654435761u) % NUM_SHARDS];
+		}
+
+		// ---------------------------------
+		static void* RebuildShard(void* arg) {
+			((RecoverableLinkedListTracking<T>*)arg)->RebuildIndex();
+			return NULL;
+		}
+};
+
+#endif /* SHARDED_LINKED_LIST_TRACKING_H_ */
@@ -13,6 +13,7 @@
 #include <sys/time.h>
 
 #include "RecoverableLinkedListTracking.h"
+#include "ShardedLinkedListTracking.h"
 #include "RecoverableLinkedListCapsules.h"
 
 #include "Utilities.h"
@@ -48,6 +49,9 @@ int totalNumRecoverableLinkedListTrackingActions = 0;
 RecoverableLinkedListCapsules<int> recoverableLinkedListCapsules;
 int totalNumRecoverableLinkedListCapsulesActions = 0;
 
+ShardedLinkedListTracking<int> shardedLinkedListTracking;
+int totalNumShardedLinkedListTrackingActions = 0;
+
 
 #if defined(PROFILING)
 // Tracking
@@ -226,6 +230,51 @@ inline static void* startRoutineRecoverableLinkedListTracking(void* argsInput){
     return NULL;
 }
 
+// Same measurement loop as the tracking routine, routed through the
+// sharded wrapper. Per-phase PROFILING counters are left to the
+// single-list experiments; this target only measures throughput.
+inline static void* startRoutineShardedLinkedListTracking(void* argsInput){
+
+    int thread_id = *(int*)argsInput;
+    // threadPin(thread_id);
+
+    long numMyOps=0;
+
+    ShardedLinkedListTracking<int>& list = shardedLinkedListTracking;
+
+    int key;
+    unsigned int seed = time(NULL) + thread_id;
+    long op;
+
+    fastRandomSetSeed(seed);
+
+    while (run == false) {          // busy-wait to start "simultaneously"
+        MFENCE();
+        pthread_yield();
+    }
+
+    while(!stop){
+
+        numMyOps++;
+        op = fastRandomRange(1, 100);
+        key = fastRandomRange(1, KEY_RANGE);
+
+        if (op <= 100*INSERTS_PERCENTAGE) {
+            list.Insert(key, thread_id);
+        }
+        else if (op <= 100*INSERTS_PERCENTAGE+100*DELETES_PERCENTAGE) {
+            list.Delete(key, thread_id);
+        }
+        else {
+            list.Find(key, thread_id);
+        }
+    }
+
+    ADD(&totalNumShardedLinkedListTrackingActions, numMyOps);
+
+    return NULL;
+}
+
 inline static void* startRoutineRecoverableLinkedListCapsules(void* argsInput){
 
     int thread_id = *(int*)argsInput;
@@ -386,9 +435,53 @@ void countRecoverableLinkedListTracking(){
     file << (float) totalNumRecoverableLinkedListTrackingActions_numFlushHigh/totalNumRecoverableLinkedListTrackingActions << endl;
     file << "Test Tracking-Fence - Threads num: " << numThreads << endl;
     file << (float) totalNumRecoverableLinkedListTrackingActions_numFence/totalNumRecoverableLinkedListTrackingActions << endl;
+
+    // Latency/retry detail recorded for 1 in PROFILING_SAMPLE_PERIOD ops,
+    // aggregated across threads through the profiler registry.
+    RecoverableLinkedListTracking<int>::OpProfiler profSnapshot;
+    RecoverableLinkedListTracking<int>::OpProfiler::Snapshot(profSnapshot);
+    if (profSnapshot.numSampledOps > 0) {
+        cout << "Sampled ops: " << profSnapshot.numSampledOps
+             << ", avg latency (cycles): " << (float) profSnapshot.sampledCycles/profSnapshot.numSampledOps
+             << ", max latency (cycles): " << profSnapshot.sampledCyclesMax
+             << ", avg retries: " << (float) profSnapshot.sampledRetries/profSnapshot.numSampledOps << endl;
+    }
 	#endif
 }
 
+void countShardedLinkedListTracking(){
+
+    shardedLinkedListTracking.initialize();
+
+    run = false;
+    stop = false;
+
+    int i;
+
+    for (i = 0; i < numThreads; i++) {
+        arguments[i * PADDING] = i;
+        if(pthread_create(&threads[i], NULL, startRoutineShardedLinkedListTracking, (void*)&arguments[i * PADDING])){
+            cout << "Error occurred when creating thread" << i << endl;
+            exit(1);
+        }
+    }
+
+    // threadPin(i);
+
+    run = true;
+    MFENCE();
+    sleep(timeForRecord);
+    stop=true;
+    MFENCE();
+
+    for (int i = 0; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    cout << totalNumShardedLinkedListTrackingActions/timeForRecord << endl;
+    file << totalNumShardedLinkedListTrackingActions/timeForRecord << endl;
+}
+
 void countRecoverableLinkedListCapsules(){
 
     recoverableLinkedListCapsules.initialize(0);
@@ -491,6 +584,13 @@ int main(int argc, char* argv[]){
         countRecoverableLinkedListTracking();
     }
 
+    // Sharded tracking
+    else if(!strcmp(linkedListType, "Tracking-sharded")){
+        file << "Test Tracking-sharded (" << NUM_SHARDS << " shards) - Threads num: " << numThreads << endl;
+        cout << "Test Tracking-sharded (" << NUM_SHARDS << " shards) - Threads num: " << numThreads << endl;
+        countShardedLinkedListTracking();
+    }
+
     // Capsules
     else if(!strcmp(linkedListType, "Capsules-Opt")){
         file << "Test Capsules-Opt - Threads num: " << numThreads << endl;
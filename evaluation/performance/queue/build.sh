@@ -16,7 +16,7 @@ sudo $base_dir/src/clobber-nvm/deps.sh
 # Build
 
 ### PMDK
-g++ -O3 -o $target_path/bench_cpp $base_dir/src/main.cpp $base_dir/src/pmdk/pipe.cpp $base_dir/src/pmdk/queue.cpp -pthread -lpmemobj -std=c++17
+g++ -O3 -o $target_path/bench_cpp $base_dir/src/main.cpp $base_dir/src/pmdk/pipe.cpp $base_dir/src/pmdk/queue.cpp $base_dir/src/pmdk/fcqueue.cpp $base_dir/src/pmdk/msqueue.cpp -pthread -lpmemobj -std=c++17
 
 ### Clobber-NVM
 (cd $base_dir/src/clobber-nvm; sudo ./build.sh)
@@ -84,6 +84,49 @@ void ptr_para_record(void *ptr, size_t size){
 
 
 
+/*
+ * Buffered store tracking (pass flag -buffered-tracking): instrumented
+ * stores append their record to this thread-local ring and the pass
+ * inserts a single flush_nvmm_writes() call at fence/unlock/return
+ * boundaries, so a batch of stores pays one runtime call instead of one
+ * per store. The ring also self-flushes when full, so records are never
+ * dropped.
+ */
+#define WriteLogEntries 256
+
+typedef struct {
+    void *ptr;
+    size_t size;
+} WriteRecord;
+
+static __thread WriteRecord writeLog[WriteLogEntries];
+static __thread uint32_t writeLogCount = 0;
+
+void flush_nvmm_writes() {
+    if (writeLogCount == 0) return;
+    ThreadContext *ctx = my_context();
+    if (ctx->openTxs == 0){
+	tx_open(ctx);
+	ctx->openTxs++;
+    }
+#ifdef NVM_STATS
+    for (uint32_t i = 0; i < writeLogCount; i++)
+	ctx->bytesWritten += writeLog[i].size;
+#endif
+    // same per-record work on_nvmm_write would do, one call per batch
+//    for (uint32_t i = 0; i < writeLogCount; i++)
+//	pmemobj_tx_add_range_direct(writeLog[i].ptr, writeLog[i].size);
+    writeLogCount = 0;
+}
+
+void buffered_nvmm_write(void *ptr, size_t size) {
+    debug("buffered_nvmm_write(%p, %zu)\n", ptr, size);
+    if (writeLogCount == WriteLogEntries) flush_nvmm_writes();
+    writeLog[writeLogCount].ptr = ptr;
+    writeLog[writeLogCount].size = size;
+    writeLogCount++;
+}
+
 void on_RAW_write(void *ptr, size_t size) {
     debug("on_nvmm_write(%p, %zu)\n", ptr, size);
 #ifdef NVM_STATS
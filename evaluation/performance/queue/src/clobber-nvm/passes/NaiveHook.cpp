@@ -36,6 +36,10 @@ static cl::opt<bool> PostStoreCallback("post-store-callback",
 static cl::opt<bool> PostLoadCallback("post-load-callback",
         cl::desc("Follow loads to NVMM with a callback to `post_nvmm_load(...)`"),
         cl::value_desc("Disabled by default"));
+static cl::opt<bool> BufferedTracking("buffered-tracking",
+        cl::desc("Track stores with `buffered_nvmm_write(...)` (thread-local ring) "
+                 "and flush with one `flush_nvmm_writes()` call at fence/unlock/return boundaries"),
+        cl::value_desc("Disabled by default"));
 
 namespace {
     class MemoryAccess {
@@ -107,6 +111,10 @@ namespace {
                 enablePostReadCallback = PostLoadCallback;
                 outs() << "Post-load callback is " << enablePostReadCallback << "\n";
             }
+            if (BufferedTracking.getNumOccurrences() > 0) {
+                enableBufferedTracking = BufferedTracking;
+                outs() << "Buffered store tracking is " << enableBufferedTracking << "\n";
+            }
 
             assert(!enableStaticRangeCheck || enableRangeCheck);
             assert(enableRangeCheck || !enablePostWriteCallback);
@@ -242,6 +250,13 @@ namespace {
         Instruction *createRangeTrack(Instruction *inst,
                 Value *addr, Value *size) {
             std::string trackerFunction = writeTrackFunction;
+            // Buffered mode: the store record lands in a thread-local
+            // ring; flush_nvmm_writes() drains it in one call at the
+            // next fence/unlock/return (see insertFlushCalls). RAW
+            // stores stay on the eager path: their log must be durable
+            // before the store itself executes.
+            if (std::is_same<T, Store>::value && enableBufferedTracking)
+                trackerFunction = bufferedWriteTrackFunction;
             if (std::is_same<T, Load>::value) trackerFunction = readTrackFunction;
 
             Module *m = static_cast<Module *>(inst->getModule());
@@ -821,9 +836,50 @@ namespace {
             }
         }
 
+        // Boundaries the write log may not be deferred past: explicit
+        // fences, lock releases (other threads may then read the data),
+        // and function returns (bounds how stale the ring can get).
+        bool isFlushBoundary(Instruction *inst) {
+            if (isa<FenceInst>(inst) || isa<ReturnInst>(inst)) return true;
+            if (!isa<CallInst>(inst)) return false;
+            CallInst *call = cast<CallInst>(inst);
+            if (call->isInlineAsm()) return false;
+            Function *func = call->getCalledFunction();
+            if (func == NULL) return false;
+            StringRef name = func->getName();
+            return name.contains("unlock") ||
+                name == "pmemobj_tx_commit" ||
+                name == "tx_commit";
+        }
+
+        void insertFlushCalls(Function &F) {
+            std::vector<Instruction *> boundaries;
+            for (BBIterator bi = F.getBasicBlockList().begin();
+                    bi != F.getBasicBlockList().end(); bi++) {
+                BasicBlock *bb = &(*bi);
+                for (InstIterator ii = bb->begin(); ii != bb->end(); ii++) {
+                    Instruction *inst = &(*ii);
+                    if (isFlushBoundary(inst)) boundaries.push_back(inst);
+                }
+            }
+
+            Module *m = F.getParent();
+            FunctionType *funcType =
+                TypeBuilder<void(), false>::get(m->getContext());
+            Function *func =
+                (Function*)m->getOrInsertFunction(flushWriteLogFunction, funcType);
+            for (size_t i = 0; i < boundaries.size(); i++) {
+                CallInst *flushCall =
+                    CallInst::Create(func, ArrayRef<Value *>(), "", boundaries[i]);
+                flushCall->setDebugLoc(boundaries[i]->getDebugLoc());
+            }
+        }
+
         bool isHooksFunction(Function *func) {
             if (func->getName() == rangeCheckFunction ||
                     func->getName() == writeTrackFunction ||
+                    func->getName() == bufferedWriteTrackFunction ||
+                    func->getName() == flushWriteLogFunction ||
                     func->getName() == readTrackFunction ||
                     func->getName() == swizzlingFunction ||
                     func->getName() == postStoreFunction ||
@@ -925,6 +981,13 @@ namespace {
             }
             loads.clear();
 
+            // Drain the buffered write log at every deferral boundary;
+            // done after instrumentation so hook callbacks themselves
+            // are never followed by a flush.
+            if (enableBufferedTracking && retVal) {
+                insertFlushCalls(F);
+            }
+
             // TODO tracking and swizzling for library calls
 
             return retVal;
@@ -941,6 +1004,8 @@ namespace {
         std::string rangeCheckFunction = "is_nvmm";
 	std::string RAWwriteTrackFunction = "on_RAW_write";
         std::string writeTrackFunction = "on_nvmm_write";
+        std::string bufferedWriteTrackFunction = "buffered_nvmm_write";
+        std::string flushWriteLogFunction = "flush_nvmm_writes";
         std::string readTrackFunction = "on_nvmm_read";
         std::string swizzlingFunction = "to_absolute_ptr";
         std::string postStoreFunction = "post_nvmm_write";
@@ -956,6 +1021,7 @@ namespace {
         bool enableSwizzling = true;
         bool enablePostWriteCallback = false;
         bool enablePostReadCallback = false;
+        bool enableBufferedTracking = false;
     };
 }
 
@@ -1,3 +1,7 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // syscall() for the futex park path
+#endif
+
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -11,6 +15,9 @@
 #include <errno.h>
 #include <assert.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "txlock.h"
 #include "txutil.h"
@@ -103,6 +110,114 @@ static int tas_unlock(tas_lock_t *l) {
 }
 
 
+// test-and-set spin-then-park lock =========================
+//
+// "tas" spins forever, which is the right call when every waiter owns a
+// core but destroys the holder's throughput once threads are
+// overcommitted. "tas_park" spins for a bounded budget calibrated to the
+// lock's observed hold time, then parks on a futex. val follows the
+// usual three-state protocol: 0 free, 1 held, 2 held with (possible)
+// waiters; an unlock that observes 2 wakes one parked thread.
+
+struct _tas_park_lock_t {
+    volatile int32_t val;        // 0 free, 1 held, 2 held w/ waiters
+    volatile int32_t listed;     // pushed onto the contended-lock list
+    volatile int32_t hold_ewma;  // EWMA of hold time in cycles (holder-only)
+    volatile int32_t acqs;       // acquisitions (holder-only)
+    volatile int32_t parks;      // futex parks on this lock
+    int64_t hold_start;          // cycle count at acquisition (holder-only)
+    struct _tas_park_lock_t* volatile next; // contended-lock list link
+} __attribute__((__packed__));
+
+typedef struct _tas_park_lock_t tas_park_lock_t;
+
+_Static_assert(sizeof(tas_park_lock_t) <= sizeof(pthread_mutex_t), "must fit in a pthread_mutex_t for drop in replacement");
+
+// spin budget bounds in cycles (LIBTXLOCK_PARK_MIN_SPIN / _MAX_SPIN)
+static uint32_t TP_MIN_SPIN = 1<<10;
+static uint32_t TP_MAX_SPIN = 1<<16;
+
+static inline uint64_t park_clock() {
+#if defined(__x86_64__) || defined(__x86_64)
+    return rdtsc();
+#else
+    return __builtin_ppc_get_timebase();
+#endif
+}
+
+// Locks that ever parked a waiter, so the exit handler can report
+// per-lock contention. Locks live in application memory; the list is
+// only walked at process exit, when that memory is still mapped.
+static tas_park_lock_t* volatile park_lock_head = 0;
+
+static void tas_park_register(tas_park_lock_t *l) {
+    if (l->listed || !__sync_bool_compare_and_swap(&l->listed, 0, 1))
+        return;
+    do {
+        l->next = park_lock_head;
+    } while (!__sync_bool_compare_and_swap(&park_lock_head, l->next, l));
+}
+
+static int tas_park_lock(tas_park_lock_t *l) {
+    TM_STATS_ADD(my_tm_stats->locks, 1);
+    int32_t c = __sync_val_compare_and_swap(&l->val, 0, 1);
+    if (c != 0) {
+        // Spinning about twice the observed hold time catches the
+        // handoff when the holder is running, without burning a full
+        // timeslice when it was preempted.
+        uint64_t budget = 2 * (uint64_t)l->hold_ewma;
+        if (budget < TP_MIN_SPIN) budget = TP_MIN_SPIN;
+        if (budget > TP_MAX_SPIN) budget = TP_MAX_SPIN;
+        uint64_t start = park_clock();
+        int s = spin_begin();
+        while (l->val != 0 && park_clock() - start < budget)
+            s = spin_wait(s);
+        // From here on we acquire with val=2 so the eventual unlock
+        // knows someone may be parked (one spurious wake when the spin
+        // won after all; that is the standard price).
+        c = __sync_lock_test_and_set(&l->val, 2);
+        while (c != 0) {
+            tas_park_register(l);
+            __sync_fetch_and_add(&l->parks, 1);
+            TM_STATS_ADD(my_tm_stats->parks, 1);
+            syscall(SYS_futex, &l->val, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+            c = __sync_lock_test_and_set(&l->val, 2);
+        }
+    }
+    l->acqs++;
+    l->hold_start = (int64_t)park_clock();
+    TM_STATS_SUB(my_tm_stats->cycles, RDTSC());
+    return 0;
+}
+
+static int tas_park_trylock(tas_park_lock_t *l) {
+    if (__sync_val_compare_and_swap(&l->val, 0, 1) == 0) {
+        TM_STATS_ADD(my_tm_stats->locks, 1);
+        l->acqs++;
+        l->hold_start = (int64_t)park_clock();
+        TM_STATS_SUB(my_tm_stats->cycles, RDTSC());
+        return 0;
+    }
+    return 1;
+}
+
+static int tas_park_unlock(tas_park_lock_t *l) {
+    // fold this hold into the EWMA (alpha 1/8); only the holder writes
+    int64_t held = (int64_t)park_clock() - l->hold_start;
+    if (held > 0) {
+        if (held > (int64_t)TP_MAX_SPIN * 16)
+            held = (int64_t)TP_MAX_SPIN * 16;
+        l->hold_ewma += (int32_t)((held - (int64_t)l->hold_ewma) >> 3);
+    }
+    if (__atomic_exchange_n(&l->val, 0, __ATOMIC_RELEASE) == 2) {
+        TM_STATS_ADD(my_tm_stats->wakes, 1);
+        syscall(SYS_futex, &l->val, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+    TM_STATS_ADD(my_tm_stats->cycles, RDTSC());
+    return 0;
+}
+
+
 // test-and-set TM lock =========================
 //
 
@@ -671,6 +786,117 @@ static int mcs_unlock_tm(mcs_lock_t *lk) {
 }
 
 
+// CLH queue lock ============================
+//
+// Each waiter spins on a flag in its predecessor's node, so the only
+// line a thread polls while waiting is one no other waiter writes; the
+// handoff on unlock is a single store instead of the MCS
+// lock_next handshake. Nodes are recycled CLH-style: the releaser
+// adopts its predecessor's node for its next acquisition and leaves its
+// own node behind for the successor, so at most one node per lock plus
+// one spare per thread is ever live.
+
+struct _clh_node_t {
+  volatile int locked;
+  char pad[60]; // own the whole line; waiters of other locks never share
+} __attribute__((aligned(64)));
+
+typedef struct _clh_node_t clh_node_t;
+
+struct _clh_lock_t {
+  clh_node_t* volatile tail;
+};
+
+typedef struct _clh_lock_t clh_lock_t;
+
+// Which node/pred belong to a lock this thread currently holds; like
+// the MCS used-list, assumes we never hold a lot of locks at once.
+#define CLH_MAX_HELD 16
+typedef struct {
+  clh_lock_t *lock;
+  clh_node_t *node; // the node we enqueued (successor spins on it)
+  clh_node_t *pred; // predecessor's node, adopted on release
+} clh_held_t;
+static __thread clh_held_t clh_held[CLH_MAX_HELD];
+static __thread int clh_n_held = 0;
+static __thread clh_node_t *clh_spare = NULL;
+
+static clh_node_t *clh_get_node() {
+  clh_node_t *n = clh_spare;
+  if (n != NULL) {
+    clh_spare = NULL;
+    return n;
+  }
+  n = aligned_alloc(64, sizeof(clh_node_t));
+  assert(n != NULL);
+  return n;
+}
+
+static inline int clh_lock_common(clh_lock_t *lk, bool try_lock) {
+  TM_STATS_ADD(my_tm_stats->locks, 1);
+  clh_node_t *mine = clh_get_node();
+  mine->locked = 1;
+
+  clh_node_t *pred;
+  if (try_lock) {
+    // Only take the lock when the tail is free (empty queue or a
+    // released node); otherwise give the node back and fail.
+    pred = lk->tail;
+    if ((pred != NULL && pred->locked) ||
+        !__sync_bool_compare_and_swap(&lk->tail, pred, mine)) {
+      clh_spare = mine;
+      return 1;
+    }
+  } else {
+    pred = (clh_node_t*)__sync_lock_test_and_set(&lk->tail, mine);
+    if (pred != NULL) {
+      int s = spin_begin();
+      while (pred->locked) {
+        s = spin_wait(s);
+      }
+    }
+  }
+
+  assert(clh_n_held < CLH_MAX_HELD);
+  clh_held[clh_n_held].lock = lk;
+  clh_held[clh_n_held].node = mine;
+  clh_held[clh_n_held].pred = pred;
+  clh_n_held++;
+  return 0;
+}
+
+static int clh_lock(clh_lock_t *lk) {
+  return clh_lock_common(lk, false);
+}
+
+static int clh_trylock(clh_lock_t *lk) {
+  return clh_lock_common(lk, true);
+}
+
+static int clh_unlock(clh_lock_t *lk) {
+  int i = clh_n_held - 1;
+  while (i >= 0 && clh_held[i].lock != lk) {
+    i--;
+  }
+  assert(i >= 0);
+  clh_node_t *mine = clh_held[i].node;
+  clh_node_t *pred = clh_held[i].pred;
+  clh_held[i] = clh_held[--clh_n_held];
+
+  __sync_synchronize();
+  mine->locked = 0; // successor proceeds; our node stays in the queue
+
+  if (pred != NULL) {
+    if (clh_spare == NULL) {
+      clh_spare = pred;
+    } else {
+      free(pred);
+    }
+  }
+  return 0;
+}
+
+
 // function dispatch =========================
 //
 
@@ -687,12 +913,14 @@ static lock_type_t lock_types[] = {
     {"pthread",     sizeof(pthread_mutex_t), (txlock_func_t)pthread_lock, (txlock_func_t)pthread_trylock, (txlock_func_t)pthread_unlock},
     {"pthread_tm",  sizeof(pthread_mutex_t), (txlock_func_t)pthread_lock_tm, (txlock_func_t)pthread_trylock_tm, (txlock_func_t)pthread_unlock_tm},
     {"tas",         sizeof(tas_lock_t), (txlock_func_t)tas_lock, (txlock_func_t)tas_trylock, (txlock_func_t)tas_unlock},
+    {"tas_park",    sizeof(tas_park_lock_t), (txlock_func_t)tas_park_lock, (txlock_func_t)tas_park_trylock, (txlock_func_t)tas_park_unlock},
     {"tas_tm",      sizeof(tas_lock_t), (txlock_func_t)tas_lock_tm, (txlock_func_t)tas_trylock_tm, (txlock_func_t)tas_unlock_tm},
     {"tas_priority_tm",      sizeof(tas_lock_t), (txlock_func_t)tas_priority_lock_tm, (txlock_func_t)tas_priority_trylock_tm, (txlock_func_t)tas_priority_unlock_tm},
     {"tas_hle",     sizeof(tas_lock_t), (txlock_func_t)tas_lock_hle, (txlock_func_t)tas_trylock_hle, (txlock_func_t)tas_unlock_hle},
     {"ticket",      sizeof(ticket_lock_t), (txlock_func_t)ticket_lock, (txlock_func_t)ticket_trylock, (txlock_func_t)ticket_unlock},
     {"ticket_tm",   sizeof(ticket_lock_t), (txlock_func_t)ticket_lock_tm, (txlock_func_t)ticket_trylock_tm, (txlock_func_t)ticket_unlock_tm},
     {"mcs",   sizeof(mcs_lock_t), (txlock_func_t)mcs_lock, (txlock_func_t)mcs_trylock, (txlock_func_t)mcs_unlock},
+    {"clh",   sizeof(clh_lock_t), (txlock_func_t)clh_lock, (txlock_func_t)clh_trylock, (txlock_func_t)clh_unlock},
     {"mcs_tm",   sizeof(mcs_lock_t), (txlock_func_t)mcs_lock_tm, (txlock_func_t)mcs_trylock_tm, (txlock_func_t)mcs_unlock_tm}
 };
 
@@ -779,6 +1007,10 @@ static void init_lib_txlock() {
         TK_MIN_DISTANCE=atoi(env);
     if ((env = getenv("LIBTXLOCK_NUM_TRIES")) != NULL)
         TK_NUM_TRIES=atoi(env);
+    if ((env = getenv("LIBTXLOCK_PARK_MIN_SPIN")) != NULL)
+        TP_MIN_SPIN=atoi(env);
+    if ((env = getenv("LIBTXLOCK_PARK_MAX_SPIN")) != NULL)
+        TP_MAX_SPIN=atoi(env);
 
       // notify user of arguments
     fprintf(stderr, "LIBTXLOCK_LOCK: %s\n", using_lock_type->name);
@@ -855,6 +1087,8 @@ static void uninit_lib_txlock()
         tm_stats.commits += curr->commits;
         tm_stats.overflows += curr->overflows;
         tm_stats.conflicts += curr->conflicts;
+        tm_stats.parks += curr->parks;
+        tm_stats.wakes += curr->wakes;
         tm_stats.threads += 1;
         curr = curr->next;
     }
@@ -879,6 +1113,14 @@ Ensure all threads properly terminate using pthread_exit()");
                         (tm_stats.tm_cycles/tm_stats.tries), tm_stats.tries, tm_stats.commits,
                         tm_stats.overflows, tm_stats.conflicts, tm_stats.stops);
     }
+    if (tm_stats.parks!=0) {
+        fprintf(stderr, ", parks: %d, wakes: %d", tm_stats.parks, tm_stats.wakes);
+    }
+    // per-lock contention report: every lock that ever parked a waiter
+    for (tas_park_lock_t* volatile lk = park_lock_head; lk; lk = lk->next) {
+        fprintf(stderr, "\nLIBTXLOCK contended lock %p: acqs: %d, parks: %d, avg_hold_cycles: %d",
+                        (void*)lk, lk->acqs, lk->parks, lk->hold_ewma);
+    }
     fprintf(stderr, "\n");
     fflush(stderr);
 
@@ -54,6 +54,8 @@ typedef struct _tm_stats_t {
     int32_t commits;       // # of tm_ends
     int32_t overflows;     // overflow aborts
     int32_t conflicts;     // conflict aborts
+    int32_t parks;         // futex parks (tas_park)
+    int32_t wakes;         // futex wakes (tas_park)
     int32_t threads;       // number of threads
     struct _tm_stats_t* volatile next;
 } __attribute__ ((aligned(128))) tm_stats_t;
@@ -2,6 +2,12 @@
 #include <unistd.h>
 #include <vector>
 #include <atomic>
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include <ctime>
+#include <pthread.h>
+#include <x86intrin.h>
 
 #include <iostream>
 
@@ -9,3 +15,119 @@
 #define SEC_2_MICRO_SEC(sec) ((sec)*ONE_MILLION) // util
 
 #define POOL_SIZE 128 * 1024 * 1024 * 1024 // 128 GB
+
+#ifndef QUEUE_BENCH_UTIL
+#define QUEUE_BENCH_UTIL
+
+// rdtsc-based latency histogram with power-of-two buckets: add() is a
+// clz plus an increment, cheap enough to sit on the per-op path without
+// moving the numbers it measures. Percentiles come back as the upper
+// bound of the bucket holding the requested quantile.
+struct latency_hist
+{
+    uint64_t buckets[64] = {};
+    uint64_t count = 0;
+
+    void add(uint64_t cycles)
+    {
+        int b = cycles == 0 ? 0 : 63 - __builtin_clzll(cycles);
+        buckets[b]++;
+        count++;
+    }
+
+    void merge(const latency_hist &o)
+    {
+        for (int b = 0; b < 64; b++)
+            buckets[b] += o.buckets[b];
+        count += o.count;
+    }
+
+    uint64_t percentile(double q) const
+    {
+        uint64_t rank = (uint64_t)(q * count);
+        uint64_t seen = 0;
+        for (int b = 0; b < 64; b++)
+        {
+            seen += buckets[b];
+            if (seen > rank)
+                return 2ULL << b;
+        }
+        return 0;
+    }
+};
+
+static inline uint64_t rdtsc_now()
+{
+    return __rdtsc();
+}
+
+// TSC period, calibrated once against CLOCK_MONOTONIC over 10ms.
+static inline double tsc_ns_per_cycle()
+{
+    static double cached = 0.0;
+    if (cached == 0.0)
+    {
+        struct timespec a, b;
+        clock_gettime(CLOCK_MONOTONIC, &a);
+        uint64_t c0 = __rdtsc();
+        long ns = 0;
+        do
+        {
+            clock_gettime(CLOCK_MONOTONIC, &b);
+            ns = (b.tv_sec - a.tv_sec) * 1000000000L + (b.tv_nsec - a.tv_nsec);
+        } while (ns < 10000000L);
+        uint64_t c1 = __rdtsc();
+        cached = (double)ns / (c1 - c0);
+    }
+    return cached;
+}
+
+// "1,3,5-8" -> {1,3,5,6,7,8}; workers are pinned round-robin onto the
+// list, empty list means "let the OS place threads".
+static inline std::vector<int> parse_cpu_list(const std::string &s)
+{
+    std::vector<int> cpus;
+    if (s.empty() || s == "none")
+        return cpus;
+    std::stringstream ss(s);
+    std::string part;
+    while (getline(ss, part, ','))
+    {
+        auto dash = part.find('-');
+        if (dash == std::string::npos)
+        {
+            cpus.push_back(stoi(part));
+        }
+        else
+        {
+            int lo = stoi(part.substr(0, dash));
+            int hi = stoi(part.substr(dash + 1));
+            for (int c = lo; c <= hi; c++)
+                cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+// Wall-clock microseconds between two CLOCK_MONOTONIC samples; the
+// recovery benches time pool reopen with this rather than the TSC since
+// reopen spans syscalls and page faults.
+static inline long elapsed_us(const struct timespec &a, const struct timespec &b)
+{
+    return (b.tv_sec - a.tv_sec) * 1000000L + (b.tv_nsec - a.tv_nsec) / 1000;
+}
+
+static inline void pin_to(const std::vector<int> &cpus, int tid)
+{
+    if (cpus.empty())
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[tid % cpus.size()], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// Set once by the harness before the run; worker loops consult it.
+extern std::vector<int> bench_pin_cpus;
+
+#endif
@@ -9,14 +9,29 @@
 
 #include "pmdk/pipe.hpp"
 #include "pmdk/queue.hpp"
+#include "pmdk/fcqueue.hpp"
+#include "pmdk/msqueue.hpp"
 
 using namespace std;
 
+std::vector<int> bench_pin_cpus;
+
 enum TestTarget
 {
   PMDK_Queue_Pair,
   PMDK_Queue_Prob,
-  PMDK_Pipe
+  PMDK_Queue_Topo,
+  PMDK_Queue_Recover,
+  PMDK_Queue_Drain,
+  PMDK_FCQueue_Pair,
+  PMDK_FCQueue_Prob,
+  PMDK_FCQueue_Recover,
+  PMDK_MSQueue_Pair,
+  PMDK_MSQueue_Prob,
+  PMDK_MSQueue_Recover,
+  PMDK_Pipe,
+  PMDK_Pipe_Seg,
+  PMDK_Pipe_K
 };
 
 TestTarget
@@ -26,7 +41,15 @@ parse_target(string target, string kind)
   {
     return TestTarget::PMDK_Pipe;
   }
-  else if (target == "pmdk_queue" && kind == "pair")
+  else if (target == "pmdk_pipe" && kind == "pipe-seg")
+  {
+    return TestTarget::PMDK_Pipe_Seg;
+  }
+  else if (target == "pmdk_pipe" && kind.substr(0, 6) == "pipe-k")
+  {
+    return TestTarget::PMDK_Pipe_K;
+  }
+  else if (target == "pmdk_queue" && kind.substr(0, 4) == "pair")
   {
     return TestTarget::PMDK_Queue_Pair;
   }
@@ -34,10 +57,59 @@ parse_target(string target, string kind)
   {
     return TestTarget::PMDK_Queue_Prob;
   }
+  else if (target == "pmdk_queue" && kind.substr(0, 4) == "topo")
+  {
+    return TestTarget::PMDK_Queue_Topo;
+  }
+  else if (target == "pmdk_queue" && kind == "recover")
+  {
+    return TestTarget::PMDK_Queue_Recover;
+  }
+  else if (target == "pmdk_queue" && kind == "drain")
+  {
+    return TestTarget::PMDK_Queue_Drain;
+  }
+  else if (target == "pmdk_fcqueue" && kind == "pair")
+  {
+    return TestTarget::PMDK_FCQueue_Pair;
+  }
+  else if (target == "pmdk_fcqueue" && kind.substr(0, 4) == "prob")
+  {
+    return TestTarget::PMDK_FCQueue_Prob;
+  }
+  else if (target == "pmdk_fcqueue" && kind == "recover")
+  {
+    return TestTarget::PMDK_FCQueue_Recover;
+  }
+  else if (target == "pmdk_msqueue" && kind == "pair")
+  {
+    return TestTarget::PMDK_MSQueue_Pair;
+  }
+  else if (target == "pmdk_msqueue" && kind.substr(0, 4) == "prob")
+  {
+    return TestTarget::PMDK_MSQueue_Prob;
+  }
+  else if (target == "pmdk_msqueue" && kind == "recover")
+  {
+    return TestTarget::PMDK_MSQueue_Recover;
+  }
   std::cerr << "Invalid target or bench kind: (target: " << target << ", kind: " << kind << ")" << std::endl;
   exit(0);
 }
 
+// Batch size appended to a queue bench kind as "-b{N}" (e.g. "pair-b16",
+// "prob50-b16"): each op then pushes/pops N nodes under one transaction.
+// 1 (unbatched) when absent.
+int parse_batch(string kind)
+{
+  auto pos = kind.find("-b");
+  if (pos == string::npos)
+  {
+    return 1;
+  }
+  return stoi(kind.substr(pos + 2));
+}
+
 struct Config
 {
   string filepath;
@@ -75,6 +147,13 @@ Config setup(int argc, char *argv[])
 
   //                 filepath, target,  kind,   threads,        duration,      init,          output
   Config cfg = Config(argv[1], argv[2], argv[3], atoi(argv[4]), atof(argv[5]), atoi(argv[6]), &of);
+
+  // Optional 8th argument: CPU list ("1,3,5-8") the workers are pinned
+  // onto round-robin; absent or "none" leaves placement to the OS.
+  if (argc > 8)
+  {
+    bench_pin_cpus = parse_cpu_list(argv[8]);
+  }
   return cfg;
 }
 
@@ -90,13 +169,76 @@ double bench(Config cfg)
   case PMDK_Pipe:
     nops = get_pipe_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init);
     break;
+  case PMDK_Pipe_Seg:
+    nops = get_pipe_seg_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init);
+    break;
+  case PMDK_Pipe_K:
+  {
+    // "pipe-k{K}[-b{B}]", e.g. "pipe-k4-b16": K stages, B items moved
+    // per hand-off transaction (1 when absent).
+    int stages = stoi(cfg.kind.substr(6));
+    nops = get_pipe_k_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, stages, parse_batch(cfg.kind));
+    break;
+  }
   case PMDK_Queue_Pair:
-    nops = get_queue_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, std::nullopt);
+    nops = get_queue_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, std::nullopt, parse_batch(cfg.kind));
     break;
   case PMDK_Queue_Prob:
+  {
     int prob = stoi(cfg.kind.substr(4, 3));
-    nops = get_queue_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, prob);
+    nops = get_queue_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, prob, parse_batch(cfg.kind));
+    break;
+  }
+  case PMDK_Queue_Topo:
+  {
+    // "topo{P}:{C}[-r{rate}]", e.g. "topo3:1-r100000": P:C
+    // producer/consumer split with an optional token-bucket cap of
+    // `rate` enqueues/s per producer.
+    int p = 1, c = 1;
+    sscanf(cfg.kind.c_str(), "topo%d:%d", &p, &c);
+    long rate = 0;
+    auto rp = cfg.kind.find("-r");
+    if (rp != string::npos)
+      rate = stol(cfg.kind.substr(rp + 2));
+    nops = get_queue_topo_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, p, c, rate);
+    break;
+  }
+  // "recover": cfg.init is the largest backlog; the sweep and the
+  // per-point timing lines come from the target's recovery function.
+  // The returned count is the total number of nodes built, so the CSV
+  // throughput column is not comparable with the timed kinds.
+  case PMDK_Queue_Recover:
+    nops = get_queue_recovery_nops(cfg.filepath, cfg.init);
     break;
+  // "drain": one thread detaches the whole backlog per call, the rest
+  // produce; the count is items drained.
+  case PMDK_Queue_Drain:
+    nops = get_queue_drain_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init);
+    break;
+  case PMDK_FCQueue_Recover:
+    nops = get_fcqueue_recovery_nops(cfg.filepath, cfg.init);
+    break;
+  case PMDK_MSQueue_Recover:
+    nops = get_msqueue_recovery_nops(cfg.filepath, cfg.init);
+    break;
+  case PMDK_FCQueue_Pair:
+    nops = get_fcqueue_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, std::nullopt);
+    break;
+  case PMDK_FCQueue_Prob:
+  {
+    int prob = stoi(cfg.kind.substr(4, 3));
+    nops = get_fcqueue_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, prob);
+    break;
+  }
+  case PMDK_MSQueue_Pair:
+    nops = get_msqueue_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, std::nullopt);
+    break;
+  case PMDK_MSQueue_Prob:
+  {
+    int prob = stoi(cfg.kind.substr(4, 3));
+    nops = get_msqueue_nops(cfg.filepath, cfg.threads, cfg.duration, cfg.init, prob);
+    break;
+  }
     // TODO: other c++ implementations?
   }
 
@@ -0,0 +1,239 @@
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+#include <atomic>
+#include <optional>
+#include <iostream>
+
+#include "fcqueue.hpp"
+
+using namespace pmem::obj;
+using namespace std;
+
+#define OP_NONE 0
+#define OP_ENQ 1
+#define OP_DEQ 2
+
+// Combiner lock lives in DRAM: it only arbitrates which thread combines
+// and carries no recoverable state.
+static std::atomic<bool> combiner_lock{false};
+
+// Applies every announced request under a single transaction: all node
+// allocations/frees, link updates and result slots are logged and
+// flushed by one commit, which is the whole point of combining on PM.
+// Completion flags are flipped after the commit so waiters never see a
+// result that is not yet persistent.
+void fcqueue::combine(pool_base &pop)
+{
+    int done[FC_MAX_THREADS];
+    int n_done = 0;
+    transaction::run(
+        pop, [&]
+        {
+            for (int t = 0; t < FC_MAX_THREADS; t++)
+            {
+                auto &s = slots[t];
+                int op = s.op.load(std::memory_order_acquire);
+                if (op == OP_ENQ)
+                {
+                    auto n = make_persistent<node>();
+                    n->value = s.arg;
+                    n->next = nullptr;
+                    if (head == nullptr && tail == nullptr)
+                    {
+                        head = tail = n;
+                    }
+                    else
+                    {
+                        tail->next = n;
+                        tail = n;
+                    }
+                    s.ret = 0;
+                    done[n_done++] = t;
+                }
+                else if (op == OP_DEQ)
+                {
+                    if (head == nullptr)
+                    {
+                        s.ret = -1; // EMPTY
+                    }
+                    else
+                    {
+                        s.ret = head->value;
+                        auto next = head->next;
+                        delete_persistent<node>(head);
+                        head = next;
+                        if (head == nullptr)
+                            tail = nullptr;
+                    }
+                    done[n_done++] = t;
+                }
+            } });
+    for (int i = 0; i < n_done; i++)
+    {
+        slots[done[i]].op.store(OP_NONE, std::memory_order_release);
+    }
+}
+
+// Publish the request, then either become the combiner or wait for one;
+// a waiter retries for the combiner role whenever the lock frees while
+// its request is still pending, so no request can be stranded.
+static int64_t execute(fcqueue *q, void (fcqueue::*comb)(pool_base &),
+                       pool_base &pop, std::atomic<int> &op_slot, int op)
+{
+    op_slot.store(op, std::memory_order_release);
+    for (;;)
+    {
+        bool expected = false;
+        if (combiner_lock.compare_exchange_strong(expected, true))
+        {
+            (q->*comb)(pop);
+            combiner_lock.store(false, std::memory_order_release);
+        }
+        if (op_slot.load(std::memory_order_acquire) == OP_NONE)
+        {
+            return 0;
+        }
+        while (combiner_lock.load(std::memory_order_relaxed) &&
+               op_slot.load(std::memory_order_acquire) != OP_NONE)
+        {
+        }
+    }
+}
+
+void fcqueue::push(pool_base &pop, int tid, uint64_t value)
+{
+    auto &s = slots[tid];
+    s.arg = value;
+    pop.persist(&s.arg, sizeof(s.arg));
+    execute(this, &fcqueue::combine, pop, s.op, OP_ENQ);
+}
+
+std::optional<int> fcqueue::pop(pool_base &pop, int tid)
+{
+    auto &s = slots[tid];
+    execute(this, &fcqueue::combine, pop, s.op, OP_DEQ);
+    if (s.ret == -1)
+    {
+        return std::nullopt;
+    }
+    return (int)s.ret;
+}
+
+// pair: {enq; deq;}
+static void fc_op_pair(pool<fcqueue> pop, persistent_ptr<fcqueue> q, int tid, optional<int> prob)
+{
+    q->push(pop, tid, tid);
+    q->pop(pop, tid);
+}
+
+// prob{n}: { n% enq; or (100-n)% deq; }
+static void fc_op_prob(pool<fcqueue> pop, persistent_ptr<fcqueue> q, int tid, optional<int> prob)
+{
+    if ((rand() % 100) < prob.value())
+    {
+        q->push(pop, tid, tid);
+    }
+    else
+    {
+        q->pop(pop, tid);
+    }
+}
+
+int get_fcqueue_nops(string filepath, int nr_threads, float duration, int init, optional<int> prob)
+{
+    if (nr_threads > FC_MAX_THREADS)
+    {
+        std::cerr << "fcqueue supports up to " << FC_MAX_THREADS << " threads" << std::endl;
+        exit(0);
+    }
+
+    remove(filepath.c_str());
+    auto pop = pool<fcqueue>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+    persistent_ptr<fcqueue> q = pop.root();
+
+    // Initailize
+    for (int i = 0; i < init; i++)
+    {
+        q->push(pop, 0, i);
+    }
+
+    std::thread workers[nr_threads];
+    int local_ops[nr_threads];
+    int sum_ops = 0;
+
+    // Count the number of times the op is executed in `duration` seconds
+    for (int tid = 0; tid < nr_threads; tid++)
+    {
+        workers[tid] = std::thread(
+            [](
+                int tid, float duration, int &local_ops, pool<fcqueue> pop, persistent_ptr<fcqueue> q, optional<int> prob)
+            {
+                auto op = (!prob.has_value()) ? fc_op_pair : fc_op_prob;
+
+                pin_to(bench_pin_cpus, tid);
+                local_ops = 0;
+                struct timespec begin, end;
+                clock_gettime(CLOCK_REALTIME, &begin);
+                while (true)
+                {
+                    clock_gettime(CLOCK_REALTIME, &end);
+                    long elapsed = end.tv_sec - begin.tv_sec;
+                    if (duration < elapsed)
+                    {
+                        break;
+                    }
+
+                    op(pop, q, tid, prob);
+                    local_ops += 1;
+                }
+            },
+            tid, duration, std::ref(local_ops[tid]), pop, q, prob);
+    }
+
+    for (int tid = 0; tid < nr_threads; ++tid)
+    {
+        workers[tid].join();
+        sum_ops += local_ops[tid];
+    }
+    return sum_ops;
+}
+
+int get_fcqueue_recovery_nops(string filepath, int max_init)
+{
+    int n = max_init < 1000 ? max_init : 1000;
+    int total = 0;
+    while (true)
+    {
+        remove(filepath.c_str());
+        {
+            auto pop = pool<fcqueue>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+            persistent_ptr<fcqueue> q = pop.root();
+            for (int i = 0; i < n; i++)
+                q->push(pop, 0, i);
+            pop.close();
+        }
+
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        auto pop = pool<fcqueue>::open(filepath, "MY_LAYOUT");
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        auto v = pop.root()->pop(pop, 0);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        pop.close();
+
+        cout << "recover init=" << n
+             << " reopen_us=" << elapsed_us(t0, t1)
+             << " first_deq_us=" << elapsed_us(t1, t2)
+             << " total_us=" << elapsed_us(t0, t2)
+             << (v.has_value() ? "" : " (empty)") << endl;
+
+        total += n;
+        if (n >= max_init)
+            break;
+        n = (n > max_init / 10) ? max_init : n * 10;
+    }
+    return total;
+}
@@ -0,0 +1,67 @@
+// #pragma once
+
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+#include <atomic>
+#include <iostream>
+#include "../common.hpp"
+
+using namespace pmem::obj;
+using namespace std;
+
+#ifndef PMDK_FCQUEUE
+#define PMDK_FCQUEUE
+
+#define FC_MAX_THREADS 64
+
+// Persistent flat-combining queue (cf. pbcomb on the Rust side): each
+// thread publishes its request in a per-thread announcement slot and a
+// single combiner applies every pending request to the queue under one
+// transaction, so a combined batch pays one commit fence instead of one
+// per operation. This separates the combining algorithm's effect from
+// language/runtime overhead when compared against the mutex-per-op
+// `queue`.
+class fcqueue
+{
+    struct node
+    {
+        p<uint64_t> value;
+        persistent_ptr<node> next;
+    } __attribute((aligned(128)));
+
+    // One cacheline-aligned slot per thread so publishing a request
+    // never contends with another thread's slot.
+    struct announce
+    {
+        std::atomic<int> op; // OP_NONE / OP_ENQ / OP_DEQ
+        p<uint64_t> arg;
+        p<int64_t> ret; // popped value, or -1 for empty
+    } __attribute((aligned(128)));
+
+private:
+    persistent_ptr<node> head;
+    persistent_ptr<node> tail;
+    announce slots[FC_MAX_THREADS];
+
+    void combine(pool_base &pop);
+
+public:
+    void push(pool_base &pop, int tid, uint64_t value);
+    std::optional<int> pop(pool_base &pop, int tid);
+};
+
+#endif
+
+#ifndef PMDK_FCQUEUE_TEST
+#define PMDK_FCQUEUE_TEST
+
+int get_fcqueue_nops(string filepath, int nr_threads, float duration, int init, optional<int> prob);
+
+// recover: same sweep as get_queue_recovery_nops, against the
+// flat-combining queue.
+int get_fcqueue_recovery_nops(string filepath, int max_init);
+
+#endif
@@ -0,0 +1,261 @@
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj.h>
+#include <iostream>
+
+#include "msqueue.hpp"
+
+using namespace pmem::obj;
+using namespace std;
+
+// Atomic out-of-transaction allocation: the node is complete and
+// flushed before it becomes reachable, so readers never see a partially
+// written node. A crash between allocation and linking leaks at most
+// one node per thread — the same window the other lock-free PM
+// structures in this tree accept.
+uint64_t msqueue::alloc_node(PMEMobjpool *pop, uint64_t value)
+{
+    PMEMoid oid;
+    if (pmemobj_zalloc(pop, &oid, sizeof(node), 0))
+    {
+        std::cerr << "msqueue: node allocation failed" << std::endl;
+        exit(1);
+    }
+    node *n = static_cast<node *>(pmemobj_direct(oid));
+    n->value = value;
+    n->next = 0;
+    pmemobj_persist(pop, n, sizeof(node));
+    return oid.off;
+}
+
+void msqueue::init(pool_base &pop)
+{
+    PMEMobjpool *p = pop.handle();
+    pool_uuid = pmemobj_oid(this).pool_uuid_lo;
+    uint64_t dummy = alloc_node(p, 0);
+    head = dummy;
+    tail = dummy;
+    pmemobj_persist(p, this, sizeof(msqueue));
+}
+
+void msqueue::push(pool_base &pop, uint64_t value)
+{
+    PMEMobjpool *p = pop.handle();
+    uint64_t off = alloc_node(p, value);
+    while (true)
+    {
+        uint64_t last = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+        node *ln = direct(last);
+        uint64_t next = __atomic_load_n(&ln->next, __ATOMIC_ACQUIRE);
+        if (last != __atomic_load_n(&tail, __ATOMIC_ACQUIRE))
+            continue;
+        if (next != 0)
+        {
+            // Tail is lagging. The link it lags behind is the durable
+            // point of the other enqueue; flush it before helping tail
+            // past it so tail never points beyond persisted links.
+            pmemobj_persist(p, &ln->next, sizeof(uint64_t));
+            __atomic_compare_exchange_n(&tail, &last, next, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+            continue;
+        }
+        uint64_t expected = 0;
+        if (__atomic_compare_exchange_n(&ln->next, &expected, off, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+            // The enqueue is durable once this flush completes; the
+            // tail swing is advisory and flushed lazily by whoever
+            // needs it next.
+            pmemobj_persist(p, &ln->next, sizeof(uint64_t));
+            __atomic_compare_exchange_n(&tail, &last, off, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+
+std::optional<int> msqueue::pop(pool_base &pop)
+{
+    PMEMobjpool *p = pop.handle();
+    while (true)
+    {
+        uint64_t first = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        uint64_t last = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+        node *fn = direct(first);
+        uint64_t next = __atomic_load_n(&fn->next, __ATOMIC_ACQUIRE);
+        if (first != __atomic_load_n(&head, __ATOMIC_ACQUIRE))
+            continue;
+        if (first == last)
+        {
+            if (next == 0)
+                return std::nullopt; // EMPTY
+            // Same helping rule as push: persist the link, then swing
+            // the lagging tail.
+            pmemobj_persist(p, &direct(last)->next, sizeof(uint64_t));
+            __atomic_compare_exchange_n(&tail, &last, next, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+            continue;
+        }
+        int value = (int)direct(next)->value;
+        if (__atomic_compare_exchange_n(&head, &first, next, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+            // Flushed after the CAS: a crash loses only the
+            // advancement, and recovery walking from the persisted head
+            // re-offers the nodes in between.
+            pmemobj_persist(p, &head, sizeof(uint64_t));
+            return value;
+        }
+    }
+}
+
+static bool ms_pick(int prob)
+{
+    return (rand() % 100) < prob;
+}
+
+// pair: {enq; deq;} — enqueue and dequeue latencies recorded separately,
+// as in queue.cpp.
+static int ms_op_pair(pool<msqueue> pop, persistent_ptr<msqueue> q, int tid, optional<int> prob,
+                      latency_hist &enq_hist, latency_hist &deq_hist)
+{
+    auto t0 = rdtsc_now();
+    q->push(pop, tid);
+    auto t1 = rdtsc_now();
+    enq_hist.add(t1 - t0);
+    q->pop(pop);
+    deq_hist.add(rdtsc_now() - t1);
+    return 1;
+}
+
+// prob{n}: { n% enq; or (100-n)% deq; }
+static int ms_op_prob(pool<msqueue> pop, persistent_ptr<msqueue> q, int tid, optional<int> prob,
+                      latency_hist &enq_hist, latency_hist &deq_hist)
+{
+    auto t0 = rdtsc_now();
+    if (ms_pick(prob.value()))
+    {
+        q->push(pop, tid);
+        enq_hist.add(rdtsc_now() - t0);
+    }
+    else
+    {
+        q->pop(pop);
+        deq_hist.add(rdtsc_now() - t0);
+    }
+    return 1;
+}
+
+int get_msqueue_nops(string filepath, int nr_threads, float duration, int init, optional<int> prob)
+{
+    remove(filepath.c_str());
+    auto pop = pool<msqueue>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+    persistent_ptr<msqueue> q = pop.root();
+    q->init(pop);
+
+    // Initailize
+    for (int i = 0; i < init; i++)
+    {
+        q->push(pop, i);
+    }
+
+    std::thread workers[nr_threads];
+    int local_ops[nr_threads];
+    latency_hist enq_hists[nr_threads];
+    latency_hist deq_hists[nr_threads];
+    int sum_ops = 0;
+
+    // Count the number of times the op is executed in `duration` seconds
+    for (int tid = 0; tid < nr_threads; tid++)
+    {
+        workers[tid] = std::thread(
+            [](
+                int tid, float duration, int &local_ops, pool<msqueue> pop, persistent_ptr<msqueue> q, optional<int> prob,
+                latency_hist &enq_hist, latency_hist &deq_hist)
+            {
+                pin_to(bench_pin_cpus, tid);
+                auto op = (!prob.has_value()) ? ms_op_pair : ms_op_prob;
+
+                local_ops = 0;
+                struct timespec begin, end;
+                clock_gettime(CLOCK_REALTIME, &begin);
+                while (true)
+                {
+                    clock_gettime(CLOCK_REALTIME, &end);
+                    long elapsed = end.tv_sec - begin.tv_sec;
+                    if (duration < elapsed)
+                    {
+                        break;
+                    }
+
+                    local_ops += op(pop, q, tid, prob, enq_hist, deq_hist);
+                }
+            },
+            tid, duration, std::ref(local_ops[tid]), pop, q, prob,
+            std::ref(enq_hists[tid]), std::ref(deq_hists[tid]));
+    }
+
+    for (int tid = 0; tid < nr_threads; ++tid)
+    {
+        workers[tid].join();
+        sum_ops += local_ops[tid];
+    }
+
+    latency_hist enq_all, deq_all;
+    for (int tid = 0; tid < nr_threads; ++tid)
+    {
+        enq_all.merge(enq_hists[tid]);
+        deq_all.merge(deq_hists[tid]);
+    }
+    double ns = tsc_ns_per_cycle();
+    if (enq_all.count > 0)
+        cout << "enq latency(ns): p50 " << enq_all.percentile(0.50) * ns
+             << " p90 " << enq_all.percentile(0.90) * ns
+             << " p99 " << enq_all.percentile(0.99) * ns
+             << " p999 " << enq_all.percentile(0.999) * ns << endl;
+    if (deq_all.count > 0)
+        cout << "deq latency(ns): p50 " << deq_all.percentile(0.50) * ns
+             << " p90 " << deq_all.percentile(0.90) * ns
+             << " p99 " << deq_all.percentile(0.99) * ns
+             << " p999 " << deq_all.percentile(0.999) * ns << endl;
+    return sum_ops;
+}
+
+int get_msqueue_recovery_nops(string filepath, int max_init)
+{
+    int n = max_init < 1000 ? max_init : 1000;
+    int total = 0;
+    while (true)
+    {
+        remove(filepath.c_str());
+        {
+            auto pop = pool<msqueue>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+            persistent_ptr<msqueue> q = pop.root();
+            q->init(pop);
+            for (int i = 0; i < n; i++)
+                q->push(pop, i);
+            pop.close();
+        }
+
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        auto pop = pool<msqueue>::open(filepath, "MY_LAYOUT");
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        auto v = pop.root()->pop(pop);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        pop.close();
+
+        cout << "recover init=" << n
+             << " reopen_us=" << elapsed_us(t0, t1)
+             << " first_deq_us=" << elapsed_us(t1, t2)
+             << " total_us=" << elapsed_us(t0, t2)
+             << (v.has_value() ? "" : " (empty)") << endl;
+
+        total += n;
+        if (n >= max_init)
+            break;
+        n = (n > max_init / 10) ? max_init : n * 10;
+    }
+    return total;
+}
@@ -0,0 +1,70 @@
+// #pragma once
+
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj.h>
+#include <optional>
+#include <iostream>
+#include "../common.hpp"
+
+using namespace pmem::obj;
+using namespace std;
+
+#ifndef PMDK_MSQUEUE
+#define PMDK_MSQUEUE
+
+// Durable Michael-Scott queue: lock-free CAS on persistent head/tail
+// with a per-node flush protocol, giving the harness a C++ target that
+// scales past the mutex-serialized `queue` (cf. friedman/ on the Rust
+// side). Head and tail are pool offsets so each fits in one CAS word.
+// The durable linking point is the predecessor's next field — it is
+// flushed before tail may move past it — while head and tail themselves
+// are flushed lazily: after a crash both are recovered by walking next
+// pointers from the last persisted head, re-offering any nodes whose
+// head advancement did not reach PM (at-least-once dequeue, as in the
+// published log-free durable variants). Dequeued nodes are not reused
+// during a run — reuse would need hazard tracking and reintroduce ABA
+// on the offset CAS — and the pool file is recreated per run, which is
+// where the space comes back.
+class msqueue
+{
+    struct node
+    {
+        uint64_t next; // pool offset of the successor, 0 = none
+        uint64_t value;
+    } __attribute((aligned(64)));
+
+private:
+    uint64_t head; // pool offset of the front (dummy) node
+    uint64_t tail; // pool offset of the rear node, possibly one behind
+    uint64_t pool_uuid;
+
+    node *direct(uint64_t off) const
+    {
+        PMEMoid oid = {pool_uuid, off};
+        return static_cast<node *>(pmemobj_direct(oid));
+    }
+    uint64_t alloc_node(PMEMobjpool *pop, uint64_t value);
+
+public:
+    // Installs the dummy node; call once on a freshly created pool
+    // before any worker starts.
+    void init(pool_base &pop);
+    void push(pool_base &pop, uint64_t value);
+    std::optional<int> pop(pool_base &pop);
+};
+
+#endif
+
+#ifndef PMDK_MSQUEUE_TEST
+#define PMDK_MSQUEUE_TEST
+
+int get_msqueue_nops(string filepath, int nr_threads, float duration, int init, optional<int> prob);
+
+// recover: same sweep as get_queue_recovery_nops. For this queue the
+// first dequeue also pays the lazy-tail catch-up the flush protocol
+// defers, so the number covers the whole durable-state repair.
+int get_msqueue_recovery_nops(string filepath, int max_init);
+
+#endif
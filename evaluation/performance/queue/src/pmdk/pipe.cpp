@@ -33,6 +33,140 @@ void pipe(pool<pipe_root> pop, persistent_ptr<queue> q1, persistent_ptr<queue> q
     }
 }
 
+void segqueue::push(pool_base &pop, uint64_t value)
+{
+    transaction::run(
+        pop, [&]
+        {
+            if (tail == nullptr || tail->tail == SEG_CAP)
+            {
+                auto seg = make_persistent<segment>();
+                seg->head = 0;
+                seg->tail = 0;
+                seg->next = nullptr;
+                if (tail == nullptr)
+                    head = tail = seg;
+                else
+                {
+                    tail->next = seg;
+                    tail = seg;
+                }
+            }
+            tail->vals[tail->tail] = value;
+            tail->tail = tail->tail + 1; },
+        pmutex);
+}
+
+std::optional<uint64_t> segqueue::pop(pool_base &pop)
+{
+    std::optional<uint64_t> value = std::nullopt;
+    transaction::run(
+        pop, [&]
+        {
+            if (head == nullptr || head->head == head->tail)
+            {
+                return; // EMPTY
+            }
+            value = head->vals[head->head];
+            head->head = head->head + 1;
+            if (head->head == SEG_CAP)
+            {
+                auto next = head->next;
+                delete_persistent<segment>(head);
+                head = next;
+                if (head == nullptr)
+                    tail = nullptr;
+            } },
+        pmutex);
+    return value;
+}
+
+bool segqueue::transfer(pool_base &pop, persistent_ptr<segqueue> from, persistent_ptr<segqueue> to)
+{
+    bool moved = false;
+    auto fn = [&]
+    {
+        auto seg = from->head;
+        if (seg == nullptr || seg->head == seg->tail)
+        {
+            return; // nothing to hand over
+        }
+        from->head = seg->next;
+        if (from->head == nullptr)
+            from->tail = nullptr;
+        seg->next = nullptr;
+        if (to->tail == nullptr)
+            to->head = to->tail = seg;
+        else
+        {
+            to->tail->next = seg;
+            to->tail = seg;
+        }
+        moved = true;
+    };
+    // Both stage locks are taken inside the transaction; address order
+    // keeps opposite-direction transfers from deadlocking.
+    if (from.get() < to.get())
+        transaction::run(pop, fn, from->pmutex, to->pmutex);
+    else
+        transaction::run(pop, fn, to->pmutex, from->pmutex);
+    return moved;
+}
+
+size_t segqueue::move_n(pool_base &pop, persistent_ptr<segqueue> from, persistent_ptr<segqueue> to,
+                        size_t n, const std::function<uint64_t(uint64_t)> &xform)
+{
+    size_t moved = 0;
+    // Pop and push are inlined rather than calling push()/pop(): both
+    // stage locks are already held by the transaction, and the per-item
+    // lock/commit cost is exactly what batching is meant to amortize.
+    auto fn = [&]
+    {
+        while (moved < n)
+        {
+            auto seg = from->head;
+            if (seg == nullptr || seg->head == seg->tail)
+            {
+                break; // source drained
+            }
+            uint64_t v = xform(seg->vals[seg->head]);
+            seg->head = seg->head + 1;
+            if (seg->head == SEG_CAP)
+            {
+                auto next = seg->next;
+                delete_persistent<segment>(seg);
+                from->head = next;
+                if (from->head == nullptr)
+                    from->tail = nullptr;
+            }
+
+            if (to->tail == nullptr || to->tail->tail == SEG_CAP)
+            {
+                auto nseg = make_persistent<segment>();
+                nseg->head = 0;
+                nseg->tail = 0;
+                nseg->next = nullptr;
+                if (to->tail == nullptr)
+                    to->head = to->tail = nseg;
+                else
+                {
+                    to->tail->next = nseg;
+                    to->tail = nseg;
+                }
+            }
+            to->tail->vals[to->tail->tail] = v;
+            to->tail->tail = to->tail->tail + 1;
+            moved++;
+        }
+    };
+    // Same lock-ordering rule as transfer().
+    if (from.get() < to.get())
+        transaction::run(pop, fn, from->pmutex, to->pmutex);
+    else
+        transaction::run(pop, fn, to->pmutex, from->pmutex);
+    return moved;
+}
+
 int get_pipe_nops(string filepath, int nr_threads, float duration, int init)
 {
     remove(filepath.c_str());
@@ -61,6 +195,7 @@ int get_pipe_nops(string filepath, int nr_threads, float duration, int init)
         workers[tid] = std::thread(
             [](int tid, float duration, int &local_ops, pool<pipe_root> pop, persistent_ptr<queue> q1, persistent_ptr<queue> q2)
             {
+                pin_to(bench_pin_cpus, tid);
                 local_ops = 0;
                 struct timespec begin, end;
                 clock_gettime(CLOCK_REALTIME, &begin);
@@ -87,3 +222,196 @@ int get_pipe_nops(string filepath, int nr_threads, float duration, int init)
     }
     return sum_ops;
 }
+
+int get_pipe_seg_nops(string filepath, int nr_threads, float duration, int init)
+{
+    remove(filepath.c_str());
+    auto pop = pool<pipe_seg_root>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+    persistent_ptr<pipe_seg_root> q_manager = pop.root();
+
+    // Initialize
+    transaction::run(
+        pop, [&]
+        {
+            q_manager->q1 = make_persistent<segqueue>();
+            q_manager->q2 = make_persistent<segqueue>(); });
+    persistent_ptr<segqueue> q1 = q_manager->q1;
+    persistent_ptr<segqueue> q2 = q_manager->q2;
+    for (int i = 0; i < init; i++)
+    {
+        q1->push(pop, i);
+    }
+
+    std::thread workers[nr_threads];
+    int local_ops[nr_threads];
+    int sum_ops = 0;
+
+    // One op = one segment handed from stage 1 to stage 2 (SEG_CAP
+    // items, zero copies). When stage 1 runs dry the segments are
+    // relinked back from stage 2, so the pipeline stays primed for the
+    // whole measured duration instead of draining once.
+    for (int tid = 0; tid < nr_threads; tid++)
+    {
+        workers[tid] = std::thread(
+            [](int tid, float duration, int &local_ops, pool<pipe_seg_root> pop, persistent_ptr<segqueue> q1, persistent_ptr<segqueue> q2)
+            {
+                pin_to(bench_pin_cpus, tid);
+                local_ops = 0;
+                struct timespec begin, end;
+                clock_gettime(CLOCK_REALTIME, &begin);
+                while (true)
+                {
+                    clock_gettime(CLOCK_REALTIME, &end);
+                    long elapsed = end.tv_sec - begin.tv_sec;
+                    if (duration < elapsed)
+                    {
+                        break;
+                    }
+
+                    if (segqueue::transfer(pop, q1, q2))
+                    {
+                        local_ops += 1;
+                    }
+                    else
+                    {
+                        segqueue::transfer(pop, q2, q1);
+                    }
+                }
+            },
+            tid, duration, std::ref(local_ops[tid]), pop, q1, q2);
+    }
+
+    for (int tid = 0; tid < nr_threads; ++tid)
+    {
+        workers[tid].join();
+        sum_ops += local_ops[tid];
+    }
+    return sum_ops;
+}
+
+int get_pipe_k_nops(string filepath, int nr_threads, float duration, int init, int stages, int batch)
+{
+    if (stages < 2 || stages > PIPE_MAX_STAGES)
+    {
+        cerr << "pipe-k: stages must be in [2, " << PIPE_MAX_STAGES << "]" << endl;
+        exit(0);
+    }
+    remove(filepath.c_str());
+    auto pop = pool<pipe_k_root>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+    persistent_ptr<pipe_k_root> q_manager = pop.root();
+
+    // Initialize: all items start in stage 0 with a zero stamp, so the
+    // first (partial) traversal never lands in the latency histogram.
+    transaction::run(
+        pop, [&]
+        {
+            for (int s = 0; s < stages; s++)
+                q_manager->qs[s] = make_persistent<segqueue>(); });
+    for (int i = 0; i < init; i++)
+    {
+        q_manager->qs[0]->push(pop, 0);
+    }
+
+    // Per-stage occupancy, fed by the workers and sampled by a monitor;
+    // the stage whose queue grows is the pipeline's bottleneck.
+    std::atomic<long> occupancy[PIPE_MAX_STAGES];
+    for (int s = 0; s < stages; s++)
+        occupancy[s] = 0;
+    occupancy[0] = init;
+    std::atomic<bool> stop{false};
+    std::thread monitor(
+        [&]
+        {
+            int t = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                usleep(100000);
+                cout << "occupancy@" << ++t * 100 << "ms:";
+                for (int s = 0; s < stages; s++)
+                    cout << " " << occupancy[s].load(std::memory_order_relaxed);
+                cout << endl;
+            }
+        });
+
+    std::thread workers[nr_threads];
+    int local_ops[nr_threads];
+    latency_hist e2e_hists[nr_threads];
+    int sum_ops = 0;
+
+    // Stage s moves items from qs[s] to qs[(s+1) % stages] in batches
+    // of `batch` per transaction. Stage 0 stamps each item with the
+    // TSC; the last stage, which closes the ring, records now - stamp:
+    // the end-to-end latency of one traversal through every hand-off.
+    // One op = one item completing the ring at the last stage.
+    for (int tid = 0; tid < nr_threads; tid++)
+    {
+        int stage = tid % stages;
+        workers[tid] = std::thread(
+            [&, tid, stage]
+            {
+                pin_to(bench_pin_cpus, tid);
+                local_ops[tid] = 0;
+                persistent_ptr<segqueue> src = q_manager->qs[stage];
+                persistent_ptr<segqueue> dst = q_manager->qs[(stage + 1) % stages];
+
+                std::function<uint64_t(uint64_t)> xform;
+                if (stage == 0)
+                {
+                    xform = [](uint64_t) { return rdtsc_now(); };
+                }
+                else if (stage == stages - 1)
+                {
+                    xform = [&](uint64_t v)
+                    {
+                        if (v != 0)
+                            e2e_hists[tid].add(rdtsc_now() - v);
+                        return v;
+                    };
+                }
+                else
+                {
+                    xform = [](uint64_t v) { return v; };
+                }
+
+                struct timespec begin, end;
+                clock_gettime(CLOCK_REALTIME, &begin);
+                while (true)
+                {
+                    clock_gettime(CLOCK_REALTIME, &end);
+                    long elapsed = end.tv_sec - begin.tv_sec;
+                    if (duration < elapsed)
+                    {
+                        break;
+                    }
+
+                    size_t moved = segqueue::move_n(pop, src, dst, batch, xform);
+                    if (moved > 0)
+                    {
+                        occupancy[stage].fetch_sub(moved, std::memory_order_relaxed);
+                        occupancy[(stage + 1) % stages].fetch_add(moved, std::memory_order_relaxed);
+                        if (stage == stages - 1)
+                            local_ops[tid] += moved;
+                    }
+                }
+            });
+    }
+
+    for (int tid = 0; tid < nr_threads; ++tid)
+    {
+        workers[tid].join();
+        sum_ops += local_ops[tid];
+    }
+    stop.store(true);
+    monitor.join();
+
+    latency_hist e2e_all;
+    for (int tid = 0; tid < nr_threads; ++tid)
+        e2e_all.merge(e2e_hists[tid]);
+    double ns = tsc_ns_per_cycle();
+    if (e2e_all.count > 0)
+        cout << "e2e latency(ns): p50 " << e2e_all.percentile(0.50) * ns
+             << " p90 " << e2e_all.percentile(0.90) * ns
+             << " p99 " << e2e_all.percentile(0.99) * ns
+             << " p999 " << e2e_all.percentile(0.999) * ns << endl;
+    return sum_ops;
+}
@@ -1,5 +1,7 @@
 #include "queue.hpp"
 #include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/mutex.hpp>
+#include <functional>
 #include "../common.hpp"
 
 using namespace pmem::obj;
@@ -13,3 +15,65 @@ struct pipe_root {
 void pipe(pool<pipe_root> pop, persistent_ptr<queue> q1, persistent_ptr<queue> q2);
 
 int get_pipe_nops(std::string filepath, int nr_thread, float duration, int init);
+
+#ifndef PMDK_SEGQUEUE
+#define PMDK_SEGQUEUE
+
+#define SEG_CAP 64
+
+// Queue of fixed-size ring-buffer segments. Values live inside the
+// segments, so a pipeline stage can move a whole segment to the next
+// stage by relinking three pointers — no per-item pop/push, copy, or
+// reallocation — which is what the "-seg" pipe mode measures.
+class segqueue
+{
+    struct segment
+    {
+        p<uint64_t> vals[SEG_CAP];
+        p<uint32_t> head; // consume index
+        p<uint32_t> tail; // produce index
+        persistent_ptr<segment> next;
+    };
+
+    pmem::obj::mutex pmutex;
+    persistent_ptr<segment> head;
+    persistent_ptr<segment> tail;
+
+public:
+    void push(pool_base &pop, uint64_t value);
+    std::optional<uint64_t> pop(pool_base &pop);
+    // Relink the head segment of `from` onto the tail of `to` under one
+    // transaction; the payload is never touched. Returns false when
+    // `from` has nothing to hand over.
+    static bool transfer(pool_base &pop, persistent_ptr<segqueue> from, persistent_ptr<segqueue> to);
+    // Move up to n items from `from` to `to` under one transaction, so
+    // a batched hand-off pays one undo log and one commit fence for the
+    // whole batch. Each value passes through `xform` on the way over
+    // (stages use it to stamp or inspect items); returns how many items
+    // actually moved.
+    static size_t move_n(pool_base &pop, persistent_ptr<segqueue> from, persistent_ptr<segqueue> to,
+                         size_t n, const std::function<uint64_t(uint64_t)> &xform);
+};
+
+struct pipe_seg_root {
+   persistent_ptr<segqueue> q1;
+   persistent_ptr<segqueue> q2;
+};
+
+int get_pipe_seg_nops(std::string filepath, int nr_thread, float duration, int init);
+
+#define PIPE_MAX_STAGES 16
+
+struct pipe_k_root {
+   persistent_ptr<segqueue> qs[PIPE_MAX_STAGES];
+};
+
+// K-stage pipeline: stage s (threads with tid % K == s) moves items
+// from queue s to queue (s+1) % K in batches of `batch` per
+// transaction. The ring keeps the pipeline primed for the whole run;
+// stage 0 stamps items with the TSC and the last stage records the
+// end-to-end latency of a full traversal. A monitor samples per-stage
+// occupancy every 100ms, which is where a bottleneck stage shows up.
+int get_pipe_k_nops(std::string filepath, int nr_thread, float duration, int init, int stages, int batch);
+
+#endif
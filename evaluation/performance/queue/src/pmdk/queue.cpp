@@ -11,12 +11,66 @@
 using namespace pmem::obj;
 using namespace std;
 
+queue::node_pool &queue::my_pool()
+{
+    // Slots are handed out once per thread; with more threads than
+    // slots two threads may share a pool, which is safe (all access is
+    // transactional) and only costs some free-list locality.
+    static std::atomic<int> next_slot{0};
+    static thread_local int slot = -1;
+    if (slot < 0)
+        slot = next_slot.fetch_add(1) % QUEUE_POOL_THREADS;
+    return pools[slot];
+}
+
+void queue::reserve(pool_base &pop, node_pool &pl, size_t want)
+{
+    if (pl.free != nullptr)
+        return;
+    if (pl.slab != nullptr && pl.slab_next + want <= QUEUE_SLAB)
+        return;
+    transaction::run(
+        pop, [&]
+        {
+            // Any unconsumed tail of the old slab moves to the free
+            // list before the slab pointer is dropped, so no node ever
+            // becomes unreachable.
+            while (pl.slab != nullptr && pl.slab_next < QUEUE_SLAB)
+            {
+                persistent_ptr<node> n = &pl.slab[pl.slab_next];
+                pl.slab_next = pl.slab_next + 1;
+                n->next = pl.free;
+                pl.free = n;
+            }
+            pl.slab = make_persistent<node[]>(QUEUE_SLAB);
+            pl.slab_next = 0; });
+}
+
+persistent_ptr<queue::node> queue::take(node_pool &pl)
+{
+    if (pl.free != nullptr)
+    {
+        auto n = pl.free;
+        pl.free = n->next;
+        return n;
+    }
+    if (pl.slab != nullptr && pl.slab_next < QUEUE_SLAB)
+    {
+        persistent_ptr<node> n = &pl.slab[pl.slab_next];
+        pl.slab_next = pl.slab_next + 1;
+        return n;
+    }
+    return make_persistent<node>();
+}
+
 void queue::push(pool_base &pop, uint64_t value)
 {
+    node_pool &pl = my_pool();
+    reserve(pop, pl, 1);
     transaction::run(
         pop, [&]
         {
-            auto n = make_persistent<node>();
+            auto n = take(pl);
             n->value = value;
             n->next = nullptr;
             if (head == nullptr && tail == nullptr)
@@ -34,6 +88,7 @@ void queue::push(pool_base &pop, uint64_t value)
 std::optional<int> queue::pop(pool_base &pop)
 {
     std::optional<int> value = std::nullopt;
+    node_pool &pl = my_pool();
     transaction::run(
         pop, [&]
         {
@@ -43,7 +98,10 @@ std::optional<int> queue::pop(pool_base &pop)
             }
             value = head->value;
             auto next = head->next;
-            delete_persistent<node>(head);
+            // Recycle onto this thread's free list instead of freeing,
+            // so a later push links it without touching the allocator.
+            head->next = pl.free;
+            pl.free = head;
             head = next;
             if (head == nullptr)
                 tail = nullptr; },
@@ -51,6 +109,82 @@ std::optional<int> queue::pop(pool_base &pop)
     return value;
 }
 
+void queue::push_n(pool_base &pop, uint64_t value, size_t n)
+{
+    node_pool &pl = my_pool();
+    reserve(pop, pl, n);
+    transaction::run(
+        pop, [&]
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                auto nd = take(pl);
+                nd->value = value;
+                nd->next = nullptr;
+                if (head == nullptr && tail == nullptr)
+                {
+                    head = tail = nd;
+                }
+                else
+                {
+                    tail->next = nd;
+                    tail = nd;
+                }
+            } },
+        pmutex);
+}
+
+size_t queue::pop_n(pool_base &pop, size_t n)
+{
+    size_t popped = 0;
+    node_pool &pl = my_pool();
+    transaction::run(
+        pop, [&]
+        {
+            while (popped < n && head != nullptr)
+            {
+                auto next = head->next;
+                head->next = pl.free;
+                pl.free = head;
+                head = next;
+                popped++;
+            }
+            if (head == nullptr)
+                tail = nullptr; },
+        pmutex);
+    return popped;
+}
+
+size_t queue::drain(pool_base &pop, const std::function<void(int)> &f)
+{
+    node_pool &pl = my_pool();
+    persistent_ptr<node> first = nullptr;
+    persistent_ptr<node> stop = nullptr;
+    transaction::run(
+        pop, [&]
+        {
+            if (head == nullptr)
+                return;
+            first = head;
+            stop = pl.free;
+            // Splice before iterating: only this thread's pushes
+            // consume the free list, so the values stay intact while
+            // the walk runs outside the lock.
+            tail->next = pl.free;
+            pl.free = first;
+            head = nullptr;
+            tail = nullptr; },
+        pmutex);
+
+    size_t drained = 0;
+    for (auto n = first; n != stop; n = n->next)
+    {
+        f(n->value);
+        drained++;
+    }
+    return drained;
+}
+
 void queue::show(void) const
 {
     for (auto n = head; n != nullptr; n = n->next)
@@ -63,27 +197,56 @@ bool pick(int prob)
     return (rand() % 100) < prob;
 }
 
-// pair: {enq; deq;}
-void op_pair(pool<queue> pop, persistent_ptr<queue> q, int tid, optional<int> prob)
+// pair: {enq; deq;} — with batch > 1, {enq xN; deq xN;} under one
+// transaction each; returns how many pairs were executed so batched and
+// unbatched runs report per-pair throughput on the same scale. Enqueue
+// and dequeue latencies are recorded separately: under
+// producer/consumer imbalance their tails diverge, and the combined
+// number hides exactly the side we tune.
+int op_pair(pool<queue> pop, persistent_ptr<queue> q, int tid, optional<int> prob, int batch,
+            latency_hist &enq_hist, latency_hist &deq_hist)
 {
-    q->push(pop, tid);
-    q->pop(pop);
+    auto t0 = rdtsc_now();
+    if (batch == 1)
+        q->push(pop, tid);
+    else
+        q->push_n(pop, tid, batch);
+    auto t1 = rdtsc_now();
+    enq_hist.add(t1 - t0);
+    if (batch == 1)
+        q->pop(pop);
+    else
+        q->pop_n(pop, batch);
+    deq_hist.add(rdtsc_now() - t1);
+    return batch;
 }
 
-// prob{n}: { n% enq; or (100-n)% deq; }
-void op_prob(pool<queue> pop, persistent_ptr<queue> q, int tid, optional<int> prob)
+// prob{n}: { n% enq; or (100-n)% deq; } — with batch > 1 each pick
+// enqueues or dequeues a whole batch in one transaction.
+int op_prob(pool<queue> pop, persistent_ptr<queue> q, int tid, optional<int> prob, int batch,
+            latency_hist &enq_hist, latency_hist &deq_hist)
 {
+    auto t0 = rdtsc_now();
     if (pick(prob.value()))
     {
-        q->push(pop, tid);
+        if (batch == 1)
+            q->push(pop, tid);
+        else
+            q->push_n(pop, tid, batch);
+        enq_hist.add(rdtsc_now() - t0);
     }
     else
     {
-        q->pop(pop);
+        if (batch == 1)
+            q->pop(pop);
+        else
+            q->pop_n(pop, batch);
+        deq_hist.add(rdtsc_now() - t0);
     }
+    return batch;
 }
 
-int get_queue_nops(string filepath, int nr_threads, float duration, int init, optional<int> prob)
+int get_queue_nops(string filepath, int nr_threads, float duration, int init, optional<int> prob, int batch)
 {
     remove(filepath.c_str());
     auto pop = pool<queue>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
@@ -97,6 +260,8 @@ int get_queue_nops(string filepath, int nr_threads, float duration, int init, op
 
     std::thread workers[nr_threads];
     int local_ops[nr_threads];
+    latency_hist enq_hists[nr_threads];
+    latency_hist deq_hists[nr_threads];
     int sum_ops = 0;
 
     // Count the number of times the op is executed in `duration` seconds
@@ -104,8 +269,10 @@ int get_queue_nops(string filepath, int nr_threads, float duration, int init, op
     {
         workers[tid] = std::thread(
             [](
-                int tid, float duration, int &local_ops, pool<queue> pop, persistent_ptr<queue> q, optional<int> prob)
+                int tid, float duration, int &local_ops, pool<queue> pop, persistent_ptr<queue> q, optional<int> prob, int batch,
+                latency_hist &enq_hist, latency_hist &deq_hist)
             {
+                pin_to(bench_pin_cpus, tid);
                 auto op = (!prob.has_value()) ? op_pair : op_prob;
 
                 local_ops = 0;
@@ -120,11 +287,11 @@ int get_queue_nops(string filepath, int nr_threads, float duration, int init, op
                         break;
                     }
 
-                    op(pop, q, tid, prob);
-                    local_ops += 1;
+                    local_ops += op(pop, q, tid, prob, batch, enq_hist, deq_hist);
                 }
             },
-            tid, duration, std::ref(local_ops[tid]), pop, q, prob);
+            tid, duration, std::ref(local_ops[tid]), pop, q, prob, batch,
+            std::ref(enq_hists[tid]), std::ref(deq_hists[tid]));
     }
 
     for (int tid = 0; tid < nr_threads; ++tid)
@@ -132,5 +299,289 @@ int get_queue_nops(string filepath, int nr_threads, float duration, int init, op
         workers[tid].join();
         sum_ops += local_ops[tid];
     }
+
+    latency_hist enq_all, deq_all;
+    for (int tid = 0; tid < nr_threads; ++tid)
+    {
+        enq_all.merge(enq_hists[tid]);
+        deq_all.merge(deq_hists[tid]);
+    }
+    double ns = tsc_ns_per_cycle();
+    if (enq_all.count > 0)
+        cout << "enq latency(ns): p50 " << enq_all.percentile(0.50) * ns
+             << " p90 " << enq_all.percentile(0.90) * ns
+             << " p99 " << enq_all.percentile(0.99) * ns
+             << " p999 " << enq_all.percentile(0.999) * ns << endl;
+    if (deq_all.count > 0)
+        cout << "deq latency(ns): p50 " << deq_all.percentile(0.50) * ns
+             << " p90 " << deq_all.percentile(0.90) * ns
+             << " p99 " << deq_all.percentile(0.99) * ns
+             << " p999 " << deq_all.percentile(0.999) * ns << endl;
     return sum_ops;
 }
+
+int get_queue_topo_nops(string filepath, int nr_threads, float duration, int init, int prod_ratio, int cons_ratio, long rate)
+{
+    remove(filepath.c_str());
+    auto pop = pool<queue>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+    persistent_ptr<queue> q = pop.root();
+
+    // Initailize
+    for (int i = 0; i < init; i++)
+    {
+        q->push(pop, i);
+    }
+
+    // Thread split by ratio, both sides at least one thread.
+    int producers = (int)((long)nr_threads * prod_ratio / (prod_ratio + cons_ratio));
+    if (producers < 1)
+        producers = 1;
+    if (producers > nr_threads - 1)
+        producers = nr_threads - 1;
+    cout << "topology: " << producers << " producers / "
+         << nr_threads - producers << " consumers";
+    if (rate > 0)
+        cout << ", " << rate << " enq/s per producer";
+    cout << endl;
+
+    std::atomic<long> depth{(long)init};
+    std::atomic<bool> stop{false};
+
+    // Depth-over-time monitor: one sample per 100ms on a counter fed by
+    // the workers. The series (and its maximum) is the backlog the
+    // consumers carry under imbalance, which per-op latency hides.
+    std::thread monitor(
+        [&]
+        {
+            int t = 0;
+            long max_depth = depth.load();
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                usleep(100000);
+                long d = depth.load(std::memory_order_relaxed);
+                if (d > max_depth)
+                    max_depth = d;
+                cout << "depth@" << ++t * 100 << "ms: " << d << endl;
+            }
+            cout << "max depth: " << max_depth << endl;
+        });
+
+    std::thread workers[nr_threads];
+    int local_ops[nr_threads];
+    latency_hist enq_hists[nr_threads];
+    latency_hist deq_hists[nr_threads];
+    int sum_ops = 0;
+
+    for (int tid = 0; tid < nr_threads; tid++)
+    {
+        bool producer = tid < producers;
+        workers[tid] = std::thread(
+            [&, tid, producer]
+            {
+                pin_to(bench_pin_cpus, tid);
+                local_ops[tid] = 0;
+
+                // Token bucket: refilled continuously at `rate`
+                // tokens/s and capped at 100ms worth, so a producer
+                // that fell behind releases its backlog as a burst
+                // rather than a smoothed stream.
+                double tokens = 0;
+                double burst = rate > 0 ? rate / 10.0 : 0;
+                double cycles_per_token =
+                    rate > 0 ? 1e9 / (tsc_ns_per_cycle() * rate) : 0;
+                uint64_t last_tsc = rdtsc_now();
+
+                struct timespec begin, end;
+                clock_gettime(CLOCK_REALTIME, &begin);
+                while (true)
+                {
+                    clock_gettime(CLOCK_REALTIME, &end);
+                    long elapsed = end.tv_sec - begin.tv_sec;
+                    if (duration < elapsed)
+                    {
+                        break;
+                    }
+
+                    if (producer)
+                    {
+                        if (rate > 0)
+                        {
+                            uint64_t now = rdtsc_now();
+                            tokens += (now - last_tsc) / cycles_per_token;
+                            if (tokens > burst)
+                                tokens = burst;
+                            last_tsc = now;
+                            if (tokens < 1)
+                            {
+                                _mm_pause();
+                                continue;
+                            }
+                            tokens -= 1;
+                        }
+                        auto t0 = rdtsc_now();
+                        q->push(pop, tid);
+                        enq_hists[tid].add(rdtsc_now() - t0);
+                        depth.fetch_add(1, std::memory_order_relaxed);
+                        local_ops[tid]++;
+                    }
+                    else
+                    {
+                        auto t0 = rdtsc_now();
+                        auto v = q->pop(pop);
+                        // Empty pops count as neither work nor latency,
+                        // so a drained queue doesn't inflate throughput.
+                        if (v.has_value())
+                        {
+                            deq_hists[tid].add(rdtsc_now() - t0);
+                            depth.fetch_sub(1, std::memory_order_relaxed);
+                            local_ops[tid]++;
+                        }
+                    }
+                }
+            });
+    }
+
+    for (int tid = 0; tid < nr_threads; ++tid)
+    {
+        workers[tid].join();
+        sum_ops += local_ops[tid];
+    }
+    stop.store(true);
+    monitor.join();
+
+    latency_hist enq_all, deq_all;
+    for (int tid = 0; tid < nr_threads; ++tid)
+    {
+        enq_all.merge(enq_hists[tid]);
+        deq_all.merge(deq_hists[tid]);
+    }
+    double ns = tsc_ns_per_cycle();
+    if (enq_all.count > 0)
+        cout << "enq latency(ns): p50 " << enq_all.percentile(0.50) * ns
+             << " p90 " << enq_all.percentile(0.90) * ns
+             << " p99 " << enq_all.percentile(0.99) * ns
+             << " p999 " << enq_all.percentile(0.999) * ns << endl;
+    if (deq_all.count > 0)
+        cout << "deq latency(ns): p50 " << deq_all.percentile(0.50) * ns
+             << " p90 " << deq_all.percentile(0.90) * ns
+             << " p99 " << deq_all.percentile(0.99) * ns
+             << " p999 " << deq_all.percentile(0.999) * ns << endl;
+    return sum_ops;
+}
+
+int get_queue_recovery_nops(string filepath, int max_init)
+{
+    int n = max_init < 1000 ? max_init : 1000;
+    int total = 0;
+    while (true)
+    {
+        remove(filepath.c_str());
+        {
+            auto pop = pool<queue>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+            persistent_ptr<queue> q = pop.root();
+            for (int i = 0; i < n; i++)
+                q->push(pop, i);
+            pop.close();
+        }
+
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        auto pop = pool<queue>::open(filepath, "MY_LAYOUT");
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        auto v = pop.root()->pop(pop);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        pop.close();
+
+        cout << "recover init=" << n
+             << " reopen_us=" << elapsed_us(t0, t1)
+             << " first_deq_us=" << elapsed_us(t1, t2)
+             << " total_us=" << elapsed_us(t0, t2)
+             << (v.has_value() ? "" : " (empty)") << endl;
+
+        total += n;
+        if (n >= max_init)
+            break;
+        n = (n > max_init / 10) ? max_init : n * 10;
+    }
+    return total;
+}
+
+int get_queue_drain_nops(string filepath, int nr_threads, float duration, int init)
+{
+    remove(filepath.c_str());
+    auto pop = pool<queue>::create(filepath, "MY_LAYOUT", ((size_t)POOL_SIZE));
+    persistent_ptr<queue> q = pop.root();
+
+    // Initailize
+    for (int i = 0; i < init; i++)
+    {
+        q->push(pop, i);
+    }
+
+    int producers = nr_threads > 1 ? nr_threads - 1 : 0;
+    std::thread workers[nr_threads];
+
+    // Producers keep refilling the backlog the drainer detaches.
+    for (int tid = 0; tid < producers; tid++)
+    {
+        workers[tid] = std::thread(
+            [](int tid, float duration, pool<queue> pop, persistent_ptr<queue> q)
+            {
+                pin_to(bench_pin_cpus, tid);
+                struct timespec begin, end;
+                clock_gettime(CLOCK_REALTIME, &begin);
+                while (true)
+                {
+                    clock_gettime(CLOCK_REALTIME, &end);
+                    long elapsed = end.tv_sec - begin.tv_sec;
+                    if (duration < elapsed)
+                    {
+                        break;
+                    }
+                    q->push(pop, tid);
+                }
+            },
+            tid, duration, pop, q);
+    }
+
+    long drained = 0;
+    long calls = 0;
+    long checksum = 0;
+    latency_hist drain_hist;
+    workers[nr_threads - 1] = std::thread(
+        [&](int tid, float duration, pool<queue> pop, persistent_ptr<queue> q)
+        {
+            pin_to(bench_pin_cpus, tid);
+            struct timespec begin, end;
+            clock_gettime(CLOCK_REALTIME, &begin);
+            while (true)
+            {
+                clock_gettime(CLOCK_REALTIME, &end);
+                long elapsed = end.tv_sec - begin.tv_sec;
+                if (duration < elapsed)
+                {
+                    break;
+                }
+                auto t0 = rdtsc_now();
+                drained += q->drain(pop, [&](int v)
+                                    { checksum += v; });
+                drain_hist.add(rdtsc_now() - t0);
+                calls++;
+            }
+        },
+        nr_threads - 1, duration, pop, q);
+
+    for (int tid = producers > 0 ? 0 : nr_threads - 1; tid < nr_threads; ++tid)
+        workers[tid].join();
+
+    double ns = tsc_ns_per_cycle();
+    cout << "drain: " << calls << " calls, avg batch "
+         << (calls > 0 ? drained / calls : 0)
+         << " (checksum " << checksum << ")" << endl;
+    if (drain_hist.count > 0)
+        cout << "drain latency(ns): p50 " << drain_hist.percentile(0.50) * ns
+             << " p90 " << drain_hist.percentile(0.90) * ns
+             << " p99 " << drain_hist.percentile(0.99) * ns
+             << " p999 " << drain_hist.percentile(0.999) * ns << endl;
+    return (int)drained;
+}
@@ -6,6 +6,7 @@
 #include <libpmemobj++/pool.hpp>
 #include <libpmemobj++/transaction.hpp>
 #include <libpmemobj++/mutex.hpp>
+#include <functional>
 #include <iostream>
 #include "../common.hpp"
 
@@ -15,6 +16,9 @@ using namespace std;
 #ifndef PMDK_QUEUE
 #define PMDK_QUEUE
 
+#define QUEUE_POOL_THREADS 64
+#define QUEUE_SLAB 1024
+
 class queue
 {
     struct node
@@ -23,14 +27,54 @@ class queue
         persistent_ptr<node> next;
     } __attribute((aligned(128)));
 
+    // Per-thread persistent node pool: nodes come from pre-carved slabs
+    // and popped nodes recycle through the popping thread's free list,
+    // so the enqueue transaction only links and flushes instead of
+    // paying the pmemobj allocator inside the critical section. All
+    // pool mutations run inside transactions, so a crash leaves every
+    // node reachable from the root (in the queue, on a free list, or in
+    // an unconsumed slab slot) — nothing leaks and nothing doubles.
+    struct node_pool
+    {
+        persistent_ptr<node> free;   // recycled nodes, linked via next
+        persistent_ptr<node[]> slab; // current slab, carved in order
+        p<size_t> slab_next;         // first unconsumed slab slot
+    } __attribute((aligned(128)));
+
 private:
     pmem::obj::mutex pmutex;
     persistent_ptr<node> head;
     persistent_ptr<node> tail;
+    node_pool pools[QUEUE_POOL_THREADS];
+
+    node_pool &my_pool();
+    // Carves a fresh slab in its own transaction when the caller's pool
+    // cannot serve `want` more nodes; called before the locked enqueue
+    // transaction so allocator work stays off the critical path.
+    void reserve(pool_base &pop, node_pool &pl, size_t want);
+    // Hands out one node inside the enqueue transaction: free list
+    // first, then the slab cursor, falling back to make_persistent only
+    // when reserve() could not keep up (e.g. batches beyond QUEUE_SLAB).
+    persistent_ptr<node> take(node_pool &pl);
 
 public:
     void push(pool_base &pop, uint64_t value);
     std::optional<int> pop(pool_base &pop);
+    // Batched variants: n nodes are allocated/freed and linked under a
+    // single transaction, so the undo-log setup and commit fence are
+    // paid once per batch instead of once per node. pop_n returns how
+    // many nodes were actually popped (the queue may drain first).
+    void push_n(pool_base &pop, uint64_t value, size_t n);
+    size_t pop_n(pool_base &pop, size_t n);
+    // Pop-all: one constant-size transaction detaches the whole chain
+    // and splices it onto the calling thread's free list; `f` then runs
+    // over the detached values outside the lock, with node reclamation
+    // already done (free-list nodes relink on later pushes). The chain
+    // stays reachable from the root throughout, so a crash mid-iteration
+    // leaks nothing, and only this thread's own pushes can reuse the
+    // nodes — which cannot happen before drain returns. Returns the
+    // number of items drained.
+    size_t drain(pool_base &pop, const std::function<void(int)> &f);
     void show(void) const;
 };
 
@@ -39,6 +83,27 @@ public:
 #ifndef PMDK_QUEUE_TEST
 #define PMDK_QUEUE_TEST
 
-int get_queue_nops(string filepath, int nr_threads, float duration, int init, optional<int> prob);
+int get_queue_nops(string filepath, int nr_threads, float duration, int init, optional<int> prob, int batch = 1);
+
+// topo{P}:{C}[-r{rate}]: fixed producer/consumer split in the given
+// ratio instead of every thread doing both sides, with an optional
+// token-bucket cap of `rate` enqueues/s per producer (bucket holds
+// 100ms of tokens, so arrivals are released in bursts). A monitor
+// samples queue depth every 100ms — the consumer-side backlog under
+// imbalance that the symmetric kinds average away.
+int get_queue_topo_nops(string filepath, int nr_threads, float duration, int init, int prod_ratio, int cons_ratio, long rate);
+
+// recover: builds a backlog of N nodes, closes the pool, then times
+// reopen plus the first successful dequeue — the failover path. N is
+// swept in decades up to `max_init` (one "recover init=..." line per
+// point), giving a recovery-latency-vs-backlog curve from one run.
+int get_queue_recovery_nops(string filepath, int max_init);
+
+// drain: one consumer detaches the whole backlog per queue::drain call
+// while the remaining threads keep pushing; prints calls, average
+// batch and per-drain latency, and returns total items drained —
+// pop-all throughput to hold against the per-item pop transactions of
+// the other kinds.
+int get_queue_drain_nops(string filepath, int nr_threads, float duration, int init);
 
 #endif
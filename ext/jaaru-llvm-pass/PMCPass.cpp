@@ -23,6 +23,7 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Analysis/CaptureTracking.h"
 #include "llvm/IR/BasicBlock.h"
@@ -39,7 +40,9 @@
 #include "llvm/ProfileData/InstrProf.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/AtomicOrdering.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/EscapeEnumerator.h"
@@ -51,6 +54,14 @@ using namespace llvm;
 #include <llvm/IR/DebugLoc.h>
 
 #define ENABLEATOMIC
+/* Record clflush/clwb events in an inlined thread-local buffer and only
+ * call into the runtime when it fills or at the next fence, instead of
+ * one libcall per flush. Epoch persistency models order flushes at the
+ * fence anyway, so draining there loses nothing. Requires the runtime
+ * to provide pmc_flush_batch() and the __pmc_flush_buf/__pmc_flush_cnt
+ * thread-locals; comment this out to fall back to per-flush calls.
+ */
+#define INLINE_FLUSH_BUFFER
 
 enum NVMOP {
 	NVM_CLWB,
@@ -87,6 +98,41 @@ STATISTIC(NumOmittedReadsFromConstantGlobals,
           "Number of reads from constant globals");
 STATISTIC(NumOmittedReadsFromVtable, "Number of vtable reads");
 STATISTIC(NumOmittedNonCaptured, "Number of accesses ignored due to capturing");
+STATISTIC(NumOmittedRedundantFlushes,
+          "Number of cache operations ignored as block-local duplicates");
+STATISTIC(NumOmittedTransient,
+          "Number of accesses ignored as provably transient memory");
+STATISTIC(NumSkippedFunctions,
+          "Number of functions skipped by selective instrumentation");
+
+/* Only the persistence layer usually needs jaaru coverage; hash
+ * functions, key generators and other pure compute just inflate the
+ * instrumented binary. Functions can be selected by an allowlist file
+ * (one name per line, '#' comments) and/or source annotations:
+ * __attribute__((annotate("pmc_skip"))) always exempts a function,
+ * __attribute__((annotate("pmc_instrument"))) always includes it. If
+ * any positive selector exists (a list file or at least one
+ * pmc_instrument annotation), every unselected function is skipped;
+ * with no selectors the whole module is instrumented as before.
+ */
+static cl::opt<std::string> ClInstrumentList("pmc-instrument-list",
+	cl::desc("File listing functions to instrument; empty means all"),
+	cl::init(""));
+
+/* Compile-time map of persistence overhead: -pmc-fence-stats prints,
+ * per function, how many potentially-persistent stores, cache flushes
+ * and fences it carries, and flags basic blocks whose fence count
+ * exceeds -pmc-fence-density-pct percent of their store count. Pure
+ * reporting, the emitted code is unchanged; diffing the output across
+ * two releases shows where a binary started over-fencing without
+ * running either build.
+ */
+static cl::opt<bool> ClFenceStats("pmc-fence-stats",
+	cl::desc("Report per-function persistent-store/flush/fence counts"),
+	cl::init(false));
+static cl::opt<unsigned> ClFenceDensityPct("pmc-fence-density-pct",
+	cl::desc("Flag blocks whose fences exceed this percent of stores"),
+	cl::init(100));
 
 // static const char *const kCDSModuleCtorName = "cds.module_ctor";
 // static const char *const kCDSInitName = "cds_init";
@@ -101,6 +147,13 @@ Type * Int64PtrTy;
 Type * VoidTy;
 
 static const size_t kNumberOfAccessSizes = 4;
+/* kind argument of pmc_range_access; must match the runtime's values */
+static const unsigned kRangeMemset  = 0;
+static const unsigned kRangeMemcpy  = 1;
+static const unsigned kRangeMemmove = 2;
+#ifdef INLINE_FLUSH_BUFFER
+static const unsigned kFlushBufferSlots = 64;
+#endif
 #ifdef ENABLEATOMIC
 int getAtomicOrderIndex(AtomicOrdering order) {
 	switch (order) {
@@ -198,7 +251,13 @@ namespace {
 		void chooseInstructionsToInstrument(SmallVectorImpl<Instruction *> &Local,
 											SmallVectorImpl<Instruction *> &All,
 											const DataLayout &DL);
+		void elideRedundantFlushes(Function &F,
+									SmallVectorImpl<Instruction *> &CacheOperations);
 		bool addrPointsToConstantData(Value *Addr);
+		bool addrIsProvablyTransient(Value *Addr);
+		void readInstrumentationSelectors(Module &M);
+		bool shouldInstrumentFunction(Function &F);
+		void reportFenceStats(Function &F);
 		int getMemoryAccessFuncIndex(Value *Addr, const DataLayout &DL);
 
 		//Function * PMCFuncEntry;
@@ -218,14 +277,23 @@ namespace {
 		Function * PMCAtomicThreadFence;
 #endif
 		Function * MemmoveFn, * MemcpyFn, * MemsetFn;
+		Function * RangeAccessFn;
 		Function *CLFlushFn, *CLFlushOptFn, *CLWBFn;
 		Function *SFenceFn, *MFenceFn, *LFenceFn;
+#ifdef INLINE_FLUSH_BUFFER
+		Function *FlushBatchFn;
+		GlobalVariable *FlushBuf;
+		GlobalVariable *FlushBufCnt;
+#endif
 #ifdef ENABLEATOMIC
 		std::vector<StringRef> AtomicFuncNames;
 #endif
 		std::vector<StringRef> PartialAtomicFuncNames;
 		std::vector<StringRef> CacheOperationsNames;
 		std::vector<StringRef> FenceOperationsNames;
+		SmallPtrSet<const Function *, 8> SkipAnnotated;
+		SmallPtrSet<const Function *, 8> OnlyAnnotated;
+		StringSet<> InstrumentAllowlist;
 	};
 
 }
@@ -389,12 +457,39 @@ void PMCPass::initializeCallbacks(Module &M) {
 	MemsetFn = checkPMCPassInterfaceFunction(
 					M.getOrInsertFunction("memset", Attr, Int8PtrTy, Int8PtrTy,
 					Int32Ty, IntPtrTy).getCallee());
+	/* one record covering a whole memcpy/memset/memmove extent:
+	 * (base, length, kind, position); kind values are kRange* above */
+	RangeAccessFn = checkPMCPassInterfaceFunction(
+					M.getOrInsertFunction("pmc_range_access", Attr, VoidTy,
+					Int8PtrTy, IntPtrTy, Int32Ty, Int8PtrTy).getCallee());
 	CLWBFn  = checkPMCPassInterfaceFunction(M.getOrInsertFunction("pmc_clwb", Attr, VoidTy, Int8PtrTy).getCallee());
 	CLFlushFn  = checkPMCPassInterfaceFunction(M.getOrInsertFunction("pmc_clflush", Attr, VoidTy, Int8PtrTy).getCallee());
 	CLFlushOptFn  = checkPMCPassInterfaceFunction(M.getOrInsertFunction("pmc_clflushopt", Attr, VoidTy, Int8PtrTy).getCallee());
 	MFenceFn  = checkPMCPassInterfaceFunction(M.getOrInsertFunction("pmc_mfence", Attr, VoidTy).getCallee());
 	SFenceFn  = checkPMCPassInterfaceFunction(M.getOrInsertFunction("pmc_sfence", Attr, VoidTy).getCallee());
 	LFenceFn  = checkPMCPassInterfaceFunction(M.getOrInsertFunction("pmc_lfence", Attr, VoidTy).getCallee());
+#ifdef INLINE_FLUSH_BUFFER
+	FlushBatchFn = checkPMCPassInterfaceFunction(
+						M.getOrInsertFunction("pmc_flush_batch", Attr, VoidTy,
+						Int8PtrTy->getPointerTo(), Int32Ty).getCallee());
+	/* Buffer and counter are defined (thread-local) by the runtime; the
+	 * pass only declares them, so every module drains the same buffer. */
+	Type *BufTy = ArrayType::get(Int8PtrTy, kFlushBufferSlots);
+	FlushBuf = M.getNamedGlobal("__pmc_flush_buf");
+	if (FlushBuf == NULL) {
+		FlushBuf = new GlobalVariable(M, BufTy, false,
+						GlobalValue::ExternalLinkage, nullptr,
+						"__pmc_flush_buf", nullptr,
+						GlobalValue::GeneralDynamicTLSModel);
+	}
+	FlushBufCnt = M.getNamedGlobal("__pmc_flush_cnt");
+	if (FlushBufCnt == NULL) {
+		FlushBufCnt = new GlobalVariable(M, Int32Ty, false,
+						GlobalValue::ExternalLinkage, nullptr,
+						"__pmc_flush_cnt", nullptr,
+						GlobalValue::GeneralDynamicTLSModel);
+	}
+#endif
 }
 
 bool PMCPass::doInitialization(Module &M) {
@@ -433,6 +528,68 @@ bool PMCPass::doInitialization(Module &M) {
 	{
 		"mfence", "sfence", "lfence"
 	};
+	readInstrumentationSelectors(M);
+	return true;
+}
+
+void PMCPass::readInstrumentationSelectors(Module &M) {
+	SkipAnnotated.clear();
+	OnlyAnnotated.clear();
+	InstrumentAllowlist.clear();
+
+	if (!ClInstrumentList.empty()) {
+		auto BufOrErr = MemoryBuffer::getFile(ClInstrumentList);
+		if (!BufOrErr) {
+			errs() << "PMC: cannot read instrument list: "
+					<< ClInstrumentList << "\n";
+		} else {
+			SmallVector<StringRef, 16> Lines;
+			(*BufOrErr)->getBuffer().split(Lines, '\n', -1, false);
+			for (StringRef Line : Lines) {
+				Line = Line.trim();
+				if (!Line.empty() && !Line.startswith("#"))
+					InstrumentAllowlist.insert(Line);
+			}
+		}
+	}
+
+	/* llvm.global.annotations is an array of {fn, str, file, line}. */
+	GlobalVariable *GA = M.getGlobalVariable("llvm.global.annotations");
+	if (GA == NULL || !GA->hasInitializer())
+		return;
+	ConstantArray *CA = dyn_cast<ConstantArray>(GA->getInitializer());
+	if (CA == NULL)
+		return;
+	for (Value *Op : CA->operands()) {
+		ConstantStruct *CS = dyn_cast<ConstantStruct>(Op);
+		if (CS == NULL || CS->getNumOperands() < 2)
+			continue;
+		Function *Fn = dyn_cast<Function>(CS->getOperand(0)->stripPointerCasts());
+		if (Fn == NULL)
+			continue;
+		GlobalVariable *StrGV =
+			dyn_cast<GlobalVariable>(CS->getOperand(1)->stripPointerCasts());
+		if (StrGV == NULL || !StrGV->hasInitializer())
+			continue;
+		ConstantDataArray *Str =
+			dyn_cast<ConstantDataArray>(StrGV->getInitializer());
+		if (Str == NULL || !Str->isCString())
+			continue;
+		StringRef Annotation = Str->getAsCString();
+		if (Annotation == "pmc_skip")
+			SkipAnnotated.insert(Fn);
+		else if (Annotation == "pmc_instrument")
+			OnlyAnnotated.insert(Fn);
+	}
+}
+
+bool PMCPass::shouldInstrumentFunction(Function &F) {
+	if (SkipAnnotated.count(&F))
+		return false;
+	if (OnlyAnnotated.count(&F))
+		return true;
+	if (!InstrumentAllowlist.empty() || !OnlyAnnotated.empty())
+		return InstrumentAllowlist.count(F.getName()) != 0;
 	return true;
 }
 
@@ -475,6 +632,44 @@ static bool shouldInstrumentReadWriteFromAddress(const Module *M, Value *Addr) {
 	return true;
 }
 
+/* Jaaru checks crash consistency of persistent memory, so accesses that
+ * provably never touch PM carry no information and only slow the
+ * instrumented binary down. Stack slots and the ordinary transient heap
+ * (malloc/calloc/..., operator new) are never PM -- persistent mappings
+ * come from pmem_map_file/pmemobj pools -- so a pointer all of whose
+ * underlying objects are such allocations can skip instrumentation
+ * outright, capture or no capture (capture matters for race detection,
+ * not persistency). Anything ambiguous (arguments, globals, loads of
+ * pointers) stays instrumented and is classified at runtime by the
+ * library's own range check.
+ */
+static bool isKnownTransientAllocation(const Value *V) {
+	if (isa<AllocaInst>(V))
+		return true;
+	if (const CallInst *CI = dyn_cast<CallInst>(V)) {
+		const Function *Callee = CI->getCalledFunction();
+		if (Callee == NULL)
+			return false;
+		StringRef Name = Callee->getName();
+		return Name == "malloc" || Name == "calloc" || Name == "realloc" ||
+				Name == "aligned_alloc" || Name == "valloc" ||
+				Name == "_Znwm" || Name == "_Znam";
+	}
+	return false;
+}
+
+bool PMCPass::addrIsProvablyTransient(Value *Addr) {
+	SmallVector<const Value *, 4> Objects;
+	getUnderlyingObjects(Addr, Objects);
+	if (Objects.empty())
+		return false;
+	for (const Value *Obj : Objects) {
+		if (!isKnownTransientAllocation(Obj))
+			return false;
+	}
+	return true;
+}
+
 bool PMCPass::addrPointsToConstantData(Value *Addr) {
 	// If this is a GEP, just analyze its pointer operand.
 	if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(Addr))
@@ -567,6 +762,11 @@ void PMCPass::chooseInstructionsToInstrument(
 			NumOmittedNonCaptured++;
 			continue;
 		}
+		if (addrIsProvablyTransient(Addr)) {
+			// Stack or transient heap: never persistent memory.
+			NumOmittedTransient++;
+			continue;
+		}
 		results.push_back(I);
 	}
 	for( Instruction *I: reverse(results) ){
@@ -575,6 +775,61 @@ void PMCPass::chooseInstructionsToInstrument(
 	Local.clear();
 }
 
+/* A second clflush/clwb of the same address value is a no-op for the
+ * persistency model as long as nothing in between could have re-dirtied
+ * the line or ordered against the first flush: the line is already
+ * clean (or already queued for write-back) and holds the same data, so
+ * instrumenting it only burns a runtime call. This walks each basic
+ * block in program order and drops such duplicates from the
+ * instrumentation worklist; the raw asm stays in the binary and still
+ * executes natively. The window is reset by anything that might write
+ * memory or act as a persistence barrier: stores, atomics, fences, and
+ * any call we do not recognize as one of our tracked cache operations
+ * (block-local and address-identity based, so purely conservative).
+ * Accesses themselves are left alone: pmc_load/pmc_store report values
+ * to the runtime and are not removable on idempotence grounds.
+ */
+void PMCPass::elideRedundantFlushes(Function &F,
+	SmallVectorImpl<Instruction *> &CacheOperations) {
+	SmallPtrSet<Instruction*, 16> Flushes(CacheOperations.begin(),
+											CacheOperations.end());
+	SmallPtrSet<Instruction*, 8> Redundant;
+
+	for (auto &BB : F) {
+		SmallPtrSet<Value*, 8> FlushedAddrs;
+		for (auto &Inst : BB) {
+			if (Flushes.count(&Inst)) {
+				CallInst *CI = cast<CallInst>(&Inst);
+				if (CI->arg_size() < 1) {
+					continue;
+				}
+				Value *Addr = CI->getArgOperand(0);
+				if (!FlushedAddrs.insert(Addr).second) {
+					Redundant.insert(&Inst);
+					NumOmittedRedundantFlushes++;
+				}
+				continue;
+			}
+			if (isa<StoreInst>(Inst) || isa<FenceInst>(Inst) ||
+					(&Inst)->isAtomic() || isa<CallInst>(Inst) ||
+					isa<InvokeInst>(Inst)) {
+				FlushedAddrs.clear();
+			}
+		}
+	}
+
+	if (Redundant.empty())
+		return;
+
+	SmallVector<Instruction*, 8> Kept;
+	for (Instruction *I : CacheOperations) {
+		if (!Redundant.count(I))
+			Kept.push_back(I);
+	}
+	CacheOperations.clear();
+	CacheOperations.append(Kept.begin(), Kept.end());
+}
+
 /* Not implemented
 void CDSPass::InsertRuntimeIgnores(Function &F) {
 	IRBuilder<> IRB(F.getEntryBlock().getFirstNonPHI());
@@ -585,8 +840,58 @@ void CDSPass::InsertRuntimeIgnores(Function &F) {
 	}
 }*/
 
+/* -pmc-fence-stats: count, per basic block, stores that may reach PM
+ * (provably transient destinations are excluded, like the instrumenter
+ * does), flush instructions and fences. Prints one summary line per
+ * function and one flag line per block fencing above the threshold;
+ * fences with no persistent store in the block are always flagged. */
+void PMCPass::reportFenceStats(Function &F) {
+	unsigned FnStores = 0, FnFlushes = 0, FnFences = 0, FlaggedBlocks = 0;
+	for (auto &BB : F) {
+		unsigned Stores = 0, Flushes = 0, Fences = 0;
+		for (auto &Inst : BB) {
+			if (StoreInst *SI = dyn_cast<StoreInst>(&Inst)) {
+				if (!addrIsProvablyTransient(SI->getPointerOperand()))
+					Stores++;
+			} else if (isa<FenceInst>(Inst)) {
+				Fences++;
+			} else if (isa<CallInst>(Inst) || isa<InvokeInst>(Inst)) {
+				NVMOP op = whichNVMoperation(&Inst);
+				if (op == NVM_FENCE)
+					Fences++;
+				else if (op == NVM_CLWB)
+					Flushes++;
+			}
+		}
+		FnStores += Stores;
+		FnFlushes += Flushes;
+		FnFences += Fences;
+		if (Fences > 0 && Fences * 100 > Stores * ClFenceDensityPct) {
+			FlaggedBlocks++;
+			errs() << "PMC-fence-stats: " << F.getName() << " block '"
+					<< BB.getName() << "': " << Fences << " fences for "
+					<< Stores << " persistent stores\n";
+		}
+	}
+	if (FnStores + FnFlushes + FnFences > 0) {
+		errs() << "PMC-fence-stats: " << F.getName()
+				<< ": stores=" << FnStores
+				<< " flushes=" << FnFlushes
+				<< " fences=" << FnFences
+				<< " flagged-blocks=" << FlaggedBlocks << "\n";
+	}
+}
+
 bool PMCPass::runOnFunction(Function &F) {
 	// errs() << "[PMCPass::runOnFunction] start" << "\n";
+	/* reporting covers the whole module, even functions the selectors
+	 * exempt from instrumentation */
+	if (ClFenceStats)
+		reportFenceStats(F);
+	if (!shouldInstrumentFunction(F)) {
+		NumSkippedFunctions++;
+		return false;
+	}
 	initializeCallbacks( *F.getParent() );
 	SmallVector<Instruction*, 8> AllLoadsAndStores;
 	SmallVector<Instruction*, 8> FenceOperations;
@@ -651,8 +956,17 @@ bool PMCPass::runOnFunction(Function &F) {
 		chooseInstructionsToInstrument(LocalLoadsAndStores, AllLoadsAndStores, DL);
 	}
 
+	elideRedundantFlushes(F, CacheOperations);
+
+	unsigned FuncReads = 0, FuncWrites = 0;
 	for (auto Inst : AllLoadsAndStores) {
-		instrumentLoadOrStore(Inst, DL);
+		bool IsWrite = isa<StoreInst>(*Inst);
+		if (instrumentLoadOrStore(Inst, DL)) {
+			if (IsWrite)
+				FuncWrites++;
+			else
+				FuncReads++;
+		}
 	}
 
 #ifdef ENABLEATOMIC 	
@@ -675,6 +989,12 @@ bool PMCPass::runOnFunction(Function &F) {
 	for (auto Inst : FenceOperations) {
 		instrumentFenceOp(Inst, DL);
 	}
+
+	/* Per-function breakdown of where the instrumentation budget goes. */
+	if (FuncReads + FuncWrites > 0) {
+		errs() << "PMC: " << F.getName() << ": instrumented "
+				<< FuncWrites << " writes, " << FuncReads << " reads\n";
+	}
 	// errs() << "[PMCPass::runOnFunction] finish" << "\n";
 	
 	return false;
@@ -709,17 +1029,52 @@ bool PMCPass::instrumentCacheOp( Instruction *I, const DataLayout &DL){
 	if ( ArgType != Int8PtrTy ) {
                 return false;
         }
+#ifdef INLINE_FLUSH_BUFFER
+	/* Inline fast path: append the flushed address to the thread-local
+	 * event buffer and bump the counter; only the buffer-full slow path
+	 * calls into the runtime. The next fence drains the remainder. */
+	Type *Int32Ty = Type::getInt32Ty(IRB.getContext());
+	Type *BufTy = ArrayType::get(Int8PtrTy, kFlushBufferSlots);
+	Value *Zero = ConstantInt::get(Int32Ty, 0);
+	Value *Cnt = IRB.CreateLoad(Int32Ty, FlushBufCnt);
+	Value *Slot = IRB.CreateInBoundsGEP(BufTy, FlushBuf, {Zero, Cnt});
+	IRB.CreateStore(Addr, Slot);
+	Value *Inc = IRB.CreateAdd(Cnt, ConstantInt::get(Int32Ty, 1));
+	IRB.CreateStore(Inc, FlushBufCnt);
+	Value *Full = IRB.CreateICmpEQ(Inc,
+						ConstantInt::get(Int32Ty, kFlushBufferSlots));
+	Instruction *Then = SplitBlockAndInsertIfThen(Full, I, false);
+	IRBuilder<> ThenIRB(Then);
+	Value *BufStart = ThenIRB.CreateInBoundsGEP(BufTy, FlushBuf, {Zero, Zero});
+	ThenIRB.CreateCall(FlushBatchFn, {BufStart, Inc});
+	ThenIRB.CreateStore(Zero, FlushBufCnt);
+	I->eraseFromParent();
+	(void)CacheFn;
+	return true;
+#else
 	//IRB.CreateCall(CacheFn, IRB.CreatePointerCast(Addr, Addr->getType()));
 	Value *args[] = {Addr};
 	Instruction* funcInst = CallInst::Create(CacheFn, args);
 	ReplaceInstWithInst(I, funcInst);
 	return true;
+#endif
 }
 
 void PMCPass::instrumentFenceOp(Instruction *I, const DataLayout &DL){
 	errs() << "Intrumenting Cache Fence: " << *I << "\n";
 	IRBuilder<> IRB(I);
 	Function *FenceFn = whichNVMFunction(I);
+#ifdef INLINE_FLUSH_BUFFER
+	/* Drain buffered flush events before the fence is reported, so the
+	 * runtime sees every flush that this fence orders. */
+	Type *Int32Ty = Type::getInt32Ty(IRB.getContext());
+	Type *BufTy = ArrayType::get(Int8PtrTy, kFlushBufferSlots);
+	Value *Zero = ConstantInt::get(Int32Ty, 0);
+	Value *Cnt = IRB.CreateLoad(Int32Ty, FlushBufCnt);
+	Value *BufStart = IRB.CreateInBoundsGEP(BufTy, FlushBuf, {Zero, Zero});
+	IRB.CreateCall(FlushBatchFn, {BufStart, Cnt});
+	IRB.CreateStore(Zero, FlushBufCnt);
+#endif
 	IRB.CreateCall(FenceFn);
 }
 
@@ -852,20 +1207,28 @@ bool PMCPass::instrumentVolatile(Instruction * I, const DataLayout &DL) {
 bool PMCPass::instrumentMemIntrinsic(Instruction *I) {
 	errs() << "Intrumenting Memory: " << *I << "\n";
 	IRBuilder<> IRB(I);
+	Value *position = getPosition(I, IRB, true);
+	/* Emit one ranged record covering the destination extent and leave
+	 * the intrinsic in place. Routing the copy through the interposed
+	 * libc memcpy/memset made the runtime replay it as a record per
+	 * access size, so a 4KB memset produced hundreds of events; the
+	 * single (base, length, kind) record carries the same information
+	 * and codegen keeps lowering the intrinsic however it likes. */
 	if (MemSetInst *M = dyn_cast<MemSetInst>(I)) {
 		IRB.CreateCall(
-			MemsetFn,
+			RangeAccessFn,
 			{IRB.CreatePointerCast(M->getArgOperand(0), IRB.getInt8PtrTy()),
-			 IRB.CreateIntCast(M->getArgOperand(1), IRB.getInt32Ty(), false),
-			 IRB.CreateIntCast(M->getArgOperand(2), IntPtrTy, false)});
-		I->eraseFromParent();
+			 IRB.CreateIntCast(M->getArgOperand(2), IntPtrTy, false),
+			 ConstantInt::get(IRB.getInt32Ty(), kRangeMemset),
+			 position});
 	} else if (MemTransferInst *M = dyn_cast<MemTransferInst>(I)) {
 		IRB.CreateCall(
-			isa<MemCpyInst>(M) ? MemcpyFn : MemmoveFn,
+			RangeAccessFn,
 			{IRB.CreatePointerCast(M->getArgOperand(0), IRB.getInt8PtrTy()),
-			 IRB.CreatePointerCast(M->getArgOperand(1), IRB.getInt8PtrTy()),
-			 IRB.CreateIntCast(M->getArgOperand(2), IntPtrTy, false)});
-		I->eraseFromParent();
+			 IRB.CreateIntCast(M->getArgOperand(2), IntPtrTy, false),
+			 ConstantInt::get(IRB.getInt32Ty(),
+							isa<MemCpyInst>(M) ? kRangeMemcpy : kRangeMemmove),
+			 position});
 	}
 	return true;
 }
@@ -11,12 +11,19 @@
  * is retained. See LICENSE for details about MIT License.
  */
 
+#include <numaif.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdio.h>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "BaseMeta.hpp"
 #include "SizeClass.hpp"
@@ -162,6 +169,750 @@ inline bool AtomicCrossPtrCnt<T, idx>::compare_exchange_strong(
   return ret;
 }
 
+// round-robin shard assignment; threads spawned together (and thus likely
+// co-located on a socket) spread over different shards
+static std::atomic<size_t> shard_counter(0);
+thread_local size_t ralloc::t_partial_shard =
+    shard_counter.fetch_add(1, std::memory_order_relaxed) % PARTIAL_SHARDS;
+
+// NUMA node freshly carved superblocks should be bound to; -1 leaves the
+// region's default policy in place
+static thread_local int t_alloc_node = -1;
+// node+1 each sizeclass bin was last filled for (0 means unbound), so
+// RP_malloc_node doesn't hand out blocks cached for a different node
+static thread_local int t_cache_node[MAX_SZ_IDX] = {0};
+// lifetime temperature for the refill in flight: false serves from
+// heaps (hot, the default), true from cold_heaps
+static thread_local bool t_alloc_cold = false;
+// temperature each sizeclass bin was last filled for, so a hint switch
+// doesn't hand out blocks from the other temperature's superblocks
+static thread_local bool t_cache_cold[MAX_SZ_IDX] = {false};
+
+// thread-local direct-mapped cache of descriptor fields keyed by
+// superblock index. do_free and do_malloc_size only need sc_idx and
+// block_size; a hit spares them the dependent loads into the desc and
+// meta regions, which miss cache badly under random frees. Entries are
+// tagged with the retire generation current when they were filled, so a
+// superblock recycled under a different sizeclass can't serve stale
+// fields; superblocks retire only when they drain completely, so the
+// counter moves rarely and hits stay one predictable load.
+const size_t DESC_CACHE_SIZE = 256; // power of two; ~6KB per thread
+// bumped on every small_sb_retire; starts at 1 so the zero-initialized
+// cache entries below never match
+static std::atomic<uint64_t> sb_retire_gen(1);
+struct DescCacheEntry {
+  uint64_t sb_index;
+  uint64_t gen;
+  uint32_t sc_idx;
+  uint32_t block_size;
+};
+static thread_local DescCacheEntry t_desc_cache[DESC_CACHE_SIZE] = {};
+
+// process-wide DRAM shadow of the persistent descriptor fields, one
+// 64-bit word per superblock: block_size<<32 | maxcount<<8 | (sc_idx+1),
+// zero meaning "not mirrored". The PM descriptor array stays the
+// authoritative copy -- the carve paths keep writing and flushing it
+// exactly as before -- but t_desc_cache misses in do_free and
+// do_malloc_size are answered from here instead of faulting into the
+// desc and meta regions. Unlike t_desc_cache there is no generation
+// check: the word is rewritten when a superblock is carved and cleared
+// when it retires, and a retired superblock has no live blocks left
+// whose free could still read the stale value. Only small superblocks
+// are mirrored; the large path needs its descriptor anyway. A restart
+// comes up with the shadow zeroed and shadow_rebuild() re-derives it
+// from the descriptor array.
+static std::atomic<uint64_t> *desc_shadow = nullptr;
+static uint64_t desc_shadow_cnt = 0;
+
+static inline uint64_t shadow_sb_index(const void *ptr) {
+  return (((uint64_t)ptr) >> SB_SHIFT) -
+         (((uint64_t)ralloc::_rgs->lookup(SB_IDX)) >> SB_SHIFT);
+}
+
+static inline void shadow_fill(uint64_t sb_index, size_t sc_idx,
+                               uint32_t maxcount, uint32_t block_size) {
+  if (desc_shadow == nullptr || sb_index >= desc_shadow_cnt)
+    return;
+  uint64_t packed = ((uint64_t)block_size << 32) | ((uint64_t)maxcount << 8) |
+                    (uint64_t)(sc_idx + 1);
+  desc_shadow[sb_index].store(packed, std::memory_order_release);
+}
+
+static inline void shadow_clear(uint64_t sb_index) {
+  if (desc_shadow == nullptr || sb_index >= desc_shadow_cnt)
+    return;
+  desc_shadow[sb_index].store(0, std::memory_order_release);
+}
+
+static inline uint64_t shadow_read(uint64_t sb_index) {
+  if (desc_shadow == nullptr || sb_index >= desc_shadow_cnt)
+    return 0;
+  return desc_shadow[sb_index].load(std::memory_order_acquire);
+}
+
+static inline size_t shadow_sc_idx(uint64_t packed) {
+  return (size_t)(packed & 0xff) - 1;
+}
+
+static inline uint32_t shadow_block_size(uint64_t packed) {
+  return (uint32_t)(packed >> 32);
+}
+
+void BaseMeta::shadow_init(uint64_t num_sb) {
+  // calloc so every word starts "not mirrored"; a failed allocation
+  // just leaves the shadow disabled and reads fall through to PM
+  desc_shadow = (std::atomic<uint64_t> *)calloc(num_sb, sizeof(uint64_t));
+  desc_shadow_cnt = desc_shadow == nullptr ? 0 : num_sb;
+}
+
+/*
+ * Lazy concurrent sweep, enabled by RALLOC_GC_LAZY_SWEEP for full
+ * collections. The stop-the-world pause of a GC then covers only Step 0
+ * and the mark; operator() publishes the mark set plus a per-superblock
+ * state map (UNSWEPT/SWEEPING/SWEPT) and returns. A detached background
+ * sweeper walks the superblock space front to back claiming one
+ * superblock (or one whole span, large or multi-stride small) at a
+ * time with a CAS on its state byte, rebuilding it through the same sweep_range used by the
+ * synchronous path and publishing the results incrementally: partial
+ * superblocks via the lock-free heap_push_partial inside sweep_range,
+ * free ones by splicing each fragment onto avail_sb.
+ *
+ * Mutators cooperate in two ways. Paths that are about to touch a
+ * descriptor the sweeper may still rewrite -- flush_cache CASing an
+ * anchor, do_free retiring a large superblock -- call
+ * lazy_sweep_ensure() first, which sweeps that superblock on the spot
+ * (or waits out a concurrent claim). And small_sb_alloc, instead of
+ * expanding the region when avail_sb runs dry, first helps sweep a
+ * batch from the cursor, since unswept space is where free superblocks
+ * are hiding. Descriptor reads need no guard: the sweeper only rewrites
+ * anchors and transient links of live superblocks, and resets
+ * descriptors of superblocks the mark proved dead, which no live
+ * pointer can reach.
+ *
+ * Generational collections keep the synchronous sweep: they only visit
+ * dirty superblocks, so their sweep is already short, and the lazy
+ * window would race with the dirty-bit baseline reset.
+ */
+enum : uint8_t { LAZY_UNSWEPT = 0, LAZY_SWEEPING = 1, LAZY_SWEPT = 2 };
+static GarbageCollection *lazy_gc = nullptr; // published mark set
+static std::atomic<uint8_t> *lazy_map = nullptr;
+static uint64_t lazy_map_cnt = 0;
+static std::atomic<uint64_t> lazy_cursor(0); // next index the walk claims
+static std::atomic<bool> lazy_active(false);
+
+static inline uint64_t lazy_idx_of(const char *sb) {
+  return ((uint64_t)sb - (uint64_t)ralloc::_rgs->lookup(SB_IDX)) >> SB_SHIFT;
+}
+
+// splice a free-superblock fragment onto the given free list, same CAS
+// shape as small_sb_retire
+static void lazy_push_avail(AtomicCrossPtrCnt<Descriptor, DESC_IDX> &list,
+                            Descriptor *head, Descriptor *tail) {
+  ptr_cnt<Descriptor> oldhead = list.load();
+  ptr_cnt<Descriptor> newhead;
+  do {
+    tail->next_free.store(oldhead.get_ptr());
+    newhead.set(head, oldhead.get_counter() + 1);
+  } while (!list.compare_exchange_weak(oldhead, newhead));
+}
+
+// bring the superblock at index idx to LAZY_SWEPT, sweeping it here if
+// it is unclaimed and waiting out whoever claimed it otherwise. idx
+// must be a unit head (never the interior of a large or multi-stride
+// span; interiors are premarked at publish time).
+static void lazy_sweep_sb(uint64_t idx) {
+  uint8_t expect = LAZY_UNSWEPT;
+  if (lazy_map[idx].compare_exchange_strong(expect, LAZY_SWEEPING)) {
+    char *sb = ralloc::_rgs->lookup(SB_IDX) + (idx << SB_SHIFT);
+    char *range_end = sb + SBSIZE;
+    Descriptor *d = base_md->desc_lookup(sb);
+    if (d->heap != nullptr && d->superblock == sb) {
+      // whole span (large, or a multi-stride small class) is one unit
+      range_end =
+          sb + (d->heap->sc_idx == 0
+                    ? d->block_size
+                    : base_md->get_sizeclass_by_idx(d->heap->sc_idx)->sb_size);
+    }
+    Descriptor *tail = nullptr;
+    Descriptor *span_h = nullptr;
+    Descriptor *span_t = nullptr;
+    Descriptor *head =
+        lazy_gc->sweep_range(sb, range_end, &tail, &span_h, &span_t);
+    if (head != nullptr)
+      lazy_push_avail(base_md->avail_sb, head, tail);
+    if (span_h != nullptr)
+      lazy_push_avail(base_md->avail_sb_span, span_h, span_t);
+    for (char *c = sb; c < range_end; c += SBSIZE)
+      lazy_map[lazy_idx_of(c)].store(LAZY_SWEPT, std::memory_order_release);
+    return;
+  }
+  while (lazy_map[idx].load(std::memory_order_acquire) != LAZY_SWEPT)
+    sched_yield();
+}
+
+void BaseMeta::lazy_sweep_ensure(char *sb) {
+  if (LIKELY(!lazy_active.load(std::memory_order_acquire)))
+    return;
+  uint64_t idx = lazy_idx_of(sb);
+  if (idx >= lazy_map_cnt) // carved after the mark; nothing to rebuild
+    return;
+  if (lazy_map[idx].load(std::memory_order_acquire) == LAZY_SWEPT)
+    return;
+  lazy_sweep_sb(idx);
+}
+
+// claim up to $batch$ units from the cursor; returns true if any
+// progress was made (so a caller hunting for free superblocks should
+// re-check avail_sb before expanding the region)
+static bool lazy_sweep_help(uint64_t batch) {
+  if (!lazy_active.load(std::memory_order_acquire))
+    return false;
+  bool progress = false;
+  while (batch > 0) {
+    uint64_t idx = lazy_cursor.fetch_add(1);
+    if (idx >= lazy_map_cnt)
+      break;
+    if (lazy_map[idx].load(std::memory_order_acquire) != LAZY_UNSWEPT)
+      continue; // interior of a span, or already claimed
+    lazy_sweep_sb(idx);
+    progress = true;
+    batch--;
+  }
+  return progress;
+}
+
+static void lazy_sweep_bg() {
+  // front to back, the same order the frontier grew; ensure() calls
+  // from mutators punch ahead of the cursor when they must
+  for (uint64_t idx = 1; idx < lazy_map_cnt; idx++) {
+    if (lazy_map[idx].load(std::memory_order_acquire) == LAZY_UNSWEPT)
+      lazy_sweep_sb(idx);
+    else if (lazy_map[idx].load(std::memory_order_acquire) == LAZY_SWEEPING)
+      lazy_sweep_sb(idx); // waits for the claimer
+  }
+  // everything swept: write the rebuilt metadata back, as the
+  // synchronous tail of operator() would
+  _rgs->flush_region(DESC_IDX);
+  _rgs->flush_region(SB_IDX);
+  FLUSHFENCE;
+  delete lazy_gc;
+  lazy_gc = nullptr;
+  lazy_active.store(false, std::memory_order_release);
+}
+
+// end of the pause in lazy mode: move the mark set somewhere stable,
+// premark span interiors so no unit claim can start inside one, and
+// start the background sweeper. Returns false (and changes
+// nothing) if the state map can't be allocated.
+static bool lazy_publish(GarbageCollection *gc, char *first_sb,
+                         char *sb_end) {
+  uint64_t cnt = lazy_idx_of(sb_end);
+  std::atomic<uint8_t> *map =
+      (std::atomic<uint8_t> *)calloc(cnt, sizeof(std::atomic<uint8_t>));
+  if (map == nullptr)
+    return false;
+  if (lazy_map != nullptr)
+    free((void *)lazy_map);
+  lazy_map = map;
+  lazy_map_cnt = cnt;
+  lazy_map[0].store(LAZY_SWEPT, std::memory_order_relaxed); // region header
+  // descriptor-only walk, same as the parallel sweep's chunk bounds;
+  // interiors of spans (large or multi-stride small) are premarked so
+  // no unit claim can start inside one
+  char *sb = first_sb;
+  while (sb < sb_end) {
+    Descriptor *d = base_md->desc_lookup(sb);
+    if (d->heap != nullptr && d->superblock == sb) {
+      uint64_t unit =
+          d->heap->sc_idx == 0
+              ? d->block_size
+              : base_md->get_sizeclass_by_idx(d->heap->sc_idx)->sb_size;
+      for (char *c = sb + SBSIZE; c < sb + unit; c += SBSIZE)
+        lazy_map[lazy_idx_of(c)].store(LAZY_SWEPT, std::memory_order_relaxed);
+      sb += unit;
+    } else {
+      sb += SBSIZE;
+    }
+  }
+  GarbageCollection *g = new GarbageCollection();
+  g->marked_blk = std::move(gc->marked_blk);
+  g->gen_mode = gc->gen_mode;
+  lazy_gc = g;
+  lazy_cursor.store(1);
+  lazy_active.store(true, std::memory_order_release);
+  std::thread(lazy_sweep_bg).detach();
+  return true;
+}
+
+void BaseMeta::lazy_sweep_drain() {
+  if (!lazy_active.load(std::memory_order_acquire))
+    return;
+  while (lazy_sweep_help(64)) {
+  }
+  // the background sweeper (or a claimer we raced with) may still be
+  // finishing its unit; completion is its store to lazy_active
+  while (lazy_active.load(std::memory_order_acquire))
+    sched_yield();
+}
+
+void BaseMeta::shadow_rebuild() {
+  if (desc_shadow == nullptr)
+    return;
+  Descriptor *descs = reinterpret_cast<Descriptor *>(_rgs->lookup(DESC_IDX));
+  for (uint64_t i = 0; i < desc_shadow_cnt; i++) {
+    Descriptor *d = &descs[i];
+    if (d->heap != nullptr && d->superblock != nullptr &&
+        d->heap->sc_idx != 0)
+      shadow_fill(i, d->heap->sc_idx, d->maxcount, d->block_size);
+    else
+      shadow_clear(i);
+  }
+}
+
+// per-thread telemetry block (see RallocStats in BaseMeta.hpp);
+// registered so stats_read can sum the live threads, merged into
+// retired_stats when its thread exits
+static std::mutex stats_lk;
+static ralloc::RallocStats retired_stats = {};
+static std::vector<ralloc::RallocStats *> live_stats;
+struct StatsHandle {
+  ralloc::RallocStats stats = {};
+  StatsHandle() {
+    std::lock_guard<std::mutex> lk(stats_lk);
+    live_stats.push_back(&stats);
+  }
+  ~StatsHandle() {
+    std::lock_guard<std::mutex> lk(stats_lk);
+    live_stats.erase(std::find(live_stats.begin(), live_stats.end(), &stats));
+    for (int i = 0; i < MAX_SZ_IDX; i++) {
+      retired_stats.allocs[i] += stats.allocs[i];
+      retired_stats.frees[i] += stats.frees[i];
+      retired_stats.refills[i] += stats.refills[i];
+      retired_stats.flushes[i] += stats.flushes[i];
+    }
+  }
+};
+static thread_local StatsHandle t_stats;
+
+// optional event ring (see stat_ring_drain in BaseMeta.hpp); producers
+// claim slots with one fetch_add and overwrite the oldest events
+struct StatRing {
+  ralloc::StatEvent *events = nullptr;
+  uint64_t mask = 0;
+  std::atomic<uint64_t> head{0};
+  uint64_t drained = 0; // consumer cursor; single monitoring thread
+  StatRing() {
+    if (const char *env = std::getenv("RALLOC_STAT_RING")) {
+      uint64_t cap = strtoul(env, nullptr, 10);
+      if (cap >= 2 && (cap & (cap - 1)) == 0) {
+        events = new ralloc::StatEvent[cap]();
+        mask = cap - 1;
+      }
+    }
+  }
+  ~StatRing() { delete[] events; }
+  inline void push(uint32_t op, uint32_t sc_idx) {
+    uint64_t seq = head.fetch_add(1, std::memory_order_relaxed);
+    ralloc::StatEvent &e = events[seq & mask];
+    e.seq = seq;
+    e.op = op;
+    e.sc_idx = sc_idx;
+  }
+};
+static StatRing stat_ring;
+
+// operation breadcrumbs for crash_dump: each thread keeps a small ring
+// of its latest allocator operations (timestamped with rdtsc) in a
+// fixed slot table, so a signal handler can walk every thread's recent
+// history without locks or allocation
+const size_t CRUMB_RING = 64; // power of two
+const size_t MAX_CRUMB_THREADS = 1024;
+struct Crumb {
+  uint64_t tsc;
+  uint32_t op;
+  uint32_t sc_idx;
+};
+struct CrumbSlot {
+  Crumb crumbs[CRUMB_RING];
+  uint64_t next;
+  TCaches *caches;
+};
+static CrumbSlot *crumb_slots[MAX_CRUMB_THREADS] = {nullptr};
+static std::atomic<uint32_t> crumb_slot_count(0);
+struct CrumbHandle {
+  CrumbSlot slot = {};
+  uint32_t idx;
+  CrumbHandle() {
+    slot.caches = &t_caches;
+    idx = crumb_slot_count.fetch_add(1, std::memory_order_relaxed);
+    if (idx < MAX_CRUMB_THREADS)
+      crumb_slots[idx] = &slot;
+  }
+  ~CrumbHandle() {
+    if (idx < MAX_CRUMB_THREADS)
+      crumb_slots[idx] = nullptr;
+  }
+};
+static thread_local CrumbHandle t_crumbs;
+
+static inline void stat_event(uint32_t op, uint32_t sc_idx) {
+  CrumbSlot &slot = t_crumbs.slot;
+  Crumb &c = slot.crumbs[slot.next++ & (CRUMB_RING - 1)];
+  c.tsc = asm_rdtsc();
+  c.op = op;
+  c.sc_idx = sc_idx;
+  if (UNLIKELY(stat_ring.events != nullptr))
+    stat_ring.push(op, sc_idx);
+}
+
+// async-signal-safe writers for crash_dump: write(2) only, no locale,
+// no allocation
+static void sig_puts(int fd, const char *s) {
+  size_t n = 0;
+  while (s[n] != '\0')
+    n++;
+  ssize_t r = write(fd, s, n);
+  (void)r;
+}
+
+static void sig_putu(int fd, uint64_t v) {
+  char buf[21];
+  int i = 21;
+  do {
+    buf[--i] = '0' + (char)(v % 10);
+    v /= 10;
+  } while (v != 0);
+  ssize_t r = write(fd, buf + i, 21 - i);
+  (void)r;
+}
+
+static void sig_puthex(int fd, uint64_t v) {
+  const char *digits = "0123456789abcdef";
+  char buf[18];
+  int i = 18;
+  do {
+    buf[--i] = digits[v & 0xf];
+    v >>= 4;
+  } while (v != 0);
+  buf[--i] = 'x';
+  buf[--i] = '0';
+  ssize_t r = write(fd, buf + i, 18 - i);
+  (void)r;
+}
+
+/*
+ * function ralloc::crash_dump
+ * Description: best-effort snapshot of allocator state, callable from
+ *  a SIGSEGV/SIGBUS handler. Walks the breadcrumb slots, thread cache
+ *  fill levels, partial list heads (with their anchors), and the free
+ *  superblock list using only async-signal-safe operations; racing
+ *  threads may leave individual lines inconsistent, but nothing here
+ *  blocks or allocates. Returns 0, or -1 when the heap is down.
+ */
+int ralloc::crash_dump(int fd) {
+  static const char *op_names[4] = {"alloc", "free", "refill", "flush"};
+  static const char *state_names[4] = {"active", "full", "partial", "empty"};
+  sig_puts(fd, "== ralloc crash dump ==\n");
+  if (!initialized || base_md == nullptr) {
+    sig_puts(fd, "heap not initialized\n");
+    return -1;
+  }
+
+  ptr_cnt<Descriptor> avail = base_md->avail_sb.load();
+  sig_puts(fd, "avail_sb: ");
+  sig_puthex(fd, (uint64_t)avail.get_ptr());
+  sig_puts(fd, " cnt ");
+  sig_putu(fd, avail.get_counter());
+  sig_puts(fd, "\n");
+
+  for (int sc = 1; sc < MAX_SZ_IDX; sc++) {
+    for (int s = 0; s < PARTIAL_SHARDS; s++) {
+      Descriptor *head =
+          base_md->heaps[sc].partial_lists[s].list.load().get_ptr();
+      if (head == nullptr)
+        continue;
+      Anchor a = head->anchor.load();
+      sig_puts(fd, "sc ");
+      sig_putu(fd, sc);
+      sig_puts(fd, " shard ");
+      sig_putu(fd, s);
+      sig_puts(fd, " head ");
+      sig_puthex(fd, (uint64_t)head);
+      sig_puts(fd, " sb ");
+      sig_puthex(fd, (uint64_t)(char *)head->superblock);
+      sig_puts(fd, " anchor avail ");
+      sig_putu(fd, a.avail);
+      sig_puts(fd, " count ");
+      sig_putu(fd, a.count);
+      sig_puts(fd, " state ");
+      sig_puts(fd, a.state < 4 ? state_names[a.state] : "?");
+      sig_puts(fd, "\n");
+    }
+  }
+
+  uint32_t nslots = crumb_slot_count.load(std::memory_order_relaxed);
+  if (nslots > MAX_CRUMB_THREADS)
+    nslots = MAX_CRUMB_THREADS;
+  for (uint32_t t = 0; t < nslots; t++) {
+    CrumbSlot *slot = crumb_slots[t];
+    if (slot == nullptr)
+      continue; // thread exited
+    sig_puts(fd, "thread ");
+    sig_putu(fd, t);
+    sig_puts(fd, " cache:");
+    for (int sc = 1; sc < MAX_SZ_IDX; sc++) {
+      uint64_t n = slot->caches->t_cache[sc].get_block_num();
+      if (n == 0)
+        continue;
+      sig_puts(fd, " sc");
+      sig_putu(fd, sc);
+      sig_puts(fd, "=");
+      sig_putu(fd, n);
+    }
+    sig_puts(fd, "\n crumbs (newest first):\n");
+    uint64_t next = slot->next;
+    uint64_t shown = next < CRUMB_RING ? next : CRUMB_RING;
+    for (uint64_t i = 0; i < shown; i++) {
+      Crumb &c = slot->crumbs[(next - 1 - i) & (CRUMB_RING - 1)];
+      sig_puts(fd, "  tsc ");
+      sig_putu(fd, c.tsc);
+      sig_puts(fd, " ");
+      sig_puts(fd, c.op < 4 ? op_names[c.op] : "?");
+      sig_puts(fd, " sc ");
+      sig_putu(fd, c.sc_idx);
+      sig_puts(fd, "\n");
+    }
+  }
+  return 0;
+}
+
+// allocation-size histogram for profile-guided size class tuning
+// (RALLOC_SIZE_PROFILE=<path>): one counter per requested byte size up
+// to MAX_SZ, dumped as "size count" lines when the heap closes. Feed
+// the dump to test/sizeclass_gen to emit a tuned table.
+static std::atomic<uint64_t> *size_profile = nullptr;
+static const char *size_profile_path = nullptr;
+static struct SizeProfileInit {
+  SizeProfileInit() {
+    if ((size_profile_path = std::getenv("RALLOC_SIZE_PROFILE")) != nullptr)
+      size_profile = new std::atomic<uint64_t>[MAX_SZ + 1]();
+  }
+} size_profile_init;
+
+static inline void profile_size(size_t size, uint64_t n = 1) {
+  if (UNLIKELY(size_profile != nullptr) && size <= MAX_SZ)
+    size_profile[size].fetch_add(n, std::memory_order_relaxed);
+}
+
+void ralloc::size_profile_dump() {
+  if (size_profile == nullptr)
+    return;
+  FILE *f = fopen(size_profile_path, "w");
+  if (f == nullptr) {
+    perror("RALLOC_SIZE_PROFILE");
+    return;
+  }
+  for (size_t s = 0; s <= MAX_SZ; s++) {
+    uint64_t c = size_profile[s].load(std::memory_order_relaxed);
+    if (c != 0)
+      fprintf(f, "%lu %lu\n", s, c);
+  }
+  fclose(f);
+}
+
+void ralloc::stats_read(RallocStats *out) {
+  std::lock_guard<std::mutex> lk(stats_lk);
+  *out = retired_stats;
+  for (RallocStats *s : live_stats) {
+    for (int i = 0; i < MAX_SZ_IDX; i++) {
+      out->allocs[i] += s->allocs[i];
+      out->frees[i] += s->frees[i];
+      out->refills[i] += s->refills[i];
+      out->flushes[i] += s->flushes[i];
+    }
+  }
+}
+
+size_t ralloc::stat_ring_drain(StatEvent *out, size_t max) {
+  if (stat_ring.events == nullptr)
+    return 0;
+  uint64_t head = stat_ring.head.load(std::memory_order_acquire);
+  uint64_t start = stat_ring.drained;
+  if (head - start > stat_ring.mask + 1) {
+    start = head - (stat_ring.mask + 1); // wrapped; oldest were overwritten
+  }
+  size_t n = 0;
+  for (; start < head && n < max; start++) {
+    out[n++] = stat_ring.events[start & stat_ring.mask];
+  }
+  stat_ring.drained = start;
+  return n;
+}
+
+// transient dirty map for generational collections: one byte per
+// superblock slot in the SB region, set by every allocator path that
+// mutates a superblock's blocks or metadata. A partial collection
+// traces and rebuilds only dirty superblocks and trusts the persisted
+// anchors of the clean ones; the map is cleared after each collection
+// to start the next baseline. nullptr until gc_enable_generational.
+static std::atomic<uint8_t> *sb_dirty_map = nullptr;
+static uint64_t sb_dirty_slots = 0;
+// old-to-young pointers announced through gc_remember; drained (marked
+// but not traced) at the start of each partial collection
+static std::mutex remembered_lk;
+static std::vector<char *> remembered_set;
+
+static inline void sb_dirty_mark(const void *addr) {
+  if (LIKELY(sb_dirty_map == nullptr))
+    return;
+  uint64_t slot = ((uint64_t)addr - (uint64_t)ralloc::_rgs->lookup(SB_IDX)) >>
+                  SB_SHIFT;
+  if (slot < sb_dirty_slots &&
+      sb_dirty_map[slot].load(std::memory_order_relaxed) == 0)
+    sb_dirty_map[slot].store(1, std::memory_order_relaxed);
+}
+
+void ralloc::gc_enable_generational(bool enable) {
+  if (enable && sb_dirty_map == nullptr) {
+    sb_dirty_slots = _rgs->regions[SB_IDX]->FILESIZE >> SB_SHIFT;
+    sb_dirty_map = new std::atomic<uint8_t>[sb_dirty_slots]();
+  } else if (!enable && sb_dirty_map != nullptr) {
+    std::atomic<uint8_t> *map = sb_dirty_map;
+    sb_dirty_map = nullptr;
+    sb_dirty_slots = 0;
+    delete[] map;
+  }
+}
+
+bool ralloc::gc_sb_is_clean(const char *addr) {
+  if (sb_dirty_map == nullptr)
+    return false; // no baseline yet; treat everything as dirty
+  uint64_t slot = ((uint64_t)addr - (uint64_t)_rgs->lookup(SB_IDX)) >> SB_SHIFT;
+  if (slot >= sb_dirty_slots)
+    return false;
+  return sb_dirty_map[slot].load(std::memory_order_relaxed) == 0;
+}
+
+void ralloc::gc_remember(void *ptr) {
+  std::lock_guard<std::mutex> lk(remembered_lk);
+  remembered_set.push_back(reinterpret_cast<char *>(ptr));
+}
+
+std::vector<char *> ralloc::gc_take_remembered() {
+  std::lock_guard<std::mutex> lk(remembered_lk);
+  return std::move(remembered_set);
+}
+
+void ralloc::gc_dirty_reset() {
+  for (uint64_t i = 0; i < sb_dirty_slots; i++)
+    sb_dirty_map[i].store(0, std::memory_order_relaxed);
+}
+
+/*
+ * DRAM staging tier (RP_stage_*). Optane reads are several times
+ * slower than DRAM, so read-mostly blocks whose working set fits DRAM
+ * gain from being served out of a DRAM mirror. stage_enable carves an
+ * anonymous DRAM arena in superblock-sized slots; stage_read samples
+ * accesses per superblock and, past a hit threshold, copies the whole
+ * superblock into a free slot. A staged block is addressed through the
+ * same in-superblock offset, just against the mirror base. Writes to
+ * staged ranges must go through stage_write, which persists to PM
+ * first (write-through) and then refreshes the mirror; that is the
+ * coherence contract, PM remains the only durable truth and the tier
+ * can be dropped wholesale at any time.
+ */
+const uint64_t STAGE_PROMOTE_HITS = 64; // sampled hits before promotion
+const uint64_t STAGE_SAMPLE = 8;        // count every 8th stage_read miss
+struct StageEntry {
+  // mirror base for this superblock; non-null once resident
+  std::atomic<char *> copy;
+  std::atomic<uint64_t> hits;
+};
+static StageEntry *stage_map = nullptr; // one per superblock slot
+static uint64_t stage_sbs = 0;
+static std::mutex stage_lk;
+static std::vector<char *> stage_free_slots;
+static thread_local uint64_t t_stage_tick = 0;
+
+void ralloc::stage_enable(size_t dram_budget) {
+  std::lock_guard<std::mutex> lk(stage_lk);
+  if (stage_map != nullptr || dram_budget < SBSIZE)
+    return;
+  size_t slots = dram_budget / SBSIZE;
+  char *arena = (char *)mmap(nullptr, slots * SBSIZE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (arena == MAP_FAILED) {
+    perror("stage_enable");
+    return;
+  }
+  stage_free_slots.reserve(slots);
+  for (size_t i = 0; i < slots; i++)
+    stage_free_slots.push_back(arena + i * SBSIZE);
+  stage_sbs = _rgs->regions[SB_IDX]->FILESIZE >> SB_SHIFT;
+  stage_map = new StageEntry[stage_sbs]();
+}
+
+void *ralloc::stage_read(void *ptr) {
+  if (LIKELY(stage_map == nullptr))
+    return ptr;
+  uint64_t off = (uint64_t)ptr - (uint64_t)_rgs->lookup(SB_IDX);
+  uint64_t slot = off >> SB_SHIFT;
+  if (slot >= stage_sbs)
+    return ptr;
+  StageEntry &e = stage_map[slot];
+  char *copy = e.copy.load(std::memory_order_acquire);
+  if (copy != nullptr)
+    return copy + (off & (SBSIZE - 1));
+  // sample misses; promotion copies 64K, so only promote superblocks
+  // that prove themselves hot
+  if ((++t_stage_tick % STAGE_SAMPLE) != 0)
+    return ptr;
+  if (e.hits.fetch_add(1, std::memory_order_relaxed) + 1 <
+      STAGE_PROMOTE_HITS)
+    return ptr;
+  std::lock_guard<std::mutex> lk(stage_lk);
+  if (e.copy.load(std::memory_order_relaxed) != nullptr ||
+      stage_free_slots.empty())
+    return ptr;
+  char *mirror = stage_free_slots.back();
+  stage_free_slots.pop_back();
+  char *sb = (char *)_rgs->lookup(SB_IDX) + (slot << SB_SHIFT);
+  memcpy(mirror, sb, SBSIZE);
+  e.copy.store(mirror, std::memory_order_release);
+  return mirror + (off & (SBSIZE - 1));
+}
+
+void ralloc::stage_write(void *ptr, const void *src, size_t len) {
+  // write-through: PM first, with the usual flush discipline, then the
+  // mirror, so a crash at any point leaves PM authoritative
+  memcpy(ptr, src, len);
+  for (uint64_t line = (uint64_t)ptr & ~(uint64_t)(CACHELINE_SIZE - 1);
+       line < (uint64_t)ptr + len; line += CACHELINE_SIZE) {
+    FLUSH((char *)line);
+  }
+  FLUSHFENCE;
+  if (LIKELY(stage_map == nullptr))
+    return;
+  uint64_t off = (uint64_t)ptr - (uint64_t)_rgs->lookup(SB_IDX);
+  uint64_t slot = off >> SB_SHIFT;
+  if (slot >= stage_sbs)
+    return;
+  char *copy = stage_map[slot].copy.load(std::memory_order_acquire);
+  if (copy != nullptr)
+    memcpy(copy + (off & (SBSIZE - 1)), src, len);
+}
+
+// mbind len bytes at addr (page-aligned) to node; used at superblock
+// granularity so per-node placement works inside one flat region
+static void bind_block_numa(void *addr, size_t len, int node) {
+  if (node < 0)
+    return;
+  const unsigned long mask = 1UL << node;
+  if (mbind(addr, len, MPOL_BIND, &mask, sizeof(mask) * 8, 0) < 0) {
+    perror("mbind");
+  }
+}
+
 void BaseMeta::set_dirty() {
   // this must be called AFTER is_dirty
   int s = pthread_mutex_trylock(&dirty_mtx);
@@ -194,7 +945,7 @@ bool BaseMeta::is_dirty() {
 void BaseMeta::set_clean() { pthread_mutex_unlock(&dirty_mtx); }
 
 BaseMeta::BaseMeta() noexcept
-    : avail_sb(), heaps()
+    : avail_sb(), avail_sb_span(), heaps()
 // thread_num(thd_num) {
 {
   /* allocate these persistent data into specific memory address */
@@ -207,9 +958,18 @@ BaseMeta::BaseMeta() noexcept
   /* heaps init */
   for (size_t idx = 0; idx < MAX_SZ_IDX; ++idx) {
     ProcHeap &heap = heaps[idx];
-    heap.partial_list.store(nullptr);
+    for (int s = 0; s < PARTIAL_SHARDS; s++) {
+      heap.partial_lists[s].list.store(nullptr);
+    }
     heap.sc_idx = idx;
     FLUSH(&heaps[idx]);
+
+    ProcHeap &cold_heap = cold_heaps[idx];
+    for (int s = 0; s < PARTIAL_SHARDS; s++) {
+      cold_heap.partial_lists[s].list.store(nullptr);
+    }
+    cold_heap.sc_idx = idx;
+    FLUSH(&cold_heaps[idx]);
   }
 
   /* persistent roots init */
@@ -230,7 +990,7 @@ BaseMeta::BaseMeta() noexcept
   _rgs->regions_address[SB_IDX] = (char *)tmp_sec_start;
   // we skip the first sb on purpose so that CrossPtr doesn't start from 0.
   tmp_sec_start = (char *)((uint64_t)tmp_sec_start + SBSIZE);
-  organize_sb_list(tmp_sec_start, SB_REGION_EXPAND_SIZE / SBSIZE - 1);
+  organize_sb_list_parallel(tmp_sec_start, SB_REGION_EXPAND_SIZE / SBSIZE - 1);
   FLUSHFENCE;
 }
 
@@ -290,28 +1050,13 @@ uint32_t BaseMeta::compute_idx(char *superblock, char *block, size_t sc_idx) {
 
   assert(block >= superblock);
   assert(block < superblock + sc->sb_size);
-  // optimize integer division by allowing the compiler to create
-  //  a jump table using size class index
-  // compiler can then optimize integer div due to known divisor
+  // blocks carry no header, so a block's index is exactly its offset
+  // over the class stride; divide with the precomputed round-up
+  // reciprocal (exact for in-superblock offsets) instead of a jump
+  // table over compile-time divisors, which also keeps this correct
+  // for generated tables (RALLOC_TUNED_CLASSES)
   uint32_t diff = uint32_t(block - superblock);
-  uint32_t idx = 0;
-  switch (sc_idx) {
-#define SIZE_CLASS_bin_yes(index, block_size)                                  \
-  case index:                                                                  \
-    assert(sc_block_size == block_size);                                       \
-    idx = diff / block_size;                                                   \
-    break;
-#define SIZE_CLASS_bin_no(index, block_size)
-#define SC(index, lg_grp, lg_delta, ndelta, psz, bin, pgs, lg_delta_lookup)    \
-  SIZE_CLASS_bin_##bin((index + 1), ((1U << lg_grp) + (ndelta << lg_delta)))
-    SIZE_CLASSES
-  default:
-    assert(false);
-    break;
-  }
-#undef SIZE_CLASS_bin_yes
-#undef SIZE_CLASS_bin_no
-#undef SC
+  uint32_t idx = (uint32_t)(((uint64_t)diff * sc->block_magic) >> 32);
 
   assert(diff / sc_block_size == idx);
   return idx;
@@ -330,6 +1075,9 @@ void BaseMeta::fill_cache(size_t sc_idx, TCacheBin *cache) {
   (void)sc;
   assert(block_num > 0);
   assert(block_num <= sc->cache_block_num);
+
+  t_stats.stats.refills[sc_idx]++;
+  stat_event(STAT_REFILL, sc_idx);
 }
 
 size_t BaseMeta::cache_count(size_t sc_idx, TCacheBin *cache) {
@@ -345,6 +1093,8 @@ size_t BaseMeta::cache_size(size_t sc_idx, TCacheBin *cache) {
 }
 
 void BaseMeta::flush_cache(size_t sc_idx, TCacheBin *cache) {
+  t_stats.stats.flushes[sc_idx]++;
+  stat_event(STAT_FLUSH, sc_idx);
   ProcHeap *heap = &heaps[sc_idx];
   SizeClassData *sc = get_sizeclass_by_idx(sc_idx);
   uint32_t const sb_size = sc->sb_size;
@@ -354,6 +1104,17 @@ void BaseMeta::flush_cache(size_t sc_idx, TCacheBin *cache) {
   uint32_t const maxcount = sc->get_block_num();
   (void)maxcount; // suppress unused warning
 
+  // lines dirtied by this eviction (the free-list link at the head of
+  // each returned block); freed neighbors often share a line, so write
+  // each distinct line back once with one fence per superblock run
+  // instead of flushing per block
+  static thread_local std::vector<char *> dirtied_lines;
+
+  // the flush walk below goes through the blocks' pptr words, so fold
+  // any unconsumed run into the list shape first (same stores the
+  // relinking below would issue anyway)
+  cache->materialize_run();
+
   // @todo: optimize
   // in the normal case, we should be able to return several
   //  blocks with a single CAS
@@ -362,11 +1123,23 @@ void BaseMeta::flush_cache(size_t sc_idx, TCacheBin *cache) {
     char *tail = head;
     Descriptor *desc = desc_lookup(head);
     char *superblock = static_cast<char *>(desc->superblock);
+    // head may sit in an interior stride of a multi-stride superblock,
+    // whose descriptor only mirrors the geometry; the live anchor is in
+    // the span head's descriptor
+    desc = desc_lookup(superblock);
+    // the anchor CAS below must not race a pending lazy sweep of this
+    // superblock
+    lazy_sweep_ensure(superblock);
+    if (PWB_ACTIVE)
+      dirtied_lines.push_back(
+          (char *)((uint64_t)head & ~(uint64_t)(CACHELINE_SIZE - 1)));
 
     // cache is a linked list of blocks
     // superblock free list is also a linked list of blocks
     // can optimize transfers of blocks between these 2 entities
     //  by exploiting existing structure
+    sb_dirty_mark(superblock);
+
     uint32_t block_count = 1;
     // check if next cache blocks are in the same superblock
     // same superblock, same descriptor
@@ -375,12 +1148,22 @@ void BaseMeta::flush_cache(size_t sc_idx, TCacheBin *cache) {
       if (ptr < superblock || ptr >= superblock + sb_size)
         break; // ptr not in superblock
 
+      // issue the next hop early; the dependent loads of this walk are
+      // what a cold flush stalls on
+      PREFETCH(ptr);
+      if (PWB_ACTIVE)
+        dirtied_lines.push_back(
+            (char *)((uint64_t)ptr & ~(uint64_t)(CACHELINE_SIZE - 1)));
       // ptr in superblock, add to "list"
       ++block_count;
       tail = ptr;
     }
 
-    cache->pop_list(static_cast<char *>(*(pptr<char> *)tail), block_count);
+    char *next_head = static_cast<char *>(*(pptr<char> *)tail);
+    // overlap this run's anchor CAS with the first hop of the next run
+    if (next_head != nullptr)
+      PREFETCH(next_head);
+    cache->pop_list(next_head, block_count);
 
     // add list to desc, update anchor
     uint32_t idx = compute_idx(superblock, head, sc_idx);
@@ -408,6 +1191,23 @@ void BaseMeta::flush_cache(size_t sc_idx, TCacheBin *cache) {
         newanchor.count += block_count;
     } while (!desc->anchor.compare_exchange_weak(oldanchor, newanchor));
 
+    if (PWB_ACTIVE) {
+      // anchor line too; flushing it is safe even if the desc is
+      // concurrently reused
+      dirtied_lines.push_back(
+          (char *)((uint64_t)desc & ~(uint64_t)(CACHELINE_SIZE - 1)));
+      std::sort(dirtied_lines.begin(), dirtied_lines.end());
+      char *prev_line = nullptr;
+      for (char *line : dirtied_lines) {
+        if (line != prev_line) {
+          FLUSH(line);
+        }
+        prev_line = line;
+      }
+      FLUSHFENCE;
+      dirtied_lines.clear();
+    }
+
     // after last CAS, can't reliably read any desc fields
     // as desc might have become empty and been concurrently reused
     assert(oldanchor.avail < maxcount || oldanchor.state == SB_FULL);
@@ -418,7 +1218,7 @@ void BaseMeta::flush_cache(size_t sc_idx, TCacheBin *cache) {
     if (oldanchor.state == SB_FULL) {
       if (newanchor.state == SB_EMPTY) {
         // this sb becomes empty from full
-        small_sb_retire(superblock, SBSIZE);
+        small_sb_retire(superblock, sb_size);
       } else {
         // this sb becomes partial from full
         heap_push_partial(desc);
@@ -449,34 +1249,46 @@ char *BaseMeta::sb_lookup(Descriptor *desc) {
 
 void BaseMeta::heap_push_partial(Descriptor *desc) {
   ProcHeap *heap = desc->heap;
-  ptr_cnt<Descriptor> oldhead = heap->partial_list.load();
+  auto &partial_list = heap->partial_lists[t_partial_shard].list;
+  ptr_cnt<Descriptor> oldhead = partial_list.load();
   ptr_cnt<Descriptor> newhead;
   do {
     newhead.set(desc, oldhead.get_counter() + 1);
     assert(oldhead.get_ptr() != newhead.get_ptr());
     newhead.get_ptr()->next_partial.store(oldhead.get_ptr());
-  } while (!heap->partial_list.compare_exchange_weak(oldhead, newhead));
+  } while (!partial_list.compare_exchange_weak(oldhead, newhead));
 }
 
 Descriptor *BaseMeta::heap_pop_partial(ProcHeap *heap) {
-  ptr_cnt<Descriptor> oldhead = heap->partial_list.load();
-  ptr_cnt<Descriptor> newhead;
-  do {
-    Descriptor *olddesc = oldhead.get_ptr();
-    if (!olddesc) {
-      return nullptr;
+  // pop from the local shard first; when it runs dry, steal from the
+  // other shards so no shard hoards partial superblocks forever
+  for (int i = 0; i < PARTIAL_SHARDS; i++) {
+    size_t shard = (t_partial_shard + i) % PARTIAL_SHARDS;
+    auto &partial_list = heap->partial_lists[shard].list;
+    ptr_cnt<Descriptor> oldhead = partial_list.load();
+    ptr_cnt<Descriptor> newhead;
+    bool empty = false;
+    do {
+      Descriptor *olddesc = oldhead.get_ptr();
+      if (!olddesc) {
+        empty = true;
+        break;
+      }
+      Descriptor *desc = olddesc->next_partial.load();
+      uint64_t counter = oldhead.get_counter();
+      newhead.set(desc, counter);
+    } while (!partial_list.compare_exchange_weak(oldhead, newhead));
+    if (!empty) {
+      return oldhead.get_ptr();
     }
-    Descriptor *desc = olddesc->next_partial.load();
-    uint64_t counter = oldhead.get_counter();
-    newhead.set(desc, counter);
-  } while (!heap->partial_list.compare_exchange_weak(oldhead, newhead));
-  return oldhead.get_ptr();
+  }
+  return nullptr;
 }
 
 void BaseMeta::malloc_from_partial(size_t sc_idx, TCacheBin *cache,
                                    size_t &block_num) {
 retry:
-  ProcHeap *heap = &heaps[sc_idx];
+  ProcHeap *heap = t_alloc_cold ? &cold_heaps[sc_idx] : &heaps[sc_idx];
 
   Descriptor *desc = heap_pop_partial(heap);
   if (!desc)
@@ -519,6 +1331,7 @@ retry:
   uint32_t block_take = oldanchor.count;
   uint32_t avail = oldanchor.avail;
 
+  sb_dirty_mark(superblock);
   assert(avail < maxcount);
   char *block = superblock + avail * block_size;
 
@@ -533,13 +1346,17 @@ retry:
 
 void BaseMeta::malloc_from_newsb(size_t sc_idx, TCacheBin *cache,
                                  size_t &block_num) {
-  ProcHeap *heap = &heaps[sc_idx];
+  // desc->heap keeps the temperature: frees and partial pushes of this
+  // superblock stay on the heap it was carved for
+  ProcHeap *heap = t_alloc_cold ? &cold_heaps[sc_idx] : &heaps[sc_idx];
   SizeClassData *sc = get_sizeclass_by_idx(sc_idx);
   uint32_t const block_size = sc->block_size;
   uint32_t const maxcount = sc->get_block_num();
 
   char *superblock = reinterpret_cast<char *>(small_sb_alloc(sc->sb_size));
   assert(superblock);
+  bind_block_numa(superblock, sc->sb_size, t_alloc_node);
+  sb_dirty_mark(superblock);
   Descriptor *desc = desc_lookup(superblock);
 
   desc->heap = heap;
@@ -547,16 +1364,25 @@ void BaseMeta::malloc_from_newsb(size_t sc_idx, TCacheBin *cache,
   desc->maxcount = maxcount;
   desc->superblock = superblock;
 
-  // prepare block list
-  for (uint32_t idx = 0; idx < maxcount - 1; ++idx) {
-    pptr<char> *block = (pptr<char> *)(superblock + idx * block_size);
-    char *next = superblock + (idx + 1) * block_size;
-    *block = next;
+  // interior strides of a multi-stride superblock carry mirror
+  // descriptors: same geometry, superblock pointing back at the span
+  // head, so desc_lookup on any block in the span answers do_free and
+  // do_malloc_size; only the head's anchor is live
+  for (uint32_t off = SBSIZE; off < sc->sb_size; off += SBSIZE) {
+    Descriptor *mirror = desc_lookup(superblock + off);
+    mirror->heap = heap;
+    mirror->block_size = block_size;
+    mirror->maxcount = maxcount;
+    mirror->superblock = superblock;
+    mirror->next_free.store(nullptr);
+    mirror->next_partial.store(nullptr);
+    FLUSH(mirror);
   }
 
-  // push blocks to thread local cache
-  char *block = superblock; // first block
-  cache->push_list(block, maxcount);
+  // push blocks to thread local cache as an arithmetic run: no link
+  // words to write (a full superblock of stores) and no dependent-load
+  // walk when they are handed out
+  cache->push_run(superblock, maxcount, block_size);
 
   Anchor anchor;
   anchor.avail = maxcount;
@@ -567,6 +1393,13 @@ void BaseMeta::malloc_from_newsb(size_t sc_idx, TCacheBin *cache,
   FLUSH(desc);
   FLUSHFENCE;
 
+  // write-through to the DRAM shadow now that the PM copy is durable;
+  // every stride of the span gets the word, since do_free indexes the
+  // shadow by the freed block's own stride
+  for (uint32_t off = 0; off < sc->sb_size; off += SBSIZE)
+    shadow_fill(shadow_sb_index(superblock + off), sc_idx, maxcount,
+                block_size);
+
   assert(anchor.avail < maxcount || anchor.state == SB_FULL);
   assert(anchor.count < maxcount);
 
@@ -596,24 +1429,146 @@ inline void BaseMeta::organize_sb_list(void *start, uint64_t count) {
   } while (!avail_sb.compare_exchange_weak(oldhead, newhead));
 }
 
+// span counterpart of organize_sb_list: chain count SB_SPAN_SIZE spans
+// starting at start onto avail_sb_span. Every descriptor in the range
+// is wiped (not just the span heads), preserving the invariant that a
+// free stride's descriptor never claims to be in use.
+void BaseMeta::organize_sb_span_list(void *start, uint64_t count) {
+  Descriptor *desc_start = desc_lookup((char *)((uint64_t)start));
+  Descriptor *desc = desc_start;
+  for (uint64_t i = 0; i < count; i++) {
+    for (uint64_t s = 0; s < SB_SPAN_STRIDES; s++)
+      new (desc_start + i * SB_SPAN_STRIDES + s) Descriptor();
+    if (i > 0) {
+      desc->next_free.store(desc + SB_SPAN_STRIDES); // pptr
+      desc += SB_SPAN_STRIDES;
+    }
+  }
+  ptr_cnt<Descriptor> oldhead = avail_sb_span.load();
+  ptr_cnt<Descriptor> newhead;
+  do {
+    desc->next_free.store(oldhead.get_ptr());
+    newhead.set(desc_start, oldhead.get_counter() + 1);
+  } while (!avail_sb_span.compare_exchange_weak(oldhead, newhead));
+}
+
+/*
+ * function BaseMeta::organize_sb_list_parallel
+ *
+ * Description:
+ *  Cold-start formatting of a fresh pool is dominated by constructing
+ *  the descriptor array, and every store in it is independent, so carve
+ *  the range across worker threads, stitch the chain with one CAS and
+ *  close with a single fence instead of serializing on one core's
+ *  store/flush throughput. Runtime expansions keep using the serial
+ *  organize_sb_list; their ranges are too small to amortize threads.
+ */
+void BaseMeta::organize_sb_list_parallel(void *start, uint64_t count) {
+  // span-first: a single-stride request splits a free span on demand
+  // (see small_sb_alloc) but singles only re-combine into spans in a
+  // GC sweep, so fresh space goes out at the larger granularity
+  uint64_t spans = count / SB_SPAN_STRIDES;
+  uint64_t leftover = count % SB_SPAN_STRIDES;
+
+  uint64_t workers = std::thread::hardware_concurrency();
+  if (const char *env = getenv("RALLOC_FORMAT_THREADS")) {
+    workers = strtoul(env, nullptr, 10);
+  }
+  // don't bother spawning for ranges a single core formats instantly
+  const uint64_t min_per_worker = 1024;
+  if (workers > count / min_per_worker)
+    workers = count / min_per_worker;
+  if (workers <= 1) {
+    if (spans > 0)
+      organize_sb_span_list(start, spans);
+    if (leftover > 0)
+      organize_sb_list((char *)((uint64_t)start + spans * SB_SPAN_SIZE),
+                       leftover);
+    return;
+  }
+
+  Descriptor *desc_start = desc_lookup((char *)((uint64_t)start));
+  std::vector<std::thread> pool;
+  for (uint64_t w = 0; w < workers; w++) {
+    pool.emplace_back([=]() {
+      uint64_t lo = count * w / workers;
+      uint64_t hi = count * (w + 1) / workers;
+      Descriptor *desc = desc_start + lo;
+      for (uint64_t i = lo; i < hi; i++, desc++) {
+        new (desc) Descriptor();
+        // only span heads join the chain; the successor's address is
+        // arithmetic, so ranges stitch for free
+        if (i % SB_SPAN_STRIDES == 0 &&
+            i + SB_SPAN_STRIDES < spans * SB_SPAN_STRIDES) {
+          desc->next_free.store(desc + SB_SPAN_STRIDES); // pptr
+        }
+      }
+    });
+  }
+  for (auto &worker : pool) {
+    worker.join();
+  }
+
+  // push the whole span chain with one CAS, as organize_sb_span_list
+  // does, and hand the leftover strides (already formatted) to avail_sb
+  Descriptor *desc_end = desc_start + (spans - 1) * SB_SPAN_STRIDES;
+  ptr_cnt<Descriptor> oldhead = avail_sb_span.load();
+  ptr_cnt<Descriptor> newhead;
+  do {
+    desc_end->next_free.store(oldhead.get_ptr());
+    newhead.set(desc_start, oldhead.get_counter() + 1);
+  } while (!avail_sb_span.compare_exchange_weak(oldhead, newhead));
+  if (leftover > 0)
+    organize_sb_list((char *)((uint64_t)start + spans * SB_SPAN_SIZE),
+                     leftover);
+  FLUSHFENCE;
+}
+
 void *BaseMeta::small_sb_alloc(size_t size) {
-  if (size != SBSIZE) {
+  if (size != SBSIZE && size != SB_SPAN_SIZE) {
     std::cout << "desired size: " << size << std::endl;
     assert(0);
   }
+  auto &free_list = size == SBSIZE ? avail_sb : avail_sb_span;
 
   Descriptor *oldptr = nullptr;
 
-  ptr_cnt<Descriptor> oldhead = avail_sb.load();
+  ptr_cnt<Descriptor> oldhead = free_list.load();
   while (true) {
     oldptr = oldhead.get_ptr();
     if (oldptr) {
       ptr_cnt<Descriptor> newhead;
       newhead.set(oldptr->next_free.load(), oldhead.get_counter());
-      if (avail_sb.compare_exchange_strong(oldhead, newhead)) {
+      if (free_list.compare_exchange_strong(oldhead, newhead)) {
         return reinterpret_cast<void *>(sb_lookup(oldptr));
       }
     } else {
+      // a single-stride request can split a free span (the reverse
+      // direction, singles back into spans, only happens in a GC
+      // sweep, which is why fresh space is carved span-first)
+      if (size == SBSIZE) {
+        ptr_cnt<Descriptor> oldspan = avail_sb_span.load();
+        Descriptor *span = oldspan.get_ptr();
+        if (span != nullptr) {
+          ptr_cnt<Descriptor> newspan;
+          newspan.set(span->next_free.load(), oldspan.get_counter());
+          if (avail_sb_span.compare_exchange_strong(oldspan, newspan)) {
+            char *res = sb_lookup(span);
+            organize_sb_list((char *)((uint64_t)res + SBSIZE),
+                             SB_SPAN_STRIDES - 1);
+            new (span) Descriptor();
+            return (void *)res;
+          }
+          oldhead = free_list.load();
+          continue;
+        }
+      }
+      // a pending lazy sweep is where free superblocks hide; help
+      // sweep a batch and re-check before expanding the region
+      if (lazy_sweep_help(64)) {
+        oldhead = free_list.load();
+        continue;
+      }
       // below is effectively _rgs->regions[SB_IDX](&tmp_sec_start,PAGESIZE,
       // SB_REGION_EXPAND_SIZE);
       char *next;
@@ -625,7 +1580,7 @@ void *BaseMeta::small_sb_alloc(size_t size) {
         new_curr_addr += (PAGESIZE - aln_adj);
       res = new_curr_addr;
       next = new_curr_addr + SB_REGION_EXPAND_SIZE;
-      if (avail_sb.load().get_ptr() != nullptr) {
+      if (free_list.load().get_ptr() != nullptr) {
         // ensure this expansion is necessary
         continue;
       }
@@ -643,9 +1598,21 @@ void *BaseMeta::small_sb_alloc(size_t size) {
               old_curr_addr, new_curr_addr)) {
         FLUSH(_rgs->regions[SB_IDX]->curr_addr_ptr);
         FLUSHFENCE;
+        _rgs->regions[SB_IDX]->__materialize_to(
+            (uint64_t)(new_curr_addr - _rgs->regions[SB_IDX]->base_addr));
         DBG_PRINT("expand sb space for small sb allocation\n");
-        organize_sb_list((char *)((uint64_t)res + SBSIZE),
-                         SB_REGION_EXPAND_SIZE / SBSIZE - 1);
+        // keep the fresh space span-granular: spans can always be
+        // split into singles later, but not the other way around
+        uint64_t taken = size / SBSIZE;
+        uint64_t strides = SB_REGION_EXPAND_SIZE / SBSIZE - taken;
+        uint64_t spans = strides / SB_SPAN_STRIDES;
+        if (spans > 0)
+          organize_sb_span_list((char *)((uint64_t)res + size), spans);
+        uint64_t leftover = strides % SB_SPAN_STRIDES;
+        if (leftover > 0)
+          organize_sb_list((char *)((uint64_t)res + size +
+                                    spans * SB_SPAN_SIZE),
+                           leftover);
         Descriptor *desc = desc_lookup(res);
         new (desc) Descriptor();
         return (void *)res;
@@ -655,15 +1622,24 @@ void *BaseMeta::small_sb_alloc(size_t size) {
   }
 }
 inline void BaseMeta::small_sb_retire(void *sb, size_t size) {
-  assert(size == SBSIZE);
-  Descriptor *desc = desc_lookup(sb);
-  new (desc) Descriptor(); // at this time we erase data in this desc
-  ptr_cnt<Descriptor> oldhead = avail_sb.load();
+  assert(size == SBSIZE || size == SB_SPAN_SIZE);
+  // invalidate every thread's cached fields for this (and any) sb; the
+  // sb may come back under a different sizeclass
+  sb_retire_gen.fetch_add(1, std::memory_order_release);
+  for (size_t off = 0; off < size; off += SBSIZE) {
+    shadow_clear(shadow_sb_index((char *)sb + off));
+    sb_dirty_mark((char *)sb + off);
+    // erase the head's data and the interior mirrors alike
+    new (desc_lookup((char *)sb + off)) Descriptor();
+  }
+  Descriptor *desc = desc_lookup((char *)sb);
+  auto &free_list = size == SBSIZE ? avail_sb : avail_sb_span;
+  ptr_cnt<Descriptor> oldhead = free_list.load();
   ptr_cnt<Descriptor> newhead;
   do {
     desc->next_free.store(oldhead.get_ptr());
     newhead.set(desc, oldhead.get_counter() + 1);
-  } while (!avail_sb.compare_exchange_weak(oldhead, newhead));
+  } while (!free_list.compare_exchange_weak(oldhead, newhead));
 }
 
 /*
@@ -680,7 +1656,15 @@ inline void *BaseMeta::large_sb_alloc(size_t size) {
 void BaseMeta::large_sb_retire(void *sb, size_t size) {
   // cout<<"WARNING: Deallocating a large object.\n";
   assert(size % SBSIZE == 0); // size must be a multiple of SBSIZE
-  organize_sb_list(sb, size / SBSIZE);
+  for (size_t off = 0; off < size; off += SBSIZE)
+    sb_dirty_mark((char *)sb + off);
+  // hand the space back span-first; the leftover strides go to avail_sb
+  uint64_t spans = (size / SBSIZE) / SB_SPAN_STRIDES;
+  if (spans > 0)
+    organize_sb_span_list(sb, spans);
+  uint64_t leftover = (size / SBSIZE) % SB_SPAN_STRIDES;
+  if (leftover > 0)
+    organize_sb_list((char *)sb + spans * SB_SPAN_SIZE, leftover);
 }
 
 inline void *BaseMeta::alloc_large_block(size_t sz) {
@@ -693,6 +1677,7 @@ void *BaseMeta::do_malloc(size_t size) {
     size_t sbs = round_up(size, SBSIZE); // round size up to multiple of SBSIZE
     char *ptr = (char *)alloc_large_block(sbs);
     assert(ptr);
+    sb_dirty_mark(ptr);
     Descriptor *desc = desc_lookup(ptr);
 
     desc->heap = &heaps[0];
@@ -710,53 +1695,342 @@ void *BaseMeta::do_malloc(size_t size) {
     FLUSHFENCE;
 
     DBG_PRINT("large, ptr: %p", ptr);
+    t_stats.stats.allocs[0]++;
+    stat_event(STAT_ALLOC, 0);
     return (void *)ptr;
   }
 
   // size class calculation
   size_t sc_idx = get_sizeclass(size);
+  profile_size(size);
 
-  TCacheBin *cache = &t_caches.t_cache[sc_idx];
+  cache_guard_t cg;
+  TCacheBin *cache = &cg.caches().t_cache[sc_idx];
   // fill cache if needed
+  if (UNLIKELY(cache->get_block_num() == 0)) {
+    cache->record_miss(get_sizeclass_by_idx(sc_idx)->cache_block_num);
+    fill_cache(sc_idx, cache);
+  }
+
+  t_stats.stats.allocs[sc_idx]++;
+  stat_event(STAT_ALLOC, sc_idx);
+  return cache->pop_block();
+}
+/*
+ * function BaseMeta::do_aligned_malloc
+ *
+ * Description:
+ *  Aligned allocation with zero padding in the common cases. The sb
+ *  region is carved on page-aligned SBSIZE strides and a block sits at
+ *  superblock + idx * block_size, so every block of a class whose
+ *  block_size is a multiple of align is naturally aligned. For
+ *  power-of-two align up to a page we pick the smallest such class
+ *  that holds size (the power-of-two classes guarantee one exists up
+ *  to 8K; past that the scan can fall through to a whole superblock).
+ *  The result is a plain class block: RP_free works on it unchanged
+ *  and no bookkeeping pointer is needed. Unsupported alignments
+ *  (non-power-of-two, or beyond a page) return NULL rather than
+ *  handing back an interior pointer free() could not take.
+ */
+void *BaseMeta::do_aligned_malloc(size_t align, size_t size) {
+  if (align == 0 || (align & (align - 1)) != 0 || align > PAGESIZE)
+    return nullptr;
+  if (size == 0)
+    size = 1;
+  if (UNLIKELY(size > MAX_SZ))
+    return do_malloc(size); // large blocks sit on SBSIZE strides
+
+  size_t sc_idx = get_sizeclass(size);
+  while (sc_idx < MAX_SZ_IDX &&
+         get_sizeclass_by_idx(sc_idx)->block_size % align != 0)
+    sc_idx++;
+  if (sc_idx >= MAX_SZ_IDX ||
+      get_sizeclass_by_idx(sc_idx)->block_size > (uint32_t)MAX_SZ)
+    return do_malloc(MAX_SZ + 1); // nothing lined up; take a superblock
+
+  profile_size(size);
+  cache_guard_t cg;
+  TCacheBin *cache = &cg.caches().t_cache[sc_idx];
+  if (UNLIKELY(cache->get_block_num() == 0)) {
+    cache->record_miss(get_sizeclass_by_idx(sc_idx)->cache_block_num);
+    fill_cache(sc_idx, cache);
+  }
+  t_stats.stats.allocs[sc_idx]++;
+  stat_event(STAT_ALLOC, sc_idx);
+  return cache->pop_block();
+}
+
+void *BaseMeta::do_malloc_node(size_t size, int node) {
+  if (UNLIKELY(node < 0))
+    return do_malloc(size);
+
+  if (UNLIKELY(size > MAX_SZ)) {
+    // large blocks bypass the cache; bind the carved superblocks directly
+    t_alloc_node = node;
+    void *ptr = do_malloc(size);
+    bind_block_numa(ptr, round_up(size, SBSIZE), node);
+    t_alloc_node = -1;
+    return ptr;
+  }
+
+  size_t sc_idx = get_sizeclass(size);
+  cache_guard_t cg;
+  TCacheBin *cache = &cg.caches().t_cache[sc_idx];
+  // blocks cached for another node would defeat the placement request;
+  // give them back before refilling for this node
+  if (UNLIKELY(t_cache_node[sc_idx] != node + 1)) {
+    flush_cache(sc_idx, cache);
+    t_cache_node[sc_idx] = node + 1;
+  }
+  t_alloc_node = node;
   if (UNLIKELY(cache->get_block_num() == 0))
     fill_cache(sc_idx, cache);
+  t_alloc_node = -1;
+  profile_size(size);
+  t_stats.stats.allocs[sc_idx]++;
+  stat_event(STAT_ALLOC, sc_idx);
+  return cache->pop_block();
+}
+
+void *BaseMeta::do_malloc_hint(size_t size, bool cold) {
+  // large blocks already own whole superblocks; nothing to segregate
+  if (UNLIKELY(size > MAX_SZ))
+    return do_malloc(size);
 
+  size_t sc_idx = get_sizeclass(size);
+  profile_size(size);
+  cache_guard_t cg;
+  TCacheBin *cache = &cg.caches().t_cache[sc_idx];
+  // blocks cached for the other temperature would defeat the
+  // segregation; give them back before refilling. Plain do_malloc
+  // stays hint-free (no extra branch on its path) and hands out
+  // whatever the bin holds, like do_malloc_node leaves node-bound
+  // blocks behind -- callers that care pass the hint consistently.
+  if (UNLIKELY(t_cache_cold[sc_idx] != cold)) {
+    flush_cache(sc_idx, cache);
+    t_cache_cold[sc_idx] = cold;
+  }
+  t_alloc_cold = cold;
+  if (UNLIKELY(cache->get_block_num() == 0)) {
+    cache->record_miss(get_sizeclass_by_idx(sc_idx)->cache_block_num);
+    fill_cache(sc_idx, cache);
+  }
+  t_alloc_cold = false;
+  t_stats.stats.allocs[sc_idx]++;
+  stat_event(STAT_ALLOC, sc_idx);
   return cache->pop_block();
 }
+
+size_t BaseMeta::do_malloc_batch(size_t size, size_t num, void **out) {
+  if (UNLIKELY(size > MAX_SZ)) {
+    // large blocks gain nothing from batching; allocate one by one
+    size_t filled = 0;
+    for (; filled < num; filled++) {
+      out[filled] = do_malloc(size);
+      if (UNLIKELY(out[filled] == nullptr))
+        break;
+    }
+    return filled;
+  }
+
+  size_t sc_idx = get_sizeclass(size);
+  profile_size(size, num);
+  cache_guard_t cg;
+  TCacheBin *cache = &cg.caches().t_cache[sc_idx];
+  size_t filled = 0;
+  while (filled < num) {
+    if (UNLIKELY(cache->get_block_num() == 0))
+      fill_cache(sc_idx, cache);
+
+    // freshly carved superblocks sit in the bin as an arithmetic run:
+    // hand those out with pointer bumps, no PM loads at all
+    if (cache->run_num() > 0) {
+      uint32_t take = min(num - filled, (uint64_t)cache->run_num());
+      char *block = cache->run_base();
+      uint32_t const bs = get_sizeclass_by_idx(sc_idx)->block_size;
+      for (uint32_t i = 0; i < take; i++) {
+        out[filled++] = block;
+        block += bs;
+      }
+      cache->pop_run(take);
+      t_stats.stats.allocs[sc_idx] += take;
+      stat_event(STAT_ALLOC, sc_idx);
+      continue;
+    }
+
+    // hand out as much of the cached list as needed in one walk;
+    // for a freshly carved superblock the list is sequential, so this
+    // is effectively a pointer bump per block instead of a pop each
+    uint32_t take = min(num - filled, (uint64_t)cache->get_block_num());
+    char *block = cache->peek_block();
+    for (uint32_t i = 0; i < take; i++) {
+      out[filled++] = block;
+      block = static_cast<char *>(*(pptr<char> *)block);
+      // pipeline the walk: start the next dependent load while this
+      // iteration's store to out retires
+      if (i + 1 < take)
+        PREFETCH(block);
+    }
+    cache->pop_list(block, take);
+    // one ring event per run; per-block events would flood the ring
+    t_stats.stats.allocs[sc_idx] += take;
+    stat_event(STAT_ALLOC, sc_idx);
+  }
+  return filled;
+}
+
+/*
+ * function BaseMeta::do_warmup
+ *
+ * Description:
+ *  Pre-populate the calling thread's cache bins so its first
+ *  allocations don't pay a burst of refill round-trips. Each entry
+ *  batch-carves the missing blocks (one superblock carve in the common
+ *  case, via do_malloc_batch) and frees them straight back into the
+ *  bin. Targets are clamped to the bin's flush threshold; filling past
+ *  it would make the next free evict the whole bin again.
+ */
+void BaseMeta::do_warmup(const size_t *sizes, const uint32_t *counts,
+                         size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (sizes[i] == 0 || sizes[i] > MAX_SZ)
+      continue; // only small classes are cached
+    size_t sc_idx = get_sizeclass(sizes[i]);
+    SizeClassData *sc = get_sizeclass_by_idx(sc_idx);
+    uint32_t target, have;
+    {
+      // scope the guard: the batch carve and frees below re-enter the
+      // cache themselves
+      cache_guard_t cg;
+      TCacheBin *cache = &cg.caches().t_cache[sc_idx];
+      target = min(counts[i], cache->capacity(sc->cache_block_num));
+      have = cache->get_block_num();
+    }
+    if (have >= target)
+      continue;
+    uint32_t want = target - have;
+    std::vector<void *> blocks(want);
+    size_t filled = do_malloc_batch(sc->block_size, want, blocks.data());
+    for (size_t b = 0; b < filled; b++) {
+      do_free(blocks[b]);
+    }
+  }
+}
+
 void BaseMeta::do_free(void *ptr) {
   if (ptr == nullptr)
     return;
   assert(_rgs->in_range(SB_IDX, ptr));
-  Descriptor *desc = desc_lookup(ptr);
-  // @todo: this can happen with dynamic loading
-  // need to print correct message
+  uint64_t sb_index = (((uint64_t)ptr) >> SB_SHIFT) -
+                      (((uint64_t)_rgs->lookup(SB_IDX)) >> SB_SHIFT);
+  DescCacheEntry &entry = t_desc_cache[sb_index % DESC_CACHE_SIZE];
+  uint64_t gen = sb_retire_gen.load(std::memory_order_acquire);
+  size_t sc_idx;
+  if (entry.sb_index == sb_index && entry.gen == gen) {
+    sc_idx = entry.sc_idx;
+    assert(sc_idx == desc_lookup((char *)ptr)->heap->sc_idx);
+  } else if (uint64_t packed = shadow_read(sb_index)) {
+    // t_desc_cache miss, shadow hit: the geometry comes from DRAM and
+    // the descriptor line is never touched
+    sc_idx = shadow_sc_idx(packed);
+    assert(sc_idx == desc_lookup((char *)ptr)->heap->sc_idx);
+    entry = {sb_index, gen, (uint32_t)sc_idx, shadow_block_size(packed)};
+  } else {
+    Descriptor *desc = desc_lookup(ptr);
+    // @todo: this can happen with dynamic loading
+    // need to print correct message
+
+    sc_idx = desc->heap->sc_idx;
+    // DBG_PRINT("Desc %p, ptr %p", desc, ptr);
+
+    // large allocation case
+    if (UNLIKELY(!sc_idx)) {
+      char *superblock = desc->superblock;
+      // retiring reformats the span's descriptors; sweep it first
+      lazy_sweep_ensure(superblock);
+      // free superblock
+      large_sb_retire(superblock, desc->block_size);
+      t_stats.stats.frees[0]++;
+      stat_event(STAT_FREE, 0);
+      return;
+    }
+    // lazy refill for superblocks carved before the shadow came up
+    // (i.e. before this restart)
+    shadow_fill(sb_index, sc_idx, desc->maxcount, desc->block_size);
+    entry = {sb_index, gen, (uint32_t)sc_idx, (uint32_t)desc->block_size};
+  }
+  t_stats.stats.frees[sc_idx]++;
+  stat_event(STAT_FREE, sc_idx);
 
-  size_t sc_idx = desc->heap->sc_idx;
-  // DBG_PRINT("Desc %p, ptr %p", desc, ptr);
+  cache_guard_t cg;
+  TCacheBin *cache = &cg.caches().t_cache[sc_idx];
+  SizeClassData *sc = get_sizeclass_by_idx(sc_idx);
 
-  // large allocation case
-  if (UNLIKELY(!sc_idx)) {
-    char *superblock = desc->superblock;
-    // free superblock
-    large_sb_retire(superblock, desc->block_size);
+  // flush cache if need
+  if (UNLIKELY(cache->get_block_num() >= cache->capacity(sc->cache_block_num))) {
+    flush_cache(sc_idx, cache);
+    cache->record_flush(sc->cache_block_num);
+  }
+
+  cache->push_block((char *)ptr);
+}
+
+void BaseMeta::do_free_sized(void *ptr, size_t size) {
+  if (ptr == nullptr)
+    return;
+  // large blocks need the descriptor anyway; take the generic path
+  if (UNLIKELY(size > MAX_SZ)) {
+    do_free(ptr);
     return;
   }
+  assert(_rgs->in_range(SB_IDX, ptr));
+  // the size tells us the size class directly, like C++17 sized delete
+  size_t sc_idx = get_sizeclass(size);
+  assert(sc_idx == desc_lookup(ptr)->heap->sc_idx);
+  t_stats.stats.frees[sc_idx]++;
+  stat_event(STAT_FREE, sc_idx);
 
-  TCacheBin *cache = &t_caches.t_cache[sc_idx];
+  cache_guard_t cg;
+  TCacheBin *cache = &cg.caches().t_cache[sc_idx];
   SizeClassData *sc = get_sizeclass_by_idx(sc_idx);
 
   // flush cache if need
-  if (UNLIKELY(cache->get_block_num() >= sc->cache_block_num))
+  if (UNLIKELY(cache->get_block_num() >= cache->capacity(sc->cache_block_num))) {
     flush_cache(sc_idx, cache);
+    cache->record_flush(sc->cache_block_num);
+  }
 
   cache->push_block((char *)ptr);
 }
 
+size_t BaseMeta::do_malloc_size(const void *ptr) {
+  uint64_t sb_index = (((uint64_t)ptr) >> SB_SHIFT) -
+                      (((uint64_t)_rgs->lookup(SB_IDX)) >> SB_SHIFT);
+  DescCacheEntry &entry = t_desc_cache[sb_index % DESC_CACHE_SIZE];
+  uint64_t gen = sb_retire_gen.load(std::memory_order_acquire);
+  if (entry.sb_index == sb_index && entry.gen == gen) {
+    return entry.block_size;
+  }
+  if (uint64_t packed = shadow_read(sb_index)) {
+    entry = {sb_index, gen, (uint32_t)shadow_sc_idx(packed),
+             shadow_block_size(packed)};
+    return entry.block_size;
+  }
+  Descriptor *desc = desc_lookup((const char *)ptr);
+  size_t sc_idx = desc->heap->sc_idx;
+  if (LIKELY(sc_idx)) { // large blocks aren't cached; sc 0 retires differently
+    shadow_fill(sb_index, sc_idx, desc->maxcount, desc->block_size);
+    entry = {sb_index, gen, (uint32_t)sc_idx, (uint32_t)desc->block_size};
+  }
+  return (size_t)desc->block_size;
+}
+
 // this can be called by TCaches
 void ralloc::public_flush_cache() {
   if (initialized) {
+    cache_guard_t cg;
     for (int i = 1; i < MAX_SZ_IDX; i++) { // sc 0 is reserved.
-      base_md->flush_cache(i, &t_caches.t_cache[i]);
+      base_md->flush_cache(i, &cg.caches().t_cache[i]);
     }
   }
 }
@@ -764,6 +2038,41 @@ void ralloc::public_flush_cache() {
 size_t GarbageCollection::count = 0;
 size_t GarbageCollection::time = 0;
 
+/* RALLOC_GC_PUNCH_HOLES: after a collection rebuilt the free lists,
+ * hand the dead strides' file blocks back to the filesystem. A churned
+ * pool otherwise keeps every block it ever touched allocated, so the
+ * heap file stays at peak size forever and snapshots/backups pay for
+ * the dead space too. Only the superblock bodies are punched -- their
+ * free-list linkage lives in the descriptor region -- and a punched
+ * range re-materializes on the next write fault when the stride is
+ * carved again, same as the sparse tail of a lazily grown region.
+ * Adjacent strides are merged first so a mostly dead pool costs a few
+ * fallocate calls, not one per superblock. */
+static void punch_free_capacity(Descriptor *sbs, Descriptor *spans) {
+  RegionManager *rm = ralloc::_rgs->regions[SB_IDX];
+  std::vector<std::pair<uint64_t, uint64_t>> runs; // file offset, length
+  for (Descriptor *d = sbs; d != nullptr; d = d->next_free.load())
+    runs.emplace_back((uint64_t)(base_md->sb_lookup(d) - rm->base_addr),
+                      SBSIZE);
+  for (Descriptor *d = spans; d != nullptr; d = d->next_free.load())
+    runs.emplace_back((uint64_t)(base_md->sb_lookup(d) - rm->base_addr),
+                      SB_SPAN_SIZE);
+  std::sort(runs.begin(), runs.end());
+  uint64_t start = 0, len = 0;
+  for (auto &r : runs) {
+    if (len != 0 && start + len == r.first) {
+      len += r.second;
+      continue;
+    }
+    if (len != 0 && rm->__punch_hole(start, len) != 0)
+      return; // filesystem can't punch holes; don't keep trying
+    start = r.first;
+    len = r.second;
+  }
+  if (len != 0)
+    rm->__punch_hole(start, len);
+}
+
 /*
  * function GarbageCollection::operator()
  *
@@ -774,12 +2083,18 @@ size_t GarbageCollection::time = 0;
 void GarbageCollection::operator()() {
   // printf("Start garbage collection...\n");
   auto start = high_resolution_clock::now();
+  // a previous lazy sweep must be finished before its lists are reset
+  base_md->lazy_sweep_drain();
   // Step 0: initialize all transient data
   // printf("Initializing all transient data...");
   base_md->avail_sb.off.store(nullptr); // initialize avail_sb
+  base_md->avail_sb_span.off.store(nullptr);
   for (int i = 0; i < MAX_SZ_IDX; i++) {
-    // initialize partial list of each heap
-    base_md->heaps[i].partial_list.off.store(nullptr);
+    // initialize partial lists of each heap
+    for (int s = 0; s < PARTIAL_SHARDS; s++) {
+      base_md->heaps[i].partial_lists[s].list.off.store(nullptr);
+      base_md->cold_heaps[i].partial_lists[s].list.off.store(nullptr);
+    }
   }
   // printf("Initialized!\n");
 
@@ -792,13 +2107,31 @@ void GarbageCollection::operator()() {
       ralloc::roots_filter_func[i](base_md->roots[i], i, *this);
     }
   }
-  while (!to_filter_node.empty()) {
-    // pop nodes from the stack and call filter function of each node
-    auto func = to_filter_func.top();
-    auto node = to_filter_node.top();
-    to_filter_node.pop();
-    to_filter_func.pop();
-    func(node.first, node.second, *this);
+  if (gen_mode) {
+    // blocks announced through gc_remember are reachable from old
+    // (clean) objects; mark them but don't trace through them — their
+    // own outgoing pointers land in young blocks only via further
+    // gc_remember calls or dirty superblocks
+    for (char *blk : ralloc::gc_take_remembered()) {
+      if (_rgs->in_range(SB_IDX, blk))
+        marked_blk.insert(blk);
+    }
+  }
+  size_t mark_threads = 1;
+  if (const char *env = std::getenv("RALLOC_GC_THREADS")) {
+    mark_threads = max(1, atoi(env));
+  }
+  if (mark_threads > 1) {
+    mark_parallel(mark_threads);
+  } else {
+    while (!to_filter_node.empty()) {
+      // pop nodes from the stack and call filter function of each node
+      auto func = to_filter_func.top();
+      auto node = to_filter_node.top();
+      to_filter_node.pop();
+      to_filter_func.pop();
+      func(node.first, node.second, *this);
+    }
   }
   // printf("Done!\nReachable blocks = %lu\n", marked_blk.size());
   // printf("GC_COUNT:%lu\n", marked_blk.size());
@@ -806,15 +2139,225 @@ void GarbageCollection::operator()() {
 
   // Step 2: sweep phase, update variables.
   // printf("Reconstructing metadata...");
-  char *curr_sb = _rgs->translate(
+  char *first_sb = _rgs->translate(
       SB_IDX, reinterpret_cast<char *>(SBSIZE)); // starting from first sb
-  Descriptor *curr_desc = base_md->desc_lookup(curr_sb);
-  auto curr_marked_blk = marked_blk.begin();
   char *sb_end = _rgs->regions[SB_IDX]->curr_addr_ptr->load();
-  Descriptor *avail_sb = nullptr; // head of new free sb list
 
-  // go through all sb in the region
+  if (!gen_mode && std::getenv("RALLOC_GC_LAZY_SWEEP") &&
+      lazy_publish(this, first_sb, sb_end)) {
+    // the pause ends here; the background sweeper and cooperating
+    // mutators rebuild the rest (see the lazy sweep block near the top
+    // of this file)
+    auto stop = high_resolution_clock::now();
+    GarbageCollection::time +=
+        duration_cast<microseconds>(stop - start).count();
+    // mutator writes from here on count against the fresh baseline;
+    // the mark already captured everything older
+    ralloc::gc_dirty_reset();
+    return;
+  }
+
+  Descriptor *avail_sb = nullptr;   // head of new free sb list
+  Descriptor *avail_span = nullptr; // head of new free span list
+
+  if (mark_threads > 1) {
+    // partition the superblock space; chunk boundaries come from a
+    // cheap descriptor-only walk so no multi-stride superblock is split
+    std::vector<char *> bounds;
+    uint64_t chunk = base_md->round_up(
+        (uint64_t)(sb_end - first_sb) / mark_threads + SBSIZE - 1, SBSIZE);
+    char *sb = first_sb;
+    size_t k = 0;
+    while (sb < sb_end) {
+      if (sb >= first_sb + k * chunk) {
+        bounds.push_back(sb);
+        k++;
+      }
+      Descriptor *d = base_md->desc_lookup(sb);
+      if (d->heap != nullptr && d->heap->sc_idx == 0 && d->superblock == sb) {
+        sb += d->block_size;
+      } else if (d->heap != nullptr && d->superblock == sb) {
+        sb += base_md->get_sizeclass_by_idx(d->heap->sc_idx)->sb_size;
+      } else {
+        sb += SBSIZE;
+      }
+    }
+    bounds.push_back(sb_end);
+
+    size_t nchunk = bounds.size() - 1;
+    std::vector<Descriptor *> heads(nchunk, nullptr);
+    std::vector<Descriptor *> tails(nchunk, nullptr);
+    std::vector<Descriptor *> span_heads(nchunk, nullptr);
+    std::vector<Descriptor *> span_tails(nchunk, nullptr);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < nchunk; i++) {
+      workers.emplace_back([&, i]() {
+        heads[i] = sweep_range(bounds[i], bounds[i + 1], &tails[i],
+                               &span_heads[i], &span_tails[i]);
+      });
+    }
+    for (auto &w : workers) {
+      w.join();
+    }
+    // stitch the per-chunk free-superblock fragments together
+    for (size_t i = 0; i < nchunk; i++) {
+      if (heads[i] != nullptr) {
+        tails[i]->next_free.store(avail_sb);
+        avail_sb = heads[i];
+      }
+      if (span_heads[i] != nullptr) {
+        span_tails[i]->next_free.store(avail_span);
+        avail_span = span_heads[i];
+      }
+    }
+  } else {
+    Descriptor *tail = nullptr;
+    Descriptor *span_tail = nullptr;
+    avail_sb = sweep_range(first_sb, sb_end, &tail, &avail_span, &span_tail);
+  }
+  // store heads of the new free sb and span lists into base_md
+  ptr_cnt<Descriptor> tmp_avail_sb(avail_sb, 0);
+  base_md->avail_sb.store(tmp_avail_sb);
+  ptr_cnt<Descriptor> tmp_avail_span(avail_span, 0);
+  base_md->avail_sb_span.store(tmp_avail_span);
+  // the synchronous sweep just enumerated every dead stride; the lazy
+  // sweep path above skips this (its free lists appear incrementally)
+  if (std::getenv("RALLOC_GC_PUNCH_HOLES"))
+    punch_free_capacity(avail_sb, avail_span);
+  // printf("Reconstructed! \n");
+  auto stop = high_resolution_clock::now();
+  auto duration = duration_cast<microseconds>(stop - start);
+  // cout << "GC_TIME:" << duration.count() << endl;
+  GarbageCollection::time += duration.count();
+
+  // printf("Flushing recovered data...");
+  _rgs->flush_region(DESC_IDX);
+  _rgs->flush_region(SB_IDX);
+  char *addr_to_flush = reinterpret_cast<char *>(base_md);
+  // flush values in BaseMeta, including avail_sb and partial lists
+  for (size_t i = 0; i < sizeof(BaseMeta); i += CACHELINE_SIZE) {
+    addr_to_flush += CACHELINE_SIZE;
+    FLUSH(addr_to_flush);
+  }
+  FLUSHFENCE;
+  // every collection (full or partial) leaves the heap fully
+  // consistent, so it starts the next generational baseline
+  ralloc::gc_dirty_reset();
+  // printf("Garbage collection Completed!\n");
+}
+
+/*
+ * function GarbageCollection::sweep_range
+ *
+ * Description:
+ *  Sweep the superblocks in [start, end), reconstructing descriptors,
+ *  anchors, and partial lists from the mark set. Safe to run on disjoint
+ *  ranges concurrently: heap_push_partial is lock-free and the free-sb
+ *  fragments are merged by the caller.
+ */
+Descriptor *GarbageCollection::sweep_range(char *start, char *end,
+                                           Descriptor **tail,
+                                           Descriptor **span_head,
+                                           Descriptor **span_tail) {
+  char *curr_sb = start;
+  Descriptor *curr_desc = base_md->desc_lookup(curr_sb);
+  auto curr_marked_blk = marked_blk.lower_bound(start);
+  char *sb_end = end;
+  Descriptor *avail_sb = nullptr;   // head of free sb list in this range
+  Descriptor *avail_span = nullptr; // head of free span list in this range
+  *tail = nullptr;
+  *span_tail = nullptr;
+
+  // free strides accumulate as maximal contiguous runs and are carved
+  // span-first when a run closes, so a drained multi-stride superblock
+  // (or any adjacent group of dead ones) goes back to avail_sb_span
+  // instead of degrading into singles
+  char *run_start = nullptr;
+  uint64_t run_len = 0;
+  auto emit_single = [&](Descriptor *d) {
+    if (avail_sb == nullptr)
+      *tail = d; // first push stays the tail of this fragment
+    d->next_free.store(avail_sb);
+    avail_sb = d;
+  };
+  auto emit_span = [&](Descriptor *d) {
+    if (avail_span == nullptr)
+      *span_tail = d;
+    d->next_free.store(avail_span);
+    avail_span = d;
+  };
+  auto close_run = [&]() {
+    uint64_t i = 0;
+    for (; run_len - i >= SB_SPAN_STRIDES; i += SB_SPAN_STRIDES)
+      emit_span(base_md->desc_lookup(run_start + i * SBSIZE));
+    for (; i < run_len; i++)
+      emit_single(base_md->desc_lookup(run_start + i * SBSIZE));
+    run_len = 0;
+  };
+  auto free_stride = [&](char *sb) {
+    if (run_len != 0 && run_start + run_len * SBSIZE == sb) {
+      run_len++;
+    } else {
+      close_run();
+      run_start = sb;
+      run_len = 1;
+    }
+  };
+
+  // go through all sb in the range
   while (curr_sb < sb_end) {
+    if (gen_mode && ralloc::gc_sb_is_clean(curr_sb)) {
+      // untouched since the last collection: the persisted descriptor
+      // and anchor are still correct, so only the transient list
+      // membership that Step 0 reset needs rebuilding
+      if (curr_desc->heap == nullptr || curr_desc->superblock != curr_sb) {
+        // free sb; give it back to the free list fragment
+        new (curr_desc) Descriptor();
+        free_stride(curr_sb);
+      } else if (curr_desc->heap->sc_idx == 0) {
+        // large sb in use; jump over the whole allocation
+        curr_desc->next_free.store(nullptr);
+        curr_desc->next_partial.store(nullptr);
+        while (curr_marked_blk != marked_blk.end() &&
+               *curr_marked_blk < curr_sb + curr_desc->block_size)
+          curr_marked_blk++;
+        curr_sb += curr_desc->block_size;
+        curr_desc = base_md->desc_lookup(curr_sb);
+        continue;
+      } else {
+        // small sb, possibly a multi-stride span
+        uint32_t sbsz =
+            base_md->get_sizeclass_by_idx(curr_desc->heap->sc_idx)->sb_size;
+        Anchor a = curr_desc->anchor.load();
+        if (a.state == SB_EMPTY) {
+          // drained but not yet retired when the baseline was taken;
+          // wipe the head and the interior mirrors alike
+          for (uint32_t off = 0; off < sbsz; off += SBSIZE) {
+            new (base_md->desc_lookup(curr_sb + off)) Descriptor();
+            free_stride(curr_sb + off);
+          }
+        } else {
+          curr_desc->next_free.store(nullptr);
+          if (a.state == SB_PARTIAL) {
+            base_md->heap_push_partial(curr_desc);
+          } else {
+            curr_desc->next_partial.store(nullptr);
+          }
+        }
+        while (curr_marked_blk != marked_blk.end() &&
+               *curr_marked_blk < curr_sb + sbsz)
+          curr_marked_blk++;
+        curr_sb += sbsz;
+        curr_desc = base_md->desc_lookup(curr_sb);
+        continue;
+      }
+      while (curr_marked_blk != marked_blk.end() &&
+             *curr_marked_blk < curr_sb + SBSIZE)
+        curr_marked_blk++;
+      curr_sb += SBSIZE;
+      curr_desc++;
+      continue;
+    }
     Anchor anchor(0, 0, SB_EMPTY);
     char *free_blocks_head = nullptr;
     char *last_possible_free_block = curr_sb;
@@ -835,11 +2378,14 @@ void GarbageCollection::operator()() {
         anchor.state = SB_FULL; // set it as full
         curr_marked_blk++;
 
-        // small sb that's in use
+        // small sb that's in use (marked blocks may sit in any stride
+        // of a multi-stride superblock)
         // curr_marked_blk doesn't reach the end of marked_blk and
         // curr_marked_blk is in curr_sb
       } else if (curr_desc->heap->sc_idx != 0 && *curr_marked_blk >= curr_sb &&
-                 *curr_marked_blk < curr_sb + SBSIZE) {
+                 *curr_marked_blk <
+                     curr_sb + (uint64_t)curr_desc->maxcount *
+                                   curr_desc->block_size) {
         anchor.state = SB_PARTIAL;
         for (char *free_block = last_possible_free_block;
              free_block < (*curr_marked_blk);
@@ -857,10 +2403,10 @@ void GarbageCollection::operator()() {
       }
     }
     if (anchor.state == SB_EMPTY) {
-      // curr_sb isn't in use
+      // curr_sb isn't in use (interior mirrors of dead spans land here
+      // stride by stride and re-coalesce when their run closes)
       new (curr_desc) Descriptor();
-      curr_desc->next_free.store(avail_sb);
-      avail_sb = curr_desc;
+      free_stride(curr_sb);
       curr_sb += SBSIZE;
       curr_desc++;
     } else {
@@ -880,7 +2426,10 @@ void GarbageCollection::operator()() {
         curr_sb += curr_desc->block_size;
         curr_desc = base_md->desc_lookup(curr_sb);
       } else {
-        // small sb that's in use
+        // small sb that's in use; read the span size before the anchor
+        // store below publishes the descriptor
+        uint32_t sbsz =
+            base_md->get_sizeclass_by_idx(curr_desc->heap->sc_idx)->sb_size;
         for (char *free_block = last_possible_free_block;
              free_block < curr_sb + curr_desc->maxcount * curr_desc->block_size;
              free_block += curr_desc->block_size) {
@@ -913,33 +2462,72 @@ void GarbageCollection::operator()() {
           base_md->heap_push_partial(curr_desc);
           curr_desc->anchor.store(anchor);
         }
-        // move curr_sb and curr_desc to next sb
-        curr_sb += SBSIZE;
-        curr_desc++;
+        // move curr_sb and curr_desc past the whole (possibly
+        // multi-stride) sb
+        curr_sb += sbsz;
+        curr_desc = base_md->desc_lookup(curr_sb);
       }
     }
   }
-  // store head of new free sb list into base_md
-  ptr_cnt<Descriptor> tmp_avail_sb(avail_sb, 0);
-  base_md->avail_sb.store(tmp_avail_sb);
-  // printf("Reconstructed! \n");
-  auto stop = high_resolution_clock::now();
-  assert(curr_marked_blk == marked_blk.end());
-  auto duration = duration_cast<microseconds>(stop - start);
-  // cout << "GC_TIME:" << duration.count() << endl;
-  GarbageCollection::time += duration.count();
+  close_run();
+  *span_head = avail_span;
+  return avail_sb;
+}
 
-  // printf("Flushing recovered data...");
-  _rgs->flush_region(DESC_IDX);
-  _rgs->flush_region(SB_IDX);
-  char *addr_to_flush = reinterpret_cast<char *>(base_md);
-  // flush values in BaseMeta, including avail_sb and partial lists
-  for (size_t i = 0; i < sizeof(BaseMeta); i += CACHELINE_SIZE) {
-    addr_to_flush += CACHELINE_SIZE;
-    FLUSH(addr_to_flush);
+/*
+ * function GarbageCollection::mark_parallel
+ *
+ * Description:
+ *  Drain the mark stacks with nthreads workers. Block scans (the filter
+ *  functions, which dominate mark time) run outside mark_lk; only the
+ *  pops and the mark-set inserts inside mark_func serialize. Workers
+ *  quit once every one of them is idle with the stacks drained, since an
+ *  in-flight scan may still push more work.
+ */
+void GarbageCollection::mark_parallel(size_t nthreads) {
+  std::atomic<size_t> idle(0);
+  auto work = [&]() {
+    while (true) {
+      std::function<void(char *, size_t, GarbageCollection &)> func;
+      std::pair<char *, size_t> node;
+      bool got = false;
+      {
+        std::lock_guard<std::mutex> lk(mark_lk);
+        if (!to_filter_node.empty()) {
+          func = to_filter_func.top();
+          node = to_filter_node.top();
+          to_filter_node.pop();
+          to_filter_func.pop();
+          got = true;
+        }
+      }
+      if (got) {
+        func(node.first, node.second, *this);
+        continue;
+      }
+      idle.fetch_add(1);
+      bool resume = false;
+      while (!resume) {
+        {
+          std::lock_guard<std::mutex> lk(mark_lk);
+          if (!to_filter_node.empty()) {
+            idle.fetch_sub(1);
+            resume = true;
+          }
+        }
+        if (!resume && idle.load() == nthreads)
+          return;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < nthreads; i++) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto &w : workers) {
+    w.join();
   }
-  FLUSHFENCE;
-  // printf("Garbage collection Completed!\n");
 }
 
 void GarbageCollection::mark_func_c(char *ptr, size_t tid,
@@ -949,6 +2537,10 @@ void GarbageCollection::mark_func_c(char *ptr, size_t tid,
   // Step 1: check if it's a valid pptr
   if (UNLIKELY(!ralloc::_rgs->in_range(SB_IDX, addr)))
     return; // return if not in range
+  // clean superblocks keep their state in a partial collection; don't
+  // mark into them or trace through them
+  if (gen_mode && ralloc::gc_sb_is_clean(reinterpret_cast<char *>(addr)))
+    return;
   auto res = marked_blk.find(reinterpret_cast<char *>(addr));
   if (res == marked_blk.end()) {
     // Step 2: mark potential pptr
@@ -17,6 +17,7 @@
 #include <atomic>
 #include <iostream>
 #include <functional>
+#include <mutex>
 #include <set>
 #include <vector>
 #include <stack>
@@ -76,6 +77,86 @@ namespace ralloc{
     // function to flush thread-local cache, used in TCaches::~TCaches and
     // BaseMeta::writeback()
     extern void public_flush_cache();
+    // partial-list shard of the calling thread, assigned round-robin
+    extern thread_local size_t t_partial_shard;
+
+    /*
+     * Always-on allocator telemetry. Each thread owns a cacheline-padded
+     * counter block bumped with plain (non-atomic) increments on the hot
+     * paths; stats_read() sums the live blocks plus totals inherited
+     * from exited threads. Snapshots may tear by a few events, which is
+     * fine for monitoring.
+     */
+    struct alignas(CACHELINE_SIZE) RallocStats {
+        uint64_t allocs[MAX_SZ_IDX];
+        uint64_t frees[MAX_SZ_IDX];
+        uint64_t refills[MAX_SZ_IDX];
+        uint64_t flushes[MAX_SZ_IDX];
+    };
+    // sum per-thread counters into *out
+    void stats_read(RallocStats* out);
+
+    /*
+     * Optional lock-free event ring, enabled by setting RALLOC_STAT_RING
+     * to a power-of-two capacity. Producers claim slots with a single
+     * fetch_add and overwrite the oldest events; a monitoring thread
+     * drains with stat_ring_drain(). Off (the default) costs one
+     * predicted-untaken branch per event.
+     */
+    enum StatOp { STAT_ALLOC, STAT_FREE, STAT_REFILL, STAT_FLUSH };
+    struct StatEvent {
+        uint64_t seq; // global order; gaps mean the ring wrapped
+        uint32_t op;      // StatOp
+        uint32_t sc_idx;
+    };
+    // copy up to $max$ undrained events into out; returns the number copied
+    size_t stat_ring_drain(StatEvent* out, size_t max);
+    /*
+     * With RALLOC_SIZE_PROFILE=<path> set, the allocator keeps a
+     * histogram of requested allocation sizes; this writes it to the
+     * given path as "size count" lines (input of test/sizeclass_gen).
+     * Called on heap close; a no-op when profiling is off.
+     */
+    void size_profile_dump();
+    /*
+     * Best-effort, async-signal-safe snapshot of allocator state
+     * (breadcrumb rings, thread cache fill levels, partial list heads
+     * and anchors, free superblock list) written to fd; see
+     * RP_crash_dump in ralloc.hpp.
+     */
+    int crash_dump(int fd);
+    /*
+     * DRAM staging tier for hot superblocks (see RP_stage_* in
+     * ralloc.hpp): read-mostly blocks get a DRAM mirror of their
+     * superblock, located through the same in-superblock offsets, with
+     * write-through to PM. Promotion is driven by sampled stage_read
+     * hit counts.
+     */
+    void stage_enable(size_t dram_budget);
+    void* stage_read(void* ptr);
+    void stage_write(void* ptr, const void* src, size_t len);
+
+    /*
+     * Generational GC support. With tracking enabled the allocator sets
+     * a (transient) dirty byte for every superblock whose blocks or
+     * metadata it changes; a partial collection then traces and rebuilds
+     * only dirty superblocks, trusting the anchors of the clean ones.
+     * Pointers written from old (clean) objects into young blocks bypass
+     * the allocator, so callers must announce them with gc_remember —
+     * the standard generational write-barrier contract.
+     */
+    // enable/disable dirty-superblock tracking
+    void gc_enable_generational(bool enable);
+    // true iff tracking is on and the superblock of addr is unchanged
+    // since the last collection
+    bool gc_sb_is_clean(const char* addr);
+    // record a cross-generation pointer target, keeping it live across
+    // the next partial collection
+    void gc_remember(void* ptr);
+    // take (and clear) the remembered set
+    std::vector<char*> gc_take_remembered();
+    // clear the dirty map after a collection established a new baseline
+    void gc_dirty_reset();
 };
 
 /*
@@ -268,17 +349,29 @@ struct Descriptor {
 }__attribute__((aligned(CACHELINE_SIZE)));
 static_assert(sizeof(Descriptor) == CACHELINE_SIZE, "Invalid Descriptor size");
 
+/*
+ * struct PartialShard
+ *
+ * Descrition:
+ *  One shard of a ProcHeap's partial descriptor list. Each shard sits on
+ *  its own cache line so pushes to different shards don't false-share.
+ */
+struct PartialShard {
+    RP_TRANSIENT AtomicCrossPtrCnt<Descriptor, DESC_IDX> list;
+    PartialShard() noexcept : list(){};
+}__attribute__((aligned(CACHELINE_SIZE)));
+
 /*
  * struct ProcHeap
  *
  * Descrition:
- *  Legacy struct to store the reference to partial list of a sizeclass.
+ *  Legacy struct to store the reference to partial lists of a sizeclass.
  *  Can be merged into sizeclass but I'm too lazy to do so. :D
  */
 struct ProcHeap {
 public:
-    // ptr to descriptor, head of partial descriptor list
-    RP_TRANSIENT AtomicCrossPtrCnt<Descriptor, DESC_IDX> partial_list;
+    // ptrs to descriptors, heads of sharded partial descriptor lists
+    RP_TRANSIENT PartialShard partial_lists[PARTIAL_SHARDS];
     /* size class index; never change after init
      * though it's tagged RP_PERSIST, in 1/sc scheme,
      * we don't have to flush it at all; it's fixed.
@@ -286,7 +379,7 @@ public:
     RP_PERSIST size_t sc_idx;
     // std::mutex lk;
     ProcHeap() noexcept :
-        partial_list(){};
+        partial_lists(){};
 }__attribute__((aligned(CACHELINE_SIZE)));
 
 /*
@@ -302,6 +395,12 @@ public:
     std::set<char*> marked_blk;
     std::stack<std::pair<char*, size_t>> to_filter_node;
     std::stack<std::function<void(char*, size_t, GarbageCollection& gc)>> to_filter_func;
+    // protects marked_blk and the two stacks during the parallel mark;
+    // block scans themselves run outside the lock
+    std::mutex mark_lk;
+    // generational mode: trace and rebuild only superblocks dirtied
+    // since the last collection (see gc_enable_generational)
+    bool gen_mode = false;
 
     static size_t count;
     static size_t time;
@@ -310,6 +409,18 @@ public:
 
     void operator() ();
 
+    // drain the mark stacks with nthreads workers
+    void mark_parallel(size_t nthreads);
+
+    // sweep superblocks in [start, end), rebuilding their descriptors;
+    // returns the head of the free single-stride superblock list found
+    // in the range and writes its tail to *tail; contiguous free runs
+    // long enough are carved into SB_SPAN_SIZE spans instead, returned
+    // through *span_head/*span_tail (all nullptr if the range is fully
+    // live). start and end must not split a multi-stride superblock.
+    Descriptor* sweep_range(char* start, char* end, Descriptor** tail,
+                            Descriptor** span_head, Descriptor** span_tail);
+
     // return true if ptr is a valid and unmarked pointer, otherwise false
     template<class T>
     inline void mark_func(T* ptr, size_t tid){
@@ -317,6 +428,11 @@ public:
         // Step 1: check if it's a valid pptr
         if(UNLIKELY(!ralloc::_rgs->in_range(SB_IDX, addr)))
             return; // return if not in range
+        // clean superblocks keep their state in a partial collection;
+        // don't mark into them or trace through them
+        if(gen_mode && ralloc::gc_sb_is_clean(reinterpret_cast<char*>(addr)))
+            return;
+        std::lock_guard<std::mutex> lk(mark_lk);
         auto res = marked_blk.find(reinterpret_cast<char*>(addr));
         if(res == marked_blk.end()){
             // Step 2: mark potential pptr
@@ -361,10 +477,18 @@ class BaseMeta {
 public:
     // unused small sb
     RP_TRANSIENT AtomicCrossPtrCnt<Descriptor, DESC_IDX> avail_sb;
+    // unused SB_SPAN_SIZE spans for the classes that take multi-stride
+    // superblocks; kept apart from avail_sb since the two granularities
+    // cannot share one list
+    RP_TRANSIENT AtomicCrossPtrCnt<Descriptor, DESC_IDX> avail_sb_span;
     RP_PERSIST pthread_mutexattr_t dirty_attr;
     RP_PERSIST pthread_mutex_t dirty_mtx;
 
     RP_PERSIST ProcHeap heaps[MAX_SZ_IDX];
+    // parallel heaps for RALLOC_COLD allocations: cold superblocks keep
+    // their descriptors pointed here, so hot and cold lifetimes never
+    // share a superblock and freed cold blocks return to cold partials
+    RP_PERSIST ProcHeap cold_heaps[MAX_SZ_IDX];
     RP_PERSIST CrossPtr<char, SB_IDX> roots[MAX_ROOTS];
     friend class GarbageCollection;
     BaseMeta() noexcept;
@@ -375,7 +499,39 @@ public:
         std::cout<<"Warning: BaseMeta is being destructed!\n";
     }
     void* do_malloc(size_t size);
+    // allocate num blocks of size at once, writing them to out;
+    // returns the number of blocks actually allocated
+    size_t do_malloc_batch(size_t size, size_t num, void** out);
+    // do_malloc, but superblocks carved for the refill are bound to the
+    // given NUMA node (-1 falls back to do_malloc)
+    void* do_malloc_node(size_t size, int node);
+    // do_malloc routed by lifetime temperature: cold == true serves the
+    // block from cold_heaps, so cold data gets its own superblocks
+    void* do_malloc_hint(size_t size, bool cold);
+    // do_malloc on an align boundary; exploits size class geometry,
+    // see the definition for what alignments are served
+    void* do_aligned_malloc(size_t align, size_t size);
     void do_free(void* ptr);
+    // do_free for callers that know the allocation size; skips the
+    // descriptor lookup for small blocks
+    void do_free_sized(void* ptr, size_t size);
+    // size of the block ptr points to, answered from the thread-local
+    // descriptor cache when possible
+    size_t do_malloc_size(const void* ptr);
+    // DRAM shadow of the persistent descriptor fields (see BaseMeta.cpp):
+    // sized once at init, kept write-through by the carve/retire paths,
+    // re-derived from the PM descriptor array after a restart
+    void shadow_init(uint64_t num_sb);
+    void shadow_rebuild();
+    // lazy concurrent sweep (RALLOC_GC_LAZY_SWEEP, see BaseMeta.cpp):
+    // sweep the given superblock now if a published sweep hasn't
+    // reached it yet; drain blocks until the whole sweep has finished
+    void lazy_sweep_ensure(char* sb);
+    void lazy_sweep_drain();
+    // pre-populate the calling thread's cache bins (see
+    // RP_thread_warmup); sizes are request byte sizes, counts the
+    // desired number of cached blocks per entry
+    void do_warmup(const size_t* sizes, const uint32_t* counts, size_t n);
     bool is_dirty();
     // set_dirty must be called AFTER is_dirty
     void set_dirty();
@@ -421,6 +577,8 @@ public:
             gc();
         }
         FLUSHFENCE;
+        // descriptors are consistent again; warm the DRAM shadow from them
+        shadow_rebuild();
         // here restart is done, and "dirty" should be set to true until
         // writeback() is called so that crash will result in a true dirty.
         set_dirty();
@@ -430,7 +588,16 @@ public:
         GarbageCollection collect;
         collect();
     }
+    // partial collection: trace and rebuild only superblocks dirtied
+    // since the last collection, plus the remembered set
+    void gc_generational() {
+        GarbageCollection collect;
+        collect.gen_mode = true;
+        collect();
+    }
     void writeback(){
+        // a clean shutdown must not persist half-swept metadata
+        lazy_sweep_drain();
         // Give back tcached blocks *Wentao: no actually ~TCache will do this*
         // Should be called during normal exit
         // ralloc::public_flush_cache();
@@ -485,6 +652,14 @@ private:
 
     // add all newly allocated sbs to free_sb
     void organize_sb_list(void* start, uint64_t count);
+    // chain count SB_SPAN_SIZE spans starting at start onto
+    // avail_sb_span, wiping every descriptor in the range
+    void organize_sb_span_list(void* start, uint64_t count);
+    // cold-start variant: formats the descriptor range with a worker
+    // pool and one closing fence (RALLOC_FORMAT_THREADS overrides the
+    // worker count); carves the range span-first, with the leftover
+    // strides going to avail_sb
+    void organize_sb_list_parallel(void* start, uint64_t count);
     // get one free sb or allocate a new space for sbs
     void* small_sb_alloc(size_t size);
     // free the superblock sb points to
@@ -24,6 +24,7 @@
 #include <fcntl.h>
 #include <numaif.h>
 #include <stdint.h>
+#include <sys/ioctl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/mman.h>
@@ -32,7 +33,296 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <thread>
+#include <vector>
+
+// process-wide region indirection vector backing rptr (see pptr.hpp)
+char* RegionIndirection::bases[RIV_MAX_REGIONS] = {nullptr};
+
+// not exposed by every libc's sys/mman.h
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#ifndef MAP_SHARED_VALIDATE
+#define MAP_SHARED_VALIDATE 0x03
+#endif
+#ifndef MAP_SYNC
+#define MAP_SYNC 0x80000
+#endif
+#ifndef FALLOC_FL_KEEP_SIZE
+#define FALLOC_FL_KEEP_SIZE 0x01
+#endif
+#ifndef FALLOC_FL_PUNCH_HOLE
+#define FALLOC_FL_PUNCH_HOLE 0x02
+#endif
+
+// bind a fresh mapping to the NUMA node named by CXL_NUMA_NODE, if any
+void RegionManager::__bind_numa(void *addr, size_t len) {
+  if (const char *numa = std::getenv("CXL_NUMA_NODE")) {
+    std::size_t pos{};
+    const int node{std::stoi(numa, &pos)};
+    const unsigned long mask = 1 << node;
+    if (mbind(addr, len, MPOL_BIND, &mask, sizeof(mask) * 8, 0) < 0) {
+      perror("mbind");
+      exit(1);
+    }
+  }
+}
+
+/* Huge-page backing, controlled by RALLOC_HUGE_PAGES=2M or =1G.
+ * Multi-GB pools on 4K pages spend a measurable share of cycles in DTLB
+ * misses; 2M (or 1G) pages cut the TLB reach problem directly. hugetlbfs
+ * can only back anonymous/hugetlbfs mappings, so file-backed regions get
+ * MADV_HUGEPAGE instead and rely on THP. */
+int RegionManager::__huge_mmap_flags() {
+  const char *huge = std::getenv("RALLOC_HUGE_PAGES");
+  if (huge == nullptr)
+    return 0;
+  if (huge[0] == '1' && huge[1] == 'G')
+    return MAP_HUGETLB | MAP_HUGE_1GB;
+  return MAP_HUGETLB | MAP_HUGE_2MB;
+}
+
+void RegionManager::__advise_huge(void *addr, size_t len) {
+  if (std::getenv("RALLOC_HUGE_PAGES") == nullptr)
+    return;
+  if (madvise(addr, len, MADV_HUGEPAGE) < 0) {
+    perror("madvise");
+  }
+}
+
+/* Page-population policy, controlled by RALLOC_PREFAULT. First-touch
+ * faults on a freshly mapped multi-GB region serialize into the kernel
+ * exactly when the workload warms up, showing as p999 spikes right
+ * after start.
+ *   "map" adds MAP_POPULATE, so mmap returns with the page tables
+ *         pre-filled; the whole cost is paid once, before any
+ *         allocation runs.
+ *   "bg"  spawns a detached toucher thread that read-faults one byte
+ *         per page front to back -- the same order the bump frontier
+ *         advances -- so it stays ahead of the allocations and start-up
+ *         isn't delayed.
+ * Unset keeps the kernel's demand paging, as before. Read faults leave
+ * shared mappings write-protected, so the first store to a page still
+ * takes a (much cheaper) write-notify fault. */
+int RegionManager::__populate_mmap_flag() {
+  const char *mode = std::getenv("RALLOC_PREFAULT");
+  if (mode != nullptr && strcmp(mode, "map") == 0)
+    return MAP_POPULATE;
+  return 0;
+}
+
+void RegionManager::__prefault_bg(void *addr, size_t len) {
+  const char *mode = std::getenv("RALLOC_PREFAULT");
+  if (mode == nullptr || strcmp(mode, "bg") != 0)
+    return;
+  std::thread([addr, len]() {
+    const volatile char *p = (const volatile char *)addr;
+    for (size_t off = 0; off < len; off += PAGESIZE)
+      (void)p[off];
+  }).detach();
+}
+
+/* Lazily materialized regions keep the whole FILESIZE range mapped but
+ * only fallocate file blocks up to a high-water mark, advanced in
+ * REGION_MATERIALIZE_SIZE chunks here. The CAS decides a single winner
+ * per chunk; racing threads that sail past an in-flight fallocate just
+ * fault onto the (ftruncate'd, hence valid) sparse tail, so this is a
+ * capacity reservation and write prefault, never a correctness gate. */
+void RegionManager::__materialize_to(uint64_t end) {
+  if (!lazy)
+    return;
+  uint64_t cur = materialized.load(std::memory_order_acquire);
+  while (cur < end) {
+    uint64_t target = (end + REGION_MATERIALIZE_SIZE - 1) /
+                      REGION_MATERIALIZE_SIZE * REGION_MATERIALIZE_SIZE;
+    if (target > FILESIZE)
+      target = FILESIZE;
+    if (materialized.compare_exchange_weak(cur, target)) {
+      if (posix_fallocate(FD, cur, target - cur) != 0) {
+        perror("posix_fallocate");
+        exit(1);
+      }
+      return;
+    }
+  }
+}
+
+/* Deallocate the file blocks backing [off, off+len): the range reads
+ * back as zeros and the capacity goes back to the filesystem (and out
+ * of snapshots/backups). The mapping itself is untouched -- the next
+ * write fault re-materializes blocks, exactly like the sparse tail of a
+ * lazily grown region -- so this is safe on any range whose contents
+ * are dead. Returns -1 (silently) where the filesystem has no
+ * hole-punch support. */
+int RegionManager::__punch_hole(uint64_t off, uint64_t len) {
+  if (fallocate(FD, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)off,
+                (off_t)len) != 0)
+    return -1;
+  return 0;
+}
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define RALLOC_HAS_URING 1
+#endif
+
+#ifdef RALLOC_HAS_URING
+/* Minimal raw-syscall io_uring reader: streams [0, len) of fd through
+ * $depth$ concurrent buffered reads of $chunk$ bytes, which pulls the
+ * file into the page cache at sequential NVMe bandwidth. Returns false
+ * when the kernel lacks io_uring (or a read fails) so the caller can
+ * fall back to readahead(2). No liburing dependency; the three ring
+ * mmaps below are the whole ABI we need. */
+static bool uring_stream_file(int fd, size_t len, unsigned depth,
+                              size_t chunk) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  int ring = syscall(__NR_io_uring_setup, depth, &p);
+  if (ring < 0)
+    return false;
+  size_t sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  size_t cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  void *sq_ptr = mmap(0, sq_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+  void *cq_ptr = mmap(0, cq_sz, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+  struct io_uring_sqe *sqes = (struct io_uring_sqe *)mmap(
+      0, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+  if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED ||
+      sqes == (struct io_uring_sqe *)MAP_FAILED) {
+    close(ring);
+    return false;
+  }
+  auto *sq_tail = (std::atomic<unsigned> *)((char *)sq_ptr + p.sq_off.tail);
+  unsigned *sq_mask = (unsigned *)((char *)sq_ptr + p.sq_off.ring_mask);
+  unsigned *sq_array = (unsigned *)((char *)sq_ptr + p.sq_off.array);
+  auto *cq_head = (std::atomic<unsigned> *)((char *)cq_ptr + p.cq_off.head);
+  auto *cq_tail = (std::atomic<unsigned> *)((char *)cq_ptr + p.cq_off.tail);
+  unsigned *cq_mask = (unsigned *)((char *)cq_ptr + p.cq_off.ring_mask);
+  auto *cqes = (struct io_uring_cqe *)((char *)cq_ptr + p.cq_off.cqes);
+
+  std::vector<char *> bufs(depth);
+  std::vector<unsigned> free_bufs;
+  for (unsigned i = 0; i < depth; i++) {
+    bufs[i] = (char *)malloc(chunk);
+    free_bufs.push_back(i);
+  }
+  size_t next_off = 0;
+  unsigned inflight = 0;
+  bool ok = true;
+  while (ok && (next_off < len || inflight > 0)) {
+    unsigned submitted = 0;
+    while (next_off < len && !free_bufs.empty()) {
+      unsigned bi = free_bufs.back();
+      free_bufs.pop_back();
+      unsigned tail = sq_tail->load(std::memory_order_relaxed);
+      unsigned idx = tail & *sq_mask;
+      struct io_uring_sqe *sqe = &sqes[idx];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = fd;
+      sqe->addr = (uint64_t)bufs[bi];
+      sqe->len = (len - next_off < chunk) ? (len - next_off) : chunk;
+      sqe->off = next_off;
+      sqe->user_data = bi;
+      sq_array[idx] = idx;
+      sq_tail->store(tail + 1, std::memory_order_release);
+      next_off += chunk;
+      inflight++;
+      submitted++;
+    }
+    int ret = syscall(__NR_io_uring_enter, ring, submitted, inflight ? 1 : 0,
+                      IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (ret < 0) {
+      ok = false;
+      break;
+    }
+    unsigned head = cq_head->load(std::memory_order_acquire);
+    while (head != cq_tail->load(std::memory_order_acquire)) {
+      struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+      if (cqe->res < 0)
+        ok = false; // e.g. IORING_OP_READ unsupported (pre-5.6)
+      free_bufs.push_back((unsigned)cqe->user_data);
+      inflight--;
+      head++;
+    }
+    cq_head->store(head, std::memory_order_release);
+  }
+  for (unsigned i = 0; i < depth; i++)
+    free(bufs[i]);
+  munmap(sq_ptr, sq_sz);
+  munmap(cq_ptr, cq_sz);
+  munmap(sqes, p.sq_entries * sizeof(struct io_uring_sqe));
+  close(ring);
+  return ok;
+}
+#endif
+
+/* Cold-start loading for non-DAX deployments, controlled by
+ * RALLOC_PRELOAD. On ordinary NVMe the pool otherwise page-faults in
+ * 4KB at a time in whatever order recovery touches it, making cold
+ * start I/O-bound and seeky; streaming the file into the page cache
+ * first turns that into one sequential pass at device bandwidth, and
+ * the later faults become minor. Any value enables it ("ra" skips
+ * io_uring and goes straight to readahead(2));
+ * RALLOC_PRELOAD_DEPTH/RALLOC_PRELOAD_CHUNK override the queue depth
+ * and read size. DAX mappings bypass the page cache entirely, so this
+ * is a no-op there. */
+void RegionManager::__preload_pagecache(int fd) {
+  const char *mode = std::getenv("RALLOC_PRELOAD");
+  if (mode == nullptr || dax)
+    return;
+  unsigned depth = 32;
+  size_t chunk = 1ULL << 20;
+  if (const char *d = std::getenv("RALLOC_PRELOAD_DEPTH"))
+    depth = (unsigned)atoi(d) > 0 ? (unsigned)atoi(d) : depth;
+  if (const char *c = std::getenv("RALLOC_PRELOAD_CHUNK"))
+    chunk = atoll(c) > 0 ? (size_t)atoll(c) : chunk;
+#ifdef RALLOC_HAS_URING
+  if (strcmp(mode, "ra") != 0 &&
+      uring_stream_file(fd, FILESIZE, depth, chunk))
+    return;
+#endif
+  for (off_t off = 0; off < (off_t)FILESIZE; off += chunk)
+    readahead(fd, off, chunk);
+}
+
+/* DAX detection happens at map time rather than compile time: a
+ * MAP_SHARED_VALIDATE|MAP_SYNC mapping only succeeds on device-dax or
+ * fsdax backing, where the kernel promises that a store reaching media
+ * via user-space flushes is durable with no msync/fsync on any commit
+ * path. Filesystems without DAX semantics reject the flags
+ * (EOPNOTSUPP), and we fall back to plain MAP_SHARED instead of
+ * aborting, so one binary runs on both real PM mounts and page-cache
+ * backed development machines. */
+void *RegionManager::__map_shared(int fd, int extra_flags) {
+  extra_flags |= __populate_mmap_flag();
+  void *addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE,
+                    MAP_SHARED_VALIDATE | MAP_SYNC | extra_flags, fd, 0);
+  dax = (addr != MAP_FAILED);
+  if (addr == MAP_FAILED) {
+    addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED | extra_flags, fd, 0);
+  }
+  DBG_PRINT("%s: dax mode %s\n", HEAPFILE.c_str(), dax ? "on" : "off");
+  return addr;
+}
+
 // //mmap anynomous
 // void RegionManager::__map_transient_region(){
 // 	char* ret = (char*) mmap((void*) 0, FILESIZE,
@@ -57,24 +347,27 @@ void RegionManager::__map_persistent_region() {
   fd = open(HEAPFILE.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
 
   FD = fd;
-  off_t offt = lseek(fd, FILESIZE - 1, SEEK_SET);
-  assert(offt != -1);
+  if (lazy) {
+    // set the logical size only; blocks materialize with the frontier
+    int res = ftruncate(fd, FILESIZE);
+    assert(res == 0);
+    __materialize_to(PAGESIZE);
+  } else {
+    off_t offt = lseek(fd, FILESIZE - 1, SEEK_SET);
+    assert(offt != -1);
 
-  int result = write(fd, "", 1);
-  assert(result != -1);
+    int result = write(fd, "", 1);
+    assert(result != -1);
+  }
 
-  void *addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE, MMAP_FLAG, fd, 0);
+  void *addr = __map_shared(fd, 0);
   assert(addr != MAP_FAILED);
 
-  if (const char *numa = std::getenv("CXL_NUMA_NODE")) {
-    std::size_t pos{};
-    const int node{std::stoi(numa, &pos)};
-    const unsigned long mask = 1 << node;
-    if (mbind(addr, FILESIZE, MPOL_BIND, &mask, sizeof(mask) * 8, 0) < 0) {
-      perror("mbind");
-      exit(1);
-    }
-  }
+  __advise_huge(addr, FILESIZE);
+
+  __bind_numa(addr, FILESIZE);
+
+  __prefault_bg(addr, FILESIZE);
 
   base_addr = (char *)addr;
   // | curr_addr  |
@@ -107,23 +400,27 @@ void RegionManager::__remap_persistent_region() {
   offt = lseek(fd, 0, SEEK_SET);
   assert(offt == 0);
 
-  void *addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE, MMAP_FLAG, fd, 0);
+  void *addr = __map_shared(fd, 0);
   assert(addr != MAP_FAILED);
 
-  if (const char *numa = std::getenv("CXL_NUMA_NODE")) {
-    std::size_t pos{};
-    const int node{std::stoi(numa, &pos)};
-    const unsigned long mask = 1 << node;
-    if (mbind(addr, FILESIZE, MPOL_BIND, &mask, sizeof(mask) * 8, 0) < 0) {
-      perror("mbind");
-      exit(1);
-    }
-  }
+  // this is the restart path, so the file has real contents; pull them
+  // into the page cache sequentially before recovery faults them in
+  __preload_pagecache(fd);
+
+  __advise_huge(addr, FILESIZE);
+
+  __bind_numa(addr, FILESIZE);
+
+  __prefault_bg(addr, FILESIZE);
 
   base_addr = (char *)addr;
   curr_addr_ptr = (atomic_pptr<char> *)base_addr;
   assert(*(uint64_t *)((size_t)base_addr + 2 * sizeof(atomic_pptr<char>)) ==
          FILESIZE);
+  if (lazy) {
+    // everything up to the recovered frontier is already backed
+    materialized.store((uint64_t)(curr_addr_ptr->load() - base_addr));
+  }
   DBG_PRINT("Addr: %p\n", addr);
   DBG_PRINT("Base_addr: %p\n", base_addr);
   DBG_PRINT("Curr_addr: %p\n", curr_addr_ptr->load());
@@ -135,15 +432,38 @@ void RegionManager::__map_transient_region() {
   fd = open(HEAPFILE.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
 
   FD = fd;
-  off_t offt = lseek(fd, FILESIZE - 1, SEEK_SET);
-  assert(offt != -1);
+  if (lazy) {
+    // set the logical size only; blocks materialize with the frontier
+    int res = ftruncate(fd, FILESIZE);
+    assert(res == 0);
+    __materialize_to(PAGESIZE);
+  } else {
+    off_t offt = lseek(fd, FILESIZE - 1, SEEK_SET);
+    assert(offt != -1);
 
-  int result = write(fd, "", 1);
-  assert(result != -1);
+    int result = write(fd, "", 1);
+    assert(result != -1);
+  }
 
-  void *addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE,
-                    MAP_SHARED | MAP_NORESERVE, fd, 0);
-  assert(addr != MAP_FAILED);
+  int huge = __huge_mmap_flags();
+  void *addr = MAP_FAILED;
+  if (huge != 0) {
+    addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_NORESERVE | huge | __populate_mmap_flag(), fd,
+                0);
+  }
+  if (addr == MAP_FAILED) {
+    // not on hugetlbfs (or no reserved huge pages); map normally and
+    // let THP coalesce
+    addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_NORESERVE | __populate_mmap_flag(), fd, 0);
+    assert(addr != MAP_FAILED);
+    __advise_huge(addr, FILESIZE);
+  }
+
+  __bind_numa(addr, FILESIZE);
+
+  __prefault_bg(addr, FILESIZE);
 
   base_addr = (char *)addr;
   // | curr_addr  |
@@ -176,14 +496,34 @@ void RegionManager::__remap_transient_region() {
   offt = lseek(fd, 0, SEEK_SET);
   assert(offt == 0);
 
-  void *addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE,
-                    MAP_SHARED | MAP_NORESERVE, fd, 0);
-  assert(addr != MAP_FAILED);
+  int huge = __huge_mmap_flags();
+  void *addr = MAP_FAILED;
+  if (huge != 0) {
+    addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_NORESERVE | huge | __populate_mmap_flag(), fd,
+                0);
+  }
+  if (addr == MAP_FAILED) {
+    // not on hugetlbfs (or no reserved huge pages); map normally and
+    // let THP coalesce
+    addr = mmap(0, FILESIZE, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_NORESERVE | __populate_mmap_flag(), fd, 0);
+    assert(addr != MAP_FAILED);
+    __advise_huge(addr, FILESIZE);
+  }
+
+  __bind_numa(addr, FILESIZE);
+
+  __prefault_bg(addr, FILESIZE);
 
   base_addr = (char *)addr;
   curr_addr_ptr = (atomic_pptr<char> *)base_addr;
   assert(*(uint64_t *)((size_t)base_addr + 2 * sizeof(atomic_pptr<char>)) ==
          FILESIZE);
+  if (lazy) {
+    // everything up to the recovered frontier is already backed
+    materialized.store((uint64_t)(curr_addr_ptr->load() - base_addr));
+  }
   DBG_PRINT("Addr: %p\n", addr);
   DBG_PRINT("Base_addr: %p\n", base_addr);
   DBG_PRINT("Curr_addr: %p\n", curr_addr_ptr->load());
@@ -270,6 +610,7 @@ int RegionManager::__nvm_region_allocator(void **memptr, size_t alignment,
   if (curr_addr_ptr->compare_exchange_strong(old_curr_addr, new_curr_addr)) {
     FLUSH(curr_addr_ptr);
     FLUSHFENCE;
+    __materialize_to((uint64_t)(new_curr_addr - base_addr));
     *memptr = res;
     return 1;
   }
@@ -308,6 +649,7 @@ int RegionManager::__try_nvm_region_allocator(void **memptr, size_t alignment,
   if (curr_addr_ptr->compare_exchange_strong(old_curr_addr, new_curr_addr)) {
     FLUSH(curr_addr_ptr);
     FLUSHFENCE;
+    __materialize_to((uint64_t)(new_curr_addr - base_addr));
     *memptr = res;
     return 0;
   } else {
@@ -320,6 +662,42 @@ bool RegionManager::__within_range(void *ptr) {
   return ((intptr_t)base_addr < (intptr_t)ptr) && ((intptr_t)ptr < curr_addr);
 }
 
+int RegionManager::__clone_to(const std::string &dst) {
+  int dfd = open(dst.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (dfd < 0)
+    return -1;
+  if (ioctl(dfd, FICLONE, FD) < 0) {
+    close(dfd);
+    unlink(dst.c_str());
+    return -1; // not a reflink-capable fs; caller falls back to copying
+  }
+  close(dfd);
+  return 0;
+}
+
+void RegionManager::__copy_to(const std::string &dst) {
+  int dfd = open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (dfd < 0)
+    return;
+  // only the carved part of the region holds data; the sparse tail is
+  // recreated by the ftruncate below
+  size_t len = (size_t)(curr_addr_ptr->load() - base_addr);
+  size_t off = 0;
+  while (off < len) {
+    size_t chunk = len - off;
+    if (chunk > REGION_MATERIALIZE_SIZE)
+      chunk = REGION_MATERIALIZE_SIZE;
+    ssize_t w = write(dfd, base_addr + off, chunk);
+    if (w <= 0)
+      break;
+    off += (size_t)w;
+  }
+  int res = ftruncate(dfd, FILESIZE);
+  (void)res;
+  fsync(dfd);
+  close(dfd);
+}
+
 void RegionManager::__destroy() {
   if (!exists_test(HEAPFILE)) {
     std::cout << "File " << HEAPFILE << " doesn't exist!\n";
@@ -35,6 +35,7 @@
 #define _REGION_MANAGER_HPP_
 
 #include <string>
+#include <cstdlib>
 #include <fstream>
 #include <atomic>
 #include <vector>
@@ -62,12 +63,25 @@ public:
     char *base_addr = nullptr;
     atomic_pptr<char>* curr_addr_ptr;//this always points to the place of base_addr
     bool persist;
+    // on-demand growth, enabled by RALLOC_LAZY_GROW: the full FILESIZE
+    // virtual range is still reserved at map time (so pptr offsets and
+    // running structures see no difference), but file blocks are
+    // fallocate'd in REGION_MATERIALIZE_SIZE chunks as the frontier
+    // passes them instead of all up front
+    bool lazy;
+    // high-water mark (offset from base) of file-backed bytes
+    std::atomic<uint64_t> materialized;
+    // true when the region got a MAP_SYNC mapping (device-dax/fsdax
+    // backing); durability then needs no per-commit msync/fsync at all
+    bool dax = false;
 
     RegionManager(const std::string& file_path, uint64_t size, bool p = true, bool imm_expand = true):
         FILESIZE(((size/PAGESIZE)+2)*PAGESIZE), // size should align to page
         HEAPFILE(file_path),
         curr_addr_ptr(nullptr),
-        persist(p){
+        persist(p),
+        lazy(std::getenv("RALLOC_LAZY_GROW") != nullptr),
+        materialized(0){
         assert(size%CACHELINE_SIZE == 0); // size should be multiple of cache line size
         if(persist){
             if(exists_test(HEAPFILE)){
@@ -112,6 +126,42 @@ public:
         return f.good();
     }
 
+    //bind a mapping to the NUMA node named by CXL_NUMA_NODE, if set
+    static void __bind_numa(void* addr, size_t len);
+
+    //extra mmap flags (MAP_HUGETLB | page size) when RALLOC_HUGE_PAGES
+    //requests 2M or 1G backing, 0 otherwise
+    static int __huge_mmap_flags();
+    //advise transparent huge pages for mappings hugetlbfs can't back
+    //(file-backed regions); no-op unless RALLOC_HUGE_PAGES is set
+    static void __advise_huge(void* addr, size_t len);
+
+    //extra mmap flag (MAP_POPULATE) when RALLOC_PREFAULT=map asks for
+    //eager population at map time, 0 otherwise
+    static int __populate_mmap_flag();
+    //detached toucher thread that read-faults the region front to back
+    //when RALLOC_PREFAULT=bg; no-op otherwise
+    static void __prefault_bg(void* addr, size_t len);
+
+    //ensure file blocks exist up to offset $end$ (from base); no-op for
+    //eagerly materialized regions
+    void __materialize_to(uint64_t end);
+
+    //return the file blocks backing [off, off+len) to the filesystem
+    //(FALLOC_FL_PUNCH_HOLE; re-materialized by the next write fault);
+    //returns 0 on success, -1 when the filesystem can't punch holes
+    int __punch_hole(uint64_t off, uint64_t len);
+
+    //stream an existing pool file into the page cache before recovery
+    //touches it (RALLOC_PRELOAD; io_uring batched reads with a
+    //readahead(2) fallback); no-op on DAX mappings
+    void __preload_pagecache(int fd);
+
+    //shared file mapping with DAX detection: tries
+    //MAP_SHARED_VALIDATE|MAP_SYNC first (sets $dax$) and falls back to
+    //plain MAP_SHARED on filesystems without DAX semantics
+    void* __map_shared(int fd, int extra_flags);
+
     //mmap file
     //the only difference between persist and trans version is
     //persist always map to the same addr while trans doesn't
@@ -149,6 +199,15 @@ public:
 
     //destroy the region and delete the file
     void __destroy();
+
+    //reflink-clone the heap file to dst (instant, CoW at the fs level);
+    //returns 0 on success, -1 when the filesystem can't reflink
+    int __clone_to(const std::string& dst);
+
+    //stream the mapped image (up to the frontier) into dst; meant to run
+    //in a fork'd child whose address space is a CoW snapshot, so it only
+    //uses async-signal-safe calls
+    void __copy_to(const std::string& dst);
 };
 
 /*
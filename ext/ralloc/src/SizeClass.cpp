@@ -14,9 +14,14 @@
 #include "pm_config.hpp"
 #include "SizeClass.hpp"
 
-// here we use same size for sbs in different sizeclass for easy management
+// per-class superblock size: hot small classes take SB_SPAN_SIZE spans
+// so they transition between superblocks less often, everything else
+// keeps the single SBSIZE stride (see pm_config.hpp)
+#define SC_SB_SIZE(block_size) \
+	((block_size) <= SB_SPAN_MAX_BLOCK ? SB_SPAN_SIZE : SBSIZE)
 #define SIZE_CLASS_bin_yes(block_size, pages) \
-	{ block_size, SBSIZE, SBSIZE/block_size, SBSIZE/block_size },
+	{ block_size, SC_SB_SIZE(block_size), SC_SB_SIZE(block_size)/block_size, \
+	  SC_SB_SIZE(block_size)/block_size, 0 },
 /* #define SIZE_CLASS_bin_yes(block_size, pages) \
  	{ block_size, pages * PAGESIZE, 0, 0 },
  	*/
@@ -25,21 +30,42 @@
 #define SC(index, lg_grp, lg_delta, ndelta, psz, bin, pgs, lg_delta_lookup) \
 	SIZE_CLASS_bin_##bin(((1U << lg_grp) + (ndelta << lg_delta)), pgs)
 
+// A workload-tuned table generated by test/sizeclass_gen (from an
+// RALLOC_SIZE_PROFILE histogram) replaces the jemalloc-derived classes
+// below; opt in with -DRALLOC_TUNED_CLASSES once src/SizeClassTuned.hpp
+// has been generated.
+#ifdef RALLOC_TUNED_CLASSES
+#define SIZE_CLASS_TUNED(block_size) \
+	{ block_size, SC_SB_SIZE(block_size), SC_SB_SIZE(block_size)/block_size, \
+	  SC_SB_SIZE(block_size)/block_size, 0 },
+#include "SizeClassTuned.hpp"
+#endif
+
 // this is reconstructed in every execution
 SizeClass ralloc::sizeclass;
 
 SizeClass::SizeClass():
 	sizeclasses{
-		{ 0, 0, 0, 0},
+		{ 0, 0, 0, 0, 0},
+#ifdef RALLOC_TUNED_CLASSES
+		SIZE_CLASSES_TUNED
+#else
 		SIZE_CLASSES
+#endif
 	},
 	sizeclass_lookup{0} {
 	// first size class reserved for large allocations
 	size_t lookupIdx = 0;
 	for (size_t sc_idx = 1; sc_idx < MAX_SZ_IDX; ++sc_idx)
 	{
-		SizeClassData const& sc = sizeclasses[sc_idx];
+		SizeClassData& sc = sizeclasses[sc_idx];
 		size_t block_size = sc.block_size;
+		// exact for any in-superblock offset: the rounding error of
+		// the reciprocal is below block_size, so the divide stays
+		// exact for offsets up to 2^32/block_size -- far beyond
+		// SBSIZE, and beyond SB_SPAN_SIZE for the small classes that
+		// use spans
+		sc.block_magic = ((1ULL << 32) + block_size - 1) / block_size;
 		while (lookupIdx <= block_size)
 		{
 			sizeclass_lookup[lookupIdx] = sc_idx;
@@ -39,13 +39,18 @@ struct SizeClassData
 public:
 	// size of block
 	uint32_t block_size;
-	// superblock size
-	// always a multiple of page size
+	// superblock size: SBSIZE, or SB_SPAN_SIZE for hot small classes
+	// (always a multiple of SBSIZE)
 	uint32_t sb_size;
 	// cached number of blocks, equal to sb_size / block_size
 	uint32_t block_num;
 	// number of blocks held by thread-specific caches
 	uint32_t cache_block_num;
+	// round-up reciprocal of block_size (computed in the constructor);
+	// block index = (offset * block_magic) >> 32, exact for any offset
+	// within a superblock, so indexing needs no hardware division and
+	// works for any table, including tuned ones
+	uint64_t block_magic;
 
 public:
 	size_t get_block_num() const { return block_num; }
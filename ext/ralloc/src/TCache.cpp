@@ -13,9 +13,135 @@
 
 #include "TCache.hpp"
 
+#include <algorithm>
+#include <mutex>
+
 using namespace ralloc;
+namespace ralloc { extern bool initialized; }
 thread_local TCaches ralloc::t_caches;
 
+// live TCaches of all threads, so RP_close can drain them in parallel
+// instead of waiting on each thread's destructor
+static std::mutex caches_lk;
+static std::vector<TCaches*> live_caches;
+// bins parked by exited threads, waiting for a new thread to adopt
+static std::vector<TCaches*> parked_caches;
+
+#ifdef RALLOC_CPU_CACHE
+#include <sched.h>
+#include <sys/sysinfo.h>
+#include <atomic>
+
+// One TCaches per possible CPU; the constructors register every slot
+// in live_caches (above), so RP_close's parallel drain covers them
+// unchanged. Defined after the registry so static init runs in order.
+int ralloc::cpu_cache_count = get_nprocs_conf();
+TCaches* ralloc::cpu_caches = new TCaches[ralloc::cpu_cache_count];
+// per-slot owner locks
+static std::atomic<bool>* cpu_cache_lk =
+	new std::atomic<bool>[ralloc::cpu_cache_count]();
+
+// cpu id read. glibc 2.35+ registers an rseq area for every thread;
+// its cpu_id field (offset 4) is kernel-maintained, so reading it is
+// one thread-pointer-relative load. Older glibc (or an unregistered
+// area) falls back to the sched_getcpu vDSO call. A full restartable
+// push/pop sequence would need asm restart blocks; the owner lock
+// below keeps the slot correct at a fraction of the complexity.
+#if defined(__x86_64__) && defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+extern "C" { extern const ptrdiff_t __rseq_offset; extern const unsigned int __rseq_size; }
+static inline int current_cpu()
+{
+	if (__rseq_size != 0) {
+		unsigned int id = *(volatile unsigned int*)(
+			(char*)__builtin_thread_pointer() + __rseq_offset + 4);
+		if ((int)id >= 0)
+			return (int)id;
+	}
+	return sched_getcpu();
+}
+#else
+static inline int current_cpu() { return sched_getcpu(); }
+#endif
+
+int ralloc::cpu_cache_pin()
+{
+	int cpu = current_cpu();
+	if (cpu < 0 || cpu >= cpu_cache_count)
+		cpu = 0;
+	while (cpu_cache_lk[cpu].exchange(true, std::memory_order_acquire)) {
+		do {
+#ifdef __x86_64__
+			__builtin_ia32_pause();
+#endif
+		} while (cpu_cache_lk[cpu].load(std::memory_order_relaxed));
+	}
+	return cpu;
+}
+
+void ralloc::cpu_cache_unpin(int cpu)
+{
+	cpu_cache_lk[cpu].store(false, std::memory_order_release);
+}
+#endif // RALLOC_CPU_CACHE
+
+std::vector<TCaches*> ralloc::all_caches()
+{
+	std::lock_guard<std::mutex> lk(caches_lk);
+	return live_caches;
+}
+
+// registry-silent shell: holds parked bins, touches no list itself
+TCaches::TCaches(int):t_cache() {}
+
+TCaches::TCaches():t_cache()
+{
+	TCaches* adopted = nullptr;
+	{
+		std::lock_guard<std::mutex> lk(caches_lk);
+		live_caches.push_back(this);
+		if (!parked_caches.empty()) {
+			adopted = parked_caches.back();
+			parked_caches.pop_back();
+			for (size_t i = 0; i < MAX_SZ_IDX; i++) {
+				t_cache[i] = adopted->t_cache[i];
+				adopted->t_cache[i] = TCacheBin();
+			}
+			live_caches.erase(
+				std::find(live_caches.begin(), live_caches.end(), adopted));
+		}
+	}
+	// outside the lock: the shell is empty now, so its destructor
+	// neither re-parks nor finds itself in the registry
+	delete adopted;
+}
+
+TCaches::~TCaches()
+{
+	// ralloc::public_flush_cache();
+	uint32_t total = 0;
+	for (size_t i = 0; i < MAX_SZ_IDX; i++)
+		total += t_cache[i].get_block_num();
+
+	std::lock_guard<std::mutex> lk(caches_lk);
+	auto it = std::find(live_caches.begin(), live_caches.end(), this);
+	if (it != live_caches.end())
+		live_caches.erase(it);
+
+	// Park populated bins for the next thread instead of dropping
+	// them; the shell stays in the live list so RP_close's parallel
+	// drain flushes parked blocks like any thread's.
+	if (ralloc::initialized && total > 0 &&
+	    parked_caches.size() < (size_t)TCACHE_PARK_SLOTS) {
+		TCaches* shell = new TCaches(0);
+		for (size_t i = 0; i < MAX_SZ_IDX; i++) {
+			shell->t_cache[i] = t_cache[i];
+			t_cache[i] = TCacheBin();
+		}
+		live_caches.push_back(shell);
+		parked_caches.push_back(shell);
+	}
+}
+
 void TCacheBin::push_block(char* block)
 {
 	// block has at least sizeof(char*)
@@ -37,10 +163,22 @@ void TCacheBin::push_list(char* block, uint32_t length)
 char* TCacheBin::pop_block()
 {
 	// caller must ensure there's an available block
-	assert(_block_num > 0);
+	assert(_block_num + _run_num > 0);
+
+	// drain the run first: freshly carved blocks are handed out with a
+	// pointer bump, no PM load at all
+	if (_run_num > 0) {
+		char* ret = _run_base;
+		_run_base += _run_bs;
+		_run_num--;
+		return ret;
+	}
 
 	char* ret = _block;
 	char* next = (char*)(*(pptr<char>*)ret);
+	// warm the next hop's line so the following pop doesn't stall on PM
+	if (next != nullptr)
+		PREFETCH(next);
 	_block = next;
 	_block_num--;
 	return ret;
@@ -53,3 +191,58 @@ void TCacheBin::pop_list(char* block, uint32_t length)
 	_block = block;
 	_block_num -= length;
 }
+
+void TCacheBin::push_run(char* base, uint32_t length, uint32_t block_size)
+{
+	// caller must ensure the run is empty (only fill paths push runs,
+	// and fills happen on an empty bin)
+	assert(_run_num == 0);
+
+	_run_base = base;
+	_run_num = length;
+	_run_bs = block_size;
+}
+
+void TCacheBin::pop_run(uint32_t length)
+{
+	assert(_run_num >= length);
+
+	_run_base += (uint64_t)length * _run_bs;
+	_run_num -= length;
+}
+
+void TCacheBin::materialize_run()
+{
+	// Converts the run into the legacy linked-list shape for paths
+	// that walk the bin through the blocks' pptr words. The flush path
+	// relinks every returned block into its superblock free list
+	// anyway, so these are the same stores it would issue there --
+	// sequential, with no dependent loads.
+	if (_run_num == 0)
+		return;
+	for (uint32_t i = 0; i + 1 < _run_num; i++)
+		*(pptr<char>*)(_run_base + (uint64_t)i * _run_bs) =
+			_run_base + (uint64_t)(i + 1) * _run_bs;
+	*(pptr<char>*)(_run_base + (uint64_t)(_run_num - 1) * _run_bs) = _block;
+	_block = _run_base;
+	_block_num += _run_num;
+	_run_num = 0;
+}
+
+void TCacheBin::record_miss(uint32_t dflt)
+{
+	if (++_miss_streak >= TCACHE_GROW_MISS) {
+		_miss_streak = 0;
+		uint32_t cap = capacity(dflt) * 2;
+		uint32_t max = dflt * TCACHE_GROWTH_CAP;
+		_capacity = cap > max ? max : cap;
+	}
+}
+
+void TCacheBin::record_flush(uint32_t dflt)
+{
+	// the thread is freeing more than it allocates; shrink back
+	_miss_streak = 0;
+	uint32_t cap = capacity(dflt) / 2;
+	_capacity = cap < dflt ? dflt : cap;
+}
@@ -14,6 +14,8 @@
 #ifndef __TCACHE_H_
 #define __TCACHE_H_
 
+#include <vector>
+
 #include "pm_config.hpp"
 #include "pfence_util.h"
 #include "SizeClass.hpp"
@@ -38,11 +40,32 @@
 
 struct TCaches;
 
+// consecutive refill misses before a bin doubles its capacity
+const int TCACHE_GROW_MISS = 4;
+// max capacity as a multiple of the sizeclass default
+const int TCACHE_GROWTH_CAP = 8;
+// parked caches kept for adoption by later threads
+const int TCACHE_PARK_SLOTS = 64;
+
 struct TCacheBin
 {
 private:
 	char* _block;//absolute address of block
 	uint32_t _block_num;
+	// Arithmetic run: a freshly carved superblock enters the bin as
+	// (base, count, block_size) instead of a pre-linked list, so pops
+	// are a pointer bump with no PM load and the carve path skips
+	// writing maxcount link words. Blocks returned by free() and
+	// blocks reserved from partial superblocks keep the legacy
+	// pptr-linked list; pops drain the run first.
+	char* _run_base;
+	uint32_t _run_num;
+	uint32_t _run_bs;
+	// adaptive flush threshold; 0 means "sizeclass default".
+	// Grows on consecutive refill misses (burst allocation), decays
+	// back toward the default whenever a flush is triggered.
+	uint32_t _capacity;
+	uint32_t _miss_streak;
 
 public:
 	// common, fast ops
@@ -56,26 +79,91 @@ public:
 	void pop_list(char* block, uint32_t length);
 	char* peek_block() const { return _block; }
 
-	uint32_t get_block_num() const { return _block_num; }
-	TCacheBin() noexcept:_block(nullptr), _block_num(0) {};
+	// push a contiguous run of blocks; run *must* be empty
+	void push_run(char* base, uint32_t length, uint32_t block_size);
+	char* run_base() const { return _run_base; }
+	uint32_t run_num() const { return _run_num; }
+	// manually handed out the first `length` run blocks
+	void pop_run(uint32_t length);
+	// link the run into the legacy list shape, for paths that walk
+	// the bin through the blocks' pptr words (flush)
+	void materialize_run();
+
+	uint32_t get_block_num() const { return _block_num + _run_num; }
+	// current flush threshold of a bin whose sizeclass default is dflt
+	uint32_t capacity(uint32_t dflt) const { return _capacity ? _capacity : dflt; }
+	// called when a malloc finds the bin empty
+	void record_miss(uint32_t dflt);
+	// called when a flush is triggered
+	void record_flush(uint32_t dflt);
+	TCacheBin() noexcept:_block(nullptr), _block_num(0),
+		_run_base(nullptr), _run_num(0), _run_bs(0),
+		_capacity(0), _miss_streak(0) {};
 	// slow operations like fill/flush handled in cache user
 };
 
 namespace ralloc{
 	extern void public_flush_cache();
+	// snapshot of every live thread's TCaches, for the parallel
+	// shutdown drain in RP_close
+	std::vector<TCaches*> all_caches();
 }
 struct TCaches
 {
 	TCacheBin t_cache[MAX_SZ_IDX];
-	TCaches():t_cache(){};
-	~TCaches(){
-		// ralloc::public_flush_cache();
-	}
+	// out of line: registers/deregisters this in the live-cache list.
+	// Construction first adopts a parked cache when one is available --
+	// populated bins an exited thread left behind -- and destruction
+	// parks populated bins (up to TCACHE_PARK_SLOTS) instead of
+	// dropping them, so a pool of short-lived threads inherits warm
+	// bins rather than paying cache construction and refill each time.
+	TCaches();
+	~TCaches();
+private:
+	// registry-silent shell holding parked bins between thread
+	// lifetimes; shells sit in the live-cache list so the shutdown
+	// drain still sees their blocks
+	explicit TCaches(int);
 };
 
 /* thread-local cache */
 namespace ralloc{
 	extern thread_local TCaches t_caches;
 }
+
+/*
+ * Per-CPU cache mode (-DRALLOC_CPU_CACHE): bins are keyed by the CPU a
+ * thread runs on instead of by thread, bounding the cache count (and
+ * the PM stranded in idle bins) by the core count rather than the
+ * thread count. Each slot is serialized by an owner spinlock; the cpu
+ * id read uses the rseq area glibc registers when available, so the
+ * uncontended pin is a thread-pointer-relative load plus one exchange.
+ * Migration between the id read and the acquire only costs locality,
+ * never correctness -- whoever holds a slot serializes it.
+ *
+ * Call sites go through cache_guard_t, an empty shell the compiler
+ * erases in the default TLS build.
+ */
+#ifdef RALLOC_CPU_CACHE
+namespace ralloc{
+	extern TCaches* cpu_caches;
+	extern int cpu_cache_count;
+	// locks the current CPU's slot and returns its index
+	int cpu_cache_pin();
+	void cpu_cache_unpin(int cpu);
+}
+struct cache_guard_t
+{
+	int cpu;
+	cache_guard_t() { cpu = ralloc::cpu_cache_pin(); }
+	~cache_guard_t() { ralloc::cpu_cache_unpin(cpu); }
+	TCaches& caches() const { return ralloc::cpu_caches[cpu]; }
+};
+#else
+struct cache_guard_t
+{
+	TCaches& caches() const { return ralloc::t_caches; }
+};
+#endif
 #endif // __TCACHE_H_
 
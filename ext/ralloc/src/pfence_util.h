@@ -55,7 +55,67 @@
 //     #define FLUSHFENCE
 // #endif
 
+/*
+ * Runtime write-back dispatch (PWB_IS_RUNTIME):
+ * instead of fixing the flush instruction at compile time, resolve it
+ * once per process from CPUID (clwb > clflushopt > clflush) so one
+ * binary runs optimally across a mixed fleet. PWB_NAME() reports the
+ * chosen path for logging.
+ */
+#include <cpuid.h>
+
+#define PWB_CPUID_CLFLUSHOPT (1u << 23)
+#define PWB_CPUID_CLWB (1u << 24)
+
+static inline void pwb_clflush(void *addr) {
+  __asm__ volatile("clflush %0" : "+m"(*(volatile char *)addr));
+}
+static inline void pwb_clflushopt(void *addr) {
+  __asm__ volatile("clflushopt %0" : "+m"(*(volatile char *)addr));
+}
+static inline void pwb_clwb(void *addr) {
+  __asm__ volatile("clwb %0" : "+m"(*(volatile char *)addr));
+}
+
+typedef void (*pwb_func_t)(void *);
+
+static inline pwb_func_t pwb_resolve(void) {
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    if (ebx & PWB_CPUID_CLWB)
+      return pwb_clwb;
+    if (ebx & PWB_CPUID_CLFLUSHOPT)
+      return pwb_clflushopt;
+  }
+  return pwb_clflush;
+}
+
+static pwb_func_t pwb_dispatch __attribute__((unused)) = 0;
+
+static inline void PWB(void *addr) {
+  if (pwb_dispatch == 0)
+    pwb_dispatch = pwb_resolve();
+  pwb_dispatch(addr);
+}
+
+static inline const char *PWB_NAME(void) {
+  pwb_func_t f = pwb_resolve();
+  if (f == pwb_clwb)
+    return "clwb";
+  if (f == pwb_clflushopt)
+    return "clflushopt";
+  return "clflush";
+}
+
+#ifdef PWB_IS_RUNTIME
+#define FLUSH(addr) PWB((void *)(addr))
+/* lets callers skip flush bookkeeping (sorting, dedup) that would be
+ * pure overhead when FLUSH compiles away */
+#define PWB_ACTIVE 1
+#else
 #define FLUSH(addr)
+#define PWB_ACTIVE 0
+#endif
 #define FLUSHFENCE asm volatile("sfence" ::: "memory")
 
 /*
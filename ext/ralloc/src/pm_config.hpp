@@ -34,6 +34,10 @@ enum RegionIndex : int {
 #define LIKELY(x) __builtin_expect((x), 1)
 #define UNLIKELY(x) __builtin_expect((x), 0)
 
+// software prefetch for pptr-linked free-list walks; a cold dependent
+// load from PM costs hundreds of ns, so walks issue the next hop early
+#define PREFETCH(addr) __builtin_prefetch((const void*)(addr))
+
 // returns smallest value >= value with alignment align
 #define ALIGN_VAL(val, align) \
     ( __typeof__ (val))(((uint64_t)(val) + (align - 1)) & ((~(align)) + 1))
@@ -53,13 +57,14 @@ enum RegionIndex : int {
   #define DBG_PRINT(msg, ...)
 #endif
 
-/* SHM_SIMULATING switches to compatible mode for machines without real persistent memory. */
+/* SHM_SIMULATING switches to compatible mode for machines without real
+ * persistent memory. Mapping flags are no longer fixed here: the region
+ * manager probes MAP_SHARED_VALIDATE|MAP_SYNC at map time and falls
+ * back to MAP_SHARED off DAX backing (see RegionManager::__map_shared). */
 #ifdef SHM_SIMULATING
   #define HEAPFILE_PREFIX ""
-  #define MMAP_FLAG MAP_SHARED
 #else
   #define HEAPFILE_PREFIX ""
-  #define MMAP_FLAG 0x80003/*MAP_SHARED_VALIDATE | MAP_SYNC*/
 #endif
 // #define DEBUG 1
 
@@ -67,7 +72,21 @@ enum RegionIndex : int {
 const uint64_t MAX_DESC_AMOUNT_BITS = 24;
 const uint64_t MIN_SB_REGION_SIZE = 1*1024*1024*1024ULL; // min sb region size
 const uint64_t SB_REGION_EXPAND_SIZE = MIN_SB_REGION_SIZE;
+// chunk in which lazily grown regions (RALLOC_LAZY_GROW) materialize
+// their file backing as the frontier advances
+const uint64_t REGION_MATERIALIZE_SIZE = 64*1024*1024ULL;
 const int MAX_ROOTS = 1024;
+/*
+ * Number of per-sizeclass partial-list shards. Threads are assigned to
+ * shards round-robin; a refill pops from the local shard first and only
+ * steals from the other shards when it runs dry, so the CAS loops on the
+ * partial lists stop contending across sockets. 1 falls back to the
+ * original single shared list.
+ */
+#ifndef RALLOC_PARTIAL_SHARDS
+#define RALLOC_PARTIAL_SHARDS 4
+#endif
+const int PARTIAL_SHARDS = RALLOC_PARTIAL_SHARDS;
 
 /* System Macros */
 const int TYPE_SIZE = 4;
@@ -92,6 +111,22 @@ const uint64_t DESCSIZE = CACHELINE_SIZE;
 const int SB_SHIFT = 16; // assume size of a superblock is 64K
 const int DESC_SHIFT = 6; // assume size of a descriptor is 64B
 
+/*
+ * Per-sizeclass superblock sizing. Hot small classes churn through
+ * 64K superblocks (and their carve/retire metadata transitions) very
+ * quickly, so classes with block_size <= SB_SPAN_MAX_BLOCK get
+ * superblocks of SB_SPAN_STRIDES contiguous SBSIZE strides instead.
+ * The SBSIZE descriptor stride is unchanged: the span head's
+ * descriptor is the authoritative one and the interior strides carry
+ * mirror descriptors whose superblock field points back at the head,
+ * the same head/interior shape large allocations already use. Free
+ * spans live on their own list (BaseMeta::avail_sb_span), since the
+ * two granularities cannot share one.
+ */
+const uint64_t SB_SPAN_STRIDES = 4;
+const uint64_t SB_SPAN_SIZE = SB_SPAN_STRIDES * SBSIZE; // 256K
+const uint32_t SB_SPAN_MAX_BLOCK = 256;
+
 
 /* Consts Determined by Customizable Values */
 const uint64_t MAX_DESC_AMOUNT = 1ULL<<MAX_DESC_AMOUNT_BITS; // maximum of superblocks in region
@@ -10,9 +10,33 @@
 #include <vector>
 #include <iostream>
 #include <cstddef>
+#include <cassert>
 #include <atomic>
 #include "pm_config.hpp"
 
+/*
+ * PPTR_FIXED_BASE selects an untagged encoding for builds that always
+ * map every region at a fixed address: off is the raw byte delta from
+ * the pptr instance to its target, nullptr included (null encodes to
+ * -(uint64_t)this, so decoding is one unconditional add that lands on
+ * 0). Dereference drops the pattern shift, mask check and sign branch
+ * of the default encoding. The cost: is_valid() degenerates to "not
+ * null", so conservative GC root filters that rely on the pattern tag
+ * must stay on the default encoding.
+ */
+#ifdef PPTR_FIXED_BASE
+inline bool is_null_pptr(uint64_t off) {
+    // null has no instance-free encoding here; it decodes to nullptr
+    // naturally through from_pptr_off
+    (void)off;
+    return false;
+}
+
+inline bool is_valid_pptr(uint64_t off) {
+    (void)off;
+    return true;
+}
+#else
 inline bool is_null_pptr(uint64_t off) {
     return off == PPTR_PATTERN_POS;
 }
@@ -20,6 +44,7 @@ inline bool is_null_pptr(uint64_t off) {
 inline bool is_valid_pptr(uint64_t off) {
     return (off & PPTR_PATTERN_MASK) == PPTR_PATTERN_POS;
 }
+#endif
 /*
  * class pptr<T>
  * 
@@ -61,12 +86,45 @@ class pptr;
 template<class T>
 class atomic_pptr;
 
+/*
+ * class atomic_tagged_pptr<T>
+ *
+ * Description:
+ * Double-width (16-byte) variant of atomic_pptr<T> that pairs the
+ * self-relative offset with a monotonic 64-bit tag, compare-exchanged
+ * together. Lock-free clients that would otherwise fold an ABA counter
+ * into stolen pointer bits get the same protection with no masking on
+ * the hot path: every successful update bumps the tag, so a stale
+ * expected value can never match a recycled pointer, and load() hands
+ * back a plain T*.
+ *
+ * Build with -mcx16 so the 16-byte compare_exchange lowers to
+ * cmpxchg16b; without it libstdc++ falls back to a libatomic lock
+ * (correct, just slower). The tag is transient like the rest of the
+ * word -- monotonicity only matters within a run, so whatever a crash
+ * leaves behind is a fine starting point.
+ */
+template<class T>
+class atomic_tagged_pptr;
+
 /* 
  * functions to_pptr_off<T> and from_pptr_off<T>
  * 
  * Description:
  * These are functions for conversions between pptr<T>::off and T* 
  */
+#ifdef PPTR_FIXED_BASE
+template<class T>
+inline uint64_t to_pptr_off(const T* v, const pptr<T>* p) {
+    // raw delta; v == nullptr encodes to -(uint64_t)p and decodes to 0
+    return ((uint64_t)v) - ((uint64_t)p);
+}
+
+template<class T>
+inline T* from_pptr_off(uint64_t off, const pptr<T>* p) {
+    return (T*)(((uint64_t)p) + off); // a single add, nothing else
+}
+#else
 template<class T>
 inline uint64_t to_pptr_off(const T* v, const pptr<T>* p) {
     uint64_t off;
@@ -88,7 +146,7 @@ inline uint64_t to_pptr_off(const T* v, const pptr<T>* p) {
 
 template<class T>
 inline T* from_pptr_off(uint64_t off, const pptr<T>* p) {
-    if(!is_valid_pptr(off) || is_null_pptr(off)) { 
+    if(!is_valid_pptr(off) || is_null_pptr(off)) {
         return nullptr;
     } else {
         if(off & 1) { // sign bit is true (negative)
@@ -98,6 +156,7 @@ inline T* from_pptr_off(uint64_t off, const pptr<T>* p) {
         }
     }
 }
+#endif
 
 template<class T>
 inline uint64_t to_pptr_off(const T* v, const atomic_pptr<T>* p) {
@@ -109,6 +168,16 @@ inline T* from_pptr_off(uint64_t off, const atomic_pptr<T>* p) {
     return from_pptr_off(off, reinterpret_cast<const pptr<T>*>(p));
 }
 
+template<class T>
+inline uint64_t to_pptr_off(const T* v, const atomic_tagged_pptr<T>* p) {
+    return to_pptr_off(v, reinterpret_cast<const pptr<T>*>(p));
+}
+
+template<class T>
+inline T* from_pptr_off(uint64_t off, const atomic_tagged_pptr<T>* p) {
+    return from_pptr_off(off, reinterpret_cast<const pptr<T>*>(p));
+}
+
 template<class T>
 class pptr{
 public:
@@ -144,6 +213,15 @@ public:
     inline T& operator [] (size_t idx) const { // subscript
             return static_cast<T*>(*this)[idx];
     }
+#ifdef PPTR_FIXED_BASE
+    bool is_null() const {
+        return from_pptr_off(off, this) == nullptr;
+    }
+
+    bool is_valid() const {
+        return !is_null(); // no pattern tag in the fixed-base encoding
+    }
+#else
     bool is_null() const {
         return off == PPTR_PATTERN_POS;
     }
@@ -151,6 +229,7 @@ public:
     bool is_valid() const {
         return (off & PPTR_PATTERN_MASK) == PPTR_PATTERN_POS;
     }
+#endif
 };
 
 template <class T>
@@ -236,4 +315,235 @@ public:
         return ret;
     }
 };
+
+template <class T>
+class alignas(16) atomic_tagged_pptr{
+public:
+    // compare_exchange on std::atomic compares bytes, so no operator==
+    // is needed; both halves must match for the CAS to succeed
+    struct tagged_off{
+        uint64_t off;
+        uint64_t tag;
+    };
+    std::atomic<tagged_off> word;
+    atomic_tagged_pptr(T* v=nullptr) noexcept { //default constructor
+        word.store({to_pptr_off(v, this), 0});
+    }
+    T* load(std::memory_order order = std::memory_order_seq_cst) const noexcept{
+        return from_pptr_off(word.load(order).off, this);
+    }
+    // load that also reports the tag, for CAS loops
+    T* load(uint64_t& tag,
+        std::memory_order order = std::memory_order_seq_cst) const noexcept{
+        tagged_off cur = word.load(order);
+        tag = cur.tag;
+        return from_pptr_off(cur.off, this);
+    }
+    void store(T* desired,
+        std::memory_order order = std::memory_order_seq_cst ) noexcept{
+        // plain stores bump the tag too, so a CAS whose expected value
+        // was read before this store can't succeed after it
+        tagged_off old = word.load(std::memory_order_relaxed);
+        tagged_off next;
+        do {
+            next = {to_pptr_off(desired, this), old.tag + 1};
+        } while(!word.compare_exchange_weak(old, next, order));
+    }
+    // fetch-style helper: atomically install desired and return the
+    // previous pointer
+    T* exchange(T* desired,
+        std::memory_order order = std::memory_order_seq_cst ) noexcept{
+        tagged_off old = word.load(std::memory_order_relaxed);
+        tagged_off next;
+        do {
+            next = {to_pptr_off(desired, this), old.tag + 1};
+        } while(!word.compare_exchange_weak(old, next, order));
+        if(is_null_pptr(old.off)){
+            return nullptr;
+        }
+        return from_pptr_off(old.off, this);
+    }
+    bool compare_exchange_weak(T*& expected, uint64_t& expected_tag,
+        T* desired,
+        std::memory_order order = std::memory_order_seq_cst ) noexcept{
+        tagged_off old = {to_pptr_off(expected, this), expected_tag};
+        tagged_off next = {to_pptr_off(desired, this), expected_tag + 1};
+        bool ret = word.compare_exchange_weak(old, next, order);
+        if(!ret) {
+            if(is_null_pptr(old.off)){
+                expected = nullptr;
+            } else{
+                expected = from_pptr_off(old.off, this);
+            }
+            expected_tag = old.tag;
+        }
+        return ret;
+    }
+    bool compare_exchange_strong(T*& expected, uint64_t& expected_tag,
+        T* desired,
+        std::memory_order order = std::memory_order_seq_cst ) noexcept{
+        tagged_off old = {to_pptr_off(expected, this), expected_tag};
+        tagged_off next = {to_pptr_off(desired, this), expected_tag + 1};
+        bool ret = word.compare_exchange_strong(old, next, order);
+        if(!ret) {
+            if(is_null_pptr(old.off)){
+                expected = nullptr;
+            } else{
+                expected = from_pptr_off(old.off, this);
+            }
+            expected_tag = old.tag;
+        }
+        return ret;
+    }
+};
+
+/*
+ * class rptr<T> / atomic_rptr<T>
+ *
+ * Description:
+ *  The region-indirection-vector (RIV) variant the TODO above asks for:
+ *  cross-region position-independent pointers.
+ *
+ *  A self-relative pptr can only reference its own region. An rptr<T>
+ *  instead names its target as (region id, offset) and indirects through
+ *  a process-wide vector of region bases, so one process can open
+ *  several pools and point across them — e.g. hot metadata in a
+ *  DRAM-backed pool referencing cold data on PM. Each pool registers
+ *  its base under a caller-chosen id that must be stable across
+ *  restarts; id 0 is reserved for the ralloc superblock region and
+ *  registered by RP_init.
+ *
+ *  Both fields pack into one word ([63:56] id, [55:0] offset), so
+ *  atomic_rptr supports single-word CAS like atomic_pptr. Unlike pptr,
+ *  the encoding is not position-dependent: rptr values can be memcpy'd
+ *  freely between regions.
+ */
+const int RIV_MAX_REGIONS = 256;
+const int RIV_ID_SHIFT = 56;
+const uint64_t RIV_OFF_MASK = (1ULL << RIV_ID_SHIFT) - 1;
+const uint64_t RIV_NULL = UINT64_MAX;
+
+class RegionIndirection {
+public:
+    // transient by design; every restart re-registers its pools
+    static char* bases[RIV_MAX_REGIONS];
+    static void reg(int rid, char* base) {
+        assert(rid >= 0 && rid < RIV_MAX_REGIONS);
+        bases[rid] = base;
+    }
+    static void unreg(int rid) {
+        assert(rid >= 0 && rid < RIV_MAX_REGIONS);
+        bases[rid] = nullptr;
+    }
+};
+
+template<class T>
+inline uint64_t to_rptr_val(const T* v, int rid) {
+    if(v == nullptr) {
+        return RIV_NULL;
+    }
+    assert(RegionIndirection::bases[rid] != nullptr);
+    uint64_t off = ((uint64_t)v) - ((uint64_t)RegionIndirection::bases[rid]);
+    assert(off <= RIV_OFF_MASK);
+    return (((uint64_t)rid) << RIV_ID_SHIFT) | off;
+}
+
+template<class T>
+inline T* from_rptr_val(uint64_t val) {
+    if(val == RIV_NULL) {
+        return nullptr;
+    }
+    return (T*)(RegionIndirection::bases[val >> RIV_ID_SHIFT] +
+                (val & RIV_OFF_MASK));
+}
+
+template<class T>
+class rptr{
+public:
+    uint64_t val;
+    rptr() noexcept : val(RIV_NULL) {};
+    rptr(std::nullptr_t) noexcept : val(RIV_NULL) {};
+    rptr(T* v, int rid) noexcept : val(to_rptr_val(v, rid)) {};
+
+    template<class F>
+    inline operator F*() const{ //cast to transient pointer
+        return from_rptr_val<T>(val);
+    }
+    inline T& operator * () { //dereference
+        return *from_rptr_val<T>(val);
+    }
+    inline T* operator -> (){ //arrow
+        return from_rptr_val<T>(val);
+    }
+    inline rptr& operator = (std::nullptr_t){ //assignment
+        val = RIV_NULL;
+        return *this;
+    }
+    inline void set(T* v, int rid) {
+        val = to_rptr_val(v, rid);
+    }
+    inline T& operator [] (size_t idx) const { // subscript
+        return from_rptr_val<T>(val)[idx];
+    }
+    int region_id() const {
+        return is_null() ? -1 : (int)(val >> RIV_ID_SHIFT);
+    }
+    bool is_null() const {
+        return val == RIV_NULL;
+    }
+};
+
+template <class T>
+inline bool operator==(const rptr<T>& lhs, const std::nullptr_t& rhs){
+    return lhs.is_null();
+}
+
+template <class T>
+inline bool operator==(const rptr<T>& lhs, const rptr<T>& rhs){
+    return lhs.val == rhs.val;
+}
+
+template <class T>
+inline bool operator!=(const rptr<T>& lhs, const std::nullptr_t& rhs){
+    return !lhs.is_null();
+}
+
+template <class T>
+inline bool operator!=(const rptr<T>& lhs, const rptr<T>& rhs){
+    return lhs.val != rhs.val;
+}
+
+template <class T>
+class atomic_rptr{
+public:
+    std::atomic<uint64_t> val;
+    atomic_rptr() noexcept { val.store(RIV_NULL); }
+    atomic_rptr(T* v, int rid) noexcept { val.store(to_rptr_val(v, rid)); }
+    T* load(std::memory_order order = std::memory_order_seq_cst) const noexcept{
+        return from_rptr_val<T>(val.load(order));
+    }
+    rptr<T> load_rptr(std::memory_order order = std::memory_order_seq_cst) const noexcept{
+        rptr<T> ret;
+        ret.val = val.load(order);
+        return ret;
+    }
+    void store(T* desired, int rid,
+        std::memory_order order = std::memory_order_seq_cst ) noexcept{
+        val.store(to_rptr_val(desired, rid), order);
+    }
+    void store(rptr<T> desired,
+        std::memory_order order = std::memory_order_seq_cst ) noexcept{
+        val.store(desired.val, order);
+    }
+    // expected/desired are taken as rptr values since a raw T* alone
+    // can't name its region
+    bool compare_exchange_weak(rptr<T>& expected, rptr<T> desired,
+        std::memory_order order = std::memory_order_seq_cst ) noexcept{
+        return val.compare_exchange_weak(expected.val, desired.val, order);
+    }
+    bool compare_exchange_strong(rptr<T>& expected, rptr<T> desired,
+        std::memory_order order = std::memory_order_seq_cst ) noexcept{
+        return val.compare_exchange_strong(expected.val, desired.val, order);
+    }
+};
 #endif
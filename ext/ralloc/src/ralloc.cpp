@@ -6,11 +6,17 @@
 
 #include "ralloc.hpp"
 
+#include <immintrin.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstring>
 #include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "BaseMeta.hpp"
@@ -63,16 +69,269 @@ int _RP_init(const char *_id, uint64_t size) {
       break;
     } // switch
   }
+  // region id 0 of the indirection vector is the ralloc heap, so rptrs
+  // can reference ralloc blocks from other pools
+  RegionIndirection::reg(0, _rgs->lookup(SB_IDX));
+  // DRAM shadow of the descriptor metadata, one word per superblock;
+  // stays cold until the carve paths (or RP_recover) populate it
+  base_md->shadow_init(num_sb);
   initialized = true;
   return (int)restart;
 }
 
+/*
+ * Background zeroing pool for RP_calloc, enabled by setting
+ * RALLOC_ZERO_POOL to the number of blocks kept zeroed per sizeclass.
+ * A worker thread refills per-sizeclass stacks of pre-zeroed,
+ * pre-flushed blocks; RP_calloc pops from them and falls back to
+ * inline zeroing only when the pool is dry. PM streaming writes make
+ * inline zeroing several times slower than this amortized path.
+ */
+namespace {
+struct ZeroPool {
+  mutex lks[MAX_SZ_IDX];
+  vector<void *> blocks[MAX_SZ_IDX];
+  atomic<bool> stop{false};
+  thread worker;
+  size_t target = 0; // blocks kept per sizeclass; 0 disables the pool
+
+  void refill_loop() {
+    while (!stop.load()) {
+      for (int i = 1; i < MAX_SZ_IDX && !stop.load(); i++) {
+        SizeClassData *sc = sizeclass.get_sizeclass_by_idx_noinline(i);
+        while (true) {
+          {
+            lock_guard<mutex> lk(lks[i]);
+            if (blocks[i].size() >= target)
+              break;
+          }
+          char *ptr = (char *)base_md->do_malloc(sc->block_size);
+          if (ptr == nullptr)
+            break;
+          memset(ptr, 0, sc->block_size);
+          for (size_t off = 0; off < sc->block_size; off += CACHELINE_SIZE) {
+            FLUSH(ptr + off);
+          }
+          FLUSHFENCE;
+          lock_guard<mutex> lk(lks[i]);
+          blocks[i].push_back(ptr);
+        }
+      }
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
+  }
+
+  void start(size_t t) {
+    target = t;
+    stop.store(false);
+    worker = thread(&ZeroPool::refill_loop, this);
+  }
+
+  void shutdown() {
+    if (target == 0)
+      return;
+    stop.store(true);
+    worker.join();
+    // hand pooled blocks back before the heap is written back
+    for (int i = 1; i < MAX_SZ_IDX; i++) {
+      for (void *ptr : blocks[i]) {
+        base_md->do_free(ptr);
+      }
+      blocks[i].clear();
+    }
+    target = 0;
+  }
+
+  // pop a pre-zeroed block of sizeclass sc_idx, or nullptr when dry
+  void *pop(size_t sc_idx) {
+    if (target == 0)
+      return nullptr;
+    lock_guard<mutex> lk(lks[sc_idx]);
+    if (blocks[sc_idx].empty())
+      return nullptr;
+    void *ptr = blocks[sc_idx].back();
+    blocks[sc_idx].pop_back();
+    return ptr;
+  }
+};
+ZeroPool zero_pool;
+} // namespace
+
+/*
+ * Epoch-based deferred reclamation (RP_epoch_enter/exit, RP_retire).
+ * A classic 3-bucket EBR scheme: readers announce the global epoch in a
+ * cacheline-private slot for the duration of an operation; retired
+ * blocks land in the retiring thread's bucket for the current epoch and
+ * are bulk-freed (into the TCacheBins, via do_free) once the global
+ * epoch has moved two steps past them, at which point no announced
+ * reader can still hold a reference. The global epoch only advances
+ * when every announced reader has caught up, checked every
+ * EPOCH_ADVANCE_RETIRES retires.
+ */
+namespace {
+const int EPOCH_BUCKETS = 3;
+const int EPOCH_ADVANCE_RETIRES = 64;
+const uint64_t EPOCH_IDLE = UINT64_MAX;
+
+struct alignas(CACHELINE_SIZE) EpochSlot {
+  atomic<uint64_t> epoch{EPOCH_IDLE};
+};
+
+struct EpochBucket {
+  uint64_t epoch = 0;
+  vector<void *> blocks;
+};
+
+atomic<uint64_t> global_epoch(1);
+mutex epoch_lk; // guards the slot registry and orphaned buckets
+vector<EpochSlot *> epoch_slots;
+// buckets left behind by exited threads, freed on a later advance
+vector<EpochBucket> epoch_orphans;
+
+void epoch_free_bucket(vector<void *> &blocks) {
+  for (void *block : blocks) {
+    base_md->do_free(block);
+  }
+  blocks.clear();
+}
+
+struct EpochHandle {
+  EpochSlot slot;
+  EpochBucket buckets[EPOCH_BUCKETS];
+  int retire_count = 0;
+  EpochHandle() {
+    lock_guard<mutex> lk(epoch_lk);
+    epoch_slots.push_back(&slot);
+  }
+  ~EpochHandle() {
+    lock_guard<mutex> lk(epoch_lk);
+    epoch_slots.erase(find(epoch_slots.begin(), epoch_slots.end(), &slot));
+    // blocks this thread retired may still be visible; orphan them for
+    // a later advance (or RP_close) to free. After RP_close they leak
+    // into the persistent heap, where restart GC reclaims them.
+    for (int i = 0; i < EPOCH_BUCKETS; i++) {
+      if (!buckets[i].blocks.empty())
+        epoch_orphans.push_back(std::move(buckets[i]));
+    }
+  }
+};
+thread_local EpochHandle t_epoch;
+
+// advance the global epoch if every announced reader has observed it,
+// then free any orphaned bucket two or more epochs behind
+void epoch_try_advance() {
+  uint64_t e = global_epoch.load();
+  lock_guard<mutex> lk(epoch_lk);
+  for (EpochSlot *slot : epoch_slots) {
+    uint64_t se = slot->epoch.load();
+    if (se != EPOCH_IDLE && se < e)
+      return;
+  }
+  if (!global_epoch.compare_exchange_strong(e, e + 1))
+    return;
+  for (size_t i = 0; i < epoch_orphans.size();) {
+    if (epoch_orphans[i].epoch + 2 <= e + 1) {
+      epoch_free_bucket(epoch_orphans[i].blocks);
+      epoch_orphans.erase(epoch_orphans.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+// RP_close: readers are gone by contract, so all orphans are safe
+void epoch_drain() {
+  lock_guard<mutex> lk(epoch_lk);
+  for (EpochBucket &bucket : epoch_orphans) {
+    epoch_free_bucket(bucket.blocks);
+  }
+  epoch_orphans.clear();
+}
+} // namespace
+
+void RP_epoch_enter() {
+  assert(initialized && "RPMalloc isn't initialized!");
+  // announce-and-verify: without the re-check, an advance racing with
+  // the announcement could free blocks this reader goes on to access
+  uint64_t e;
+  do {
+    e = global_epoch.load();
+    t_epoch.slot.epoch.store(e, memory_order_seq_cst);
+  } while (global_epoch.load() != e);
+}
+
+void RP_epoch_exit() {
+  t_epoch.slot.epoch.store(EPOCH_IDLE, memory_order_release);
+}
+
+void RP_retire(void *ptr) {
+  assert(initialized && "RPMalloc isn't initialized!");
+  if (ptr == nullptr)
+    return;
+  uint64_t e = global_epoch.load();
+  EpochBucket &bucket = t_epoch.buckets[e % EPOCH_BUCKETS];
+  if (bucket.epoch != e) {
+    // previous content is at least three epochs old; every reader that
+    // could have seen it has exited
+    epoch_free_bucket(bucket.blocks);
+    bucket.epoch = e;
+  }
+  bucket.blocks.push_back(ptr);
+  if (++t_epoch.retire_count >= EPOCH_ADVANCE_RETIRES) {
+    t_epoch.retire_count = 0;
+    epoch_try_advance();
+  }
+}
+
+/*
+ * Shutdown drain: flush every registered thread's cache bins back to
+ * their superblocks with a worker pool, one closing fence for the whole
+ * batch, instead of waiting on each thread's TCaches destructor in
+ * turn. Safe only under the RP_close contract: no concurrent
+ * allocation.
+ */
+static void drain_all_caches() {
+  vector<TCaches *> caches = ralloc::all_caches();
+  if (caches.empty())
+    return;
+  size_t workers =
+      min(caches.size(), (size_t)thread::hardware_concurrency());
+  atomic<size_t> next(0);
+  vector<thread> pool;
+  for (size_t w = 0; w < workers; w++) {
+    pool.emplace_back([&caches, &next]() {
+      size_t i;
+      while ((i = next.fetch_add(1)) < caches.size()) {
+        for (int sc = 1; sc < MAX_SZ_IDX; sc++) { // sc 0 is reserved.
+          base_md->flush_cache(sc, &caches[i]->t_cache[sc]);
+        }
+      }
+    });
+  }
+  for (auto &worker : pool) {
+    worker.join();
+  }
+  FLUSHFENCE;
+}
+
 struct RallocHolder {
   int init_ret_val;
+  // set once the heap has been drained and marked consistent, so the
+  // destructor only has the region teardown left to do
+  bool closed = false;
   RallocHolder(const char *_id, uint64_t size) {
     init_ret_val = _RP_init(_id, size);
+    if (const char *env = getenv("RALLOC_ZERO_POOL")) {
+      size_t target = strtoul(env, nullptr, 10);
+      if (target > 0)
+        zero_pool.start(target);
+    }
   }
-  ~RallocHolder() {
+  // everything up to and including marking the heap consistent
+  void close_heap() {
+    zero_pool.shutdown();
+    epoch_drain();
+    drain_all_caches();
     // #ifndef MEM_CONSUME_TEST
     // flush_region would affect the memory consumption result (rss) and
     // thus is disabled for benchmark testing. To enable, simply comment out
@@ -81,7 +340,13 @@ struct RallocHolder {
     // _rgs->flush_region(SB_IDX);
     // #endif
     base_md->writeback();
+    ralloc::size_profile_dump();
     initialized = false;
+    closed = true;
+  }
+  ~RallocHolder() {
+    if (!closed)
+      close_heap();
     delete _rgs;
   }
 };
@@ -100,41 +365,106 @@ int RP_init(const char *_id, uint64_t size) {
 
 size_t RP_cache_size() {
   size_t total = 0;
+  cache_guard_t cg;
   for (int i = 1; i < MAX_SZ_IDX; i++) { // sc 0 is reserved.
     SizeClassData *sc = sizeclass.get_sizeclass_by_idx_noinline(i);
     uint32_t const block_size = sc->block_size;
-    total += t_caches.t_cache[i].get_block_num();
+    total += cg.caches().t_cache[i].get_block_num();
   }
   return total;
 }
 size_t RP_cache_count() {
   size_t total = 0;
+  cache_guard_t cg;
   for (int i = 1; i < MAX_SZ_IDX; i++) { // sc 0 is reserved.
-    total += t_caches.t_cache[i].get_block_num();
+    total += cg.caches().t_cache[i].get_block_num();
   }
   return total;
 }
 
 void RP_gc() { base_md->gc(); }
+void RP_gc_set_generational(int enable) {
+  ralloc::gc_enable_generational(enable != 0);
+}
+void RP_gc_remember(void *ptr) { ralloc::gc_remember(ptr); }
+void RP_gc_partial() { base_md->gc_generational(); }
 size_t RP_gc_count() { return GarbageCollection::count; }
 size_t RP_gc_time() { return GarbageCollection::time; }
 
-void RP_invalidate() { t_caches = TCaches(); }
+// Reset bins in place: constructing a temporary TCaches would adopt a
+// parked cache and then double-own its blocks through the assignment.
+// (Per-CPU mode resets the calling CPU's slot.)
+void RP_invalidate() {
+  cache_guard_t cg;
+  for (size_t i = 0; i < MAX_SZ_IDX; i++)
+    cg.caches().t_cache[i] = TCacheBin();
+}
+
+int RP_crash_dump(int fd) { return ralloc::crash_dump(fd); }
+
+void RP_stage_enable(size_t dram_budget) { ralloc::stage_enable(dram_budget); }
+void *RP_stage_read(void *ptr) { return ralloc::stage_read(ptr); }
+void RP_stage_write(void *ptr, const void *src, size_t len) {
+  ralloc::stage_write(ptr, src, len);
+}
+
+void RP_stats_read(ralloc::RallocStats *out) { ralloc::stats_read(out); }
+size_t RP_stat_ring_drain(ralloc::StatEvent *out, size_t max) {
+  return ralloc::stat_ring_drain(out, max);
+}
 
 int RP_recover() { return (int)base_md->restart(); }
 
 void RP_close() { delete _holder; }
 
+void RP_close_async() {
+  RallocHolder *holder = _holder;
+  holder->close_heap();
+  // the heap is consistent; unmapping tens of GB of regions can happen
+  // off the caller's shutdown path
+  thread([holder]() { delete holder; }).detach();
+}
+
 void *RP_malloc(size_t sz) {
   assert(initialized && "RPMalloc isn't initialized!");
   return base_md->do_malloc(sz);
 }
 
+void *RP_malloc_node(size_t sz, int node) {
+  assert(initialized && "RPMalloc isn't initialized!");
+  return base_md->do_malloc_node(sz, node);
+}
+
+void *RP_malloc_hint(size_t sz, int flags) {
+  assert(initialized && "RPMalloc isn't initialized!");
+  return base_md->do_malloc_hint(sz, (flags & RALLOC_COLD) != 0);
+}
+
+void *RP_aligned_alloc(size_t align, size_t sz) {
+  assert(initialized && "RPMalloc isn't initialized!");
+  return base_md->do_aligned_malloc(align, sz);
+}
+
+size_t RP_malloc_batch(size_t sz, size_t n, void **out) {
+  assert(initialized && "RPMalloc isn't initialized!");
+  return base_md->do_malloc_batch(sz, n, out);
+}
+
+void RP_thread_warmup(const size_t *sizes, const uint32_t *counts, size_t n) {
+  assert(initialized && "RPMalloc isn't initialized!");
+  base_md->do_warmup(sizes, counts, n);
+}
+
 void RP_free(void *ptr) {
   assert(initialized && "RPMalloc isn't initialized!");
   base_md->do_free(ptr);
 }
 
+void RP_free_sized(void *ptr, size_t sz) {
+  assert(initialized && "RPMalloc isn't initialized!");
+  base_md->do_free_sized(ptr, sz);
+}
+
 void *RP_set_root(void *ptr, uint64_t i) {
   if (ralloc::initialized == false) {
     RP_init("no_explicit_init");
@@ -149,8 +479,80 @@ void *RP_get_root_c(uint64_t i) {
 // return the size of ptr in byte.
 // No check for whether ptr is allocated or isn't null
 size_t RP_malloc_size(void *ptr) {
-  const Descriptor *desc = base_md->desc_lookup(ptr);
-  return (size_t)desc->block_size;
+  return base_md->do_malloc_size(ptr);
+}
+
+// below this, copies go through regular stores plus per-line write-back;
+// at or above it, non-temporal stores win (no pollution, no second pass)
+static const size_t RP_NT_COPY_MIN = 256;
+
+void *RP_memcpy(void *dst, const void *src, size_t len) {
+  if (len == 0)
+    return dst;
+  // DRAM destination (or heap not up): nothing to persist
+  if (!initialized || !_rgs->in_range(SB_IDX, dst))
+    return memcpy(dst, src, len);
+
+  char *d = (char *)dst;
+  const char *s = (const char *)src;
+
+  if (PWB_ACTIVE && len >= RP_NT_COPY_MIN) {
+    // head: up to the next line boundary with regular stores
+    size_t head = (size_t)(-(intptr_t)d & CACHELINE_MASK);
+    if (head > 0) {
+      memcpy(d, s, head);
+      FLUSH(d);
+      d += head;
+      s += head;
+      len -= head;
+    }
+    // middle: full lines as non-temporal qword stores, staged through a
+    // stack buffer so src may be arbitrarily aligned. The stores bypass
+    // the cache, so no write-back pass touches these lines again.
+    while (len >= (size_t)CACHELINE_SIZE) {
+      uint64_t q[CACHELINE_SIZE / 8];
+      memcpy(q, s, CACHELINE_SIZE);
+      for (int i = 0; i < CACHELINE_SIZE / 8; i++)
+        _mm_stream_si64((long long *)d + i, (long long)q[i]);
+      d += CACHELINE_SIZE;
+      s += CACHELINE_SIZE;
+      len -= CACHELINE_SIZE;
+    }
+    if (len > 0) {
+      memcpy(d, s, len);
+      FLUSH(d);
+    }
+    FLUSHFENCE; // drains the nt stores and orders the head/tail flushes
+    return dst;
+  }
+
+  // small copy (or flush-free build): copy, then write back each
+  // touched line exactly once
+  memcpy(d, s, len);
+  for (char *p = (char *)((uintptr_t)d & ~CACHELINE_MASK); p < d + len;
+       p += CACHELINE_SIZE)
+    FLUSH(p);
+  FLUSHFENCE;
+  return dst;
+}
+
+void *RP_memmove(void *dst, const void *src, size_t len) {
+  char *d = (char *)dst;
+  const char *s = (const char *)src;
+  // only a forward-overlapping pair needs the backward copy; everything
+  // else (including backward overlap) is safe for the front-to-back
+  // streaming path
+  if (d > s && d < s + len) {
+    memmove(dst, src, len);
+    if (initialized && _rgs->in_range(SB_IDX, dst)) {
+      for (char *p = (char *)((uintptr_t)d & ~CACHELINE_MASK); p < d + len;
+           p += CACHELINE_SIZE)
+        FLUSH(p);
+      FLUSHFENCE;
+    }
+    return dst;
+  }
+  return RP_memcpy(dst, src, len);
 }
 
 void *RP_realloc(void *ptr, size_t new_size) {
@@ -159,20 +561,48 @@ void *RP_realloc(void *ptr, size_t new_size) {
   if (!_rgs->in_range(SB_IDX, ptr))
     return nullptr;
   size_t old_size = RP_malloc_size(ptr);
-  if (old_size == new_size) {
+  // the block's size class (or superblock span) often already has room
+  if (new_size <= old_size) {
     return ptr;
   }
+  // in-place growth for a large block sitting at the region frontier:
+  // absorb the unallocated space next door instead of copy+free
+  if (old_size > (size_t)MAX_SZ) {
+    size_t new_sbs = (new_size + SBSIZE - 1) & ~(SBSIZE - 1);
+    RegionManager *sb_region = _rgs->regions[SB_IDX];
+    char *expect = (char *)ptr + old_size;
+    if (sb_region->curr_addr_ptr->load() == expect &&
+        (char *)ptr + new_sbs <= sb_region->base_addr + sb_region->FILESIZE) {
+      if (sb_region->curr_addr_ptr->compare_exchange_strong(
+              expect, (char *)ptr + new_sbs)) {
+        FLUSH(sb_region->curr_addr_ptr);
+        FLUSHFENCE;
+        sb_region->__materialize_to((uint64_t)((char *)ptr + new_sbs -
+                                               sb_region->base_addr));
+        Descriptor *desc = base_md->desc_lookup(ptr);
+        desc->block_size = new_sbs;
+        FLUSH(desc);
+        FLUSHFENCE;
+        return ptr;
+      }
+    }
+  }
   void *new_ptr = RP_malloc(new_size);
   if (UNLIKELY(new_ptr == nullptr))
     return nullptr;
-  memcpy(new_ptr, ptr, old_size);
-  FLUSH(new_ptr);
-  FLUSHFENCE;
+  // flushes every copied line, not just the first, before the old
+  // block can be reused
+  RP_memcpy(new_ptr, ptr, old_size);
   RP_free(ptr);
   return new_ptr;
 }
 
 void *RP_calloc(size_t num, size_t size) {
+  if (num * size <= (size_t)MAX_SZ) {
+    void *pooled = zero_pool.pop(sizeclass.get_sizeclass(num * size));
+    if (pooled != nullptr)
+      return pooled; // already zeroed and flushed by the worker
+  }
   void *ptr = RP_malloc(num * size);
   if (UNLIKELY(ptr == nullptr))
     return nullptr;
@@ -183,6 +613,49 @@ void *RP_calloc(size_t num, size_t size) {
   return ptr;
 }
 
+/*
+ * Point-in-time copy of the live heap under id $dst$, for offline
+ * analysis. Quiesce is limited to flushing the descriptor and BaseMeta
+ * regions: after that the image is crash-consistent, and opening it
+ * runs the usual dirty-restart GC to rebuild free lists. Each region
+ * file is reflinked when the filesystem supports it (instant, CoW);
+ * otherwise a fork'd child — whose address space is a CoW snapshot of
+ * this instant — streams the mapped image out in the background while
+ * the parent keeps allocating.
+ */
+int RP_snapshot(const char *dst) {
+  assert(initialized && "RPMalloc isn't initialized!");
+  string dst_path = HEAPFILE_PREFIX + string(dst);
+  FLUSHFENCE;
+  _rgs->flush_region(DESC_IDX);
+  _rgs->flush_region(META_IDX);
+
+  // same layout as _RP_init, indexed by RegionIndex
+  static const char *suffix[LAST_IDX] = {"_desc", "_sb", "_basemd"};
+  string dst_files[LAST_IDX];
+  bool need_copy[LAST_IDX];
+  bool any_copy = false;
+  for (int i = 0; i < LAST_IDX; i++) {
+    dst_files[i] = dst_path + suffix[i];
+    need_copy[i] = _rgs->regions[i]->__clone_to(dst_files[i]) != 0;
+    any_copy = any_copy || need_copy[i];
+  }
+  if (!any_copy)
+    return 0;
+  pid_t pid = fork();
+  if (pid < 0)
+    return -1;
+  if (pid == 0) {
+    // only async-signal-safe calls from here on
+    for (int i = 0; i < LAST_IDX; i++) {
+      if (need_copy[i])
+        _rgs->regions[i]->__copy_to(dst_files[i]);
+    }
+    _exit(0);
+  }
+  return 0;
+}
+
 int RP_in_prange(void *ptr) {
   if (_rgs->in_range(SB_IDX, ptr))
     return 1;
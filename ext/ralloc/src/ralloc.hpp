@@ -36,23 +36,113 @@ int RP_init(const char *_id, uint64_t size);
 size_t RP_cache_count();
 size_t RP_cache_size();
 
+/* Stop-the-world trace and sweep. With RALLOC_GC_PUNCH_HOLES set, a
+ * collection also hole-punches the file ranges of fully-free
+ * superblocks, returning their capacity to the filesystem (they
+ * re-materialize when carved again). */
 void RP_gc();
+/* Generational mode. RP_gc_set_generational(1) starts tracking which
+ * superblocks the allocator dirties; RP_gc_partial then traces and
+ * rebuilds only those, plus blocks announced with RP_gc_remember — the
+ * write barrier callers must invoke when storing a pointer from an old
+ * (unmodified) object into a young block. Same stop-the-world contract
+ * as RP_gc. */
+void RP_gc_set_generational(int enable);
+void RP_gc_remember(void *ptr);
+void RP_gc_partial();
 
 size_t RP_gc_count();
 size_t RP_gc_time();
 
 void RP_invalidate();
 
+/* Async-signal-safe crash dump: writes a best-effort snapshot of the
+ * per-thread caches, partial-list heads with their superblock anchors,
+ * and each thread's recent-operation breadcrumb ring to fd (text, one
+ * record per line). Intended to be called from a SIGSEGV/SIGBUS
+ * handler with an already-open sidecar file descriptor; uses only
+ * write(2), never locks or allocates. Returns 0, or -1 when the heap
+ * is not up. */
+int RP_crash_dump(int fd);
+
+#ifdef __cplusplus
+/* sum the per-thread telemetry counters into *out */
+void RP_stats_read(ralloc::RallocStats *out);
+/* drain up to $max$ events from the RALLOC_STAT_RING event ring */
+size_t RP_stat_ring_drain(ralloc::StatEvent *out, size_t max);
+#endif
+
 /* return 1 if it's dirty, otherwise 0. */
 int RP_recover();
 void RP_close();
+/* like RP_close, but returns as soon as the heap is marked consistent;
+ * region unmapping finishes in a background thread. */
+void RP_close_async();
 void *RP_malloc(size_t sz);
+/* allocate n blocks of size sz at once into out; returns the number of
+ * blocks actually allocated. */
+size_t RP_malloc_batch(size_t sz, size_t n, void **out);
+/* allocate sz bytes whose backing superblock is bound to the given NUMA
+ * node; node == -1 behaves like RP_malloc. */
+void *RP_malloc_node(size_t sz, int node);
+/* lifetime-hinted RP_malloc: RALLOC_COLD blocks come from their own
+ * superblock group per size class, so run-phase garbage and long-lived
+ * data never share a superblock — reclamation finds whole superblocks
+ * dead and cold data stays off hot cache lines. RALLOC_HOT (or 0) is
+ * the default placement. */
+#define RALLOC_HOT 0x1
+#define RALLOC_COLD 0x2
+void *RP_malloc_hint(size_t sz, int flags);
+/* allocate sz bytes on an align boundary. Power-of-two alignments up
+ * to a page come for free from the size class geometry (no padding, no
+ * bookkeeping; the block is RP_free-able as usual); anything else
+ * returns NULL. */
+void *RP_aligned_alloc(size_t align, size_t sz);
 void RP_free(void *ptr);
+/* RP_free for callers that know the allocation size (as passed to
+ * RP_malloc); skips the descriptor lookup, mirroring C++17 sized
+ * delete. */
+void RP_free_sized(void *ptr, size_t sz);
+/* Persistence-aware copies into ralloc-managed PM: large copies go
+ * through non-temporal stores (no cache pollution, no separate
+ * write-back pass), small ones copy and flush each touched line once;
+ * both end with the trailing fence. Destinations outside the heap get
+ * a plain memcpy/memmove. Return dst, like their libc namesakes. */
+void *RP_memcpy(void *dst, const void *src, size_t len);
+void *RP_memmove(void *dst, const void *src, size_t len);
+/* Epoch-based deferred reclamation. A reader brackets each operation on
+ * a lock-free structure with RP_epoch_enter/RP_epoch_exit; an unlinked
+ * block passed to RP_retire is batched per epoch and handed back to the
+ * thread caches in bulk once no bracketed reader can still hold it. */
+void RP_epoch_enter();
+void RP_epoch_exit();
+void RP_retire(void *ptr);
+/* Pre-populate the calling thread's cache bins: for each of the n
+ * entries, ensure at least counts[i] blocks of the class serving
+ * sizes[i] bytes are cached (clamped to the bin's flush threshold).
+ * Called once when a pool spawns a worker, it replaces the burst of
+ * refill round-trips the first allocations would otherwise pay. */
+void RP_thread_warmup(const size_t *sizes, const uint32_t *counts, size_t n);
 void *RP_set_root(void *ptr, uint64_t i);
 void *RP_get_root_c(uint64_t i);
 size_t RP_malloc_size(void *ptr);
 void *RP_calloc(size_t num, size_t size);
 void *RP_realloc(void *ptr, size_t new_size);
+/* DRAM staging tier for read-mostly data. RP_stage_enable carves a
+ * DRAM arena of the given byte budget in superblock-sized slots;
+ * RP_stage_read(ptr) returns a pointer to read through - the DRAM
+ * mirror of ptr's superblock once it has proven hot (sampled hit
+ * counting), ptr itself otherwise. Writes into staged ranges must go
+ * through RP_stage_write, which persists to PM first and then
+ * refreshes the mirror; PM stays the only durable truth. */
+void RP_stage_enable(size_t dram_budget);
+void *RP_stage_read(void *ptr);
+void RP_stage_write(void *ptr, const void *src, size_t len);
+
+/* point-in-time copy of the live heap under id dst; reflinks the heap
+ * files when the filesystem supports it, otherwise streams a fork'd
+ * CoW image in the background. Returns 0 on success. */
+int RP_snapshot(const char *dst);
 /* return 1 if ptr is in range of Ralloc heap, otherwise 0. */
 int RP_in_prange(void *ptr);
 /* return 1 if the query is invalid, otherwise 0 and write start and end addr to
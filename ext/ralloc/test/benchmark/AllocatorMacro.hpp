@@ -9,6 +9,7 @@
 #include "pfence_util.h"
 
 #include <cassert>
+#include <cstdio>
 #include <cstdlib>
 
 #ifndef THREAD_PINNING
@@ -71,6 +72,36 @@ volatile static int init_count = 0;
     return RP_get_root<T>(i);
   }
   inline void pm_set_root(void* ptr, unsigned int i) { RP_set_root(ptr, i); }
+  // One parseable "pm_stats: ops=N flushes=N" line from the always-on
+  // allocator telemetry (allocs+frees vs. cache lines flushed), summed
+  // over all size classes; run_matrix.sh divides the two into a
+  // flushes-per-allocator-op column.
+  inline void pm_report_stats() {
+    ralloc::RallocStats st;
+    RP_stats_read(&st);
+    uint64_t ops = 0, flushes = 0;
+    for (size_t i = 0; i < MAX_SZ_IDX; i++) {
+      ops += st.allocs[i] + st.frees[i];
+      flushes += st.flushes[i];
+    }
+    printf("pm_stats: ops=%lu flushes=%lu\n",
+           (unsigned long)ops, (unsigned long)flushes);
+  }
+
+  // Currently live allocator blocks (allocs minus frees) from the same
+  // telemetry; samplers subtract a baseline to see net growth, and a
+  // gap between this and a benchmark's own live-object accounting is
+  // reclamation lag.
+  inline uint64_t pm_live_blocks() {
+    ralloc::RallocStats st;
+    RP_stats_read(&st);
+    uint64_t allocs = 0, frees = 0;
+    for (size_t i = 0; i < MAX_SZ_IDX; i++) {
+      allocs += st.allocs[i];
+      frees += st.frees[i];
+    }
+    return allocs >= frees ? allocs - frees : 0;
+  }
 
 #elif defined(MAKALU) // RALLOC ends
 
@@ -174,6 +205,8 @@ volatile static int init_count = 0;
     return (T*)MAK_persistent_root(i);
   }
   inline void pm_set_root(void* ptr, unsigned int i) { return MAK_set_persistent_root(i, ptr); }
+  inline void pm_report_stats() {} // makalu exposes no flush telemetry
+  inline uint64_t pm_live_blocks() { return 0; } // no live-block telemetry
 
 #elif defined(PMDK) // MAKALU ends
 
@@ -239,6 +272,8 @@ volatile static int init_count = 0;
     return (T*)((PMDK_roots*)pmemobj_direct(root))->roots[i];
   }
   inline void pm_set_root(void* ptr, unsigned int i) { ((PMDK_roots*)pmemobj_direct(root))->roots[i] = ptr; }
+  inline void pm_report_stats() {} // pmdk exposes no flush telemetry
+  inline uint64_t pm_live_blocks() { return 0; } // no live-block telemetry
 
 #else // PMDK ends
 
@@ -255,6 +290,8 @@ volatile static int init_count = 0;
     return (T*)roots[i];
   }
   inline void pm_set_root(void* ptr, unsigned int i) { roots[i] = ptr; }
+  inline void pm_report_stats() {} // transient malloc: nothing to flush
+  inline uint64_t pm_live_blocks() { return 0; } // no live-block telemetry
 
 #endif //else ends
 
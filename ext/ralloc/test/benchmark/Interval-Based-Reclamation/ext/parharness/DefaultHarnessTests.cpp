@@ -28,6 +28,7 @@ limitations under the License.
 #include <set>
 #include <iterator>
 #include <climits>
+#include <chrono>
 
 using namespace std;
 
@@ -623,3 +624,73 @@ uint32_t UIDGenerator::id(uint32_t val){
 
 
 
+
+// RetiredSampler methods
+RetiredSampler::RetiredSampler(GlobalTestConfig* gtc,
+ std::function<uint64_t(int)> retired_len, size_t obj_size,
+ std::function<uint64_t()> alloc_live){
+	this->retired_len = retired_len;
+	this->alloc_live = alloc_live;
+	this->obj_size = obj_size;
+	task_num = gtc->task_num;
+	if(gtc->checkEnv("retiredTick")){
+		tick_ms = atoi((gtc->getEnv("retiredTick")).c_str());
+	}
+	done.store(false);
+	gtc->recorder->addGlobalField("retired_peak_objs");
+	gtc->recorder->addGlobalField("retired_peak_bytes");
+	gtc->recorder->addGlobalField("retired_steady_objs");
+	gtc->recorder->addGlobalField("retired_steady_bytes");
+	gtc->recorder->addGlobalField("alloc_live_steady");
+}
+
+void RetiredSampler::start(){
+	if(!retired_len){return;}
+	thr = std::thread([this](){
+		while(!done.load()){
+			uint64_t total = 0;
+			for(int t = 0; t<task_num; t++){
+				total += retired_len(t);
+			}
+			retired_samples.push_back(total);
+			live_samples.push_back(alloc_live ? alloc_live() : 0);
+			std::this_thread::sleep_for(std::chrono::milliseconds(tick_ms));
+		}
+	});
+}
+
+void RetiredSampler::finish(GlobalTestConfig* gtc){
+	if(!retired_len){return;}
+	done.store(true);
+	thr.join();
+	uint64_t peak = 0;
+	for(size_t i = 0; i<retired_samples.size(); i++){
+		if(retired_samples[i]>peak){peak = retired_samples[i];}
+	}
+	// steady state: mean over the last half of the run, after the
+	// retired lists reach their equilibrium against empty_freq
+	uint64_t steady = 0;
+	uint64_t live_steady = 0;
+	size_t half = retired_samples.size()/2;
+	if(retired_samples.size()>half){
+		for(size_t i = half; i<retired_samples.size(); i++){
+			steady += retired_samples[i];
+			live_steady += live_samples[i];
+		}
+		steady /= (retired_samples.size()-half);
+		live_steady /= (retired_samples.size()-half);
+	}
+	gtc->recorder->reportGlobalInfo("retired_peak_objs", (unsigned long)peak);
+	gtc->recorder->reportGlobalInfo("retired_peak_bytes", (unsigned long)(peak*obj_size));
+	gtc->recorder->reportGlobalInfo("retired_steady_objs", (unsigned long)steady);
+	gtc->recorder->reportGlobalInfo("retired_steady_bytes", (unsigned long)(steady*obj_size));
+	gtc->recorder->reportGlobalInfo("alloc_live_steady", (unsigned long)live_steady);
+	if(gtc->verbose){
+		printf("retired_curve: tick_ms=%lu obj_size=%lu\n",
+		 (unsigned long)tick_ms, (unsigned long)obj_size);
+		for(size_t i = 0; i<retired_samples.size(); i++){
+			printf("retired_curve: %lu,%lu,%lu\n", (unsigned long)(i*tick_ms),
+			 (unsigned long)retired_samples[i], (unsigned long)live_samples[i]);
+		}
+	}
+}
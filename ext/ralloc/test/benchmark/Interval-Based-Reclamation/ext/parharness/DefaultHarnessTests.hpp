@@ -32,6 +32,10 @@ limitations under the License.
 #include <vector>
 #include <list>
 #include <map>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
 #include <hwloc.h>
 
 class InsertRemoveTest : public Test{
@@ -79,6 +83,37 @@ public:
 	void cleanup(GlobalTestConfig* gtc);
 };
 
+/*
+ * Samples the unreclaimed-garbage curve on a fixed tick while a test
+ * runs: throughput alone can't separate reclamation schemes, since a
+ * scheme that stalls reclamation shows up as memory the tracker has
+ * retired but not yet freed, not as ops. The callbacks keep this class
+ * free of tracker/allocator types (the harness also builds standalone):
+ * retired_len(tid) returns tid's current retired-list length and
+ * alloc_live() the allocator's live-block count, so the gap between the
+ * two curves is reclamation lag. finish() reports peak and steady-state
+ * (mean of the last half of the samples) objects and bytes into the
+ * recorder, and dumps the raw curve when verbose.
+ */
+class RetiredSampler{
+public:
+	std::function<uint64_t(int)> retired_len;
+	std::function<uint64_t()> alloc_live;
+	int task_num;
+	size_t obj_size;
+	uint64_t tick_ms = 50;
+	std::thread thr;
+	std::atomic<bool> done;
+	std::vector<uint64_t> retired_samples; // total retired objects per tick
+	std::vector<uint64_t> live_samples;    // allocator live blocks per tick
+
+	RetiredSampler(GlobalTestConfig* gtc,
+	 std::function<uint64_t(int)> retired_len, size_t obj_size,
+	 std::function<uint64_t()> alloc_live);
+	void start();
+	void finish(GlobalTestConfig* gtc);
+};
+
 class SequentialTest : public Test{
 public:
 
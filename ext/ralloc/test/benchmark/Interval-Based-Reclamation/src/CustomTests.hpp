@@ -21,9 +21,11 @@ limitations under the License.
 #define CUSTOMTESTS_HPP
 
 #include "Harness.hpp"
+#include "DefaultHarnessTests.hpp"
 #include "RUnorderedMap.hpp"
 #include "ROrderedMap.hpp"
 #include "RetiredMonitorable.hpp"
+#include "AllocatorMacro.hpp"
 #include <map>
 #include <random>
 #include <chrono>
@@ -166,20 +168,25 @@ template <class T>
 class ObjRetireTest : public Test{
 public:
 	RUnorderedMap<T,T>* m;
+	RetiredSampler* retired_sampler = nullptr;
 	int pg,pr,pp,pi,pv;
 	int prop_gets, prop_replaces, prop_puts, prop_inserts, prop_removes;
 	int range;
 	int prefill;
 
 	inline T fromInt(uint64_t v);
-	
+
 	ObjRetireTest(int p_gets, int p_replaces, int p_puts, int p_inserts, int p_removes, int range, int prefill);
 	ObjRetireTest(int p_gets, int p_replaces, int p_puts, int p_inserts, int p_removes, int range):
 		ObjRetireTest(p_gets, p_replaces, p_puts, p_inserts, p_removes, range,0){}
 	void init(GlobalTestConfig* gtc);
 	void parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc){}
 	int execute(GlobalTestConfig* gtc, LocalTestConfig* ltc);
-	void cleanup(GlobalTestConfig* gtc){}
+	void cleanup(GlobalTestConfig* gtc){
+		if(retired_sampler){
+			retired_sampler->finish(gtc);
+		}
+	}
 };
 
 template <class T>
@@ -233,6 +240,18 @@ void ObjRetireTest<T>::init(GlobalTestConfig* gtc){
 
 	// add a field in records:
 	gtc->recorder->addThreadField("obj_retired", &Recorder::sumInt64s);
+	// per-thread retired-list length at the end of the run (current
+	// unreclaimed garbage, unlike the cumulative obj_retired sum)
+	gtc->recorder->addThreadField("retired_final", &Recorder::sumInt64s);
+
+	// unreclaimed-garbage curve on a fixed tick (see RetiredSampler);
+	// the allocator's live-block telemetry rides along so reclamation
+	// lag is measured, not inferred
+	RetiredMonitorable* rm_ptr = dynamic_cast<RetiredMonitorable*>(ptr);
+	if(rm_ptr->retired_live_fn){
+		retired_sampler = new RetiredSampler(gtc, rm_ptr->retired_live_fn,
+		 rm_ptr->retired_obj_size, [](){return (uint64_t)pm_live_blocks();});
+	}
 
 	// prefill
 	int i = 0;
@@ -258,6 +277,12 @@ void ObjRetireTest<T>::init(GlobalTestConfig* gtc){
 	if(gtc->verbose){
 		printf("Prefilled %d\n",i);
 	}
+
+	// start ticking after the prefill so the curve covers the measured
+	// run, not the setup burst
+	if(retired_sampler){
+		retired_sampler->start();
+	}
 }
 
 template <class T>
@@ -320,6 +345,8 @@ int ObjRetireTest<T>::ObjRetireTest::execute(GlobalTestConfig* gtc, LocalTestCon
 
 	RetiredMonitorable* rm_ptr = dynamic_cast<RetiredMonitorable*>(m);
 	gtc->recorder->reportThreadInfo("obj_retired", rm_ptr->report_retired(ltc->tid), ltc->tid);
+	gtc->recorder->reportThreadInfo("retired_final",
+	 rm_ptr->retired_live_fn ? rm_ptr->retired_live_fn(tid) : (uint64_t)0, ltc->tid);
 	return ops;
 }
 
@@ -24,15 +24,28 @@ limitations under the License.
 #include <list>
 #include <vector>
 #include <atomic>
+#include <functional>
 #include "ConcurrentPrimitives.hpp"
 #include "RAllocator.hpp"
 
 class RetiredMonitorable{
 public:
 	padded<uint64_t>* retired_cnt;
+	// live view for RetiredSampler (see DefaultHarnessTests.hpp):
+	// rideables that own a MemoryTracker register a callback returning
+	// tid's *current* retired-list length (the tracker incs it on
+	// retire and decs on reclaim, so this is unreclaimed garbage, not
+	// the cumulative sum retired_cnt accumulates) plus the retired
+	// object's size so the sampler can report bytes
+	std::function<uint64_t(int)> retired_live_fn;
+	size_t retired_obj_size = 0;
 	RetiredMonitorable(GlobalTestConfig* gtc){
 		retired_cnt = new padded<uint64_t>[gtc->task_num];
 	}
+	void monitor_retired_live(std::function<uint64_t(int)> fn, size_t obj_size){
+		retired_live_fn = std::move(fn);
+		retired_obj_size = obj_size;
+	}
 	void collect_retired_size(uint64_t size, int tid){
 		retired_cnt[tid].ui += size;
 	}
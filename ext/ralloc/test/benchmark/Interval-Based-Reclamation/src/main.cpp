@@ -108,6 +108,7 @@ int main(int argc, char *argv[])
 	else{
 		printf("%ld \t",gtc->total_operations/gtc->interval);
 	}
+	PM_report_stats();
 	PM_close();
 	return 0;
 }
@@ -68,6 +68,7 @@ public:
 		int epochf = gtc->getEnv("epochf").empty()? 150:stoi(gtc->getEnv("epochf"));
 		int emptyf = gtc->getEnv("emptyf").empty()? 30:stoi(gtc->getEnv("emptyf"));
 		memory_tracker = new MemoryTracker<Node>(gtc, epochf, emptyf, 1, COLLECT);
+		monitor_retired_live([this](int t){return memory_tracker->get_retired_cnt(t);}, sizeof(Node));
 		}
 	~LinkedList(){};
 	Node* mkNode(K k, V v, Node* n, int tid){
@@ -119,6 +120,7 @@ public:
 		int epochf = gtc->getEnv("epochf").empty()? 150:stoi(gtc->getEnv("epochf"));
 		int emptyf = gtc->getEnv("emptyf").empty()? 30:stoi(gtc->getEnv("emptyf"));
 		memory_tracker = new MemoryTracker<Node>(gtc, epochf, emptyf, 1, COLLECT);
+		monitor_retired_live([this](int t){return memory_tracker->get_retired_cnt(t);}, sizeof(Node));
 	}
 	void* operator new(size_t size){
 		return PM_malloc(size);
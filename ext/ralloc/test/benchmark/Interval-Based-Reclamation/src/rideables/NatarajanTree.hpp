@@ -156,6 +156,7 @@ public:
         int epochf = gtc->getEnv("epochf").empty()? 150:stoi(gtc->getEnv("epochf"));
         int emptyf = gtc->getEnv("emptyf").empty()? 30:stoi(gtc->getEnv("emptyf"));
 		memory_tracker = new MemoryTracker<Node>(gtc, epochf, emptyf, 5, COLLECT);
+		monitor_retired_live([this](int t){return memory_tracker->get_retired_cnt(t);}, sizeof(Node));
 		r = Node::alloc(infK,defltV,nullptr,nullptr,2,memory_tracker,0);
 		s = Node::alloc(infK,defltV,nullptr,nullptr,1,memory_tracker,0);
 		r->right = Node::alloc(infK,defltV,nullptr,nullptr,2,memory_tracker,0);
@@ -177,6 +178,7 @@ public:
 		int epochf = gtc->getEnv("epochf").empty()? 150:stoi(gtc->getEnv("epochf"));
 		int emptyf = gtc->getEnv("emptyf").empty()? 30:stoi(gtc->getEnv("emptyf"));
 		memory_tracker = new MemoryTracker<Node>(gtc, epochf, emptyf, 5, COLLECT);
+		monitor_retired_live([this](int t){return memory_tracker->get_retired_cnt(t);}, sizeof(Node));
 		records = new padded<SeekRecord>[gtc->task_num]{};
 	}
 	void* operator new(size_t size){
@@ -86,6 +86,7 @@ public:
         int emptyf = gtc->getEnv("emptyf").empty()? 30:stoi(gtc->getEnv("emptyf"));
 		std::cout<<"emptyf:"<<emptyf<<std::endl;
 		memory_tracker = new MemoryTracker<Node>(gtc, epochf, emptyf, 3, COLLECT);
+		monitor_retired_live([this](int t){return memory_tracker->get_retired_cnt(t);}, sizeof(Node));
 	}
 	~SortedUnorderedMap(){};
 
@@ -100,6 +101,7 @@ public:
 		int emptyf = gtc->getEnv("emptyf").empty()? 30:stoi(gtc->getEnv("emptyf"));
 		std::cout<<"emptyf:"<<emptyf<<std::endl;
 		memory_tracker = new MemoryTracker<Node>(gtc, epochf, emptyf, 3, COLLECT);
+		monitor_retired_live([this](int t){return memory_tracker->get_retired_cnt(t);}, sizeof(Node));
 	}
 	optional<V> get(K key, int tid);
 	optional<V> put(K key, V val, int tid);
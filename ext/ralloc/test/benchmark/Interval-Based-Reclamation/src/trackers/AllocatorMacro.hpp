@@ -1,13 +1,23 @@
-#ifndef ALLOCATOR_MACRO
-#define ALLOCATOR_MACRO
+#ifndef IBR_ALLOCATOR_MACRO
+#define IBR_ALLOCATOR_MACRO
 
-#include "ralloc.hpp"
-#define PM_start(id) RP_init(id)
-#define PM_close() RP_close()
-#define PM_recover() RP_recover()
-#define PM_malloc(sz) RP_malloc(sz)
-#define PM_free(ptr) RP_free(ptr)
-#define set_root(ptr, i) RP_set_root(ptr, i)
-#define get_root(i) RP_get_root(i)
+// Thin shim over the compile-time allocator selection in
+// ../../../AllocatorMacro.hpp (-DRALLOC / -DMAKALU / -DPMDK / none), so
+// the rideables build against the same allocator cross-product as the
+// Hoard-style benchmarks instead of being hardwired to ralloc. Pick the
+// flavor with ALLOC= on the make command line (see the Makefile);
+// libralloc.a in ../../ must be built with the same flavor, which
+// `make matrix` there takes care of. The PM_* names below are what the
+// rideables and harness mains already use.
+#include "../../../AllocatorMacro.hpp"
 
-#endif
\ No newline at end of file
+#define PM_start(id) pm_init()
+#define PM_close() pm_close()
+#define PM_recover() pm_recover()
+#define PM_report_stats() pm_report_stats()
+#define PM_malloc(sz) pm_malloc(sz)
+#define PM_free(ptr) pm_free(ptr)
+#define set_root(ptr, i) pm_set_root(ptr, i)
+#define get_root(i) pm_get_root<void>(i)
+
+#endif
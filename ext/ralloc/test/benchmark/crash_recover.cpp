@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2019 University of Rochester. All rights reserved.
+ * Licenced under the MIT licence. See LICENSE file in the project root for
+ * details.
+ */
+
+/*
+ * crash_recover: crash-injection stress benchmark with recovery timing.
+ *
+ * Each trial forks a child that runs larson-style malloc/free churn
+ * against a persistent slot table (root 0), SIGKILLs it at a randomized
+ * point, then forks a second child that times RP_init + RP_recover on
+ * the dirty pool and validates heap invariants: every published slot
+ * must point to a block with an intact header and pattern line whose
+ * RP_malloc_size covers the recorded size, and the allocator must
+ * survive a burst of fresh malloc/free afterwards. Churn time ramps
+ * across trials, so the output is a recovery-time-vs-live-objects
+ * curve -- the shape that exposes superlinear recovery behaviors
+ * before they ship.
+ *
+ * Blocks are published crash-consistently (header+pattern line flushed
+ * and fenced before the slot pointer, slot cleared and fenced before
+ * RP_free), so anything recovery finds through a slot must validate;
+ * blocks lost between malloc and publish are garbage the recovery GC
+ * has to collect, which is part of the work being timed.
+ *
+ * Usage: ./crash_recover_test [threads] [slots/thread] [fill%] [trials]
+ * Output: one CSV line per trial:
+ *   trial, churn_ms, live_objects, dirty, recovery_us, status
+ */
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ralloc.hpp"
+
+#define CRASH_REGION_SIZE (5 * 1024 * 1024 * 1024ULL)
+#define POOL_ID "crash"
+
+static int nthreads = 4;
+static int slots_per_thread = 20000;
+static int fill_pct = 70;
+static int trials = 8;
+
+// block layout: header in the first 16 bytes, deterministic pattern
+// filling the rest of the first cache line (the part we flush and can
+// therefore demand back after a crash)
+struct BlockHdr {
+  uint64_t size; // requested allocation size, header included
+  uint64_t tag;  // HDR_TAG ^ slot index
+};
+static const uint64_t HDR_TAG = 0x52435243524352ULL;
+
+static inline uint8_t pattern_byte(uint64_t slot) {
+  return (uint8_t)(slot * 31 + 7);
+}
+
+static void publish_block(pptr<char> *slot, uint64_t slot_idx, char *blk,
+                          uint64_t sz) {
+  BlockHdr *hdr = (BlockHdr *)blk;
+  hdr->size = sz;
+  hdr->tag = HDR_TAG ^ slot_idx;
+  memset(blk + sizeof(BlockHdr), pattern_byte(slot_idx),
+         CACHELINE_SIZE - sizeof(BlockHdr));
+  FLUSH(blk);
+  FLUSHFENCE;
+  *slot = blk;
+  FLUSH(slot);
+  FLUSHFENCE;
+}
+
+static void churn_thread(pptr<char> *slots, uint64_t base, int count,
+                         unsigned seed) {
+  while (true) {
+    uint64_t slot_idx = base + rand_r(&seed) % count;
+    pptr<char> *slot = &slots[slot_idx];
+    char *cur = static_cast<char *>(*slot);
+    if (cur == nullptr) {
+      // mostly small classes, occasionally spilling into large ones
+      uint64_t sz = CACHELINE_SIZE + rand_r(&seed) % 4032;
+      if (rand_r(&seed) % 256 == 0)
+        sz += MAX_SZ;
+      char *blk = (char *)RP_malloc(sz);
+      if (blk != nullptr)
+        publish_block(slot, slot_idx, blk, sz);
+    } else if ((int)(rand_r(&seed) % 100) >= fill_pct) {
+      // unlink durably first; a crash in between only leaks, and the
+      // recovery GC reclaims leaks
+      *slot = nullptr;
+      FLUSH(slot);
+      FLUSHFENCE;
+      RP_free(cur);
+    }
+  }
+}
+
+// forked churn child; runs until the parent kills it
+static void run_churn() {
+  RP_init(POOL_ID, CRASH_REGION_SIZE);
+  uint64_t total = (uint64_t)nthreads * slots_per_thread;
+  pptr<char> *slots = (pptr<char> *)RP_malloc(total * sizeof(pptr<char>));
+  for (uint64_t i = 0; i < total; i++)
+    slots[i] = nullptr;
+  for (uint64_t off = 0; off < total * sizeof(pptr<char>);
+       off += CACHELINE_SIZE)
+    FLUSH((char *)slots + off);
+  FLUSHFENCE;
+  RP_set_root(slots, 0);
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < nthreads; t++)
+    workers.emplace_back(churn_thread, slots, (uint64_t)t * slots_per_thread,
+                         slots_per_thread, (unsigned)(t * 7919 + 13));
+  for (auto &w : workers)
+    w.join(); // never returns; the parent SIGKILLs us
+}
+
+// forked recovery child; prints the trial's CSV line, exits nonzero on
+// any invariant violation
+static int run_recover(int trial, long churn_ms) {
+  using namespace std::chrono;
+  auto t0 = steady_clock::now();
+  int restart = RP_init(POOL_ID, CRASH_REGION_SIZE);
+  // registering root 0 installs its (conservative) filter before the
+  // recovery GC walks the roots
+  char *slots_raw = RP_get_root<char>(0);
+  int dirty = RP_recover();
+  auto t1 = steady_clock::now();
+  long recovery_us = duration_cast<microseconds>(t1 - t0).count();
+
+  pptr<char> *slots = (pptr<char> *)slots_raw;
+  uint64_t total = (uint64_t)nthreads * slots_per_thread;
+  uint64_t live = 0, bad = 0;
+  for (uint64_t i = 0; i < total; i++) {
+    char *blk = static_cast<char *>(slots[i]);
+    if (blk == nullptr)
+      continue;
+    live++;
+    BlockHdr *hdr = (BlockHdr *)blk;
+    bool ok = hdr->tag == (HDR_TAG ^ i) && hdr->size >= CACHELINE_SIZE &&
+              RP_malloc_size(blk) >= hdr->size;
+    for (size_t b = sizeof(BlockHdr); ok && b < CACHELINE_SIZE; b++)
+      ok = (uint8_t)blk[b] == pattern_byte(i);
+    if (!ok)
+      bad++;
+  }
+
+  // the recovered heap must also still allocate: burst of fresh
+  // malloc/free across the small classes
+  std::vector<void *> burst;
+  for (int i = 0; i < 10000; i++) {
+    void *p = RP_malloc(8 + (i % 512) * 8);
+    if (p == nullptr)
+      bad++;
+    else
+      burst.push_back(p);
+  }
+  for (void *p : burst)
+    RP_free(p);
+  RP_close();
+
+  printf("%d, %ld, %lu, %d, %ld, %s\n", trial, churn_ms, live, dirty,
+         recovery_us, bad == 0 ? "ok" : "CORRUPT");
+  fflush(stdout);
+  if (!restart || bad != 0)
+    return 1;
+  return 0;
+}
+
+static void remove_pool() {
+  const char *suffix[] = {"_basemd", "_desc", "_sb"};
+  for (const char *s : suffix)
+    unlink((std::string(HEAPFILE_PREFIX) + POOL_ID + s).c_str());
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1)
+    nthreads = atoi(argv[1]);
+  if (argc > 2)
+    slots_per_thread = atoi(argv[2]);
+  if (argc > 3)
+    fill_pct = atoi(argv[3]);
+  if (argc > 4)
+    trials = atoi(argv[4]);
+  srand(12345);
+
+  printf("trial, churn_ms, live_objects, dirty, recovery_us, status\n");
+  int failures = 0;
+  for (int trial = 0; trial < trials; trial++) {
+    remove_pool();
+    pid_t churn = fork();
+    if (churn == 0) {
+      run_churn();
+      _exit(0);
+    }
+    // ramp the churn window so live sets (and garbage) grow across
+    // trials; randomize within the window to vary the kill point
+    long churn_ms = 100 + trial * 400 + rand() % 100;
+    usleep(churn_ms * 1000);
+    kill(churn, SIGKILL);
+    waitpid(churn, nullptr, 0);
+
+    pid_t recover = fork();
+    if (recover == 0)
+      _exit(run_recover(trial, churn_ms));
+    int status = 0;
+    waitpid(recover, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failures++;
+  }
+  if (failures) {
+    fprintf(stderr, "crash_recover: %d/%d trials failed validation\n",
+            failures, trials);
+    return 1;
+  }
+  return 0;
+}
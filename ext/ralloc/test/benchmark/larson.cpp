@@ -216,6 +216,7 @@ int main (int argc, char *argv[])
 #ifdef _DEBUG
   _cputs("Hit any key to exit...") ;	(void)_getch() ;
 #endif
+  pm_report_stats();
   pm_close();
   return(0) ;
 
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2019 University of Rochester. All rights reserved.
+ * Licenced under the MIT licence. See LICENSE file in the project root for
+ * details.
+ */
+
+/*
+ * This benchmark records per-call allocation latency instead of
+ * aggregate throughput, so tail regressions (e.g. p999 malloc spikes
+ * when a thread hits superblock carving) stay visible.
+ *
+ * Every thread runs a steady-state malloc/free ring per request size,
+ * timing each call with rdtsc into an HDR-style histogram (power-of-two
+ * groups with 32 linear sub-buckets, ~3% value precision) kept per
+ * thread, operation and size. After the run the histograms are merged
+ * and printed as one JSON line per (op, size), cycles as the unit:
+ *
+ *   {"op":"malloc","size":64,"threads":8,"count":...,"p50":...,...}
+ *
+ * Usage: ./latency_test <nthreads> <ops per size per thread>
+ * run_latency.sh sweeps thread counts and collects the output.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpuinfo.h"
+#include "timer.h"
+
+#include "AllocatorMacro.hpp"
+
+// request sizes to exercise, one per interesting size class
+static const size_t SIZES[] = {16, 64, 128, 256, 1024, 4096, 14336};
+static const int NSIZES = sizeof(SIZES) / sizeof(SIZES[0]);
+
+// ring depth per size: deep enough that frees hit blocks past the
+// thread cache's hot end, shallow enough to stay resident
+static const int RING_DEPTH = 1024;
+
+enum { OP_MALLOC = 0, OP_FREE, NOPS };
+static const char *OP_NAMES[NOPS] = {"malloc", "free"};
+
+// HDR-style histogram: group = position of the msb, 32 linear
+// sub-buckets per group
+static const int HIST_GROUPS = 48; // up to 2^47 cycles, plenty
+static const int HIST_SUBS = 32;
+
+struct Hist {
+  uint64_t buckets[HIST_GROUPS][HIST_SUBS];
+  uint64_t count;
+  uint64_t max;
+
+  void record(uint64_t v) {
+    int msb = 63 - __builtin_clzll(v | 1);
+    int group, sub;
+    if (msb < 5) {
+      group = 0;
+      sub = (int)v;
+    } else {
+      group = msb - 4;
+      sub = (int)((v >> (msb - 5)) & (HIST_SUBS - 1));
+    }
+    if (group >= HIST_GROUPS)
+      group = HIST_GROUPS - 1;
+    buckets[group][sub]++;
+    count++;
+    if (v > max)
+      max = v;
+  }
+
+  void merge(const Hist &other) {
+    for (int g = 0; g < HIST_GROUPS; g++)
+      for (int s = 0; s < HIST_SUBS; s++)
+        buckets[g][s] += other.buckets[g][s];
+    count += other.count;
+    if (other.max > max)
+      max = other.max;
+  }
+
+  // lower bound of the bucket holding the q-quantile observation
+  uint64_t percentile(double q) const {
+    uint64_t rank = (uint64_t)(q * (double)count);
+    if (rank >= count)
+      rank = count - 1;
+    uint64_t seen = 0;
+    for (int g = 0; g < HIST_GROUPS; g++) {
+      for (int s = 0; s < HIST_SUBS; s++) {
+        seen += buckets[g][s];
+        if (seen > rank) {
+          if (g == 0)
+            return (uint64_t)s;
+          return ((uint64_t)(HIST_SUBS + s)) << (g - 1);
+        }
+      }
+    }
+    return max;
+  }
+};
+
+class workerArg {
+public:
+  int tid;
+  int nthreads;
+  uint64_t ops_per_size;
+  Hist *hists; // [NOPS][NSIZES], this thread's slice
+};
+
+pthread_barrier_t barrier;
+
+static void *worker(void *arg) {
+  workerArg &w = *(workerArg *)arg;
+#ifdef THREAD_PINNING
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(PINNING_MAP[w.tid % 80], &cpuset);
+  int set_result =
+      pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+  if (set_result != 0) {
+    fprintf(stderr, "setaffinity failed for thread %d\n", w.tid);
+  }
+#endif
+  void **ring = (void **)malloc(RING_DEPTH * sizeof(void *));
+
+  pthread_barrier_wait(&barrier);
+
+  for (int si = 0; si < NSIZES; si++) {
+    size_t size = SIZES[si];
+    Hist *h_malloc = &w.hists[OP_MALLOC * NSIZES + si];
+    Hist *h_free = &w.hists[OP_FREE * NSIZES + si];
+    memset(ring, 0, RING_DEPTH * sizeof(void *));
+
+    // warm-up: reach steady state (caches populated, superblocks
+    // carved) before timing starts
+    for (int i = 0; i < RING_DEPTH; i++) {
+      ring[i] = pm_malloc(size);
+    }
+
+    uint64_t slot = 0;
+    for (uint64_t i = 0; i < w.ops_per_size; i++) {
+      uint64_t t0 = asm_rdtsc();
+      pm_free(ring[slot]);
+      uint64_t t1 = asm_rdtsc();
+      void *p = pm_malloc(size);
+      uint64_t t2 = asm_rdtsc();
+      h_free->record(t1 - t0);
+      h_malloc->record(t2 - t1);
+      ring[slot] = p;
+      slot = (slot + 1) % RING_DEPTH;
+    }
+
+    for (int i = 0; i < RING_DEPTH; i++) {
+      pm_free(ring[i]);
+    }
+  }
+
+  free(ring);
+  return nullptr;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <nthreads> <ops per size per thread>\n",
+            argv[0]);
+    return 1;
+  }
+  int nthreads = atoi(argv[1]);
+  uint64_t ops = strtoull(argv[2], nullptr, 10);
+
+  pm_init();
+
+  Hist *hists = (Hist *)calloc((size_t)nthreads * NOPS * NSIZES, sizeof(Hist));
+  workerArg *args = (workerArg *)calloc(nthreads, sizeof(workerArg));
+  pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+  pthread_barrier_init(&barrier, nullptr, nthreads);
+
+  for (int t = 0; t < nthreads; t++) {
+    args[t].tid = t;
+    args[t].nthreads = nthreads;
+    args[t].ops_per_size = ops;
+    args[t].hists = hists + (size_t)t * NOPS * NSIZES;
+    pthread_create(&threads[t], nullptr, worker, &args[t]);
+  }
+  for (int t = 0; t < nthreads; t++) {
+    pthread_join(threads[t], nullptr);
+  }
+
+  for (int op = 0; op < NOPS; op++) {
+    for (int si = 0; si < NSIZES; si++) {
+      Hist merged;
+      memset(&merged, 0, sizeof(merged));
+      for (int t = 0; t < nthreads; t++) {
+        merged.merge(hists[(size_t)t * NOPS * NSIZES + op * NSIZES + si]);
+      }
+      printf("{\"op\":\"%s\",\"size\":%lu,\"threads\":%d,\"count\":%lu,"
+             "\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"p999\":%lu,"
+             "\"p9999\":%lu,\"max\":%lu}\n",
+             OP_NAMES[op], SIZES[si], nthreads, merged.count,
+             merged.percentile(0.50), merged.percentile(0.90),
+             merged.percentile(0.99), merged.percentile(0.999),
+             merged.percentile(0.9999), merged.max);
+    }
+  }
+
+  pm_close();
+  free(threads);
+  free(args);
+  free(hists);
+  return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2019 University of Rochester. All rights reserved.
+ * Licenced under the MIT licence. See LICENSE file in the project root for
+ * details.
+ */
+
+/*
+ * pool_analyze: offline fragmentation analyzer for ralloc pool files.
+ *
+ * Maps the <prefix>_desc and <prefix>_sb files of a pool read-only and
+ * walks the descriptor array directly -- no RP_init, no live process --
+ * so copies of production pools can be analyzed anywhere. Both the
+ * self-relative pptr encoding and the region-relative CrossPtr offsets
+ * decode against wherever we happen to map the files, which is what
+ * makes the offline walk possible.
+ *
+ * Reports, per size class: superblock counts by state, block occupancy,
+ * slack bytes (free block slots inside live superblocks), a fill-level
+ * histogram, and a fill CDF. Options:
+ *   -m        superblock heat map, one char per superblock
+ *   -b <sc>   block-level heat map for the first superblocks of class sc
+ *
+ * Caveats: anchors and in-superblock free lists are runtime state that
+ * the allocator flushes opportunistically, so the numbers are exact for
+ * cleanly closed pools and best-effort for crash images; blocks parked
+ * in thread caches at close count as live here.
+ *
+ * Usage: ./pool_analyze [-m] [-b <sc>] <pool path prefix>
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "BaseMeta.hpp"
+
+static char *map_file(const std::string &path, size_t *len) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "pool_analyze: can't open %s\n", path.c_str());
+    exit(1);
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    fprintf(stderr, "pool_analyze: can't stat %s\n", path.c_str());
+    exit(1);
+  }
+  void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED) {
+    fprintf(stderr, "pool_analyze: mmap of %s failed\n", path.c_str());
+    exit(1);
+  }
+  close(fd);
+  *len = st.st_size;
+  return (char *)addr;
+}
+
+// per-class accumulators
+struct ClassStat {
+  uint64_t sbs = 0;
+  uint64_t full = 0, partial = 0;
+  uint64_t blocks = 0, live = 0;
+  uint32_t block_size = 0;
+  std::vector<double> fills; // live/maxcount per superblock
+};
+
+// walk the in-superblock free list and mark free blocks; returns the
+// number of free blocks found, bailing out on anything that doesn't
+// look like a well-formed chain (crash images)
+static uint32_t mark_free_blocks(char *sb, const Descriptor *desc, Anchor a,
+                                 std::vector<uint8_t> &free_map) {
+  uint32_t found = 0;
+  if (a.state == SB_FULL)
+    return 0;
+  uint64_t bs = desc->block_size;
+  char *blk = sb + (uint64_t)a.avail * bs;
+  while (found < desc->maxcount) {
+    uint64_t off = (uint64_t)(blk - sb);
+    if (blk < sb || off >= (uint64_t)desc->maxcount * bs || off % bs != 0)
+      break;
+    uint32_t idx = off / bs;
+    if (free_map[idx])
+      break; // cycle
+    free_map[idx] = 1;
+    found++;
+    char *next = static_cast<char *>(*(pptr<char> *)blk);
+    if (next == nullptr)
+      break;
+    blk = next;
+  }
+  return found;
+}
+
+int main(int argc, char **argv) {
+  bool sb_map = false;
+  int block_map_sc = -1;
+  const char *prefix = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-m") == 0) {
+      sb_map = true;
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      block_map_sc = atoi(argv[++i]);
+    } else {
+      prefix = argv[i];
+    }
+  }
+  if (prefix == nullptr) {
+    fprintf(stderr, "usage: %s [-m] [-b <sc>] <pool path prefix>\n", argv[0]);
+    return 1;
+  }
+
+  size_t desc_len = 0, sb_len = 0;
+  char *desc_base = map_file(std::string(prefix) + "_desc", &desc_len);
+  char *sb_base = map_file(std::string(prefix) + "_sb", &sb_len);
+  uint64_t num_sb = desc_len / DESCSIZE;
+  if (sb_len / SBSIZE < num_sb)
+    num_sb = sb_len / SBSIZE;
+
+  // the sb region header holds the (self-relative) bump frontier;
+  // everything beyond it was never formatted
+  char *frontier = ((atomic_pptr<char> *)sb_base)->load();
+  uint64_t frontier_idx = num_sb;
+  if (frontier > sb_base && frontier <= sb_base + sb_len)
+    frontier_idx = ((uint64_t)(frontier - sb_base) + SBSIZE - 1) / SBSIZE;
+
+  ClassStat cls[MAX_SZ_IDX] = {};
+  uint64_t free_sbs = 0, unformatted = num_sb - frontier_idx;
+  std::string heat;
+  int block_maps_left = 64;
+
+  for (uint64_t i = 1; i < frontier_idx; i++) {
+    const Descriptor *desc = (const Descriptor *)(desc_base + i * DESCSIZE);
+    char *sb = sb_base + i * SBSIZE;
+    uint64_t heap_off = (uint64_t)desc->heap.off;
+    uint64_t sb_off = (uint64_t)desc->superblock.off;
+    bool in_use = heap_off != 0 && sb_off == i * SBSIZE;
+    size_t sc = 0;
+    if (in_use) {
+      sc = (heap_off - offsetof(BaseMeta, heaps)) / sizeof(ProcHeap);
+      if (sc >= MAX_SZ_IDX)
+        in_use = false; // not a heap pointer; treat as free/corrupt
+    }
+    if (!in_use) {
+      free_sbs++;
+      heat.push_back('.');
+      continue;
+    }
+    Anchor a = desc->anchor.load(std::memory_order_relaxed);
+    if (sc == 0) {
+      // large span: one block covering block_size bytes
+      ClassStat &c = cls[0];
+      c.sbs++;
+      c.full++;
+      c.blocks++;
+      c.live++;
+      c.fills.push_back(1.0);
+      uint64_t span = (desc->block_size + SBSIZE - 1) / SBSIZE;
+      for (uint64_t k = 0; k < span && i + k < frontier_idx; k++)
+        heat.push_back('L');
+      i += span - 1;
+      continue;
+    }
+    ClassStat &c = cls[sc];
+    // multi-stride superblock: interiors carry mirror descriptors
+    // whose superblock points at this head; skip them in the walk
+    uint64_t span =
+        ((uint64_t)desc->maxcount * desc->block_size + SBSIZE - 1) / SBSIZE;
+    std::vector<uint8_t> free_map(desc->maxcount, 0);
+    uint32_t freed = mark_free_blocks(sb, desc, a, free_map);
+    // prefer the walked count; fall back to the anchor if the chain
+    // was truncated (crash image)
+    uint32_t nfree = freed >= a.count ? freed : a.count;
+    if (nfree > desc->maxcount)
+      nfree = desc->maxcount;
+    uint32_t live = desc->maxcount - nfree;
+    c.sbs++;
+    if (a.state == SB_FULL)
+      c.full++;
+    else
+      c.partial++;
+    c.blocks += desc->maxcount;
+    c.live += live;
+    c.block_size = desc->block_size;
+    double fill = (double)live / desc->maxcount;
+    c.fills.push_back(fill);
+    for (uint64_t k = 0; k < span && i + k < frontier_idx; k++)
+      heat.push_back(fill >= 0.995 ? '#' : '0' + (int)(fill * 10));
+    if ((int)sc == block_map_sc && block_maps_left > 0) {
+      block_maps_left--;
+      printf("sb %8lu sc %2zu fill %5.1f%% |", i, sc, fill * 100);
+      for (uint32_t b = 0; b < desc->maxcount; b++)
+        putchar(free_map[b] ? '.' : '#');
+      printf("|\n");
+    }
+    i += span - 1;
+  }
+
+  printf("pool: %s\n", prefix);
+  printf("superblocks: %lu formatted, %lu free, %lu unformatted\n",
+         frontier_idx - 1, free_sbs, unformatted);
+  printf("\n sc  blksz     sbs    full partial     blocks       live  live%%  "
+         "slack(MiB)  fill histogram (deciles)\n");
+  for (size_t sc = 0; sc < MAX_SZ_IDX; sc++) {
+    ClassStat &c = cls[sc];
+    if (c.sbs == 0)
+      continue;
+    uint64_t hist[10] = {0};
+    for (double f : c.fills) {
+      int d = (int)(f * 10);
+      hist[d > 9 ? 9 : d]++;
+    }
+    double livep = c.blocks ? 100.0 * c.live / c.blocks : 0;
+    double slack =
+        (double)(c.blocks - c.live) * c.block_size / (1024.0 * 1024.0);
+    printf("%3zu %6u %7lu %7lu %7lu %10lu %10lu %5.1f%% %10.1f  [", sc,
+           sc == 0 ? 0 : c.block_size, c.sbs, c.full, c.partial, c.blocks,
+           c.live, livep, sc == 0 ? 0.0 : slack);
+    for (int d = 0; d < 10; d++)
+      printf("%s%lu", d ? " " : "", hist[d]);
+    printf("]\n");
+  }
+
+  printf("\nsuperblock fill CDF per class (live fraction at percentile)\n");
+  const int pcts[] = {10, 25, 50, 75, 90, 99};
+  for (size_t sc = 1; sc < MAX_SZ_IDX; sc++) {
+    ClassStat &c = cls[sc];
+    if (c.fills.empty())
+      continue;
+    std::sort(c.fills.begin(), c.fills.end());
+    printf("%3zu %6u ", sc, c.block_size);
+    for (int p : pcts) {
+      size_t k = (size_t)(c.fills.size() * (p / 100.0));
+      if (k >= c.fills.size())
+        k = c.fills.size() - 1;
+      printf(" p%02d %.2f", p, c.fills[k]);
+    }
+    printf("\n");
+  }
+
+  if (sb_map) {
+    printf("\nheat map ('.' free, 'L' large, 0-9/# fill decile, one char "
+           "per superblock)\n");
+    for (size_t i = 0; i < heat.size(); i += 128)
+      printf("%08zx %s\n", i * SBSIZE, heat.substr(i, 128).c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,12 @@
+#!/bin/bash
+# crash-injection stress run: larson-style churn killed at randomized
+# points, recovery timed and validated (see benchmark/crash_recover.cpp)
+
+THREADS=${1:-4}
+SLOTS=${2:-20000}
+FILL=${3:-70}
+TRIALS=${4:-8}
+
+make crash_recover_test
+rm -rf crash.csv
+./crash_recover_test ${THREADS} ${SLOTS} ${FILL} ${TRIALS} | tee crash.csv
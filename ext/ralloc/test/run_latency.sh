@@ -0,0 +1,20 @@
+#!/bin/bash
+if [[ $# -ne 1 ]]; then
+  ALLOC="r"
+else
+  ALLOC=$1
+fi
+ARGS="ALLOC="
+ARGS=${ARGS}${ALLOC}
+echo $ARGS
+
+make clean
+make latency_test ${ARGS}
+rm -rf latency.json
+for threads in 1 2 4 6 10 16 20 24 32 40 48 62 72 80 84 88
+do
+	rm -rf /mnt/pmem/*
+	./latency_test $threads 1000000 >> latency.json
+done
+NAME="../data/latency/latency_"${ALLOC}".json"
+cp latency.json ${NAME}
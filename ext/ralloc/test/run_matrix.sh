@@ -0,0 +1,69 @@
+#!/bin/bash
+# Allocator-comparison matrix: builds larson and the IBR map-churn
+# harness once per allocator flavor (`make matrix`), runs every
+# benchmark against every allocator with identical workload streams
+# (fixed seeds and parameters), and emits one table -- matrix.csv --
+# with throughput, flushes per allocator op, and recovery time side by
+# side. This replaces the day of rebuild-edit-rerun the comparison used
+# to take.
+#
+# usage: ./run_matrix.sh [threads]
+
+if [[ $# -ne 1 ]]; then
+  THREADS=8
+else
+  THREADS=$1
+fi
+
+make matrix
+
+rm -rf matrix.csv
+echo "benchmark,allocator,threads,ops,flush_per_op,recovery_us" >> matrix.csv
+
+# flushes per allocator op from the "pm_stats: ops=N flushes=N" line
+# the ralloc-backed flavors print on close; "na" when the allocator has
+# no such telemetry (mak, pmdk)
+flush_per_op() {
+	awk '/^pm_stats:/ {
+		split($2, o, "="); split($3, f, "=");
+		if (o[2] > 0) { printf "%.4f", f[2] / o[2]; found = 1 }
+	} END { if (!found) print "na" }' $1
+}
+
+for ALLOC in r lr mak pmdk
+do
+	rm -rf /mnt/pmem/*
+	# same parameters and seed (123) as run_larson.sh, so every
+	# allocator sees the same allocation stream
+	./larson_test_${ALLOC} 10 64 400 1000 10000 123 $THREADS > /tmp/matrix_larson
+	ops=$(awk '/Throughput/ {print $3}' /tmp/matrix_larson)
+	fpo=$(flush_per_op /tmp/matrix_larson)
+
+	# mean recovery time over the crash-injection trials
+	# (crash_recover_test); ralloc only -- the other allocators have no
+	# recovery path to time
+	recovery="na"
+	if [ "$ALLOC" == "r" ]; then
+		rm -rf /mnt/pmem/*
+		./crash_recover_test_r $THREADS > /tmp/matrix_recover
+		recovery=$(awk -F, 'NF == 6 && $1 !~ /trial/ {s += $5; n++} END { if (n) printf "%.0f", s / n; else print "na" }' /tmp/matrix_recover)
+	fi
+
+	echo "{ \"benchmark\": larson, \"allocator\": $ALLOC, \"ops\": $ops, \"flush_per_op\": $fpo, \"recovery_us\": $recovery }"
+	echo "larson,$ALLOC,$THREADS,$ops,$fpo,$recovery" >> matrix.csv
+done
+
+# IBR suite: SortedUnorderedMap under the ObjRetire g50i30rm20 churn
+# (-r1 -m0), interval-based reclamation doing the retiring; no pmdk
+# flavor (see the matrix target)
+for ALLOC in r lr mak
+do
+	rm -rf /mnt/pmem/* /dev/shm/*
+	./ibr_main_${ALLOC} -r1 -m0 -i5 -t$THREADS -v > /tmp/matrix_ibr
+	ops=$(awk -F: '/Operations\/sec/ {print $2}' /tmp/matrix_ibr | tr -d ' ')
+	fpo=$(flush_per_op /tmp/matrix_ibr)
+	echo "{ \"benchmark\": ibr, \"allocator\": $ALLOC, \"ops\": $ops, \"flush_per_op\": $fpo, \"recovery_us\": na }"
+	echo "ibr,$ALLOC,$THREADS,$ops,$fpo,na" >> matrix.csv
+done
+
+cp matrix.csv ../data/matrix.csv
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2019 University of Rochester. All rights reserved.
+ * Licenced under the MIT licence. See LICENSE file in the project root for
+ * details.
+ */
+
+/*
+ * sizeclass_gen: profile-guided size class table generator.
+ *
+ * Input is an allocation-size histogram dumped by the allocator when
+ * run with RALLOC_SIZE_PROFILE=<path> ("size count" lines, one per
+ * requested byte size). The tool picks the MAX_SZ_IDX-1 block sizes
+ * that minimize total internal fragmentation over the histogram
+ * (optimal partition by dynamic programming over 8-byte-aligned
+ * boundaries), writes them as ../src/SizeClassTuned.hpp, and prints a
+ * report comparing per-class waste against the default table.
+ *
+ * Usage: ./sizeclass_gen <histogram> [<output header>]
+ * Rebuild the allocator with -DRALLOC_TUNED_CLASSES to use the table.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "pm_config.hpp"
+
+// block sizes of the default jemalloc-derived table in SizeClass.hpp
+// (the bin_yes entries), for the before/after comparison
+static const uint32_t default_classes[MAX_SZ_IDX - 1] = {
+    8,    16,   24,   32,   40,   48,   56,   64,   80,   96,
+    112,  128,  160,  192,  224,  256,  320,  384,  448,  512,
+    640,  768,  896,  1024, 1280, 1536, 1792, 2048, 2560, 3072,
+    3584, 4096, 5120, 6144, 7168, 8192, 10240, 12288, 14336};
+
+// histogram, indexed by requested size
+static uint64_t count[MAX_SZ + 1] = {0};
+// prefix sums over 0..s: requests, and requested bytes
+static uint64_t pfx_cnt[MAX_SZ + 2] = {0};
+static uint64_t pfx_bytes[MAX_SZ + 2] = {0};
+
+// internal fragmentation of one class with block size b serving all
+// requests in (lo, b]: every request s wastes b-s bytes
+static uint64_t waste(uint32_t lo, uint32_t b) {
+  uint64_t cnt = pfx_cnt[b + 1] - pfx_cnt[lo + 1];
+  uint64_t bytes = pfx_bytes[b + 1] - pfx_bytes[lo + 1];
+  return cnt * (uint64_t)b - bytes;
+}
+
+static uint64_t table_waste(const uint32_t *classes, size_t n,
+                            uint64_t *per_class) {
+  uint64_t total = 0;
+  uint32_t lo = 0;
+  for (size_t i = 0; i < n; i++) {
+    per_class[i] = waste(lo, classes[i]);
+    total += per_class[i];
+    lo = classes[i];
+  }
+  return total;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <histogram> [<output header>]\n", argv[0]);
+    return 1;
+  }
+  const char *out_path = argc > 2 ? argv[2] : "../src/SizeClassTuned.hpp";
+
+  FILE *in = fopen(argv[1], "r");
+  if (in == nullptr) {
+    perror(argv[1]);
+    return 1;
+  }
+  uint64_t size, cnt;
+  uint64_t total_reqs = 0;
+  while (fscanf(in, "%lu %lu", &size, &cnt) == 2) {
+    if (size > MAX_SZ) {
+      fprintf(stderr, "ignoring out-of-range size %lu\n", size);
+      continue;
+    }
+    count[size] += cnt;
+    total_reqs += cnt;
+  }
+  fclose(in);
+  if (total_reqs == 0) {
+    fprintf(stderr, "empty histogram\n");
+    return 1;
+  }
+
+  for (uint32_t s = 0; s <= MAX_SZ; s++) {
+    pfx_cnt[s + 1] = pfx_cnt[s] + count[s];
+    pfx_bytes[s + 1] = pfx_bytes[s] + count[s] * (uint64_t)s;
+  }
+
+  // optimal partition: boundaries are the 8-byte-aligned candidate
+  // block sizes 8..MAX_SZ (a block must at least hold a pptr free-list
+  // link, and 8-byte alignment matches the default table's finest
+  // spacing); dp[k][c] = least waste covering sizes up to candidate c
+  // with k classes, last class ending exactly at c
+  const size_t NCAND = MAX_SZ / 8; // candidate c is block size (c+1)*8
+  const size_t NCLS = MAX_SZ_IDX - 1;
+  const uint64_t INF = UINT64_MAX;
+  std::vector<std::vector<uint64_t>> dp(NCLS + 1,
+                                        std::vector<uint64_t>(NCAND, INF));
+  std::vector<std::vector<uint32_t>> prev(NCLS + 1,
+                                          std::vector<uint32_t>(NCAND, 0));
+  for (size_t c = 0; c < NCAND; c++) {
+    dp[1][c] = waste(0, (c + 1) * 8);
+  }
+  for (size_t k = 2; k <= NCLS; k++) {
+    for (size_t c = k - 1; c < NCAND; c++) {
+      for (size_t p = k - 2; p < c; p++) {
+        if (dp[k - 1][p] == INF)
+          continue;
+        uint64_t w = dp[k - 1][p] + waste((p + 1) * 8, (c + 1) * 8);
+        if (w < dp[k][c]) {
+          dp[k][c] = w;
+          prev[k][c] = p;
+        }
+      }
+    }
+  }
+
+  // the last class must stay MAX_SZ so get_sizeclass keeps covering
+  // every small request
+  uint32_t tuned[NCLS];
+  size_t c = NCAND - 1;
+  for (size_t k = NCLS; k >= 1; k--) {
+    tuned[k - 1] = (c + 1) * 8;
+    c = prev[k][c];
+  }
+
+  uint64_t def_per[NCLS], tuned_per[NCLS];
+  uint64_t def_total = table_waste(default_classes, NCLS, def_per);
+  uint64_t tuned_total = table_waste(tuned, NCLS, tuned_per);
+  uint64_t total_bytes = pfx_bytes[MAX_SZ + 1];
+
+  printf("# requests: %lu, requested bytes: %lu\n", total_reqs, total_bytes);
+  printf("# %8s %14s %10s %14s\n", "default", "waste", "tuned", "waste");
+  for (size_t i = 0; i < NCLS; i++) {
+    printf("  %8u %14lu %10u %14lu\n", default_classes[i], def_per[i],
+           tuned[i], tuned_per[i]);
+  }
+  printf("default table waste: %lu bytes (%.2f%% of requested)\n", def_total,
+         100.0 * def_total / total_bytes);
+  printf("tuned table waste:   %lu bytes (%.2f%% of requested)\n", tuned_total,
+         100.0 * tuned_total / total_bytes);
+
+  FILE *out = fopen(out_path, "w");
+  if (out == nullptr) {
+    perror(out_path);
+    return 1;
+  }
+  fprintf(out, "/*\n"
+               " * Generated by test/sizeclass_gen from %s; do not edit.\n"
+               " * Compile the allocator with -DRALLOC_TUNED_CLASSES to use\n"
+               " * this table instead of the default one in SizeClass.hpp.\n"
+               " */\n\n",
+          argv[1]);
+  fprintf(out, "#ifndef __SIZE_CLASS_TUNED_H\n#define __SIZE_CLASS_TUNED_H\n\n");
+  fprintf(out, "#define SIZE_CLASSES_TUNED \\\n");
+  for (size_t i = 0; i < NCLS; i++) {
+    fprintf(out, "\tSIZE_CLASS_TUNED(%u)%s\n", tuned[i],
+            i + 1 < NCLS ? " \\" : "");
+  }
+  fprintf(out, "\n#endif // __SIZE_CLASS_TUNED_H\n");
+  fclose(out);
+  printf("wrote %s\n", out_path);
+  return 0;
+}
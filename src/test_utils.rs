@@ -297,6 +297,14 @@ pub mod tests {
             Pool::create::<O, M>(&filepath, pool_len, nr_memento).unwrap()
         });
 
+        // Pool templating (evaluation/correctness/pmcheck): create and
+        // initialize the pool only, so the image can be cached and cloned
+        // by later runs instead of re-running setup every execution.
+        #[cfg(feature = "pmcheck")]
+        if std::env::var("MEMENTO_POOL_PRIME").is_ok() {
+            return;
+        }
+
         // run root memento(s)
         pool_handle.execute::<O, M>();
     }